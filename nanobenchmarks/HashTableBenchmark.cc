@@ -19,6 +19,7 @@
  */
 
 #include <math.h>
+#include <algorithm>
 
 #include "Common.h"
 #include "Context.h"
@@ -43,8 +44,203 @@ class TestObject {
     uint64_t key;
 } __attribute__((aligned(64)));
 
+/**
+ * HashTable::KeyHashCallback used to migrate TestObjects during a resize.
+ */
+KeyHash
+testObjectKeyHash(uint64_t reference, void *cookie)
+{
+    TestObject* object = reinterpret_cast<TestObject*>(reference);
+    Key key(0, &object->key, sizeof(object->key));
+    return key.getHash();
+}
+
+/**
+ * Look up a random key in the table and return how many cycles it took.
+ */
+uint64_t
+timeRandomLookup(HashTable& ht, uint64_t nkeys)
+{
+    uint64_t k = generateRandom() % nkeys;
+    Key key(0, &k, sizeof(k));
+    HashTable::Candidates c;
+
+    uint64_t start = Cycles::rdtsc();
+    ht.lookup(key.getHash(), c);
+    while (!c.isDone()) {
+        TestObject* candidateObject =
+            reinterpret_cast<TestObject*>(c.getReference());
+        Key candidateKey(0,
+                         &candidateObject->key,
+                         sizeof(candidateObject->key));
+        if (candidateKey == key)
+            break;
+        c.next();
+    }
+    uint64_t elapsed = Cycles::rdtsc() - start;
+    assert(!c.isDone());
+    return elapsed;
+}
+
+/**
+ * Print the median and tail of a set of latency samples, in nanoseconds.
+ */
+void
+printLatencies(const char* label, vector<uint64_t>& samples)
+{
+    std::sort(samples.begin(), samples.end());
+    size_t n = samples.size();
+    printf("    %-10s p50 %5lu ns  p99 %5lu ns  p99.9 %6lu ns  "
+           "max %7lu ns\n", label,
+           Cycles::toNanoseconds(samples[n / 2]),
+           Cycles::toNanoseconds(samples[n * 99 / 100]),
+           Cycles::toNanoseconds(samples[n * 999 / 1000]),
+           Cycles::toNanoseconds(samples[n - 1]));
+}
+
+/**
+ * Return a printable name for a HashTable::ProbeImplementation.
+ */
+const char*
+probeName(HashTable::ProbeImplementation probe)
+{
+    switch (probe) {
+    case HashTable::PROBE_SCALAR:
+        return "scalar";
+    case HashTable::PROBE_SSE:
+        return "sse4.1";
+    case HashTable::PROBE_AVX2:
+        return "avx2";
+    }
+    return "unknown";
+}
+
 } // anonymous namespace
 
+/**
+ * Compare the cost of looking up every key in the table using each of the
+ * bucket probe implementations (see HashTable::ProbeImplementation) that
+ * this machine supports.
+ */
+void
+hashTableProbeBenchmark(uint64_t nkeys, uint64_t nlines)
+{
+    HashTable ht(nlines);
+    LargeBlockOfMemory<TestObject> block(nkeys * sizeof(TestObject));
+    TestObject* values = block.get();
+
+    printf("populating table...");
+    fflush(stdout);
+    for (uint64_t i = 0; i < nkeys; i++) {
+        Key key(0, &i, sizeof(i));
+        values[i] = TestObject(i);
+        ht.insert(key.getHash(), reinterpret_cast<uint64_t>(&values[i]));
+    }
+    printf("done!\n");
+
+    HashTable::ProbeImplementation original =
+        HashTable::getProbeImplementation();
+    HashTable::ProbeImplementation probes[] = {
+        HashTable::PROBE_SCALAR,
+        HashTable::PROBE_SSE,
+        HashTable::PROBE_AVX2,
+    };
+    foreach (HashTable::ProbeImplementation probe, probes) {
+        if (!HashTable::setProbeImplementation(probe)) {
+            printf("%-8s not supported on this machine\n", probeName(probe));
+            continue;
+        }
+
+        uint64_t candidates = 0;
+        uint64_t lookupCycles = Cycles::rdtsc();
+        for (uint64_t i = 0; i < nkeys; i++) {
+            Key key(0, &i, sizeof(i));
+            HashTable::Candidates c;
+            ht.lookup(key.getHash(), c);
+            while (!c.isDone()) {
+                candidates++;
+                TestObject* candidateObject =
+                    reinterpret_cast<TestObject*>(c.getReference());
+                if (candidateObject->key == i)
+                    break;
+                c.next();
+            }
+        }
+        lookupCycles = Cycles::rdtsc() - lookupCycles;
+        printf("%-8s lookup avg: %lu ticks, %lu nsec (%lu candidates)\n",
+               probeName(probe), lookupCycles / nkeys,
+               Cycles::toNanoseconds(lookupCycles / nkeys), candidates);
+    }
+    HashTable::setProbeImplementation(original);
+}
+
+/**
+ * Measure lookup latency while the table is doubled online, interleaving
+ * one bucket migration with every few lookups the way a master's background
+ * resizer shares a core with RPCs, and compare it to lookups on a table that
+ * is not resizing.
+ */
+void
+hashTableResizeBenchmark(uint64_t nkeys, uint64_t nlines,
+                         uint64_t lookupsPerMigration)
+{
+    HashTable ht(nlines);
+    LargeBlockOfMemory<TestObject> block(nkeys * sizeof(TestObject));
+    TestObject* values = block.get();
+
+    printf("populating table...");
+    fflush(stdout);
+    for (uint64_t i = 0; i < nkeys; i++) {
+        Key key(0, &i, sizeof(i));
+        values[i] = TestObject(i);
+        ht.insert(key.getHash(), reinterpret_cast<uint64_t>(&values[i]));
+    }
+    printf("done!\n");
+
+    vector<uint64_t> steady;
+    uint64_t numSamples = nlines * lookupsPerMigration;
+    steady.reserve(numSamples);
+    for (uint64_t i = 0; i < numSamples; i++)
+        steady.push_back(timeRandomLookup(ht, nkeys));
+
+    printf("resizing from %lu to %lu buckets, %lu lookups per bucket "
+           "migrated...", nlines, 2 * nlines, lookupsPerMigration);
+    fflush(stdout);
+    vector<uint64_t> resizing;
+    resizing.reserve(numSamples);
+    vector<uint64_t> migrations;
+    migrations.reserve(nlines);
+    uint64_t resizeStart = Cycles::rdtsc();
+    ht.startResize(2 * nlines);
+    bool more = true;
+    while (more) {
+        for (uint64_t i = 0; i < lookupsPerMigration; i++)
+            resizing.push_back(timeRandomLookup(ht, nkeys));
+        uint64_t start = Cycles::rdtsc();
+        more = ht.migrateBucket(testObjectKeyHash, NULL);
+        migrations.push_back(Cycles::rdtsc() - start);
+    }
+    ht.finishResize();
+    uint64_t resizeCycles = Cycles::rdtsc() - resizeStart;
+    ht.tagRetiredMemory(0);
+    ht.freeRetiredMemory(~0UL);
+    printf("done!\n");
+
+    vector<uint64_t> after;
+    after.reserve(numSamples);
+    for (uint64_t i = 0; i < numSamples; i++)
+        after.push_back(timeRandomLookup(ht, nkeys));
+
+    printf("== resize took %.3f s (including lookups) ==\n",
+           Cycles::toSeconds(resizeCycles));
+    printf("lookup latency:\n");
+    printLatencies("before", steady);
+    printLatencies("resizing", resizing);
+    printLatencies("after", after);
+    printf("bucket migration latency:\n");
+    printLatencies("migrate", migrations);
+}
+
 void
 hashTableBenchmark(uint64_t nkeys, uint64_t nlines)
 {
@@ -57,6 +253,8 @@ hashTableBenchmark(uint64_t nkeys, uint64_t nlines)
     printf("hash table keys: %lu\n", nkeys);
     printf("hash table lines: %lu\n", nlines);
     printf("cache line size: %d\n", ht.bytesPerCacheLine());
+    printf("bucket probe: %s\n",
+           probeName(HashTable::getProbeImplementation()));
     printf("load factor: %.03f\n", static_cast<double>(nkeys) /
            (static_cast<double>(nlines) * ht.entriesPerCacheLine()));
 
@@ -191,8 +389,9 @@ main(int argc, char **argv)
 
     Context context(true);
 
-    uint64_t hashTableMegs, numberOfKeys;
+    uint64_t hashTableMegs, numberOfKeys, lookupsPerMigration;
     double loadFactor;
+    bool resize, compareProbes;
 
     OptionsDescription benchmarkOptions("HashTableBenchmark");
     benchmarkOptions.add_options()
@@ -207,7 +406,21 @@ main(int argc, char **argv)
         ("NumberOfKeys,n",
          ProgramOptions::value<uint64_t>(&numberOfKeys)->
             default_value(0),
-         "Number of keys to insert into the HashTable (overrides LoadFactor)");
+         "Number of keys to insert into the HashTable (overrides LoadFactor)")
+        ("Resize,r",
+         ProgramOptions::bool_switch(&resize),
+         "Instead of the normal benchmark, report lookup latency percentiles "
+         "while the HashTable is doubled online")
+        ("LookupsPerMigration,l",
+         ProgramOptions::value<uint64_t>(&lookupsPerMigration)->
+            default_value(10),
+         "With --Resize, the number of lookups performed between "
+         "consecutive bucket migrations")
+        ("CompareProbes,c",
+         ProgramOptions::bool_switch(&compareProbes),
+         "Instead of the normal benchmark, compare lookup time using each "
+         "bucket probe implementation (scalar, SSE, AVX2) this machine "
+         "supports");
 
     OptionParser optionParser(benchmarkOptions, argc, argv);
 
@@ -225,6 +438,13 @@ main(int argc, char **argv)
                           static_cast<double>(totalEntries));
     }
 
-    hashTableBenchmark(numberOfKeys, numberOfCachelines);
+    if (resize) {
+        hashTableResizeBenchmark(numberOfKeys, numberOfCachelines,
+                                 lookupsPerMigration);
+    } else if (compareProbes) {
+        hashTableProbeBenchmark(numberOfKeys, numberOfCachelines);
+    } else {
+        hashTableBenchmark(numberOfKeys, numberOfCachelines);
+    }
     return 0;
 }
@@ -13,11 +13,16 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
 #include "ClientException.h"
 #include "Cycles.h"
 #include "Logger.h"
 #include "MasterService.h"
 #include "Memory.h"
+#include "MigrationSender.h"
 #include "SegmentIterator.h"
 #include "Seglet.h"
 #include "Tablets.pb.h"
@@ -56,6 +61,41 @@ class MigrateTabletBenchmark {
         delete service;
     }
 
+    /**
+     * Write small objects to table 1 until \a stop is set, recording the
+     * latency of each write. Used to measure how migration affects
+     * foreground traffic.
+     */
+    void
+    foreground(std::atomic<bool>* stop, std::vector<uint64_t>* latencies)
+    {
+        char value[100];
+        memset(value, 'x', sizeof(value));
+        uint64_t keyVal = 0;
+        while (!*stop) {
+            Key key(1, &keyVal, sizeof(keyVal));
+            Buffer buffer;
+            Object object(key, value, sizeof(value), 0, 0, buffer);
+            uint64_t start = Cycles::rdtsc();
+            service->objectManager.writeObject(object, NULL, NULL);
+            latencies->push_back(Cycles::rdtsc() - start);
+            keyVal = (keyVal + 1) % 10000;
+        }
+    }
+
+    void
+    printLatency(const char* label, std::vector<uint64_t>& latencies)
+    {
+        if (latencies.empty())
+            return;
+        std::sort(latencies.begin(), latencies.end());
+        printf("Foreground write latency %s: median %lu ns, 99th percentile "
+            "%lu ns (%lu writes)\n", label,
+            Cycles::toNanoseconds(latencies[latencies.size() / 2]),
+            Cycles::toNanoseconds(latencies[latencies.size() * 99 / 100]),
+            latencies.size());
+    }
+
     void
     run(int numSegments, int dataLen)
     {
@@ -94,6 +134,18 @@ class MigrateTabletBenchmark {
 
         /* Update the list of Tablets */
         service->tabletManager.addTablet(0, 0, ~0UL, TabletManager::NORMAL);
+        service->tabletManager.addTablet(1, 0, ~0UL, TabletManager::NORMAL);
+
+        // Foreground write latency with no migration running, for
+        // comparison.
+        std::atomic<bool> stop(false);
+        std::vector<uint64_t> idleLatencies;
+        idleLatencies.reserve(1000000);
+        std::thread idleWriter(&MigrateTabletBenchmark::foreground, this,
+                               &stop, &idleLatencies);
+        usleep(200000);
+        stop = true;
+        idleWriter.join();
 
         metrics->temp.ticks0 =
         metrics->temp.ticks1 =
@@ -117,21 +169,27 @@ class MigrateTabletBenchmark {
         metrics->temp.count8 =
         metrics->temp.count9 = 0;
 
-        Tub<Segment> transferSeg{};
+        // Batches are built but not sent, since there is no receiver.
+        MigrationSender sender(&context, ServerId{}, 0, 0lu);
 
         uint64_t entryTotals[TOTAL_LOG_ENTRY_TYPES] = {0};
         uint64_t totalBytes = 0;
 
-        // Now run the send side of a fake migration.
+        // Now run the send side of a fake migration while foreground
+        // writes continue.
+        stop = false;
+        std::vector<uint64_t> migrationLatencies;
+        migrationLatencies.reserve(1000000);
+        std::thread writer(&MigrateTabletBenchmark::foreground, this,
+                           &stop, &migrationLatencies);
         uint64_t before = Cycles::rdtsc();
         for (int i = 0; i < numSegments; i++) {
             Segment* s = segments[i];
             SegmentIterator it{*s};
             while (!it.isDone()) {
                 Status r = service->migrateSingleLogEntry(
-                                it, transferSeg, entryTotals, totalBytes,
-                                0, 0lu, ~0lu,
-                                ServerId{});
+                                it, sender, entryTotals, totalBytes,
+                                0, 0lu, ~0lu);
                 if (r != STATUS_OK) {
                     printf("Catastrophic failure\n");
                     exit(-1);
@@ -139,7 +197,10 @@ class MigrateTabletBenchmark {
                 it.next();
             }
         }
+        sender.flush();
         uint64_t ticks = Cycles::rdtsc() - before;
+        stop = true;
+        writer.join();
 
         uint64_t totalObjectBytes = numObjects * (dataLen + sizeof(nextKeyVal));
         uint64_t totalSegmentBytes = numSegments *
@@ -161,6 +222,9 @@ class MigrateTabletBenchmark {
         double logThroughput = static_cast<double>(totalSegmentBytes) /
                 seconds / 1024. / 1024.;
         printf("Migrate log throughput: %.2f MB/s\n", logThroughput);
+        printf("Migration batches: %lu\n", sender.getBatchesSent());
+        printLatency("without migration", idleLatencies);
+        printLatency("during migration", migrationLatencies);
 
         printf("\n> %d %d %d %lu %lu %lu %lu %.2f %.2f\n\n",
                 numSegments, Segment::DEFAULT_SEGMENT_SIZE, dataLen,
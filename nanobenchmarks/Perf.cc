@@ -1265,14 +1265,19 @@ double getThreadIdSyscall()
 // be enabled to measure its effect. This test is a lot
 // slower than the others (takes several seconds) due to the
 // set up cost, but we really need a large hash table to
-// avoid caching.
-template<int prefetchBucketAhead = 0>
+// avoid caching. The scalar bucket probe can be forced in
+// order to compare it with the default (vectorized) one.
+template<int prefetchBucketAhead = 0, bool scalarProbe = false>
 double hashTableLookup()
 {
     uint64_t numBuckets = 16777216;       // 16M * 64 = 1GB
     uint32_t numLookups = 1000000;
     HashTable hashTable(numBuckets);
     HashTable::Candidates candidates;
+    HashTable::ProbeImplementation probe =
+            HashTable::getProbeImplementation();
+    if (scalarProbe)
+        HashTable::setProbeImplementation(HashTable::PROBE_SCALAR);
 
     // fill with some objects to look up (enough to blow caches)
     for (uint64_t i = 0; i < numLookups; i++) {
@@ -1317,6 +1322,7 @@ double hashTableLookup()
             }
         }
     }
+    HashTable::setProbeImplementation(probe);
 
     return Cycles::toSeconds((stop - start) / numLookups);
 }
@@ -2333,6 +2339,10 @@ TestInfo tests[] = {
      "Key lookup in a 1GB HashTable"},
     {"hashTableLookupPf", hashTableLookup<20>,
      "Key lookup in a 1GB HashTable with prefetching"},
+    {"hashTableLookupScalar", hashTableLookup<0, true>,
+     "hashTableLookup using the scalar bucket probe"},
+    {"hashTableLookupPfScalar", hashTableLookup<20, true>,
+     "hashTableLookupPf using the scalar bucket probe"},
     {"lfence", lfence,
      "Lfence instruction"},
     {"lockInDispThrd", lockInDispThrd,
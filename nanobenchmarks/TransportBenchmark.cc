@@ -0,0 +1,1176 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <queue>
+#include <random>
+
+#include "Common.h"
+#include "BasicTransport.h"
+#include "Buffer.h"
+#include "Cycles.h"
+#include "OptionParser.h"
+#include "Service.h"
+#include "ServiceLocator.h"
+#include "ShortMacros.h"
+#include "UdpDriver.h"
+#include "WorkerManager.h"
+#ifdef XDP
+#include "XdpDriver.h"
+#endif
+
+/**
+ * \file
+ * A single-machine benchmark for transports. It creates a collection of
+ * client and server BasicTransport instances in one process, all driven
+ * by the same dispatch loop, and replays one of the message size
+ * distributions from benchmarks/homa/messageSizeCDFs as symmetric echo
+ * RPCs with Poisson arrivals at a given offered load. Packets travel
+ * over UdpDriver on the loopback interface, over EmulatedDriver, which
+ * models link bandwidth, propagation delay, priority queueing at the
+ * receiver's downlink, and random packet loss, or (in XDP=yes builds)
+ * over XdpDriver between two network interfaces, such as the two ends
+ * of a veth pair.
+ *
+ * At the end it prints, for each message size bucket (deciles of the
+ * distribution), the median, 99th and 99.9th percentile round-trip times
+ * along with the slowdown: the ratio of the round-trip time to that of
+ * an RPC of the same size on an unloaded system.
+ *
+ * Note: in HOMA_BENCHMARK builds WorkerManager casts the service that
+ * handles ECHO to MasterService; this only works because it then
+ * invokes the (virtual) dispatch method.
+ */
+
+namespace RAMCloud {
+
+/**
+ * A Driver that emulates a network inside the process. Each driver is
+ * one host with a full-duplex link to an ideal switch. Packets are
+ * serialized onto the sender's uplink at link speed, spend a fixed
+ * propagation delay in flight, and then queue at the receiver's downlink,
+ * which transmits them in strict priority order (FIFO within a priority),
+ * again at link speed. Packets may also be dropped at random.
+ *
+ * All of the drivers that share a Network must be used from a single
+ * thread.
+ */
+class EmulatedDriver : public Driver {
+  public:
+    /// The maximum number of bytes in a packet.
+    static const uint32_t MAX_PAYLOAD_SIZE = 1400;
+
+    /**
+     * The address of an EmulatedDriver: an index into Network::hosts.
+     */
+    struct EmulatedAddress : public Address {
+        explicit EmulatedAddress(uint32_t host)
+            : host(host) {}
+        EmulatedAddress(const EmulatedAddress& other)
+            : Address(other)
+            , host(other.host) {}
+        string toString() const {
+            return format("emulated:host=%u", host);
+        }
+        uint32_t host;
+      private:
+        void operator=(const EmulatedAddress&);
+    };
+
+    /**
+     * Information shared by all of the drivers in an emulated network.
+     */
+    struct Network {
+        /**
+         * Constructor for Network.
+         * \param mBitsPerSecond
+         *      Speed of every link, in Mbits per second.
+         * \param latencyMicros
+         *      One-way propagation delay between any two hosts.
+         * \param lossRate
+         *      Probability that any given packet is dropped.
+         * \param highestPriority
+         *      Highest packet priority that drivers will honor.
+         * \param seed
+         *      Seed for the random number generator that decides which
+         *      packets to drop.
+         */
+        Network(uint32_t mBitsPerSecond, double latencyMicros,
+                double lossRate, int highestPriority, uint64_t seed)
+            : hosts()
+            , mBitsPerSecond(mBitsPerSecond)
+            , cyclesPerByte(Cycles::perSecond()*8.0
+                    / (mBitsPerSecond*1e06))
+            , latency(Cycles::fromNanoseconds(
+                    static_cast<uint64_t>(latencyMicros*1000)))
+            , lossRate(lossRate)
+            , highestPriority(highestPriority)
+            , generator(seed)
+            , lossDistribution(0.0, 1.0)
+            , nextSequence(0)
+            , packetsSent(0)
+            , packetsDropped(0)
+        {}
+
+        /**
+         * Return the number of cycles needed to transmit a packet
+         * on a link.
+         */
+        uint64_t
+        transmitTime(uint32_t length)
+        {
+            return static_cast<uint64_t>(length*cyclesPerByte);
+        }
+
+        /// All of the drivers in the network, indexed by host number.
+        /// NULL means that the host has been deleted.
+        std::vector<EmulatedDriver*> hosts;
+
+        /// Link speed, in Mbits per second.
+        uint32_t mBitsPerSecond;
+
+        /// Number of Cycles::rdtsc ticks to transmit one byte on a link.
+        double cyclesPerByte;
+
+        /// One-way propagation delay, in Cycles::rdtsc ticks.
+        uint64_t latency;
+
+        /// Probability that any given packet is dropped.
+        double lossRate;
+
+        /// Highest packet priority; higher priorities are ignored.
+        int highestPriority;
+
+        /// Used to decide which packets to drop.
+        std::mt19937_64 generator;
+        std::uniform_real_distribution<double> lossDistribution;
+
+        /// Used to order packets that arrive at the same time.
+        uint64_t nextSequence;
+
+        /// Statistics.
+        uint64_t packetsSent;
+        uint64_t packetsDropped;
+
+        DISALLOW_COPY_AND_ASSIGN(Network);
+    };
+
+    EmulatedDriver(Network* network, uint32_t host);
+    virtual ~EmulatedDriver();
+    virtual uint32_t getBandwidth() { return network->mBitsPerSecond; }
+    virtual int getHighestPacketPriority() { return network->highestPriority; }
+    virtual uint32_t getMaxPacketSize() { return MAX_PAYLOAD_SIZE; }
+    virtual int getTransmitQueueSpace(uint64_t currentTime);
+    virtual void receivePackets(uint32_t maxPackets,
+            std::vector<Received>* receivedPackets);
+    virtual void release(char *payload);
+    virtual void sendPacket(const Address* addr,
+                            const void* header,
+                            uint32_t headerLen,
+                            Buffer::Iterator* payload,
+                            int priority = 0);
+    virtual string getServiceLocator();
+
+    virtual Address* newAddress(const ServiceLocator* serviceLocator) {
+        return new EmulatedAddress(
+                serviceLocator->getOption<uint32_t>("host"));
+    }
+
+  PRIVATE:
+    /**
+     * A packet in flight. The payload is handed to the transport when the
+     * packet is received, and the Packet is deleted when it is released.
+     */
+    struct Packet {
+        Packet(uint32_t sender, int priority, uint64_t arrivalTime,
+                uint64_t sequence)
+            : sender(sender)
+            , priority(priority)
+            , arrivalTime(arrivalTime)
+            , sequence(sequence)
+            , length(0)
+            // No need to initialize payload
+        {}
+
+        /// Address of the sending host.
+        EmulatedAddress sender;
+
+        /// Priority at which the packet was sent.
+        int priority;
+
+        /// Time when the packet reaches the receiver's downlink queue.
+        uint64_t arrivalTime;
+
+        /// Breaks ties between packets with the same arrivalTime.
+        uint64_t sequence;
+
+        /// Number of valid bytes in payload.
+        uint32_t length;
+
+        /// Packet data (may not fill all of the allocated space).
+        char payload[MAX_PAYLOAD_SIZE];
+
+        DISALLOW_COPY_AND_ASSIGN(Packet);
+    };
+
+    /**
+     * Orders the packets in #inbound so that the earliest arrival is
+     * at the top of the heap.
+     */
+    struct ArrivesLater {
+        bool operator()(const Packet* a, const Packet* b) const {
+            if (a->arrivalTime != b->arrivalTime)
+                return a->arrivalTime > b->arrivalTime;
+            return a->sequence > b->sequence;
+        }
+    };
+
+    void enqueue(Packet* packet);
+
+    /// Shared information about the network.
+    Network* network;
+
+    /// Our index in network->hosts.
+    uint32_t host;
+
+    /// Time when our uplink will finish transmitting the packets that
+    /// have been sent so far.
+    uint64_t uplinkFreeTime;
+
+    /// Largest number of bytes that we allow to accumulate in the uplink
+    /// queue (see getTransmitQueueSpace).
+    uint32_t maxTransmitQueueSize;
+
+    /// Packets that have been sent to us but have not yet arrived at our
+    /// downlink queue.
+    std::priority_queue<Packet*, std::vector<Packet*>, ArrivesLater> inbound;
+
+    /// Packets waiting in our downlink queue, one FIFO per priority.
+    std::vector<std::deque<Packet*>> waiting;
+
+    /// The packet currently being transmitted on our downlink, or NULL.
+    Packet* onWire;
+
+    /// Time when the downlink will finish transmitting onWire (or when
+    /// it finished its last transmission, if onWire is NULL).
+    uint64_t downlinkFreeTime;
+
+    DISALLOW_COPY_AND_ASSIGN(EmulatedDriver);
+};
+
+/**
+ * Construct an EmulatedDriver and attach it to a network.
+ *
+ * \param network
+ *      The emulated network that this driver is attached to.
+ * \param host
+ *      Address of this driver; network->hosts[host] will refer to it.
+ */
+EmulatedDriver::EmulatedDriver(Network* network, uint32_t host)
+    : network(network)
+    , host(host)
+    , uplinkFreeTime(0)
+    , maxTransmitQueueSize(0)
+    , inbound()
+    , waiting(network->highestPriority + 1)
+    , onWire(NULL)
+    , downlinkFreeTime(0)
+{
+    // Allow about 2 us of queued data, as UdpDriver does.
+    maxTransmitQueueSize = std::max(2*MAX_PAYLOAD_SIZE,
+            static_cast<uint32_t>(network->mBitsPerSecond*2/8));
+    if (network->hosts.size() <= host)
+        network->hosts.resize(host + 1, NULL);
+    network->hosts[host] = this;
+}
+
+/**
+ * Destructor for EmulatedDriver: discards any packets that haven't been
+ * received yet.
+ */
+EmulatedDriver::~EmulatedDriver()
+{
+    network->hosts[host] = NULL;
+    while (!inbound.empty()) {
+        delete inbound.top();
+        inbound.pop();
+    }
+    for (std::deque<Packet*>& queue : waiting) {
+        for (Packet* packet : queue)
+            delete packet;
+    }
+    delete onWire;
+}
+
+/**
+ * Add a packet that has arrived to the downlink queue for its priority.
+ */
+void
+EmulatedDriver::enqueue(Packet* packet)
+{
+    waiting[packet->priority].push_back(packet);
+}
+
+// See docs in Driver class.
+int
+EmulatedDriver::getTransmitQueueSpace(uint64_t currentTime)
+{
+    uint64_t queued = 0;
+    if (uplinkFreeTime > currentTime) {
+        queued = static_cast<uint64_t>(static_cast<double>(
+                uplinkFreeTime - currentTime)/network->cyclesPerByte);
+    }
+    return static_cast<int>(maxTransmitQueueSize)
+            - static_cast<int>(queued);
+}
+
+// See docs in Driver class.
+void
+EmulatedDriver::receivePackets(uint32_t maxPackets,
+        std::vector<Received>* receivedPackets)
+{
+    uint64_t now = Cycles::rdtsc();
+    uint32_t count = 0;
+    while (count < maxPackets) {
+        if (onWire != NULL) {
+            if (downlinkFreeTime > now)
+                break;
+            receivedPackets->emplace_back(&onWire->sender, this,
+                    onWire->length, onWire->payload);
+            onWire = NULL;
+            count++;
+        }
+
+        // Choose the next packet for the downlink: the highest priority
+        // packet among those that arrived before the link became free
+        // or, if there are none, the next packet to arrive.
+        while (!inbound.empty()
+                && inbound.top()->arrivalTime <= downlinkFreeTime) {
+            enqueue(inbound.top());
+            inbound.pop();
+        }
+        int priority = network->highestPriority;
+        while ((priority >= 0) && waiting[priority].empty())
+            priority--;
+        if (priority < 0) {
+            if (inbound.empty() || (inbound.top()->arrivalTime > now))
+                break;
+            Packet* next = inbound.top();
+            inbound.pop();
+            enqueue(next);
+            priority = next->priority;
+        }
+        onWire = waiting[priority].front();
+        waiting[priority].pop_front();
+        downlinkFreeTime = std::max(downlinkFreeTime, onWire->arrivalTime)
+                + network->transmitTime(onWire->length);
+    }
+}
+
+// See docs in Driver class.
+void
+EmulatedDriver::release(char *payload)
+{
+    delete reinterpret_cast<Packet*>(payload - OFFSET_OF(Packet, payload));
+}
+
+// See docs in Driver class.
+void
+EmulatedDriver::sendPacket(const Address* addr,
+                           const void* header,
+                           uint32_t headerLen,
+                           Buffer::Iterator* payload,
+                           int priority)
+{
+    uint32_t totalLength = headerLen + (payload ? payload->size() : 0);
+    assert(totalLength <= MAX_PAYLOAD_SIZE);
+    uint64_t now = Cycles::rdtsc();
+    uplinkFreeTime = std::max(uplinkFreeTime, now)
+            + network->transmitTime(totalLength);
+    network->packetsSent++;
+
+    EmulatedDriver* recipient = network->hosts.at(
+            static_cast<const EmulatedAddress*>(addr)->host);
+    if ((recipient == NULL) || ((network->lossRate > 0) &&
+            (network->lossDistribution(network->generator)
+            < network->lossRate))) {
+        network->packetsDropped++;
+        return;
+    }
+
+    priority = std::min(std::max(priority, 0), network->highestPriority);
+    Packet* packet = new Packet(host, priority,
+            uplinkFreeTime + network->latency, network->nextSequence++);
+    memcpy(packet->payload, header, headerLen);
+    packet->length = headerLen;
+    while (payload && !payload->isDone()) {
+        memcpy(packet->payload + packet->length, payload->getData(),
+                payload->getLength());
+        packet->length += payload->getLength();
+        payload->next();
+    }
+    recipient->inbound.push(packet);
+}
+
+// See docs in Driver class.
+string
+EmulatedDriver::getServiceLocator()
+{
+    return format("emulated:host=%u", host);
+}
+
+/**
+ * A minimal service that handles the ECHO requests issued by the
+ * benchmark (in place of MasterService, which needs far more machinery).
+ */
+class EchoService : public Service {
+  public:
+    /**
+     * \param message
+     *      Bytes to return in echo responses; must be at least as long
+     *      as the longest echoLength requested.
+     */
+    explicit EchoService(const char* message)
+        : message(message)
+    {}
+
+    void
+    dispatch(WireFormat::Opcode opcode, Rpc* rpc)
+    {
+        switch (opcode) {
+            case WireFormat::Echo::opcode:
+                callHandler<WireFormat::Echo, EchoService,
+                            &EchoService::echo>(rpc);
+                break;
+            default:
+                throw UnimplementedRequestError(HERE);
+        }
+    }
+
+    void
+    echo(const WireFormat::Echo::Request* reqHdr,
+            WireFormat::Echo::Response* respHdr,
+            Rpc* rpc)
+    {
+        respHdr->length = reqHdr->echoLength;
+        rpc->replyPayload->appendExternal(message, respHdr->length);
+    }
+
+    /// Source of the bytes returned in responses.
+    const char* message;
+
+    DISALLOW_COPY_AND_ASSIGN(EchoService);
+};
+
+/**
+ * Values of the command-line options.
+ */
+struct Options {
+    Options()
+        : driver()
+        , interfaces()
+        , messageSizeCDF()
+        , load(0)
+        , seconds(0)
+        , clients(0)
+        , servers(0)
+        , gbps(0)
+        , latencyMicros(0)
+        , lossRate(0)
+        , priorities(0)
+        , maxMessageSize(0)
+        , maxOutstanding(0)
+        , port(0)
+        , seed(0)
+    {}
+
+    string driver;
+    string interfaces;
+    string messageSizeCDF;
+    double load;
+    double seconds;
+    uint32_t clients;
+    uint32_t servers;
+    double gbps;
+    double latencyMicros;
+    double lossRate;
+    int priorities;
+    uint32_t maxMessageSize;
+    uint32_t maxOutstanding;
+    uint32_t port;
+    uint64_t seed;
+};
+
+/**
+ * One outstanding echo RPC, which also serves as its notifier.
+ */
+class WorkloadRpc : public Transport::RpcNotifier {
+  public:
+    WorkloadRpc(std::vector<WorkloadRpc*>* finished, uint32_t size,
+            uint64_t startTime)
+        : request()
+        , response()
+        , finished(finished)
+        , size(size)
+        , startTime(startTime)
+        , endTime(0)
+        , succeeded(false)
+    {}
+
+    void
+    completed()
+    {
+        endTime = Cycles::rdtsc();
+        succeeded = true;
+        finished->push_back(this);
+    }
+
+    void
+    failed()
+    {
+        endTime = Cycles::rdtsc();
+        finished->push_back(this);
+    }
+
+    Buffer request;
+    Buffer response;
+
+    /// The RPC is added here when it completes or fails.
+    std::vector<WorkloadRpc*>* finished;
+
+    /// Size of both the request and response messages, in bytes.
+    uint32_t size;
+
+    /// Time (in Cycles::rdtsc ticks) when the request was sent and when
+    /// the response was received.
+    uint64_t startTime;
+    uint64_t endTime;
+
+    /// True means the RPC completed, false means it failed.
+    bool succeeded;
+
+    DISALLOW_COPY_AND_ASSIGN(WorkloadRpc);
+};
+
+/**
+ * Holds all of the state of a benchmark run.
+ */
+class TransportBenchmark {
+  public:
+    TransportBenchmark(Context* context, const Options* options);
+    ~TransportBenchmark();
+    void calibrate();
+    void run();
+    void report();
+
+  PRIVATE:
+    /**
+     * Round-trip times for the RPCs whose sizes fall in one bucket.
+     */
+    struct Bucket {
+        explicit Bucket(uint32_t maxSize)
+            : maxSize(maxSize)
+            , latencies()
+            , slowdowns()
+        {}
+
+        /// Largest message size in this bucket.
+        uint32_t maxSize;
+
+        /// Round-trip time of each RPC, in microseconds.
+        std::vector<double> latencies;
+
+        /// Slowdown of each RPC.
+        std::vector<double> slowdowns;
+    };
+
+    Transport* createTransport(uint32_t host, string* locator);
+    void readMessageSizes();
+    double idealLatency(uint32_t size);
+    WorkloadRpc* startRpc(uint32_t client, uint32_t server, uint32_t size);
+
+    /// Shared information about the process.
+    Context* context;
+
+    /// Command-line options.
+    const Options* options;
+
+    /// Message sizes from the distribution, and the probability of each.
+    std::vector<uint32_t> messageSizes;
+    std::vector<double> probabilities;
+
+    /// Average message size, in bytes.
+    double averageMessageSize;
+
+    /// Source of request and response contents.
+    string message;
+
+    /// Handles incoming ECHO requests.
+    EchoService service;
+
+    /// Non-NULL when EmulatedDriver is in use.
+    std::unique_ptr<EmulatedDriver::Network> network;
+
+    /// Transports that issue requests, and a session from each one to
+    /// every server.
+    std::vector<Transport*> clients;
+    std::vector<std::vector<Transport::SessionRef>> sessions;
+
+    /// Transports that handle requests.
+    std::vector<Transport*> servers;
+
+    /// Sizes at which the unloaded round-trip time was measured, and the
+    /// minimum round-trip time at each (in microseconds).
+    std::vector<uint32_t> calibrationSizes;
+    std::vector<double> calibrationLatencies;
+
+    /// Results, grouped by deciles of the message size distribution.
+    std::vector<Bucket> buckets;
+
+    /// RPCs that have completed or failed but haven't been processed.
+    std::vector<WorkloadRpc*> finished;
+
+    /// Statistics for the run.
+    uint64_t rpcsStarted;
+    uint64_t rpcsFailed;
+    uint64_t rpcsSkipped;
+    uint64_t bytesEchoed;
+    double elapsedSeconds;
+
+    DISALLOW_COPY_AND_ASSIGN(TransportBenchmark);
+};
+
+/**
+ * Construct a TransportBenchmark: reads the message size distribution
+ * and creates all of the transports.
+ *
+ * \param context
+ *      Overall information about the process; transports are attached
+ *      to its dispatcher.
+ * \param options
+ *      Command-line options.
+ */
+TransportBenchmark::TransportBenchmark(Context* context,
+        const Options* options)
+    : context(context)
+    , options(options)
+    , messageSizes()
+    , probabilities()
+    , averageMessageSize(0)
+    , message()
+    , service(NULL)
+    , network()
+    , clients()
+    , sessions()
+    , servers()
+    , calibrationSizes()
+    , calibrationLatencies()
+    , buckets()
+    , finished()
+    , rpcsStarted(0)
+    , rpcsFailed(0)
+    , rpcsSkipped(0)
+    , bytesEchoed(0)
+    , elapsedSeconds(0)
+{
+    readMessageSizes();
+    message.assign(messageSizes.back(), 'x');
+    service.message = message.data();
+    context->services[WireFormat::MASTER_SERVICE] = &service;
+
+    if (options->driver == "emulated") {
+        network.reset(new EmulatedDriver::Network(
+                static_cast<uint32_t>(options->gbps*1000),
+                options->latencyMicros, options->lossRate,
+                options->priorities - 1, options->seed));
+    }
+
+    std::vector<string> serverLocators;
+    for (uint32_t i = 0; i < options->servers; i++) {
+        string locator;
+        servers.push_back(createTransport(i, &locator));
+        serverLocators.push_back(locator);
+    }
+    for (uint32_t i = 0; i < options->clients; i++) {
+        string locator;
+        clients.push_back(createTransport(options->servers + i, &locator));
+        sessions.emplace_back();
+        for (string& serverLocator : serverLocators) {
+            ServiceLocator sl(serverLocator);
+            sessions.back().push_back(clients.back()->getSession(&sl));
+        }
+    }
+}
+
+/**
+ * Destructor for TransportBenchmark: waits for outstanding RPCs to finish
+ * and deletes all of the transports.
+ */
+TransportBenchmark::~TransportBenchmark()
+{
+    sessions.clear();
+    for (Transport* transport : clients)
+        delete transport;
+    for (Transport* transport : servers)
+        delete transport;
+    for (WorkloadRpc* rpc : finished)
+        delete rpc;
+    context->services[WireFormat::MASTER_SERVICE] = NULL;
+}
+
+/**
+ * Create one BasicTransport, along with its driver.
+ *
+ * \param host
+ *      Index of the transport, unique among all clients and servers.
+ * \param[out] locator
+ *      Filled in with the service locator for the transport.
+ * \return
+ *      The new transport, which must eventually be deleted by the caller.
+ */
+Transport*
+TransportBenchmark::createTransport(uint32_t host, string* locator)
+{
+    // Transports and UdpDriver only accept whole numbers of Gbits/second.
+    uint32_t gbs = std::max(1U, static_cast<uint32_t>(options->gbps + 0.5));
+    Driver* driver;
+    if (network) {
+        *locator = format("basic+emulated:host=%u,gbs=%u", host, gbs);
+        driver = new EmulatedDriver(network.get(), host);
+#ifdef XDP
+    } else if (options->driver == "xdp") {
+        // The server uses the first interface and the client the second.
+        size_t comma = options->interfaces.find(',');
+        string ifName = (host < options->servers)
+                ? options->interfaces.substr(0, comma)
+                : options->interfaces.substr(comma + 1);
+        *locator = format("basic+xdp:ifname=%s,gbs=%u", ifName.c_str(),
+                gbs);
+        ServiceLocator sl(*locator);
+        driver = new XdpDriver(context, &sl);
+#endif
+    } else {
+        *locator = format("basic+udp:host=127.0.0.1,port=%u,gbs=%u",
+                options->port + host, gbs);
+        ServiceLocator sl(*locator);
+        driver = new UdpDriver(context, &sl);
+    }
+    ServiceLocator sl(*locator);
+    Transport* transport = new BasicTransport(context, &sl, driver,
+            host + 1);
+
+    // The driver's own locator includes the address that peers need
+    // (e.g. the MAC address for XdpDriver).
+    *locator = transport->getServiceLocator();
+    return transport;
+}
+
+/**
+ * Read the message size distribution. The file's first line holds the
+ * average message size; each following line holds a size and the
+ * cumulative probability of messages up to that size.
+ */
+void
+TransportBenchmark::readMessageSizes()
+{
+    std::ifstream inFile(options->messageSizeCDF);
+    if (!inFile) {
+        throw Exception(HERE, format("couldn't open message size CDF '%s'",
+                options->messageSizeCDF.c_str()));
+    }
+
+    // Messages must hold at least the request header, and can't exceed
+    // maxMessageSize; sizes outside that range are clamped.
+    uint32_t minSize = sizeof32(WireFormat::Echo::Request);
+    double fileAverage, previous = 0, clamped = 0;
+    uint32_t size;
+    double cumulative;
+    inFile >> fileAverage;
+    while (inFile >> size >> cumulative) {
+        double probability = cumulative - previous;
+        previous = cumulative;
+        if (size > options->maxMessageSize) {
+            clamped += probability;
+            size = options->maxMessageSize;
+        }
+        size = std::max(size, minSize);
+        if (!messageSizes.empty() && (messageSizes.back() == size)) {
+            probabilities.back() += probability;
+        } else {
+            messageSizes.push_back(size);
+            probabilities.push_back(probability);
+        }
+        averageMessageSize += size*probability;
+    }
+    if (messageSizes.empty()) {
+        throw Exception(HERE, format("no message sizes in '%s'",
+                options->messageSizeCDF.c_str()));
+    }
+    if (clamped > 0) {
+        LOG(WARNING, "%.4f%% of messages exceed the %u-byte limit; "
+                "they will be sent at that size", clamped*100,
+                options->maxMessageSize);
+    }
+
+    // Bucket boundaries are the deciles of the distribution (which may
+    // coincide, e.g. if most messages have the same size).
+    double decile = 0.1;
+    double total = 0;
+    for (size_t i = 0; i < messageSizes.size(); i++) {
+        total += probabilities[i];
+        if ((total + 1e-9 >= decile) || (i == messageSizes.size() - 1)) {
+            buckets.emplace_back(messageSizes[i]);
+            while (decile <= total + 1e-9)
+                decile += 0.1;
+        }
+    }
+}
+
+/**
+ * Send an echo request.
+ *
+ * \param client
+ *      Index of the client transport that sends the request.
+ * \param server
+ *      Index of the server that should handle the request.
+ * \param size
+ *      Total size of the request and of the response, in bytes.
+ * \return
+ *      The new RPC; it will be added to #finished once it completes.
+ */
+WorkloadRpc*
+TransportBenchmark::startRpc(uint32_t client, uint32_t server, uint32_t size)
+{
+    WorkloadRpc* rpc = new WorkloadRpc(&finished, size, Cycles::rdtsc());
+    WireFormat::Echo::Request* reqHdr =
+            rpc->request.emplaceAppend<WireFormat::Echo::Request>();
+    memset(reqHdr, 0, sizeof(*reqHdr));
+    reqHdr->common.opcode = WireFormat::Echo::opcode;
+    reqHdr->common.service = WireFormat::Echo::service;
+    reqHdr->length = size;
+    reqHdr->echoLength = size - std::min(size,
+            sizeof32(WireFormat::Echo::Response));
+    rpc->request.appendExternal(message.data(),
+            size - sizeof32(WireFormat::Echo::Request));
+    sessions[client][server]->sendRequest(&rpc->request, &rpc->response,
+            rpc);
+    rpcsStarted++;
+    return rpc;
+}
+
+/**
+ * Measure the round-trip time of RPCs on an unloaded system, for sizes
+ * spanning the distribution; these are used to compute slowdowns.
+ */
+void
+TransportBenchmark::calibrate()
+{
+    for (uint32_t size = messageSizes.front(); ; size *= 2) {
+        size = std::min(size, messageSizes.back());
+        double best = 1e30;
+        for (int i = 0; i < 5; i++) {
+            startRpc(0, 0, size);
+            while (finished.empty())
+                context->dispatch->poll();
+            WorkloadRpc* rpc = finished.back();
+            finished.pop_back();
+            if (rpc->succeeded) {
+                best = std::min(best, Cycles::toSeconds(
+                        rpc->endTime - rpc->startTime)*1e06);
+            }
+            delete rpc;
+        }
+        calibrationSizes.push_back(size);
+        calibrationLatencies.push_back(best);
+        if (size == messageSizes.back())
+            break;
+    }
+    rpcsStarted = 0;
+}
+
+/**
+ * Return the round-trip time for an RPC on an unloaded system, in
+ * microseconds, by interpolating between the calibration measurements.
+ *
+ * \param size
+ *      Size of the request and response messages, in bytes.
+ */
+double
+TransportBenchmark::idealLatency(uint32_t size)
+{
+    size_t i = std::lower_bound(calibrationSizes.begin(),
+            calibrationSizes.end(), size) - calibrationSizes.begin();
+    if (i == 0)
+        return calibrationLatencies[0];
+    if (i == calibrationSizes.size())
+        return calibrationLatencies.back();
+    double fraction = static_cast<double>(size - calibrationSizes[i-1])
+            / (calibrationSizes[i] - calibrationSizes[i-1]);
+    return calibrationLatencies[i-1]
+            + fraction*(calibrationLatencies[i] - calibrationLatencies[i-1]);
+}
+
+/**
+ * Generate RPCs with Poisson arrivals for the length of the run, then wait
+ * for all of them to finish and record their round-trip times.
+ */
+void
+TransportBenchmark::run()
+{
+    // The load is relative to the links on whichever side (clients or
+    // servers) has fewer hosts, since each echo crosses both.
+    double bytesPerSecond = options->gbps*1e09/8
+            * std::min(options->clients, options->servers);
+    double rpcsPerCycle = options->load*bytesPerSecond/averageMessageSize
+            / Cycles::perSecond();
+    LOG(NOTICE, "Average message size %.1f bytes, %.0f RPCs/second",
+            averageMessageSize, rpcsPerCycle*Cycles::perSecond());
+
+    std::mt19937_64 generator(options->seed);
+    std::discrete_distribution<size_t> sizeDistribution(
+            probabilities.begin(), probabilities.end());
+    std::exponential_distribution<double> intervalDistribution(rpcsPerCycle);
+    std::uniform_int_distribution<uint32_t> clientDistribution(0,
+            options->clients - 1);
+    std::uniform_int_distribution<uint32_t> serverDistribution(0,
+            options->servers - 1);
+
+    uint64_t start = Cycles::rdtsc();
+    uint64_t stop = start + Cycles::fromSeconds(options->seconds);
+    uint64_t nextArrival = start;
+    uint64_t outstanding = 0;
+    while (true) {
+        uint64_t now = Cycles::rdtsc();
+        while ((nextArrival <= now) && (nextArrival < stop)) {
+            uint32_t size = messageSizes[sizeDistribution(generator)];
+            if (outstanding < options->maxOutstanding) {
+                startRpc(clientDistribution(generator),
+                        serverDistribution(generator), size);
+                outstanding++;
+            } else {
+                rpcsSkipped++;
+            }
+            nextArrival += static_cast<uint64_t>(
+                    intervalDistribution(generator));
+        }
+        context->dispatch->poll();
+
+        for (WorkloadRpc* rpc : finished) {
+            outstanding--;
+            if (!rpc->succeeded) {
+                rpcsFailed++;
+                delete rpc;
+                continue;
+            }
+            double latency = Cycles::toSeconds(
+                    rpc->endTime - rpc->startTime)*1e06;
+            Bucket* bucket = &buckets.back();
+            for (Bucket& b : buckets) {
+                if (rpc->size <= b.maxSize) {
+                    bucket = &b;
+                    break;
+                }
+            }
+            bucket->latencies.push_back(latency);
+            bucket->slowdowns.push_back(latency/idealLatency(rpc->size));
+            bytesEchoed += rpc->size;
+            delete rpc;
+        }
+        finished.clear();
+        if ((now >= stop) && (outstanding == 0))
+            break;
+    }
+    elapsedSeconds = Cycles::toSeconds(Cycles::rdtsc() - start);
+}
+
+/**
+ * Return the value at a given fraction of the way through a sorted vector.
+ */
+static double
+percentile(const std::vector<double>& sorted, double fraction)
+{
+    if (sorted.empty())
+        return 0;
+    size_t i = static_cast<size_t>(fraction*static_cast<double>(
+            sorted.size()));
+    return sorted[std::min(i, sorted.size() - 1)];
+}
+
+/**
+ * Print the results of the run on standard output.
+ */
+void
+TransportBenchmark::report()
+{
+    printf("# Workload %s, offered load %.2f, %u clients, %u servers, "
+            "%.2f Gbps links, %s driver\n", options->messageSizeCDF.c_str(),
+            options->load, options->clients, options->servers, options->gbps,
+            options->driver.c_str());
+    printf("# %lu RPCs in %.2f seconds (%.2f Gbps echoed), %lu failed, "
+            "%lu skipped (too many outstanding)\n", rpcsStarted,
+            elapsedSeconds, static_cast<double>(bytesEchoed)*8e-09
+            / elapsedSeconds, rpcsFailed, rpcsSkipped);
+    if (rpcsSkipped > 0) {
+        printf("# WARNING: this machine couldn't keep up with the offered "
+                "load; results are unreliable (try a lower --gbps)\n");
+    }
+    if (network) {
+        printf("# %lu packets sent, %lu dropped\n", network->packetsSent,
+                network->packetsDropped);
+    }
+    printf("#%11s %8s %10s %10s %10s %9s %9s\n", "maxSize", "count",
+            "p50(us)", "p99(us)", "p999(us)", "slow50", "slow99");
+    for (Bucket& bucket : buckets) {
+        std::sort(bucket.latencies.begin(), bucket.latencies.end());
+        std::sort(bucket.slowdowns.begin(), bucket.slowdowns.end());
+        printf("%12u %8lu %10.1f %10.1f %10.1f %9.2f %9.2f\n",
+                bucket.maxSize, bucket.latencies.size(),
+                percentile(bucket.latencies, 0.5),
+                percentile(bucket.latencies, 0.99),
+                percentile(bucket.latencies, 0.999),
+                percentile(bucket.slowdowns, 0.5),
+                percentile(bucket.slowdowns, 0.99));
+    }
+    fflush(stdout);
+}
+
+} // namespace RAMCloud
+
+using namespace RAMCloud;
+
+int
+main(int argc, char *argv[])
+try
+{
+    Options options;
+
+    OptionsDescription benchOptions("TransportBenchmark");
+    benchOptions.add_options()
+        ("driver",
+         ProgramOptions::value<string>(&options.driver)->
+            default_value("emulated"),
+         "Driver to use: \"emulated\" (in-process network model), "
+         "\"udp\" (UdpDriver over loopback), or \"xdp\" (XdpDriver; "
+         "needs an XDP=yes build and CAP_NET_ADMIN and CAP_BPF).")
+        ("interfaces",
+         ProgramOptions::value<string>(&options.interfaces)->
+            default_value("veth0,veth1"),
+         "Two network interfaces for the xdp driver, separated by a "
+         "comma; the server uses the first and the client the second. "
+         "Frames sent on one must arrive on the other (e.g. the two ends "
+         "of a veth pair).")
+        ("messageSizeCDF",
+         ProgramOptions::value<string>(&options.messageSizeCDF)->
+            default_value("benchmarks/homa/messageSizeCDFs/W4.txt"),
+         "File containing the message size distribution (see "
+         "benchmarks/homa/messageSizeCDFs).")
+        ("load",
+         ProgramOptions::value<double>(&options.load)->default_value(0.5),
+         "Offered load, as a fraction of link bandwidth.")
+        ("seconds",
+         ProgramOptions::value<double>(&options.seconds)->default_value(10),
+         "How long to generate requests.")
+        ("clients",
+         ProgramOptions::value<uint32_t>(&options.clients)->default_value(4),
+         "Number of client transports.")
+        ("servers",
+         ProgramOptions::value<uint32_t>(&options.servers)->default_value(4),
+         "Number of server transports.")
+        ("gbps",
+         ProgramOptions::value<double>(&options.gbps)->default_value(1),
+         "Link bandwidth in Gbits/second (also passed to the transports). "
+         "All of the transports share one core, so high bandwidths may "
+         "generate more RPCs than the benchmark can keep up with.")
+        ("latency",
+         ProgramOptions::value<double>(&options.latencyMicros)->
+            default_value(1.0),
+         "One-way propagation delay in microseconds (emulated driver).")
+        ("loss",
+         ProgramOptions::value<double>(&options.lossRate)->default_value(0),
+         "Probability that a packet is dropped (emulated driver).")
+        ("priorities",
+         ProgramOptions::value<int>(&options.priorities)->default_value(8),
+         "Number of packet priority levels (emulated driver).")
+        ("maxMessageSize",
+         ProgramOptions::value<uint32_t>(&options.maxMessageSize)->
+            default_value(1 << 23),
+         "Larger messages in the distribution are sent at this size.")
+        ("maxOutstanding",
+         ProgramOptions::value<uint32_t>(&options.maxOutstanding)->
+            default_value(10000),
+         "Requests arriving when this many RPCs are outstanding are "
+         "dropped (and counted) rather than sent.")
+        ("port",
+         ProgramOptions::value<uint32_t>(&options.port)->
+            default_value(12000),
+         "First UDP port to use (udp driver).")
+        ("seed",
+         ProgramOptions::value<uint64_t>(&options.seed)->default_value(1),
+         "Seed for the workload and loss generators.");
+
+    OptionParser optionParser(benchOptions, argc, argv);
+    if ((options.driver != "emulated") && (options.driver != "udp")
+            && (options.driver != "xdp")) {
+        fprintf(stderr, "ERROR: driver must be \"emulated\", \"udp\", "
+                "or \"xdp\"\n");
+        exit(1);
+    }
+    if (options.driver == "xdp") {
+#ifdef XDP
+        // Each interface can hold only one XdpDriver.
+        if ((options.clients != 1) || (options.servers != 1)
+                || (options.interfaces.find(',') == string::npos)) {
+            fprintf(stderr, "ERROR: the xdp driver needs exactly one "
+                    "client, one server, and two interfaces\n");
+            exit(1);
+        }
+#else
+        fprintf(stderr, "ERROR: the xdp driver requires building with "
+                "XDP=yes\n");
+        exit(1);
+#endif
+    }
+    if ((options.clients < 1) || (options.servers < 1)) {
+        fprintf(stderr, "ERROR: need at least one client and server\n");
+        exit(1);
+    }
+    if ((options.load <= 0) || (options.gbps < 0.001)
+            || (options.priorities < 1)) {
+        fprintf(stderr, "ERROR: load, gbps, and priorities must be "
+                "positive\n");
+        exit(1);
+    }
+    if (options.maxMessageSize > Transport::MAX_RPC_LEN - 200) {
+        fprintf(stderr, "ERROR: maxMessageSize must be at most %u\n",
+                Transport::MAX_RPC_LEN - 200);
+        exit(1);
+    }
+
+    Context context(false);
+    context.workerManager = new WorkerManager(&context, 1);
+    {
+        TransportBenchmark benchmark(&context, &options);
+        benchmark.calibrate();
+        benchmark.run();
+        benchmark.report();
+    }
+    return 0;
+} catch (RAMCloud::Exception& e) {
+    fprintf(stderr, "TransportBenchmark: %s\n", e.str().c_str());
+    return 1;
+}
@@ -50,6 +50,8 @@ AbstractLog::AbstractLog(LogEntryHandlers* entryHandlers,
       segmentSize(segmentSize),
       head(NULL),
       appendLock("AbstractLog::appendLock"),
+      copiesInProgress(),
+      copyGeneration(0),
       totalLiveBytes(0),
       maxLiveBytes(0),
       metrics()
@@ -82,7 +84,8 @@ bool
 AbstractLog::append(AppendVector* appends, uint32_t numAppends)
 {
     CycleCounter<uint64_t> _(&metrics.totalAppendTicks);
-    SpinLock::Guard lock(appendLock);
+    Tub<SpinLock::Guard> lock;
+    lock.construct(appendLock);
     metrics.totalAppendCalls++;
 
     uint32_t lengths[numAppends];
@@ -100,12 +103,17 @@ AbstractLog::append(AppendVector* appends, uint32_t numAppends)
     if (!head->hasSpaceFor(lengths, numAppends))
         throw FatalError(HERE, "too much data to append to one segment");
 
+    // Only the space for the entries is allocated while holding the lock;
+    // the (potentially large) entry contents are copied in afterwards, so
+    // that concurrent writers can copy their data in parallel.
     LogSegment* headBefore = head;
+    uint32_t dataOffsets[numAppends];
     for (uint32_t i = 0; i < numAppends; i++) {
-        bool enoughSpace = append(lock,
-                                  appends[i].type,
-                                  appends[i].buffer,
-                                  &appends[i].reference);
+        bool enoughSpace = reserve(*lock,
+                                   appends[i].type,
+                                   lengths[i],
+                                   &appends[i].reference,
+                                   &dataOffsets[i]);
         if (!enoughSpace)
             throw FatalError(HERE, "Guaranteed append managed to fail");
     }
@@ -113,6 +121,14 @@ AbstractLog::append(AppendVector* appends, uint32_t numAppends)
         assert(head == headBefore);
     }
 
+    int generation = copyGeneration;
+    copiesInProgress[generation]++;
+    lock.destroy();
+
+    for (uint32_t i = 0; i < numAppends; i++)
+        headBefore->fillReserved(dataOffsets[i], appends[i].buffer);
+
+    copiesInProgress[generation]--;
     return true;
 }
 
@@ -554,6 +570,76 @@ AbstractLog::append(const SpinLock::Guard& lock,
                   outTickCounter);
 }
 
+/**
+ * Allocate space for a typed entry in the head segment, without copying in
+ * its contents. Apart from not copying the data, this behaves exactly like
+ * the corresponding append() method (including allocating a new head if
+ * needed and updating log statistics). The caller must fill in the entry
+ * with Segment::fillReserved before the head can be synced or closed; see
+ * #copiesInProgress.
+ *
+ * \param lock
+ *      Ensures that the caller holds the monitor lock; not actually used.
+ * \param type
+ *      Type of the entry. See LogEntryTypes.h.
+ * \param length
+ *      Size of the entry's contents in bytes.
+ * \param[out] outReference
+ *      If the reservation succeeds, a reference to the new entry is
+ *      returned here.
+ * \param[out] outDataOffset
+ *      If the reservation succeeds, the offset in the head segment at which
+ *      the entry's contents must be copied is returned here.
+ * \return
+ *      True if the reservation succeeded, false if there was insufficient
+ *      space to complete the operation.
+ */
+bool
+AbstractLog::reserve(const SpinLock::Guard& lock,
+            LogEntryType type,
+            uint32_t length,
+            Reference* outReference,
+            uint32_t* outDataOffset)
+{
+    // This is only possible once after construction.
+    if (head == NULL) {
+        if (!allocNewWritableHead())
+            throw FatalError(HERE, "Could not allocate initial head segment");
+    }
+
+    // Try to reserve. If we can't, try to allocate a new head to get more
+    // space.
+    uint32_t bytesUsedBefore = head->getAppendedLength();
+    bool enoughSpace = head->reserve(type, length, outReference,
+                                     outDataOffset);
+    if (!enoughSpace) {
+        if (!allocNewWritableHead())
+            return false;
+
+        bytesUsedBefore = head->getAppendedLength();
+        if (!head->reserve(type, length, outReference, outDataOffset)) {
+            LOG(ERROR, "Entry too big to append to log: %u bytes of type %d",
+                length, static_cast<int>(type));
+            throw FatalError(HERE, "Entry too big to append to log");
+        }
+    }
+
+    uint32_t lengthWithMetadata = head->getAppendedLength() - bytesUsedBefore;
+
+    // Update log statistics so that the cleaner can make intelligent decisions
+    // when trying to reclaim memory.
+    head->trackNewEntry(type, lengthWithMetadata);
+    if (type == LOG_ENTRY_TYPE_OBJ ||
+        type == LOG_ENTRY_TYPE_RPCRESULT ||
+        type == LOG_ENTRY_TYPE_PREP ||
+        type == LOG_ENTRY_TYPE_TXPLIST)
+        totalLiveBytes += lengthWithMetadata;
+
+    PerfStats::threadStats.logBytesAppended += lengthWithMetadata;
+
+    return true;
+}
+
 /**
  * Allocate a new head segment, changing the ``head'' field. If the allocation
  * succeeds and the allocated segment is writable (that is, not an emergency
@@ -566,6 +652,10 @@ AbstractLog::append(const SpinLock::Guard& lock,
 bool
 AbstractLog::allocNewWritableHead()
 {
+    // The current head is about to be closed; its contents must be complete
+    // before replication of the closed segment begins.
+    waitForAllCopies();
+
     LogSegment* newHead = allocNextSegment(false);
     if (newHead != NULL)
         head = newHead;
@@ -599,4 +689,51 @@ AbstractLog::allocNewWritableHead()
     return true;
 }
 
+/**
+ * Begin a new generation of copiers (see #copiesInProgress). Entries
+ * reserved from now on are counted in the new generation, so the caller
+ * can wait for every entry reserved up to this point to be filled in by
+ * passing the return value to #waitForCopies.
+ *
+ * \param lock
+ *      Ensures that the caller holds the monitor lock; not actually used.
+ * \return
+ *      The generation that was current before this call.
+ */
+int
+AbstractLog::startCopyGeneration(const SpinLock::Guard& lock)
+{
+    int generation = copyGeneration;
+    copyGeneration = 1 - generation;
+    return generation;
+}
+
+/**
+ * Wait until all threads in a given generation of copiers have finished
+ * filling in their entries. This must not be called with appendLock held
+ * unless no new copiers can join the generation (copiers don't need the
+ * lock to finish, so waiting while holding it is safe).
+ *
+ * \param generation
+ *      Value previously returned by #startCopyGeneration.
+ */
+void
+AbstractLog::waitForCopies(int generation)
+{
+    while (copiesInProgress[generation].load() != 0) {
+        /* Spin: copies take at most a few microseconds. */
+    }
+}
+
+/**
+ * Wait until every entry reserved so far has been filled in. This method
+ * must be called with appendLock held (which prevents new reservations).
+ */
+void
+AbstractLog::waitForAllCopies()
+{
+    waitForCopies(0);
+    waitForCopies(1);
+}
+
 } // namespace
@@ -210,7 +210,15 @@ class AbstractLog {
                 Buffer& buffer,
                 Reference* outReference = NULL,
                 uint64_t* outTickCounter = NULL);
+    bool reserve(const SpinLock::Guard& lock,
+                 LogEntryType type,
+                 uint32_t length,
+                 Reference* outReference,
+                 uint32_t* outDataOffset);
     bool allocNewWritableHead();
+    int startCopyGeneration(const SpinLock::Guard& lock);
+    void waitForCopies(int generation);
+    void waitForAllCopies();
 
     /// Various handlers for entries appended to this log. Used to obtain
     /// timestamps and to relocate entries during cleaning.
@@ -248,6 +256,23 @@ class AbstractLog {
     /// segment in the presence of multiple appending threads.
     SpinLock appendLock;
 
+    /// Number of threads currently copying entry contents into space they
+    /// reserved in the head segment while holding appendLock, but that they
+    /// are filling in after releasing it (see append(AppendVector*, uint32_t)).
+    /// The head's length and certificate already include these entries, so
+    /// the head must not be synced or closed until the copies finish.
+    ///
+    /// Copiers are counted separately in one of two generations. A thread
+    /// that needs all copies up to a given point to finish switches new
+    /// copiers to the other generation (see startCopyGeneration) and then
+    /// waits for the old one to drain. This way a steady stream of new
+    /// appends can't starve it.
+    std::atomic<int> copiesInProgress[2];
+
+    /// Index in copiesInProgress of the generation that new copiers join.
+    /// Only modified with appendLock held.
+    int copyGeneration;
+
     // Total amount of log space occupied by long-term data such as
     // objects. Excludes data that can eventually be cleaned, such
     // as tombstones.
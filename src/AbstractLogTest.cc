@@ -320,6 +320,25 @@ TEST_F(AbstractLogTest, allocNewWritableHead) {
     EXPECT_TRUE(ml.metrics.noSpaceTimer);
 }
 
+TEST_F(AbstractLogTest, startCopyGeneration) {
+    SpinLock::Guard lock(l.appendLock);
+    l.copyGeneration = 0;
+    EXPECT_EQ(0, l.startCopyGeneration(lock));
+    EXPECT_EQ(1, l.copyGeneration);
+    EXPECT_EQ(1, l.startCopyGeneration(lock));
+    EXPECT_EQ(0, l.copyGeneration);
+}
+
+TEST_F(AbstractLogTest, waitForCopies) {
+    // Copiers in the current generation must not hold up a wait on the
+    // previous one.
+    l.copiesInProgress[1] = 1;
+    l.waitForCopies(0);
+    l.copiesInProgress[1] = 0;
+    l.waitForCopies(1);
+    l.waitForAllCopies();
+}
+
 TEST_F(AbstractLogTest, getMemoryStats) {
     TestLog::Enable _;
     EXPECT_EQ(37729075lu, l.maxLiveBytes);
@@ -57,13 +57,19 @@ SpinLock BackupMasterRecovery::deletionMutex
  *     The maximum number of replicas and frames to have in memory at any given
  *     point during recovery. This number will determine the size of this
  *     recovery's CyclicReplicaBuffer.
+ * \param builderThreads
+ *     Number of threads to start for constructing recovery segments once
+ *     partitions are known; they build several replicas at the same time
+ *     while the task queue keeps reads from storage flowing. If 0, recovery
+ *     segments are built on the task queue thread.
  */
 BackupMasterRecovery::BackupMasterRecovery(TaskQueue& taskQueue,
                                            uint64_t recoveryId,
                                            ServerId crashedMasterId,
                                            uint32_t segmentSize,
                                            uint32_t readSpeed,
-                                           uint32_t maxReplicasInMemory)
+                                           uint32_t maxReplicasInMemory,
+                                           uint32_t builderThreads)
     : Task(taskQueue)
     , recoveryId(recoveryId)
     , crashedMasterId(crashedMasterId)
@@ -83,6 +89,11 @@ BackupMasterRecovery::BackupMasterRecovery(TaskQueue& taskQueue,
     , buildingStartTicks()
     , testingExtractDigest()
     , testingSkipBuild()
+    , numBuilderThreads(builderThreads)
+    , builders()
+    , buildersShouldExit(false)
+    , builderMutex()
+    , replicasBuffered()
     , destroyer(taskQueue, this)
     , pendingDeletion(false)
 {
@@ -93,6 +104,7 @@ BackupMasterRecovery::BackupMasterRecovery(TaskQueue& taskQueue,
  * distinct task to clean up the BackupMasterRecovery instance.
  */
 BackupMasterRecovery::~BackupMasterRecovery() {
+    stopBuilders();
     LOG(NOTICE, "Freeing recovery state on backup for crashed master %s "
             "(recovery %lu), including %lu filtered replicas",
             crashedMasterId.toString().c_str(), recoveryId,
@@ -257,6 +269,7 @@ BackupMasterRecovery::setPartitionsAndSchedule(
 
     LOG(DEBUG, "Kicked off building recovery segments");
     buildingStartTicks = Cycles::rdtsc();
+    startBuilders();
     schedule();
 }
 
@@ -408,7 +421,9 @@ BackupMasterRecovery::getRecoveryId()
  * bufferNext()) and building the next recovery segment from a previously loaded
  * replica (see buildNext()). Invoked by a task queue in a separate thread from
  * the backup worker thread so building recovery segments is done in the
- * background.
+ * background. If there are builder threads then they do all of the building
+ * and this only keeps the buffer filled, so reads from storage overlap with
+ * filtering.
  */
 void
 BackupMasterRecovery::performTask()
@@ -419,12 +434,79 @@ BackupMasterRecovery::performTask()
             schedule();
     }
 
-    replicaBuffer.bufferNext();
-    replicaBuffer.buildNext();
+    if (builders.empty()) {
+        replicaBuffer.bufferNext();
+        replicaBuffer.buildNext();
+    } else if (replicaBuffer.bufferNext()) {
+        // Taking the lock ensures that a builder can't miss the notification
+        // between checking the buffer and going to sleep.
+        std::lock_guard<std::mutex> lock(builderMutex);
+        replicasBuffered.notify_all();
+    }
 }
 
 // - private -
 
+/**
+ * Start #numBuilderThreads threads running builderMain(). Only called once
+ * partitions are known, since the builders need them to filter replicas.
+ */
+void
+BackupMasterRecovery::startBuilders()
+{
+    for (uint32_t i = 0; i < numBuilderThreads; i++)
+        builders.emplace_back(&BackupMasterRecovery::builderMain, this);
+    if (numBuilderThreads > 0) {
+        LOG(NOTICE, "Started %u threads to build recovery segments for "
+            "crashed master %s", numBuilderThreads,
+            crashedMasterId.toString().c_str());
+    }
+}
+
+/**
+ * Ask all builder threads to exit and wait for them to finish any replica
+ * they are in the middle of filtering.
+ */
+void
+BackupMasterRecovery::stopBuilders()
+{
+    {
+        std::lock_guard<std::mutex> lock(builderMutex);
+        buildersShouldExit = true;
+        replicasBuffered.notify_all();
+    }
+    foreach (auto& builder, builders)
+        builder.join();
+    builders.clear();
+}
+
+/**
+ * Main loop of each builder thread: repeatedly construct recovery segments
+ * for loaded replicas (see CyclicReplicaBuffer::buildNext()) until told to
+ * exit. Several builders run this at once, each claiming a different replica.
+ * When every replica in the buffer has been built, builders sleep until
+ * performTask() buffers another one.
+ */
+void
+BackupMasterRecovery::builderMain()
+{
+    while (!buildersShouldExit) {
+        if (replicaBuffer.buildNext())
+            continue;
+
+        if (replicaBuffer.hasUnbuiltReplicas()) {
+            // Still being read; storage is the bottleneck, so don't spin
+            // too hard waiting for it.
+            usleep(BUILDER_IDLE_USEC);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(builderMutex);
+        while (!buildersShouldExit && !replicaBuffer.hasUnbuiltReplicas())
+            replicasBuffered.wait(lock);
+    }
+}
+
 /**
  * Append replica information and the log digest (if any) to \a responseBuffer
  * and populate \a response with the corresponding details about the
@@ -487,6 +569,7 @@ BackupMasterRecovery::Replica::Replica(const BackupStorage::FrameRef& frame)
     , recoverySegments()
     , recoveryException()
     , built()
+    , building()
     , lastAccessTime(0)
     , refCount(0)
     , fetchCount(0)
@@ -749,8 +832,10 @@ BackupMasterRecovery::CyclicReplicaBuffer::buildNext()
         for (size_t i = 0; i < inMemoryReplicas.size(); i++) {
             size_t idx = (i + oldestReplicaIdx) % inMemoryReplicas.size();
             Replica* candidate = inMemoryReplicas[idx];
-            if (candidate->frame->isLoaded() && !candidate->built) {
+            if (candidate->frame->isLoaded() && !candidate->built &&
+                    !candidate->building) {
                 replicaToBuild = candidate;
+                replicaToBuild->building = true;
                 break;
             }
         }
@@ -767,8 +852,9 @@ BackupMasterRecovery::CyclicReplicaBuffer::buildNext()
     CycleCounter<RawMetric> _(&metrics->backup.filterTicks);
 
     // Recovery segments for this replica data are constructed by splitting data
-    // among them according to #partitions. If we move to multiple worker
-    // threads then replicas will need to be locked for this filtering.
+    // among them according to #partitions. The replica was claimed above by
+    // setting #building, so no other builder thread will touch it until
+    // #built is set.
     std::unique_ptr<Segment[]> recoverySegments(
         new Segment[recovery->numPartitions]);
     uint64_t start = Cycles::rdtsc();
@@ -791,7 +877,9 @@ BackupMasterRecovery::CyclicReplicaBuffer::buildNext()
         replicaToBuild->recoveryException.reset(
             new SegmentRecoveryFailedException(HERE));
         Fence::sfence();
+        SpinLock::Guard lock(mutex);
         replicaToBuild->built = true;
+        replicaToBuild->building = false;
         return true;
     }
 
@@ -802,12 +890,30 @@ BackupMasterRecovery::CyclicReplicaBuffer::buildNext()
         Cycles::toNanoseconds(Cycles::rdtsc() - start) / 1000 / 1000);
     replicaToBuild->recoverySegments = std::move(recoverySegments);
     Fence::sfence();
-    replicaToBuild->built = true;
     replicaToBuild->lastAccessTime = Cycles::rdtsc();
     replicaToBuild->frame->unload();
+    SpinLock::Guard lock(mutex);
+    replicaToBuild->built = true;
+    replicaToBuild->building = false;
     return true;
 }
 
+/**
+ * Returns true if the buffer holds a replica that has neither been built
+ * nor claimed by a call to buildNext(), whether or not it has finished
+ * loading from storage.
+ */
+bool
+BackupMasterRecovery::CyclicReplicaBuffer::hasUnbuiltReplicas()
+{
+    SpinLock::Guard lock(mutex);
+    foreach (Replica* replica, inMemoryReplicas) {
+        if (!replica->built && !replica->building)
+            return true;
+    }
+    return false;
+}
+
 /**
  * Useful for debugging. Prints out the replicas currently in the buffer along
  * with information about whether it is loaded, built, and/or fetched. An arrow
@@ -16,6 +16,9 @@
 #ifndef RAMCLOUD_BACKUPMASTERRECOVERY_H
 #define RAMCLOUD_BACKUPMASTERRECOVERY_H
 
+#include <condition_variable>
+#include <thread>
+
 #include "Common.h"
 #include "BackupStorage.h"
 #include "Log.h"
@@ -72,10 +75,14 @@ class TaskKiller : public Task {
  * 2) Calls to performTask() are serialized.
  * 3) FrameRefs delivered to start() remain valid until destruction.
  *
- * Both primary and secondary replicas are ONLY filtered by the task queue
- * thread serially. The only difference between primary and secondary replicas
- * is that primary replicas are loaded automatically and secondary replicas are
- * not loaded until they are requested.
+ * If the recovery is constructed with builder threads, replicas are filtered
+ * by those threads, several at a time, while the task queue thread only
+ * schedules reads from storage; otherwise the task queue thread filters
+ * replicas itself, one at a time. Either way a replica is filtered by only
+ * one thread at a time (see CyclicReplicaBuffer::buildNext()). The only
+ * difference between primary and secondary replicas is that primary replicas
+ * are loaded automatically and secondary replicas are not loaded until they
+ * are requested.
  *
  * The number of replicas in memory at any given time is limited to prevent
  * out-of-memory errors. In the case of extreme speed differences between
@@ -99,7 +106,8 @@ class BackupMasterRecovery : public Task {
                          ServerId crashedMasterId,
                          uint32_t segmentSize,
                          uint32_t readSpeed,
-                         uint32_t maxReplicasInMemory);
+                         uint32_t maxReplicasInMemory,
+                         uint32_t builderThreads = 0);
     ~BackupMasterRecovery();
     void start(const std::vector<BackupStorage::FrameRef>& frames,
                Buffer* buffer,
@@ -119,6 +127,9 @@ class BackupMasterRecovery : public Task {
                                StartResponse* response);
     struct Replica;
     bool getLogDigest(Replica& replica, Buffer* digestBuffer);
+    void startBuilders();
+    void stopBuilders();
+    void builderMain();
 
     /**
      * Which master recovery this is for. The coordinator may schedule
@@ -169,9 +180,11 @@ class BackupMasterRecovery : public Task {
      * an attempt to reduce surprises. Once the replica has been filtered
      * either #recoverySegments or #recoveryException is populated.
      * Concurrency on these replicas is hairy. Both primary and secondary
-     * replicas are ALWAYS filtered by the task queue thread. There is only
-     * locking when a replica's access data is being altered by
-     * CyclicReplicaBuffer; once #built is set the backup worker thread can
+     * replicas are filtered either by the task queue thread or by one of the
+     * builder threads (never by more than one thread at once; see
+     * #building). There is only locking when a replica's access data is
+     * being altered by CyclicReplicaBuffer; once #built is set the backup
+     * worker thread can
      * safely check #recoverySegments and #recoveryException (after an lfence,
      * which it does ONLY in BackupMasterRecovery::getRecoverySegment()).
      */
@@ -227,6 +240,13 @@ class BackupMasterRecovery : public Task {
          */
         bool built;
 
+        /**
+         * Set while some thread is constructing the recovery segments for
+         * this replica, so that other builder threads skip it. Only read
+         * or written while holding CyclicReplicaBuffer::mutex.
+         */
+        bool building;
+
         /**
          * Used by CyclicReplicaBuffer to keep track of the last time
          * information from this replica was sent to a recovery master. See
@@ -315,6 +335,7 @@ class BackupMasterRecovery : public Task {
         void enqueue(Replica* replica, Priority priority);
         bool bufferNext();
         bool buildNext();
+        bool hasUnbuiltReplicas();
 
         void logState();
 
@@ -474,6 +495,44 @@ class BackupMasterRecovery : public Task {
      */
     bool testingSkipBuild;
 
+    /**
+     * Number of threads to dedicate to constructing recovery segments once
+     * partitions are known. If 0, the task queue thread builds recovery
+     * segments itself, one replica at a time, in between scheduling reads.
+     */
+    uint32_t numBuilderThreads;
+
+    /**
+     * Threads that run builderMain() to construct recovery segments for many
+     * replicas at the same time. Started by setPartitionsAndSchedule() and
+     * joined in the destructor.
+     */
+    std::vector<std::thread> builders;
+
+    /**
+     * Set to tell the threads in #builders to exit.
+     */
+    std::atomic<bool> buildersShouldExit;
+
+    /**
+     * Used with #replicasBuffered to put idle builder threads to sleep.
+     */
+    std::mutex builderMutex;
+
+    /**
+     * Notified when a replica is added to #replicaBuffer and when builder
+     * threads are told to exit. Builder threads wait on this when every
+     * replica in the buffer has been built, so they don't use any CPU
+     * once a recovery has built everything it has read.
+     */
+    std::condition_variable replicasBuffered;
+
+    /**
+     * How long a builder thread sleeps when the replicas in the buffer that
+     * are waiting to be filtered are still being read from storage.
+     */
+    static const uint32_t BUILDER_IDLE_USEC = 100;
+
     /**
      * The Task that is scheduled to delete this BackupMasterRecovery when it
      * is no longer needed.
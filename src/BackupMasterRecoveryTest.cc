@@ -392,6 +392,33 @@ TEST_F(BackupMasterRecoveryTest, performTask) {
     TestLog::reset();
 }
 
+TEST_F(BackupMasterRecoveryTest, performTask_builderThreads) {
+    recovery.construct(taskQueue, 456lu, ServerId{99, 0},
+                       segmentSize, readSpeed, maxReplicasInMemory, 2);
+    mockMetadata(88, true, true);
+    mockMetadata(89, true, true);
+    recovery->testingSkipBuild = true;
+    recovery->start(frames, NULL, NULL);
+    recovery->setPartitionsAndSchedule(partitions);
+    EXPECT_EQ(2u, recovery->builders.size());
+
+    // The task queue only loads replicas; the builders filter them.
+    taskQueue.performTask();
+    taskQueue.performTask();
+    for (int i = 0; i < 1000; i++) {
+        Fence::lfence();
+        if (recovery->replicas.at(0).built && recovery->replicas.at(1).built)
+            break;
+        usleep(1000);
+    }
+    EXPECT_TRUE(recovery->replicas.at(0).built);
+    EXPECT_TRUE(recovery->replicas.at(1).built);
+    EXPECT_EQ(STATUS_OK, recovery->getRecoverySegment(456, 89, 0, NULL, NULL));
+
+    recovery->stopBuilders();
+    EXPECT_EQ(0u, recovery->builders.size());
+}
+
 TEST_F(BackupMasterRecoveryTest, CyclicReplicaBuffer_enqueue) {
     BackupMasterRecovery::CyclicReplicaBuffer* replicaBuffer =
         &recovery->replicaBuffer;
@@ -512,6 +539,39 @@ TEST_F(BackupMasterRecoveryTest, CyclicReplicaBuffer_buildNext) {
     TestLog::reset();
 }
 
+TEST_F(BackupMasterRecoveryTest, CyclicReplicaBuffer_buildNext_claimed) {
+    mockMetadata(88, true, true);
+    recovery->testingSkipBuild = true;
+    recovery->start(frames, NULL, NULL);
+    recovery->replicaBuffer.bufferNext();
+
+    // Another builder thread has already claimed the only loaded replica.
+    recovery->replicas.at(0).building = true;
+    EXPECT_FALSE(recovery->replicaBuffer.buildNext());
+    EXPECT_FALSE(recovery->replicas.at(0).built);
+
+    recovery->replicas.at(0).building = false;
+    EXPECT_TRUE(recovery->replicaBuffer.buildNext());
+    EXPECT_TRUE(recovery->replicas.at(0).built);
+    EXPECT_FALSE(recovery->replicas.at(0).building);
+}
+
+TEST_F(BackupMasterRecoveryTest, CyclicReplicaBuffer_hasUnbuiltReplicas) {
+    mockMetadata(88, true, true);
+    recovery->testingSkipBuild = true;
+    recovery->start(frames, NULL, NULL);
+    EXPECT_FALSE(recovery->replicaBuffer.hasUnbuiltReplicas());
+    recovery->replicaBuffer.bufferNext();
+    EXPECT_TRUE(recovery->replicaBuffer.hasUnbuiltReplicas());
+
+    recovery->replicas.at(0).building = true;
+    EXPECT_FALSE(recovery->replicaBuffer.hasUnbuiltReplicas());
+    recovery->replicas.at(0).building = false;
+
+    recovery->replicaBuffer.buildNext();
+    EXPECT_FALSE(recovery->replicaBuffer.hasUnbuiltReplicas());
+}
+
 TEST_F(BackupMasterRecoveryTest, buildRecoverySegments_buildThrows) {
     mockMetadata(88, true, true);
     recovery->start(frames, NULL, NULL);
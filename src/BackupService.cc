@@ -18,6 +18,7 @@
 #include "ClientException.h"
 #include "Cycles.h"
 #include "InMemoryStorage.h"
+#include "IoUringStorage.h"
 #include "PerfStats.h"
 #include "ServerConfig.h"
 #include "ShortMacros.h"
@@ -73,12 +74,28 @@ BackupService::BackupService(Context* context,
             maxWriteBuffers = config->backup.numSegmentFrames;
         }
 
-        storage.reset(new MultiFileStorage(config->segmentSize,
-                                           config->backup.numSegmentFrames,
-                                           config->backup.writeRateLimit,
-                                           maxWriteBuffers,
-                                           config->backup.file.c_str(),
-                                           O_DIRECT | O_SYNC));
+        if (config->backup.ioUringThreads > 0) {
+            try {
+                storage.reset(new IoUringStorage(config->segmentSize,
+                        config->backup.numSegmentFrames,
+                        config->backup.writeRateLimit,
+                        maxWriteBuffers,
+                        config->backup.file.c_str(),
+                        O_DIRECT | O_SYNC,
+                        config->backup.ioUringThreads));
+            } catch (const IoUringException& e) {
+                LOG(WARNING, "Couldn't use io_uring for backup storage, "
+                    "falling back to POSIX aio: %s", e.what());
+            }
+        }
+        if (!storage) {
+            storage.reset(new MultiFileStorage(config->segmentSize,
+                                               config->backup.numSegmentFrames,
+                                               config->backup.writeRateLimit,
+                                               maxWriteBuffers,
+                                               config->backup.file.c_str(),
+                                               O_DIRECT | O_SYNC));
+        }
     }
     if (storage->getMetadataSize() < sizeof(BackupReplicaMetadata))
         DIE("Storage metadata block too small to hold BackupReplicaMetadata");
@@ -474,12 +491,10 @@ BackupService::startReadingData(
     }
     BackupMasterRecovery* recovery;
     if (mustCreateRecovery) {
-        recovery = new BackupMasterRecovery(taskQueue,
-                                            reqHdr->recoveryId,
-                                            crashedMasterId,
-                                            segmentSize,
-                                            readSpeed,
-                                            config->backup.maxRecoveryReplicas);
+        recovery = new BackupMasterRecovery(taskQueue, reqHdr->recoveryId,
+                crashedMasterId, segmentSize, readSpeed,
+                config->backup.maxRecoveryReplicas,
+                config->backup.recoveryBuilderThreads);
         recoveries[crashedMasterId] = recovery;
     }
     recovery = recoveries[crashedMasterId];
@@ -15,6 +15,7 @@
 #include <algorithm>
 
 #include "BasicTransport.h"
+#include "BitOps.h"
 #include "Service.h"
 #include "ServiceLocator.h"
 #include "TimeTrace.h"
@@ -73,9 +74,16 @@ BasicTransport::BasicTransport(Context* context, const ServiceLocator* locator,
     , outgoingRequests()
     , incomingRpcs()
     , outgoingResponses()
+    , drainingResponses()
     , serverTimerList()
     , roundTripBytes(getRoundTripBytes(locator))
     , grantIncrement(5*maxDataPerPacket)
+    , grantableMessages()
+    , maxGrantedMessages(0)
+    , highestPriority(driver->getHighestPacketPriority())
+    , lowestUnscheduledPriority(0)
+    , unscheduledCutoffs()
+    , messageSizeCounts()
     , timerInterval(0)
     , nextTimeoutCheck(0)
     , timeoutCheckDeadline(0)
@@ -95,12 +103,38 @@ BasicTransport::BasicTransport(Context* context, const ServiceLocator* locator,
     timerInterval = Cycles::fromMicroseconds(2000);
     nextTimeoutCheck = Cycles::rdtsc() + timerInterval;
 
+    // Split the driver's priorities in half: the upper half is used
+    // for unscheduled bytes and the lower half for scheduled bytes. Until
+    // we have measured some message sizes, all unscheduled bytes use the
+    // highest priority.
+    lowestUnscheduledPriority = (highestPriority + 1)/2;
+    unscheduledCutoffs.resize(highestPriority - lowestUnscheduledPriority + 1,
+            ~0u);
+
+    // By default, grant to one message for each scheduled priority, but
+    // always to at least two, so that a new message can ramp up while the
+    // current one finishes.
+    maxGrantedMessages = std::max(lowestUnscheduledPriority, 2);
+    if ((locator != NULL) && locator->hasOption("overcommit")) {
+        char* end;
+        uint32_t value = downCast<uint32_t>(strtoul(
+                locator->getOption("overcommit").c_str(), &end, 10));
+        if ((*end == 0) && (value != 0)) {
+            maxGrantedMessages = value;
+        } else {
+            LOG(ERROR, "Bad BasicTransport overcommit option value '%s' "
+                    "(expected positive integer); ignoring option",
+                    locator->getOption("overcommit").c_str());
+        }
+    }
+
     LOG(NOTICE, "BasicTransport parameters: maxDataPerPacket %u, "
-            "roundTripBytes %u, grantIncrement %u, pingIntervals %d, "
-            "timeoutIntervals %d, timerInterval %.2f ms",
-            maxDataPerPacket, roundTripBytes,
-            grantIncrement, pingIntervals, timeoutIntervals,
-            Cycles::toSeconds(timerInterval)*1e3);
+            "roundTripBytes %u, grantIncrement %u, maxGrantedMessages %u, "
+            "highestPriority %d, pingIntervals %d, timeoutIntervals %d, "
+            "timerInterval %.2f ms",
+            maxDataPerPacket, roundTripBytes, grantIncrement,
+            maxGrantedMessages, highestPriority, pingIntervals,
+            timeoutIntervals, Cycles::toSeconds(timerInterval)*1e3);
 }
 
 /**
@@ -121,6 +155,11 @@ BasicTransport::~BasicTransport()
         it++;
         deleteServerRpc(serverRpc);
     }
+    while (!drainingResponses.empty()) {
+        ServerRpc* serverRpc = &drainingResponses.front();
+        drainingResponses.pop_front();
+        serverRpcPool.destroy(serverRpc);
+    }
     for (ClientRpcMap::iterator it = outgoingRpcs.begin();
             it != outgoingRpcs.end(); it++) {
         ClientRpc* clientRpc = it->second;
@@ -155,6 +194,7 @@ BasicTransport::deleteClientRpc(ClientRpc* clientRpc)
     if (clientRpc->transmitPending) {
         erase(outgoingRequests, *clientRpc);
     }
+    unscheduleMessage(&clientRpc->scheduledMessage);
     clientRpcPool.destroy(clientRpc);
 }
 
@@ -181,9 +221,61 @@ BasicTransport::deleteServerRpc(ServerRpc* serverRpc)
     if (serverRpc->sendingResponse || !serverRpc->requestComplete) {
         erase(serverTimerList, *serverRpc);
     }
+    unscheduleMessage(&serverRpc->scheduledMessage);
     serverRpcPool.destroy(serverRpc);
 }
 
+/**
+ * Delete server RPCs in drainingResponses whose responses the driver
+ * has finished transmitting. Once this happens, the driver no longer
+ * references the response buffers, so any log memory they point to
+ * can safely be reclaimed.
+ */
+void
+BasicTransport::destroyDrainedResponses()
+{
+    while (!drainingResponses.empty()) {
+        ServerRpc* serverRpc = &drainingResponses.front();
+        if (!driver->isTransmitComplete(serverRpc->transmitMark)) {
+            break;
+        }
+        TEST_LOG("RpcId (%lu, %lu)", serverRpc->rpcId.clientId,
+                serverRpc->rpcId.sequence);
+        drainingResponses.pop_front();
+        serverRpcPool.destroy(serverRpc);
+    }
+}
+
+/**
+ * This method is invoked once the last byte of a response has been passed
+ * to the driver. The RPC is removed from all of the transport's active
+ * structures, but if the driver may still be transmitting from the
+ * response buffer (which often refers directly to log memory), the
+ * ServerRpc object is kept alive in drainingResponses until the driver
+ * is done. Keeping it allocated from serverRpcPool prevents LogProtector
+ * from allowing the cleaner to free that memory in the meantime.
+ *
+ * \param serverRpc
+ *      An RPC whose response has been completely passed to the driver.
+ */
+void
+BasicTransport::finishResponse(ServerRpc* serverRpc)
+{
+    uint64_t mark = driver->getTransmitMark();
+    if (drainingResponses.empty() && driver->isTransmitComplete(mark)) {
+        deleteServerRpc(serverRpc);
+        return;
+    }
+    timeTrace("server RPC %u waiting for driver transmit",
+            downCast<uint32_t>(serverRpc->rpcId.sequence));
+    incomingRpcs.erase(serverRpc->rpcId);
+    erase(outgoingResponses, *serverRpc);
+    erase(serverTimerList, *serverRpc);
+    serverRpc->sendingResponse = false;
+    serverRpc->transmitMark = mark;
+    drainingResponses.push_back(*serverRpc);
+}
+
 /**
  * Parse option values in a service locator to determine how many bytes
  * of data must be sent to cover the round-trip latency of a connection.
@@ -241,6 +333,27 @@ BasicTransport::getRoundTripBytes(const ServiceLocator* locator)
     return roundTripBytes;
 }
 
+/**
+ * Returns the network priority to use for the unscheduled bytes of an
+ * outgoing message (those sent before any GRANT is received). Shorter
+ * messages get higher priorities.
+ *
+ * \param messageLength
+ *      Total number of bytes in the message.
+ */
+int
+BasicTransport::getUnscheduledPriority(uint32_t messageLength)
+{
+    int priority = highestPriority;
+    for (uint32_t cutoff : unscheduledCutoffs) {
+        if (messageLength <= cutoff) {
+            break;
+        }
+        priority--;
+    }
+    return priority;
+}
+
 /**
  * Return a printable symbol for the opcode field from a packet.
  * \param opcode
@@ -291,6 +404,10 @@ BasicTransport::opcodeSymbol(uint8_t opcode) {
  *      Extra flags to set in packet headers, such as FROM_CLIENT or
  *      RETRANSMISSION. Must at least specify either FROM_CLIENT or
  *      FROM_SERVER.
+ * \param scheduledPriority
+ *      Network priority for bytes beyond the first roundTripBytes of the
+ *      message (normally from the most recent GRANT). Earlier bytes use a
+ *      priority determined by the message length.
  * \param partialOK
  *      Normally, a partial packet will get sent only if it's the last
  *      packet in the message. However, if this parameter is true then
@@ -302,9 +419,10 @@ BasicTransport::opcodeSymbol(uint8_t opcode) {
 uint32_t
 BasicTransport::sendBytes(const Driver::Address* address, RpcId rpcId,
         Buffer* message, uint32_t offset, uint32_t maxBytes,
-        uint8_t flags, bool partialOK)
+        uint8_t flags, int scheduledPriority, bool partialOK)
 {
     uint32_t messageSize = message->size();
+    int unscheduledPriority = getUnscheduledPriority(messageSize);
 
     uint32_t curOffset = offset;
     uint32_t bytesSent = 0;
@@ -319,15 +437,17 @@ BasicTransport::sendBytes(const Driver::Address* address, RpcId rpcId,
             }
             bytesThisPacket = maxBytes - bytesSent;
         }
+        int priority = (curOffset < roundTripBytes) ? unscheduledPriority
+                : scheduledPriority;
         if (bytesThisPacket == messageSize) {
             // Entire message fits in a single packet.
             AllDataHeader header(rpcId, flags, downCast<uint16_t>(messageSize));
             Buffer::Iterator iter(message, 0, messageSize);
-            driver->sendPacket(address, &header, &iter);
+            driver->sendPacket(address, &header, &iter, priority);
         } else {
             DataHeader header(rpcId, message->size(), curOffset, flags);
             Buffer::Iterator iter(message, curOffset, bytesThisPacket);
-            driver->sendPacket(address, &header, &iter);
+            driver->sendPacket(address, &header, &iter, priority);
         }
         bytesSent += bytesThisPacket;
         curOffset += bytesThisPacket;
@@ -395,7 +515,8 @@ BasicTransport::headerToString(const void* packet, uint32_t packetLength)
             }
             const BasicTransport::GrantHeader* grant =
                     static_cast<const BasicTransport::GrantHeader*>(packet);
-            result += format(", offset %u", grant->offset);
+            result += format(", offset %u, priority %u", grant->offset,
+                    grant->priority);
             break;
         }
         case BasicTransport::PacketOpcode::LOG_TIME_TRACE:
@@ -458,6 +579,13 @@ BasicTransport::tryToTransmitData()
     uint32_t transmitQueueSpace = static_cast<uint32_t>(std::max(0,
             driver->getTransmitQueueSpace(context->dispatch->currentTime)));
     uint32_t maxBytes;
+    if (transmitQueueSpace < maxDataPerPacket) {
+        return 0;
+    }
+
+    // Let the driver queue up all of the packets from the loop below and
+    // hand them to the NIC together (e.g. in a single kernel call).
+    driver->startTransmitBatch();
 
     // Each iteration of the following loop transmits data packets for
     // a single request or response.
@@ -527,7 +655,8 @@ BasicTransport::tryToTransmitData()
                     clientRpc->session->serverAddress,
                     RpcId(clientId, clientRpc->sequence),
                     clientRpc->request, clientRpc->transmitOffset,
-                    maxBytes, FROM_CLIENT|clientRpc->needGrantFlag);
+                    maxBytes, FROM_CLIENT|clientRpc->needGrantFlag,
+                    clientRpc->scheduledPriority);
             assert(bytesSent > 0);     // Otherwise, infinite loop.
             clientRpc->transmitOffset += bytesSent;
             clientRpc->lastTransmitTime = Cycles::rdtsc();
@@ -545,18 +674,19 @@ BasicTransport::tryToTransmitData()
             int bytesSent = sendBytes(serverRpc->clientAddress,
                     serverRpc->rpcId, &serverRpc->replyPayload,
                     serverRpc->transmitOffset, maxBytes,
-                    FROM_SERVER|serverRpc->needGrantFlag);
+                    FROM_SERVER|serverRpc->needGrantFlag,
+                    serverRpc->scheduledPriority);
             assert(bytesSent > 0);     // Otherwise, infinite loop.
             serverRpc->transmitOffset += bytesSent;
             serverRpc->lastTransmitTime = Cycles::rdtsc();
             transmitQueueSpace -= bytesSent;
             if (serverRpc->transmitOffset >= serverRpc->replyPayload.size()) {
-                // Delete the ServerRpc object as soon as we have transmitted
+                // Retire the ServerRpc object as soon as we have transmitted
                 // the last byte. This has the disadvantage that if some of
                 // this data is lost we won't be able to retransmit it (the
                 // whole RPC will be retried). However, this approach is
                 // simpler and faster in the common case where data isn't lost.
-                deleteServerRpc(serverRpc);
+                finishResponse(serverRpc);
             }
         } else {
             // There are no messages with data that can be transmitted.
@@ -564,9 +694,207 @@ BasicTransport::tryToTransmitData()
         }
     }
 
+    driver->flushTransmitBatch();
     return result;
 }
 
+/**
+ * Record the length of a message sent or received by this transport;
+ * the distribution of these lengths determines the priorities used for
+ * unscheduled bytes.
+ *
+ * \param messageLength
+ *      Total number of bytes in the message.
+ */
+void
+BasicTransport::recordMessageSize(uint32_t messageLength)
+{
+    int bucket = (messageLength <= 1) ? 0
+            : BitOps::findLastSet(messageLength - 1);
+    messageSizeCounts[bucket]++;
+}
+
+/**
+ * Decide which incoming messages should receive GRANTs, and issue any
+ * GRANTs that are needed. The maxGrantedMessages messages with the fewest
+ * bytes remaining are each kept granted about a round trip's worth of
+ * data ahead of what has been received; longer messages wait until they
+ * reach the front of the line. Each granted message is also told which
+ * scheduled priority to use, with shorter messages getting higher
+ * priorities.
+ *
+ * \param message
+ *      A message that has just received data (or was just created), so
+ *      its position in grantableMessages may need to change. NULL means
+ *      no message has received data (e.g., one was just removed).
+ */
+void
+BasicTransport::scheduleGrants(ScheduledMessage* message)
+{
+    if (message != NULL) {
+        erase(grantableMessages, *message);
+        uint32_t remaining = message->bytesRemaining();
+        ScheduledMessageList::iterator it = grantableMessages.begin();
+        while ((it != grantableMessages.end())
+                && (it->bytesRemaining() <= remaining)) {
+            it++;
+        }
+        grantableMessages.insert(it, *message);
+    }
+
+    // If fewer messages are active than there are scheduled priorities,
+    // use the lowest ones; this leaves higher priorities free for shorter
+    // messages that arrive later.
+    int numActive = downCast<int>(std::min(maxGrantedMessages,
+            downCast<uint32_t>(grantableMessages.size())));
+    int levels = std::min(numActive, std::max(lowestUnscheduledPriority, 1));
+    int rank = 0;
+    for (ScheduledMessageList::iterator it = grantableMessages.begin();
+            it != grantableMessages.end(); it++, rank++) {
+        ScheduledMessage* granted = &(*it);
+        if (rank >= numActive) {
+            granted->active = false;
+            continue;
+        }
+        granted->active = true;
+        int priority = std::max(levels - 1 - rank, 0);
+        uint32_t received = granted->buffer->size();
+        if ((granted->grantOffset < (received + roundTripBytes))
+                && (granted->grantOffset < granted->totalLength)) {
+            granted->grantOffset = received + roundTripBytes
+                    + grantIncrement;
+            granted->priority = priority;
+            sendGrant(granted);
+        } else if ((priority != granted->priority)
+                && (granted->grantOffset > received)
+                && (granted->grantOffset < granted->totalLength)) {
+            // The message's rank has changed; the sender should use the
+            // new priority for the rest of the granted bytes. Once the
+            // whole message has been granted, the remaining packets are
+            // already on their way, so don't bother.
+            granted->priority = priority;
+            sendGrant(granted);
+        }
+    }
+}
+
+/**
+ * This method is invoked periodically for an incoming message that isn't
+ * currently being granted. It sends a zero-length RESEND request at the
+ * message's grantOffset: this restates the grant (in case a GRANT packet
+ * was lost), lets the sender know that we're still alive, and causes the
+ * sender to return an ACK, so we can tell whether the sender is still
+ * alive.
+ *
+ * \param message
+ *      The message waiting for GRANTs.
+ */
+void
+BasicTransport::pingSender(ScheduledMessage* message)
+{
+    timeTrace("sending RESEND ping, sequence %u, offset %u",
+            downCast<uint32_t>(message->rpcId.sequence),
+            message->grantOffset);
+    ResendHeader resend(message->rpcId, message->grantOffset, 0,
+            message->whoFrom);
+    driver->sendPacket(message->senderAddress, &resend, NULL,
+            highestPriority);
+}
+
+/**
+ * Send a GRANT packet describing the current grantOffset and priority
+ * for an incoming message.
+ *
+ * \param message
+ *      The message to which the GRANT pertains.
+ */
+void
+BasicTransport::sendGrant(ScheduledMessage* message)
+{
+    timeTrace("sending GRANT, sequence %u, offset %u, priority %u",
+            downCast<uint32_t>(message->rpcId.sequence),
+            message->grantOffset, message->priority);
+    GrantHeader grant(message->rpcId, message->grantOffset, message->whoFrom,
+            downCast<uint8_t>(message->priority));
+    driver->sendPacket(message->senderAddress, &grant, NULL,
+            highestPriority);
+}
+
+/**
+ * This method is invoked when an incoming message no longer needs GRANTs
+ * (because it is complete or its RPC is being deleted). It removes the
+ * message from the scheduler and, if the message was being granted,
+ * passes its share of GRANTs on to the next message in line.
+ *
+ * \param message
+ *      Scheduling state for the message; may be empty, in which case
+ *      this method does nothing.
+ */
+void
+BasicTransport::unscheduleMessage(Tub<ScheduledMessage>* message)
+{
+    if (!*message) {
+        return;
+    }
+    bool active = (*message)->active;
+    message->destroy();
+    if (active) {
+        scheduleGrants(NULL);
+    }
+}
+
+/**
+ * Recompute unscheduledCutoffs from the distribution of message sizes
+ * recorded by recordMessageSize. The cutoffs are chosen so that each
+ * unscheduled priority carries roughly the same number of unscheduled
+ * bytes, with the shortest messages at the highest priority. This
+ * method is invoked periodically by checkTimeouts.
+ */
+void
+BasicTransport::updateUnscheduledCutoffs()
+{
+    uint32_t levels = downCast<uint32_t>(unscheduledCutoffs.size());
+    if (levels <= 1) {
+        return;
+    }
+    const int numBuckets = static_cast<int>(arrayLength(messageSizeCounts));
+
+    // Only the first roundTripBytes of each message are unscheduled.
+    uint64_t totalBytes = 0;
+    uint64_t totalMessages = 0;
+    for (int i = 0; i < numBuckets; i++) {
+        totalBytes += messageSizeCounts[i]
+                * std::min(1lu << i, uint64_t(roundTripBytes));
+        totalMessages += messageSizeCounts[i];
+    }
+    if (totalBytes == 0) {
+        return;
+    }
+
+    uint64_t cumulativeBytes = 0;
+    uint32_t level = 0;
+    for (int i = 0; (i < numBuckets) && (level < levels - 1); i++) {
+        cumulativeBytes += messageSizeCounts[i]
+                * std::min(1lu << i, uint64_t(roundTripBytes));
+        while ((level < levels - 1)
+                && ((cumulativeBytes*levels) >= ((level + 1)*totalBytes))) {
+            unscheduledCutoffs[level] = downCast<uint32_t>(
+                    std::min(1lu << i, uint64_t(~0u)));
+            level++;
+        }
+    }
+    for ( ; level < levels; level++) {
+        unscheduledCutoffs[level] = ~0u;
+    }
+
+    // Age the counts, so that the cutoffs track changes in the workload.
+    if (totalMessages > 1000000) {
+        for (int i = 0; i < numBuckets; i++) {
+            messageSizeCounts[i] /= 2;
+        }
+    }
+}
+
 /**
  * Construct a new client session.
  *
@@ -670,6 +998,7 @@ BasicTransport::Session::sendRequest(Buffer* request, Buffer* response,
     }
     ClientRpc *clientRpc = t->clientRpcPool.construct(this,
             t->nextClientSequenceNumber, request, response, notifier);
+    t->recordMessageSize(request->size());
     clientRpc->transmitLimit = t->roundTripBytes;
     if (clientRpc->transmitLimit < request->size()) {
         clientRpc->needGrantFlag = NEED_GRANT;
@@ -752,6 +1081,7 @@ BasicTransport::handlePacket(Driver::Received* received)
                 timeTrace("client received ALL_DATA, sequence %u, length %u",
                         downCast<uint32_t>(header->common.rpcId.sequence),
                         length);
+                recordMessageSize(header->messageLength);
                 Driver::PayloadChunk::appendToBuffer(clientRpc->response,
                         payload + sizeof32(AllDataHeader),
                         header->messageLength, driver, payload);
@@ -772,6 +1102,7 @@ BasicTransport::handlePacket(Driver::Received* received)
                         header->offset, received->len, header->common.flags);
                 if (!clientRpc->accumulator) {
                     clientRpc->accumulator.construct(this, clientRpc->response);
+                    recordMessageSize(header->totalLength);
                 }
                 retainPacket = clientRpc->accumulator->addPacket(header,
                         received->len);
@@ -787,24 +1118,21 @@ BasicTransport::handlePacket(Driver::Received* received)
                     }
                     clientRpc->notifier->completed();
                     deleteClientRpc(clientRpc);
-                } else {
-                    // See if we need to output a GRANT.
-                    if ((header->common.flags & NEED_GRANT) &&
-                            (clientRpc->grantOffset <
-                            (clientRpc->response->size() + roundTripBytes)) &&
-                            (clientRpc->grantOffset < header->totalLength)) {
-                        clientRpc->grantOffset = clientRpc->response->size()
-                                + roundTripBytes + grantIncrement;
-                        timeTrace(
-                                "client sending GRANT, sequence %u, offset %u",
-                                downCast<uint32_t>(
-                                header->common.rpcId.sequence),
-                                clientRpc->grantOffset);
-                        GrantHeader grant(header->common.rpcId,
-                                clientRpc->grantOffset, FROM_CLIENT);
-                        driver->sendPacket(clientRpc->session->serverAddress,
-                                &grant, NULL);
+                } else if ((header->common.flags & NEED_GRANT)
+                        || clientRpc->scheduledMessage) {
+                    // The server needs GRANTs for this response; let the
+                    // scheduler decide whether (and when) to send them.
+                    if (!clientRpc->scheduledMessage) {
+                        // Copies needed: construct takes references.
+                        uint32_t totalLength = header->totalLength;
+                        uint8_t whoFrom = FROM_CLIENT;
+                        clientRpc->scheduledMessage.construct(this,
+                                header->common.rpcId,
+                                clientRpc->session->serverAddress,
+                                clientRpc->response, clientRpc->grantOffset,
+                                totalLength, whoFrom);
                     }
+                    scheduleGrants(clientRpc->scheduledMessage.get());
                 }
                 if (retainPacket) {
                     uint32_t dummy;
@@ -824,6 +1152,7 @@ BasicTransport::handlePacket(Driver::Received* received)
                 if (header->offset > clientRpc->transmitLimit) {
                     clientRpc->transmitLimit = header->offset;
                 }
+                clientRpc->scheduledPriority = header->priority;
                 return;
             }
 
@@ -879,7 +1208,7 @@ BasicTransport::handlePacket(Driver::Received* received)
                     // we're still alive.
                     AckHeader ack(header->common.rpcId, FROM_CLIENT);
                     driver->sendPacket(clientRpc->session->serverAddress,
-                            &ack, NULL);
+                            &ack, NULL, highestPriority);
                     return;
 
                 }
@@ -895,7 +1224,7 @@ BasicTransport::handlePacket(Driver::Received* received)
                         header->common.rpcId, clientRpc->request,
                         header->offset, header->length,
                         FROM_CLIENT|RETRANSMISSION|clientRpc->needGrantFlag,
-                        true);
+                        clientRpc->scheduledPriority, true);
                 clientRpc->lastTransmitTime = Cycles::rdtsc();
                 return;
             }
@@ -961,6 +1290,7 @@ BasicTransport::handlePacket(Driver::Received* received)
                         header->common.rpcId);
                 nextServerSequenceNumber++;
                 incomingRpcs[header->common.rpcId] = serverRpc;
+                recordMessageSize(header->messageLength);
                 Driver::PayloadChunk::appendToBuffer(&serverRpc->requestPayload,
                         payload + sizeof32(AllDataHeader),
                         header->messageLength, driver, payload);
@@ -988,6 +1318,7 @@ BasicTransport::handlePacket(Driver::Received* received)
                     serverRpc->accumulator.construct(this,
                             &serverRpc->requestPayload);
                     serverTimerList.push_back(*serverRpc);
+                    recordMessageSize(header->totalLength);
                 } else if (serverRpc->requestComplete) {
                     // We've already received the full message, so
                     // ignore this packet.
@@ -1014,27 +1345,23 @@ BasicTransport::handlePacket(Driver::Received* received)
                     }
                     erase(serverTimerList, *serverRpc);
                     serverRpc->requestComplete = true;
+                    unscheduleMessage(&serverRpc->scheduledMessage);
                     context->workerManager->handleRpc(serverRpc);
-                } else {
-                    // See if we need to output a GRANT.
-                    if ((header->common.flags & NEED_GRANT) &&
-                            (serverRpc->grantOffset <
-                            (serverRpc->requestPayload.size()
-                            + roundTripBytes)) &&
-                            (serverRpc->grantOffset < header->totalLength)) {
-                        serverRpc->grantOffset =
-                                serverRpc->requestPayload.size()
-                                + roundTripBytes + grantIncrement;
-                        timeTrace(
-                                "server sending GRANT, sequence %u, offset %u",
-                                downCast<uint32_t>(
-                                header->common.rpcId.sequence),
-                                serverRpc->grantOffset);
-                        GrantHeader grant(header->common.rpcId,
-                                serverRpc->grantOffset, FROM_SERVER);
-                        driver->sendPacket(serverRpc->clientAddress,
-                                &grant, NULL);
+                } else if ((header->common.flags & NEED_GRANT)
+                        || serverRpc->scheduledMessage) {
+                    // The client needs GRANTs for this request; let the
+                    // scheduler decide whether (and when) to send them.
+                    if (!serverRpc->scheduledMessage) {
+                        // Copies needed: construct takes references.
+                        uint32_t totalLength = header->totalLength;
+                        uint8_t whoFrom = FROM_SERVER;
+                        serverRpc->scheduledMessage.construct(this,
+                                header->common.rpcId, serverRpc->clientAddress,
+                                &serverRpc->requestPayload,
+                                serverRpc->grantOffset, totalLength,
+                                whoFrom);
                     }
+                    scheduleGrants(serverRpc->scheduledMessage.get());
                 }
                 serverDataDone:
                 if (retainPacket) {
@@ -1053,7 +1380,9 @@ BasicTransport::handlePacket(Driver::Received* received)
                         downCast<uint32_t>(header->common.rpcId.sequence),
                         header->offset);
                 if ((serverRpc == NULL) || !serverRpc->sendingResponse) {
-                    RAMCLOUD_LOG(WARNING, "unexpected GRANT from client %s, "
+                    // Normal when a GRANT crosses the end of the request
+                    // or the response on the wire; not worth a warning.
+                    RAMCLOUD_LOG(DEBUG, "unexpected GRANT from client %s, "
                             "id (%lu,%lu), grantOffset %u",
                             received->sender->toString().c_str(),
                             header->common.rpcId.clientId,
@@ -1063,6 +1392,7 @@ BasicTransport::handlePacket(Driver::Received* received)
                 if (header->offset > serverRpc->transmitLimit) {
                     serverRpc->transmitLimit = header->offset;
                 }
+                serverRpc->scheduledPriority = header->priority;
                 return;
             }
 
@@ -1098,7 +1428,8 @@ BasicTransport::handlePacket(Driver::Received* received)
                             downCast<uint32_t>(common->rpcId.sequence));
                     ResendHeader resend(header->common.rpcId, 0,
                             roundTripBytes, FROM_SERVER|RESTART);
-                    driver->sendPacket(received->sender, &resend, NULL);
+                    driver->sendPacket(received->sender, &resend, NULL,
+                            highestPriority);
                     return;
                 }
                 uint32_t resendEnd = header->offset + header->length;
@@ -1120,7 +1451,7 @@ BasicTransport::handlePacket(Driver::Received* received)
                     // we're still alive.
                     AckHeader ack(serverRpc->rpcId, FROM_SERVER);
                     driver->sendPacket(serverRpc->clientAddress,
-                            &ack, NULL);
+                            &ack, NULL, highestPriority);
                     return;
                 }
                 double elapsedMicros = Cycles::toSeconds(Cycles::rdtsc()
@@ -1135,7 +1466,7 @@ BasicTransport::handlePacket(Driver::Received* received)
                         serverRpc->rpcId, &serverRpc->replyPayload,
                         header->offset, header->length,
                         RETRANSMISSION|FROM_SERVER|serverRpc->needGrantFlag,
-                        true);
+                        serverRpc->scheduledPriority, true);
                 serverRpc->lastTransmitTime = Cycles::rdtsc();
                 return;
             }
@@ -1187,6 +1518,7 @@ BasicTransport::ServerRpc::sendReply()
     timeTrace("sendReply invoked, sequence %u, length %u",
             downCast<uint32_t>(rpcId.sequence), replyPayload.size());
     sendingResponse = true;
+    t->recordMessageSize(replyPayload.size());
     transmitLimit = t->roundTripBytes;
     if (transmitLimit < replyPayload.size()) {
         needGrantFlag = NEED_GRANT;
@@ -1376,10 +1708,55 @@ BasicTransport::MessageAccumulator::requestRetransmission(BasicTransport *t,
     }
     ResendHeader resend(rpcId, buffer->size(), endOffset - buffer->size(),
             whoFrom);
-    t->driver->sendPacket(address, &resend, NULL);
+    t->driver->sendPacket(address, &resend, NULL, t->highestPriority);
     return endOffset;
 }
 
+/**
+ * Construct a ScheduledMessage and add it to the transport's list of
+ * messages that need GRANTs.
+ *
+ * \param t
+ *      Overall information about the transport.
+ * \param rpcId
+ *      Unique identifier for the RPC containing the message.
+ * \param senderAddress
+ *      Where to send GRANTs for the message.
+ * \param buffer
+ *      Holds the data received so far for the message.
+ * \param grantOffset
+ *      The grantOffset field of the RPC that contains the message.
+ * \param totalLength
+ *      Total number of bytes in the message.
+ * \param whoFrom
+ *      Must be either FROM_CLIENT, indicating that we are the client, or
+ *      FROM_SERVER, indicating that we are the server.
+ */
+BasicTransport::ScheduledMessage::ScheduledMessage(BasicTransport* t,
+        RpcId rpcId, const Driver::Address* senderAddress, Buffer* buffer,
+        uint32_t& grantOffset, uint32_t totalLength, uint8_t whoFrom)
+    : t(t)
+    , rpcId(rpcId)
+    , senderAddress(senderAddress)
+    , buffer(buffer)
+    , grantOffset(grantOffset)
+    , totalLength(totalLength)
+    , whoFrom(whoFrom)
+    , priority(0)
+    , active(false)
+    , links()
+{
+    t->grantableMessages.push_back(*this);
+}
+
+/**
+ * Destructor for ScheduledMessages.
+ */
+BasicTransport::ScheduledMessage::~ScheduledMessage()
+{
+    erase(t->grantableMessages, *this);
+}
+
 /**
  * This method is invoked in the inner polling loop of the dispatcher;
  * it drives the operation of the transport.
@@ -1435,6 +1812,11 @@ BasicTransport::Poller::poll()
     // Transmit data packets if possible.
     result |= t->tryToTransmitData();
 
+    // Release server RPCs whose responses the driver has finished sending.
+    if (!t->drainingResponses.empty()) {
+        t->destroyDrainedResponses();
+    }
+
     t->receivedPackets.clear();
     return result;
 }
@@ -1448,6 +1830,8 @@ BasicTransport::Poller::poll()
 void
 BasicTransport::checkTimeouts()
 {
+    updateUnscheduledCutoffs();
+
     // Scan all of the ClientRpc objects.
     for (ClientRpcMap::iterator it = outgoingRpcs.begin();
             it != outgoingRpcs.end(); ) {
@@ -1466,6 +1850,19 @@ BasicTransport::checkTimeouts()
         // we delete the ClientRpc below.
         it++;
 
+        if (clientRpc->scheduledMessage
+                && !clientRpc->scheduledMessage->active
+                && clientRpc->silentIntervals < timeoutIntervals) {
+            // The server is waiting for us to grant the rest of the
+            // response (shorter messages are being granted first), so its
+            // silence is expected. Ping it occasionally; if it stops
+            // answering, the RPC will eventually time out below.
+            if ((clientRpc->silentIntervals % pingIntervals) == 0) {
+                pingSender(clientRpc->scheduledMessage.get());
+            }
+            continue;
+        }
+
         assert(timeoutIntervals > 2*pingIntervals);
         if (clientRpc->silentIntervals >= timeoutIntervals) {
             // A long time has elapsed with no communication whatsoever
@@ -1495,7 +1892,7 @@ BasicTransport::checkTimeouts()
                 // The RESEND packet is effectively a grant...
                 clientRpc->grantOffset = roundTripBytes;
                 driver->sendPacket(clientRpc->session->serverAddress,
-                        &resend, NULL);
+                        &resend, NULL, highestPriority);
             }
         } else {
             // We have received part of the response. If the server has gone
@@ -1529,6 +1926,17 @@ BasicTransport::checkTimeouts()
         // delete the ServerRpc below.
         it++;
 
+        if (serverRpc->scheduledMessage
+                && !serverRpc->scheduledMessage->active
+                && serverRpc->silentIntervals < timeoutIntervals) {
+            // The client is waiting for us to grant the rest of the
+            // request; see the corresponding code for clients above.
+            if ((serverRpc->silentIntervals % pingIntervals) == 0) {
+                pingSender(serverRpc->scheduledMessage.get());
+            }
+            continue;
+        }
+
         // If a long time has elapsed with no communication whatsoever
         // from the client, then abort the RPC. Note: this code should
         // only be executed when we're waiting to transmit or receive
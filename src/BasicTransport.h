@@ -189,6 +189,67 @@ class BasicTransport : public Transport {
         DISALLOW_COPY_AND_ASSIGN(MessageAccumulator);
     };
 
+    /**
+     * An object of this class exists for each incoming multi-packet message
+     * (a request on the server or a response on the client) whose sender
+     * has asked for GRANTs. These objects are kept in t->grantableMessages
+     * so that the receiver can decide which messages to grant, and at what
+     * priority.
+     */
+    struct ScheduledMessage {
+        ScheduledMessage(BasicTransport* t, RpcId rpcId,
+                const Driver::Address* senderAddress, Buffer* buffer,
+                uint32_t& grantOffset, uint32_t totalLength, uint8_t whoFrom);
+        ~ScheduledMessage();
+
+        /**
+         * Returns the number of bytes in the message that have not yet
+         * been received; this determines the message's rank for GRANTs.
+         */
+        uint32_t bytesRemaining() const
+        {
+            return totalLength - std::min(totalLength, buffer->size());
+        }
+
+        /// Transport that is managing this object.
+        BasicTransport* t;
+
+        /// Unique identifier for the RPC containing this message.
+        RpcId rpcId;
+
+        /// Where to send GRANTs for this message.
+        const Driver::Address* senderAddress;
+
+        /// Holds all of the message data received so far, up to the first
+        /// missing byte.
+        Buffer* buffer;
+
+        /// Refers to the grantOffset field of the RPC that owns this
+        /// message.
+        uint32_t& grantOffset;
+
+        /// Total number of bytes in the message.
+        uint32_t totalLength;
+
+        /// Either FROM_CLIENT, if we are the client for this RPC (the message
+        /// is a response), or FROM_SERVER if we are the server.
+        uint8_t whoFrom;
+
+        /// Priority specified in the most recent GRANT for this message.
+        int priority;
+
+        /// True means this message is one of the t->maxGrantedMessages
+        /// shortest in t->grantableMessages, so it is being granted;
+        /// false means its sender is waiting for shorter messages to finish.
+        bool active;
+
+        /// Used to link this object into t->grantableMessages.
+        IntrusiveListHook links;
+
+      PRIVATE:
+        DISALLOW_COPY_AND_ASSIGN(ScheduledMessage);
+    };
+
     /**
      * One object of this class exists for each outgoing RPC; it is used
      * to track the RPC through to completion.
@@ -245,6 +306,10 @@ class BasicTransport : public Transport {
         /// data packets.
         uint8_t needGrantFlag;
 
+        /// Network priority to use for granted bytes of the request,
+        /// as specified by the server in its most recent GRANT.
+        int scheduledPriority;
+
         /// True means that the request message is in the process of being
         /// transmitted (and this object is linked on t->outgoingRequests).
         bool transmitPending;
@@ -252,6 +317,10 @@ class BasicTransport : public Transport {
         /// Holds state of partially-received multi-packet responses.
         Tub<MessageAccumulator> accumulator;
 
+        /// Holds scheduling state for the response, if the server has
+        /// asked for GRANTs and the response is not yet complete.
+        Tub<ScheduledMessage> scheduledMessage;
+
         /// Used to link this object into t->outgoingRequests.
         IntrusiveListHook outgoingRequestLinks;
 
@@ -270,8 +339,10 @@ class BasicTransport : public Transport {
             , resendLimit(0)
             , silentIntervals(0)
             , needGrantFlag(0)
+            , scheduledPriority(0)
             , transmitPending(false)
             , accumulator()
+            , scheduledMessage()
             , outgoingRequestLinks()
         {}
 
@@ -346,9 +417,23 @@ class BasicTransport : public Transport {
         /// data packets.
         uint8_t needGrantFlag;
 
+        /// Network priority to use for granted bytes of the response,
+        /// as specified by the client in its most recent GRANT.
+        int scheduledPriority;
+
+        /// Driver::getTransmitMark value taken after the last byte of the
+        /// response was passed to the driver; the object cannot be deleted
+        /// until the driver reports that transmission complete. Only valid
+        /// while this object is in t->drainingResponses.
+        uint64_t transmitMark;
+
         /// Holds state of partially-received multi-packet requests.
         Tub<MessageAccumulator> accumulator;
 
+        /// Holds scheduling state for the request, if the client has
+        /// asked for GRANTs and the request is not yet complete.
+        Tub<ScheduledMessage> scheduledMessage;
+
         /// Used to link this object into t->serverTimerList.
         IntrusiveListHook timerLinks;
 
@@ -371,7 +456,10 @@ class BasicTransport : public Transport {
             , requestComplete(false)
             , sendingResponse(false)
             , needGrantFlag(0)
+            , scheduledPriority(0)
+            , transmitMark(0)
             , accumulator()
+            , scheduledMessage()
             , timerLinks()
             , outgoingResponseLinks()
         {}
@@ -486,9 +574,14 @@ class BasicTransport : public Transport {
                                      // sender should now transmit all data up
                                      // to (but not including) this offset, if
                                      // it hasn't already.
-
-        GrantHeader(RpcId rpcId, uint32_t offset, uint8_t flags)
-            : common(PacketOpcode::GRANT, rpcId, flags), offset(offset) {}
+        uint8_t priority;            // Network priority the sender should
+                                     // use for scheduled (granted) data
+                                     // packets in this message.
+
+        GrantHeader(RpcId rpcId, uint32_t offset, uint8_t flags,
+                uint8_t priority)
+            : common(PacketOpcode::GRANT, rpcId, flags), offset(offset),
+              priority(priority) {}
     } __attribute__((packed));
 
     /**
@@ -557,14 +650,23 @@ class BasicTransport : public Transport {
     void checkTimeouts();
     void deleteClientRpc(ClientRpc* clientRpc);
     void deleteServerRpc(ServerRpc* serverRpc);
+    void destroyDrainedResponses();
+    void finishResponse(ServerRpc* serverRpc);
     uint32_t getRoundTripBytes(const ServiceLocator* locator);
+    int getUnscheduledPriority(uint32_t messageLength);
     void handlePacket(Driver::Received* received);
     static string headerToString(const void* header, uint32_t headerLength);
     static string opcodeSymbol(uint8_t opcode);
+    void recordMessageSize(uint32_t messageLength);
+    void scheduleGrants(ScheduledMessage* message);
     uint32_t sendBytes(const Driver::Address* address, RpcId rpcId,
             Buffer* message, uint32_t offset, uint32_t maxBytes,
-            uint8_t flags, bool partialOK = false);
+            uint8_t flags, int scheduledPriority, bool partialOK = false);
+    void pingSender(ScheduledMessage* message);
+    void sendGrant(ScheduledMessage* message);
     int tryToTransmitData();
+    void unscheduleMessage(Tub<ScheduledMessage>* message);
+    void updateUnscheduledCutoffs();
 
     /// Shared RAMCloud information.
     Context* context;
@@ -647,6 +749,15 @@ class BasicTransport : public Transport {
             OutgoingResponseList;
     OutgoingResponseList outgoingResponses;
 
+    /// Holds RPCs for which we are the server, whose response has been
+    /// passed to the driver in its entirety, but which the driver may
+    /// still be transmitting directly out of the response buffer (see
+    /// Driver::isTransmitComplete). These objects are no longer in any
+    /// other structure, but they stay allocated from serverRpcPool so
+    /// that LogProtector continues to keep any log memory referenced by
+    /// their responses from being reclaimed. Sorted by transmitMark.
+    OutgoingResponseList drainingResponses;
+
     /// Subset of the objects in incomingRpcs that require monitoring by
     /// the timer. We keep this as a separate list so that the timer doesn't
     /// have to consider RPCs currently being executed (which could be a
@@ -668,6 +779,41 @@ class BasicTransport : public Transport {
     /// GRANTS, but it can result in additional buffering in the network.
     uint32_t grantIncrement;
 
+    /// Incoming messages whose senders have asked for GRANTs and that
+    /// have not yet been completely received, sorted in increasing order
+    /// of bytes remaining. GRANTs go to the messages at the front of this
+    /// list (shortest remaining processing time first).
+    INTRUSIVE_LIST_TYPEDEF(ScheduledMessage, links) ScheduledMessageList;
+    ScheduledMessageList grantableMessages;
+
+    /// The number of messages at the front of grantableMessages that
+    /// receive GRANTs at any given time (the "degree of overcommitment").
+    /// Granting to more than one message keeps the downlink busy if some
+    /// senders are slow to respond, at the cost of additional buffering
+    /// in the network.
+    uint32_t maxGrantedMessages;
+
+    /// The highest packet priority supported by the driver. Control
+    /// packets (GRANT, RESEND, and ACK) are always sent at this priority.
+    int highestPriority;
+
+    /// Priorities from this value through highestPriority are used for
+    /// unscheduled bytes (those sent before any GRANT arrives); lower
+    /// priorities are assigned to scheduled bytes by the receiver. If the
+    /// driver supports only one priority, everything uses priority 0.
+    int lowestUnscheduledPriority;
+
+    /// Determines the priority for the unscheduled bytes of outgoing
+    /// messages. A message whose length is at most unscheduledCutoffs[i]
+    /// (and greater than any earlier cutoff) uses priority
+    /// highestPriority - i. The last entry is always ~0.
+    std::vector<uint32_t> unscheduledCutoffs;
+
+    /// Counts of the messages sent and received by this transport, used
+    /// to compute unscheduledCutoffs. Entry i counts messages whose
+    /// lengths are greater than 2^(i-1) bytes and at most 2^i bytes.
+    uint32_t messageSizeCounts[33];
+
     /// Specifies the interval between calls to checkTimeouts, in units
     /// of rdtsc ticks.
     uint64_t timerInterval;
@@ -157,6 +157,27 @@ TEST_F(BasicTransportTest, sanityCheck) {
 TEST_F(BasicTransportTest, constructor) {
     EXPECT_EQ(9618u, transport.roundTripBytes);
 }
+TEST_F(BasicTransportTest, constructor_priorities) {
+    // MockDriver supports only one priority.
+    EXPECT_EQ(0, transport.highestPriority);
+    EXPECT_EQ(0, transport.lowestUnscheduledPriority);
+    EXPECT_EQ(1u, transport.unscheduledCutoffs.size());
+    EXPECT_EQ(2u, transport.maxGrantedMessages);
+}
+TEST_F(BasicTransportTest, constructor_overcommitOption) {
+    ServiceLocator locator("mock:overcommit=5");
+    BasicTransport transport2(&context, &locator,
+            new MockDriver(BasicTransport::headerToString), 667);
+    EXPECT_EQ(5u, transport2.maxGrantedMessages);
+
+    ServiceLocator locator2("mock:overcommit=x");
+    TestLog::reset();
+    BasicTransport transport3(&context, &locator2,
+            new MockDriver(BasicTransport::headerToString), 668);
+    EXPECT_EQ(2u, transport3.maxGrantedMessages);
+    EXPECT_TRUE(TestUtil::contains(TestLog::get(),
+            "Bad BasicTransport overcommit option value 'x'"));
+}
 
 TEST_F(BasicTransportTest, deleteClientRpc) {
     MockWrapper wrapper("message1");
@@ -234,13 +255,27 @@ TEST_F(BasicTransportTest, getRoundTripBytes_roundUpToEvenPackets) {
     EXPECT_EQ(1200u, transport.getRoundTripBytes(&locator));
 }
 
+TEST_F(BasicTransportTest, getUnscheduledPriority) {
+    EXPECT_EQ(0, transport.getUnscheduledPriority(100000));
+
+    transport.highestPriority = 7;
+    transport.lowestUnscheduledPriority = 4;
+    transport.unscheduledCutoffs = {100, 1000, 10000, ~0u};
+    EXPECT_EQ(7, transport.getUnscheduledPriority(1));
+    EXPECT_EQ(7, transport.getUnscheduledPriority(100));
+    EXPECT_EQ(6, transport.getUnscheduledPriority(101));
+    EXPECT_EQ(5, transport.getUnscheduledPriority(10000));
+    EXPECT_EQ(4, transport.getUnscheduledPriority(10001));
+    EXPECT_EQ(4, transport.getUnscheduledPriority(~0u));
+}
+
 TEST_F(BasicTransportTest, sendBytes_basics) {
     transport.maxDataPerPacket = 10;
     Buffer buffer;
     buffer.append("abcdefghijklmno1234567890", 25);
     uint32_t count = transport.sendBytes(&address1,
             BasicTransport::RpcId(5, 6), &buffer, 0, 50,
-            BasicTransport::FROM_SERVER);
+            BasicTransport::FROM_SERVER, 0);
     EXPECT_EQ("DATA FROM_SERVER, rpcId 5.6, totalLength 25, "
             "offset 0 abcdefghij | "
             "DATA FROM_SERVER, rpcId 5.6, totalLength 25, "
@@ -256,11 +291,11 @@ TEST_F(BasicTransportTest, sendBytes_partialPacket) {
     buffer.append("abcdefghijklmno1234567890", 25);
     uint32_t count = transport.sendBytes(&address1,
             BasicTransport::RpcId(5, 6), &buffer, 5, 9,
-            BasicTransport::FROM_SERVER);
+            BasicTransport::FROM_SERVER, 0);
     EXPECT_EQ("", driver->outputLog);
     EXPECT_EQ(0u, count);
     count = transport.sendBytes(&address1, BasicTransport::RpcId(5, 6),
-            &buffer, 5, 5, BasicTransport::FROM_SERVER, true);
+            &buffer, 5, 5, BasicTransport::FROM_SERVER, 0, true);
     EXPECT_EQ("DATA FROM_SERVER, rpcId 5.6, totalLength 25, "
             "offset 5 fghij",
             driver->outputLog);
@@ -272,11 +307,31 @@ TEST_F(BasicTransportTest, sendBytes_shortMessage) {
     buffer.append("abcdefghijklmno", 15);
     uint32_t count = transport.sendBytes(&address1,
             BasicTransport::RpcId(5, 6), &buffer, 0, 16,
-            BasicTransport::FROM_CLIENT);
+            BasicTransport::FROM_CLIENT, 0);
     EXPECT_EQ("ALL_DATA FROM_CLIENT, rpcId 5.6 abcdefghij (+5 more)",
             driver->outputLog);
     EXPECT_EQ(15u, count);
 }
+TEST_F(BasicTransportTest, sendBytes_priorities) {
+    transport.maxDataPerPacket = 10;
+    transport.roundTripBytes = 20;
+    transport.highestPriority = 7;
+    transport.lowestUnscheduledPriority = 4;
+    transport.unscheduledCutoffs = {10, 100, 1000, ~0u};
+    Buffer buffer;
+    buffer.append("abcdefghijklmno1234567890", 25);
+
+    // Unscheduled bytes: priority depends on the message length.
+    transport.sendBytes(&address1, BasicTransport::RpcId(5, 6), &buffer,
+            10, 10, BasicTransport::FROM_SERVER, 2);
+    EXPECT_EQ(6, driver->lastPriority);
+
+    // Scheduled bytes: use the priority from the GRANT.
+    transport.sendBytes(&address1, BasicTransport::RpcId(5, 6), &buffer,
+            10, 20, BasicTransport::FROM_SERVER, 2);
+    EXPECT_EQ(2, driver->lastPriority);
+    EXPECT_EQ(3u, driver->sendPacketCount);
+}
 
 TEST_F(BasicTransportTest, tryToTransmitData_pickShortestRequest) {
     transport.maxDataPerPacket = 10;
@@ -404,6 +459,264 @@ TEST_F(BasicTransportTest, tryToTransmitData_negativeTransmitQueueSpace) {
     EXPECT_EQ("", driver->outputLog);
 }
 
+TEST_F(BasicTransportTest, tryToTransmitData_waitForDriverBeforeDeleting) {
+    transport.maxDataPerPacket = 10;
+    driver->transmitsCompleted = 0;
+    BasicTransport::ServerRpc* serverRpc = prepareToRespond(200, 15);
+    serverRpc->sendReply();
+    EXPECT_EQ(0u, transport.incomingRpcs.size());
+    EXPECT_EQ(0u, transport.outgoingResponses.size());
+    EXPECT_EQ(0u, transport.serverTimerList.size());
+    EXPECT_EQ(1u, transport.drainingResponses.size());
+    EXPECT_EQ(2u, serverRpc->transmitMark);
+    EXPECT_EQ(1u, transport.serverRpcPool.outstandingAllocations);
+
+    // Once there is an RPC waiting, later ones must wait behind it even
+    // if the driver claims they are done.
+    driver->transmitsCompleted = 2;
+    serverRpc = prepareToRespond(201, 5);
+    serverRpc->sendReply();
+    EXPECT_EQ(2u, transport.drainingResponses.size());
+    EXPECT_EQ(3u, serverRpc->transmitMark);
+}
+TEST_F(BasicTransportTest, tryToTransmitData_driverAlreadyDone) {
+    transport.maxDataPerPacket = 10;
+    BasicTransport::ServerRpc* serverRpc = prepareToRespond(200, 15);
+    serverRpc->sendReply();
+    EXPECT_EQ(0u, transport.incomingRpcs.size());
+    EXPECT_EQ(0u, transport.drainingResponses.size());
+    EXPECT_EQ(0u, transport.serverRpcPool.outstandingAllocations);
+}
+
+TEST_F(BasicTransportTest, recordMessageSize) {
+    transport.recordMessageSize(0);
+    transport.recordMessageSize(1);
+    transport.recordMessageSize(2);
+    transport.recordMessageSize(3);
+    transport.recordMessageSize(4);
+    transport.recordMessageSize(1500);
+    EXPECT_EQ(2u, transport.messageSizeCounts[0]);
+    EXPECT_EQ(1u, transport.messageSizeCounts[1]);
+    EXPECT_EQ(2u, transport.messageSizeCounts[2]);
+    EXPECT_EQ(1u, transport.messageSizeCounts[11]);
+}
+
+TEST_F(BasicTransportTest, scheduleGrants_shortestFirst) {
+    transport.roundTripBytes = 1000;
+    transport.grantIncrement = 500;
+    transport.maxGrantedMessages = 1;
+    handlePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 101), 5000,
+            0, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "abcde");
+    EXPECT_EQ("GRANT FROM_SERVER, rpcId 100.101, offset 1505, "
+            "priority 0", driver->outputLog);
+    BasicTransport::ServerRpc* longRpc =
+            transport.incomingRpcs[BasicTransport::RpcId(100, 101)];
+    EXPECT_TRUE(longRpc->scheduledMessage->active);
+
+    // A shorter message arrives: it preempts the longer one.
+    driver->outputLog.clear();
+    handlePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 102), 10,
+            0, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "abcde");
+    EXPECT_EQ("GRANT FROM_SERVER, rpcId 100.102, offset 1505, "
+            "priority 0", driver->outputLog);
+    BasicTransport::ServerRpc* shortRpc =
+            transport.incomingRpcs[BasicTransport::RpcId(100, 102)];
+    EXPECT_TRUE(shortRpc->scheduledMessage->active);
+    EXPECT_FALSE(longRpc->scheduledMessage->active);
+    EXPECT_EQ(shortRpc->scheduledMessage.get(),
+            &transport.grantableMessages.front());
+
+    // More data for the long message: no grant while it's inactive.
+    driver->outputLog.clear();
+    handlePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 101), 5000,
+            5, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "fghij");
+    EXPECT_EQ("", driver->outputLog);
+
+    // The short message completes, so the long one becomes active again.
+    handlePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 102), 10,
+            5, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "fghij");
+    EXPECT_TRUE(shortRpc->requestComplete);
+    EXPECT_FALSE(shortRpc->scheduledMessage);
+    EXPECT_TRUE(longRpc->scheduledMessage->active);
+    EXPECT_EQ(1u, transport.grantableMessages.size());
+    EXPECT_EQ("", driver->outputLog);
+}
+
+TEST_F(BasicTransportTest, scheduleGrants_priorities) {
+    transport.roundTripBytes = 1000;
+    transport.grantIncrement = 500;
+    transport.maxGrantedMessages = 4;
+    transport.highestPriority = 7;
+    transport.lowestUnscheduledPriority = 4;
+    handlePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 101), 5000,
+            0, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "abcde");
+    EXPECT_EQ("GRANT FROM_SERVER, rpcId 100.101, offset 1505, "
+            "priority 0", driver->outputLog);
+    EXPECT_EQ(7, driver->lastPriority);
+
+    // Second message is shorter, so it gets a higher priority.
+    driver->outputLog.clear();
+    handlePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 102), 3000,
+            0, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "abcde");
+    EXPECT_EQ("GRANT FROM_SERVER, rpcId 100.102, offset 1505, "
+            "priority 1", driver->outputLog);
+
+    // Third message lands in the middle; the shortest message moves
+    // up a priority level to make room for it.
+    driver->outputLog.clear();
+    handlePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 103), 4000,
+            0, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "abcde");
+    EXPECT_EQ("GRANT FROM_SERVER, rpcId 100.102, offset 1505, priority 2 | "
+            "GRANT FROM_SERVER, rpcId 100.103, offset 1505, priority 1",
+            driver->outputLog);
+}
+
+TEST_F(BasicTransportTest, scheduleGrants_fullyGrantedKeepsPriority) {
+    transport.roundTripBytes = 1000;
+    transport.grantIncrement = 500;
+    transport.maxGrantedMessages = 4;
+    transport.highestPriority = 7;
+    transport.lowestUnscheduledPriority = 4;
+    handlePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 101), 1100,
+            0, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "abcde");
+    EXPECT_EQ("GRANT FROM_SERVER, rpcId 100.101, offset 1505, "
+            "priority 0", driver->outputLog);
+
+    // The first message moves up a priority level, but it has already
+    // been granted in full, so it doesn't get another GRANT.
+    driver->outputLog.clear();
+    handlePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 102), 5000,
+            0, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "abcde");
+    EXPECT_EQ("GRANT FROM_SERVER, rpcId 100.102, offset 1505, "
+            "priority 0", driver->outputLog);
+}
+
+TEST_F(BasicTransportTest, scheduleGrants_extendGrant) {
+    transport.roundTripBytes = 10;
+    transport.grantIncrement = 5;
+    handlePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 101), 100,
+            0, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "abcde");
+    EXPECT_EQ("GRANT FROM_SERVER, rpcId 100.101, offset 20, priority 0",
+            driver->outputLog);
+
+    // Enough data is still granted: no new GRANT.
+    driver->outputLog.clear();
+    handlePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 101), 100,
+            5, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "fghij");
+    EXPECT_EQ("", driver->outputLog);
+
+    // Less than a round trip is granted: extend the grant.
+    handlePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 101), 100,
+            10, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "klmno");
+    EXPECT_EQ("GRANT FROM_SERVER, rpcId 100.101, offset 30, priority 0",
+            driver->outputLog);
+}
+
+TEST_F(BasicTransportTest, unscheduleMessage) {
+    transport.roundTripBytes = 1000;
+    transport.grantIncrement = 500;
+    transport.maxGrantedMessages = 1;
+    handlePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 101), 5000,
+            0, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "abcde");
+    handlePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 102), 6000,
+            10, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "abcde");
+    BasicTransport::ServerRpc* serverRpc =
+            transport.incomingRpcs[BasicTransport::RpcId(100, 102)];
+    EXPECT_FALSE(serverRpc->scheduledMessage->active);
+
+    // Deleting the active message passes its grants on.
+    driver->outputLog.clear();
+    transport.deleteServerRpc(
+            transport.incomingRpcs[BasicTransport::RpcId(100, 101)]);
+    EXPECT_TRUE(serverRpc->scheduledMessage->active);
+    EXPECT_EQ("GRANT FROM_SERVER, rpcId 100.102, offset 1500, priority 0",
+            driver->outputLog);
+
+    // Nothing to do.
+    Tub<BasicTransport::ScheduledMessage> empty;
+    transport.unscheduleMessage(&empty);
+    EXPECT_EQ(1u, transport.grantableMessages.size());
+}
+
+TEST_F(BasicTransportTest, updateUnscheduledCutoffs) {
+    transport.roundTripBytes = 10000;
+
+    // Only one unscheduled priority: nothing to do.
+    transport.messageSizeCounts[6] = 100;
+    transport.updateUnscheduledCutoffs();
+    EXPECT_EQ(~0u, transport.unscheduledCutoffs[0]);
+
+    // Unscheduled bytes should be divided evenly among priorities.
+    transport.unscheduledCutoffs.resize(4, ~0u);
+    transport.messageSizeCounts[10] = 10;
+    transport.messageSizeCounts[14] = 1;
+    transport.messageSizeCounts[20] = 1;
+    transport.updateUnscheduledCutoffs();
+    EXPECT_EQ(1024u, transport.unscheduledCutoffs[0]);
+    EXPECT_EQ(16384u, transport.unscheduledCutoffs[1]);
+    EXPECT_EQ(1048576u, transport.unscheduledCutoffs[2]);
+    EXPECT_EQ(~0u, transport.unscheduledCutoffs[3]);
+
+    // A single message size: all bytes go to the top priority.
+    memset(transport.messageSizeCounts, 0,
+            sizeof(transport.messageSizeCounts));
+    transport.messageSizeCounts[6] = 100;
+    transport.updateUnscheduledCutoffs();
+    EXPECT_EQ(64u, transport.unscheduledCutoffs[0]);
+    EXPECT_EQ(64u, transport.unscheduledCutoffs[1]);
+    EXPECT_EQ(64u, transport.unscheduledCutoffs[2]);
+    EXPECT_EQ(~0u, transport.unscheduledCutoffs[3]);
+
+    // Counts age once they get large.
+    transport.messageSizeCounts[6] = 2000000;
+    transport.updateUnscheduledCutoffs();
+    EXPECT_EQ(1000000u, transport.messageSizeCounts[6]);
+}
+
+TEST_F(BasicTransportTest, destroyDrainedResponses) {
+    driver->transmitsCompleted = 0;
+    prepareToRespond(200, 5)->sendReply();
+    prepareToRespond(201, 5)->sendReply();
+    prepareToRespond(202, 5)->sendReply();
+    EXPECT_EQ(3u, transport.drainingResponses.size());
+    driver->transmitsCompleted = 2;
+    TestLog::reset();
+    transport.poller.poll();
+    EXPECT_EQ("destroyDrainedResponses: RpcId (100, 200) | "
+            "destroyDrainedResponses: RpcId (100, 201)",
+            TestLog::get());
+    EXPECT_EQ(1u, transport.drainingResponses.size());
+    EXPECT_EQ(1u, transport.serverRpcPool.outstandingAllocations);
+}
+
 TEST_F(BasicTransportTest, Session_constructor) {
     ServiceLocator locator("basic+udp: host=localhost, port=11101");
     UdpDriver* driver2 = new UdpDriver(&context, &locator);
@@ -590,7 +903,8 @@ TEST_F(BasicTransportTest, handlePacket_dataFromServer_basics) {
             BasicTransport::DataHeader(BasicTransport::RpcId(666, 1), 10, 0,
             BasicTransport::NEED_GRANT | BasicTransport::FROM_SERVER), "abcde");
     EXPECT_STREQ("completed: 0, failed: 0", wrapper.getState());
-    EXPECT_EQ("GRANT FROM_CLIENT, rpcId 666.1, offset 1505",
+    EXPECT_EQ("GRANT FROM_CLIENT, rpcId 666.1, offset 1505, "
+            "priority 0",
             driver->outputLog);
     EXPECT_EQ("abcde", TestUtil::toString(&wrapper.response));
     EXPECT_EQ(1u, Driver::Received::stealCount);
@@ -644,7 +958,8 @@ TEST_F(BasicTransportTest, handlePacket_dataFromServer_dontIssueGrant) {
             BasicTransport::DataHeader(BasicTransport::RpcId(666, 1), 15, 0,
             BasicTransport::NEED_GRANT|BasicTransport::FROM_SERVER),
             "abcde");
-    EXPECT_EQ("GRANT FROM_CLIENT, rpcId 666.1, offset 1505",
+    EXPECT_EQ("GRANT FROM_CLIENT, rpcId 666.1, offset 1505, "
+            "priority 0",
             driver->outputLog);
 
     // Second packet of response (still not complete, but no need for
@@ -687,14 +1002,15 @@ TEST_F(BasicTransportTest, handlePacket_grantFromServer) {
     // First grant doesn't get past transmitLimit.
     handlePacket("mock:server=1",
             BasicTransport::GrantHeader(BasicTransport::RpcId(666, 1), 10,
-            BasicTransport::FROM_SERVER));
+            BasicTransport::FROM_SERVER, 0));
     EXPECT_EQ(10lu, clientRpc->transmitLimit);
 
     // Second grant is far enough out to enable more bytes to be sent.
     handlePacket("mock:server=1",
             BasicTransport::GrantHeader(BasicTransport::RpcId(666, 1), 15,
-            BasicTransport::FROM_SERVER));
+            BasicTransport::FROM_SERVER, 3));
     EXPECT_EQ(15lu, clientRpc->transmitLimit);
+    EXPECT_EQ(3, clientRpc->scheduledPriority);
 }
 TEST_F(BasicTransportTest, handlePacket_logTimeTraceFromServer) {
     MockWrapper wrapper("message1");
@@ -859,7 +1175,8 @@ TEST_F(BasicTransportTest, handlePacket_dataFromClient_basics) {
     ASSERT_TRUE(it != transport.incomingRpcs.end());
     BasicTransport::ServerRpc* serverRpc = it->second;
     EXPECT_FALSE(serverRpc->requestComplete);
-    EXPECT_EQ("GRANT FROM_SERVER, rpcId 100.101, offset 1500",
+    EXPECT_EQ("GRANT FROM_SERVER, rpcId 100.101, offset 1500, "
+            "priority 0",
             driver->outputLog);
     EXPECT_EQ(2u, transport.nextServerSequenceNumber);
 
@@ -941,7 +1258,7 @@ TEST_F(BasicTransportTest, handlePacket_grantFromClient_bogusGrants) {
     // GRANT arriving for unknown RpcID: bogus.
     handlePacket("mock:client=1",
             BasicTransport::GrantHeader(BasicTransport::RpcId(5, 6), 10,
-            BasicTransport::FROM_CLIENT));
+            BasicTransport::FROM_CLIENT, 0));
     EXPECT_EQ("handlePacket: unexpected GRANT from client mock:client=1, "
             "id (5,6), grantOffset 10",
             TestLog::get());
@@ -950,7 +1267,7 @@ TEST_F(BasicTransportTest, handlePacket_grantFromClient_bogusGrants) {
     TestLog::reset();
     handlePacket("mock:client=1",
             BasicTransport::GrantHeader(BasicTransport::RpcId(100, 101), 10,
-            BasicTransport::FROM_CLIENT));
+            BasicTransport::FROM_CLIENT, 0));
     EXPECT_EQ("handlePacket: unexpected GRANT from client mock:client=1, "
             "id (100,101), grantOffset 10",
             TestLog::get());
@@ -976,7 +1293,7 @@ TEST_F(BasicTransportTest, handlePacket_grantFromClient) {
     // First, send redundant grant (do nothing).
     handlePacket("mock:client=1",
             BasicTransport::GrantHeader(BasicTransport::RpcId(100, 101), 5,
-            BasicTransport::FROM_CLIENT));
+            BasicTransport::FROM_CLIENT, 0));
     transport.tryToTransmitData();
     EXPECT_EQ("", driver->outputLog);
     EXPECT_EQ(5u, serverRpc->transmitLimit);
@@ -984,7 +1301,8 @@ TEST_F(BasicTransportTest, handlePacket_grantFromClient) {
     // Second grant should allow more data to be transmitted.
     handlePacket("mock:client=1",
             BasicTransport::GrantHeader(BasicTransport::RpcId(100, 101), 15,
-            BasicTransport::FROM_CLIENT));
+            BasicTransport::FROM_CLIENT, 2));
+    EXPECT_EQ(2, serverRpc->scheduledPriority);
     transport.tryToTransmitData();
     EXPECT_EQ("DATA FROM_SERVER, rpcId 100.101, totalLength 20, offset 5, "
             "NEED_GRANT 56789 | "
@@ -997,7 +1315,7 @@ TEST_F(BasicTransportTest, handlePacket_grantFromClient) {
     driver->outputLog.clear();
     handlePacket("mock:client=1",
             BasicTransport::GrantHeader(BasicTransport::RpcId(100, 101), 25,
-            BasicTransport::FROM_CLIENT));
+            BasicTransport::FROM_CLIENT, 0));
     EXPECT_EQ(25u, serverRpc->transmitLimit);
     transport.tryToTransmitData();
     EXPECT_EQ("DATA FROM_SERVER, rpcId 100.101, totalLength 20, offset 15, "
@@ -1531,5 +1849,104 @@ TEST_F(BasicTransportTest, checkTimeouts_sendResendFromServer) {
     EXPECT_EQ("RESEND FROM_SERVER, rpcId 100.101, offset 8, length 92",
             driver->outputLog);
 }
+TEST_F(BasicTransportTest, checkTimeouts_clientInactiveScheduledMessage) {
+    transport.roundTripBytes = 1000;
+    transport.grantIncrement = 500;
+    transport.maxGrantedMessages = 1;
+    MockWrapper wrapper1("message1");
+    session->sendRequest(&wrapper1.request, &wrapper1.response, &wrapper1);
+    MockWrapper wrapper2("message2");
+    session->sendRequest(&wrapper2.request, &wrapper2.response, &wrapper2);
+    handlePacket("mock:server=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(666, 1), 5000, 0,
+            BasicTransport::NEED_GRANT | BasicTransport::FROM_SERVER),
+            "abcde");
+    handlePacket("mock:server=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(666, 2), 10, 0,
+            BasicTransport::NEED_GRANT | BasicTransport::FROM_SERVER),
+            "abcde");
+    BasicTransport::ClientRpc* clientRpc = transport.outgoingRpcs[1];
+    EXPECT_FALSE(clientRpc->scheduledMessage->active);
+    driver->outputLog.clear();
+
+    // The inactive response isn't granted, but we ping the server
+    // occasionally; its ACK shows that it's still alive.
+    transport.checkTimeouts();
+    transport.checkTimeouts();
+    EXPECT_FALSE(TestUtil::contains(driver->outputLog, "rpcId 666.1"));
+    transport.checkTimeouts();
+    EXPECT_TRUE(TestUtil::contains(driver->outputLog,
+            "RESEND FROM_CLIENT, rpcId 666.1, offset 1505, length 0"));
+    EXPECT_EQ(3u, clientRpc->silentIntervals);
+    handlePacket("mock:server=1", BasicTransport::AckHeader(
+            BasicTransport::RpcId(666, 1), BasicTransport::FROM_SERVER));
+    EXPECT_EQ(0u, clientRpc->silentIntervals);
+    EXPECT_EQ(0, wrapper1.failedCount);
+}
+TEST_F(BasicTransportTest, checkTimeouts_clientInactiveMessageFromDeadServer) {
+    transport.roundTripBytes = 1000;
+    transport.grantIncrement = 500;
+    transport.maxGrantedMessages = 1;
+    MockWrapper wrapper1("message1");
+    session->sendRequest(&wrapper1.request, &wrapper1.response, &wrapper1);
+    MockWrapper wrapper2("message2");
+    session->sendRequest(&wrapper2.request, &wrapper2.response, &wrapper2);
+    handlePacket("mock:server=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(666, 1), 5000, 0,
+            BasicTransport::NEED_GRANT | BasicTransport::FROM_SERVER),
+            "abcde");
+    handlePacket("mock:server=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(666, 2), 10, 0,
+            BasicTransport::NEED_GRANT | BasicTransport::FROM_SERVER),
+            "abcde");
+    EXPECT_FALSE(transport.outgoingRpcs[1]->scheduledMessage->active);
+
+    // The server never answers our pings, so the starved response must
+    // eventually be aborted.
+    for (uint32_t i = 0; i < transport.timeoutIntervals - 1; i++) {
+        transport.checkTimeouts();
+    }
+    EXPECT_EQ(0, wrapper1.failedCount);
+    transport.checkTimeouts();
+    EXPECT_EQ(1, wrapper1.failedCount);
+    EXPECT_TRUE(transport.outgoingRpcs.find(1) ==
+            transport.outgoingRpcs.end());
+}
+TEST_F(BasicTransportTest, checkTimeouts_serverInactiveScheduledMessage) {
+    transport.roundTripBytes = 1000;
+    transport.grantIncrement = 500;
+    transport.maxGrantedMessages = 1;
+    handlePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 101), 5000,
+            0, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "abcde");
+    handlePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 102), 10,
+            0, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "abcde");
+    BasicTransport::ServerRpc* serverRpc =
+            transport.incomingRpcs[BasicTransport::RpcId(100, 101)];
+    EXPECT_FALSE(serverRpc->scheduledMessage->active);
+    driver->outputLog.clear();
+
+    for (uint32_t i = 0; i < transport.timeoutIntervals - 1; i++) {
+        transport.checkTimeouts();
+    }
+    EXPECT_TRUE(TestUtil::contains(driver->outputLog,
+            "RESEND FROM_SERVER, rpcId 100.101, offset 1505, length 0"));
+    EXPECT_FALSE(TestUtil::contains(driver->outputLog,
+            "RESEND FROM_SERVER, rpcId 100.101, offset 5"));
+    EXPECT_EQ(2lu, transport.incomingRpcs.size());
+
+    // The client answers our ping.
+    handlePacket("mock:client=1", BasicTransport::AckHeader(
+            BasicTransport::RpcId(100, 101), BasicTransport::FROM_CLIENT));
+    EXPECT_EQ(0u, serverRpc->silentIntervals);
+
+    // The active request times out; the inactive one takes its place.
+    transport.checkTimeouts();
+    EXPECT_EQ(1lu, transport.incomingRpcs.size());
+    EXPECT_TRUE(serverRpc->scheduledMessage->active);
+}
 
 }  // namespace RAMCloud
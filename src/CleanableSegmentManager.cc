@@ -329,6 +329,13 @@ CleanableSegmentManager::scanSegmentTombstones(const SpinLock::Guard& guard)
 
 /**
  * Calculate the cost-benefit ratio (benefit/cost) for the given segment.
+ *
+ * As in LFS, the age used is that of the youngest data in the segment
+ * (LogSegment::dataTimestamp), not that of the segment itself. Survivors of
+ * earlier cleaning passes are segregated by temperature and tagged with the
+ * age of their data, so cold survivors are left alone until enough of them
+ * has died to make cleaning worthwhile, while hot survivors are treated like
+ * any other recently-written segment.
  */
 uint64_t
 CleanableSegmentManager::computeCleaningCostBenefitScore(LogSegment* s)
@@ -339,7 +346,7 @@ CleanableSegmentManager::computeCleaningCostBenefitScore(LogSegment* s)
     int utilization = s->getDiskUtilization();
     if (utilization != 0) {
         uint32_t now = WallTime::secondsTimestamp();
-        uint32_t timestamp = s->creationTimestamp;
+        uint32_t timestamp = s->dataTimestamp;
 
         // This generally shouldn't happen, but is possible due to:
         //  1) Unsynchronized TSCs across cores (WallTime uses rdtsc).
@@ -26,6 +26,7 @@
 #include "LogCleaner.h"
 #include "ReplicaManager.h"
 #include "MasterTableMetadata.h"
+#include "WallTime.h"
 
 namespace RAMCloud {
 
@@ -152,4 +153,21 @@ TEST_F(CleanableSegmentManagerTest, update) {
               csm.toString());
 }
 
+TEST_F(CleanableSegmentManagerTest, computeCleaningCostBenefitScore) {
+    CleanableSegmentManager& csm = cleaner.cleanableSegments;
+    WallTime::mockWallTimeValue = 1000;
+    LogSegment* s = segmentManager.allocHeadSegment();
+    EXPECT_EQ(1000U, s->dataTimestamp);
+    EXPECT_EQ(-1UL, csm.computeCleaningCostBenefitScore(s));
+
+    s->entryLengths[LOG_ENTRY_TYPE_OBJ] = s->segmentSize / 2;
+    EXPECT_EQ(50, s->getDiskUtilization());
+    EXPECT_EQ(0U, csm.computeCleaningCostBenefitScore(s));
+
+    // The age of the data, not of the segment, is what counts.
+    s->dataTimestamp = 900;
+    EXPECT_EQ(100U, csm.computeCleaningCostBenefitScore(s));
+    WallTime::mockWallTimeValue = 0;
+}
+
 }  // namespace RAMCloud
@@ -0,0 +1,165 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "CompletionQueue.h"
+#include "RamCloud.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct an empty CompletionQueue.
+ *
+ * \param ramcloud
+ *      The RamCloud object that RPCs started on this queue will use; it is
+ *      polled by #poll.
+ * \param maxOutstanding
+ *      Largest number of RPCs that may be in flight at once.
+ */
+CompletionQueue::CompletionQueue(RamCloud* ramcloud, uint32_t maxOutstanding)
+    : ramcloud(ramcloud)
+    , maxOutstanding(maxOutstanding)
+    , outstanding()
+    , mutex("CompletionQueue::mutex")
+    , ready()
+    , retrying()
+{
+}
+
+/**
+ * Destructor: cancels any RPCs that are still outstanding, without invoking
+ * their callbacks.
+ */
+CompletionQueue::~CompletionQueue()
+{
+    // Once an RPC has been canceled the transport won't call completed
+    // or failed for it, so nothing will touch #ready after this loop.
+    for (OperationBase* operation : outstanding)
+        operation->cancel();
+    for (OperationBase* operation : outstanding)
+        delete operation;
+}
+
+/**
+ * Check for RPCs that have finished and invoke their callbacks. This method
+ * doesn't block.
+ *
+ * \return
+ *      The number of callbacks invoked.
+ */
+uint32_t
+CompletionQueue::poll()
+{
+    ramcloud->poll();
+
+    // Work on private copies of the lists, since callbacks may start new
+    // RPCs (and hence call this method recursively).
+    std::vector<OperationBase*> candidates;
+    {
+        SpinLock::Guard _(mutex);
+        candidates.swap(ready);
+    }
+    size_t firstRetry = candidates.size();
+    candidates.insert(candidates.end(), retrying.begin(), retrying.end());
+    retrying.clear();
+
+    uint32_t count = 0;
+    for (size_t i = 0; i < candidates.size(); i++) {
+        try {
+            if (finish(candidates[i]))
+                count++;
+        } catch (...) {
+            // A callback threw; don't lose track of the RPCs that we
+            // haven't looked at yet.
+            for (size_t j = i + 1; j < candidates.size(); j++) {
+                if (j < firstRetry) {
+                    SpinLock::Guard _(mutex);
+                    ready.push_back(candidates[j]);
+                } else {
+                    retrying.push_back(candidates[j]);
+                }
+            }
+            throw;
+        }
+    }
+    return count;
+}
+
+/**
+ * Wait until all outstanding RPCs have finished and their callbacks have
+ * been invoked.
+ */
+void
+CompletionQueue::waitAll()
+{
+    while (!outstanding.empty())
+        poll();
+}
+
+/**
+ * Check whether an RPC is ready; if so, invoke its callback and delete it.
+ * If not (typically because it is being retried), arrange for it to be
+ * checked again later.
+ *
+ * \param operation
+ *      RPC that has received a response or is waiting to be retried.
+ * \return
+ *      True if the RPC's callback was invoked.
+ */
+bool
+CompletionQueue::finish(OperationBase* operation)
+{
+    // Clear this first, so that any notification that arrives while we're
+    // looking at the RPC gets it back on the ready list.
+    operation->queued = 0;
+
+    bool isReady;
+    try {
+        isReady = operation->isReady();
+    } catch (...) {
+        // Let the callback see the error: the RPC's wait method will
+        // throw the same exception.
+        isReady = true;
+    }
+    if (!isReady) {
+        if (operation->isWaitingToRetry())
+            retrying.push_back(operation);
+        else
+            operation->checkFinished();
+        return false;
+    }
+
+    outstanding.erase(operation);
+    std::unique_ptr<OperationBase> _(operation);
+    operation->invokeCallback();
+    return true;
+}
+
+/**
+ * Invoked (possibly in the dispatch thread) when a response or transport
+ * failure arrives for an RPC, so that the next call to #poll will look at it.
+ *
+ * \param operation
+ *      The RPC that has something to report.
+ */
+void
+CompletionQueue::notify(OperationBase* operation)
+{
+    if (operation->queued.exchange(1) != 0)
+        return;
+    SpinLock::Guard _(mutex);
+    ready.push_back(operation);
+}
+
+} // namespace RAMCloud
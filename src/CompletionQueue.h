@@ -0,0 +1,240 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_COMPLETIONQUEUE_H
+#define RAMCLOUD_COMPLETIONQUEUE_H
+
+#include <functional>
+#include <unordered_set>
+
+#include "Common.h"
+#include "Atomic.h"
+#include "SpinLock.h"
+
+namespace RAMCloud {
+
+class RamCloud;
+
+/**
+ * A CompletionQueue lets a single client thread keep a large number of
+ * asynchronous RPCs (ReadRpc, WriteRpc, or any other RpcWrapper subclass)
+ * outstanding at once, and invokes a callback for each one as it finishes.
+ * This replaces hand-written loops that call isReady on arrays of RPCs:
+ *
+ *     CompletionQueue queue(ramcloud);
+ *     queue.start<ReadRpc>([&](ReadRpc* rpc) {
+ *             rpc->wait();    // Won't block; throws if the read failed.
+ *             ...use value...
+ *         }, ramcloud, tableId, key, keyLength, &value);
+ *     ...start more...
+ *     queue.waitAll();
+ *
+ * Callbacks are only invoked from #poll (and the methods that call it), in
+ * the thread that owns the queue; they may start new RPCs on the same queue.
+ * A callback should call the RPC's wait method to retrieve its results; it
+ * will not block, and it throws the RPC's exception if it failed. The RPC
+ * is deleted when the callback returns.
+ *
+ * Transports tell the queue when an RPC's response arrives (by way of
+ * RpcWrapper::completed and RpcWrapper::failed), so #poll only examines
+ * RPCs that have something to report, plus those waiting to be retried;
+ * its cost doesn't grow with the number of RPCs in flight. The number of
+ * outstanding RPCs is capped, so memory use is bounded: #start waits for
+ * some RPC to finish when the queue is full.
+ *
+ * This class is not thread-safe: all methods except the transport
+ * notifications must be invoked from a single thread.
+ */
+class CompletionQueue {
+  PUBLIC:
+    explicit CompletionQueue(RamCloud* ramcloud,
+            uint32_t maxOutstanding = DEFAULT_MAX_OUTSTANDING);
+    ~CompletionQueue();
+
+    uint32_t poll();
+    void waitAll();
+
+    /**
+     * Start an asynchronous RPC and arrange for a callback to be invoked
+     * once it has finished. If #maxOutstanding RPCs are already in flight,
+     * this method waits (invoking callbacks) until one of them finishes.
+     *
+     * \tparam Rpc
+     *      Type of the RPC to start, such as ReadRpc; must be a subclass
+     *      of RpcWrapper.
+     * \param callback
+     *      Invoked with the RPC once it is ready; its wait method won't
+     *      block.
+     * \param args
+     *      Arguments for Rpc's constructor (typically starting with the
+     *      RamCloud object).
+     */
+    template<typename Rpc, typename... Args>
+    void start(std::function<void(Rpc*)> callback, Args&&... args)
+    {
+        while (outstanding.size() >= maxOutstanding)
+            poll();
+        Operation<Rpc>* operation = new Operation<Rpc>(this, callback,
+                std::forward<Args>(args)...);
+        outstanding.insert(operation);
+
+        // The RPC may have finished before Operation's constructor
+        // returned, in which case only the RpcWrapper versions of completed
+        // or failed ran.
+        operation->checkFinished();
+    }
+
+    /// Number of RPCs that have been started but whose callbacks haven't
+    /// yet been invoked.
+    uint32_t size()
+    {
+        return downCast<uint32_t>(outstanding.size());
+    }
+
+    /// Default value for #maxOutstanding.
+    static const uint32_t DEFAULT_MAX_OUTSTANDING = 4096;
+
+  PRIVATE:
+    /**
+     * The part of an outstanding RPC that doesn't depend on its type.
+     */
+    class OperationBase {
+      public:
+        explicit OperationBase(CompletionQueue* queue)
+            : queue(queue)
+            , queued(0)
+        {}
+        virtual ~OperationBase() {}
+
+        /// Invoke the RPC's isReady method.
+        virtual bool isReady() = 0;
+
+        /// Invoke the RPC's cancel method.
+        virtual void cancel() = 0;
+
+        /// Invoke the callback for the (ready) RPC.
+        virtual void invokeCallback() = 0;
+
+        /// Returns true if the RPC is waiting for its retry time, in which
+        /// case the transport won't notify the queue.
+        virtual bool isWaitingToRetry() = 0;
+
+        /// Add the RPC to the queue's ready list if a response or transport
+        /// failure has arrived for it.
+        virtual void checkFinished() = 0;
+
+        /// The queue this RPC belongs to.
+        CompletionQueue* queue;
+
+        /// Nonzero means this operation is in the queue's #ready list (or
+        /// is about to be added to it). Used to make sure it only appears
+        /// there once.
+        Atomic<int> queued;
+
+      PRIVATE:
+        DISALLOW_COPY_AND_ASSIGN(OperationBase);
+    };
+
+    /**
+     * An outstanding RPC of a particular type, along with its callback.
+     * Overrides the RPC's completed and failed methods so the transport
+     * notifies the queue.
+     */
+    template<typename Rpc>
+    class Operation : public OperationBase, public Rpc {
+      public:
+        template<typename... Args>
+        Operation(CompletionQueue* queue, std::function<void(Rpc*)> callback,
+                Args&&... args)
+            : OperationBase(queue)
+            , Rpc(std::forward<Args>(args)...)
+            , callback(callback)
+        {}
+
+        virtual void completed()
+        {
+            Rpc::completed();
+            queue->notify(this);
+        }
+
+        virtual void failed()
+        {
+            Rpc::failed();
+            queue->notify(this);
+        }
+
+        virtual bool isReady()
+        {
+            return Rpc::isReady();
+        }
+
+        virtual void cancel()
+        {
+            Rpc::cancel();
+        }
+
+        virtual void invokeCallback()
+        {
+            callback(this);
+        }
+
+        virtual bool isWaitingToRetry()
+        {
+            return Rpc::getState() == Rpc::RETRY;
+        }
+
+        virtual void checkFinished()
+        {
+            typename Rpc::RpcState state = Rpc::getState();
+            if (state == Rpc::FINISHED || state == Rpc::FAILED)
+                queue->notify(this);
+        }
+
+        /// Invoked once the RPC is ready.
+        std::function<void(Rpc*)> callback;
+
+        DISALLOW_COPY_AND_ASSIGN(Operation);
+    };
+
+    bool finish(OperationBase* operation);
+    void notify(OperationBase* operation);
+
+    /// Used to poll the dispatcher.
+    RamCloud* ramcloud;
+
+    /// Largest number of RPCs that may be outstanding at once.
+    uint32_t maxOutstanding;
+
+    /// All RPCs whose callbacks haven't been invoked yet.
+    std::unordered_set<OperationBase*> outstanding;
+
+    /// Protects #ready, which is modified by transports (possibly in the
+    /// dispatch thread) as well as by the thread that owns the queue.
+    SpinLock mutex;
+
+    /// RPCs for which a response or failure has arrived since the last
+    /// call to #poll.
+    std::vector<OperationBase*> ready;
+
+    /// RPCs that must be retried later; the transport won't notify us
+    /// about them, so #poll checks each of them.
+    std::vector<OperationBase*> retrying;
+
+    DISALLOW_COPY_AND_ASSIGN(CompletionQueue);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_COMPLETIONQUEUE_H
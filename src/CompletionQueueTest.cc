@@ -0,0 +1,210 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "CompletionQueue.h"
+#include "MockTransport.h"
+#include "RamCloud.h"
+#include "RpcWrapper.h"
+
+namespace RAMCloud {
+
+/// Minimal RPC that is sent on a MockTransport session.
+class CompletionQueueTestRpc : public RpcWrapper {
+  public:
+    CompletionQueueTestRpc(Transport::SessionRef session, int id)
+        : RpcWrapper(sizeof(WireFormat::ResponseCommon))
+        , id(id)
+    {
+        this->session = session;
+        send();
+    }
+
+    /// Simulate the arrival of a response with a given status.
+    void
+    respond(Status status)
+    {
+        response->reset();
+        response->emplaceAppend<WireFormat::ResponseCommon>()->status =
+                status;
+        completed();
+    }
+
+    int id;
+    DISALLOW_COPY_AND_ASSIGN(CompletionQueueTestRpc);
+};
+
+class CompletionQueueTest : public ::testing::Test {
+  public:
+    Context context;
+    RamCloud ramcloud;
+    ServiceLocator locator;
+    MockTransport transport;
+    Transport::SessionRef session;
+    Tub<CompletionQueue> queue;
+    string finished;
+    std::function<void(CompletionQueueTestRpc*)> callback;
+
+    CompletionQueueTest()
+        : context()
+        , ramcloud(&context, "mock:host=coordinator")
+        , locator("test:server=1")
+        , transport(&context)
+        , session(transport.getSession(&locator))
+        , queue()
+        , finished()
+        , callback()
+    {
+        queue.construct(&ramcloud, 3);
+        callback = [this](CompletionQueueTestRpc* rpc) {
+            if (!finished.empty())
+                finished += " ";
+            finished += format("%d", rpc->id);
+        };
+    }
+
+    /// Returns the most recently sent RPC.
+    CompletionQueueTestRpc*
+    lastRpc()
+    {
+        return dynamic_cast<CompletionQueueTestRpc*>(transport.lastNotifier);
+    }
+
+    void
+    start(int id)
+    {
+        queue->start<CompletionQueueTestRpc>(callback, session, id);
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(CompletionQueueTest);
+};
+
+TEST_F(CompletionQueueTest, destructor) {
+    start(1);
+    start(2);
+    transport.outputLog.clear();
+    queue.destroy();
+    EXPECT_EQ("cancel:  | cancel: ", transport.outputLog);
+    EXPECT_EQ("", finished);
+}
+
+TEST_F(CompletionQueueTest, poll) {
+    start(1);
+    CompletionQueueTestRpc* rpc1 = lastRpc();
+    start(2);
+    CompletionQueueTestRpc* rpc2 = lastRpc();
+    start(3);
+    EXPECT_EQ(0U, queue->poll());
+    EXPECT_EQ(3U, queue->size());
+
+    rpc2->respond(STATUS_OK);
+    rpc1->respond(STATUS_OK);
+    EXPECT_EQ(2U, queue->poll());
+    EXPECT_EQ("2 1", finished);
+    EXPECT_EQ(1U, queue->size());
+    EXPECT_EQ(0U, queue->poll());
+}
+
+TEST_F(CompletionQueueTest, poll_retry) {
+    Cycles::mockTscValue = 1000;
+    start(1);
+    lastRpc()->respond(STATUS_RETRY);
+    EXPECT_EQ(0U, queue->poll());
+    EXPECT_EQ(1U, queue->retrying.size());
+
+    // Not time to retry yet.
+    transport.outputLog.clear();
+    EXPECT_EQ(0U, queue->poll());
+    EXPECT_EQ("", transport.outputLog);
+    EXPECT_EQ(1U, queue->retrying.size());
+
+    Cycles::mockTscValue += Cycles::fromSeconds(1.0);
+    EXPECT_EQ(0U, queue->poll());
+    EXPECT_EQ("sendRequest: ", transport.outputLog);
+    EXPECT_EQ(0U, queue->retrying.size());
+
+    lastRpc()->respond(STATUS_OK);
+    EXPECT_EQ(1U, queue->poll());
+    EXPECT_EQ("1", finished);
+    Cycles::mockTscValue = 0;
+}
+
+TEST_F(CompletionQueueTest, poll_callbackStartsRpc) {
+    callback = [this](CompletionQueueTestRpc* rpc) {
+        finished += format("%d ", rpc->id);
+        if (rpc->id < 3)
+            start(rpc->id + 1);
+    };
+    start(1);
+    for (int i = 0; i < 3; i++) {
+        lastRpc()->respond(STATUS_OK);
+        EXPECT_EQ(1U, queue->poll());
+    }
+    EXPECT_EQ("1 2 3 ", finished);
+    EXPECT_EQ(0U, queue->size());
+}
+
+TEST_F(CompletionQueueTest, poll_callbackThrows) {
+    callback = [this](CompletionQueueTestRpc* rpc) {
+        finished += format("%d ", rpc->id);
+        if (rpc->id == 1)
+            throw RetryException(HERE, 0, 0, "callback failed");
+    };
+    start(1);
+    CompletionQueueTestRpc* rpc1 = lastRpc();
+    start(2);
+    rpc1->respond(STATUS_OK);
+    lastRpc()->respond(STATUS_OK);
+    EXPECT_THROW(queue->poll(), RetryException);
+    EXPECT_EQ(1U, queue->size());
+    EXPECT_EQ(1U, queue->poll());
+    EXPECT_EQ("1 2 ", finished);
+}
+
+TEST_F(CompletionQueueTest, start_finishedDuringConstructor) {
+    transport.setInput("0");
+    start(1);
+    EXPECT_EQ(1U, queue->poll());
+    EXPECT_EQ("1", finished);
+}
+
+TEST_F(CompletionQueueTest, start_queueFull) {
+    start(1);
+    start(2);
+    start(3);
+    lastRpc()->respond(STATUS_OK);
+    start(4);
+    EXPECT_EQ("3", finished);
+    EXPECT_EQ(3U, queue->size());
+}
+
+TEST_F(CompletionQueueTest, waitAll) {
+    transport.setInput("0");
+    start(1);
+    transport.setInput("0");
+    start(2);
+    queue->waitAll();
+    EXPECT_EQ("1 2", finished);
+    EXPECT_EQ(0U, queue->size());
+}
+
+TEST_F(CompletionQueueTest, finish_transportFailure) {
+    transport.setInput(NULL);
+    start(1);
+    EXPECT_EQ(1U, queue->poll());
+    EXPECT_EQ("1", finished);
+}
+
+} // namespace RAMCloud
@@ -50,6 +50,7 @@ main(int argc, char *argv[])
 {
     Logger::installCrashBacktraceHandlers();
     string localLocator("???");
+    double balanceInterval;
     uint32_t deadServerTimeout;
     uint32_t maxCores;
     bool reset;
@@ -57,6 +58,13 @@ main(int argc, char *argv[])
     try {
         OptionsDescription coordinatorOptions("Coordinator");
         coordinatorOptions.add_options()
+            ("balanceInterval",
+             ProgramOptions::value<double>(&balanceInterval)->
+                default_value(0),
+             "Number of seconds between runs of the tablet balancer, which "
+             "splits tablets that receive a large share of the cluster's "
+             "requests and migrates tablets to even out request load and "
+             "memory use across masters. 0 disables automatic balancing.")
             ("deadServerTimeout,d",
              ProgramOptions::value<uint32_t>(&deadServerTimeout)->
                 default_value(250),
@@ -143,7 +151,8 @@ main(int argc, char *argv[])
         CoordinatorService coordinatorService(&context,
                                               deadServerTimeout,
                                               false,
-                                              neverKill);
+                                              neverKill,
+                                              balanceInterval);
         AdminService adminService(&context, NULL, NULL);
         while (true) {
             context.dispatch->poll();
@@ -41,11 +41,16 @@ bool CoordinatorService::forceSynchronousInit = false;
  * \param unitTesting
  *      False (typical usage) means we should start the various manager threads.
  *      True is used only during testing to not run various background tasks.
+ * \param neverKill
+ *      If true, this coordinator will never kill a master.
+ * \param balanceInterval
+ *      Seconds between runs of the TabletBalancer; 0 disables it.
  */
 CoordinatorService::CoordinatorService(Context* context,
                                        uint32_t deadServerTimeout,
                                        bool unitTesting,
-                                       bool neverKill)
+                                       bool neverKill,
+                                       double balanceInterval)
     : context(context)
     , deadServerTimeout(deadServerTimeout)
     , updateManager(context->externalStorage)
@@ -54,6 +59,7 @@ CoordinatorService::CoordinatorService(Context* context,
     , leaseAuthority(context)
     , runtimeOptions()
     , recoveryManager(context, tableManager, &runtimeOptions)
+    , tabletBalancer(context, &tableManager, balanceInterval)
     , activeVerifications()
     , mutex("CoordinatorService::mutex")
     , forceServerDownForTesting(false)
@@ -82,6 +88,7 @@ CoordinatorService::CoordinatorService(Context* context,
 CoordinatorService::~CoordinatorService()
 {
     context->services[WireFormat::COORDINATOR_SERVICE] = NULL;
+    tabletBalancer.stop();
     recoveryManager.halt();
 }
 
@@ -124,6 +131,7 @@ CoordinatorService::init(CoordinatorService* service,
             // it will need accurate information about which tables are stored
             // on a crashed server).
             service->recoveryManager.start();
+            service->tabletBalancer.start();
         }
 
 
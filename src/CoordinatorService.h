@@ -34,6 +34,7 @@
 #include "RuntimeOptions.h"
 #include "Service.h"
 #include "TableManager.h"
+#include "TabletBalancer.h"
 #include "TransportManager.h"
 #include "ServerConfig.h"
 
@@ -47,7 +48,8 @@ class CoordinatorService : public Service {
     explicit CoordinatorService(Context* context,
                                 uint32_t deadServerTimeout,
                                 bool unitTesting = false,
-                                bool neverKill = false);
+                                bool neverKill = false,
+                                double balanceInterval = 0);
     ~CoordinatorService();
     void dispatch(WireFormat::Opcode opcode,
             Rpc* rpc);
@@ -200,6 +202,12 @@ class CoordinatorService : public Service {
      */
     MasterRecoveryManager recoveryManager;
 
+    /**
+     * Splits hot tablets and migrates tablets between masters to even out
+     * load; idle unless the coordinator was started with a balance interval.
+     */
+    TabletBalancer tabletBalancer;
+
     /**
      * Keeps track of the servers that we are currently checking to see if
      * they have failed,so we don't start multiple simultaneous checks
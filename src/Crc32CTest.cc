@@ -126,6 +126,42 @@ TEST_P(Crc32CTest, updateFromBuffer) {
     EXPECT_EQ(c.result, d.result);
 }
 
+TEST_P(Crc32CTest, largeBuffers) {
+    // Exercise the interleaved hardware path, its combining step, and the
+    // transitions between long, short and serial processing.
+    vector<uint8_t> data(3 * 8192 * 2 + 3 * 256 * 2 + 17);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = static_cast<uint8_t>(generateRandom());
+    uint32_t lengths[] = { 767, 768, 769, 3 * 256 * 2 + 5, 3 * 8192 - 1,
+                           3 * 8192, 3 * 8192 + 3 * 256 + 9,
+                           downCast<uint32_t>(data.size()) };
+    foreach (uint32_t length, lengths) {
+        EXPECT_EQ(Crc32C(true).update(&data[0], length).getResult(),
+                  Crc32C(forceSoftware).update(&data[0], length).getResult())
+            << "length " << length;
+        EXPECT_EQ(Crc32C(true).update(&data[1], length).getResult(),
+                  Crc32C(forceSoftware).update(&data[1], length).getResult())
+            << "unaligned length " << length;
+    }
+}
+
+TEST_P(Crc32CTest, computeMany) {
+    vector<uint8_t> data(4096);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = static_cast<uint8_t>(generateRandom());
+    const uint32_t count = 7;
+    const void* buffers[count];
+    uint32_t lengths[count] = { 100, 0, 33, 1000, 8, 7, 4000 };
+    Crc32C::ResultType results[count];
+    for (uint32_t i = 0; i < count; i++)
+        buffers[i] = &data[i * 3];
+    Crc32C::computeMany(count, buffers, lengths, results);
+    for (uint32_t i = 0; i < count; i++) {
+        EXPECT_EQ(Crc32C(true).update(buffers[i], lengths[i]).getResult(),
+                  results[i]) << "buffer " << i;
+    }
+}
+
 TEST_P(Crc32CTest, assignmentOperator) {
     Crc32C a;
     a.update(&a, sizeof(a));
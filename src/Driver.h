@@ -327,6 +327,48 @@ class Driver {
      */
     virtual void registerMemory(void* base, size_t bytes) {}
 
+    /**
+     * Return a value that identifies all of the packets passed to
+     * #sendPacket so far. It can be passed to #isTransmitComplete later to
+     * find out whether the driver is finished with the payloads of those
+     * packets.
+     */
+    virtual uint64_t getTransmitMark() { return 0; }
+
+    /**
+     * Return whether the driver (and the NIC) are finished with the payload
+     * memory of every packet passed to #sendPacket before \a mark was
+     * obtained from #getTransmitMark. Drivers that transmit directly out
+     * of memory registered with #registerMemory may read a payload long
+     * after sendPacket returns; callers must not reclaim that memory (for
+     * instance, by letting the log cleaner free a segment whose objects
+     * were appended to a reply without copying) until this returns true.
+     * Drivers that copy payloads before sendPacket returns need not
+     * override this method.
+     *
+     * \param mark
+     *      A value previously returned by #getTransmitMark.
+     */
+    virtual bool isTransmitComplete(uint64_t mark) { return true; }
+
+    /**
+     * Indicates that the caller is about to invoke #sendPacket several
+     * times in a row. Until the next call to #flushTransmitBatch, the
+     * driver may queue packets rather than transmitting each one as it
+     * arrives, so that it can hand them to the NIC or kernel together
+     * (for example, UdpDriver transmits a batch with a single sendmmsg
+     * call). As always, callers must preserve payload data until
+     * #isTransmitComplete indicates that the driver is done with it.
+     */
+    virtual void startTransmitBatch() {}
+
+    /**
+     * Transmit any packets queued since the last call to
+     * #startTransmitBatch; after this method returns, #sendPacket
+     * transmits packets immediately again.
+     */
+    virtual void flushTransmitBatch() {}
+
     /**
      * Send a single packet out over this Driver. The packet will not
      * necessarily have been transmitted before this method returns.  If an
@@ -351,7 +393,8 @@ class Driver {
      *      portion of the packet after the header).  May be NULL to
      *      indicate "no payload". Note: caller must preserve the buffer
      *      data (but not the actual iterator) even after the method returns,
-     *      since the data may not yet have been transmitted.
+     *      since the data may not yet have been transmitted (see
+     *      #isTransmitComplete).
      * \param priority
      *      The priority level of this packet. 0 is the lowest priority.
      */
@@ -38,6 +38,16 @@ struct EnumerateBucketArgs {
 
     /// A vector in which to place the resulting objects.
     std::vector<Log::Reference>* objectReferences;
+
+    /// Objects whose primary keys don't start with these keyPrefixLength
+    /// bytes are skipped. NULL means don't filter by key.
+    const void* keyPrefix;
+
+    /// Number of bytes in keyPrefix.
+    uint16_t keyPrefixLength;
+
+    /// Objects with versions less than this are skipped.
+    uint64_t minVersion;
 };
 
 /**
@@ -76,6 +86,16 @@ enumerateBucket(uint64_t reference, void* cookie)
         return;
     }
 
+    // Apply the scan filters, if any.
+    if (args.keyPrefix != NULL &&
+        (key.getStringKeyLength() < args.keyPrefixLength ||
+         memcmp(key.getStringKey(), args.keyPrefix,
+                args.keyPrefixLength) != 0)) {
+        return;
+    }
+    if (args.minVersion != 0 && Object(buffer).getVersion() < args.minVersion)
+        return;
+
     // Filter out objects from stale iterator entries. Skip the
     // topmost entry, which refers to the current master's state.
     for (int64_t frameIndex = static_cast<int64_t>(args.iter->size()) - 2;
@@ -119,6 +139,11 @@ enumerateBucket(uint64_t reference, void* cookie)
  *      The objects to append.
  * \param maxBytes
  *      The maximum number of bytes to append.
+ * \param emptySize
+ *      Size of the buffer before any objects were added to it. If the
+ *      buffer is still this size, the next object is appended even if it
+ *      exceeds maxBytes, so that every enumeration makes progress even
+ *      when the caller asks for less data than a single object.
  * \param keysOnly
  *      False means that full objects are returned, containing both keys
  *      and data. True means that the returned objects have
@@ -129,7 +154,8 @@ static int64_t
 appendObjectsToBuffer(Log& log,
                       Buffer* buffer,
                       std::vector<Log::Reference>& references,
-                      uint32_t maxBytes, bool keysOnly)
+                      uint32_t maxBytes, uint32_t emptySize,
+                      bool keysOnly)
 {
     for (uint32_t index = 0; index < references.size(); index++) {
         Buffer objectBuffer;
@@ -142,7 +168,8 @@ appendObjectsToBuffer(Log& log,
             length -= dataLength;
         }
 
-        if (buffer->size() + sizeof(length) + length > maxBytes) {
+        if (buffer->size() + sizeof(length) + length > maxBytes &&
+                buffer->size() > emptySize) {
             return index;
         }
 
@@ -256,9 +283,36 @@ Enumeration::Enumeration(uint64_t tableId,
     , objectMap(objectMap)
     , payload(payload)
     , maxPayloadBytes(maxPayloadBytes)
+    , keyPrefix(NULL)
+    , keyPrefixLength(0)
+    , minVersion(0)
 {
 }
 
+/**
+ * Restrict the objects returned by this enumeration; objects that don't
+ * match the filter are skipped entirely. This must be called before
+ * #complete, and the same filter must be used for all of the enumerations
+ * that share an EnumerationIterator.
+ *
+ * \param keyPrefix
+ *      If non-NULL, only objects whose primary keys begin with these bytes
+ *      are returned. The storage must remain valid until #complete returns.
+ * \param keyPrefixLength
+ *      Number of bytes in \a keyPrefix.
+ * \param minVersion
+ *      Only objects whose versions are at least this large are returned.
+ *      0 means don't filter by version.
+ */
+void
+Enumeration::setFilter(const void* keyPrefix, uint16_t keyPrefixLength,
+                       uint64_t minVersion)
+{
+    this->keyPrefix = keyPrefix;
+    this->keyPrefixLength = keyPrefixLength;
+    this->minVersion = minVersion;
+}
+
 /**
  * Completes an Enumeration. Upon return, the payload buffer will
  * contain objects to be returned to the client (if any are left in
@@ -294,33 +348,40 @@ Enumeration::complete()
     args.log = &log;
     args.iter = &iter;
     args.objectReferences = &objectRefs;
+    args.keyPrefix = keyPrefix;
+    args.keyPrefixLength = keyPrefixLength;
+    args.minVersion = minVersion;
     void* cookie = static_cast<void*>(&args);
     while (bucketIndex < numBuckets) {
         objectRefs.clear();
         bucketStart = payload.size();
         objectMap.forEachInBucket(enumerateBucket, cookie, bucketIndex);
         int64_t overflow = appendObjectsToBuffer(log, &payload, objectRefs,
-                                                 maxPayloadBytes, keysOnly);
+                maxPayloadBytes, initialPayloadLength, keysOnly);
         payloadFull = overflow >= 0;
         if (payloadFull) {
             break;
         }
         bucketIndex++;
+
+        // Progress within a partially enumerated bucket applies only to
+        // that bucket.
+        iter.top().bucketNextHash = 0;
     }
 
     // Clean up if last bucket is incomplete.
     if (payloadFull) {
         payload.truncate(bucketStart);
 
-        // If we failed to enumerate at least one entire bucket, then
-        // sort the current bucket and fill the buffer with whatever
-        // objects can fit.
-        if (iter.top().bucketIndex == bucketIndex) {
+        // If we failed to return any objects (the current bucket holds
+        // more than will fit), then sort the current bucket and fill the
+        // buffer with whatever objects can fit.
+        if (bucketStart == initialPayloadLength) {
             ObjectHashComparator comparator(log);
             std::sort(objectRefs.begin(), objectRefs.end(), comparator);
 
             int64_t overflow = appendObjectsToBuffer(log, &payload, objectRefs,
-                                                     maxPayloadBytes, keysOnly);
+                    maxPayloadBytes, initialPayloadLength, keysOnly);
             if (overflow >= 0) {
                 LogEntryType type;
                 Buffer buffer;
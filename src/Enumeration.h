@@ -33,6 +33,11 @@ namespace RAMCloud {
  * until the buffer fills up. The Enumeration also updates the
  * provided EnumerationIterator with the state necessary to resume on
  * the next EnumerationRPC.
+ *
+ * Enumerations are also used to service ScanRPCs, which may restrict
+ * the objects returned using a key prefix and minimum version (see
+ * setFilter); objects that don't match are skipped on the server and
+ * don't count against the payload limit.
  */
 class Enumeration {
   public:
@@ -47,6 +52,8 @@ class Enumeration {
                 HashTable& objectMap,
                 Buffer& payload, uint32_t maxPayloadBytes);
     void complete();
+    void setFilter(const void* keyPrefix, uint16_t keyPrefixLength,
+                   uint64_t minVersion);
 
   PRIVATE:
     /// The table containing the tablet being enumerated.
@@ -84,6 +91,16 @@ class Enumeration {
 
     /// The maximum number of bytes of objects to be returned.
     uint32_t maxPayloadBytes;
+
+    /// If non-NULL, only objects whose primary keys start with these
+    /// keyPrefixLength bytes are returned.
+    const void* keyPrefix;
+
+    /// Number of bytes in keyPrefix.
+    uint16_t keyPrefixLength;
+
+    /// Objects with versions less than this are not returned.
+    uint64_t minVersion;
 };
 
 }
@@ -0,0 +1,202 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+
+#include "Enumeration.h"
+#include "MasterTableMetadata.h"
+#include "Object.h"
+#include "ReplicaManager.h"
+#include "SegmentManager.h"
+#include "ServerConfig.h"
+#include "ServerList.h"
+
+namespace RAMCloud {
+
+class EnumerationTestHandlers : public LogEntryHandlers {
+  public:
+    uint32_t getTimestamp(LogEntryType type, Buffer& buffer) { return 0; }
+    void relocate(LogEntryType type,
+                  Buffer& oldBuffer,
+                  Log::Reference oldReference,
+                  LogEntryRelocator& relocator) { }
+};
+
+/**
+ * Unit tests for Enumeration. Objects are placed directly in a small hash
+ * table, so that tests can choose which bucket each one lands in.
+ */
+class EnumerationTest : public ::testing::Test {
+  public:
+    Context context;
+    ServerId serverId;
+    ServerList serverList;
+    ServerConfig serverConfig;
+    ReplicaManager replicaManager;
+    MasterTableMetadata masterTableMetadata;
+    SegletAllocator allocator;
+    SegmentManager segmentManager;
+    EnumerationTestHandlers entryHandlers;
+    Log log;
+    HashTable objectMap;
+    Buffer iterBuffer;
+    EnumerationIterator iter;
+    Buffer payload;
+    uint64_t nextTabletStartHash;
+
+    /// Number of buckets in #objectMap.
+    static const uint64_t NUM_BUCKETS = 2;
+
+    EnumerationTest()
+        : context()
+        , serverId(ServerId(57, 0))
+        , serverList(&context)
+        , serverConfig(ServerConfig::forTesting())
+        , replicaManager(&context, &serverId, 0, false, false)
+        , masterTableMetadata()
+        , allocator(&serverConfig)
+        , segmentManager(&context, &serverConfig, &serverId,
+                         allocator, replicaManager, &masterTableMetadata)
+        , entryHandlers()
+        , log(&context, &serverConfig, &entryHandlers,
+              &segmentManager, &replicaManager)
+        , objectMap(NUM_BUCKETS)
+        , iterBuffer()
+        , iter(iterBuffer, 0, 0)
+        , payload()
+        , nextTabletStartHash(0)
+    {
+    }
+
+    /// Return the hash table bucket that \a key belongs in.
+    uint64_t
+    bucketOf(const string& key)
+    {
+        Key k(1, key.c_str(), downCast<uint16_t>(key.size()));
+        uint64_t unused;
+        return HashTable::findBucketIndex(NUM_BUCKETS, k.getHash(), &unused);
+    }
+
+    /// Return the key hash of \a key in table 1.
+    KeyHash
+    hashOf(const string& key)
+    {
+        return Key(1, key.c_str(), downCast<uint16_t>(key.size())).getHash();
+    }
+
+    /// Append an object in table 1 to the log and add it to #objectMap.
+    void
+    addObject(const string& key, uint32_t valueLength)
+    {
+        Key k(1, key.c_str(), downCast<uint16_t>(key.size()));
+        string value(valueLength, 'v');
+        Buffer buffer;
+        Object object(k, value.c_str(), valueLength, 1, 0, buffer);
+        Buffer serialized;
+        object.assembleForLog(serialized);
+        Log::Reference reference;
+        ASSERT_TRUE(log.append(LOG_ENTRY_TYPE_OBJ, serialized, &reference));
+        objectMap.insert(k.getHash(), reference.toInteger());
+    }
+
+    /// Run one enumeration of all of table 1 and return the keys of the
+    /// objects it returned, in order, separated by spaces.
+    string
+    enumerate(uint32_t maxPayloadBytes)
+    {
+        payload.reset();
+        Enumeration enumeration(1, false, 0, 0, ~0UL, &nextTabletStartHash,
+                                iter, log, objectMap, payload,
+                                maxPayloadBytes);
+        enumeration.complete();
+
+        string result;
+        uint32_t offset = 0;
+        while (offset < payload.size()) {
+            uint32_t length = *payload.getOffset<uint32_t>(offset);
+            offset += sizeof32(length);
+            Object object(payload, offset, length);
+            uint16_t keyLength;
+            const void* key = object.getKey(0, &keyLength);
+            if (!result.empty())
+                result += " ";
+            result.append(static_cast<const char*>(key), keyLength);
+            offset += length;
+        }
+        return result;
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(EnumerationTest);
+};
+
+TEST_F(EnumerationTest, complete_resetBucketNextHash) {
+    // Pick the object with the largest key hash in bucket 0, and any
+    // object in bucket 1 with a smaller key hash.
+    std::vector<string> keys;
+    for (int i = 0; i < 20; i++)
+        keys.push_back(format("key%d", i));
+    string first, second;
+    foreach (const string& key, keys) {
+        if (bucketOf(key) == 0 &&
+                (first.empty() || hashOf(key) > hashOf(first)))
+            first = key;
+    }
+    foreach (const string& key, keys) {
+        if (bucketOf(key) == 1 && hashOf(key) < hashOf(first))
+            second = key;
+    }
+    ASSERT_NE("", first);
+    ASSERT_NE("", second);
+    addObject(first, 10);
+    addObject(second, 10);
+
+    // Resume in the middle of bucket 0, at the first object. The progress
+    // through bucket 0 mustn't be applied to bucket 1.
+    iter.push(EnumerationIterator::Frame(0, ~0UL, NUM_BUCKETS, 0,
+                                         hashOf(first)));
+    EXPECT_EQ(first + " " + second, enumerate(1000));
+    EXPECT_EQ(2U, iter.top().bucketIndex);
+    EXPECT_EQ(0U, iter.top().bucketNextHash);
+    EXPECT_EQ("", enumerate(1000));
+    EXPECT_EQ(0U, iter.size());
+    EXPECT_EQ(0U, nextTabletStartHash);
+}
+
+TEST_F(EnumerationTest, complete_firstObjectDoesntFit) {
+    // Bucket 0 is empty and bucket 1 holds two objects, each larger than
+    // a whole response.
+    std::vector<string> keys;
+    for (int i = 0; keys.size() < 2; i++) {
+        string key = format("key%d", i);
+        if (bucketOf(key) == 1)
+            keys.push_back(key);
+    }
+    if (hashOf(keys[0]) > hashOf(keys[1]))
+        std::swap(keys[0], keys[1]);
+    addObject(keys[0], 100);
+    addObject(keys[1], 100);
+
+    // Each enumeration returns one object, in key hash order, rather than
+    // an empty response that would look like the end of the tablet.
+    EXPECT_EQ(keys[0], enumerate(50));
+    EXPECT_EQ(1U, iter.top().bucketIndex);
+    EXPECT_EQ(hashOf(keys[1]), iter.top().bucketNextHash);
+    EXPECT_EQ(keys[1], enumerate(50));
+    EXPECT_EQ("", enumerate(50));
+    EXPECT_EQ(0U, iter.size());
+    EXPECT_EQ(0U, nextTabletStartHash);
+}
+
+}  // namespace RAMCloud
@@ -13,11 +13,16 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <immintrin.h>
+
 #include "Common.h"
 #include "HashTable.h"
 
 namespace RAMCloud {
 
+HashTable::ProbeImplementation HashTable::probeImplementation =
+        HashTable::fastestProbeImplementation();
+
 /**
  * Reinitialize a hash table entry as unused.
  */
@@ -212,33 +217,28 @@ HashTable::Candidates::remove()
 void
 HashTable::Candidates::next()
 {
-    while (true) {
-        // Not found in the cache line, see if there's a chain to
-        // another cache line.
-        if (index == ENTRIES_PER_CACHE_LINE && bucket != NULL) {
-            Entry* entry = &bucket->entries[ENTRIES_PER_CACHE_LINE - 1];
-            bucket = entry->getChainPointer();
-            index = -1;
-        }
-
-        if (bucket == NULL)
+    while (bucket != NULL) {
+        // Find every entry in the cache line whose hash matches, then skip
+        // the ones at or before the candidate we last returned. The
+        // unsigned wraparound of index + 1 makes this skip nothing when
+        // starting a new cache line.
+        uint32_t matches = probeCacheLine(bucket, secondaryHash);
+        matches &= ~0U << (index + 1);
+        if (matches != 0) {
+            // The hash within the hash table entry matches, so with
+            // high probability this is the pointer we're looking
+            // for. We'll report this index to the user of this
+            // class in the next getReference() call so that they
+            // can verify the match.
+            index = downCast<uint32_t>(BitOps::findFirstSet(matches) - 1);
             return;
-
-        // Resume in the current cache line.
-        index++;
-        Entry* candidate = &bucket->entries[index];
-        while (index < ENTRIES_PER_CACHE_LINE) {
-            if (candidate->hashMatches(secondaryHash)) {
-                // The hash within the hash table entry matches, so with
-                // high probability this is the pointer we're looking
-                // for. We'll report this index to the user of this
-                // class in the next getReference() call so that they
-                // can verify the match.
-                return;
-            }
-            candidate++;
-            index++;
         }
+
+        // Not found in the cache line, see if there's a chain to
+        // another cache line.
+        Entry* entry = &bucket->entries[ENTRIES_PER_CACHE_LINE - 1];
+        bucket = entry->getChainPointer();
+        index = -1;
     }
 }
 
@@ -262,7 +262,11 @@ HashTable::Candidates::isDone()
  */
 HashTable::HashTable(uint64_t numBuckets)
     : numBuckets(BitOps::powerOfTwoLessOrEqual(numBuckets))
-    , buckets(this->numBuckets * sizeof(CacheLine))
+    , buckets(this->numBuckets * sizeof(CacheLine), NUMA_INTERLEAVE)
+    , oldBuckets(NULL)
+    , layout(NULL)
+    , untaggedMemory()
+    , taggedMemory()
 {
     if (numBuckets != this->numBuckets) {
         RAMCLOUD_LOG(DEBUG,
@@ -273,6 +277,8 @@ HashTable::HashTable(uint64_t numBuckets)
 
     if (numBuckets == 0)
         throw Exception(HERE, "HashTable numBuckets == 0?!");
+
+    layout = new Layout(buckets.get(), this->numBuckets, NULL, 0);
 }
 
 /**
@@ -280,23 +286,23 @@ HashTable::HashTable(uint64_t numBuckets)
  */
 HashTable::~HashTable()
 {
-    uint32_t lastEntryIndex = ENTRIES_PER_CACHE_LINE - 1;
-
-    for (uint64_t i = 0; i < numBuckets; ++i) {
-        CacheLine* currBucket = &buckets.get()[i];
+    for (uint64_t i = 0; i < numBuckets; ++i)
+        freeOverflowChain(&buckets.get()[i]);
 
-        // Skip the first bucket and break the chain
-        Entry* last = &currBucket->entries[lastEntryIndex];
-        currBucket = last->getChainPointer();
-        last->clear();
-
-        while (currBucket != NULL) {
-            CacheLine *nextBucket
-                        = currBucket->entries[lastEntryIndex].getChainPointer();
-            free(currBucket);
-            currBucket = nextBucket;
-        }
+    // Overflow lines of buckets that were already migrated have been
+    // retired; only the remaining old buckets own their chains.
+    Layout* current = layout.load();
+    if (oldBuckets != NULL) {
+        for (uint64_t i = current->nextBucketToMigrate;
+                i < current->oldNumBuckets; ++i)
+            freeOverflowChain(&oldBuckets->get()[i]);
+        delete oldBuckets;
     }
+    delete current;
+
+    untaggedMemory.release();
+    foreach(RetiredMemory& memory, taggedMemory)
+        memory.release();
 }
 
 /**
@@ -339,37 +345,10 @@ void
 HashTable::insert(KeyHash keyHash, uint64_t reference)
 {
     uint64_t secondaryHash;
-    int overflowBuckets = 0;
     CacheLine* bucket = findBucket(keyHash, &secondaryHash);
-    while (true) {
-        Entry* entry = bucket->entries;
-        for (size_t i = 0; i < ENTRIES_PER_CACHE_LINE; i++) {
-            if (entry->isAvailable()) {
-                entry->setReference(secondaryHash, reference);
-                return;
-            }
-            entry++;
-        }
-
-        // No free space in the current bucket; see if there is an
-        // overflow bucket chained onto this one.
-        ++overflowBuckets;
-        Entry* last = &bucket->entries[ENTRIES_PER_CACHE_LINE - 1];
-        bucket = last->getChainPointer();
-        if (bucket == NULL) {
-            // no empty space found, allocate a new cache line
-            RAMCLOUD_CLOG(NOTICE, "Allocating overflow bucket %d for index %lu",
-                    overflowBuckets,
-                    findBucketIndex(numBuckets, keyHash, &secondaryHash));
-            void *buf = Memory::xmemalign(HERE, sizeof(CacheLine),
-                                          sizeof(CacheLine));
-            bucket = static_cast<CacheLine *>(buf);
-            bucket->entries[0] = *last;
-            for (size_t i = 1; i < ENTRIES_PER_CACHE_LINE; i++)
-                bucket->entries[i].clear();
-            last->setChainPointer(bucket);
-        }
-    }
+    insertIntoBucket(bucket, findBucketIndex(numBuckets, keyHash,
+                                             &secondaryHash),
+                     secondaryHash, reference);
 }
 
 /**
@@ -380,7 +359,12 @@ HashTable::insert(KeyHash keyHash, uint64_t reference)
  * \param cookie
  *      An opaque parameter to pass to the callback function.
  * \param bucket
- *      An index into the HashTable's buckets.  Must be < #numBuckets.
+ *      An index into the HashTable's buckets.  Should be < #getNumBuckets().
+ *      While a resize is in progress, this covers every physical bucket
+ *      in either array whose keys map to this index. Callers that don't
+ *      hold the bucket lock may pass an index that was valid when they
+ *      called #getNumBuckets(); if the table has shrunk since, the
+ *      index covers only the buckets that still exist, if any.
  * \return
  *      The total number of callbacks fired (i.e. the number of elements
  *      in the HashTable).
@@ -390,22 +374,25 @@ HashTable::forEachInBucket(void (*callback)(uint64_t, void *),
                            void *cookie,
                            uint64_t bucket)
 {
+    const Layout* current = layout.load(std::memory_order_acquire);
+    if (expect_true(current->oldBuckets == NULL)) {
+        if (bucket >= current->numBuckets)
+            return 0;
+        return forEachInChain(callback, cookie, &current->buckets[bucket]);
+    }
+
     uint64_t numCalls = 0;
-    CacheLine *cl = &buckets.get()[bucket];
-    while (1) {
-        for (uint32_t j = 0; j < ENTRIES_PER_CACHE_LINE; j++) {
-            Entry *e = &cl->entries[j];
-            if (!e->isAvailable() && e->getChainPointer() == NULL) {
-                callback(e->getReference(), cookie);
-                numCalls++;
-            }
+    uint64_t stride = std::min(current->numBuckets, current->oldNumBuckets);
+    uint64_t nextBucketToMigrate =
+            current->nextBucketToMigrate.load(std::memory_order_acquire);
+    for (uint64_t i = bucket; i < current->oldNumBuckets; i += stride) {
+        if (i >= nextBucketToMigrate) {
+            numCalls += forEachInChain(callback, cookie,
+                                       &current->oldBuckets[i]);
         }
-
-        Entry *entry = &cl->entries[ENTRIES_PER_CACHE_LINE - 1];
-        cl = entry->getChainPointer();
-        if (cl == NULL)
-            break;
     }
+    for (uint64_t i = bucket; i < current->numBuckets; i += stride)
+        numCalls += forEachInChain(callback, cookie, &current->buckets[i]);
     return numCalls;
 }
 
@@ -425,14 +412,16 @@ HashTable::forEach(void (*callback)(uint64_t, void *), void *cookie)
 {
     uint64_t numCalls = 0;
 
-    for (uint64_t i = 0; i < numBuckets; i++)
+    for (uint64_t i = 0; i < getNumBuckets(); i++)
         numCalls += forEachInBucket(callback, cookie, i);
 
     return numCalls;
 }
 
 /**
- * Prefetch the cacheline associated with the given key hash.
+ * Prefetch the cacheline associated with the given key hash. This may be
+ * called without holding the bucket lock, even while the table is being
+ * resized.
  */
 void
 HashTable::prefetchBucket(KeyHash keyHash)
@@ -461,12 +450,16 @@ HashTable::entriesPerCacheLine()
 }
 
 /**
- * Returns the number of buckets allocated to the table.
+ * Returns the number of buckets allocated to the table. While a resize is in
+ * progress, this is the smaller of the old and new sizes (see \ref resize).
  */
 uint64_t
 HashTable::getNumBuckets() const
 {
-    return numBuckets;
+    const Layout* current = layout.load(std::memory_order_acquire);
+    if (current->oldBuckets != NULL)
+        return std::min(current->numBuckets, current->oldNumBuckets);
+    return current->numBuckets;
 }
 
 /**
@@ -506,13 +499,534 @@ HashTable::findBucketIndex(uint64_t numBuckets,
  * \param[out] secondaryHash
  *      The secondary hash bits (16 bits).
  * \return
- *      The bucket corresponding to the given key.
+ *      The bucket corresponding to the given key. If the caller doesn't hold
+ *      the bucket lock, this may be a retired bucket that a resize has since
+ *      moved, but its memory remains valid until #freeRetiredMemory()
+ *      releases it.
  */
 HashTable::CacheLine*
 HashTable::findBucket(KeyHash keyHash, uint64_t *secondaryHash) //const
 {
-    uint64_t bucketIndex = findBucketIndex(numBuckets, keyHash, secondaryHash);
-    return &buckets.get()[bucketIndex];
+    const Layout* current = layout.load(std::memory_order_acquire);
+    if (expect_false(current->oldBuckets != NULL)) {
+        uint64_t oldIndex = findBucketIndex(current->oldNumBuckets, keyHash,
+                                            secondaryHash);
+        if (oldIndex >= current->nextBucketToMigrate.load(
+                std::memory_order_acquire))
+            return &current->oldBuckets[oldIndex];
+    }
+    uint64_t bucketIndex = findBucketIndex(current->numBuckets, keyHash,
+                                           secondaryHash);
+    return &current->buckets[bucketIndex];
+}
+
+/**
+ * Store a reference in the first free entry of a bucket, allocating a new
+ * overflow cache line at the end of the chain if the bucket is full.
+ * \param bucket
+ *      First cache line of the bucket to insert into.
+ * \param bucketIndex
+ *      Index of the bucket; only used for logging.
+ * \param secondaryHash
+ *      The secondary hash bits of the key being inserted.
+ * \param reference
+ *      Reference to the new element to insert into the hash table.
+ */
+void
+HashTable::insertIntoBucket(CacheLine* bucket, uint64_t bucketIndex,
+                            uint64_t secondaryHash, uint64_t reference)
+{
+    int overflowBuckets = 0;
+    while (true) {
+        Entry* entry = bucket->entries;
+        for (size_t i = 0; i < ENTRIES_PER_CACHE_LINE; i++) {
+            if (entry->isAvailable()) {
+                entry->setReference(secondaryHash, reference);
+                return;
+            }
+            entry++;
+        }
+
+        // No free space in the current bucket; see if there is an
+        // overflow bucket chained onto this one.
+        ++overflowBuckets;
+        Entry* last = &bucket->entries[ENTRIES_PER_CACHE_LINE - 1];
+        bucket = last->getChainPointer();
+        if (bucket == NULL) {
+            // no empty space found, allocate a new cache line
+            RAMCLOUD_CLOG(NOTICE, "Allocating overflow bucket %d for index %lu",
+                    overflowBuckets, bucketIndex);
+            void *buf = Memory::xmemalign(HERE, sizeof(CacheLine),
+                                          sizeof(CacheLine));
+            bucket = static_cast<CacheLine *>(buf);
+            bucket->entries[0] = *last;
+            for (size_t i = 1; i < ENTRIES_PER_CACHE_LINE; i++)
+                bucket->entries[i].clear();
+            last->setChainPointer(bucket);
+        }
+    }
+}
+
+/**
+ * Apply the given callback function to each element stored in a chain of
+ * cache lines.
+ * \param callback
+ *      The callback to fire on each element.
+ * \param cookie
+ *      An opaque parameter to pass to the callback function.
+ * \param cl
+ *      First cache line of the chain.
+ * \return
+ *      The number of callbacks fired.
+ */
+uint64_t
+HashTable::forEachInChain(void (*callback)(uint64_t, void *),
+                          void *cookie,
+                          CacheLine* cl)
+{
+    uint64_t numCalls = 0;
+    while (1) {
+        for (uint32_t j = 0; j < ENTRIES_PER_CACHE_LINE; j++) {
+            Entry *e = &cl->entries[j];
+            if (!e->isAvailable() && e->getChainPointer() == NULL) {
+                callback(e->getReference(), cookie);
+                numCalls++;
+            }
+        }
+
+        Entry *entry = &cl->entries[ENTRIES_PER_CACHE_LINE - 1];
+        cl = entry->getChainPointer();
+        if (cl == NULL)
+            break;
+    }
+    return numCalls;
+}
+
+/**
+ * Free all overflow cache lines chained onto a bucket. The bucket itself
+ * is left with no chain.
+ * \param bucket
+ *      First cache line of the bucket, which lives in a bucket array.
+ */
+void
+HashTable::freeOverflowChain(CacheLine* bucket)
+{
+    uint32_t lastEntryIndex = ENTRIES_PER_CACHE_LINE - 1;
+
+    // Skip the first bucket and break the chain
+    Entry* last = &bucket->entries[lastEntryIndex];
+    CacheLine* currBucket = last->getChainPointer();
+    if (currBucket == NULL)
+        return;
+    last->clear();
+
+    while (currBucket != NULL) {
+        CacheLine *nextBucket
+                    = currBucket->entries[lastEntryIndex].getChainPointer();
+        free(currBucket);
+        currBucket = nextBucket;
+    }
+}
+
+/**
+ * Begin resizing the table. A new, empty array of buckets is allocated, and
+ * subsequent calls to #migrateBucket() move entries into it from the current
+ * array. The table may be used normally while the resize is in progress.
+ *
+ * The caller must ensure that no other thread is accessing the table during
+ * this call, except for readers that don't hold a bucket lock (see
+ * \ref resize).
+ *
+ * \param newNumBuckets
+ *      The number of buckets the table should have once the resize is
+ *      finished. This should be a power of two.
+ * \throw Exception
+ *      An exception is thrown if newNumBuckets is 0 or a resize is already
+ *      in progress.
+ */
+void
+HashTable::startResize(uint64_t newNumBuckets)
+{
+    newNumBuckets = BitOps::powerOfTwoLessOrEqual(newNumBuckets);
+    if (newNumBuckets == 0)
+        throw Exception(HERE, "HashTable numBuckets == 0?!");
+    if (oldBuckets != NULL)
+        throw Exception(HERE, "HashTable resize already in progress");
+
+    oldBuckets = new LargeBlockOfMemory<CacheLine>(
+            newNumBuckets * sizeof(CacheLine), NUMA_INTERLEAVE);
+    buckets.swap(*oldBuckets);
+    uint64_t oldNumBuckets = numBuckets;
+    numBuckets = newNumBuckets;
+
+    // Readers that don't hold a bucket lock may still be using the old
+    // layout, so it is retired rather than deleted.
+    Layout* resizing = new Layout(buckets.get(), numBuckets,
+                                  oldBuckets->get(), oldNumBuckets);
+    untaggedMemory.layouts.push_back(
+            layout.exchange(resizing, std::memory_order_release));
+}
+
+/**
+ * Return whether a resize started with #startResize() has not yet been
+ * completed with #finishResize().
+ */
+bool
+HashTable::isResizing() const
+{
+    return layout.load(std::memory_order_acquire)->oldBuckets != NULL;
+}
+
+/**
+ * Return the index of the old bucket that the next call to #migrateBucket()
+ * will move. While a resize is in progress, all keys in this bucket hash to
+ * the same bucket index as returned by #findBucketIndex() for the smaller of
+ * the two table sizes, so callers can use it to select a lock. Once every
+ * old bucket has been migrated, this returns the old number of buckets.
+ */
+uint64_t
+HashTable::getNextBucketToMigrate() const
+{
+    return layout.load(std::memory_order_acquire)->nextBucketToMigrate;
+}
+
+/**
+ * Move all entries in the next unmigrated bucket of the old array into the
+ * new array. The overflow cache lines of the old bucket are retired, not
+ * freed, so that concurrent unlocked readers never touch freed memory.
+ *
+ * The caller must ensure that no other thread accesses the bucket being
+ * migrated (or the buckets it migrates into) during this call.
+ *
+ * \param getKeyHash
+ *      Callback that returns the full key hash for a reference in the
+ *      table. Only used when the table is growing, since the new bucket of
+ *      an entry then depends on bits not retained in the entry.
+ * \param cookie
+ *      Opaque parameter passed to getKeyHash.
+ * \return
+ *      True if there are more buckets left to migrate, false if the resize
+ *      can now be completed with #finishResize().
+ */
+bool
+HashTable::migrateBucket(KeyHashCallback getKeyHash, void *cookie)
+{
+    Layout* current = layout.load(std::memory_order_relaxed);
+    uint64_t oldNumBuckets = current->oldNumBuckets;
+    uint64_t nextBucketToMigrate =
+            current->nextBucketToMigrate.load(std::memory_order_relaxed);
+    assert(current->oldBuckets != NULL);
+    assert(nextBucketToMigrate < oldNumBuckets);
+
+    CacheLine* first = &current->oldBuckets[nextBucketToMigrate];
+    CacheLine* cl = first;
+    while (cl != NULL) {
+        for (uint32_t j = 0; j < ENTRIES_PER_CACHE_LINE; j++) {
+            Entry *e = &cl->entries[j];
+            if (e->isAvailable() || e->getChainPointer() != NULL)
+                continue;
+
+            Entry::UnpackedEntry ue;
+            e->unpack(ue);
+            uint64_t newIndex;
+            if (numBuckets < oldNumBuckets) {
+                newIndex = nextBucketToMigrate & (numBuckets - 1);
+            } else {
+                uint64_t unused;
+                newIndex = findBucketIndex(numBuckets,
+                                           getKeyHash(ue.ptr, cookie),
+                                           &unused);
+            }
+            insertIntoBucket(&buckets.get()[newIndex], newIndex,
+                             ue.hash, ue.ptr);
+        }
+
+        CacheLine* next =
+            cl->entries[ENTRIES_PER_CACHE_LINE - 1].getChainPointer();
+        if (cl != first)
+            untaggedMemory.cacheLines.push_back(cl);
+        cl = next;
+    }
+
+    // The release makes the copies visible before lookups are redirected.
+    nextBucketToMigrate++;
+    current->nextBucketToMigrate.store(nextBucketToMigrate,
+                                       std::memory_order_release);
+    return nextBucketToMigrate < oldNumBuckets;
+}
+
+/**
+ * Complete a resize once every old bucket has been migrated. The old array
+ * of buckets is retired; see #freeRetiredMemory().
+ *
+ * The caller must ensure that no other thread is accessing the table during
+ * this call, except for readers that don't hold a bucket lock (see
+ * \ref resize).
+ */
+void
+HashTable::finishResize()
+{
+    Layout* current = layout.load(std::memory_order_relaxed);
+    assert(oldBuckets != NULL);
+    assert(current->nextBucketToMigrate == current->oldNumBuckets);
+
+    untaggedMemory.bucketArrays.push_back(oldBuckets);
+    oldBuckets = NULL;
+    untaggedMemory.layouts.push_back(layout.exchange(
+            new Layout(buckets.get(), numBuckets, NULL, 0),
+            std::memory_order_release));
+}
+
+/**
+ * Return whether there is memory from earlier resizes waiting to be
+ * released by #freeRetiredMemory().
+ */
+bool
+HashTable::hasRetiredMemory() const
+{
+    return !taggedMemory.empty() ||
+            !untaggedMemory.cacheLines.empty() ||
+            !untaggedMemory.bucketArrays.empty() ||
+            !untaggedMemory.layouts.empty();
+}
+
+/**
+ * Assign an epoch to all of the memory retired by #startResize(),
+ * #migrateBucket() and #finishResize() since the last call to this method.
+ * That memory is released by #freeRetiredMemory() once no reader from
+ * \a epoch or earlier remains; until it is tagged, it is never released.
+ *
+ * \param epoch
+ *      An epoch that is at least as late as that of any reader that could
+ *      have found the retired memory through the table. The owner must
+ *      choose it after the memory was retired, and tag memory with
+ *      nondecreasing epochs.
+ */
+void
+HashTable::tagRetiredMemory(uint64_t epoch)
+{
+    if (untaggedMemory.cacheLines.empty() &&
+            untaggedMemory.bucketArrays.empty() &&
+            untaggedMemory.layouts.empty())
+        return;
+
+    untaggedMemory.epoch = epoch;
+    taggedMemory.push_back(std::move(untaggedMemory));
+    untaggedMemory = RetiredMemory();
+}
+
+/**
+ * Release retired memory that no reader could still be using.
+ *
+ * \param earliestEpoch
+ *      The earliest epoch of any reader that is still running. Memory tagged
+ *      with an earlier epoch by #tagRetiredMemory() is released.
+ */
+void
+HashTable::freeRetiredMemory(uint64_t earliestEpoch)
+{
+    while (!taggedMemory.empty() &&
+            taggedMemory.front().epoch < earliestEpoch) {
+        taggedMemory.front().release();
+        taggedMemory.pop_front();
+    }
+}
+
+/**
+ * Free all of the memory held by this object.
+ */
+void
+HashTable::RetiredMemory::release()
+{
+    foreach(CacheLine* cl, cacheLines)
+        free(cl);
+    cacheLines.clear();
+
+    foreach(LargeBlockOfMemory<CacheLine>* block, bucketArrays)
+        delete block;
+    bucketArrays.clear();
+
+    foreach(Layout* retired, layouts)
+        delete retired;
+    layouts.clear();
+}
+
+
+/**
+ * Return the method currently used to search cache lines during lookups.
+ */
+HashTable::ProbeImplementation
+HashTable::getProbeImplementation()
+{
+    return probeImplementation;
+}
+
+/**
+ * Change the method used to search cache lines during lookups. This exists
+ * so that benchmarks and tests can compare the implementations; by default
+ * the fastest one the processor supports is used. This must not be called
+ * while any HashTable is being accessed.
+ *
+ * \param implementation
+ *      The method to use from now on.
+ * \return
+ *      True if the change was made, or false if this processor does not
+ *      support \a implementation (in which case nothing changes).
+ */
+bool
+HashTable::setProbeImplementation(ProbeImplementation implementation)
+{
+    if (!probeSupported(implementation))
+        return false;
+    probeImplementation = implementation;
+    return true;
+}
+
+/**
+ * Find all entries in a cache line that may refer to a key with the given
+ * secondary hash. This is the inner loop of every lookup, so rather than
+ * unpacking one Entry at a time it compares the whole cache line at once
+ * when the processor allows it.
+ *
+ * \param cl
+ *      Cache line to search.
+ * \param secondaryHash
+ *      Secondary hash bits of the key being looked up (see #findBucket()).
+ * \return
+ *      A mask with bit i set if cl->entries[i] holds a reference whose
+ *      secondary hash equals \a secondaryHash (see Entry::hashMatches()).
+ *      Chain pointers and unused entries never match.
+ */
+uint32_t
+HashTable::probeCacheLine(const CacheLine* cl, uint64_t secondaryHash)
+{
+    switch (probeImplementation) {
+    case PROBE_AVX2:
+        return probeAvx2(cl, secondaryHash);
+    case PROBE_SSE:
+        return probeSse(cl, secondaryHash);
+    default:
+        return probeScalar(cl, secondaryHash);
+    }
+}
+
+/**
+ * Implementation of #probeCacheLine() that checks one entry at a time.
+ */
+uint32_t
+HashTable::probeScalar(const CacheLine* cl, uint64_t secondaryHash)
+{
+    uint32_t matches = 0;
+    for (uint32_t i = 0; i < ENTRIES_PER_CACHE_LINE; i++) {
+        if (cl->entries[i].hashMatches(secondaryHash))
+            matches |= 1U << i;
+    }
+    return matches;
+}
+
+/*
+ * The vector implementations below work directly on the packed Entry::value
+ * words: an entry matches if its top 17 bits equal the secondary hash
+ * followed by a clear chain bit, and its low 47 bits (the reference) are
+ * not zero.
+ */
+namespace {
+const uint64_t PROBE_TAG_MASK = 0xffff800000000000UL;
+const uint64_t PROBE_PTR_MASK = 0x00007fffffffffffUL;
+} // anonymous namespace
+
+/**
+ * Implementation of #probeCacheLine() that checks two entries per
+ * instruction using SSE4.1's 64-bit compare. Falls back to #probeScalar()
+ * if the build does not target SSE4.1.
+ */
+uint32_t
+HashTable::probeSse(const CacheLine* cl, uint64_t secondaryHash)
+{
+#if __SSE4_1__
+    const __m128i tagMask = _mm_set1_epi64x(PROBE_TAG_MASK);
+    const __m128i ptrMask = _mm_set1_epi64x(PROBE_PTR_MASK);
+    const __m128i tag = _mm_set1_epi64x(secondaryHash << 48);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i* words = reinterpret_cast<const __m128i*>(cl->entries);
+    uint32_t matches = 0;
+    for (uint32_t i = 0; i < ENTRIES_PER_CACHE_LINE / 2; i++) {
+        __m128i v = _mm_loadu_si128(&words[i]);
+        __m128i hit = _mm_cmpeq_epi64(_mm_and_si128(v, tagMask), tag);
+        __m128i unused = _mm_cmpeq_epi64(_mm_and_si128(v, ptrMask), zero);
+        hit = _mm_andnot_si128(unused, hit);
+        matches |= static_cast<uint32_t>(
+                _mm_movemask_pd(_mm_castsi128_pd(hit))) << (2 * i);
+    }
+    return matches;
+#else
+    return probeScalar(cl, secondaryHash);
+#endif
+}
+
+/**
+ * Implementation of #probeCacheLine() that checks four entries per
+ * instruction using AVX2. This is compiled for AVX2 regardless of the
+ * build's target architecture, so it must only be used if #probeSupported()
+ * says the processor can run it.
+ */
+__attribute__((target("avx2")))
+uint32_t
+HashTable::probeAvx2(const CacheLine* cl, uint64_t secondaryHash)
+{
+    const __m256i tagMask = _mm256_set1_epi64x(PROBE_TAG_MASK);
+    const __m256i ptrMask = _mm256_set1_epi64x(PROBE_PTR_MASK);
+    const __m256i tag = _mm256_set1_epi64x(secondaryHash << 48);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i* words = reinterpret_cast<const __m256i*>(cl->entries);
+    uint32_t matches = 0;
+    for (uint32_t i = 0; i < ENTRIES_PER_CACHE_LINE / 4; i++) {
+        __m256i v = _mm256_loadu_si256(&words[i]);
+        __m256i hit = _mm256_cmpeq_epi64(_mm256_and_si256(v, tagMask), tag);
+        __m256i unused = _mm256_cmpeq_epi64(_mm256_and_si256(v, ptrMask),
+                                            zero);
+        hit = _mm256_andnot_si256(unused, hit);
+        matches |= static_cast<uint32_t>(
+                _mm256_movemask_pd(_mm256_castsi256_pd(hit))) << (4 * i);
+    }
+    return matches;
+}
+
+/**
+ * Return whether this processor (and build) can run the given
+ * implementation of #probeCacheLine().
+ */
+bool
+HashTable::probeSupported(ProbeImplementation implementation)
+{
+    switch (implementation) {
+    case PROBE_SCALAR:
+        return true;
+    case PROBE_SSE:
+#if __SSE4_1__
+        return __builtin_cpu_supports("sse4.1");
+#else
+        return false;
+#endif
+    case PROBE_AVX2:
+        return __builtin_cpu_supports("avx2");
+    }
+    return false;
+}
+
+/**
+ * Return the fastest implementation of #probeCacheLine() that this
+ * processor supports. Used to initialize #probeImplementation.
+ */
+HashTable::ProbeImplementation
+HashTable::fastestProbeImplementation()
+{
+    __builtin_cpu_init();
+    if (probeSupported(PROBE_AVX2))
+        return PROBE_AVX2;
+    if (probeSupported(PROBE_SSE))
+        return PROBE_SSE;
+    return PROBE_SCALAR;
 }
 
 } // namespace RAMCloud
@@ -16,6 +16,9 @@
 #ifndef RAMCLOUD_HASHTABLE_H
 #define RAMCLOUD_HASHTABLE_H
 
+#include <atomic>
+#include <deque>
+
 #include "Common.h"
 #include "BitOps.h"
 #include "CycleCounter.h"
@@ -52,6 +55,35 @@ namespace RAMCloud {
  * buckets). In this case, the last hash table entry in each of the
  * non-terminal cache lines has a pointer to the next cache line instead of a
  * log reference.
+ *
+ * Lookups compare the secondary hash against every entry of a cache line at
+ * once (see #probeCacheLine()), using AVX2 or SSE4.1 instructions when the
+ * processor supports them and a plain loop over the entries otherwise.
+ *
+ * \section resize Resizing
+ *
+ * The table can be resized online to any other power of two number of
+ * buckets. A resize is started with #startResize(), which allocates the new
+ * array of buckets, and then proceeds one bucket of the old array at a time
+ * with #migrateBucket() until #finishResize() can be called. While a resize
+ * is in progress, lookups and inserts for a key go to the old array if the
+ * key's old bucket has not been migrated yet and to the new array otherwise,
+ * so the table remains fully usable throughout.
+ *
+ * Some readers, such as #prefetchBucket() and enumerations, don't hold the
+ * owner's lock on the bucket they read, so they may run concurrently with
+ * any step of a resize. They see the arrays through a single #Layout that is
+ * replaced, never modified, when a resize starts or finishes (except for its
+ * migration progress), and no memory is released while they might still be
+ * using it: memory unlinked from the table is retired, and the owner tags it
+ * with an epoch (see #tagRetiredMemory()) and frees it with
+ * #freeRetiredMemory() once no reader from that epoch or earlier remains.
+ *
+ * Bucket indexes passed to and from the public interface (see
+ * #getNumBuckets() and #forEachInBucket()) always refer to the smaller of the
+ * two arrays during a resize. Every key maps to exactly one such bucket, and
+ * migration never moves a key from one of these buckets to another, so
+ * callers that iterate or lock by bucket index are unaffected by resizing.
  */
 class HashTable {
   PRIVATE:
@@ -130,6 +162,8 @@ class HashTable {
             ue.chain = (this->value >> 47) & 0x0000000000000001UL;
             ue.ptr   = this->value         & 0x00007fffffffffffUL;
         }
+
+        friend class HashTable;
     };
     static_assert(sizeof(Entry) == 8, "HashTable::Entry is not 8 bytes");
 
@@ -168,6 +202,9 @@ class HashTable {
     };
     static_assert(sizeof(CacheLine) == sizeof(Entry) * ENTRIES_PER_CACHE_LINE,
                   "HashTable entries don't fit evenly into a cacheline");
+    static_assert(ENTRIES_PER_CACHE_LINE % 4 == 0 &&
+                  ENTRIES_PER_CACHE_LINE <= 32,
+                  "probe match masks assume 4-entry vectors in a uint32_t");
 
   public:
     /**
@@ -217,6 +254,28 @@ class HashTable {
         friend class HashTable;
     };
 
+    /**
+     * Callback used during a resize to recover the full key hash of a
+     * reference stored in the table, since entries only retain the secondary
+     * hash bits. The first argument is the reference and the second is the
+     * opaque cookie passed to #migrateBucket().
+     */
+    typedef KeyHash (*KeyHashCallback)(uint64_t, void *);
+
+    /**
+     * The ways in which a cache line can be searched for entries matching a
+     * secondary hash. All of them produce identical results; they differ
+     * only in which instructions they need. See #setProbeImplementation().
+     */
+    enum ProbeImplementation {
+        /// Check one entry at a time. Works on any processor.
+        PROBE_SCALAR = 0,
+        /// Check two entries per instruction using SSE4.1.
+        PROBE_SSE = 1,
+        /// Check four entries per instruction using AVX2.
+        PROBE_AVX2 = 2,
+    };
+
     explicit HashTable(uint64_t numBuckets);
     ~HashTable();
     void lookup(KeyHash keyHash, Candidates& candidates);
@@ -232,6 +291,16 @@ class HashTable {
     static uint64_t findBucketIndex(uint64_t numBuckets,
                                     KeyHash keyHash,
                                     uint64_t *secondaryHash);
+    void startResize(uint64_t newNumBuckets);
+    bool isResizing() const;
+    uint64_t getNextBucketToMigrate() const;
+    bool migrateBucket(KeyHashCallback getKeyHash, void *cookie);
+    void finishResize();
+    bool hasRetiredMemory() const;
+    void tagRetiredMemory(uint64_t epoch);
+    void freeRetiredMemory(uint64_t earliestEpoch);
+    static ProbeImplementation getProbeImplementation();
+    static bool setProbeImplementation(ProbeImplementation implementation);
 
   PRIVATE:
 
@@ -239,19 +308,131 @@ class HashTable {
     class Entry;
     struct CacheLine;
 
+    /**
+     * Where the buckets of the table live. Once published in #layout, a
+     * Layout never changes except for #nextBucketToMigrate; #startResize()
+     * and #finishResize() publish a new one and retire the old. This lets
+     * readers that don't hold a bucket lock load a consistent view of the
+     * table all at once.
+     */
+    struct Layout {
+        Layout(CacheLine* buckets, uint64_t numBuckets,
+               CacheLine* oldBuckets, uint64_t oldNumBuckets)
+            : buckets(buckets)
+            , numBuckets(numBuckets)
+            , oldBuckets(oldBuckets)
+            , oldNumBuckets(oldNumBuckets)
+            , nextBucketToMigrate(0)
+        {
+        }
+
+        /// The array of buckets. While a resize is in progress, this is
+        /// the array being migrated into.
+        CacheLine* buckets;
+
+        /// The number of buckets in #buckets.
+        uint64_t numBuckets;
+
+        /// The array of buckets being migrated away from, or NULL if no
+        /// resize is in progress.
+        CacheLine* oldBuckets;
+
+        /// The number of buckets in #oldBuckets, or 0 if no resize is in
+        /// progress.
+        uint64_t oldNumBuckets;
+
+        /// Index into #oldBuckets of the next bucket to be migrated. Every
+        /// bucket with a lower index has been moved into #buckets; keys that
+        /// map to those buckets are looked up and inserted in the new array.
+        std::atomic<uint64_t> nextBucketToMigrate;
+
+        DISALLOW_COPY_AND_ASSIGN(Layout);
+    };
+
+    /**
+     * Memory that has been unlinked from the table but may still be in use
+     * by readers that don't hold a bucket lock.
+     */
+    struct RetiredMemory {
+        RetiredMemory()
+            : epoch(~0UL)
+            , cacheLines()
+            , bucketArrays()
+            , layouts()
+        {
+        }
+        void release();
+
+        /// The epoch given to #tagRetiredMemory() for this memory; it may be
+        /// released once every reader from this epoch or earlier is done.
+        uint64_t epoch;
+
+        /// Overflow cache lines of migrated buckets.
+        std::vector<CacheLine*> cacheLines;
+
+        /// Bucket arrays that have been fully migrated.
+        std::vector<LargeBlockOfMemory<CacheLine>*> bucketArrays;
+
+        /// Layouts that have been replaced.
+        std::vector<Layout*> layouts;
+    };
+
     CacheLine * findBucket(KeyHash keyHash, uint64_t *secondaryHash);
+    void insertIntoBucket(CacheLine* bucket, uint64_t bucketIndex,
+                          uint64_t secondaryHash, uint64_t reference);
+    static uint64_t forEachInChain(void (*callback)(uint64_t, void *),
+                                   void *cookie, CacheLine* cl);
+    static void freeOverflowChain(CacheLine* bucket);
+    static uint32_t probeCacheLine(const CacheLine* cl, uint64_t secondaryHash);
+    static uint32_t probeScalar(const CacheLine* cl, uint64_t secondaryHash);
+    static uint32_t probeSse(const CacheLine* cl, uint64_t secondaryHash);
+    static uint32_t probeAvx2(const CacheLine* cl, uint64_t secondaryHash);
+    static bool probeSupported(ProbeImplementation implementation);
+    static ProbeImplementation fastestProbeImplementation();
+
+    /**
+     * The method #probeCacheLine() uses to search cache lines. Chosen when
+     * the program starts to be the fastest one this processor supports.
+     */
+    static ProbeImplementation probeImplementation;
 
     /**
-     * The number of buckets allocated to the table.
+     * The number of buckets allocated to the table. While a resize is in
+     * progress, this is the size of the new array of buckets.
      */
-    const uint64_t numBuckets;
+    uint64_t numBuckets;
 
     /**
-     * The array of buckets.
+     * The array of buckets, interleaved across NUMA nodes since lookups
+     * come from every core.
      * See HashTable.
      */
     LargeBlockOfMemory<CacheLine> buckets;
 
+    /**
+     * The array of buckets being migrated away from during a resize. NULL if
+     * no resize is in progress.
+     */
+    LargeBlockOfMemory<CacheLine>* oldBuckets;
+
+    /**
+     * The current arrangement of #buckets and #oldBuckets. Every lookup goes
+     * through this, so that it sees both arrays as they were at one point
+     * in time even if it doesn't hold the bucket lock.
+     */
+    std::atomic<Layout*> layout;
+
+    /**
+     * Memory retired since the last call to #tagRetiredMemory().
+     */
+    RetiredMemory untaggedMemory;
+
+    /**
+     * Memory tagged by #tagRetiredMemory(), oldest first, that is waiting to
+     * be released by #freeRetiredMemory().
+     */
+    std::deque<RetiredMemory> taggedMemory;
+
     friend void hashTableBenchmark(uint64_t nkeys, uint64_t nlines);
     DISALLOW_COPY_AND_ASSIGN(HashTable);
 };
@@ -341,6 +341,7 @@ class HashTableTest : public ::testing::Test {
         }
 
         ht->buckets.swap(*cacheLines);
+        ht->layout.load()->buckets = ht->buckets.get();
         dummy.swap(*cacheLines);
         dummyHasOrigCacheLines = true;
     }
@@ -672,6 +673,60 @@ TEST_F(HashTableTest, lookup) {
     EXPECT_EQ(outRef, vRef);
 }
 
+TEST_F(HashTableTest, probeCacheLine) {
+    HashTable::CacheLine cl;
+    HashTable::CacheLine other;
+    for (uint32_t i = 0; i < HashTable::ENTRIES_PER_CACHE_LINE; i++)
+        cl.entries[i].setReference(0x1234, 0x1000 + i);
+    cl.entries[1].setReference(0x4321, 0x2000);
+    cl.entries[2].clear();
+    cl.entries[5].setReference(0x1234, 0x7fffffffffffUL);
+    cl.entries[seven].setChainPointer(&other);
+
+    HashTable::ProbeImplementation original =
+            HashTable::getProbeImplementation();
+    HashTable::ProbeImplementation implementations[] = {
+        HashTable::PROBE_SCALAR,
+        HashTable::PROBE_SSE,
+        HashTable::PROBE_AVX2,
+    };
+    foreach (HashTable::ProbeImplementation implementation,
+             implementations) {
+        if (!HashTable::setProbeImplementation(implementation))
+            continue;
+        EXPECT_EQ(0x79U, HashTable::probeCacheLine(&cl, 0x1234));
+        EXPECT_EQ(0x02U, HashTable::probeCacheLine(&cl, 0x4321));
+        EXPECT_EQ(0x00U, HashTable::probeCacheLine(&cl, 0x1235));
+
+        // Neither the cleared entry nor the chain pointer (which both have
+        // zero hash bits) may match a zero secondary hash.
+        EXPECT_EQ(0x00U, HashTable::probeCacheLine(&cl, 0));
+        cl.entries[2].setReference(0, 0x3000);
+        EXPECT_EQ(0x04U, HashTable::probeCacheLine(&cl, 0));
+        cl.entries[2].clear();
+    }
+    HashTable::setProbeImplementation(original);
+}
+
+TEST_F(HashTableTest, setProbeImplementation) {
+    HashTable::ProbeImplementation original =
+            HashTable::getProbeImplementation();
+    EXPECT_TRUE(HashTable::setProbeImplementation(HashTable::PROBE_SCALAR));
+    EXPECT_EQ(HashTable::PROBE_SCALAR, HashTable::getProbeImplementation());
+
+    setup(0, HashTable::ENTRIES_PER_CACHE_LINE * 5);
+    string key = format("%u", (HashTable::ENTRIES_PER_CACHE_LINE - 1) * 2);
+    EXPECT_EQ(&entryAt(&ht, 2, 0),
+              findBucketAndLookupEntry(&ht, 0, key.c_str(),
+                    downCast<uint16_t>(key.length())));
+
+    EXPECT_TRUE(HashTable::setProbeImplementation(original));
+    EXPECT_EQ(original, HashTable::getProbeImplementation());
+    EXPECT_EQ(&entryAt(&ht, 2, 0),
+              findBucketAndLookupEntry(&ht, 0, key.c_str(),
+                    downCast<uint16_t>(key.length())));
+}
+
 #if 0
 TEST_F(HashTableTest, remove) {
     HashTable ht(1);
@@ -821,4 +876,177 @@ TEST_F(HashTableTest, forEach) {
         EXPECT_EQ(1U, checkoff[i].count);
 }
 
+/**
+ * Callback used by the resize tests to recover a TestObject's key hash.
+ */
+static KeyHash
+test_resize_keyHash(uint64_t ref, void *cookie)
+{
+    TestObject* o = reinterpret_cast<TestObject*>(ref);
+    Key key(o->tableId, o->stringKeyPtr, o->stringKeyLength);
+    return key.getHash();
+}
+
+/**
+ * Insert keys "0" through "numKeys - 1" and check that every one of them
+ * can be found throughout a resize to newNumBuckets, and that forEach visits
+ * each exactly once at every step.
+ */
+static void
+checkResize(HashTableTest* test, uint64_t numBuckets, uint64_t newNumBuckets)
+{
+    HashTable ht(numBuckets);
+    const uint32_t arrayLen = 256;
+    TestObject checkoff[arrayLen] = {};
+    for (uint32_t i = 0; i < arrayLen; i++) {
+        checkoff[i].setKey(format("%u", i));
+        Key key(checkoff[i].tableId,
+                checkoff[i].stringKeyPtr,
+                checkoff[i].stringKeyLength);
+        test->replace(&ht, key, checkoff[i].u64Address());
+    }
+
+    ht.startResize(newNumBuckets);
+    EXPECT_TRUE(ht.isResizing());
+    EXPECT_EQ(std::min(numBuckets, newNumBuckets), ht.getNumBuckets());
+    bool more = true;
+    while (more) {
+        more = ht.migrateBucket(test_resize_keyHash, NULL);
+        for (uint32_t i = 0; i < arrayLen; i++) {
+            Key key(checkoff[i].tableId,
+                    checkoff[i].stringKeyPtr,
+                    checkoff[i].stringKeyLength);
+            uint64_t outRef;
+            EXPECT_TRUE(test->lookup(&ht, key, outRef));
+            EXPECT_EQ(checkoff[i].u64Address(), outRef);
+            checkoff[i].count = 0;
+        }
+        EXPECT_EQ(arrayLen, ht.forEach(test_forEach_callback,
+                                       reinterpret_cast<void *>(57)));
+        for (uint32_t i = 0; i < arrayLen; i++)
+            EXPECT_EQ(1U, checkoff[i].count);
+    }
+    EXPECT_EQ(numBuckets, ht.getNextBucketToMigrate());
+
+    ht.finishResize();
+    EXPECT_FALSE(ht.isResizing());
+    EXPECT_EQ(newNumBuckets, ht.getNumBuckets());
+    EXPECT_TRUE(ht.hasRetiredMemory());
+    ht.tagRetiredMemory(5);
+    ht.freeRetiredMemory(5);
+    EXPECT_TRUE(ht.hasRetiredMemory());
+    ht.freeRetiredMemory(6);
+    EXPECT_FALSE(ht.hasRetiredMemory());
+    for (uint32_t i = 0; i < arrayLen; i++) {
+        Key key(checkoff[i].tableId,
+                checkoff[i].stringKeyPtr,
+                checkoff[i].stringKeyLength);
+        uint64_t outRef;
+        EXPECT_TRUE(test->lookup(&ht, key, outRef));
+        uint64_t secondaryHash;
+        EXPECT_EQ(HashTable::findBucketIndex(newNumBuckets, key.getHash(),
+                                             &secondaryHash),
+                  static_cast<uint64_t>(
+                      ht.findBucket(key.getHash(), &secondaryHash) -
+                      ht.buckets.get()));
+    }
+}
+
+TEST_F(HashTableTest, resize_grow) {
+    checkResize(this, 4, 16);
+}
+
+TEST_F(HashTableTest, resize_shrink) {
+    checkResize(this, 16, 2);
+}
+
+TEST_F(HashTableTest, resize_insertDuringResize) {
+    HashTable ht(2);
+    TestObject a(0, "a");
+    TestObject b(0, "b");
+    Key aKey(a.tableId, a.stringKeyPtr, a.stringKeyLength);
+    Key bKey(b.tableId, b.stringKeyPtr, b.stringKeyLength);
+    uint64_t outRef;
+
+    ht.startResize(8);
+    replace(&ht, aKey, a.u64Address());
+    EXPECT_TRUE(ht.migrateBucket(test_resize_keyHash, NULL));
+    replace(&ht, bKey, b.u64Address());
+    EXPECT_FALSE(ht.migrateBucket(test_resize_keyHash, NULL));
+    ht.finishResize();
+
+    EXPECT_TRUE(lookup(&ht, aKey, outRef));
+    EXPECT_EQ(a.u64Address(), outRef);
+    EXPECT_TRUE(lookup(&ht, bKey, outRef));
+    EXPECT_EQ(b.u64Address(), outRef);
+}
+
+TEST_F(HashTableTest, forEachInBucket_afterShrink) {
+    HashTable ht(8);
+    TestObject a(0, "a");
+    Key aKey(a.tableId, a.stringKeyPtr, a.stringKeyLength);
+    replace(&ht, aKey, a.u64Address());
+    uint64_t unused;
+    uint64_t bucket = HashTable::findBucketIndex(8, aKey.getHash(), &unused);
+
+    // An enumeration that read getNumBuckets() before the shrink may still
+    // ask for buckets beyond the new size.
+    ht.startResize(2);
+    while (ht.migrateBucket(test_resize_keyHash, NULL)) {}
+    ht.finishResize();
+    EXPECT_EQ(0U, ht.forEachInBucket(test_forEach_callback,
+                                     reinterpret_cast<void *>(57), 7));
+    EXPECT_EQ(1U, ht.forEachInBucket(test_forEach_callback,
+                                     reinterpret_cast<void *>(57),
+                                     bucket & 1));
+}
+
+TEST_F(HashTableTest, tagRetiredMemory) {
+    HashTable ht(2);
+    const uint32_t arrayLen = 64;
+    TestObject checkoff[arrayLen] = {};
+    for (uint32_t i = 0; i < arrayLen; i++) {
+        checkoff[i].setKey(format("%u", i));
+        Key key(checkoff[i].tableId,
+                checkoff[i].stringKeyPtr,
+                checkoff[i].stringKeyLength);
+        replace(&ht, key, checkoff[i].u64Address());
+    }
+
+    // Nothing is ever released until it has been tagged.
+    ht.startResize(4);
+    EXPECT_TRUE(ht.migrateBucket(test_resize_keyHash, NULL));
+    EXPECT_TRUE(ht.hasRetiredMemory());
+    ht.freeRetiredMemory(~0UL);
+    EXPECT_FALSE(ht.untaggedMemory.cacheLines.empty());
+    EXPECT_EQ(1U, ht.untaggedMemory.layouts.size());
+    ht.tagRetiredMemory(10);
+    EXPECT_TRUE(ht.untaggedMemory.cacheLines.empty());
+
+    EXPECT_FALSE(ht.migrateBucket(test_resize_keyHash, NULL));
+    ht.finishResize();
+    ht.tagRetiredMemory(12);
+    ASSERT_EQ(2U, ht.taggedMemory.size());
+    EXPECT_EQ(1U, ht.taggedMemory.back().bucketArrays.size());
+
+    // Tagging with nothing retired doesn't add a batch.
+    ht.tagRetiredMemory(13);
+    EXPECT_EQ(2U, ht.taggedMemory.size());
+
+    ht.freeRetiredMemory(10);
+    EXPECT_EQ(2U, ht.taggedMemory.size());
+    ht.freeRetiredMemory(12);
+    EXPECT_EQ(1U, ht.taggedMemory.size());
+    EXPECT_EQ(12U, ht.taggedMemory.front().epoch);
+    ht.freeRetiredMemory(13);
+    EXPECT_FALSE(ht.hasRetiredMemory());
+}
+
+TEST_F(HashTableTest, startResize_alreadyResizing) {
+    HashTable ht(4);
+    ht.startResize(8);
+    EXPECT_THROW(ht.startResize(16), Exception);
+    EXPECT_THROW(HashTable(4).startResize(0), Exception);
+}
+
 } // namespace RAMCloud
@@ -86,6 +86,8 @@ InfUdDriver::InfUdDriver(Context* context, const ServiceLocator *sl,
     , zeroCopyEnd(NULL)
     , zeroCopyRegion(NULL)
     , sendsSinceLastReap(0)
+    , txPacketsPosted(0)
+    , txPacketsCompleted(0)
 {
     const char *ibDeviceName = NULL;
     bool macAddressProvided = false;
@@ -165,7 +167,7 @@ InfUdDriver::InfUdDriver(Context* context, const ServiceLocator *sl,
                                      ibPhysicalPort, NULL,
                                      txcq, rxcq, MAX_TX_QUEUE_DEPTH,
                                      MAX_RX_QUEUE_DEPTH,
-                                     QKEY);
+                                     QKEY, MAX_TX_SGES);
 
     // Cache these for easier access.
     lid = infiniband->getLid(ibPhysicalPort);
@@ -267,6 +269,17 @@ InfUdDriver::getTransmitQueueSpace(uint64_t currentTime)
     return maxTransmitQueueSize - queueEstimator.getQueueSize(currentTime);
 }
 
+// See Driver.h for documentation
+bool
+InfUdDriver::isTransmitComplete(uint64_t mark)
+{
+    if (txPacketsCompleted >= mark) {
+        return true;
+    }
+    reapTransmitBuffers();
+    return txPacketsCompleted >= mark;
+}
+
 /**
  * Check the NIC to see if it is ready to return transmit buffers
  * from previously-transmit packets. If there are any available,
@@ -289,6 +302,7 @@ InfUdDriver::reapTransmitBuffers()
                 infiniband->wcStatusToString(retArray[i].status));
         }
     }
+    txPacketsCompleted += numBuffers;
 }
 
 /*
@@ -368,30 +382,44 @@ InfUdDriver::sendPacket(const Driver::Address* addr,
     memcpy(p, header, headerLen);
     p += headerLen;
 
-    ibv_sge sges[2];
+    // The first scatter-gather element covers the headers plus any payload
+    // bytes copied immediately after them. Each chunk of the payload that
+    // lies in the zero-copy region gets an element of its own, so the HCA
+    // reads it straight from its original location (typically the log);
+    // any bytes copied after such a chunk start a new element in bd.
+    ibv_sge sges[MAX_TX_SGES];
     sges[0].addr = reinterpret_cast<uint64_t>(bd->buffer);
-    sges[0].length = bd->packetLength;
+    sges[0].length = downCast<uint32_t>(p - bd->buffer);
     sges[0].lkey = bd->memoryRegion->lkey;
-    int numSges = 1;
+    uint32_t numSges = 1;
+    ibv_sge* copySge = &sges[0];
     while (payload && !payload->isDone()) {
-        // Use zero copy for the last chunk of the packet, if it's in the
-        // zero copy region and is large enough to justify the overhead
-        // of an addition scatter-gather element.
         const char *currentChunk =
                 reinterpret_cast<const char*>(payload->getData());
-        if ((payload->getLength() >= 500)
+        uint32_t chunkLength = payload->getLength();
+
+        // Reserve an element for copied bytes that may follow this chunk.
+        uint32_t sgesNeeded = (chunkLength >= payload->size()) ? 1 : 2;
+        if ((chunkLength >= MIN_ZERO_COPY_BYTES)
                 && (currentChunk >= zeroCopyStart)
-                && ((currentChunk + payload->getLength()) <= zeroCopyEnd)
-                && (payload->getLength() >= payload->size())) {
-            sges[1].addr = reinterpret_cast<uint64_t>(currentChunk);
-            sges[1].length = payload->getLength();
-            sges[1].lkey = zeroCopyRegion->lkey;
-            sges[0].length -= payload->getLength();
-            numSges = 2;
-            break;
+                && ((currentChunk + chunkLength) <= zeroCopyEnd)
+                && (numSges + sgesNeeded <= MAX_TX_SGES)) {
+            sges[numSges].addr = reinterpret_cast<uint64_t>(currentChunk);
+            sges[numSges].length = chunkLength;
+            sges[numSges].lkey = zeroCopyRegion->lkey;
+            numSges++;
+            copySge = NULL;
         } else {
-            memcpy(p, currentChunk, payload->getLength());
-            p += payload->getLength();
+            if (copySge == NULL) {
+                copySge = &sges[numSges];
+                copySge->addr = reinterpret_cast<uint64_t>(p);
+                copySge->length = 0;
+                copySge->lkey = bd->memoryRegion->lkey;
+                numSges++;
+            }
+            memcpy(p, currentChunk, chunkLength);
+            p += chunkLength;
+            copySge->length += chunkLength;
         }
         payload->next();
     }
@@ -425,6 +453,8 @@ InfUdDriver::sendPacket(const Driver::Address* addr,
     if (ibv_post_send(qp->qp, &workRequest, &bad_txWorkRequest)) {
         LOG(WARNING, "Error posting transmit packet: %s", strerror(errno));
         txPool->freeBuffers.push_back(bd);
+    } else {
+        txPacketsPosted++;
     }
 #if TIME_TRACE
     TimeTrace::record("sent packet with %u bytes, %d free buffers",
@@ -48,7 +48,9 @@ class InfUdDriver : public Driver {
     virtual void dumpStats() { infiniband->dumpStats(); }
     virtual uint32_t getMaxPacketSize();
     virtual uint32_t getBandwidth();
+    virtual uint64_t getTransmitMark() { return txPacketsPosted; }
     virtual int getTransmitQueueSpace(uint64_t currentTime);
+    virtual bool isTransmitComplete(uint64_t mark);
     virtual void receivePackets(uint32_t maxPackets,
             std::vector<Received>* receivedPackets);
     virtual void registerMemory(void* base, size_t bytes);
@@ -155,6 +157,16 @@ class InfUdDriver : public Driver {
     /// Maximum number of transmit buffers that may be outstanding at once.
     static const uint32_t MAX_TX_QUEUE_DEPTH = 50;
 
+    /// Maximum number of scatter-gather elements in a single outgoing
+    /// packet. This limits how many separate chunks of a payload can be
+    /// transmitted directly from the zero-copy region.
+    static const uint32_t MAX_TX_SGES = 4;
+
+    /// Payload chunks in the zero-copy region are transmitted without
+    /// copying only if they are at least this large; smaller chunks are
+    /// cheaper to copy than to describe with an extra scatter-gather element.
+    static const uint32_t MIN_ZERO_COPY_BYTES = 500;
+
     /*
      * Note that in UD mode, Infiniband receivers prepend a 40-byte
      * Global Routing Header (GRH) to all incoming frames. Immediately
@@ -267,6 +279,16 @@ class InfUdDriver : public Driver {
     /// Used to invoke reapTransmitBuffers after every Nth packet is sent.
     int sendsSinceLastReap;
 
+    /// Number of packets successfully posted to the HCA for transmission.
+    /// Used as the mark returned by getTransmitMark.
+    uint64_t txPacketsPosted;
+
+    /// Number of transmit completions retrieved by reapTransmitBuffers.
+    /// Completions for a queue pair arrive in order, so the first
+    /// txPacketsCompleted packets posted are no longer being read by
+    /// the HCA.
+    uint64_t txPacketsCompleted;
+
     DISALLOW_COPY_AND_ASSIGN(InfUdDriver);
 };
 
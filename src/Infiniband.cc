@@ -68,10 +68,11 @@ Infiniband::dumpStats()
 Infiniband::QueuePair*
 Infiniband::createQueuePair(ibv_qp_type type, int ibPhysicalPort, ibv_srq *srq,
                             ibv_cq *txcq, ibv_cq *rxcq, uint32_t maxSendWr,
-                            uint32_t maxRecvWr, uint32_t QKey)
+                            uint32_t maxRecvWr, uint32_t QKey,
+                            uint32_t maxSendSge)
 {
     return new QueuePair(*this, type, ibPhysicalPort, srq, txcq, rxcq,
-                         maxSendWr, maxRecvWr, QKey);
+                         maxSendWr, maxRecvWr, QKey, maxSendSge);
 }
 
 /**
@@ -502,10 +503,14 @@ Infiniband::pollCompletionQueue(ibv_cq *cq, int numEntries, ibv_wc *retWcArray)
  *      this QueuePair.
  * \param QKey
  *      UD Queue Pairs only. The QKey for this pair. 
+ * \param maxSendSge
+ *      Maximum number of scatter-gather elements in each send work
+ *      request posted on this QueuePair.
  */
 Infiniband::QueuePair::QueuePair(Infiniband& infiniband, ibv_qp_type type,
     int ibPhysicalPort, ibv_srq *srq, ibv_cq *txcq, ibv_cq *rxcq,
-    uint32_t maxSendWr, uint32_t maxRecvWr, uint32_t QKey)
+    uint32_t maxSendWr, uint32_t maxRecvWr, uint32_t QKey,
+    uint32_t maxSendSge)
     : infiniband(infiniband),
       type(type),
       ctxt(infiniband.device.ctxt),
@@ -530,7 +535,7 @@ Infiniband::QueuePair::QueuePair(Infiniband& infiniband, ibv_qp_type type,
     qpia.srq = srq;                    // use the same shared receive queue
     qpia.cap.max_send_wr  = maxSendWr; // max outstanding send requests
     qpia.cap.max_recv_wr  = maxRecvWr; // max outstanding recv requests
-    qpia.cap.max_send_sge = 1;         // max send scatter-gather elements
+    qpia.cap.max_send_sge = maxSendSge;// max send scatter-gather elements
     qpia.cap.max_recv_sge = 1;         // max recv scatter-gather elements
     qpia.cap.max_inline_data =         // max bytes of immediate data on send q
         MAX_INLINE_DATA;
@@ -180,7 +180,8 @@ class Infiniband {
                   ibv_cq *rxcq,
                   uint32_t maxSendWr,
                   uint32_t maxRecvWr,
-                  uint32_t QKey = 0);
+                  uint32_t QKey = 0,
+                  uint32_t maxSendSge = 1);
         // exists solely as superclass constructor for MockQueuePair derivative
         explicit QueuePair(Infiniband& infiniband)
             : infiniband(infiniband), type(0), ctxt(NULL), ibPhysicalPort(-1),
@@ -451,7 +452,8 @@ class Infiniband {
                     ibv_cq *rxcq,
                     uint32_t maxSendWr,
                     uint32_t maxRecvWr,
-                    uint32_t QKey = 0);
+                    uint32_t QKey = 0,
+                    uint32_t maxSendSge = 1);
 
     int
     getLid(int port);
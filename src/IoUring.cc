@@ -0,0 +1,441 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "IoUring.h"
+#include "ShortMacros.h"
+
+namespace RAMCloud {
+
+namespace {
+/// Read a field shared with the kernel.
+uint32_t
+loadAcquire(const uint32_t* p)
+{
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+/// Publish a new value for a field shared with the kernel.
+void
+storeRelease(uint32_t* p, uint32_t value)
+{
+    __atomic_store_n(p, value, __ATOMIC_RELEASE);
+}
+
+/// Return a pointer \a offset bytes into \a base.
+template<typename T>
+T*
+at(void* base, uint32_t offset)
+{
+    return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+}
+}
+
+/**
+ * Create an io_uring instance and map its queues.
+ *
+ * \param entries
+ *      Number of submission queue entries; the kernel rounds this up to a
+ *      power of two. Batches larger than this are split across several
+ *      system calls, so it bounds only how much is submitted at once, not
+ *      how much may be in flight.
+ * \throw IoUringException
+ *      If the kernel doesn't support io_uring or the ring couldn't be set
+ *      up (for example, because io_uring is disabled for this process).
+ */
+IoUring::IoUring(uint32_t entries)
+    : mutex()
+    , changes()
+    , ringFd(-1)
+    , sqEntries(0)
+    , sqRing(MAP_FAILED)
+    , sqRingSize(0)
+    , cqRing(MAP_FAILED)
+    , cqRingSize(0)
+    , sqes(static_cast<struct io_uring_sqe*>(MAP_FAILED))
+    , sqHead(NULL)
+    , sqTail(NULL)
+    , sqMask(0)
+    , sqArray(NULL)
+    , cqHead(NULL)
+    , cqTail(NULL)
+    , cqMask(0)
+    , cqes(NULL)
+    , unsubmitted(0)
+    , submitting(false)
+    , polling(false)
+    , fixedFiles()
+    , fixedBufferBase(NULL)
+    , fixedBufferSize(0)
+    , fixedBufferCount(0)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ringFd = downCast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (ringFd < 0)
+        throw IoUringException(HERE, "io_uring_setup failed", errno);
+
+    sqEntries = params.sq_entries;
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    cqRingSize = params.cq_off.cqes +
+                 params.cq_entries * sizeof(struct io_uring_cqe);
+    bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMmap)
+        sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+
+    sqRing = mmap(NULL, sqRingSize, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED) {
+        int e = errno;
+        close(ringFd);
+        throw IoUringException(HERE, "couldn't map io_uring queue", e);
+    }
+    if (singleMmap) {
+        cqRing = sqRing;
+    } else {
+        cqRing = mmap(NULL, cqRingSize, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+    }
+    sqes = static_cast<struct io_uring_sqe*>(
+        mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe),
+             PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd,
+             IORING_OFF_SQES));
+    if (cqRing == MAP_FAILED || sqes == MAP_FAILED) {
+        int e = errno;
+        unmapQueues();
+        throw IoUringException(HERE, "couldn't map io_uring queue", e);
+    }
+
+    sqHead = at<uint32_t>(sqRing, params.sq_off.head);
+    sqTail = at<uint32_t>(sqRing, params.sq_off.tail);
+    sqMask = *at<uint32_t>(sqRing, params.sq_off.ring_mask);
+    sqArray = at<uint32_t>(sqRing, params.sq_off.array);
+    cqHead = at<uint32_t>(cqRing, params.cq_off.head);
+    cqTail = at<uint32_t>(cqRing, params.cq_off.tail);
+    cqMask = *at<uint32_t>(cqRing, params.cq_off.ring_mask);
+    cqes = at<struct io_uring_cqe>(cqRing, params.cq_off.cqes);
+}
+
+/**
+ * Unmap the queues and close the ring. No batches may be in flight.
+ */
+IoUring::~IoUring()
+{
+    unmapQueues();
+}
+
+/**
+ * Register files with the kernel so later operations on them skip the
+ * per-operation file table lookup. May only be called once, before any
+ * batches are in flight.
+ *
+ * \param fds
+ *      Files that will be read and written through this ring. Operations on
+ *      other files still work, just without the benefit.
+ * \return
+ *      True if the files were registered; false if the kernel refused (the
+ *      ring remains usable).
+ */
+bool
+IoUring::registerFiles(const std::vector<int>& fds)
+{
+    Lock _(mutex);
+    if (syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_FILES,
+                &fds[0], downCast<uint32_t>(fds.size())) != 0) {
+        LOG(WARNING, "Couldn't register %lu files with io_uring: %s",
+            fds.size(), strerror(errno));
+        return false;
+    }
+    fixedFiles = fds;
+    return true;
+}
+
+/**
+ * Register a contiguous region of memory, divided into equal-sized buffers,
+ * with the kernel. The kernel pins these pages once, rather than on every
+ * operation. May only be called once, before any batches are in flight;
+ * the memory must remain allocated until the ring is destroyed.
+ *
+ * \param base
+ *      Start of the region.
+ * \param bufferSize
+ *      Size of each buffer. An operation may use registered memory only if
+ *      it lies entirely within one buffer.
+ * \param count
+ *      Number of buffers in the region.
+ * \return
+ *      True if the buffers were registered; false if the kernel refused
+ *      (for example because the region exceeds RLIMIT_MEMLOCK). The ring
+ *      remains usable either way.
+ */
+bool
+IoUring::registerBuffers(void* base, size_t bufferSize, uint32_t count)
+{
+    Lock _(mutex);
+    std::vector<struct iovec> iovecs(count);
+    for (uint32_t i = 0; i < count; i++) {
+        iovecs[i].iov_base = static_cast<char*>(base) + i * bufferSize;
+        iovecs[i].iov_len = bufferSize;
+    }
+    if (syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_BUFFERS,
+                &iovecs[0], count) != 0) {
+        LOG(WARNING, "Couldn't register %u buffers of %lu bytes with "
+            "io_uring: %s", count, bufferSize, strerror(errno));
+        return false;
+    }
+    fixedBufferBase = static_cast<char*>(base);
+    fixedBufferSize = bufferSize;
+    fixedBufferCount = count;
+    return true;
+}
+
+/**
+ * Submit a batch of reads and writes and wait for all of them to complete.
+ * The whole batch is normally handed to the kernel with a single system
+ * call, and the operations in it proceed concurrently (and concurrently with
+ * those of other threads' batches). There is no ordering between operations
+ * in a batch.
+ *
+ * Batches from concurrent callers are coalesced: if another thread is
+ * already in the kernel submitting, this batch is left in the submission
+ * queue for it to pass along on its next system call.
+ *
+ * \param operations
+ *      Operations to perform. On return the result field of each is set.
+ * \param count
+ *      Number of entries in \a operations.
+ */
+void
+IoUring::perform(Operation* operations, uint32_t count)
+{
+    if (count == 0)
+        return;
+    uint32_t remaining = count;
+    std::vector<Token> tokens(count);
+
+    Lock lock(mutex);
+    for (uint32_t i = 0; i < count; i++) {
+        while (*sqTail - loadAcquire(sqHead) > sqMask) {
+            // The submission queue is full; wait for the kernel to take
+            // some entries.
+            if (submitting)
+                changes.wait(lock);
+            else
+                submit(lock);
+        }
+        tokens[i].operation = &operations[i];
+        tokens[i].remaining = &remaining;
+        uint32_t tail = *sqTail;
+        uint32_t index = tail & sqMask;
+        fill(&sqes[index], &tokens[i]);
+        sqArray[index] = index;
+        storeRelease(sqTail, tail + 1);
+        unsubmitted++;
+    }
+    if (!submitting)
+        submit(lock);
+
+    while (remaining > 0) {
+        if (polling) {
+            // Only the polling thread may reap while it is in the kernel:
+            // if we took its completion it would go back to sleep there,
+            // and notifying #changes can't wake it.
+            changes.wait(lock);
+            continue;
+        }
+        if (reap(lock))
+            continue;
+        // Sleep in the kernel on behalf of every waiting thread.
+        polling = true;
+        lock.unlock();
+        int r = enter(0, 1, IORING_ENTER_GETEVENTS);
+        int e = errno;
+        lock.lock();
+        polling = false;
+        changes.notify_all();
+        if (r < 0 && e != EINTR && e != EAGAIN && e != EBUSY)
+            DIE("Failed waiting for io_uring completions: %s", strerror(e));
+    }
+}
+
+// - private -
+
+/**
+ * Release the mappings of the queues and close the ring. Used by the
+ * destructor and to clean up when the constructor fails part way.
+ */
+void
+IoUring::unmapQueues()
+{
+    if (sqes != MAP_FAILED)
+        munmap(sqes, sqEntries * sizeof(struct io_uring_sqe));
+    if (cqRing != MAP_FAILED && cqRing != sqRing)
+        munmap(cqRing, cqRingSize);
+    if (sqRing != MAP_FAILED)
+        munmap(sqRing, sqRingSize);
+    sqes = static_cast<struct io_uring_sqe*>(MAP_FAILED);
+    cqRing = sqRing = MAP_FAILED;
+    if (ringFd >= 0)
+        close(ringFd);
+    ringFd = -1;
+}
+
+/**
+ * Fill in a submission queue entry for an operation.
+ */
+void
+IoUring::fill(struct io_uring_sqe* sqe, Token* token)
+{
+    Operation* op = token->operation;
+    memset(sqe, 0, sizeof(*sqe));
+    int fileIndex = fixedFileIndex(op->fd);
+    if (fileIndex >= 0) {
+        sqe->fd = fileIndex;
+        sqe->flags = IOSQE_FIXED_FILE;
+    } else {
+        sqe->fd = op->fd;
+    }
+    int bufferIndex = fixedBufferIndex(op->buffer, op->length);
+    if (bufferIndex >= 0) {
+        sqe->opcode = op->write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+        sqe->buf_index = downCast<uint16_t>(bufferIndex);
+    } else {
+        sqe->opcode = op->write ? IORING_OP_WRITE : IORING_OP_READ;
+    }
+    sqe->addr = reinterpret_cast<uint64_t>(op->buffer);
+    sqe->len = op->length;
+    sqe->off = op->offset;
+    sqe->user_data = reinterpret_cast<uint64_t>(token);
+}
+
+/**
+ * Hand all unsubmitted entries in the submission queue to the kernel,
+ * reaping completions if the kernel asks us to make room for more. #mutex
+ * is released during each system call so that other threads can queue more
+ * entries meanwhile; those are submitted too before returning.
+ *
+ * \param lock
+ *      Lock on #mutex, which must be held. No other thread may be
+ *      submitting.
+ */
+void
+IoUring::submit(Lock& lock)
+{
+    submitting = true;
+    while (unsubmitted > 0) {
+        uint32_t count = unsubmitted;
+        lock.unlock();
+        int r = enter(count, 0, 0);
+        int e = errno;
+        lock.lock();
+        if (r >= 0) {
+            unsubmitted -= std::min(unsubmitted, static_cast<uint32_t>(r));
+            continue;
+        }
+        if (e == EINTR)
+            continue;
+        if (e == EAGAIN || e == EBUSY) {
+            // The completion queue is backed up; drain it and retry (or
+            // let the polling thread drain it; see perform()).
+            if (polling)
+                changes.wait(lock);
+            else
+                reap(lock);
+            continue;
+        }
+        DIE("Failed submitting to io_uring: %s", strerror(e));
+    }
+    submitting = false;
+    changes.notify_all();
+}
+
+/**
+ * Deliver every available completion to the Operation and batch that it
+ * belongs to.
+ *
+ * \param lock
+ *      Lock on #mutex, which must be held.
+ * \return
+ *      True if any completions were reaped.
+ */
+bool
+IoUring::reap(Lock& lock)
+{
+    uint32_t head = *cqHead;
+    uint32_t tail = loadAcquire(cqTail);
+    if (head == tail)
+        return false;
+    for (; head != tail; head++) {
+        struct io_uring_cqe* cqe = &cqes[head & cqMask];
+        Token* token = reinterpret_cast<Token*>(cqe->user_data);
+        token->operation->result = cqe->res;
+        --*token->remaining;
+    }
+    storeRelease(cqHead, head);
+    changes.notify_all();
+    return true;
+}
+
+/**
+ * Invoke the io_uring_enter system call.
+ *
+ * \return
+ *      The system call's return value; errno is set if negative.
+ */
+int
+IoUring::enter(uint32_t toSubmit, uint32_t minComplete, uint32_t flags)
+{
+    return downCast<int>(syscall(__NR_io_uring_enter, ringFd, toSubmit,
+                                 minComplete, flags, NULL, 0));
+}
+
+/**
+ * Return the index of \a fd among the registered files, or -1 if it
+ * isn't registered.
+ */
+int
+IoUring::fixedFileIndex(int fd) const
+{
+    for (size_t i = 0; i < fixedFiles.size(); i++) {
+        if (fixedFiles[i] == fd)
+            return downCast<int>(i);
+    }
+    return -1;
+}
+
+/**
+ * Return the index of the registered buffer that entirely contains the
+ * given range of memory, or -1 if there is none.
+ */
+int
+IoUring::fixedBufferIndex(const void* buffer, uint32_t length) const
+{
+    const char* start = static_cast<const char*>(buffer);
+    if (fixedBufferBase == NULL || start < fixedBufferBase ||
+            start >= fixedBufferBase + fixedBufferCount * fixedBufferSize)
+        return -1;
+    size_t index = (start - fixedBufferBase) / fixedBufferSize;
+    const char* end = fixedBufferBase + (index + 1) * fixedBufferSize;
+    if (start + length > end)
+        return -1;
+    return downCast<int>(index);
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,208 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_IOURING_H
+#define RAMCLOUD_IOURING_H
+
+#include <condition_variable>
+#include <mutex>
+
+#include "Common.h"
+#include "Exception.h"
+
+// Defined in <linux/io_uring.h>, which isn't included here because it pulls
+// in macros (such as BLOCK_SIZE) that collide with names in RAMCloud.
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace RAMCloud {
+
+/**
+ * Thrown if an io_uring instance can't be created, for example because the
+ * kernel doesn't support io_uring or it has been disabled.
+ */
+struct IoUringException : public Exception {
+    explicit IoUringException(const CodeLocation& where)
+        : Exception(where) {}
+    IoUringException(const CodeLocation& where, std::string msg)
+        : Exception(where, msg) {}
+    IoUringException(const CodeLocation& where, int errNo)
+        : Exception(where, errNo) {}
+    IoUringException(const CodeLocation& where, string msg, int errNo)
+        : Exception(where, msg, errNo) {}
+};
+
+/**
+ * A minimal wrapper around a Linux io_uring submission/completion queue pair,
+ * used directly through system calls (liburing isn't required). It offers
+ * just what backup storage needs: submit a batch of reads and writes with a
+ * single system call and wait for all of them to complete.
+ *
+ * Files and a region of buffer memory may be registered with the kernel up
+ * front; operations on registered files and buffers avoid per-operation
+ * file table lookups and page pinning in the kernel.
+ *
+ * All methods are thread-safe. Any number of threads may have batches in
+ * flight at once. No thread is dedicated to reaping completions: at any
+ * moment one of the waiting threads sleeps in the kernel on behalf of all
+ * of them, and whichever thread reaps a completion hands it to its owner.
+ * Likewise, batches queued while another thread is submitting are handed
+ * to the kernel by that thread, so concurrent callers share system calls.
+ */
+class IoUring {
+  PUBLIC:
+    /**
+     * Describes one read or write in a batch passed to perform().
+     */
+    struct Operation {
+        Operation()
+            : write(false)
+            , fd(-1)
+            , buffer(NULL)
+            , length(0)
+            , offset(0)
+            , result(0)
+        {}
+
+        /// True to write #buffer to the file, false to read into it.
+        bool write;
+
+        /// File to read or write.
+        int fd;
+
+        /// Memory to write from or read into.
+        void* buffer;
+
+        /// Number of bytes to transfer.
+        uint32_t length;
+
+        /// Offset in the file at which to start.
+        uint64_t offset;
+
+        /**
+         * Set by perform(): the number of bytes transferred, or a negated
+         * errno value if the operation failed.
+         */
+        int32_t result;
+    };
+
+    explicit IoUring(uint32_t entries);
+    ~IoUring();
+
+    bool registerFiles(const std::vector<int>& fds);
+    bool registerBuffers(void* base, size_t bufferSize, uint32_t count);
+    void perform(Operation* operations, uint32_t count);
+
+  PRIVATE:
+    /**
+     * Passed to the kernel as the user data of each submitted operation so
+     * that its completion can be matched to the Operation and to the
+     * perform() call that is waiting for it.
+     */
+    struct Token {
+        /// The operation that was submitted.
+        Operation* operation;
+
+        /// Count of operations still outstanding in the submitting batch.
+        uint32_t* remaining;
+    };
+
+    typedef std::unique_lock<std::mutex> Lock;
+
+    void fill(struct io_uring_sqe* sqe, Token* token);
+    void submit(Lock& lock);
+    bool reap(Lock& lock);
+    int enter(uint32_t toSubmit, uint32_t minComplete, uint32_t flags);
+    int fixedFileIndex(int fd) const;
+    int fixedBufferIndex(const void* buffer, uint32_t length) const;
+    void unmapQueues();
+
+    /// Serializes access to the queues and the fields below.
+    std::mutex mutex;
+
+    /// Notified whenever completions are reaped or a thread stops polling.
+    std::condition_variable changes;
+
+    /// File descriptor for the io_uring instance.
+    int ringFd;
+
+    /// Number of entries in the submission queue.
+    uint32_t sqEntries;
+
+    /// Memory mapped for the submission queue ring.
+    void* sqRing;
+
+    /// Bytes mapped at #sqRing.
+    size_t sqRingSize;
+
+    /// Memory mapped for the completion queue ring (may equal #sqRing).
+    void* cqRing;
+
+    /// Bytes mapped at #cqRing.
+    size_t cqRingSize;
+
+    /// Submission queue entries shared with the kernel.
+    struct io_uring_sqe* sqes;
+
+    /// Pointers to the fields of the submission queue ring.
+    uint32_t* sqHead;
+    uint32_t* sqTail;
+    uint32_t sqMask;
+    uint32_t* sqArray;
+
+    /// Pointers to the fields of the completion queue ring.
+    uint32_t* cqHead;
+    uint32_t* cqTail;
+    uint32_t cqMask;
+    struct io_uring_cqe* cqes;
+
+    /**
+     * Number of entries that have been added to the submission queue but
+     * not yet handed to the kernel.
+     */
+    uint32_t unsubmitted;
+
+    /**
+     * True while some thread is in submit(); other threads leave their
+     * entries in the submission queue for it instead of entering the
+     * kernel themselves.
+     */
+    bool submitting;
+
+    /**
+     * True while some thread is blocked in the kernel waiting for
+     * completions; other waiting threads sleep on #changes instead, and
+     * leave reaping to it until it returns.
+     */
+    bool polling;
+
+    /// Files registered with registerFiles(); position is the fixed index.
+    std::vector<int> fixedFiles;
+
+    /// Start of the memory registered with registerBuffers(), or NULL.
+    char* fixedBufferBase;
+
+    /// Size of each registered buffer.
+    size_t fixedBufferSize;
+
+    /// Number of registered buffers.
+    uint32_t fixedBufferCount;
+
+    DISALLOW_COPY_AND_ASSIGN(IoUring);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_IOURING_H
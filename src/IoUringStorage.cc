@@ -0,0 +1,246 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "IoUringStorage.h"
+#include "CycleCounter.h"
+#include "Cycles.h"
+#include "PerfStats.h"
+#include "RawMetrics.h"
+#include "ShortMacros.h"
+
+namespace RAMCloud {
+
+/**
+ * Create storage that performs replica IO through io_uring. Arguments are
+ * the same as for MultiFileStorage, except:
+ *
+ * \param ioThreads
+ *      Number of threads performing frame IO (loading replicas and writing
+ *      buffered replicas); each keeps one frame's IO in flight. Must be at
+ *      least 1.
+ * \throw IoUringException
+ *      If io_uring isn't available; callers may fall back to
+ *      MultiFileStorage.
+ */
+IoUringStorage::IoUringStorage(size_t segmentSize,
+                               size_t frameCount,
+                               size_t writeRateLimit,
+                               size_t maxNonVolatileBuffers,
+                               const char* filePaths,
+                               int openFlags,
+                               uint32_t ioThreads)
+    : MultiFileStorage(segmentSize, frameCount, writeRateLimit,
+                       maxNonVolatileBuffers, filePaths, openFlags)
+    , ring(RING_ENTRIES)
+    , ioThreads()
+{
+    ring.registerFiles(fds);
+    ring.registerBuffers(bufferArena, bufferArenaStride,
+                         downCast<uint32_t>(bufferArenaCount));
+
+    // MultiFileStorage already started one thread on ioQueue.
+    for (uint32_t i = 1; i < ioThreads; i++)
+        this->ioThreads.emplace_back(&PriorityTaskQueue::main, &ioQueue);
+
+    LOG(NOTICE, "Using io_uring for backup storage IO with %u IO thread(s)",
+        std::max(ioThreads, 1U));
+}
+
+/**
+ * Stop the IO threads; MultiFileStorage closes the files.
+ */
+IoUringStorage::~IoUringStorage()
+{
+    ioQueue.halt();
+    for (auto& thread : ioThreads)
+        thread.join();
+}
+
+/**
+ * Performs all necessary IO operations to read a particular frame into memory.
+ * This method DIEs on any problems, and releases #lock during IO.
+ * The reads of all framelets are submitted together.
+ *
+ * \param lock
+ *     Lock on the storage mutex which must be held before calling. This lock
+ *     is released during IO and reacquired at the end of the method.
+ * \param buf
+ *     Pointer to the buffer that the Frame's data will be written to. Must
+ *     be large enough to hold an entire segment.
+ * \param frameIndex
+ *     Identifies which Frame to fetch from disk.
+ * \param usingDevNull
+ *     If true, short reads will not be considered an error. If false, short
+ *     reads cause the method to DIE.
+ */
+void
+IoUringStorage::unlockedRead(Frame::Lock& lock, void* buf, size_t frameIndex,
+                             bool usingDevNull)
+{
+    lock.unlock();
+    CycleCounter<RawMetric> _(&metrics->backup.storageReadTicks);
+
+    std::vector<IoUring::Operation> ops(fds.size());
+    size_t frameletStart = offsetOfFramelet(frameIndex);
+    char* frameletBuf = static_cast<char*>(buf);
+    for (size_t fileIndex = 0; fileIndex < fds.size(); fileIndex++) {
+        size_t frameletSize = bytesInFramelet(fileIndex);
+        IoUring::Operation* op = &ops[fileIndex];
+        op->fd = fds[fileIndex];
+        op->offset = frameletStart;
+        op->buffer = frameletBuf;
+        op->length = downCast<uint32_t>(frameletSize);
+        frameletBuf += frameletSize;
+    }
+    ring.perform(ops.data(), downCast<uint32_t>(fds.size()));
+
+    for (size_t i = 0; i < fds.size(); i++) {
+        IoUring::Operation* op = &ops[i];
+        if (op->result < 0) {
+            DIE("Failed to read replica: %s, "
+                "reading %u bytes from backup file %lu at offset %lu.",
+                strerror(-op->result), op->length, i, op->offset);
+        } else if (op->result != downCast<int32_t>(op->length)) {
+            if (!usingDevNull)
+                DIE("Failure performing io_uring IO (short read: "
+                    "wanted %u, got %d at offset %lu in file %lu)",
+                    op->length, op->result, op->offset, i);
+        }
+    }
+
+    PerfStats::threadStats.backupReadActiveCycles += _.stop();
+    lock.lock();
+}
+
+/**
+ * Performs all necessary IO operations to write #count bytes to the Frame
+ * identified by #frameIndex, beginning at #offsetInFrame bytes. Also writes
+ * out the most recently appended metadata block. The data and metadata
+ * writes are submitted together. DIEs on any problem and releases #lock
+ * during IO.
+ *
+ * \param lock
+ *     Lock on the storage mutex which must be held before calling. This lock
+ *     is released during IO and reacquired at the end of the method.
+ * \param buf
+ *     Pointer to the buffer that contains the data to write to disk.
+ * \param count
+ *     Number of bytes to write.
+ * \param frameIndex
+ *     Identifies which Frame to write to.
+ * \param offsetInFrame
+ *     Offset into the Frame to write to. (Note that the caller does NOT have
+ *     to worry about framelet offsets.)
+ * \param metadataBuf
+ *     Pointer to the buffer that contains the metadata to write to disk.
+ * \param metadataCount
+ *     Number of bytes of metadata to write.
+ */
+void
+IoUringStorage::unlockedWrite(Frame::Lock& lock, void* buf, size_t count,
+                              size_t frameIndex, off_t offsetInFrame,
+                              void* metadataBuf, size_t metadataCount)
+{
+    uint64_t start = Cycles::rdtsc();
+    CycleCounter<RawMetric> writeTicks(&metrics->backup.storageWriteTicks);
+    lock.unlock();
+
+    size_t remaining = count;
+    off_t frameletStart = offsetOfFramelet(frameIndex);
+    off_t offsetInFramelet = offsetInFrame;
+
+    // One operation for each file written, plus one (the last) for metadata.
+    std::vector<IoUring::Operation> ops(fds.size() + 1);
+    std::vector<size_t> fileOfOp(fds.size() + 1);
+    uint32_t opCount = 0;
+    for (size_t fileIndex = 0; remaining > 0; fileIndex++) {
+        size_t frameletSize = bytesInFramelet(fileIndex);
+        if (static_cast<size_t>(offsetInFramelet) > frameletSize) {
+            // The offset that we want to write is past this framelet.
+            offsetInFramelet -= frameletSize;
+            continue;
+        }
+
+        size_t bytesToWrite = std::min(frameletSize - offsetInFramelet,
+                                       remaining);
+        IoUring::Operation* op = &ops[opCount];
+        fileOfOp[opCount] = fileIndex;
+        opCount++;
+        op->write = true;
+        op->fd = fds[fileIndex];
+        op->offset = frameletStart + offsetInFramelet;
+        op->buffer = buf;
+        op->length = downCast<uint32_t>(bytesToWrite);
+
+        remaining -= bytesToWrite;
+        buf = static_cast<char*>(buf) + bytesToWrite;
+        offsetInFramelet = 0;
+    }
+
+    IoUring::Operation* metadataOp = &ops[opCount];
+    fileOfOp[opCount] = 0;
+    opCount++;
+    metadataOp->write = true;
+    metadataOp->fd = fds[0];
+    metadataOp->offset = offsetOfFrameMetadata(frameIndex);
+    metadataOp->buffer = metadataBuf;
+    metadataOp->length = downCast<uint32_t>(metadataCount);
+
+    ring.perform(ops.data(), opCount);
+
+    for (uint32_t i = 0; i < opCount; i++) {
+        IoUring::Operation* op = &ops[i];
+        bool isMetadata = (op == metadataOp);
+        if (op->result < 0) {
+            if (isMetadata)
+                DIE("Failed to write metadata for replica: %s, "
+                    "writing %u bytes to backup file 0 at offset %lu.",
+                    strerror(-op->result), op->length, op->offset);
+            else
+                DIE("Failed to write replica: %s, "
+                    "writing %u bytes to backup file %lu at offset %lu.",
+                    strerror(-op->result), op->length, fileOfOp[i],
+                    op->offset);
+        } else if (op->result != downCast<int32_t>(op->length)) {
+            if (isMetadata)
+                DIE("Unexpectedly short write to metadata for replica, "
+                    "file 0 at offset %lu, "
+                    "expected length %u, actual write length %d",
+                    op->offset, op->length, op->result);
+            else
+                DIE("Unexpectedly short write to replica, "
+                    "file %lu at offset %lu, "
+                    "expected length %u, actual write length %d",
+                    fileOfOp[i], op->offset, op->length, op->result);
+        }
+    }
+
+    double elapsedSeconds = Cycles::toSeconds(Cycles::rdtsc() - start);
+    if (elapsedSeconds > 0.1) {
+        LOG(WARNING, "Slow write to replica storage: %.1f ms for %lu bytes "
+                "across %u IO operation(s)", elapsedSeconds*1e03,
+                count + metadataCount, opCount);
+    }
+
+    // Reduce our bandwidth (if so configured) by delaying this operation.
+    sleepToThrottleWrites(count + metadataCount, Cycles::rdtsc() - start);
+
+    uint64_t elapsed = Cycles::rdtsc() - start;
+    metrics->backup.storageWriteTicks += elapsed;
+    PerfStats::threadStats.backupWriteActiveCycles += elapsed;
+    lock.lock();
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,86 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_IOURINGSTORAGE_H
+#define RAMCLOUD_IOURINGSTORAGE_H
+
+#include <thread>
+
+#include "IoUring.h"
+#include "MultiFileStorage.h"
+
+namespace RAMCloud {
+
+/**
+ * A MultiFileStorage that performs replica IO through io_uring instead of
+ * POSIX aio. The layout on storage, frame management, and buffering are all
+ * inherited unchanged, so files written by either class can be read by the
+ * other.
+ *
+ * POSIX aio in glibc is implemented with a pool of helper threads, one per
+ * outstanding request, and MultiFileStorage has only a single IO thread, so
+ * only one frame's IO is ever in flight. Here every frame read or write
+ * (all of its framelets plus the metadata block) goes to the kernel in one
+ * io_uring submission, using registered files and the registered buffer
+ * pool, and several IO threads share the ring so that the IO for many
+ * frames is in flight at once. Writes done synchronously on behalf of
+ * BackupService::writeSegment() (for sync replicas) use the same ring, and
+ * the ring coalesces the submissions of concurrent writeSegment() calls and
+ * IO threads into shared system calls.
+ * Completions are reaped by whichever waiting thread is in the kernel;
+ * there are no helper threads.
+ *
+ * Works on plain files as well as devices.
+ */
+class IoUringStorage : public MultiFileStorage {
+  PUBLIC:
+    IoUringStorage(size_t segmentSize,
+                   size_t frameCount,
+                   size_t writeRateLimit,
+                   size_t maxNonVolatileBuffers,
+                   const char* filePaths,
+                   int openFlags = 0,
+                   uint32_t ioThreads = 4);
+    ~IoUringStorage();
+
+  PRIVATE:
+    void unlockedRead(Frame::Lock& lock, void* buf, size_t frameIndex,
+                      bool usingDevNull);
+    void unlockedWrite(Frame::Lock& lock, void* buf, size_t count,
+                       size_t frameIndex, off_t offsetInFrame,
+                       void* metadataBuf, size_t metadataCount);
+
+    /**
+     * Number of submission queue entries in #ring. Each frame IO uses one
+     * entry per file plus one for metadata.
+     */
+    static const uint32_t RING_ENTRIES = 256;
+
+    /// All replica IO is submitted through this ring.
+    IoUring ring;
+
+    /**
+     * Threads, in addition to the one started by MultiFileStorage, that
+     * perform frame IO from #ioQueue. Each has at most one frame's IO in
+     * flight.
+     */
+    std::vector<std::thread> ioThreads;
+
+    DISALLOW_COPY_AND_ASSIGN(IoUringStorage);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_IOURINGSTORAGE_H
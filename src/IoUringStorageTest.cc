@@ -0,0 +1,340 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <fcntl.h>
+
+#include "TestUtil.h"
+#include "IoUringStorage.h"
+#include "Memory.h"
+
+namespace RAMCloud {
+
+// io_uring may be missing from the kernel (ENOSYS) or disabled for this
+// process, for example by a seccomp filter or kernel.io_uring_disabled
+// (EPERM); tests using it pass trivially in that case.
+#define SKIP_IF_NO_IO_URING() \
+    if (!ioUringAvailable) \
+        return;
+
+class IoUringStorageTest : public ::testing::Test {
+  public:
+    typedef char* bytes;
+    enum { BLOCK_SIZE = MultiFileStorage::BLOCK_SIZE };
+    typedef MultiFileStorage::Frame Frame;
+
+    uint32_t segmentFrames;
+    uint32_t segmentSize;
+    Tub<IoUringStorage> storage1;
+    Tub<IoUringStorage> storage3;
+    const char* filePath1;
+    const char* filePath31;
+    const char* filePath32;
+    const char* filePath33;
+    mode_t oldUmask;
+    bool ioUringAvailable;
+
+    IoUringStorageTest()
+        : segmentFrames(8)
+        // Needed when testing with O_DIRECT
+        , segmentSize(BLOCK_SIZE * 4)
+        , storage1()
+        , storage3()
+        , filePath1("/tmp/ramcloud-iouring-storage-test-delete-this-1-1")
+        , filePath31("/tmp/ramcloud-iouring-storage-test-delete-this-3-1")
+        , filePath32("/tmp/ramcloud-iouring-storage-test-delete-this-3-2")
+        , filePath33("/tmp/ramcloud-iouring-storage-test-delete-this-3-3")
+        , oldUmask(umask(0))
+        , ioUringAvailable(true)
+    {
+        Logger::get().setLogLevels(SILENT_LOG_LEVEL);
+
+        try {
+            storage1.construct(segmentSize, segmentFrames, 0, segmentFrames,
+                               filePath1, O_DIRECT | O_SYNC, 4);
+        } catch (const IoUringException& e) {
+            if (e.errNo != ENOSYS && e.errNo != EPERM)
+                throw;
+            ioUringAvailable = false;
+            return;
+        }
+        std::string threeFiles = std::string(filePath31) + "," + filePath32
+                                 + "," + filePath33;
+        storage3.construct(segmentSize, segmentFrames, 0, segmentFrames,
+                           threeFiles.c_str(), O_DIRECT | O_SYNC, 4);
+    }
+
+    ~IoUringStorageTest()
+    {
+        storage1.destroy();
+        storage3.destroy();
+        umask(oldUmask);
+        unlink(filePath1);
+        unlink(filePath31);
+        unlink(filePath32);
+        unlink(filePath33);
+    }
+
+    // Append a full replica filled with \a fill to a newly opened frame
+    // and wait for it to reach storage.
+    BackupStorage::FrameRef
+    writeReplica(IoUringStorage* storage, char fill)
+    {
+        string data(segmentSize - 1, fill);
+        Buffer source;
+        source.appendCopy(data.c_str(), segmentSize);
+        string metadata(16, fill);
+        BackupStorage::FrameRef frameRef = storage->open(false, ServerId(), 0);
+        frameRef->append(source, 0, segmentSize, 0, metadata.c_str(),
+                         downCast<uint32_t>(metadata.size() + 1));
+        while (!static_cast<Frame*>(frameRef.get())->isSynced());
+        return frameRef;
+    }
+
+    // Force \a frameRef's replica to be read back from storage and return
+    // its contents.
+    char*
+    readReplica(BackupStorage::FrameRef frameRef)
+    {
+        Frame* frame = static_cast<Frame*>(frameRef.get());
+        frame->buffer.reset();
+        {
+            Frame::Lock lock(frame->storage->mutex);
+            frame->loadRequested = true;
+            frame->performRead(lock);
+        }
+        return bytes(frame->load());
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(IoUringStorageTest);
+};
+
+TEST_F(IoUringStorageTest, IoUring_perform) {
+    SKIP_IF_NO_IO_URING();
+    int fd = open(filePath1, O_RDWR);
+    ASSERT_NE(-1, fd);
+    IoUring ring(4);
+    char out[3][64];
+    char in[3][64];
+    IoUring::Operation ops[3];
+    for (int i = 0; i < 3; i++) {
+        snprintf(out[i], sizeof(out[i]), "operation %d", i);
+        ops[i].write = true;
+        ops[i].fd = fd;
+        ops[i].buffer = out[i];
+        ops[i].length = sizeof(out[i]);
+        ops[i].offset = i * sizeof(out[i]);
+    }
+    ring.perform(ops, 3);
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ(64, ops[i].result);
+        ops[i].write = false;
+        ops[i].buffer = in[i];
+    }
+    ring.perform(ops, 3);
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ(64, ops[i].result);
+        EXPECT_STREQ(out[i], in[i]);
+    }
+
+    // More operations than fit in the submission queue at once.
+    IoUring::Operation many[10];
+    for (int i = 0; i < 10; i++) {
+        many[i].fd = fd;
+        many[i].buffer = in[0];
+        many[i].length = 64;
+    }
+    ring.perform(many, 10);
+    for (int i = 0; i < 10; i++)
+        EXPECT_EQ(64, many[i].result);
+
+    // Errors are reported per operation.
+    ops[0].fd = -1;
+    ring.perform(ops, 1);
+    EXPECT_EQ(-EBADF, ops[0].result);
+    close(fd);
+}
+
+TEST_F(IoUringStorageTest, IoUring_perform_concurrentBatches) {
+    SKIP_IF_NO_IO_URING();
+    int fd = open(filePath1, O_RDWR);
+    ASSERT_NE(-1, fd);
+    // Small enough that the threads' batches contend for queue entries.
+    IoUring ring(4);
+    const int threadCount = 4;
+    const int opsPerThread = 6;
+    char out[threadCount][opsPerThread][64];
+    IoUring::Operation ops[threadCount][opsPerThread];
+    for (int t = 0; t < threadCount; t++) {
+        for (int i = 0; i < opsPerThread; i++) {
+            snprintf(out[t][i], sizeof(out[t][i]), "thread %d op %d", t, i);
+            ops[t][i].write = true;
+            ops[t][i].fd = fd;
+            ops[t][i].buffer = out[t][i];
+            ops[t][i].length = sizeof(out[t][i]);
+            ops[t][i].offset = (t * opsPerThread + i) * sizeof(out[t][i]);
+        }
+    }
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; t++) {
+        threads.emplace_back([&ring, &ops, t] {
+            for (int round = 0; round < 10; round++)
+                ring.perform(ops[t], opsPerThread);
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    char in[64];
+    for (int t = 0; t < threadCount; t++) {
+        for (int i = 0; i < opsPerThread; i++) {
+            EXPECT_EQ(64, ops[t][i].result);
+            EXPECT_EQ(64, pread(fd, in, sizeof(in), ops[t][i].offset));
+            EXPECT_STREQ(out[t][i], in);
+        }
+    }
+    EXPECT_EQ(0U, ring.unsubmitted);
+    EXPECT_FALSE(ring.submitting);
+    close(fd);
+}
+
+TEST_F(IoUringStorageTest, IoUring_perform_otherThreadCompletesPollersBatch) {
+    SKIP_IF_NO_IO_URING();
+    int fd = open(filePath1, O_RDWR);
+    ASSERT_NE(-1, fd);
+    IoUring ring(4);
+    for (int round = 0; round < 50; round++) {
+        // The poller's read of an empty pipe can't complete until we write
+        // to it, so it ends up polling in the kernel.
+        int pipeFds[2];
+        ASSERT_EQ(0, pipe(pipeFds));
+        char pipeIn[8] = "";
+        IoUring::Operation pipeRead;
+        pipeRead.fd = pipeFds[0];
+        pipeRead.buffer = pipeIn;
+        pipeRead.length = 1;
+        std::atomic<bool> pollerDone(false);
+        std::thread poller([&] {
+            ring.perform(&pipeRead, 1);
+            pollerDone = true;
+        });
+        while (true) {
+            std::lock_guard<std::mutex> _(ring.mutex);
+            if (ring.polling)
+                break;
+        }
+
+        // Complete the poller's read while another thread is waiting for
+        // (and could reap) completions of its own.
+        char out[64] = "other";
+        IoUring::Operation fileWrite;
+        fileWrite.write = true;
+        fileWrite.fd = fd;
+        fileWrite.buffer = out;
+        fileWrite.length = sizeof(out);
+        std::thread other([&] { ring.perform(&fileWrite, 1); });
+        EXPECT_EQ(1, write(pipeFds[1], "x", 1));
+        other.join();
+        EXPECT_EQ(64, fileWrite.result);
+
+        // The poller must return without any further IO to wake it up.
+        uint64_t deadline = Cycles::rdtsc() + Cycles::fromSeconds(5);
+        while (!pollerDone && Cycles::rdtsc() < deadline)
+            usleep(100);
+        EXPECT_TRUE(pollerDone) << "round " << round;
+        if (!pollerDone) {
+            IoUring::Operation kick;
+            kick.fd = fd;
+            kick.buffer = out;
+            kick.length = 1;
+            ring.perform(&kick, 1);
+        }
+        poller.join();
+        EXPECT_EQ(1, pipeRead.result);
+        EXPECT_EQ('x', pipeIn[0]);
+        close(pipeFds[0]);
+        close(pipeFds[1]);
+        if (!pollerDone)
+            break;
+    }
+    close(fd);
+}
+
+TEST_F(IoUringStorageTest, unlockedWriteAndRead) {
+    SKIP_IF_NO_IO_URING();
+    IoUringStorage* storages[] = { storage1.get(), storage3.get() };
+    for (IoUringStorage* storage : storages) {
+        BackupStorage::FrameRef frameRef = writeReplica(storage, 'x');
+        string expected(segmentSize - 1, 'x');
+        EXPECT_STREQ(expected.c_str(), readReplica(frameRef));
+        EXPECT_STREQ(string(16, 'x').c_str(),
+                     bytes(const_cast<void*>(frameRef->getMetadata())));
+    }
+}
+
+TEST_F(IoUringStorageTest, unlockedWriteMiddleOfSegment) {
+    SKIP_IF_NO_IO_URING();
+    string data(BLOCK_SIZE * 3, 'x');
+    memset(&data[BLOCK_SIZE + BLOCK_SIZE / 2], 'y', BLOCK_SIZE);
+    data[BLOCK_SIZE * 2 + BLOCK_SIZE / 2] = '\0';
+    Buffer source;
+    source.appendCopy(data.c_str(), downCast<uint32_t>(data.size()));
+
+    BackupStorage::FrameRef frameRef = storage3->open(false, ServerId(), 0);
+    frameRef->append(source, 0, BLOCK_SIZE + BLOCK_SIZE / 2, 0, "m", 2);
+    storage3->quiesce();
+    frameRef->append(source, BLOCK_SIZE + BLOCK_SIZE / 2, BLOCK_SIZE + 1,
+                     BLOCK_SIZE + BLOCK_SIZE / 2, NULL, 0);
+    while (!static_cast<Frame*>(frameRef.get())->isSynced());
+
+    EXPECT_STREQ(data.c_str(), readReplica(frameRef));
+    EXPECT_STREQ("m", bytes(const_cast<void*>(frameRef->getMetadata())));
+}
+
+TEST_F(IoUringStorageTest, manyFramesInFlight) {
+    SKIP_IF_NO_IO_URING();
+    std::vector<BackupStorage::FrameRef> frames;
+    for (uint32_t i = 0; i < segmentFrames; i++) {
+        string data(segmentSize - 1, static_cast<char>('a' + i));
+        Buffer source;
+        source.appendCopy(data.c_str(), segmentSize);
+        frames.push_back(storage3->open(false, ServerId(), 0));
+        frames.back()->append(source, 0, segmentSize, 0, NULL, 0);
+    }
+    for (auto& frame : frames)
+        while (!static_cast<Frame*>(frame.get())->isSynced());
+    for (uint32_t i = 0; i < segmentFrames; i++) {
+        string expected(segmentSize - 1, static_cast<char>('a' + i));
+        EXPECT_STREQ(expected.c_str(), readReplica(frames[i]));
+    }
+}
+
+TEST_F(IoUringStorageTest, readableByMultiFileStorage) {
+    SKIP_IF_NO_IO_URING();
+    writeReplica(storage1.get(), 'z');
+    storage1.destroy();
+
+    MultiFileStorage storage(segmentSize, segmentFrames, 0, segmentFrames,
+                             filePath1, O_DIRECT | O_SYNC);
+    std::vector<BackupStorage::FrameRef> frames = storage.loadAllMetadata();
+    ASSERT_EQ(segmentFrames, frames.size());
+    Frame* frame = static_cast<Frame*>(frames[0].get());
+    EXPECT_STREQ(string(16, 'z').c_str(),
+                 bytes(const_cast<void*>(frame->getMetadata())));
+    frame->startLoading();
+    EXPECT_STREQ(string(segmentSize - 1, 'z').c_str(),
+                 bytes(frame->load()));
+}
+
+}  // namespace RAMCloud
@@ -123,6 +123,18 @@ Key::getHash()
     return *hash;
 }
 
+/**
+ * Supply the hash of this key when it is already known (for example, it was
+ * computed to steer the request that named the key to a worker thread), so
+ * that getHash() needn't compute it again. The caller is responsible for
+ * \a keyHash actually being the hash of this key.
+ */
+void
+Key::setHash(KeyHash keyHash)
+{
+    hash.construct(keyHash);
+}
+
 /**
  * Given a key, returns its hash value.
  *
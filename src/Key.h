@@ -58,6 +58,7 @@ class Key {
     Key(uint64_t tableId, const void* key, KeyLength keyLength);
 
     KeyHash getHash();
+    void setHash(KeyHash keyHash);
     static KeyHash getHash(uint64_t tableId,
                            const void* key,
                            KeyLength keyLength);
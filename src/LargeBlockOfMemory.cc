@@ -13,7 +13,12 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+
 #include "LargeBlockOfMemory.h"
+#include "ShortMacros.h"
 
 namespace RAMCloud {
 
@@ -40,6 +45,133 @@ namespace LargeBlockOfMemoryInternal {
 #else
     uint64_t nextProbeBase = (uint64_t)1 << 30;
 #endif
+
+/// Pieces of a block split across NUMA nodes are multiples of this size, so
+/// that no 2MB huge page straddles two nodes.
+static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+/// Largest number of NUMA nodes we will bind memory to (the size in bits of
+/// the node mask passed to mbind).
+static const int MAX_NUMA_NODES = 64;
+
+/**
+ * Return the number of NUMA nodes in this machine (1 if it isn't a NUMA
+ * machine, or if the number can't be determined). Node numbers are assumed
+ * to be dense, starting at 0.
+ */
+int
+getNumaNodeCount()
+{
+    static int count = 0;
+    if (count == 0) {
+        int nodes = 0;
+        while (nodes < MAX_NUMA_NODES) {
+            string path = format("/sys/devices/system/node/node%d", nodes);
+            if (access(path.c_str(), F_OK) != 0)
+                break;
+            nodes++;
+        }
+        count = std::max(nodes, 1);
+    }
+    return count;
+}
+
+/**
+ * Return the NUMA node of the core on which the calling thread is currently
+ * running (0 if it can't be determined).
+ */
+int
+getCurrentNumaNode()
+{
+    // getcpu() goes through the vDSO, so this is cheap enough to call on
+    // every allocation.
+    unsigned cpu, node;
+    if (getcpu(&cpu, &node) != 0)
+        return 0;
+    return downCast<int>(node);
+}
+
+/**
+ * Set the memory policy of a range of virtual memory with mbind(2). We
+ * invoke the system call directly rather than linking against libnuma.
+ *
+ * \return
+ *      True if the policy was applied, otherwise false (a warning is logged).
+ */
+static bool
+bindMemory(void* start, size_t length, int mode, uint64_t nodeMask)
+{
+    if (syscall(SYS_mbind, start, length, mode, &nodeMask,
+                MAX_NUMA_NODES + 1, 0) != 0) {
+        LOG(WARNING, "mbind of %lu bytes at %p failed: %s",
+            length, start, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Prepare a freshly mmapped region for use by a LargeBlockOfMemory: ask for
+ * transparent huge pages and set the NUMA policy requested by the user. This
+ * must be invoked before any of the region's pages are touched.
+ *
+ * \param block
+ *      Start of the region.
+ * \param length
+ *      Number of bytes in the region.
+ * \param placement
+ *      One of the NumaPlacement values.
+ * \param[out] numNodes
+ *      If non-NULL and the region is split across nodes, set to the number
+ *      of nodes. Otherwise left unmodified.
+ * \param[out] pieceSize
+ *      If non-NULL and the region is split across nodes, set to the number
+ *      of bytes assigned to each node (the last node also gets any remainder).
+ *      Otherwise left unmodified.
+ */
+void
+applyPlacement(void* block, size_t length, int placement, int* numNodes,
+               size_t* pieceSize)
+{
+    // Huge pages cut TLB misses dramatically for the randomly accessed log
+    // and hash table. This is only advice: kernels without transparent huge
+    // page support simply fall back to 4KB pages.
+    if (madvise(block, length, MADV_HUGEPAGE) != 0) {
+        LOG(DEBUG, "madvise(MADV_HUGEPAGE) of %lu bytes failed: %s",
+            length, strerror(errno));
+    }
+
+    int nodes = getNumaNodeCount();
+    if (nodes <= 1 || placement == NUMA_DEFAULT)
+        return;
+
+    if (placement == NUMA_INTERLEAVE) {
+        uint64_t allNodes = (nodes == 64) ? ~0UL : ((1UL << nodes) - 1);
+        bindMemory(block, length, MPOL_INTERLEAVE, allNodes);
+        return;
+    }
+
+    size_t piece = (length / nodes) & ~(HUGE_PAGE_SIZE - 1);
+    if (piece == 0)
+        return;
+    uint8_t* base = static_cast<uint8_t*>(block);
+    for (int node = 0; node < nodes; node++) {
+        size_t offset = node * piece;
+        size_t bytes = (node == nodes - 1) ? length - offset : piece;
+        // Only prefer the node: a hard MPOL_BIND would fail allocations (or
+        // invoke the OOM killer) once that node fills up, even though the
+        // other nodes still have free memory.
+        if (!bindMemory(base + offset, bytes, MPOL_PREFERRED, 1UL << node))
+            return;
+    }
+    if (numNodes != NULL)
+        *numNodes = nodes;
+    if (pieceSize != NULL)
+        *pieceSize = piece;
+    LOG(NOTICE, "Split %lu-byte block at %p across %d NUMA nodes",
+        length, block, nodes);
 }
 
+} // namespace LargeBlockOfMemoryInternal
+
 }
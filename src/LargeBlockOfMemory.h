@@ -34,8 +34,35 @@ namespace RAMCloud {
  */
 namespace LargeBlockOfMemoryInternal {
     extern uint64_t nextProbeBase;
+    int getNumaNodeCount();
+    int getCurrentNumaNode();
+    void applyPlacement(void* block, size_t length, int placement,
+                        int* numNodes, size_t* pieceSize);
 }
 
+/**
+ * Specifies how the pages of a #LargeBlockOfMemory are distributed across
+ * the NUMA nodes of the machine. On machines with a single node all of these
+ * are equivalent.
+ */
+enum NumaPlacement {
+    /// Leave placement to the kernel (normally the node of the thread that
+    /// first touches each page, which is the constructing thread).
+    NUMA_DEFAULT = 0,
+
+    /// Spread pages round-robin across all nodes. Use this for structures
+    /// like the hash table that are accessed uniformly from every core, so
+    /// that no one node's memory bandwidth becomes the bottleneck.
+    NUMA_INTERLEAVE = 1,
+
+    /// Divide the block into one contiguous piece per node and have piece i
+    /// prefer node i (pages fall back to other nodes if node i runs out of
+    /// memory). Users can then find the node backing any address with
+    /// LargeBlockOfMemory::getNumaNode() and hand out memory that is local
+    /// to the requesting core.
+    NUMA_SPLIT = 2
+};
+
 /**
  * A wrapper for a large block of memory. Returned memory is guaranteed to be
  * at least one gigabyte aligned (at least the first 30 address bits will be 0).
@@ -46,16 +73,26 @@ template<typename T = void>
 struct LargeBlockOfMemory {
     /**
      * Allocates anonymous backing pages for a block of memory, pins them,
-     * and zeros them. The memory is aligned to a gigabyte boundary.
+     * and zeros them. The memory is aligned to a gigabyte boundary and, where
+     * the kernel supports it, backed by transparent 2MB huge pages.
      * \param length
      *      The number of bytes of memory to allocate.
+     * \param placement
+     *      How the pages should be distributed across NUMA nodes. This is
+     *      applied before any page is faulted in.
      * \throw FatalError
      *      If the memory could not be allocated.
      */
-    explicit LargeBlockOfMemory(size_t length)
+    explicit LargeBlockOfMemory(size_t length,
+                                NumaPlacement placement = NUMA_DEFAULT)
         : length(length)
-        , block(static_cast<T*>(mmapGigabyteAligned(length, MAP_ANONYMOUS)))
+        , block(NULL)
+        , numaNodes(1)
+        , numaPieceSize(length)
     {
+        block = static_cast<T*>(mmapGigabyteAligned(length, MAP_ANONYMOUS,
+                -1, placement, &numaNodes, &numaPieceSize));
+
         if (block == MAP_FAILED) {
             if (length == 0)
                 return;
@@ -81,7 +118,9 @@ struct LargeBlockOfMemory {
      */
     LargeBlockOfMemory(string filePath, size_t length)
         : length(length),
-          block(NULL)
+          block(NULL),
+          numaNodes(1),
+          numaPieceSize(length)
     {
         const char* path = filePath.c_str();
 
@@ -139,6 +178,26 @@ struct LargeBlockOfMemory {
     void swap(LargeBlockOfMemory<T>& other) {
         std::swap(this->length, other.length);
         std::swap(this->block, other.block);
+        std::swap(this->numaNodes, other.numaNodes);
+        std::swap(this->numaPieceSize, other.numaPieceSize);
+    }
+
+    /**
+     * Return the NUMA node preferred for the given byte of the block (which
+     * backs it unless that node ran out of memory). This is only meaningful
+     * for blocks allocated with NUMA_SPLIT; all other blocks (and all blocks
+     * on single-node machines) report node 0.
+     * \param offset
+     *      Offset of the byte within the block.
+     */
+    int
+    getNumaNode(size_t offset) const
+    {
+        if (numaPieceSize == 0)
+            return 0;
+        // The last node also holds the bytes left over after dividing the
+        // block evenly.
+        return std::min(downCast<int>(offset / numaPieceSize), numaNodes - 1);
     }
 
     /// Returns #block.
@@ -160,6 +219,15 @@ struct LargeBlockOfMemory {
      */
     T* block;
 
+    /// The number of NUMA nodes the block was split across (1 unless it was
+    /// allocated with NUMA_SPLIT on a NUMA machine).
+    int numaNodes;
+
+    /// If the block was split across NUMA nodes, the number of bytes assigned
+    /// to each node (the last node also gets any remainder). Otherwise this
+    /// is #length, so that every byte maps to node 0.
+    size_t numaPieceSize;
+
   private:
     /**
      * Mmap the desired amount of space with gigabyte alignment (lower 30
@@ -178,19 +246,33 @@ struct LargeBlockOfMemory {
      *      Extra flags to be passed to mmap(2).
      * \param[in] fd
      *      Optional file descriptor (if mmaping a file, for instance).
+     * \param[in] placement
+     *      NUMA placement to apply to the region before faulting it in.
+     * \param[out] numNodes
+     *      If non-NULL and the region is split across nodes, set to the
+     *      number of nodes (see #numaNodes).
+     * \param[out] pieceSize
+     *      If non-NULL and the region is split across nodes, set to the
+     *      number of bytes assigned to each node (see #numaPieceSize).
      */
     void*
-    mmapGigabyteAligned(size_t length, int extraFlags, int fd = -1)
+    mmapGigabyteAligned(size_t length, int extraFlags, int fd = -1,
+                        NumaPlacement placement = NUMA_DEFAULT,
+                        int* numNodes = NULL, size_t* pieceSize = NULL)
     {
         const int maxTries = 10000;
         int i;
 
+        // Anonymous memory is mapped private: shared anonymous memory is
+        // shmem, for which the kernel ignores MADV_HUGEPAGE unless
+        // /sys/kernel/mm/transparent_hugepage/shmem_enabled allows it.
+        int sharing = (extraFlags & MAP_ANONYMOUS) ? MAP_PRIVATE : MAP_SHARED;
         uint64_t tryBase = LargeBlockOfMemoryInternal::nextProbeBase;
         for (i = 0; i < maxTries; i++) {
             void *base = mmap(reinterpret_cast<void*>(tryBase),
                               length,
                               PROT_READ | PROT_WRITE,
-                              MAP_SHARED | extraFlags,
+                              sharing | extraFlags,
                               fd,
                               0);
 
@@ -214,6 +296,12 @@ struct LargeBlockOfMemory {
 
         void* block = reinterpret_cast<void*>(tryBase);
 
+        // Page placement and huge page eligibility must be established
+        // before the pages are faulted in below; afterwards it's too late.
+        if (fd == -1)
+            LargeBlockOfMemoryInternal::applyPlacement(block, length,
+                    placement, numNodes, pieceSize);
+
         // Do not pin and fault in pages if we're testing, since that just
         // slows things down considerably (we usually don't touch anywhere near
         // all of the memory we allocate).
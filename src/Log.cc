@@ -127,6 +127,35 @@ Log::getHead() {
     return LogPosition(head->id, head->getAppendedLength());
 }
 
+/**
+ * Return how many bytes at the start of a segment of this log hold complete
+ * entries. For the head this may be less than its appended length, since
+ * writers fill in entries after reserving space for them (see
+ * AbstractLog::copiesInProgress); this method snapshots the head's length
+ * and then waits for all entries reserved before that point to be filled
+ * in. Used to iterate the head without reading uninitialized entry contents.
+ *
+ * \param segment
+ *      Segment of this log to measure.
+ */
+uint32_t
+Log::getFilledLength(LogSegment* segment)
+{
+    Tub<SpinLock::Guard> lock;
+    lock.construct(appendLock);
+    uint32_t length = segment->getAppendedLength();
+
+    // Segments other than the head are closed, and the head is only rolled
+    // over once all copies into it have finished.
+    if (segment != head)
+        return length;
+
+    int generation = startCopyGeneration(*lock);
+    lock.destroy();
+    waitForCopies(generation);
+    return length;
+}
+
 /**
  * Wait for all log appends made at the time this method is invoked to be fully
  * replicated to backups. If no appends have ever been done, this method will
@@ -197,10 +226,13 @@ Log::sync()
         // batch up other appends that came in while we were waiting.
         SegmentCertificate certificate;
         appendedLength = originalHead->getAppendedLength(&certificate);
+        int generation = startCopyGeneration(*lock);
 
         // Drop the append lock. We don't want to block other appending threads
-        // while we sync.
+        // while we sync. Entries up to appendedLength may still be getting
+        // filled in by their writers, though; wait for them to finish.
         lock.destroy();
+        waitForCopies(generation);
 
         originalHead->replicatedSegment->sync(appendedLength, &certificate);
         originalHead->syncedLength = appendedLength;
@@ -253,14 +285,18 @@ Log::syncTo(Log::Reference reference)
         // If segment != head, segment must have been closed and its replication
         // is queued already. Forcing sync of head segment will also make sure
         // that the closed segment is fully replicated.
-        uint32_t appendedLength = head->getAppendedLength(&certificate);
+        LogSegment* currentHead = head;
+        uint32_t appendedLength = currentHead->getAppendedLength(&certificate);
+        int generation = startCopyGeneration(*lock);
 
         // Drop the append lock. We don't want to block other appending
-        // threads while we sync.
+        // threads while we sync, but we must wait for any entries they
+        // reserved before appendedLength to be filled in.
         lock.destroy();
+        waitForCopies(generation);
 
-        head->replicatedSegment->sync(appendedLength, &certificate);
-        head->syncedLength = appendedLength;
+        currentHead->replicatedSegment->sync(appendedLength, &certificate);
+        currentHead->syncedLength = appendedLength;
         TEST_LOG("log synced");
         return;
     }
@@ -294,6 +330,7 @@ Log::rollHeadOver()
     // for SideLog::commit(), which rolls the head over to inject a SideLog
     // into the main log (by adding segments to a new log digest and syncing
     // that to disk). See RAM-489.
+    waitForAllCopies();
     head = allocNextSegment(true);
     SegmentCertificate certificate;
     uint32_t appendedLength = head->getAppendedLength(&certificate);
@@ -87,6 +87,7 @@ class Log : public AbstractLog {
 
   PRIVATE:
     LogSegment* allocNextSegment(bool mustNotFail);
+    uint32_t getFilledLength(LogSegment* segment);
 
     INTRUSIVE_LIST_TYPEDEF(LogSegment, listEntries) SegmentList;
 
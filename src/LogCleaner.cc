@@ -26,6 +26,7 @@
 #include "SegmentIterator.h"
 #include "ServerConfig.h"
 #include "WallTime.h"
+#include "WorkerManager.h"
 
 namespace RAMCloud {
 
@@ -132,7 +133,8 @@ LogCleaner::start()
 {
     for (int i = 0; i < numThreads; i++) {
         if (threads[i] == NULL)
-            threads[i] = new std::thread(cleanerThreadEntry, this, context);
+            threads[i] = new std::thread(cleanerThreadEntry, this, context,
+                                         downCast<uint32_t>(i));
     }
 }
 
@@ -158,8 +160,6 @@ LogCleaner::stop()
     }
 
     threadsShouldExit = false;
-
-    /// XXX- should set threadCnt to 0 so we can clean on disk again!
 }
 
 /**
@@ -186,21 +186,20 @@ LogCleaner::getMetrics(ProtoBuf::LogMetrics_CleanerMetrics& m)
  * PRIVATE METHODS
  ******************************************************************************/
 
-static volatile uint32_t threadCnt;
-
 /**
  * Static entry point for the cleaner thread. This is invoked via the
  * std::thread() constructor. This thread performs continuous cleaning on an
  * as-needed basis.
  */
 void
-LogCleaner::cleanerThreadEntry(LogCleaner* logCleaner, Context* context)
+LogCleaner::cleanerThreadEntry(LogCleaner* logCleaner, Context* context,
+                               uint32_t threadNumber)
 {
     LOG(NOTICE, "LogCleaner thread started");
     PerfStats::registerStats(&PerfStats::threadStats);
 
     CleanerThreadState state;
-    state.threadNumber = __sync_fetch_and_add(&threadCnt, 1);
+    state.threadNumber = threadNumber;
     try {
         while (1) {
             Fence::lfence();
@@ -611,9 +610,17 @@ LogCleaner::getSortedEntries(LogSegmentVector& segmentsToClean,
  * survivor segments in order and alert their owning module (MasterService,
  * usually), that they've been relocated.
  *
+ * Entries are segregated by temperature (see getTemperature()): whenever the
+ * next entry belongs to a different class than the current survivor, that
+ * survivor is closed and a new one is started. Since the entries are sorted
+ * by timestamp this produces at most one partially-filled survivor per class.
+ * Each survivor also records the timestamp of the youngest entry it contains
+ * so that future cost-benefit decisions use the age of the data, rather than
+ * the age of the survivor.
+ *
  * \param entries
  *      Vector the entries from segments being cleaned that may need to be
- *      relocated.
+ *      relocated. Must be sorted by timestamp.
  * \param outSurvivors
  *      The new survivor segments created to hold the relocated live data are
  *      returned here.
@@ -633,11 +640,29 @@ LogCleaner::relocateLiveEntries(EntryVector& entries,
     CycleCounter<uint64_t> _(&localMetrics->relocateLiveEntriesTicks);
 
     LogSegment* survivor = NULL;
+    Temperature survivorTemperature = COLD;
+    uint32_t survivorDataTimestamp = 0;
     uint64_t totalEntryBytesAppended = 0;
     uint32_t currentLiveEntries[TOTAL_LOG_ENTRY_TYPES] = { 0 };
     uint32_t currentLiveEntryLengths[TOTAL_LOG_ENTRY_TYPES] = { 0 };
+    uint32_t now = WallTime::secondsTimestamp();
 
     foreach (Entry& entry, entries) {
+        Temperature temperature = getTemperature(entry.timestamp, now);
+        if (survivor != NULL && temperature != survivorTemperature) {
+            for (size_t i = 0; i < TOTAL_LOG_ENTRY_TYPES; i++) {
+                survivor->trackNewEntries(static_cast<LogEntryType>(i),
+                                          currentLiveEntries[i],
+                                          currentLiveEntryLengths[i]);
+            }
+            memset(currentLiveEntries, 0, sizeof(currentLiveEntries));
+            memset(currentLiveEntryLengths, 0,
+                   sizeof(currentLiveEntryLengths));
+            survivor->dataTimestamp = survivorDataTimestamp;
+            closeSurvivor(survivor);
+            survivor = NULL;
+        }
+
         Buffer buffer;
         LogEntryType type = entry.reference.getEntry(
             &segmentManager.getAllocator(), &buffer);
@@ -660,6 +685,7 @@ LogCleaner::relocateLiveEntries(EntryVector& entries,
                 memset(currentLiveEntries, 0, sizeof(currentLiveEntries));
                 memset(currentLiveEntryLengths, 0,
                        sizeof(currentLiveEntryLengths));
+                survivor->dataTimestamp = survivorDataTimestamp;
                 closeSurvivor(survivor);
             }
 
@@ -673,6 +699,8 @@ LogCleaner::relocateLiveEntries(EntryVector& entries,
             assert(survivor != NULL);
             waitTicks.stop();
             outSurvivors.push_back(survivor);
+            survivorTemperature = temperature;
+            survivorDataTimestamp = 0;
 
             s = relocateEntry(type,
                               buffer,
@@ -692,6 +720,8 @@ LogCleaner::relocateLiveEntries(EntryVector& entries,
                 buffer.size();
             currentLiveEntries[type]++;
             currentLiveEntryLengths[type] += bytesAppended;
+            survivorDataTimestamp = std::max(survivorDataTimestamp,
+                                             entry.timestamp);
         }
 
         totalEntryBytesAppended += bytesAppended;
@@ -703,6 +733,7 @@ LogCleaner::relocateLiveEntries(EntryVector& entries,
                                       currentLiveEntries[i],
                                       currentLiveEntryLengths[i]);
         }
+        survivor->dataTimestamp = survivorDataTimestamp;
         closeSurvivor(survivor);
     }
 
@@ -721,6 +752,30 @@ LogCleaner::relocateLiveEntries(EntryVector& entries,
     return totalEntryBytesAppended;
 }
 
+/**
+ * Estimate how likely a log entry is to be overwritten soon, based on how long
+ * it has been since it was written. Used to segregate survivor data during
+ * disk cleaning.
+ *
+ * \param timestamp
+ *      WallTime timestamp of the entry (see LogEntryHandlers::getTimestamp).
+ * \param now
+ *      Current WallTime timestamp.
+ */
+LogCleaner::Temperature
+LogCleaner::getTemperature(uint32_t timestamp, uint32_t now)
+{
+    // Clocks may be slightly off (see
+    // CleanableSegmentManager::computeCleaningCostBenefitScore), so treat
+    // timestamps in the future as brand new.
+    uint32_t age = (timestamp < now) ? now - timestamp : 0;
+    if (age < HOT_ENTRY_MAX_AGE)
+        return HOT;
+    if (age < COLD_ENTRY_MIN_AGE)
+        return WARM;
+    return COLD;
+}
+
 /**
  * Close a survivor segment we've written data to as part of a disk cleaning
  * pass and tell the replicaManager to begin flushing it asynchronously to
@@ -766,15 +821,66 @@ LogCleaner::Balancer::isMemoryLow(CleanerThreadState* thread)
         return false;
 
     // Employ multiple threads only when we fail to keep up with fewer of them.
-    if (thread->threadNumber > 0) {
-        int thresh = baseThreshold + 2 * static_cast<int>(thread->threadNumber);
-        if (T < std::min(99, thresh))
-            return false;
-    }
+    if (static_cast<int>(thread->threadNumber) >= targetThreads)
+        return false;
 
     return true;
 }
 
+/**
+ * Decide how many cleaner threads should be working, based on how memory and
+ * the server's cores are being used. Another thread is added whenever memory
+ * is low, free seglets have been disappearing since the last check (that is,
+ * new data is being appended at the log head faster than the current threads
+ * can clean), and the worker threads are leaving cores idle. Conversely,
+ * threads are given back as soon as memory is no longer low or the cores are
+ * needed to service requests. This lets the cleaner absorb write bursts
+ * without permanently dedicating cores to it, and without falling back on
+ * RETRY backpressure to writers while there are cores to spare.
+ *
+ * This is invoked frequently by cleaner thread 0, but only reconsiders the
+ * number of threads every THREAD_SCALING_USEC.
+ */
+void
+LogCleaner::Balancer::updateTargetThreads()
+{
+    uint64_t now = Cycles::rdtsc();
+    if (Cycles::toMicroseconds(now - lastThreadScalingTicks) <
+            THREAD_SCALING_USEC)
+        return;
+    lastThreadScalingTicks = now;
+
+    // See isMemoryLow for the meaning of T, L, and the threshold.
+    const int T = cleaner->segmentManager.getMemoryUtilization();
+    const int L = cleaner->cleanableSegments.getLiveObjectUtilization();
+    bool memoryLow = (T >= std::max(90, (100 + L) / 2));
+
+    size_t freeSeglets = cleaner->segmentManager.getAllocator().getFreeCount(
+            SegletAllocator::DEFAULT);
+    bool fallingBehind = (freeSeglets < lastFreeSeglets);
+    lastFreeSeglets = freeSeglets;
+
+    WorkerManager* workerManager = cleaner->context->workerManager;
+    bool coreAvailable = (workerManager == NULL) ||
+            workerManager->hasIdleCore();
+
+    int target = targetThreads;
+    if (memoryLow && fallingBehind && coreAvailable) {
+        if (target < cleaner->numThreads)
+            target++;
+    } else if (!memoryLow || !coreAvailable) {
+        if (target > 1)
+            target--;
+    }
+
+    if (target != targetThreads) {
+        LOG(DEBUG, "Cleaner now using %d of %d threads (memory utilization "
+                "%d%%, %lu free seglets)", target, cleaner->numThreads, T,
+                freeSeglets);
+        targetThreads = target;
+    }
+}
+
 /**
  * This method is called by the memory compactor if it failed to free any memory
  * after processing a segment. This is a pretty good signal that it might be
@@ -789,6 +895,9 @@ LogCleaner::Balancer::compactionFailed()
 LogCleaner::Balancer::CleaningTask
 LogCleaner::Balancer::requestTask(CleanerThreadState* thread)
 {
+    if (thread->threadNumber == 0)
+        updateTargetThreads();
+
     if (isDiskCleaningNeeded(thread))
         return CLEAN_DISK;
 
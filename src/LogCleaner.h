@@ -104,11 +104,18 @@ class LogCleaner {
     /// this many microseconds before checking again.
     enum { POLL_USEC = 10000 };
 
+    /// How often, in microseconds, the Balancer reconsiders how many cleaner
+    /// threads should be working (see Balancer::updateTargetThreads).
+    enum { THREAD_SCALING_USEC = 100000 };
+
     /// The number of full survivor segments to reserve with the SegmentManager.
     /// Must be large enough to ensure that if we get the worst possible
     /// fragmentation during cleaning, we'll still have enough space to fit in
     /// MAX_LIVE_SEGMENTS_PER_DISK_PASS of live data before freeing unused
-    /// seglets at the ends of survivor segments.
+    /// seglets at the ends of survivor segments. The slack beyond
+    /// MAX_LIVE_SEGMENTS_PER_DISK_PASS also covers the extra partially-filled
+    /// survivor that each additional temperature class may produce (see
+    /// Temperature).
     enum { SURVIVOR_SEGMENTS_TO_RESERVE = 15 };
 
     /// The minimum amount of memory utilization we will begin cleaning at using
@@ -122,6 +129,28 @@ class LogCleaner {
     /// inefficiency and requires disk cleaning to free them).
     enum { MIN_DISK_UTILIZATION = 95 };
 
+    /**
+     * Temperature classes that the disk cleaner uses to segregate survivor
+     * data. Each survivor segment only ever holds entries of a single class,
+     * so data that is likely to be overwritten soon (hot) does not keep
+     * long-lived (cold) data company and force it to be cleaned again and
+     * again. The class of an entry is estimated from its age: the longer an
+     * entry has gone without being overwritten, the less likely it is to be
+     * overwritten in the near future.
+     */
+    enum Temperature {
+        COLD = 0,
+        WARM = 1,
+        HOT = 2
+    };
+
+    /// Entries younger than this many seconds are considered HOT.
+    enum { HOT_ENTRY_MAX_AGE = 60 };
+
+    /// Entries at least this many seconds old are considered COLD. Anything
+    /// between HOT_ENTRY_MAX_AGE and this is WARM.
+    enum { COLD_ENTRY_MIN_AGE = 3600 };
+
     /**
      * Tuple containing a reference to an entry being cleaned, as well as a
      * cache of its timestamp. The purpose of this is to make sorting entries
@@ -183,6 +212,9 @@ class LogCleaner {
             : cleaner(cleaner)
             , compactionFailures(0)
             , compactionFailuresHandled(0)
+            , targetThreads(1)
+            , lastThreadScalingTicks(0)
+            , lastFreeSeglets(0)
         {
         }
         virtual ~Balancer() { }
@@ -191,11 +223,27 @@ class LogCleaner {
 
       PROTECTED:
         bool isMemoryLow(CleanerThreadState* thread);
+        void updateTargetThreads();
         virtual bool isDiskCleaningNeeded(CleanerThreadState* thread) = 0;
         LogCleaner* cleaner;
         std::atomic<uint64_t> compactionFailures;
         std::atomic<uint64_t> compactionFailuresHandled;
 
+        /// Number of cleaner threads (out of the cleaner's numThreads) that
+        /// are currently allowed to do work; the rest sleep. This starts at 1
+        /// and is adjusted at runtime by updateTargetThreads so that extra
+        /// threads only run while the cleaner is falling behind and there
+        /// are cores to spare.
+        std::atomic<int> targetThreads;
+
+        /// Cycles::rdtsc() time of the last call to updateTargetThreads that
+        /// reevaluated targetThreads. Only accessed by cleaner thread 0.
+        uint64_t lastThreadScalingTicks;
+
+        /// Number of free seglets in the default pool when targetThreads was
+        /// last reevaluated. Only accessed by cleaner thread 0.
+        size_t lastFreeSeglets;
+
         DISALLOW_COPY_AND_ASSIGN(Balancer);
     };
 
@@ -220,7 +268,8 @@ class LogCleaner {
         const uint32_t cleaningPercentage;
     };
 
-    static void cleanerThreadEntry(LogCleaner* logCleaner, Context* context);
+    static void cleanerThreadEntry(LogCleaner* logCleaner, Context* context,
+                                   uint32_t threadNumber);
     int getLiveObjectUtilization();
     int getUndeadTombstoneUtilization();
     bool checkIfCleaningNeeded(CleanerThreadState* thread);
@@ -239,6 +288,7 @@ class LogCleaner {
     uint64_t relocateLiveEntries(EntryVector& entries,
                             LogSegmentVector& outSurvivors,
                             LogCleanerMetrics::OnDisk<uint64_t>* localMetrics);
+    static Temperature getTemperature(uint32_t timestamp, uint32_t now);
     void closeSurvivor(LogSegment* survivor);
     void waitForAvailableSurvivors(size_t count, uint64_t& outTicks);
 
@@ -364,9 +414,11 @@ class LogCleaner {
     /// cleaner will run in its place.
     bool disableInMemoryCleaning;
 
-    /// The number of cleaner threads to run concurrently. More threads will
-    /// allow the system to perform more cleaning and compaction in parallel to
-    /// keep up with higher write rates and memory utilizations.
+    /// The maximum number of cleaner threads to run concurrently. More threads
+    /// will allow the system to perform more cleaning and compaction in
+    /// parallel to keep up with higher write rates and memory utilizations.
+    /// How many of them are actually working at any given time is decided by
+    /// the Balancer (see Balancer::updateTargetThreads).
     const int numThreads;
 
     /// Size of each seglet in bytes. Used to calculate the best segment for in-
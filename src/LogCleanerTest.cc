@@ -287,6 +287,60 @@ TEST_F(LogCleanerTest, doWork_notifyConditionVariable) {
     thread.join();
 }
 
+TEST_F(LogCleanerTest, Balancer_updateTargetThreads) {
+    LogCleaner::Balancer* balancer = cleaner.balancer;
+    int* numThreads = const_cast<int*>(&cleaner.numThreads);
+    int savedNumThreads = *numThreads;
+    *numThreads = 3;
+    SegmentManager::mockMemoryUtilization = 95;
+    CleanableSegmentManager::mockLiveObjectUtilization = 50;
+    LogCleaner::CleanerThreadState thread1;
+    thread1.threadNumber = 1;
+
+    // The first sample establishes the free seglet baseline.
+    balancer->updateTargetThreads();
+    EXPECT_EQ(1, balancer->targetThreads);
+    EXPECT_FALSE(balancer->isMemoryLow(&thread1));
+
+    // Falling behind with memory low: add a thread.
+    segmentManager.allocHeadSegment();
+    balancer->lastThreadScalingTicks = 0;
+    balancer->updateTargetThreads();
+    EXPECT_EQ(2, balancer->targetThreads);
+    EXPECT_TRUE(balancer->isMemoryLow(&thread1));
+
+    // Too soon to reconsider.
+    segmentManager.allocHeadSegment();
+    balancer->updateTargetThreads();
+    EXPECT_EQ(2, balancer->targetThreads);
+
+    // Never more than numThreads.
+    balancer->lastThreadScalingTicks = 0;
+    balancer->updateTargetThreads();
+    EXPECT_EQ(3, balancer->targetThreads);
+    segmentManager.allocHeadSegment();
+    balancer->lastThreadScalingTicks = 0;
+    balancer->updateTargetThreads();
+    EXPECT_EQ(3, balancer->targetThreads);
+
+    // Keeping up: hold steady.
+    balancer->lastThreadScalingTicks = 0;
+    balancer->updateTargetThreads();
+    EXPECT_EQ(3, balancer->targetThreads);
+
+    // Memory is no longer low: give threads back, but always keep one.
+    SegmentManager::mockMemoryUtilization = 50;
+    for (int i = 0; i < 3; i++) {
+        balancer->lastThreadScalingTicks = 0;
+        balancer->updateTargetThreads();
+    }
+    EXPECT_EQ(1, balancer->targetThreads);
+
+    *numThreads = savedNumThreads;
+    SegmentManager::mockMemoryUtilization = 0;
+    CleanableSegmentManager::mockLiveObjectUtilization = 0;
+}
+
 // There are currently no meaningful tests for doMemoryCleaning;
 // please write some!
 
@@ -320,6 +374,45 @@ TEST_F(LogCleanerTest, doDiskCleaning) {
         TestLog::get());
 }
 
+TEST_F(LogCleanerTest, relocateLiveEntries_segregateByTemperature) {
+    WallTime::mockWallTimeValue = 100000;
+    entryHandlers.attemptToRelocate = true;
+    LogSegment* s = segmentManager.allocHeadSegment();
+
+    LogSegmentVector segments;
+    segments.push_back(s);
+    LogCleaner::EntryVector entries;
+    LogCleanerMetrics::OnDisk<uint64_t> localMetrics;
+    cleaner.getSortedEntries(segments, entries, &localMetrics);
+    ASSERT_EQ(4U, entries.size());
+
+    // Two cold entries, one warm one, and one hot one.
+    entries[0].timestamp = 10;
+    entries[1].timestamp = 20;
+    entries[2].timestamp = 100000 - 61;
+    entries[3].timestamp = 100000 - 5;
+
+    LogSegmentVector survivors;
+    cleaner.relocateLiveEntries(entries, survivors, &localMetrics);
+    ASSERT_EQ(3U, survivors.size());
+    EXPECT_EQ(20U, survivors[0]->dataTimestamp);
+    EXPECT_EQ(100000U - 61, survivors[1]->dataTimestamp);
+    EXPECT_EQ(100000U - 5, survivors[2]->dataTimestamp);
+    foreach (LogSegment* survivor, survivors)
+        EXPECT_TRUE(survivor->closed);
+
+    WallTime::mockWallTimeValue = 0;
+}
+
+TEST_F(LogCleanerTest, getTemperature) {
+    EXPECT_EQ(LogCleaner::HOT, LogCleaner::getTemperature(1000, 1000));
+    EXPECT_EQ(LogCleaner::HOT, LogCleaner::getTemperature(1001, 1000));
+    EXPECT_EQ(LogCleaner::HOT, LogCleaner::getTemperature(941, 1000));
+    EXPECT_EQ(LogCleaner::WARM, LogCleaner::getTemperature(940, 1000));
+    EXPECT_EQ(LogCleaner::WARM, LogCleaner::getTemperature(1, 3600));
+    EXPECT_EQ(LogCleaner::COLD, LogCleaner::getTemperature(0, 3600));
+}
+
 // The tests below were disabled a long time ago by Steve Rumble and
 // never got reworked to reflect his changes, so they are currently
 // broken.
@@ -55,6 +55,40 @@ LogIterator::LogIterator(Log& log)
     next();
 }
 
+/**
+ * Construct a LogIterator that skips segments older than a given position
+ * in the log, for example the position at which an earlier iteration ended
+ * (see getPosition()). Everything appended at or after \a start is visited,
+ * but so is the rest of the segment containing \a start, as well as entries
+ * relocated by the cleaner into newer segments, so callers must tolerate
+ * seeing some entries again.
+ *
+ * The segment containing \a start is iterated from its beginning because
+ * in-memory compaction keeps segment ids but moves entries toward the
+ * front: entries appended after \a start may now be at smaller offsets.
+ *
+ * \param log
+ *      The log to iterate over.
+ * \param start
+ *      Position of the first entry that must be visited.
+ */
+LogIterator::LogIterator(Log& log, LogPosition start)
+    : log(log),
+      segmentList(),
+      currentIterator(),
+      currentSegmentId(start.getSegmentId() - 1),
+      lastSegment(NULL),
+      lastSegmentLength(),
+      done(false),
+      headReached(false)
+{
+    if (log.head == NULL) {
+        // Log is empty; not sure this should ever happen in practice.
+        done = true;
+    }
+    next();
+}
+
 /**
  * Destroy the iterator.
  */
@@ -78,15 +112,15 @@ LogIterator::next()
         // That means that all of the relevant entries are now present
         // in the log. Record the current log head position: it will
         // define the end of the iteration.
+        // Writers fill in entries after reserving space for them in the
+        // head, so only go as far as entries that have been filled in.
         lastSegment = log.head;
-        SegmentCertificate dummy;
-        lastSegmentLength = lastSegment->getAppendedLength(&dummy);
+        lastSegmentLength = log.getFilledLength(lastSegment);
 
         // The current segment (which was the head at the time of the last
         // call to this method) may have grown between then and now, so
         // reset the length of currentIterator.
-        currentIterator->setLimit(
-                segmentList.back()->getAppendedLength(&dummy));
+        currentIterator->setLimit(log.getFilledLength(segmentList.back()));
     }
 
     // First, see if there are more entries in the current segment
@@ -120,15 +154,16 @@ LogIterator::next()
         }
     }
 
-    if (segmentList.back() == log.head) {
-        headReached = true;
-    }
-
     LogSegment* nextSegment = segmentList.back();
     currentIterator.construct(*nextSegment);
     currentSegmentId = nextSegment->id;
     if (nextSegment == lastSegment) {
         currentIterator->setLimit(lastSegmentLength);
+    } else if (nextSegment == log.head) {
+        // The head's appended length may include space reserved for entries
+        // that haven't been filled in yet; see Log::getFilledLength.
+        headReached = true;
+        currentIterator->setLimit(log.getFilledLength(nextSegment));
     }
 }
 
@@ -144,6 +179,21 @@ LogIterator::onHead()
     return headReached;
 }
 
+/**
+ * Return the position of the current entry or, once the iteration is
+ * done, the position just past the last entry considered. Constructing a
+ * new LogIterator at the latter position continues where this one ended.
+ */
+LogPosition
+LogIterator::getPosition()
+{
+    if (!done)
+        return LogPosition(currentSegmentId, currentIterator->getOffset());
+    if (lastSegment == NULL)
+        return LogPosition();
+    return LogPosition(lastSegment->id, lastSegmentLength);
+}
+
 /**
  * Same as getPosition, but returns Log::Reference instead.
  */
@@ -47,15 +47,24 @@ namespace RAMCloud {
  *   will not be iterated (presumably the caller has locked out any
  *   updates that are relevant to the iteration).
  * - When iteration completes, the caller releases its lock(s).
+ *
+ * A client may also iterate without locking anything: the iteration then
+ * ends at whatever the extent of the log was in the call to next after the
+ * head was reached, and getPosition() reports where it ended. A later
+ * iterator constructed at that position visits everything appended since,
+ * along with all of the segment that the position falls in (which it may
+ * have already seen) and any entries the cleaner relocated in the meantime.
  */
 class LogIterator {
   PUBLIC:
     explicit LogIterator(Log& log);
+    LogIterator(Log& log, LogPosition start);
     ~LogIterator();
 
     void next();
     bool onHead();
     Log::Reference getReference();
+    LogPosition getPosition();
 
     /**
      * Returns true if the iteration has completed (there are no more entries
@@ -13,6 +13,8 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <thread>
+
 #include "TestUtil.h"
 
 #include "Log.h"
@@ -107,6 +109,102 @@ TEST_F(LogIteratorTest, constructor_multiSegmentLog) {
     EXPECT_EQ(1U, i.currentSegmentId);
 }
 
+TEST_F(LogIteratorTest, constructor_startPosition) {
+    for (int j = 0; j < 5; j++)
+        l.append(LOG_ENTRY_TYPE_OBJ, data, sizeof(data));
+    LogIterator first(l);
+    while (!first.isDone())
+        first.next();
+    LogPosition end = first.getPosition();
+    EXPECT_EQ(l.head->id, end.getSegmentId());
+    EXPECT_EQ(l.head->getAppendedLength(), end.getSegmentOffset());
+
+    // Nothing appended since: only the segment containing the start
+    // position is visited again.
+    int readCount = 0;
+    LogIterator again(l, end);
+    EXPECT_EQ(LogPosition(1, 0), again.getPosition());
+    for (; !again.isDone(); again.next()) {
+        if (again.getType() == LOG_ENTRY_TYPE_OBJ)
+            readCount++;
+    }
+    EXPECT_EQ(5, readCount);
+    EXPECT_EQ(end, again.getPosition());
+
+    // Entries appended since are visited, including those in new segments.
+    int writeCount = 5;
+    while (l.head->id < 2) {
+        l.append(LOG_ENTRY_TYPE_OBJ, data, sizeof(data));
+        writeCount++;
+    }
+    for (int j = 0; j < 3; j++) {
+        l.append(LOG_ENTRY_TYPE_OBJ, data, sizeof(data));
+        writeCount++;
+    }
+    readCount = 0;
+    LogIterator second(l, end);
+    for (; !second.isDone(); second.next()) {
+        if (second.getType() == LOG_ENTRY_TYPE_OBJ)
+            readCount++;
+    }
+    EXPECT_EQ(writeCount, readCount);
+    EXPECT_EQ(LogPosition(2, l.head->getAppendedLength()),
+              second.getPosition());
+
+    // Segments entirely before the start position are skipped: only the
+    // entry that rolled the head over and the 3 after it are visited.
+    readCount = 0;
+    LogIterator third(l, second.getPosition());
+    for (; !third.isDone(); third.next()) {
+        if (third.getType() == LOG_ENTRY_TYPE_OBJ)
+            readCount++;
+    }
+    EXPECT_EQ(4, readCount);
+}
+
+TEST_F(LogIteratorTest, constructor_startSegmentCompacted) {
+    // Iterate up to the end of segment 1, then append one more entry to it.
+    memset(data, 'a', sizeof(data));
+    for (int j = 0; j < 3; j++)
+        l.append(LOG_ENTRY_TYPE_OBJ, data, sizeof(data));
+    LogIterator first(l);
+    while (!first.isDone())
+        first.next();
+    LogPosition end = first.getPosition();
+    EXPECT_EQ(1U, end.getSegmentId());
+    memset(data, 'b', sizeof(data));
+    l.append(LOG_ENTRY_TYPE_OBJ, data, sizeof(data));
+    l.rollHeadOver();
+
+    // Compact segment 1 as the cleaner would if the first three entries
+    // had died: the survivor keeps the segment's id, and the surviving
+    // entry moves to an offset below the end of the first iteration.
+    LogSegmentVector cleanable;
+    segmentManager.cleanableSegments(cleanable);
+    ASSERT_EQ(1U, cleanable.size());
+    LogSegment* segment = cleanable[0];
+    EXPECT_EQ(1U, segment->id);
+    LogSegment* survivor = segmentManager.allocSideSegment(
+            SegmentManager::FOR_CLEANING, segment);
+    ASSERT_TRUE(survivor != NULL);
+    EXPECT_EQ(1U, survivor->id);
+    ASSERT_TRUE(survivor->append(LOG_ENTRY_TYPE_OBJ, data, sizeof(data)));
+    survivor->close();
+    segmentManager.compactionComplete(segment, survivor);
+    EXPECT_LT(survivor->getAppendedLength(), end.getSegmentOffset());
+
+    int found = 0;
+    for (LogIterator second(l, end); !second.isDone(); second.next()) {
+        if (second.getType() != LOG_ENTRY_TYPE_OBJ)
+            continue;
+        Buffer buffer;
+        second.appendToBuffer(buffer);
+        if (*buffer.getStart<char>() == 'b')
+            found++;
+    }
+    EXPECT_EQ(1, found);
+}
+
 TEST_F(LogIteratorTest, next_basics) {
     l.sync();
     LogIterator i(l);
@@ -241,6 +339,56 @@ TEST_F(LogIteratorTest, next_setLimitForHeadSegment) {
     EXPECT_EQ(writeCount, readCount);
 }
 
+// Copies the contents of every object entry in the log into *contents.
+static void
+iterateObjects(Log* log, std::vector<string>* contents)
+{
+    for (LogIterator i(*log); !i.isDone(); i.next()) {
+        if (i.getType() != LOG_ENTRY_TYPE_OBJ)
+            continue;
+        Buffer buffer;
+        i.appendToBuffer(buffer);
+        contents->push_back(string(static_cast<const char*>(
+                buffer.getRange(0, buffer.size())), buffer.size()));
+    }
+}
+
+TEST_F(LogIteratorTest, next_waitForReservedEntriesInHead) {
+    memset(data, 'a', sizeof(data));
+    l.append(LOG_ENTRY_TYPE_OBJ, data, sizeof(data));
+
+    // A writer reserves space for an entry in the head, the way
+    // AbstractLog::append(AppendVector*, ...) does, but hasn't filled it in.
+    Log::Reference reference;
+    uint32_t dataOffset;
+    int generation;
+    {
+        SpinLock::Guard lock(l.appendLock);
+        EXPECT_TRUE(l.reserve(lock, LOG_ENTRY_TYPE_OBJ, sizeof(data),
+                              &reference, &dataOffset));
+        generation = l.copyGeneration;
+        l.copiesInProgress[generation]++;
+    }
+
+    // A pass over the log (as during migration) must not return the entry
+    // until its contents are present.
+    std::vector<string> contents;
+    std::thread pass(iterateObjects, &l, &contents);
+    usleep(10000);
+    EXPECT_EQ(0U, contents.size());
+
+    memset(data, 'b', sizeof(data));
+    Buffer buffer;
+    buffer.appendExternal(data, sizeof(data));
+    l.head->fillReserved(dataOffset, buffer);
+    l.copiesInProgress[generation]--;
+    pass.join();
+
+    ASSERT_EQ(2U, contents.size());
+    EXPECT_EQ(string(sizeof(data), 'a'), contents[0]);
+    EXPECT_EQ(string(sizeof(data), 'b'), contents[1]);
+}
+
 TEST_F(LogIteratorTest, populateSegmentList) {
         l.sync();
         LogSegment* seg1 = segmentManager.allocHeadSegment();
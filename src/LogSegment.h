@@ -83,6 +83,7 @@ class LogSegment : public Segment {
           segletSize(segletSize),
           segmentSize(segmentSize),
           creationTimestamp(creationTimestamp),
+          dataTimestamp(creationTimestamp),
           isEmergencyHead(isEmergencyHead),
           cleanedEpoch(0),
           cachedCleaningCostBenefitScore(0),
@@ -234,6 +235,15 @@ class LogSegment : public Segment {
     /// benefit formula).
     const uint32_t creationTimestamp;
 
+    /// Timestamp of the youngest data in this segment in seconds (via
+    /// WallTime::). For head segments this is simply the creation time, but
+    /// survivor segments written by the disk cleaner contain much older data
+    /// and record the timestamp of the youngest entry relocated into them.
+    /// The cleaner uses this as the age in its cost-benefit formula so that
+    /// cold data it has already segregated is not mistaken for new data and
+    /// cleaned again prematurely.
+    uint32_t dataTimestamp;
+
     /// If true, this segment is one of two special emergency heads the system
     /// reserves so that it can always open a new log head even if out of
     /// memory. This is needed so that the cleaner can advance the head and
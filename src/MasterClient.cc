@@ -226,6 +226,68 @@ GetHeadOfLogRpc::wait()
     return { respHdr->headSegmentId, respHdr->headSegmentOffset };
 }
 
+/**
+ * Retrieve a master's per-tablet access statistics. Used by the coordinator's
+ * TabletBalancer.
+ *
+ * \param context
+ *      Overall information about this RAMCloud server or client.
+ * \param serverId
+ *      Identifier for the target server.
+ * \param[out] serverStats
+ *      Filled in with the master's statistics.
+ *
+ * \throw ServerNotUpException
+ *      The intended server for this RPC is not part of the cluster;
+ *      if it ever existed, it has since crashed.
+ */
+void
+MasterClient::getMasterStatistics(Context* context, ServerId serverId,
+        ProtoBuf::ServerStatistics& serverStats)
+{
+    GetMasterStatisticsRpc rpc(context, serverId);
+    rpc.wait(serverStats);
+}
+
+/**
+ * Constructor for GetMasterStatisticsRpc: initiates an RPC in the same way as
+ * #MasterClient::getMasterStatistics, but returns once the RPC has been
+ * initiated, without waiting for it to complete.
+ *
+ * \param context
+ *      Overall information about this RAMCloud server or client.
+ * \param serverId
+ *      Identifier for the target server.
+ */
+GetMasterStatisticsRpc::GetMasterStatisticsRpc(Context* context,
+        ServerId serverId)
+    : ServerIdRpcWrapper(context, serverId,
+            sizeof(WireFormat::GetServerStatistics::Response))
+{
+    allocHeader<WireFormat::GetServerStatistics>();
+    send();
+}
+
+/**
+ * Wait for a getMasterStatistics RPC to complete.
+ *
+ * \param[out] serverStats
+ *      Filled in with the master's statistics.
+ *
+ * \throw ServerNotUpException
+ *      The intended server for this RPC is not part of the cluster;
+ *      if it ever existed, it has since crashed.
+ */
+void
+GetMasterStatisticsRpc::wait(ProtoBuf::ServerStatistics& serverStats)
+{
+    waitAndCheckErrors();
+    const WireFormat::GetServerStatistics::Response* respHdr(
+            getResponseHeader<WireFormat::GetServerStatistics>());
+    ProtoBuf::parseFromResponse(response, sizeof(*respHdr),
+            respHdr->serverStatsLength, &serverStats);
+}
+
 /**
  * This RPC is sent to an index server to request that it insert an index
  * entry in an indexlet it holds.
@@ -378,6 +440,72 @@ IsReplicaNeededRpc::wait()
     return respHdr->needed;
 }
 
+/**
+ * Ask the master that owns a tablet to migrate it to another master. Returns
+ * once the migration is complete and the coordinator has been told of the
+ * new owner. Used by the coordinator's TabletBalancer; clients use
+ * RamCloud::migrateTablet.
+ *
+ * \param context
+ *      Overall information about this RAMCloud server or client.
+ * \param serverId
+ *      Identifier for the master that currently owns the tablet.
+ * \param tableId
+ *      Identifier for the table containing the tablet.
+ * \param firstKeyHash
+ *      Smallest key hash in the tablet.
+ * \param lastKeyHash
+ *      Largest key hash in the tablet.
+ * \param newOwnerId
+ *      Master that should own the tablet once migration completes.
+ *
+ * \throw ServerNotUpException
+ *      The intended server for this RPC is not part of the cluster;
+ *      if it ever existed, it has since crashed.
+ */
+void
+MasterClient::migrateMasterTablet(Context* context, ServerId serverId,
+        uint64_t tableId, uint64_t firstKeyHash, uint64_t lastKeyHash,
+        ServerId newOwnerId)
+{
+    MigrateMasterTabletRpc rpc(context, serverId, tableId, firstKeyHash,
+            lastKeyHash, newOwnerId);
+    rpc.wait();
+}
+
+/**
+ * Constructor for MigrateMasterTabletRpc: initiates an RPC in the same way as
+ * #MasterClient::migrateMasterTablet, but returns once the RPC has been
+ * initiated, without waiting for it to complete.
+ *
+ * \param context
+ *      Overall information about this RAMCloud server or client.
+ * \param serverId
+ *      Identifier for the master that currently owns the tablet.
+ * \param tableId
+ *      Identifier for the table containing the tablet.
+ * \param firstKeyHash
+ *      Smallest key hash in the tablet.
+ * \param lastKeyHash
+ *      Largest key hash in the tablet.
+ * \param newOwnerId
+ *      Master that should own the tablet once migration completes.
+ */
+MigrateMasterTabletRpc::MigrateMasterTabletRpc(Context* context,
+        ServerId serverId, uint64_t tableId, uint64_t firstKeyHash,
+        uint64_t lastKeyHash, ServerId newOwnerId)
+    : ServerIdRpcWrapper(context, serverId,
+            sizeof(WireFormat::MigrateTablet::Response))
+{
+    WireFormat::MigrateTablet::Request* reqHdr(
+            allocHeader<WireFormat::MigrateTablet>());
+    reqHdr->tableId = tableId;
+    reqHdr->firstKeyHash = firstKeyHash;
+    reqHdr->lastKeyHash = lastKeyHash;
+    reqHdr->newOwnerMasterId = newOwnerId.getId();
+    send();
+}
+
 /**
  * Request that a master decide whether it will accept a migrated indexlet
  * and set up any necessary state to begin receiving indexlet data from the
@@ -50,12 +50,17 @@ class MasterClient {
     static void dropTabletOwnership(Context* context, ServerId serverId,
             uint64_t tableId, uint64_t firstKeyHash, uint64_t lastKeyHash);
     static LogPosition getHeadOfLog(Context* context, ServerId serverId);
+    static void getMasterStatistics(Context* context, ServerId serverId,
+            ProtoBuf::ServerStatistics& serverStats);
     static void insertIndexEntry(Context* context,
             uint64_t tableId, uint8_t indexId,
             const void* indexKey, KeyLength indexKeyLength,
             uint64_t primaryKeyHash);
     static bool isReplicaNeeded(Context* context, ServerId serverId,
             ServerId backupServerId, uint64_t segmentId);
+    static void migrateMasterTablet(Context* context, ServerId serverId,
+            uint64_t tableId, uint64_t firstKeyHash, uint64_t lastKeyHash,
+            ServerId newOwnerId);
     static void prepForIndexletMigration(Context* context, ServerId serverId,
             uint64_t tableId, uint8_t indexId, uint64_t backingTableId,
             const void* firstKey, uint16_t firstKeyLength,
@@ -146,6 +151,20 @@ class GetHeadOfLogRpc : public ServerIdRpcWrapper {
     DISALLOW_COPY_AND_ASSIGN(GetHeadOfLogRpc);
 };
 
+/**
+ * Encapsulates the state of a MasterClient::getMasterStatistics
+ * request, allowing it to execute asynchronously.
+ */
+class GetMasterStatisticsRpc : public ServerIdRpcWrapper {
+  public:
+    GetMasterStatisticsRpc(Context* context, ServerId serverId);
+    ~GetMasterStatisticsRpc() {}
+    void wait(ProtoBuf::ServerStatistics& serverStats);
+
+  PRIVATE:
+    DISALLOW_COPY_AND_ASSIGN(GetMasterStatisticsRpc);
+};
+
 /**
  * Encapsulates the state of a MasterClient::insertIndexEntry
  * request, allowing it to execute asynchronously.
@@ -179,6 +198,23 @@ class IsReplicaNeededRpc : public ServerIdRpcWrapper {
     DISALLOW_COPY_AND_ASSIGN(IsReplicaNeededRpc);
 };
 
+/**
+ * Encapsulates the state of a MasterClient::migrateMasterTablet
+ * request, allowing it to execute asynchronously.
+ */
+class MigrateMasterTabletRpc : public ServerIdRpcWrapper {
+  public:
+    MigrateMasterTabletRpc(Context* context, ServerId serverId,
+            uint64_t tableId, uint64_t firstKeyHash, uint64_t lastKeyHash,
+            ServerId newOwnerId);
+    ~MigrateMasterTabletRpc() {}
+    /// \copydoc ServerIdRpcWrapper::waitAndCheckErrors
+    void wait() {waitAndCheckErrors();}
+
+  PRIVATE:
+    DISALLOW_COPY_AND_ASSIGN(MigrateMasterTabletRpc);
+};
+
 /**
  * Encapsulates the state of a MasterClient::prepForIndexletMigration
  * request, allowing it to execute asynchronously.
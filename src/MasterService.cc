@@ -13,6 +13,8 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <condition_variable>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -222,6 +224,10 @@ MasterService::dispatch(WireFormat::Opcode opcode, Rpc* rpc)
             callHandler<WireFormat::RemoveIndexEntry, MasterService,
                         &MasterService::removeIndexEntry>(rpc);
             break;
+        case WireFormat::Scan::opcode:
+            callHandler<WireFormat::Scan, MasterService,
+                        &MasterService::scan>(rpc);
+            break;
         case WireFormat::SplitAndMigrateIndexlet::opcode:
             callHandler<WireFormat::SplitAndMigrateIndexlet, MasterService,
                         &MasterService::splitAndMigrateIndexlet>(rpc);
@@ -497,6 +503,13 @@ MasterService::getServerStatistics(
 {
     ProtoBuf::ServerStatistics serverStats;
     tabletManager.getStatistics(&serverStats);
+    for (int i = 0; i < serverStats.tabletentry_size(); i++) {
+        ProtoBuf::ServerStatistics_TabletEntry* entry =
+                serverStats.mutable_tabletentry(i);
+        entry->set_byte_count(TableStats::estimateBytes(&masterTableMetadata,
+                entry->table_id(), entry->start_key_hash(),
+                entry->end_key_hash()));
+    }
     SpinLock::getStatistics(serverStats.mutable_spin_lock_stats());
     respHdr->serverStatsLength = serializeToResponse(
             rpc->replyPayload, &serverStats);
@@ -611,6 +624,8 @@ MasterService::increment(const WireFormat::Increment::Request* reqHdr,
     // Read the current value of the object and add the increment value
     Key key(reqHdr->tableId, *rpc->requestPayload, sizeof32(*reqHdr),
             reqHdr->keyLength);
+    if (rpc->keyHash)
+        key.setHash(*rpc->keyHash);
     Status *status = &respHdr->common.status;
 
     int64_t asInt64 = reqHdr->incrementInt64;
@@ -891,17 +906,17 @@ MasterService::lookupIndexKeys(
  * Helper function to avoid code duplication in migrateTablet which copies a log
  * entry to a segment for migration if it is a live log entry.
  *
- * If the segment is full, it will send the segment to the target of the
- * migration, destroy the segment, and create a new one.
+ * If the segment is full, the sender sends it to the target of the
+ * migration (without waiting for it to be received) and starts a new one.
  *
  * If there is an error, this method will set the status code of the response
  * to the client to be an error.
  *
  * \param it
  *      The iterator that points at the object we are attempting to migrate.
- * \param[out] transferSeg
- *      Segment object that we append objects to, and possibly send when it gets
- *      full.
+ * \param sender
+ *      Batches entries into segments and sends them to the master that is
+ *      receiving the migration data.
  * \param[out] entryTotals
  *      Array indexed by type of the total number of log entries copied into
  *      segments for transfer thus far, which we increment whenever we append an
@@ -916,10 +931,6 @@ MasterService::lookupIndexKeys(
  *      Lowest key hash that will be migrated.
  * \param lastKeyHash
  *      Highest key hash that will be migrated.
- * \param receiver
- *      ServerId of the master that is receiving the migration data. Each time
- *      a transfer segment fills, this server will be sent an RPC containing
- *      the data.
  * \return
  *      Returns STATUS_OK on success (either the entry is ignored or
  *      successfully added to the segment) or another status failure (an entry
@@ -928,13 +939,12 @@ MasterService::lookupIndexKeys(
 Status
 MasterService::migrateSingleLogEntry(
         SegmentIterator& it,
-        Tub<Segment>& transferSeg,
+        MigrationSender& sender,
         uint64_t entryTotals[],
         uint64_t& totalBytes,
         uint64_t tableId,
         uint64_t firstKeyHash,
-        uint64_t lastKeyHash,
-        ServerId receiver)
+        uint64_t lastKeyHash)
 {
     LogEntryType type = it.getType();
     if (type != LOG_ENTRY_TYPE_OBJ &&
@@ -1033,31 +1043,12 @@ MasterService::migrateSingleLogEntry(
     totalBytes += buffer.size();
     PerfStats::threadStats.migrationPhase1Bytes += buffer.size();
 
-    if (!transferSeg)
-        transferSeg.construct();
-
 #if !MIGRATION_SKIP_APPEND
-    // If we can't fit it, send the current buffer and retry.
-    if (!transferSeg->append(type, buffer)) {
-        transferSeg->close();
-        LOG(DEBUG, "Sending migration segment");
-        if (expect_true(receiver != ServerId{})) {
-#if !MIGRATION_SKIP_TX
-            MasterClient::receiveMigrationData(context, receiver,
-                    transferSeg.get(), tableId, firstKeyHash);
-#endif
-        }
-
-        transferSeg.destroy();
-        transferSeg.construct();
-
-        // If it doesn't fit this time, we're in trouble.
-        if (!transferSeg->append(type, buffer)) {
-            LOG(ERROR, "Tablet migration failed: could not fit object "
-                    "into empty segment (obj bytes %u)",
-                    buffer.size());
-            return STATUS_INTERNAL_ERROR;
-        }
+    if (!sender.append(type, buffer)) {
+        LOG(ERROR, "Tablet migration failed: could not fit object "
+                "into empty segment (obj bytes %u)",
+                buffer.size());
+        return STATUS_INTERNAL_ERROR;
     }
 #endif
 
@@ -1124,61 +1115,66 @@ MasterService::migrateTablet(const WireFormat::MigrateTablet::Request* reqHdr,
         context->serverList->toString(receiver).c_str());
 
     // We'll send over objects in Segment containers for better network
-    // efficiency and convenience.
-    Tub<Segment> transferSeg;
+    // efficiency and convenience, keeping several in flight at once.
+    MigrationSender sender(context, receiver, tableId, firstKeyHash,
+                           MIGRATION_RPCS_IN_FLIGHT);
 
     uint64_t entryTotals[TOTAL_LOG_ENTRY_TYPES] = {0};
     uint64_t totalBytes = 0;
+    Log* log = objectManager.getLog();
 
-    LogIterator it(*objectManager.getLog());
-    // Phase 1: scan the log from oldest to newest entries until we reach
-    // the head segment.
+    // Phase 1: scan the log from oldest to newest entries while writes to
+    // the tablet continue. Anything written during a pass is appended past
+    // the position where that pass ended, so each further pass copies just
+    // that range of the log (starting from the beginning of the segment it
+    // ended in; see LogIterator). Stop once a pass has little new to copy.
     CycleCounter<> phase1Cycles{};
-    if (!it.isDone()) {
-        while (true) {
+    LogPosition passStart;
+    for (uint32_t pass = 0; pass < MAX_MIGRATION_PASSES; pass++) {
+        uint64_t passBytes = totalBytes;
+        uint64_t resentBytes = 0;
+        LogIterator it(*log, passStart);
+        for (; !it.isDone(); it.next()) {
+            uint64_t entryStart = totalBytes;
             Status error = migrateSingleLogEntry(
                     *it.getCurrentSegmentIterator(),
-                    transferSeg, entryTotals, totalBytes,
-                    tableId, firstKeyHash, lastKeyHash,
-                    receiver);
+                    sender, entryTotals, totalBytes,
+                    tableId, firstKeyHash, lastKeyHash);
             if (error) return;
-
-            if (it.onHead())
-                break;
-            it.next();
+            // Entries before passStart were (most likely) copied by the
+            // previous pass, so they don't count toward this one's progress.
+            if (it.getPosition() < passStart)
+                resentBytes += totalBytes - entryStart;
         }
+        passStart = it.getPosition();
+        passBytes = totalBytes - passBytes - resentBytes;
+        if (passBytes <= MIGRATION_HANDOFF_BYTES)
+            break;
+        LOG(NOTICE, "Migration pass %u over the log copied %lu bytes; "
+            "copying writes made during the pass", pass, passBytes);
     }
     PerfStats::threadStats.migrationPhase1Cycles += phase1Cycles.stop();
 
     // Phase 2: block new writes and let current writes finish
-    if (it.onHead()) {
-        tabletManager.changeState(tableId, firstKeyHash, lastKeyHash,
-                TabletManager::NORMAL, TabletManager::LOCKED_FOR_MIGRATION);
+    tabletManager.changeState(tableId, firstKeyHash, lastKeyHash,
+            TabletManager::NORMAL, TabletManager::LOCKED_FOR_MIGRATION);
 
-        // Wait for the remainder of already running writes to finish.
-        LogProtector::wait(context, Transport::ServerRpc::APPEND_ACTIVITY);
-    }
+    // Wait for the remainder of already running writes to finish.
+    LogProtector::wait(context, Transport::ServerRpc::APPEND_ACTIVITY);
 
-    // Phase 3: finish iterating over the remaining log entries.
-    while (true) {
-        it.next();
-        if (it.isDone())
-            break;
+    // Phase 3: copy the log entries appended since the last pass (again
+    // starting from the beginning of the segment it ended in).
+    for (LogIterator it(*log, passStart); !it.isDone(); it.next()) {
         Status error = migrateSingleLogEntry(
                 *it.getCurrentSegmentIterator(),
-                transferSeg, entryTotals, totalBytes,
-                tableId, firstKeyHash, lastKeyHash,
-                receiver);
+                sender, entryTotals, totalBytes,
+                tableId, firstKeyHash, lastKeyHash);
         if (error) return;
     }
 
-    if (transferSeg) {
-        transferSeg->close();
+    if (sender.hasBufferedData())
         LOG(DEBUG, "Sending last migration segment");
-        MasterClient::receiveMigrationData(context, receiver,
-                transferSeg.get(), tableId, firstKeyHash);
-        transferSeg.destroy();
-    }
+    sender.flush();
 
     // Now that all data has been transferred, we can reassign ownership of
     // the tablet. If this succeeds, we are free to drop the tablet. The
@@ -1189,6 +1185,12 @@ MasterService::migrateTablet(const WireFormat::MigrateTablet::Request* reqHdr,
     tabletManager.changeState(tableId, firstKeyHash, lastKeyHash,
             TabletManager::LOCKED_FOR_MIGRATION, TabletManager::NORMAL);
 #else
+    // Leases on the tablet's objects (see ReadLeaseTable) aren't migrated,
+    // and the new owner will accept writes as soon as it owns the tablet.
+    // No leases have been granted on the tablet since it was locked, so wait
+    // for the ones granted before that to run out.
+    objectManager.waitForAllReadLeases();
+
     CoordinatorClient::reassignTabletOwnership(context,
             tableId, firstKeyHash, lastKeyHash, receiver,
             newOwnerLogHead.getSegmentId(), newOwnerLogHead.getSegmentOffset());
@@ -1353,8 +1355,17 @@ MasterService::multiRead(const WireFormat::MultiOp::Request* reqHdr,
     respHdr->count = numRequests;
     uint32_t oldResponseLength = rpc->replyPayload->size();
 
-    // Each iteration extracts one request from request rpc, finds the
-    // corresponding object, and appends the response to the response rpc.
+    // Requests are parsed in batches of up to MULTI_READ_BATCH_SIZE so that
+    // the hash table buckets and log entries for all of the objects in a
+    // batch can be prefetched before any of them are read.
+    Tub<Key> keys[MULTI_READ_BATCH_SIZE];
+    Key* batchKeys[MULTI_READ_BATCH_SIZE];
+    RejectRules rejectRules[MULTI_READ_BATCH_SIZE];
+    uint32_t batchStart = 0;
+    uint32_t batchSize = 0;
+
+    // Each iteration finds the object for one request and appends the
+    // response to the response rpc.
     for (uint32_t i = 0; ; i++) {
         // If the RPC response has exceeded the legal limit, truncate it
         // to the last object that fits below the limit (the client will
@@ -1375,31 +1386,47 @@ MasterService::multiRead(const WireFormat::MultiOp::Request* reqHdr,
             break;
         }
 
-        const WireFormat::MultiOp::Request::ReadPart *currentReq =
-                rpc->requestPayload->getOffset<
-                WireFormat::MultiOp::Request::ReadPart>(reqOffset);
-        reqOffset += sizeof32(WireFormat::MultiOp::Request::ReadPart);
-
-        const void* stringKey = rpc->requestPayload->getRange(
-                reqOffset, currentReq->keyLength);
-        reqOffset += currentReq->keyLength;
-
-        if (stringKey == NULL) {
-            respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
-            break;
+        if (i == batchStart + batchSize) {
+            // Extract the next batch of requests from the request rpc. A
+            // malformed request ends the batch early; it is reported once
+            // all of the requests before it have been processed.
+            batchStart = i;
+            batchSize = 0;
+            while (batchSize < MULTI_READ_BATCH_SIZE &&
+                    batchStart + batchSize < numRequests) {
+                const WireFormat::MultiOp::Request::ReadPart *currentReq =
+                        rpc->requestPayload->getOffset<
+                        WireFormat::MultiOp::Request::ReadPart>(reqOffset);
+                if (currentReq == NULL)
+                    break;
+                const void* stringKey = rpc->requestPayload->getRange(
+                        reqOffset + sizeof32(*currentReq),
+                        currentReq->keyLength);
+                if (stringKey == NULL)
+                    break;
+                reqOffset += sizeof32(*currentReq) + currentReq->keyLength;
+
+                keys[batchSize].construct(currentReq->tableId, stringKey,
+                        currentReq->keyLength);
+                batchKeys[batchSize] = keys[batchSize].get();
+                rejectRules[batchSize] = currentReq->rejectRules;
+                batchSize++;
+            }
+            if (batchSize == 0) {
+                respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
+                break;
+            }
+            objectManager.prefetchObjects(batchKeys, batchSize);
         }
 
-        Key key(currentReq->tableId, stringKey, currentReq->keyLength);
-
         WireFormat::MultiOp::Response::ReadPart* currentResp =
                rpc->replyPayload->emplaceAppend<
                WireFormat::MultiOp::Response::ReadPart>();
 
         uint32_t initialLength = rpc->replyPayload->size();
-        RejectRules rejectRules = currentReq->rejectRules;
         currentResp->status = objectManager.readObject(
-                key, rpc->replyPayload, &rejectRules,
-                &currentResp->version);
+                *keys[i - batchStart], rpc->replyPayload,
+                &rejectRules[i - batchStart], &currentResp->version);
 
         if (currentResp->status != STATUS_OK)
             continue;
@@ -1732,16 +1759,21 @@ MasterService::read(const WireFormat::Read::Request* reqHdr,
     }
 
     Key key(reqHdr->tableId, stringKey, reqHdr->keyLength);
+    if (rpc->keyHash)
+        key.setHash(*rpc->keyHash);
 
     RejectRules rejectRules = reqHdr->rejectRules;
     bool valueOnly = true;
+    uint32_t leaseNanoseconds = reqHdr->leaseNanoseconds;
     uint32_t initialLength = rpc->replyPayload->size();
     respHdr->common.status = objectManager.readObject(
-            key, rpc->replyPayload, &rejectRules, &respHdr->version, valueOnly);
+            key, rpc->replyPayload, &rejectRules, &respHdr->version, valueOnly,
+            &leaseNanoseconds);
 
     if (respHdr->common.status != STATUS_OK)
         return;
 
+    respHdr->leaseNanoseconds = leaseNanoseconds;
     respHdr->length = rpc->replyPayload->size() - initialLength;
 }
 
@@ -1779,6 +1811,8 @@ MasterService::readKeysAndValue(
     }
 
     Key key(reqHdr->tableId, stringKey, reqHdr->keyLength);
+    if (rpc->keyHash)
+        key.setHash(*rpc->keyHash);
 
     RejectRules rejectRules = reqHdr->rejectRules;
     uint32_t initialLength = rpc->replyPayload->size();
@@ -1900,6 +1934,8 @@ MasterService::remove(const WireFormat::Remove::Request* reqHdr,
     }
 
     Key key(reqHdr->tableId, stringKey, reqHdr->keyLength);
+    if (rpc->keyHash)
+        key.setHash(*rpc->keyHash);
 
     // Buffer for object being removed, so we can remove corresponding
     // index entries later.
@@ -2238,6 +2274,83 @@ MasterService::migrateSingleIndexObject(
     return 0;
 }
 
+/**
+ * Top-level server method to handle the SCAN request. SCAN works like
+ * ENUMERATE, except that it covers only a given range of key hashes (so
+ * that clients can scan different parts of a table in parallel), the
+ * client can choose the amount of data returned in each response, and
+ * objects can be filtered by key prefix and version here, rather than
+ * being shipped to the client and discarded there.
+ *
+ * \copydetails Service::ping
+ */
+void
+MasterService::scan(const WireFormat::Scan::Request* reqHdr,
+        WireFormat::Scan::Response* respHdr,
+        Rpc* rpc)
+{
+    if (reqHdr->lastHash < reqHdr->tabletFirstHash) {
+        respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
+        return;
+    }
+
+    TabletManager::Tablet tablet;
+    bool found = tabletManager.getTablet(reqHdr->tableId,
+            reqHdr->tabletFirstHash, &tablet);
+    if (!found) {
+        respHdr->common.status = STATUS_UNKNOWN_TABLET;
+        return;
+    }
+
+    uint32_t reqOffset = downCast<uint32_t>(sizeof(*reqHdr));
+    const void* keyPrefix = NULL;
+    if (reqHdr->keyPrefixLength > 0) {
+        keyPrefix = rpc->requestPayload->getRange(reqOffset,
+                reqHdr->keyPrefixLength);
+        if (keyPrefix == NULL) {
+            respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
+            return;
+        }
+        reqOffset += reqHdr->keyPrefixLength;
+    }
+
+    // Pretend that the tablet ends at the end of the requested range.
+    // This keeps the scan from returning objects that belong to another
+    // range being scanned in parallel, and it makes us point the client
+    // past the range once the range has been completely scanned.
+    uint64_t actualTabletStartHash = tablet.startKeyHash;
+    uint64_t actualTabletEndHash = std::min(tablet.endKeyHash,
+            reqHdr->lastHash);
+
+    EnumerationIterator iter(*rpc->requestPayload, reqOffset,
+            reqHdr->iteratorBytes);
+
+    // As in enumerate, leave room in the reply for the response header
+    // and the iterator. Note: Enumeration's limit applies to the entire
+    // reply, including the response header.
+    uint32_t maxPayloadBytes = downCast<uint32_t>(
+            Transport::MAX_RPC_LEN - sizeof(*respHdr) - (1 << 20));
+    if (reqHdr->maxPayloadBytes != 0 &&
+            reqHdr->maxPayloadBytes < maxPayloadBytes) {
+        maxPayloadBytes = reqHdr->maxPayloadBytes +
+                downCast<uint32_t>(sizeof(*respHdr));
+    }
+    Enumeration enumeration(
+            reqHdr->tableId, reqHdr->keysOnly,
+            reqHdr->tabletFirstHash,
+            actualTabletStartHash, actualTabletEndHash,
+            &respHdr->tabletFirstHash, iter,
+            *objectManager.getLog(),
+            *objectManager.getObjectMap(),
+            *rpc->replyPayload, maxPayloadBytes);
+    enumeration.setFilter(keyPrefix, reqHdr->keyPrefixLength,
+            reqHdr->minVersion);
+    enumeration.complete();
+    respHdr->payloadBytes = rpc->replyPayload->size()
+            - downCast<uint32_t>(sizeof(*respHdr));
+    respHdr->iteratorBytes = iter.serialize(*rpc->replyPayload);
+}
+
 /**
  * Top-level server method to handle the SPLIT_AND_MIGRAGE_INDEXLET request.
  *
@@ -3177,8 +3290,11 @@ MasterService::write(const WireFormat::Write::Request* reqHdr,
     KeyLength pKeyLen;
     const void* pKey = object.getKey(0, &pKeyLen);
     respHdr->common.status = STATUS_OK;
+    KeyHash keyHash = rpc->keyHash ? *rpc->keyHash
+                                   : Key::getHash(reqHdr->tableId, pKey,
+                                                  pKeyLen);
     RpcResult rpcResult(
-            reqHdr->tableId, Key::getHash(reqHdr->tableId, pKey, pKeyLen),
+            reqHdr->tableId, keyHash,
             reqHdr->lease.leaseId, reqHdr->rpcId, reqHdr->ackId,
             respHdr, sizeof(*respHdr));
 
@@ -3355,6 +3471,221 @@ class RecoveryTask {
     Tub<GetRecoveryDataRpc> rpc;
     DISALLOW_COPY_AND_ASSIGN(RecoveryTask);
 };
+
+/**
+ * Spreads the replay of each recovery segment across several cores. The
+ * entries of a segment are divided into partitions by hash table bucket
+ * lock stripe (see ObjectManager::getReplayPartition()), so helpers don't
+ * contend for bucket locks either. The thread running recover()
+ * replays partition 0 itself and each of the other partitions is replayed
+ * concurrently by a helper thread owned by this class. Each helper appends
+ * to its own SideLog, so helpers never contend on a log head; the SideLogs
+ * are all committed once recovery has replayed every segment.
+ */
+class ReplayThreads {
+  PUBLIC:
+    /**
+     * Construct a ReplayThreads and start its helper threads.
+     *
+     * \param objectManager
+     *      The ObjectManager to replay segments into.
+     * \param numPartitions
+     *      Total number of threads to replay each segment with, including
+     *      the caller of replay().
+     * \param nextNodeIdMap
+     *      The recovery's map of indexlet nextNodeIds; each helper updates
+     *      its own copy, which is merged back by commit().
+     */
+    ReplayThreads(ObjectManager* objectManager, uint32_t numPartitions,
+                  std::unordered_map<uint64_t, uint64_t>* nextNodeIdMap)
+        : objectManager(objectManager)
+        , numPartitions(std::max(numPartitions, 1U))
+        , nextNodeIdMap(nextNodeIdMap)
+        , mutex()
+        , workReady()
+        , workDone()
+        , segment(NULL)
+        , generation(0)
+        , busyHelpers(0)
+        , exiting(false)
+        , error()
+        , sideLogs()
+        , nextNodeIdMaps()
+        , threads()
+    {
+        for (uint32_t i = 1; i < this->numPartitions; i++) {
+            sideLogs.emplace_back(new SideLog(objectManager->getLog()));
+            nextNodeIdMaps.push_back(*nextNodeIdMap);
+        }
+        for (uint32_t i = 1; i < this->numPartitions; i++)
+            threads.emplace_back(&ReplayThreads::helperMain, this, i);
+    }
+
+    ~ReplayThreads()
+    {
+        {
+            std::lock_guard<std::mutex> _(mutex);
+            exiting = true;
+        }
+        workReady.notify_all();
+        foreach (std::thread& thread, threads)
+            thread.join();
+    }
+
+    /**
+     * Replay one recovery segment, returning once all partitions of it
+     * have been replayed.
+     *
+     * \param sideLog
+     *      SideLog for the entries in partition 0.
+     * \param it
+     *      Iterator positioned at the start of the recovery segment.
+     * \throw
+     *      Any exception thrown by ObjectManager::replaySegment() in any of
+     *      the threads.
+     */
+    void
+    replay(SideLog* sideLog, SegmentIterator& it)
+    {
+        if (numPartitions == 1) {
+            objectManager->replaySegment(sideLog, it, nextNodeIdMap);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> _(mutex);
+            segment = &it;
+            generation++;
+            busyHelpers = numPartitions - 1;
+            error = std::exception_ptr();
+        }
+        workReady.notify_all();
+
+        // The helpers read from the segment, so they must finish before we
+        // return, even if our partition fails.
+        std::exception_ptr ourError;
+        try {
+            SegmentIterator ours(it);
+            objectManager->replaySegment(sideLog, ours, nextNodeIdMap,
+                                         0, numPartitions);
+        } catch (...) {
+            ourError = std::current_exception();
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        while (busyHelpers > 0)
+            workDone.wait(lock);
+        segment = NULL;
+        if (ourError)
+            std::rethrow_exception(ourError);
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    /**
+     * Commit the helpers' SideLogs, making the entries they replayed
+     * durable and part of the log, and fold the helpers' nextNodeIds into
+     * the recovery's map.
+     */
+    void
+    commit()
+    {
+        foreach (auto& sideLog, sideLogs)
+            sideLog->commit();
+        TEST_LOG("Committed %lu helper SideLogs", sideLogs.size());
+        foreach (auto& helperMap, nextNodeIdMaps) {
+            foreach (auto& entry, helperMap) {
+                uint64_t& nextNodeId = (*nextNodeIdMap)[entry.first];
+                nextNodeId = std::max(nextNodeId, entry.second);
+            }
+        }
+    }
+
+  PRIVATE:
+    /**
+     * Main loop of each helper thread: wait for a segment and replay this
+     * thread's partition of it.
+     *
+     * \param partition
+     *      The partition of every segment that this thread replays.
+     */
+    void
+    helperMain(uint32_t partition)
+    {
+        uint64_t lastGeneration = 0;
+        while (true) {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!exiting && generation == lastGeneration)
+                workReady.wait(lock);
+            if (exiting)
+                return;
+            lastGeneration = generation;
+            SegmentIterator it(*segment);
+            lock.unlock();
+
+            try {
+                objectManager->replaySegment(sideLogs[partition - 1].get(),
+                        it, &nextNodeIdMaps[partition - 1], partition,
+                        numPartitions);
+            } catch (...) {
+                std::lock_guard<std::mutex> _(mutex);
+                if (!error)
+                    error = std::current_exception();
+            }
+
+            lock.lock();
+            if (--busyHelpers == 0)
+                workDone.notify_all();
+        }
+    }
+
+    /// Where replayed entries go.
+    ObjectManager* objectManager;
+
+    /// Number of partitions each segment is replayed in (one more than the
+    /// number of helper threads).
+    const uint32_t numPartitions;
+
+    /// The recovery's indexlet nextNodeId map (see recover()).
+    std::unordered_map<uint64_t, uint64_t>* nextNodeIdMap;
+
+    /// Protects all of the fields below that are shared with the helpers.
+    std::mutex mutex;
+
+    /// Signalled when a new segment is available or the helpers must exit.
+    std::condition_variable workReady;
+
+    /// Signalled when the last helper finishes replaying a segment.
+    std::condition_variable workDone;
+
+    /// The segment currently being replayed, if any.
+    SegmentIterator* segment;
+
+    /// Incremented each time a new segment is handed to the helpers.
+    uint64_t generation;
+
+    /// Number of helpers that have not yet finished the current segment.
+    uint32_t busyHelpers;
+
+    /// Set to tell the helpers to exit.
+    bool exiting;
+
+    /// The first exception thrown by a helper during the current segment.
+    std::exception_ptr error;
+
+    /// sideLogs[i] receives the entries replayed by the helper for
+    /// partition i + 1.
+    std::vector<std::unique_ptr<SideLog>> sideLogs;
+
+    /// nextNodeIdMaps[i] is the copy of the nextNodeId map updated by the
+    /// helper for partition i + 1.
+    std::vector<std::unordered_map<uint64_t, uint64_t>> nextNodeIdMaps;
+
+    /// The helper threads.
+    std::vector<std::thread> threads;
+
+    DISALLOW_COPY_AND_ASSIGN(ReplayThreads);
+};
 } // namespace MasterServiceInternal
 
 using namespace MasterServiceInternal; // NOLINT
@@ -3503,6 +3834,11 @@ MasterService::recover(uint64_t recoveryId, ServerId masterId,
     // durable.
     SideLog sideLog(objectManager.getLog());
 
+    // Replay of each segment is shared with helper threads, which have
+    // SideLogs of their own.
+    ReplayThreads replayThreads(&objectManager,
+            config->master.recoveryReplayThreads, &nextNodeIdMap);
+
     // Start RPCs
     auto replicaIt = notStarted;
     foreach (auto& task, tasks) {
@@ -3616,7 +3952,7 @@ MasterService::recover(uint64_t recoveryId, ServerId masterId,
                                     ReplicatedSegment::recoveryStart),
                             task->replica.segmentId, responseLen);
                 }
-                objectManager.replaySegment(&sideLog, it, &nextNodeIdMap);
+                replayThreads.replay(&sideLog, it);
                 usefulTime += Cycles::rdtsc() - startUseful;
                 TEST_LOG("Segment %lu replay complete",
                          task->replica.segmentId);
@@ -3716,6 +4052,7 @@ MasterService::recover(uint64_t recoveryId, ServerId masterId,
                 0 - metrics->transport.infiniband.transmitActiveTicks;
         metrics->master.logSyncPostingWriteRpcTicks =
                 0 - metrics->master.replicationPostingWriteRpcTicks;
+        replayThreads.commit();
         sideLog.commit();
         metrics->master.logSyncBytes += metrics->transport.transmit.byteCount;
         metrics->master.logSyncTransmitCopyTicks +=
@@ -25,6 +25,7 @@
 #include "LogIterator.h"
 #include "HashTable.h"
 #include "MasterTableMetadata.h"
+#include "MigrationSender.h"
 #include "Object.h"
 #include "ObjectFinder.h"
 #include "ObjectManager.h"
@@ -213,13 +214,12 @@ class MasterService : public Service {
                 WireFormat::SplitAndMigrateIndexlet::Response* respHdr);
   public: // For MigrateTabletBenchmark.
     Status migrateSingleLogEntry(SegmentIterator& it,
-                Tub<Segment>& transferSeg,
+                MigrationSender& sender,
                 uint64_t entryTotals[],
                 uint64_t& totalBytes,
                 uint64_t tableId,
                 uint64_t firstKeyHash,
-                uint64_t lastKeyHash,
-                ServerId receiver);
+                uint64_t lastKeyHash);
   PRIVATE:
     void migrateTablet(const WireFormat::MigrateTablet::Request* reqHdr,
                 WireFormat::MigrateTablet::Response* respHdr,
@@ -264,6 +264,9 @@ class MasterService : public Service {
                 Rpc* rpc);
     void requestInsertIndexEntries(Object& object);
     void requestRemoveIndexEntries(Object& object);
+    void scan(const WireFormat::Scan::Request* reqHdr,
+                WireFormat::Scan::Response* respHdr,
+                Rpc* rpc);
     void splitAndMigrateIndexlet(
                 const WireFormat::SplitAndMigrateIndexlet::Request* reqHdr,
                 WireFormat::SplitAndMigrateIndexlet::Response* respHdr,
@@ -375,6 +378,35 @@ class MasterService : public Service {
      */
     uint32_t maxResponseRpcLen;
 
+    /**
+     * Number of objects whose hash table buckets and log entries multiRead
+     * prefetches together before reading any of them (see
+     * ObjectManager::prefetchObjects()).
+     */
+    static const uint32_t MULTI_READ_BATCH_SIZE = 16;
+
+    /**
+     * Number of segment-sized batches of tablet data that migrateTablet
+     * keeps in flight to the new owner at once.
+     */
+    static const uint32_t MIGRATION_RPCS_IN_FLIGHT = 4;
+
+    /**
+     * migrateTablet keeps making passes over the log, each copying the
+     * entries appended during the previous pass, until a pass copies no
+     * more than this many bytes of the tablet's data; only then are writes
+     * to the tablet blocked for the final pass. This bounds how long the
+     * tablet is unavailable.
+     */
+    static const uint64_t MIGRATION_HANDOFF_BYTES = 1024 * 1024;
+
+    /**
+     * Upper bound on the number of passes migrateTablet makes over the log
+     * while writes continue, in case the tablet is written faster than it
+     * can be copied.
+     */
+    static const uint32_t MAX_MIGRATION_PASSES = 8;
+
     /*
      * Used to identify tablets for which migration is underway.
      */
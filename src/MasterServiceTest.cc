@@ -641,8 +641,10 @@ TEST_F(MasterServiceTest, getServerStatistics) {
     ramcloud->getServerStatistics("mock:host=master", serverStats);
     EXPECT_TRUE(StringUtil::startsWith(serverStats.ShortDebugString(),
             "tabletentry { table_id: 1 start_key_hash: 0 "
-            "end_key_hash: 18446744073709551615 number_read_and_writes: 4 } "
-            "spin_lock_stats { locks { name:"));
+            "end_key_hash: 18446744073709551615 number_read_and_writes: 4 "
+            "number_reads: 3 number_writes: 1 "));
+    EXPECT_TRUE(TestUtil::contains(serverStats.ShortDebugString(),
+            "} spin_lock_stats { locks { name:"));
 
     MasterClient::splitMasterTablet(&context, masterServer->serverId, 1,
             (~0UL/2));
@@ -872,7 +874,6 @@ TEST_F(MasterServiceTest, migrateSingleLogEntry_basic) {
     EXPECT_EQ(STATUS_OK, service->objectManager.writeObject(obj, 0, 0));
 
     LogIterator it(*service->objectManager.getLog());
-    Tub<Segment> transferSeg;
 
     uint64_t entryTotals[TOTAL_LOG_ENTRY_TYPES] = {0};
     uint64_t totalBytes = 0;
@@ -880,15 +881,15 @@ TEST_F(MasterServiceTest, migrateSingleLogEntry_basic) {
     uint64_t firstKeyHash = 0x0;
     uint64_t lastKeyHash = 0xffffffffffffffff;
     ServerId receiver(1);
+    MigrationSender sender(&context, receiver, tableId, firstKeyHash);
 
     Status error;
     for (; !it.isDone(); it.next()) {
         TestLog::reset();
         error = service->migrateSingleLogEntry(
                 *it.getCurrentSegmentIterator(),
-                transferSeg, entryTotals, totalBytes,
-                tableId, firstKeyHash, lastKeyHash,
-                receiver);
+                sender, entryTotals, totalBytes,
+                tableId, firstKeyHash, lastKeyHash);
         if (error) break;
     }
 
@@ -907,7 +908,6 @@ TEST_F(MasterServiceTest, migrateSingleLogEntry_wrongTable) {
     EXPECT_EQ(STATUS_OK, service->objectManager.writeObject(obj, 0, 0));
 
     LogIterator it(*service->objectManager.getLog());
-    Tub<Segment> transferSeg;
 
     uint64_t entryTotals[TOTAL_LOG_ENTRY_TYPES] = {0};
     uint64_t totalBytes = 0;
@@ -915,15 +915,15 @@ TEST_F(MasterServiceTest, migrateSingleLogEntry_wrongTable) {
     uint64_t firstKeyHash = 0x0;
     uint64_t lastKeyHash = 0xffffffffffffffff;
     ServerId receiver(1);
+    MigrationSender sender(&context, receiver, tableId, firstKeyHash);
 
     Status error;
     for (; !it.isDone(); it.next()) {
         TestLog::reset();
         error = service->migrateSingleLogEntry(
                 *it.getCurrentSegmentIterator(),
-                transferSeg, entryTotals, totalBytes,
-                tableId, firstKeyHash, lastKeyHash,
-                receiver);
+                sender, entryTotals, totalBytes,
+                tableId, firstKeyHash, lastKeyHash);
         if (error) break;
     }
 
@@ -943,7 +943,6 @@ TEST_F(MasterServiceTest, migrateSingleLogEntry_wrongKeyHash) {
     EXPECT_EQ(STATUS_OK, service->objectManager.writeObject(obj, 0, 0));
 
     LogIterator it(*service->objectManager.getLog());
-    Tub<Segment> transferSeg;
 
     uint64_t entryTotals[TOTAL_LOG_ENTRY_TYPES] = {0};
     uint64_t totalBytes = 0;
@@ -951,15 +950,15 @@ TEST_F(MasterServiceTest, migrateSingleLogEntry_wrongKeyHash) {
     uint64_t firstKeyHash = 0x0;
     uint64_t lastKeyHash = 0x0;
     ServerId receiver(1);
+    MigrationSender sender(&context, receiver, tableId, firstKeyHash);
 
     Status error;
     for (; !it.isDone(); it.next()) {
         TestLog::reset();
         error = service->migrateSingleLogEntry(
                 *it.getCurrentSegmentIterator(),
-                transferSeg, entryTotals, totalBytes,
-                tableId, firstKeyHash, lastKeyHash,
-                receiver);
+                sender, entryTotals, totalBytes,
+                tableId, firstKeyHash, lastKeyHash);
         if (error) break;
     }
 
@@ -998,7 +997,6 @@ TEST_F(MasterServiceTest, migrateSingleLogEntry_rpcResult) {
         ASSERT_TRUE(segment.append(LOG_ENTRY_TYPE_RPCRESULT, buffer));
     }
 
-    Tub<Segment> transferSeg;
 
     uint64_t entryTotals[TOTAL_LOG_ENTRY_TYPES] = {0};
     uint64_t totalBytes = 0;
@@ -1006,6 +1004,7 @@ TEST_F(MasterServiceTest, migrateSingleLogEntry_rpcResult) {
     uint64_t firstKeyHash = 0x0;
     uint64_t lastKeyHash = 0x0;
     ServerId receiver(1);
+    MigrationSender sender(&context, receiver, tableId, firstKeyHash);
 
     TestLog::reset();
     Status error;
@@ -1013,9 +1012,8 @@ TEST_F(MasterServiceTest, migrateSingleLogEntry_rpcResult) {
     for (SegmentIterator it(segment); !it.isDone(); it.next()) {
         error = service->migrateSingleLogEntry(
                 it,
-                transferSeg, entryTotals, totalBytes,
-                tableId, firstKeyHash, lastKeyHash,
-                receiver);
+                sender, entryTotals, totalBytes,
+                tableId, firstKeyHash, lastKeyHash);
         if (error) break;
     }
 
@@ -1086,7 +1084,6 @@ TEST_F(MasterServiceTest, migrateSingleLogEntry_prepAndprepTomb) {
         ASSERT_TRUE(segment.append(LOG_ENTRY_TYPE_PREPTOMB, buffer));
     }
 
-    Tub<Segment> transferSeg;
 
     uint64_t entryTotals[TOTAL_LOG_ENTRY_TYPES] = {0};
     uint64_t totalBytes = 0;
@@ -1094,6 +1091,7 @@ TEST_F(MasterServiceTest, migrateSingleLogEntry_prepAndprepTomb) {
     uint64_t firstKeyHash = keyToMigrate.getHash();
     uint64_t lastKeyHash = keyToMigrate.getHash();
     ServerId receiver(1);
+    MigrationSender sender(&context, receiver, tableId, firstKeyHash);
 
     TestLog::reset();
     Status error;
@@ -1101,9 +1099,8 @@ TEST_F(MasterServiceTest, migrateSingleLogEntry_prepAndprepTomb) {
     for (SegmentIterator it(segment); !it.isDone(); it.next()) {
         error = service->migrateSingleLogEntry(
                 it,
-                transferSeg, entryTotals, totalBytes,
-                tableId, firstKeyHash, lastKeyHash,
-                receiver);
+                sender, entryTotals, totalBytes,
+                tableId, firstKeyHash, lastKeyHash);
         if (error) break;
     }
 
@@ -1146,7 +1143,6 @@ TEST_F(MasterServiceTest, migrateSingleLogEntry_decisionRecord) {
     }
 
     LogIterator it(*service->objectManager.getLog());
-    Tub<Segment> transferSeg;
 
     uint64_t entryTotals[TOTAL_LOG_ENTRY_TYPES] = {0};
     uint64_t totalBytes = 0;
@@ -1154,15 +1150,15 @@ TEST_F(MasterServiceTest, migrateSingleLogEntry_decisionRecord) {
     uint64_t firstKeyHash = 0x0;
     uint64_t lastKeyHash = 0x0;
     ServerId receiver(1);
+    MigrationSender sender(&context, receiver, tableId, firstKeyHash);
 
     TestLog::reset();
     Status error;
     for (; !it.isDone(); it.next()) {
         error = service->migrateSingleLogEntry(
                 *it.getCurrentSegmentIterator(),
-                transferSeg, entryTotals, totalBytes,
-                tableId, firstKeyHash, lastKeyHash,
-                receiver);
+                sender, entryTotals, totalBytes,
+                tableId, firstKeyHash, lastKeyHash);
         if (error) break;
     }
 
@@ -1231,7 +1227,6 @@ TEST_F(MasterServiceTest, migrateSingleLogEntry_participantList) {
     }
 
     LogIterator it(*service->objectManager.getLog());
-    Tub<Segment> transferSeg;
 
     uint64_t entryTotals[TOTAL_LOG_ENTRY_TYPES] = {0};
     uint64_t totalBytes = 0;
@@ -1239,15 +1234,15 @@ TEST_F(MasterServiceTest, migrateSingleLogEntry_participantList) {
     uint64_t firstKeyHash = 0x0;
     uint64_t lastKeyHash = 0x0;
     ServerId receiver(1);
+    MigrationSender sender(&context, receiver, tableId, firstKeyHash);
 
     TestLog::reset();
     Status error;
     for (; !it.isDone(); it.next()) {
         error = service->migrateSingleLogEntry(
                 *it.getCurrentSegmentIterator(),
-                transferSeg, entryTotals, totalBytes,
-                tableId, firstKeyHash, lastKeyHash,
-                receiver);
+                sender, entryTotals, totalBytes,
+                tableId, firstKeyHash, lastKeyHash);
         if (error) break;
     }
 
@@ -1340,12 +1335,15 @@ TEST_F(MasterServiceTest, migrateTablet_movingData) {
     uint64_t oldEpcoh = LogProtector::getCurrentEpoch();
     ramcloud->migrateTablet(tbl, 0, -1, master2->serverId);
     EXPECT_GT(LogProtector::getCurrentEpoch(), oldEpcoh);
+    // The object is sent twice: the final copy starts over from the
+    // beginning of the head segment, where the first pass ended.
     EXPECT_EQ("migrateTablet: Migrating tablet [0x0,0xffffffffffffffff] "
             "in tableId 1 to server 3.0 at mock:host=master2 | "
             "migrateTablet: Sending last migration segment | "
             "migrateTablet: Migration succeeded for tablet "
-            "[0x0,0xffffffffffffffff] in tableId 1; sent 1 objects and "
-            "0 tombstones to server 3.0 at mock:host=master2, 92 bytes in total"
+            "[0x0,0xffffffffffffffff] in tableId 1; sent 2 objects and "
+            "0 tombstones to server 3.0 at mock:host=master2, 184 bytes in "
+            "total"
             " | deleteKeyHashRange: tableId 1 range [0x0,0xffffffffffffffff]"
             , TestLog::get());
 
@@ -1516,6 +1514,41 @@ TEST_F(MasterServiceTest, multiRead_noSuchObject) {
     EXPECT_EQ(STATUS_OBJECT_DOESNT_EXIST, request.status);
 }
 
+TEST_F(MasterServiceTest, multiRead_multipleBatches) {
+    uint64_t tableId1 = ramcloud->createTable("table1");
+    const uint32_t numObjects = 2 * MasterService::MULTI_READ_BATCH_SIZE + 3;
+    Tub<ObjectBuffer> values[numObjects];
+    Tub<MultiReadObject> objects[numObjects];
+    MultiReadObject* requests[numObjects];
+    string keys[numObjects];
+    for (uint32_t i = 0; i < numObjects; i++) {
+        keys[i] = format("key%u", i);
+        // Leave one object in the middle of the second batch missing.
+        if (i != MasterService::MULTI_READ_BATCH_SIZE + 1) {
+            string value = format("value%u", i);
+            ramcloud->write(tableId1, keys[i].c_str(),
+                    downCast<uint16_t>(keys[i].length()),
+                    value.c_str(), downCast<uint32_t>(value.length()));
+        }
+        objects[i].construct(tableId1, keys[i].c_str(),
+                downCast<uint16_t>(keys[i].length()), &values[i]);
+        requests[i] = objects[i].get();
+    }
+    ramcloud->multiRead(requests, numObjects);
+
+    for (uint32_t i = 0; i < numObjects; i++) {
+        if (i == MasterService::MULTI_READ_BATCH_SIZE + 1) {
+            EXPECT_EQ(STATUS_OBJECT_DOESNT_EXIST, objects[i]->status);
+            continue;
+        }
+        EXPECT_EQ(STATUS_OK, objects[i]->status);
+        uint32_t length;
+        const char* value = reinterpret_cast<const char*>(
+                values[i].get()->getValue(&length));
+        EXPECT_EQ(format("value%u", i), string(value, length));
+    }
+}
+
 TEST_F(MasterServiceTest, multiRemove_basics) {
     uint64_t tableId1 = ramcloud->createTable("table1");
     ramcloud->write(tableId1, "0", 1, "firstVal", 8);
@@ -2359,6 +2392,79 @@ TEST_F(MasterServiceTest, requestRemoveIndexEntries_basics) {
 }
 
 
+TEST_F(MasterServiceTest, scan_basics) {
+    uint64_t version0, version1;
+    ramcloud->write(1, "012345", 6, "abcdef", 6, NULL, &version0, false);
+    ramcloud->write(1, "678910", 6, "ghijkl", 6, NULL, &version1, false);
+    Buffer iter, nextIter, finalIter, objects;
+    ScanTableRpc rpc(ramcloud.get(), 1, false, 0, ~0UL, NULL, 0, 0,
+            iter, objects);
+    uint64_t nextTabletStartHash = rpc.wait(nextIter);
+    EXPECT_EQ(0U, nextTabletStartHash);
+    EXPECT_EQ(86U, objects.size());
+
+    ScanTableRpc rpc2(ramcloud.get(), 1, false, nextTabletStartHash,
+            ~0UL, NULL, 0, 0, nextIter, objects);
+    nextTabletStartHash = rpc2.wait(finalIter);
+    EXPECT_EQ(0U, nextTabletStartHash);
+    EXPECT_EQ(0U, objects.size());
+}
+
+TEST_F(MasterServiceTest, scan_badRange) {
+    Buffer iter, nextIter, objects;
+    ScanTableRpc rpc(ramcloud.get(), 1, false, 10, 9, NULL, 0, 0,
+            iter, objects);
+    EXPECT_THROW(rpc.wait(nextIter), RequestFormatError);
+}
+
+TEST_F(MasterServiceTest, scan_partOfTablet) {
+    ramcloud->write(1, "012345", 6, "abcdef", 6, NULL, NULL, false);
+    ramcloud->write(1, "678910", 6, "ghijkl", 6, NULL, NULL, false);
+
+    // (tableId = 1, key = "012345") hashes to 0x7fc19e9dda158f61
+    // (tableId = 1, key = "678910") hashes to 0xb1e38b2242e1bbf4
+
+    Buffer iter, nextIter, finalIter, objects;
+    ScanTableRpc rpc(ramcloud.get(), 1, false, 0, 0x8fffffffffffffffUL,
+            NULL, 0, 0, iter, objects);
+    uint64_t nextTabletStartHash = rpc.wait(nextIter);
+    EXPECT_EQ(0U, nextTabletStartHash);
+    EXPECT_EQ(43U, objects.size());
+    Object object(objects, 4, objects.size() - 4);
+    EXPECT_EQ("012345", string(reinterpret_cast<const char*>(
+            object.getKey()), 6));
+
+    // The scan ends at the end of the range, not the end of the tablet.
+    ScanTableRpc rpc2(ramcloud.get(), 1, false, nextTabletStartHash,
+            0x8fffffffffffffffUL, NULL, 0, 0, nextIter, objects);
+    nextTabletStartHash = rpc2.wait(finalIter);
+    EXPECT_EQ(0x9000000000000000UL, nextTabletStartHash);
+    EXPECT_EQ(0U, objects.size());
+}
+
+TEST_F(MasterServiceTest, scan_filters) {
+    uint64_t version0, version1;
+    ramcloud->write(1, "012345", 6, "abcdef", 6, NULL, &version0, false);
+    ramcloud->write(1, "678910", 6, "ghijkl", 6, NULL, &version1, false);
+    ramcloud->write(1, "6", 1, "mnopqr", 6, NULL, NULL, false);
+    Buffer iter, nextIter, objects;
+
+    // Key prefix longer than some keys.
+    ScanTableRpc rpc(ramcloud.get(), 1, false, 0, ~0UL, "67", 2, 0,
+            iter, objects);
+    rpc.wait(nextIter);
+    EXPECT_EQ(43U, objects.size());
+    Object object(objects, 4, objects.size() - 4);
+    EXPECT_EQ("678910", string(reinterpret_cast<const char*>(
+            object.getKey()), 6));
+
+    // Version (with keysOnly, so each object is 6 bytes shorter).
+    ScanTableRpc rpc2(ramcloud.get(), 1, true, 0, ~0UL, NULL, 0, version1,
+            iter, objects);
+    rpc2.wait(nextIter);
+    EXPECT_EQ(69U, objects.size());
+}
+
 TEST_F(MasterServiceTest, splitAndMigrateIndexlet_indexletNotOnServer) {
     ServerConfig master2Config = masterConfig;
     master2Config.master.numReplicas = 0;
@@ -4569,6 +4675,71 @@ TEST_F(MasterServiceTest, recover) {
     EXPECT_EQ(State::FAILED, replicas.at(8).state);
 }
 
+TEST_F(MasterServiceTest, recover_replayThreads) {
+    ServerConfig master2Config = masterConfig;
+    master2Config.master.numReplicas = 0;
+    master2Config.master.recoveryReplayThreads = 3;
+    master2Config.localLocator = "mock:host=master2";
+    MasterService* service2 = cluster.addServer(master2Config)->master.get();
+    service2->tabletManager.addTablet(123, 0, ~0UL, TabletManager::NOT_READY);
+
+    // Write a segment of objects that land in every replay partition.
+    ServerId serverId(123, 0);
+    ReplicaManager mgr(&context, &serverId, 1, false, false);
+    Segment seg;
+    SegmentHeader header(serverId.getId(), 87, 1000);
+    seg.append(LOG_ENTRY_TYPE_SEGHEADER, &header, sizeof(header));
+    bool partitionUsed[3] = { false, false, false };
+    for (int i = 0; i < 20; i++) {
+        string keyString = format("key%d", i);
+        Key key(123, keyString.c_str(), downCast<uint16_t>(keyString.size()));
+        partitionUsed[service2->objectManager.getBucketLockIndex(
+                key.getHash()) % 3] = true;
+        Buffer dataBuffer;
+        Object object(key, keyString.c_str(),
+                downCast<uint32_t>(keyString.size()) + 1, 1, 0, dataBuffer);
+        Buffer objectBuffer;
+        object.assembleForLog(objectBuffer);
+        ASSERT_TRUE(seg.append(LOG_ENTRY_TYPE_OBJ, objectBuffer));
+    }
+    ASSERT_TRUE(partitionUsed[0] && partitionUsed[1] && partitionUsed[2]);
+    ReplicatedSegment* rs = mgr.allocateHead(87, &seg, NULL);
+    rs->sync(seg.getAppendedLength());
+
+    ProtoBuf::RecoveryPartition recoveryPartition;
+    appendRecoveryPartition(recoveryPartition, 0, 123, 0, ~0UL, 0, 0);
+    BackupClient::startReadingData(&context, backup1Id, 456lu, serverId);
+    BackupClient::StartPartitioningReplicas(&context, backup1Id, 456lu,
+            serverId, &recoveryPartition);
+    vector<MasterService::Replica> replicas {
+        {backup1Id.getId(), 87},
+    };
+
+    TestLog::Enable _("commit", "recover", NULL);
+    std::unordered_map<uint64_t, uint64_t> nextNodeIdMap;
+    service2->recover(456lu, serverId, 0, replicas, nextNodeIdMap);
+    EXPECT_EQ(MasterService::Replica::State::OK, replicas.at(0).state);
+
+    // The helpers' SideLogs are committed before the main one.
+    size_t curPos = 0;
+    TestLog::getUntil("commit: ", curPos, &curPos);
+    EXPECT_EQ("commit: Committed 2 helper SideLogs | ",
+            TestLog::getUntil("recover: SideLog finished committing",
+                    curPos, &curPos));
+
+    service2->tabletManager.changeState(123, 0, ~0UL,
+            TabletManager::NOT_READY, TabletManager::NORMAL);
+    for (int i = 0; i < 20; i++) {
+        string keyString = format("key%d", i);
+        Key key(123, keyString.c_str(), downCast<uint16_t>(keyString.size()));
+        Buffer value;
+        EXPECT_EQ(STATUS_OK, service2->objectManager.readObject(key, &value,
+                NULL, NULL, true));
+        EXPECT_STREQ(keyString.c_str(),
+                static_cast<const char*>(value.getRange(0, value.size())));
+    }
+}
+
 TEST_F(MasterServiceTest, recover_ctimeUpdateIssued) {
     cluster.coordinator->recoveryManager.start();
     TestLog::Enable _("recoveryMasterFinished");
@@ -0,0 +1,154 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "MigrationSender.h"
+#include "ShortMacros.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct a MigrationSender.
+ *
+ * \param context
+ *      Overall information about this server.
+ * \param receiver
+ *      Master that has agreed (via PREP_FOR_MIGRATION) to receive the
+ *      tablet. If invalid, batches are built but not sent.
+ * \param tableId
+ *      Table being migrated.
+ * \param firstKeyHash
+ *      Lowest key hash in the range being migrated.
+ * \param maxRpcsInFlight
+ *      Largest number of batches that may be outstanding at once. Each
+ *      outstanding batch holds a full segment's worth of memory.
+ */
+MigrationSender::MigrationSender(Context* context, ServerId receiver,
+                                 uint64_t tableId, uint64_t firstKeyHash,
+                                 uint32_t maxRpcsInFlight)
+    : context(context)
+    , receiver(receiver)
+    , tableId(tableId)
+    , firstKeyHash(firstKeyHash)
+    , maxRpcsInFlight(std::max(maxRpcsInFlight, 1U))
+    , current()
+    , inFlight()
+    , batchesSent(0)
+{
+}
+
+/**
+ * Destroy the sender. Entries not yet flushed are discarded and any RPCs
+ * still in flight are canceled; a migration that completes normally calls
+ * flush() first.
+ */
+MigrationSender::~MigrationSender()
+{
+}
+
+/**
+ * Add a log entry to the current batch, sending the batch first if the
+ * entry doesn't fit. Blocks if the maximum number of batches is already
+ * in flight.
+ *
+ * \param type
+ *      Type of the log entry.
+ * \param buffer
+ *      Contents of the log entry.
+ * \return
+ *      False if the entry is too large to fit even in an empty batch.
+ * \throw ClientException
+ *      The receiver rejected an earlier batch.
+ */
+bool
+MigrationSender::append(LogEntryType type, Buffer& buffer)
+{
+    if (current && current->append(type, buffer))
+        return true;
+    if (current)
+        send();
+    current.reset(new Segment());
+    return current->append(type, buffer);
+}
+
+/**
+ * Send any partially filled batch and wait until the receiver has
+ * acknowledged every batch sent so far.
+ *
+ * \throw ClientException
+ *      The receiver rejected a batch.
+ */
+void
+MigrationSender::flush()
+{
+    if (current)
+        send();
+    while (!inFlight.empty())
+        reap(true);
+}
+
+/**
+ * Close the current batch and start an RPC to send it, first waiting for
+ * an earlier batch to complete if too many are in flight.
+ */
+void
+MigrationSender::send()
+{
+    current->close();
+    batchesSent++;
+    if (expect_false(receiver == ServerId())) {
+        current.reset();
+        return;
+    }
+#if MIGRATION_SKIP_TX
+    current.reset();
+    return;
+#endif
+
+    reap(false);
+    while (inFlight.size() >= maxRpcsInFlight)
+        reap(true);
+
+    LOG(DEBUG, "Sending migration segment");
+    inFlight.emplace_back();
+    Transfer& transfer = inFlight.back();
+    transfer.segment = std::move(current);
+    transfer.rpc.construct(context, receiver, transfer.segment.get(),
+                           tableId, firstKeyHash, false, 0UL, uint8_t(0),
+                           static_cast<const void*>(NULL), uint16_t(0));
+}
+
+/**
+ * Retire batches whose RPCs have completed, in the order they were sent.
+ *
+ * \param waitForOne
+ *      If true, wait for the oldest batch to complete even if it isn't
+ *      ready yet.
+ * \throw ClientException
+ *      The receiver rejected a batch.
+ */
+void
+MigrationSender::reap(bool waitForOne)
+{
+    while (!inFlight.empty()) {
+        Transfer& oldest = inFlight.front();
+        if (!waitForOne && !oldest.rpc->isReady())
+            return;
+        oldest.rpc->wait();
+        inFlight.pop_front();
+        waitForOne = false;
+    }
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,117 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_MIGRATIONSENDER_H
+#define RAMCLOUD_MIGRATIONSENDER_H
+
+#include <deque>
+#include <memory>
+
+#include "Common.h"
+#include "MasterClient.h"
+#include "Segment.h"
+
+namespace RAMCloud {
+
+/**
+ * Used by the source master during tablet migration to pack log entries
+ * into segment-sized batches and send them to the new owner with
+ * RECEIVE_MIGRATION_DATA RPCs. Several RPCs are kept in flight at once, so
+ * the source keeps scanning its log while the receiver replays earlier
+ * batches; the receiver replays each batch into its own side log, so
+ * batches may complete in any order.
+ *
+ * Not thread-safe; a migration uses a single instance from one thread.
+ */
+class MigrationSender {
+  PUBLIC:
+    MigrationSender(Context* context, ServerId receiver, uint64_t tableId,
+                    uint64_t firstKeyHash, uint32_t maxRpcsInFlight = 4);
+    ~MigrationSender();
+
+    bool append(LogEntryType type, Buffer& buffer);
+    void flush();
+
+    /**
+     * Return true if entries have been appended that haven't yet been
+     * sent (that is, flush() would send another batch).
+     */
+    bool hasBufferedData() const
+    {
+        return current.get() != NULL;
+    }
+
+    /// Number of batches sent so far, including those still in flight.
+    uint64_t getBatchesSent() const
+    {
+        return batchesSent;
+    }
+
+  PRIVATE:
+    void send();
+    void reap(bool waitForOne);
+
+    /**
+     * A batch that has been sent to the receiver and may still be in
+     * flight. The segment must remain allocated until the RPC completes.
+     */
+    struct Transfer {
+        Transfer()
+            : segment()
+            , rpc()
+        {}
+
+        /// Log entries being sent.
+        std::unique_ptr<Segment> segment;
+
+        /// RPC carrying #segment to the receiver.
+        Tub<ReceiveMigrationDataRpc> rpc;
+
+        DISALLOW_COPY_AND_ASSIGN(Transfer);
+    };
+
+    /// Overall information about the server.
+    Context* context;
+
+    /**
+     * Master receiving the tablet. An invalid ServerId means batches are
+     * built but never sent (used by MigrateTabletBenchmark).
+     */
+    ServerId receiver;
+
+    /// Table being migrated.
+    uint64_t tableId;
+
+    /// Lowest key hash in the range being migrated.
+    uint64_t firstKeyHash;
+
+    /// Largest number of batches that may be in flight at once.
+    uint32_t maxRpcsInFlight;
+
+    /// Batch currently being filled by append(), or NULL if none.
+    std::unique_ptr<Segment> current;
+
+    /// Batches sent, in the order they were sent.
+    std::deque<Transfer> inFlight;
+
+    /// See getBatchesSent().
+    uint64_t batchesSent;
+
+    DISALLOW_COPY_AND_ASSIGN(MigrationSender);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_MIGRATIONSENDER_H
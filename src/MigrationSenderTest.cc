@@ -0,0 +1,70 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "MigrationSender.h"
+
+namespace RAMCloud {
+
+class MigrationSenderTest : public ::testing::Test {
+  public:
+    Context context;
+
+    MigrationSenderTest()
+        : context()
+    {
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(MigrationSenderTest);
+};
+
+TEST_F(MigrationSenderTest, append) {
+    // No receiver: batches are built but not sent.
+    MigrationSender sender(&context, ServerId(), 1, 0);
+    EXPECT_FALSE(sender.hasBufferedData());
+
+    string entry(1000000, 'x');
+    Buffer buffer;
+    buffer.appendExternal(entry.c_str(), downCast<uint32_t>(entry.size()));
+    for (int i = 0; i < 8; i++)
+        EXPECT_TRUE(sender.append(LOG_ENTRY_TYPE_OBJ, buffer));
+    EXPECT_TRUE(sender.hasBufferedData());
+    EXPECT_EQ(0U, sender.getBatchesSent());
+
+    // The ninth entry doesn't fit in the first batch.
+    EXPECT_TRUE(sender.append(LOG_ENTRY_TYPE_OBJ, buffer));
+    EXPECT_EQ(1U, sender.getBatchesSent());
+    EXPECT_EQ(0U, sender.inFlight.size());
+
+    sender.flush();
+    EXPECT_FALSE(sender.hasBufferedData());
+    EXPECT_EQ(2U, sender.getBatchesSent());
+}
+
+TEST_F(MigrationSenderTest, append_tooBig) {
+    MigrationSender sender(&context, ServerId(), 1, 0);
+    string entry(Segment::DEFAULT_SEGMENT_SIZE, 'x');
+    Buffer buffer;
+    buffer.appendExternal(entry.c_str(), downCast<uint32_t>(entry.size()));
+    EXPECT_FALSE(sender.append(LOG_ENTRY_TYPE_OBJ, buffer));
+}
+
+TEST_F(MigrationSenderTest, flush_nothingBuffered) {
+    MigrationSender sender(&context, ServerId(), 1, 0);
+    sender.flush();
+    EXPECT_EQ(0U, sender.getBatchesSent());
+}
+
+}  // namespace RAMCloud
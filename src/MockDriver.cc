@@ -29,6 +29,8 @@ MockDriver::MockDriver()
             , releaseCount(0)
             , incomingPackets()
             , transmitQueueSpace(10000)
+            , transmitsCompleted(~0UL)
+            , lastPriority(0)
 {
 }
 
@@ -47,6 +49,8 @@ MockDriver::MockDriver(HeaderToString headerToString)
             , releaseCount(0)
             , incomingPackets()
             , transmitQueueSpace(10000)
+            , transmitsCompleted(~0UL)
+            , lastPriority(0)
 {
 }
 
@@ -85,6 +89,7 @@ MockDriver::sendPacket(const Address* addr,
                        int priority)
 {
     sendPacketCount++;
+    lastPriority = priority;
     uint32_t bytesSent = headerLen;
     if (payload != NULL) {
         bytesSent += payload->size();
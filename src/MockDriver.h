@@ -88,6 +88,10 @@ class MockDriver : public Driver {
                             Buffer::Iterator* payload,
                             int priority = 0);
     virtual string getServiceLocator();
+    virtual uint64_t getTransmitMark() { return sendPacketCount; }
+    virtual bool isTransmitComplete(uint64_t mark) {
+        return mark <= transmitsCompleted;
+    }
 
     /**
      * Simulates the arrival of a packet in the driver.
@@ -136,6 +140,13 @@ class MockDriver : public Driver {
     // Returned as the result of getTransmitQueueSpace.
     uint32_t transmitQueueSpace;
 
+    // Number of sent packets whose transmission is considered complete
+    // by isTransmitComplete (defaults to all of them).
+    uint64_t transmitsCompleted;
+
+    // Priority passed to the most recent call to sendPacket.
+    int lastPriority;
+
     DISALLOW_COPY_AND_ASSIGN(MockDriver);
 };
 
@@ -39,10 +39,11 @@ class MockSyscall : public Syscall {
                     epollWaitCount(-1), epollWaitEvents(NULL),
                     epollWaitErrno(0), exitCount(0), fcntlErrno(0),
                     futexWaitErrno(0), futexWakeErrno(0), fwriteResult(~0LU),
-                    getsocknameErrno(0), ioctlErrno(0),
+                    getsocknameErrno(0), getsockoptErrno(0), ioctlErrno(0),
                     ioctlRetriesToSuccess(0), listenErrno(0), pipeErrno(0),
                     recvErrno(0), recvEof(false), recvfromErrno(0),
                     recvfromEof(false), recvmmsgErrno(0),
+                    sendmmsgErrno(0), sendmmsgCalls(0),
                     sendmsgErrno(0), sendmsgReturnCount(-1),
                     sendtoErrno(0), sendtoReturnCount(-1), setsockoptErrno(0),
                     socketErrno(0), writeErrno(0) {}
@@ -180,6 +181,17 @@ class MockSyscall : public Syscall {
         return -1;
     }
 
+    int getsockoptErrno;
+    int getsockopt(int sockfd, int level, int optname, void* optval,
+                    socklen_t* optlen) {
+        if (getsockoptErrno == 0) {
+            return ::getsockopt(sockfd, level, optname, optval, optlen);
+        }
+        errno = getsockoptErrno;
+        getsockoptErrno = 0;
+        return -1;
+    }
+
     int ioctlErrno;
     int ioctlRetriesToSuccess;
     int ioctl(int fd, int reqType, void* request) {
@@ -255,6 +267,18 @@ class MockSyscall : public Syscall {
 
     }
 
+    int sendmmsgErrno;
+    int sendmmsgCalls;
+    int sendmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen,
+            int flags) {
+        sendmmsgCalls++;
+        if (sendmmsgErrno != 0) {
+            errno = sendmmsgErrno;
+            return -1;
+        }
+        return ::sendmmsg(sockfd, msgvec, vlen, flags);
+    }
+
     int sendmsgErrno;
     int sendmsgReturnCount;
     ssize_t sendmsg(int sockfd, const msghdr *msg, int flags) {
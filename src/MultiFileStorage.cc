@@ -420,6 +420,11 @@ MultiFileStorage::Frame::performTask()
     Lock lock(storage->mutex);
     if (epoch != scheduledInEpoch)
         return;
+    // If several threads run #ioQueue (see IoUringStorage) another one may
+    // still be doing IO for this frame; it reschedules the frame when it
+    // finishes if more IO is needed.
+    if (performingIo)
+        return;
     performingIo = true;
     if (!isSynced()) {
         performWrite(lock);
@@ -576,14 +581,18 @@ MultiFileStorage::unlockedRead(Frame::Lock& lock, void* buf, size_t frameIndex,
     // Linux documentation recommends clearing control blocks before use.
     memset(cbs, 0, sizeof(struct aiocb) * fds.size());
     size_t frameletStart = offsetOfFramelet(frameIndex);
+    // Framelets aren't all the same size when the segment doesn't divide
+    // evenly across files, so place each one right after the previous.
+    char* frameletBuf = static_cast<char*>(buf);
     for (size_t fileIndex = 0; fileIndex < fds.size(); fileIndex++) {
         size_t frameletSize = bytesInFramelet(fileIndex);
         struct aiocb* cb = &cbs[fileIndex];
         cb->aio_fildes = fds[fileIndex];
         cb->aio_offset = frameletStart;
-        cb->aio_buf = static_cast<char*>(buf) + (frameletSize * fileIndex);
+        cb->aio_buf = frameletBuf;
         cb->aio_nbytes = frameletSize;
         aio_read(cb);
+        frameletBuf += frameletSize;
     }
 
     // Wait for all of the IO operations to complete.
@@ -888,7 +897,11 @@ void
 MultiFileStorage::BufferDeleter::operator()(void* buffer)
 {
     if (buffer) {
-        if (storage->buffers.size() >= MAX_POOLED_BUFFERS) {
+        char* p = static_cast<char*>(buffer);
+        bool inArena = p >= storage->bufferArena &&
+            p < storage->bufferArena +
+                storage->bufferArenaCount * storage->bufferArenaStride;
+        if (!inArena && storage->buffers.size() >= MAX_POOLED_BUFFERS) {
             std::free(buffer);
         } else {
             storage->buffers.push(buffer);
@@ -943,6 +956,10 @@ MultiFileStorage::MultiFileStorage(size_t segmentSize,
     , maxWriteBuffers(maxWriteBuffers)
     , bufferDeleter(this)
     , buffers()
+    , bufferArena(NULL)
+    , bufferArenaStride((segmentSize + METADATA_SIZE + BUFFER_ALIGNMENT - 1) /
+                        BUFFER_ALIGNMENT * BUFFER_ALIGNMENT)
+    , bufferArenaCount(INIT_POOLED_BUFFERS)
 {
     assert(filePathsStr);
 
@@ -1005,11 +1022,11 @@ MultiFileStorage::MultiFileStorage(size_t segmentSize,
     // 1.75 ms.
     std::free(Memory::xmemalign(HERE, BUFFER_ALIGNMENT, segmentSize));
 
-    { // Pre-fill the buffer pool.
-        std::vector<BufferPtr> buffers;
-        for (int i = 0; i < INIT_POOLED_BUFFERS; ++i)
-            buffers.emplace_back(allocateBuffer());
-    }
+    // Pre-fill the buffer pool.
+    bufferArena = static_cast<char*>(Memory::xmemalign(HERE, BUFFER_ALIGNMENT,
+            bufferArenaCount * bufferArenaStride));
+    for (size_t i = bufferArenaCount; i > 0; --i)
+        buffers.push(bufferArena + (i - 1) * bufferArenaStride);
 
     for (size_t frame = 0; frame < frameCount; ++frame)
         frames.emplace_back(this, frame);
@@ -1033,9 +1050,13 @@ MultiFileStorage::~MultiFileStorage()
     }
 
     while (!buffers.empty()) {
-        std::free(buffers.top());
+        char* buffer = static_cast<char*>(buffers.top());
+        if (buffer < bufferArena ||
+                buffer >= bufferArena + bufferArenaCount * bufferArenaStride)
+            std::free(buffer);
         buffers.pop();
     }
+    std::free(bufferArena);
 }
 
 /**
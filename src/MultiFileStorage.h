@@ -259,16 +259,16 @@ class MultiFileStorage : public BackupStorage {
      */
     enum { METADATA_SIZE = BLOCK_SIZE };
 
-  PRIVATE:
+  PROTECTED:
     size_t bytesInFramelet(size_t fileIndex) const;
     off_t offsetOfFramelet(size_t frameIndex) const;
     off_t offsetOfFrameMetadata(size_t frameIndex) const;
     off_t offsetOfSuperblockFrame(size_t superblockIndex) const;
-    void unlockedRead(Frame::Lock& lock, void* buf, size_t frameIndex,
-                      bool usingDevNull);
-    void unlockedWrite(Frame::Lock& lock, void* buf, size_t count,
-                       size_t frameIndex, off_t offsetInFrame,
-                       void* metadataBuf, size_t metadataCount);
+    virtual void unlockedRead(Frame::Lock& lock, void* buf, size_t frameIndex,
+                              bool usingDevNull);
+    virtual void unlockedWrite(Frame::Lock& lock, void* buf, size_t count,
+                               size_t frameIndex, off_t offsetInFrame,
+                               void* metadataBuf, size_t metadataCount);
 
     void reserveSpace(int fd);
     Tub<Superblock> tryLoadSuperblock(uint32_t superblockFrame);
@@ -359,6 +359,21 @@ class MultiFileStorage : public BackupStorage {
      */
     std::stack<void*, std::vector<void*>> buffers;
 
+    /**
+     * The buffers initially placed in #buffers are carved out of this single
+     * allocation, so that subclasses can register them with the kernel as
+     * one region (see IoUringStorage). Buffers from here are always returned
+     * to the pool, never to the OS. Buffers allocated later, when the pool
+     * runs dry, come from the OS as usual.
+     */
+    char* bufferArena;
+
+    /// Distance in bytes between consecutive buffers in #bufferArena.
+    size_t bufferArenaStride;
+
+    /// Number of buffers in #bufferArena.
+    size_t bufferArenaCount;
+
     DISALLOW_COPY_AND_ASSIGN(MultiFileStorage);
 };
 
@@ -818,6 +818,45 @@ Object::computeChecksum(const Object::Header* object,
     return crc.getResult();
 }
 
+/**
+ * Compute the checksums of several contiguous Objects in memory at once.
+ * This is considerably faster than calling computeChecksum() on each in
+ * turn (see Crc32C::computeMany()).
+ *
+ * \param count
+ *      Number of objects.
+ * \param objects
+ *      Pointers to the beginning of each object (header, keys and value).
+ * \param totalLengths
+ *      Total length of each object in bytes, including the header, keys
+ *      and value.
+ * \param[out] checksums
+ *      checksums[i] is set to the checksum of objects[i], as
+ *      computeChecksum() would return it.
+ */
+void
+Object::computeChecksums(uint32_t count,
+                         const Object::Header* const objects[],
+                         const uint32_t totalLengths[],
+                         uint32_t checksums[])
+{
+    // The checksum covers everything after the checksum field, which is
+    // contiguous for these objects.
+    const uint32_t batchSize = 12;
+    const void* buffers[batchSize];
+    uint32_t lengths[batchSize];
+    for (uint32_t done = 0; done < count; done += batchSize) {
+        uint32_t n = std::min(batchSize, count - done);
+        for (uint32_t i = 0; i < n; i++) {
+            buffers[i] = reinterpret_cast<const uint8_t*>(objects[done + i]) +
+                         sizeof(objects[done + i]->checksum);
+            lengths[i] = totalLengths[done + i] -
+                         sizeof32(objects[done + i]->checksum);
+        }
+        Crc32C::computeMany(n, buffers, lengths, &checksums[done]);
+    }
+}
+
 /**
  * Construct a new tombstone for a given dead object. Use this constructor
  * when generating new tombstones to be written to the log.
@@ -184,6 +184,10 @@ class Object {
 
     static uint32_t computeChecksum(const Object::Header* object,
                                     uint32_t totalLength);
+    static void computeChecksums(uint32_t count,
+                                 const Object::Header* const objects[],
+                                 const uint32_t totalLengths[],
+                                 uint32_t checksums[]);
     uint32_t computeChecksum();
     void applyChecksum(Crc32C *crc);
 
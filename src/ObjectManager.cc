@@ -20,6 +20,7 @@
 #include "EnumerationIterator.h"
 #include "IndexletManager.h"
 #include "LogEntryRelocator.h"
+#include "LogProtector.h"
 #include "ObjectManager.h"
 #include "Object.h"
 #include "PerfStats.h"
@@ -94,9 +95,11 @@ ObjectManager::ObjectManager(Context* context, ServerId* serverId,
     , anyWrites(false)
     , hashTableBucketLocks()
     , lockTable(1000, log)
+    , readLeases()
     , mutex("ObjectManager::mutex")
     , tombstoneRemover(this, &objectMap)
     , tombstoneProtectorCount(0)
+    , hashTableResizer(this, &objectMap)
 {
     for (size_t i = 0; i < arrayLength(hashTableBucketLocks); i++)
         hashTableBucketLocks[i].setName("hashTableBucketLock");
@@ -145,6 +148,9 @@ ObjectManager::initOnceEnlisted()
 
     if (!config->master.disableLogCleaner)
         log.enableCleaner();
+
+    if (config->master.hashTableAutoResize)
+        hashTableResizer.start(0);
 }
 
 /**
@@ -297,6 +303,136 @@ ObjectManager::prefetchHashTableBucket(SegmentIterator* it)
     }
 }
 
+/**
+ * Determine which partition of a recovery segment an entry belongs to when
+ * its replay is split among several threads (see replaySegment()). Objects
+ * and tombstones are divided by the hash table bucket lock that guards their
+ * key (see getBucketLockIndex()), so all of the entries for a given key are
+ * replayed by the same thread, and each thread works on a disjoint set of
+ * lock stripes and therefore buckets. All other entries are rare and belong
+ * to partition 0.
+ *
+ * \param it
+ *      Iterator positioned at the entry. The segment must be contiguous.
+ * \param numPartitions
+ *      Number of partitions.
+ */
+uint32_t
+ObjectManager::getReplayPartition(SegmentIterator& it, uint32_t numPartitions)
+{
+    LogEntryType type = it.getType();
+    if (type == LOG_ENTRY_TYPE_OBJ) {
+        const Object::Header* header =
+            it.getContiguous<Object::Header>(NULL, 0);
+        Object object(header, it.getLength());
+        KeyLength keyLength = 0;
+        const void* key = object.getKey(0, &keyLength);
+        return getBucketLockIndex(
+            Key::getHash(header->tableId, key, keyLength)) % numPartitions;
+    } else if (type == LOG_ENTRY_TYPE_OBJTOMB) {
+        const ObjectTombstone::Header* tomb =
+            it.getContiguous<ObjectTombstone::Header>(NULL, 0);
+        return getBucketLockIndex(Key::getHash(tomb->tableId, tomb->key,
+            downCast<uint16_t>(it.getLength() - sizeof32(*tomb)))) %
+            numPartitions;
+    }
+    return 0;
+}
+
+/**
+ * This method is used by replaySegment() to verify the checksums of several
+ * upcoming objects at once, which is much faster than checking them one at
+ * a time (see Crc32C::computeMany()).
+ *
+ * \param it
+ *      Iterator positioned at the first object to check. Other types of
+ *      entries are skipped. The segment must be contiguous.
+ * \param maxObjects
+ *      Check at most this many objects.
+ * \param[out] valid
+ *      valid[i] is set to whether the i'th object checked has a correct
+ *      checksum. Must have room for maxObjects entries.
+ * \param partition
+ *      Only check objects in this replay partition (see
+ *      getReplayPartition()).
+ * \param numPartitions
+ *      Number of replay partitions.
+ * \return
+ *      The number of objects checked (less than maxObjects only if the end
+ *      of the segment was reached).
+ */
+uint32_t
+ObjectManager::verifyObjectChecksums(SegmentIterator it, uint32_t maxObjects,
+                                     bool* valid, uint32_t partition,
+                                     uint32_t numPartitions)
+{
+    const Object::Header* objects[REPLAY_CHECKSUM_BATCH];
+    uint32_t lengths[REPLAY_CHECKSUM_BATCH];
+    uint32_t checksums[REPLAY_CHECKSUM_BATCH];
+    if (maxObjects > REPLAY_CHECKSUM_BATCH)
+        maxObjects = REPLAY_CHECKSUM_BATCH;
+
+    uint32_t count = 0;
+    for (; count < maxObjects && !it.isDone(); it.next()) {
+        if (it.getType() != LOG_ENTRY_TYPE_OBJ)
+            continue;
+        if (numPartitions > 1 &&
+                getReplayPartition(it, numPartitions) != partition) {
+            continue;
+        }
+        objects[count] = it.getContiguous<Object::Header>(NULL, 0);
+        lengths[count] = it.getLength();
+        count++;
+    }
+
+    Object::computeChecksums(count, objects, lengths, checksums);
+    for (uint32_t i = 0; i < count; i++)
+        valid[i] = (checksums[i] == objects[i]->checksum);
+    return count;
+}
+
+/**
+ * Prepare to read a batch of objects by bringing everything that
+ * readObject() will touch for them into the processor's cache. This is
+ * done in two passes: the first starts fetching the hash table bucket of
+ * every key, and the second (by which time those buckets have hopefully
+ * arrived) walks each bucket and starts fetching the log entries it refers
+ * to. When the caller then reads the objects one at a time, the DRAM misses
+ * of the whole batch have been overlapped instead of being taken serially,
+ * once per object.
+ *
+ * This method is purely an optimization: it does not change any state, and
+ * objects may be modified, moved, or deleted between it and the subsequent
+ * reads without affecting correctness. For the same reason it takes no
+ * bucket locks (readObject() takes each one anyway): a bucket that changes
+ * underneath it yields at worst a stale reference, and prefetching that
+ * only wastes a little memory bandwidth. Like enumerations, it relies on
+ * the caller's RPC epoch to keep retired hash table memory alive.
+ *
+ * \param keys
+ *      Keys of the objects about to be read.
+ * \param numKeys
+ *      Number of entries in \a keys. This should be small enough (a few
+ *      dozen at most) that the lines prefetched for the first key are not
+ *      evicted before it is read.
+ */
+void
+ObjectManager::prefetchObjects(Key* keys[], uint32_t numKeys)
+{
+    for (uint32_t i = 0; i < numKeys; i++)
+        objectMap.prefetchBucket(keys[i]->getHash());
+
+    for (uint32_t i = 0; i < numKeys; i++) {
+        HashTable::Candidates candidates;
+        objectMap.lookup(keys[i]->getHash(), candidates);
+        while (!candidates.isDone()) {
+            prefetch(reinterpret_cast<const void*>(candidates.getReference()),
+                     PREFETCH_LOG_ENTRY_BYTES);
+            candidates.next();
+        }
+    }
+}
+
 /**
  * Read an object previously written to this ObjectManager.
  *
@@ -314,6 +450,11 @@ ObjectManager::prefetchHashTableBucket(SegmentIterator* it)
  * \param valueOnly
  *      If true, then only the value portion of the object is written to
  *      outBuffer. Otherwise, keys and value are written to outBuffer.
+ * \param[in,out] leaseNanoseconds
+ *      If non-NULL, the caller would like to cache the object for this many
+ *      nanoseconds (see ReadLeaseTable). If the read succeeds, the length of
+ *      the lease actually granted is returned here; 0 means the object must
+ *      not be cached.
  * \return
  *      Returns STATUS_OK if the lookup succeeded and the reject rules did not
  *      preclude this read. Other status values indicate different failures
@@ -322,7 +463,7 @@ ObjectManager::prefetchHashTableBucket(SegmentIterator* it)
 Status
 ObjectManager::readObject(Key& key, Buffer* outBuffer,
                 RejectRules* rejectRules, uint64_t* outVersion,
-                bool valueOnly)
+                bool valueOnly, uint32_t* leaseNanoseconds)
 {
     objectMap.prefetchBucket(key.getHash());
     HashTableBucketLock lock(*this, key);
@@ -363,6 +504,8 @@ ObjectManager::readObject(Key& key, Buffer* outBuffer,
     PerfStats::threadStats.readKeyBytes +=
             object.getKeysAndValueLength() - valueLength;
 
+    if (leaseNanoseconds != NULL)
+        *leaseNanoseconds = readLeases.grant(key, *leaseNanoseconds);
     return STATUS_OK;
 }
 
@@ -422,6 +565,10 @@ ObjectManager::removeObject(Key& key, RejectRules* rejectRules,
         return STATUS_RETRY;
     }
 
+    // Clients may have the object cached; retry once their leases run out.
+    if (checkReadLeases(lock, key))
+        return STATUS_RETRY;
+
     LogEntryType type;
     Buffer buffer;
     Log::Reference reference;
@@ -578,10 +725,19 @@ ObjectManager::replaySegment(SideLog* sideLog, SegmentIterator& it)
  * \param nextNodeIdMap
  *       A unordered map that keeps track of the nextNodeId in
  *       each indexlet table.
+ * \param partition
+ *       Replay only the entries in this partition of the segment (see
+ *       getReplayPartition()). Several threads may replay the same segment
+ *       concurrently as long as each uses a distinct partition and its own
+ *       SideLog and nextNodeIdMap.
+ * \param numPartitions
+ *       Number of partitions the segment's entries are divided into. The
+ *       default of 1 replays every entry.
  */
 void
 ObjectManager::replaySegment(SideLog* sideLog, SegmentIterator& it,
-    std::unordered_map<uint64_t, uint64_t>* nextNodeIdMap)
+    std::unordered_map<uint64_t, uint64_t>* nextNodeIdMap,
+    uint32_t partition, uint32_t numPartitions)
 {
     uint64_t startReplicationTicks = metrics->master.replicaManagerTicks;
     uint64_t startReplicationPostingWriteRpcTicks =
@@ -611,6 +767,12 @@ ObjectManager::replaySegment(SideLog* sideLog, SegmentIterator& it,
     SegmentIterator prefetcher = it;
     prefetcher.next();
 
+    // Object checksums are verified a batch at a time, ahead of replay.
+    // checksumValid[nextChecksum] corresponds to the next object entry.
+    bool checksumValid[REPLAY_CHECKSUM_BATCH];
+    uint32_t nextChecksum = 0;
+    uint32_t checksumCount = 0;
+
     uint64_t bytesIterated = 0;
     for (; expect_true(!it.isDone()); it.next()) {
         prefetchHashTableBucket(&prefetcher);
@@ -624,6 +786,11 @@ ObjectManager::replaySegment(SideLog* sideLog, SegmentIterator& it,
         }
         bytesIterated += it.getLength();
 
+        if (numPartitions > 1 &&
+                getReplayPartition(it, numPartitions) != partition) {
+            continue;
+        }
+
         recoverySegmentEntryCount++;
         recoverySegmentEntryBytes += it.getLength();
 
@@ -654,11 +821,14 @@ ObjectManager::replaySegment(SideLog* sideLog, SegmentIterator& it,
                 }
             }
 
-            bool checksumIsValid = ({
+            if (nextChecksum == checksumCount) {
                 CycleCounter<uint64_t> c(&verifyChecksumTicks);
-                Object::computeChecksum(recoveryObj, it.getLength()) ==
-                    recoveryObj->checksum;
-            });
+                checksumCount = verifyObjectChecksums(it,
+                        REPLAY_CHECKSUM_BATCH, checksumValid,
+                        partition, numPartitions);
+                nextChecksum = 0;
+            }
+            bool checksumIsValid = checksumValid[nextChecksum++];
             if (expect_false(!checksumIsValid)) {
                 LOG(WARNING, "bad object checksum! key: %s, version: %lu",
                     key.toString().c_str(), recoveryObj->version);
@@ -1206,6 +1376,10 @@ ObjectManager::writeObject(Object& newObject, RejectRules* rejectRules,
         return STATUS_RETRY;
     }
 
+    // Clients may have the object cached; retry once their leases run out.
+    if (checkReadLeases(lock, key))
+        return STATUS_RETRY;
+
     LogEntryType currentType = LOG_ENTRY_TYPE_INVALID;
     Buffer currentBuffer;
     Log::Reference currentReference;
@@ -1857,6 +2031,11 @@ ObjectManager::commitRemove(PreparedOp& op,
 
     HashTableBucketLock lock(*this, key);
 
+    // Clients may have the object cached; the decision has been made, so
+    // there's no choice but to wait for their leases to run out. This may
+    // release the bucket lock for a while, so check everything else after.
+    waitForReadLeases(lock, key);
+
     // Skip if object is not prepared since it is already committed.
     // We need to check this again after holding HashTableBucketLock
     // since there can be a concurrent TxDecision RPC.
@@ -1965,6 +2144,11 @@ ObjectManager::commitWrite(PreparedOp& op,
     objectMap.prefetchBucket(key.getHash());
     HashTableBucketLock lock(*this, key);
 
+    // Clients may have the object cached; the decision has been made, so
+    // there's no choice but to wait for their leases to run out. This may
+    // release the bucket lock for a while, so check everything else after.
+    waitForReadLeases(lock, key);
+
     // Skip if object is not prepared since it is already committed.
     // We need to check this again after holding HashTableBucketLock
     // since there can be a concurrent TxDecision RPC.
@@ -2248,6 +2432,7 @@ ObjectManager::prepareForLog(Object& newObject, Buffer *logBuffer,
 
     objectMap.prefetchBucket(key.getHash());
     HashTableBucketLock lock(*this, key);
+    waitForReadLeases(lock, key);
 
     // If the tablet doesn't exist in the NORMAL state, we must plead
     // ignorance.
@@ -2342,6 +2527,7 @@ Status
 ObjectManager::writeTombstone(Key& key, Buffer *logBuffer)
 {
     HashTableBucketLock lock(*this, key);
+    waitForReadLeases(lock, key);
 
     // If the tablet doesn't exist in the NORMAL state, we must plead
     // ignorance.
@@ -2513,6 +2699,139 @@ ObjectManager::TombstoneProtector::~TombstoneProtector()
     }
 }
 
+/**
+ * HashTable::forEachInBucket callback that does nothing; used by
+ * HashTableResizer::chooseNumBuckets() just to count entries.
+ */
+static void
+ignoreReference(uint64_t reference, void *cookie)
+{
+}
+
+/**
+ * Construct a HashTableResizer. It does nothing until started.
+ *
+ * \param objectManager
+ *      The instance of ObjectManager that owns the #objectMap.
+ * \param objectMap
+ *      The HashTable that will be resized.
+ */
+ObjectManager::HashTableResizer::HashTableResizer(
+                ObjectManager* objectManager,
+                HashTable* objectMap)
+    : WorkerTimer(objectManager->context->dispatch)
+    , objectManager(objectManager)
+    , objectMap(objectMap)
+    , minNumBuckets(objectMap->getNumBuckets())
+{
+}
+
+/**
+ * Release memory left over from earlier resizes once it is safe, decide
+ * whether a new resize is needed, and migrate a batch of buckets of any
+ * resize in progress. Then reschedule ourselves.
+ */
+void
+ObjectManager::HashTableResizer::handleTimerEvent()
+{
+    // Readers holding a bucket lock never see retired memory, but those
+    // that don't (prefetches, enumerations and scans) may, so retired memory
+    // is only freed once every RPC that could have found it has finished.
+    if (objectMap->hasRetiredMemory()) {
+        uint64_t earliestEpoch;
+        {
+            Dispatch::Lock lock(objectManager->context->dispatch);
+            earliestEpoch = LogProtector::getEarliestOutstandingEpoch(~0);
+        }
+        objectMap->freeRetiredMemory(earliestEpoch);
+    }
+
+    if (!objectMap->isResizing()) {
+        uint64_t numBuckets = chooseNumBuckets();
+        if (numBuckets == objectMap->getNumBuckets()) {
+            start(Cycles::rdtsc() +
+                  Cycles::fromMicroseconds(CHECK_INTERVAL_MS * 1000));
+            return;
+        }
+
+        LOG(NOTICE, "Resizing hash table from %lu to %lu buckets",
+            objectMap->getNumBuckets(), numBuckets);
+        objectManager->lockAllHashTableBuckets();
+        objectMap->startResize(numBuckets);
+        objectManager->unlockAllHashTableBuckets();
+    }
+
+    // Each old bucket's keys all map to the same lock (see chooseNumBuckets),
+    // so migrating it only excludes operations on that bucket.
+    bool moreBuckets = true;
+    for (uint32_t i = 0; i < BUCKETS_PER_PASS && moreBuckets; i++) {
+        HashTableBucketLock lock(*objectManager,
+                                 objectMap->getNextBucketToMigrate());
+        moreBuckets = objectMap->migrateBucket(getKeyHashForReference,
+                                               objectManager);
+    }
+
+    if (!moreBuckets) {
+        objectManager->lockAllHashTableBuckets();
+        objectMap->finishResize();
+        objectManager->unlockAllHashTableBuckets();
+        LOG(NOTICE, "Hash table resize to %lu buckets complete",
+            objectMap->getNumBuckets());
+    }
+
+    // Everything retired during this pass is now unreachable for RPCs that
+    // start from here on, so it belongs to the epoch before the new one.
+    objectMap->tagRetiredMemory(LogProtector::incrementCurrentEpoch() - 1);
+
+    // Keep going right away, but after any other WorkerTimers that may be
+    // ready.
+    start(0);
+}
+
+/**
+ * Estimate the load of the hash table by sampling random buckets and
+ * return the number of buckets the table should have.
+ *
+ * \return
+ *      The current number of buckets if no resize is warranted (or
+ *      possible right now), otherwise the new number of buckets.
+ */
+uint64_t
+ObjectManager::HashTableResizer::chooseNumBuckets()
+{
+    uint64_t numBuckets = objectMap->getNumBuckets();
+
+    // Bucket locks are selected from the low bits of the key hash, so every
+    // size must have at least as many buckets as there are locks in order
+    // for a bucket's keys to share one lock before, during, and after a
+    // resize.
+    uint64_t numLocks = arrayLength(objectManager->hashTableBucketLocks);
+    if (numBuckets < numLocks)
+        return numBuckets;
+
+    uint64_t entries = 0;
+    for (uint32_t i = 0; i < SAMPLE_BUCKETS; i++) {
+        uint64_t bucket = generateRandom() & (numBuckets - 1);
+        HashTableBucketLock lock(*objectManager, bucket);
+        entries += objectMap->forEachInBucket(ignoreReference, NULL, bucket);
+    }
+    double load = static_cast<double>(entries) /
+            (SAMPLE_BUCKETS * HashTable::entriesPerCacheLine());
+
+    if (load > MAX_LOAD_FACTOR)
+        return numBuckets * 2;
+
+    // A shrinking table folds buckets above the new size into ones the
+    // tombstone remover may already have scanned, so it could miss entries
+    // while it is partway through a scan. Growing is fine: every entry in a
+    // bucket the remover hasn't reached yet stays at or above that index.
+    if (load < MIN_LOAD_FACTOR && numBuckets / 2 >= minNumBuckets &&
+            numBuckets / 2 >= numLocks &&
+            !objectManager->tombstoneRemover.isRunning())
+        return numBuckets / 2;
+    return numBuckets;
+}
+
 /**
  * Produce a human-readable description of the contents of a segment.
  * Intended primarily for use in unit tests.
@@ -2615,6 +2934,80 @@ ObjectManager::dumpSegment(Segment* segment)
     return result;
 }
 
+/**
+ * Return the index of the hash table bucket lock that serializes operations
+ * on keys with a given hash (see HashTableBucketLock). Operations on keys
+ * with different lock indexes never contend for the same lock. Used to
+ * steer requests for the same lock stripe to the same worker thread.
+ *
+ * \param keyHash
+ *      Primary key hash of the object.
+ */
+uint32_t
+ObjectManager::getBucketLockIndex(KeyHash keyHash)
+{
+    uint64_t unused;
+    uint64_t bucket = HashTable::findBucketIndex(objectMap.getNumBuckets(),
+                                                 keyHash, &unused);
+    uint32_t numLocks = arrayLength(hashTableBucketLocks);
+    return downCast<uint32_t>(bucket & (numLocks - 1));
+}
+
+/**
+ * Wait until every read lease granted so far has expired (see
+ * ReadLeaseTable). Used when migrating a tablet away: the new owner knows
+ * nothing about leases granted here, so it mustn't accept writes to the
+ * tablet while clients may still have its objects cached.
+ */
+void
+ObjectManager::waitForAllReadLeases()
+{
+    readLeases.waitForAll();
+}
+
+/**
+ * Return the primary key hash of the object or tombstone referenced by a
+ * hash table entry. Used as a HashTable::KeyHashCallback while resizing
+ * #objectMap.
+ *
+ * \param reference
+ *      Log reference stored in the hash table.
+ * \param cookie
+ *      The ObjectManager that owns the log.
+ */
+KeyHash
+ObjectManager::getKeyHashForReference(uint64_t reference, void *cookie)
+{
+    ObjectManager* objectManager = static_cast<ObjectManager*>(cookie);
+    Buffer buffer;
+    LogEntryType type = objectManager->log.getEntry(Log::Reference(reference),
+                                                    buffer);
+    Key key(type, buffer);
+    return key.getHash();
+}
+
+/**
+ * Acquire every hash table bucket lock, in index order. This excludes all
+ * other object operations and is only used for the brief transitions at the
+ * start and end of a hash table resize.
+ */
+void
+ObjectManager::lockAllHashTableBuckets()
+{
+    for (size_t i = 0; i < arrayLength(hashTableBucketLocks); i++)
+        hashTableBucketLocks[i].lock();
+}
+
+/**
+ * Release all locks acquired by #lockAllHashTableBuckets().
+ */
+void
+ObjectManager::unlockAllHashTableBuckets()
+{
+    for (size_t i = 0; i < arrayLength(hashTableBucketLocks); i++)
+        hashTableBucketLocks[i].unlock();
+}
+
 /**
  * Callback used by the Log to determine the modification timestamp of an
  * Object. Timestamps are stored in the Object itself, rather than in the
@@ -2664,6 +3057,52 @@ ObjectManager::getTxDecisionRecordTimestamp(Buffer& buffer)
     return record.getTimestamp();
 }
 
+/**
+ * Check whether any client may have an object cached, before it is modified.
+ *
+ * \param lock
+ *      This method must be invoked with the appropriate hash table bucket
+ *      lock already held. This parameter exists to help ensure correct
+ *      caller behaviour.
+ * \param key
+ *      Key of the object about to be modified.
+ * \return
+ *      True if a client holds a read lease on the object; the caller should
+ *      return STATUS_RETRY so that the client tries again later. No new
+ *      leases will be granted on the object in the meantime.
+ */
+bool
+ObjectManager::checkReadLeases(HashTableBucketLock& lock, Key& key)
+{
+    return expect_false(readLeases.checkWrite(key) != 0);
+}
+
+/**
+ * Wait until no client has an object cached, for operations that can't be
+ * retried later (such as committing a transaction). The bucket lock is
+ * released while waiting, so that a lease (up to
+ * ReadLeaseTable::MAX_LEASE_NANOSECONDS) doesn't hold up every other
+ * operation on the bucket; no new leases are granted on the object in the
+ * meantime. Callers must check anything else that depends on the lock only
+ * after this method returns.
+ *
+ * \param lock
+ *      The object's hash table bucket lock, which must be held. It is held
+ *      again when this method returns.
+ * \param key
+ *      Key of the object about to be modified.
+ */
+void
+ObjectManager::waitForReadLeases(HashTableBucketLock& lock, Key& key)
+{
+    uint64_t nanoseconds;
+    while (expect_false((nanoseconds = readLeases.checkWrite(key)) != 0)) {
+        lock.unlock();
+        Cycles::sleep(nanoseconds / 1000 + 1);
+        lock.relock();
+    }
+}
+
 /**
  * Look up an object in the hash table, then extract the entry from the
  * log. Since tombstones are stored in the hash table during recovery,
@@ -38,6 +38,7 @@
 #include "MasterTableMetadata.h"
 #include "UnackedRpcResults.h"
 #include "LockTable.h"
+#include "ReadLeaseTable.h"
 
 namespace RAMCloud {
 
@@ -74,15 +75,17 @@ class ObjectManager : public LogEntryHandlers,
                 uint32_t maxLength, Buffer* response, uint32_t* respNumHashes,
                 uint32_t* numObjects);
     void prefetchHashTableBucket(SegmentIterator* it);
+    void prefetchObjects(Key* keys[], uint32_t numKeys);
     Status readObject(Key& key, Buffer* outBuffer,
                 RejectRules* rejectRules, uint64_t* outVersion,
-                bool valueOnly = false);
+                bool valueOnly = false, uint32_t* leaseNanoseconds = NULL);
     Status removeObject(Key& key, RejectRules* rejectRules,
                 uint64_t* outVersion, Buffer* removedObjBuffer = NULL,
                 RpcResult* rpcResult = NULL, uint64_t* rpcResultPtr = NULL);
     void removeOrphanedObjects();
     void replaySegment(SideLog* sideLog, SegmentIterator& it,
-                std::unordered_map<uint64_t, uint64_t>* nextNodeIdMap);
+                std::unordered_map<uint64_t, uint64_t>* nextNodeIdMap,
+                uint32_t partition = 0, uint32_t numPartitions = 1);
     void replaySegment(SideLog* sideLog, SegmentIterator& it);
     void syncChanges();
     Status writeObject(Object& newObject, RejectRules* rejectRules,
@@ -133,6 +136,8 @@ class ObjectManager : public LogEntryHandlers,
     Log* getLog() { return &log; }
     ReplicaManager* getReplicaManager() { return &replicaManager; }
     HashTable* getObjectMap() { return &objectMap; }
+    uint32_t getBucketLockIndex(KeyHash keyHash);
+    void waitForAllReadLeases();
 
     /**
      * An object of this class must be held by any activity that places
@@ -206,6 +211,28 @@ class ObjectManager : public LogEntryHandlers,
             lock->unlock();
         }
 
+        /**
+         * Release the bucket lock temporarily, for example to wait for
+         * something without blocking other operations on the bucket. The
+         * lock must be reacquired with relock() before this object is
+         * destroyed, and anything checked while holding it must be
+         * checked again afterwards.
+         */
+        void
+        unlock()
+        {
+            lock->unlock();
+        }
+
+        /**
+         * Reacquire a bucket lock released with unlock().
+         */
+        void
+        relock()
+        {
+            lock->lock();
+        }
+
       PRIVATE:
         /**
          * Helper method that actually acquires the appropriate bucket lock.
@@ -274,10 +301,72 @@ class ObjectManager : public LogEntryHandlers,
         DISALLOW_COPY_AND_ASSIGN(TombstoneRemover);
     };
 
+    /**
+     * This object executes in the background (as a WorkerTimer) when
+     * ServerConfig::Master::hashTableAutoResize is set. It periodically
+     * samples the load of #objectMap and, if the table is too full or too
+     * empty, resizes it a few buckets at a time so that RPCs are never
+     * blocked for more than one bucket's migration.
+     */
+    class HashTableResizer : public WorkerTimer {
+      public:
+        HashTableResizer(ObjectManager* objectManager,
+                        HashTable* objectMap);
+        void handleTimerEvent();
+        uint64_t chooseNumBuckets();
+
+      PRIVATE:
+        /// The ObjectManager that owns the hash table being resized.
+        ObjectManager* objectManager;
+
+        /// The hash table to be resized.
+        HashTable* objectMap;
+
+        /// The table is never shrunk below the size it was created with.
+        uint64_t minNumBuckets;
+
+        /// Grow the table when the sampled fraction of used entries
+        /// exceeds this.
+        static constexpr double MAX_LOAD_FACTOR = 0.75;
+
+        /// Shrink the table when the sampled fraction of used entries
+        /// falls below this.
+        static constexpr double MIN_LOAD_FACTOR = 0.10;
+
+        /// Number of randomly chosen buckets examined to estimate the load.
+        static const uint32_t SAMPLE_BUCKETS = 256;
+
+        /// Number of buckets migrated before yielding to other WorkerTimers.
+        static const uint32_t BUCKETS_PER_PASS = 1000;
+
+        /// How often to check the load when no resize is in progress.
+        static const uint64_t CHECK_INTERVAL_MS = 100;
+
+        DISALLOW_COPY_AND_ASSIGN(HashTableResizer);
+    };
+
+    /// Number of bytes at the start of each candidate log entry that
+    /// prefetchObjects() brings into the cache: enough for the entry and
+    /// object headers and a typical key, which is what lookup() examines.
+    static const uint32_t PREFETCH_LOG_ENTRY_BYTES = 128;
+
+    /// replaySegment() verifies the checksums of this many upcoming objects
+    /// at a time (see verifyObjectChecksums()).
+    static const uint32_t REPLAY_CHECKSUM_BATCH = 12;
+
     static string dumpSegment(Segment* segment);
+    static KeyHash getKeyHashForReference(uint64_t reference, void *cookie);
+    void lockAllHashTableBuckets();
+    void unlockAllHashTableBuckets();
+    uint32_t getReplayPartition(SegmentIterator& it, uint32_t numPartitions);
+    uint32_t verifyObjectChecksums(SegmentIterator it, uint32_t maxObjects,
+                                   bool* valid, uint32_t partition = 0,
+                                   uint32_t numPartitions = 1);
     uint32_t getObjectTimestamp(Buffer& buffer);
     uint32_t getTombstoneTimestamp(Buffer& buffer);
     uint32_t getTxDecisionRecordTimestamp(Buffer& buffer);
+    bool checkReadLeases(HashTableBucketLock& lock, Key& key);
+    void waitForReadLeases(HashTableBucketLock& lock, Key& key);
     bool lookup(HashTableBucketLock& lock, Key& key,
                 LogEntryType& outType, Buffer& buffer,
                 uint64_t* outVersion = NULL,
@@ -399,6 +488,12 @@ class ObjectManager : public LogEntryHandlers,
      */
     LockTable lockTable;
 
+    /**
+     * Objects that clients may have cached; these can't be modified until
+     * the clients' leases expire.
+     */
+    ReadLeaseTable readLeases;
+
     /**
      * Protects access to tombstoneRemover and tombstoneProtectorCount.
      */
@@ -416,6 +511,11 @@ class ObjectManager : public LogEntryHandlers,
      */
     int tombstoneProtectorCount;
 
+    /**
+     * Grows and shrinks #objectMap in the background, if enabled.
+     */
+    HashTableResizer hashTableResizer;
+
     friend class CleanerCompactionBenchmark;
     friend class ObjectManagerBenchmark;
 
@@ -13,6 +13,8 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <thread>
+
 #include "TestUtil.h"
 #include "BackupStorage.h"
 #include "Buffer.h"
@@ -565,6 +567,36 @@ TEST_F(ObjectManagerTest, readHashes) {
                                   o1.getValueLength()));
 }
 
+TEST_F(ObjectManagerTest, prefetchObjects) {
+    Key key1(1, "1", 1);
+    Key key2(1, "2", 1);
+    Key key3(1, "3", 1);
+    tabletManager.addTablet(1, 0, ~0UL, TabletManager::NORMAL);
+    storeObject(key1, "hi", 93);
+    storeTombstone(key2);
+
+    // Prefetching must not disturb the objects, whether they exist, are
+    // deleted, or were never written.
+    Key* keys[] = { &key1, &key2, &key3 };
+    objectManager.prefetchObjects(keys, 3);
+    objectManager.prefetchObjects(keys, 0);
+
+    // No bucket locks are taken, so this can't block.
+    {
+        ObjectManager::HashTableBucketLock lock(objectManager, key1);
+        objectManager.prefetchObjects(keys, 3);
+    }
+
+    Buffer buffer;
+    uint64_t version;
+    EXPECT_EQ(STATUS_OK, objectManager.readObject(key1, &buffer, 0, &version));
+    EXPECT_EQ(93UL, version);
+    EXPECT_EQ(STATUS_OBJECT_DOESNT_EXIST,
+        objectManager.readObject(key2, &buffer, 0, 0));
+    EXPECT_EQ(STATUS_OBJECT_DOESNT_EXIST,
+        objectManager.readObject(key3, &buffer, 0, 0));
+}
+
 TEST_F(ObjectManagerTest, readObject) {
     Buffer buffer;
     Key key(1, "1", 1);
@@ -614,6 +646,30 @@ TEST_F(ObjectManagerTest, readObject) {
         tabletManager.toString());
 }
 
+TEST_F(ObjectManagerTest, readObject_lease) {
+    Buffer buffer;
+    Key key(1, "1", 1);
+    storeObject(key, "hi", 93);
+    tabletManager.addTablet(1, 0, ~0UL, TabletManager::NORMAL);
+
+    uint32_t lease = 500;
+    Key key2(1, "2", 1);
+    EXPECT_EQ(STATUS_OBJECT_DOESNT_EXIST,
+        objectManager.readObject(key2, &buffer, 0, 0, true, &lease));
+    EXPECT_EQ(500U, lease);
+    EXPECT_EQ(0U, objectManager.readLeases.leases.size());
+
+    EXPECT_EQ(STATUS_OK,
+        objectManager.readObject(key, &buffer, 0, 0, true, &lease));
+    EXPECT_EQ(500U, lease);
+    EXPECT_EQ(1U, objectManager.readLeases.leases.count(key.getHash()));
+
+    lease = 0;
+    EXPECT_EQ(STATUS_OK,
+        objectManager.readObject(key, &buffer, 0, 0, true, &lease));
+    EXPECT_EQ(0U, lease);
+}
+
 static bool
 antiGetEntryFilter(string s)
 {
@@ -1584,6 +1640,132 @@ TEST_F(ObjectManagerTest, replaySegment_ParticipantList) {
 
 }
 
+TEST_F(ObjectManagerTest, getReplayPartition) {
+    Segment s;
+    Key key(0, "key0", 4);
+    Buffer dataBuffer;
+    Object object(key, "value", 5, 1, 0, dataBuffer);
+    Buffer objectBuffer;
+    object.assembleForLog(objectBuffer);
+    EXPECT_TRUE(s.append(LOG_ENTRY_TYPE_OBJ, objectBuffer));
+    ObjectTombstone tombstone(object, 0, 0);
+    Buffer tombstoneBuffer;
+    tombstone.assembleForLog(tombstoneBuffer);
+    EXPECT_TRUE(s.append(LOG_ENTRY_TYPE_OBJTOMB, tombstoneBuffer));
+    ObjectSafeVersion safeVersion(10UL);
+    Buffer safeVersionBuffer;
+    safeVersion.assembleForLog(safeVersionBuffer);
+    EXPECT_TRUE(s.append(LOG_ENTRY_TYPE_SAFEVERSION, safeVersionBuffer));
+
+    uint32_t expected = objectManager.getBucketLockIndex(key.getHash()) % 7;
+    SegmentIterator it(s);
+    EXPECT_EQ(expected, objectManager.getReplayPartition(it, 7));
+    it.next();
+    EXPECT_EQ(expected, objectManager.getReplayPartition(it, 7));
+    it.next();
+    EXPECT_EQ(0U, objectManager.getReplayPartition(it, 7));
+}
+
+TEST_F(ObjectManagerTest, replaySegment_partitioned) {
+    ObjectManager::TombstoneProtector p(&objectManager);
+    Segment s;
+    for (int i = 0; i < 20; i++) {
+        string keyString = format("key%d", i);
+        Key key(0, keyString.c_str(), downCast<uint16_t>(keyString.size()));
+        Buffer dataBuffer;
+        Object object(key, keyString.c_str(),
+                      downCast<uint32_t>(keyString.size()) + 1, 1, 0,
+                      dataBuffer);
+        Buffer objectBuffer;
+        object.assembleForLog(objectBuffer);
+        EXPECT_TRUE(s.append(LOG_ENTRY_TYPE_OBJ, objectBuffer));
+    }
+    s.close();
+    Buffer buffer;
+    uint32_t length = s.appendToBuffer(buffer);
+    char contents[length];
+    buffer.copy(0, length, contents);
+    SegmentCertificate certificate;
+    s.getAppendedLength(&certificate);
+
+    // Replaying only partition 1 should leave exactly the keys in
+    // partition 0 missing.
+    SideLog sl(&objectManager.log);
+    Tub<SegmentIterator> it;
+    it.construct(&contents[0], length, certificate);
+    objectManager.replaySegment(&sl, *it, NULL, 1, 2);
+    int found = 0;
+    for (int i = 0; i < 20; i++) {
+        string keyString = format("key%d", i);
+        Key key(0, keyString.c_str(), downCast<uint16_t>(keyString.size()));
+        Buffer value;
+        LogEntryType type;
+        ObjectManager::HashTableBucketLock lock(objectManager, key);
+        bool present = objectManager.lookup(lock, key, type, value);
+        EXPECT_EQ(objectManager.getBucketLockIndex(key.getHash()) % 2 == 1,
+                  present);
+        if (present)
+            found++;
+    }
+    EXPECT_LT(0, found);
+    EXPECT_GT(20, found);
+
+    // Replaying the other partition fills in the rest.
+    it.construct(&contents[0], length, certificate);
+    objectManager.replaySegment(&sl, *it, NULL, 0, 2);
+    for (int i = 0; i < 20; i++) {
+        string keyString = format("key%d", i);
+        Key key(0, keyString.c_str(), downCast<uint16_t>(keyString.size()));
+        verifyRecoveryObject(key, keyString);
+    }
+}
+
+TEST_F(ObjectManagerTest, verifyObjectChecksums) {
+    Segment s;
+    for (int i = 0; i < 5; i++) {
+        Key key(0, format("key%d", i).c_str(),
+                downCast<uint16_t>(format("key%d", i).size()));
+        Buffer dataBuffer;
+        Object object(key, "value", 5, 1, 0, dataBuffer);
+        Buffer objectBuffer;
+        object.assembleForLog(objectBuffer);
+        EXPECT_TRUE(s.append(LOG_ENTRY_TYPE_OBJ, objectBuffer));
+        if (i == 1) {
+            ObjectTombstone tombstone(object, 0, 0);
+            Buffer tombstoneBuffer;
+            tombstone.assembleForLog(tombstoneBuffer);
+            EXPECT_TRUE(s.append(LOG_ENTRY_TYPE_OBJTOMB, tombstoneBuffer));
+        }
+    }
+    s.close();
+    Buffer buffer;
+    uint32_t length = s.appendToBuffer(buffer);
+    char contents[length];
+    buffer.copy(0, length, contents);
+
+    // Corrupt the value of the fourth object.
+    Segment copy(contents, length);
+    SegmentIterator it(copy);
+    for (int objects = 0; ; it.next()) {
+        if (it.getType() == LOG_ENTRY_TYPE_OBJ && ++objects == 4)
+            break;
+    }
+    char* object = const_cast<char*>(reinterpret_cast<const char*>(
+            it.getContiguous<Object::Header>(NULL, 0)));
+    object[it.getLength() - 1]++;
+
+    bool valid[ObjectManager::REPLAY_CHECKSUM_BATCH];
+    SegmentIterator it2(copy);
+    EXPECT_EQ(3U, objectManager.verifyObjectChecksums(it2, 3, valid));
+    EXPECT_TRUE(valid[0]);
+    EXPECT_TRUE(valid[1]);
+    EXPECT_TRUE(valid[2]);
+    EXPECT_EQ(5U, objectManager.verifyObjectChecksums(it2, 100, valid));
+    EXPECT_TRUE(valid[0]);
+    EXPECT_FALSE(valid[3]);
+    EXPECT_TRUE(valid[4]);
+}
+
 static bool
 writeObjectFilter(string s)
 {
@@ -1643,6 +1825,83 @@ TEST_F(ObjectManagerTest, writeObject) {
     objectManager.getLog()->totalLiveBytes = original;
 }
 
+TEST_F(ObjectManagerTest, writeObject_readLease) {
+    tabletManager.addTablet(1, 0, ~0UL, TabletManager::NORMAL);
+    Key key(1, "1", 1);
+    Buffer buffer;
+    Object obj(key, "value", 5, 0, 0, buffer);
+    EXPECT_EQ(STATUS_OK, objectManager.writeObject(obj, 0, 0));
+
+    uint32_t lease = ReadLeaseTable::MAX_LEASE_NANOSECONDS;
+    Buffer value;
+    EXPECT_EQ(STATUS_OK,
+        objectManager.readObject(key, &value, 0, 0, true, &lease));
+    EXPECT_EQ(STATUS_RETRY, objectManager.writeObject(obj, 0, 0));
+    EXPECT_EQ(STATUS_RETRY, objectManager.removeObject(key, 0, 0));
+
+    // No new leases until the write goes through.
+    EXPECT_EQ(STATUS_OK,
+        objectManager.readObject(key, &value, 0, 0, true, &lease));
+    EXPECT_EQ(0U, lease);
+
+    {
+        ObjectManager::HashTableBucketLock lock(objectManager, key);
+        objectManager.waitForReadLeases(lock, key);
+    }
+    uint64_t version;
+    EXPECT_EQ(STATUS_OK, objectManager.writeObject(obj, 0, &version));
+    EXPECT_EQ(2U, version);
+}
+
+// Waits for read leases on \a key, as a transaction commit would.
+static void
+waitForReadLeasesThread(ObjectManager* objectManager, Key* key,
+                        std::atomic<bool>* done)
+{
+    ObjectManager::HashTableBucketLock lock(*objectManager, *key);
+    objectManager->waitForReadLeases(lock, *key);
+    *done = true;
+}
+
+TEST_F(ObjectManagerTest, waitForReadLeases) {
+    Key key(1, "1", 1);
+    {
+        ObjectManager::HashTableBucketLock lock(objectManager, key);
+        objectManager.waitForReadLeases(lock, key);
+    }
+
+    // Longer than any lease that would be granted, so that the test isn't
+    // sensitive to timing.
+    ReadLeaseTable& leases = objectManager.readLeases;
+    leases.grant(key, 1000);
+    uint64_t expiration = Cycles::rdtsc() + Cycles::fromSeconds(0.2);
+    leases.leases[key.getHash()].expiration = expiration;
+    leases.latestExpiration = expiration;
+
+    std::atomic<bool> done(false);
+    std::thread waiter(waitForReadLeasesThread, &objectManager, &key, &done);
+    // Wait for the waiter to find the lease.
+    while (1) {
+        {
+            SpinLock::Guard _(leases.mutex);
+            if (leases.leases[key.getHash()].writePending)
+                break;
+        }
+        usleep(100);
+    }
+
+    // The bucket lock isn't held while waiting, and no new leases are
+    // granted.
+    {
+        ObjectManager::HashTableBucketLock lock(objectManager, key);
+        EXPECT_FALSE(done);
+        EXPECT_EQ(0U, leases.grant(key, 1000));
+    }
+    waiter.join();
+    EXPECT_TRUE(done);
+    EXPECT_GE(Cycles::rdtsc(), expiration);
+}
+
 TEST_F(ObjectManagerTest, writeObject_returnRemovedObj) {
     tabletManager.addTablet(1, 0, ~0UL, TabletManager::NORMAL);
     Key key(1, "a", 1);
@@ -2211,6 +2470,122 @@ TEST_F(ObjectManagerTest, TombstoneRemover_handleTimerEvent_doWork) {
     }
 }
 
+TEST_F(ObjectManagerTest, getBucketLockIndex) {
+    ASSERT_LE(1024lu, objectManager.objectMap.getNumBuckets());
+    EXPECT_EQ(0x3ffu, objectManager.getBucketLockIndex(0x12fffUL));
+    EXPECT_EQ(0x3ffu, objectManager.getBucketLockIndex(0x123ffUL));
+
+    // Fewer buckets than locks: keys sharing a bucket share a lock.
+    objectManager.objectMap.startResize(512);
+    while (objectManager.objectMap.migrateBucket(
+            ObjectManager::getKeyHashForReference, &objectManager)) {}
+    objectManager.objectMap.finishResize();
+    EXPECT_EQ(0x1ffu, objectManager.getBucketLockIndex(0x12fffUL));
+    EXPECT_EQ(0x1ffu, objectManager.getBucketLockIndex(0x121ffUL));
+}
+
+TEST_F(ObjectManagerTest, HashTableResizer_chooseNumBuckets) {
+    Key key1(0, "key1", 4);
+    storeObject(key1, "value1");
+    uint64_t numBuckets = objectManager.objectMap.getNumBuckets();
+
+    // Nearly empty, but already at the minimum size.
+    EXPECT_EQ(numBuckets,
+              objectManager.hashTableResizer.chooseNumBuckets());
+
+    objectManager.hashTableResizer.minNumBuckets = 1024;
+    EXPECT_EQ(numBuckets / 2,
+              objectManager.hashTableResizer.chooseNumBuckets());
+
+    // Don't shrink while the tombstone remover is partway through a scan.
+    objectManager.tombstoneRemover.start(0);
+    EXPECT_EQ(numBuckets,
+              objectManager.hashTableResizer.chooseNumBuckets());
+    objectManager.tombstoneRemover.stop();
+
+    // Never resize tables with fewer buckets than locks.
+    objectManager.hashTableResizer.minNumBuckets = 1;
+    objectManager.objectMap.startResize(512);
+    while (objectManager.objectMap.migrateBucket(
+            ObjectManager::getKeyHashForReference, &objectManager)) {}
+    objectManager.objectMap.finishResize();
+    EXPECT_EQ(512lu, objectManager.hashTableResizer.chooseNumBuckets());
+}
+
+TEST_F(ObjectManagerTest, HashTableResizer_handleTimerEvent) {
+    TestLog::Enable logEnabler("handleTimerEvent");
+    Key key1(0, "key1", 4);
+    storeObject(key1, "value1");
+    Key key2(0, "key2", 4);
+    storeTombstone(key2);
+    uint64_t numBuckets = objectManager.objectMap.getNumBuckets();
+
+    // No resize needed.
+    objectManager.hashTableResizer.handleTimerEvent();
+    EXPECT_FALSE(objectManager.objectMap.isResizing());
+    EXPECT_EQ("", TestLog::get());
+    EXPECT_TRUE(objectManager.hashTableResizer.isRunning());
+
+    objectManager.hashTableResizer.minNumBuckets = 1024;
+    objectManager.hashTableResizer.handleTimerEvent();
+    EXPECT_TRUE(objectManager.objectMap.isResizing());
+    EXPECT_EQ(1000lu, objectManager.objectMap.getNextBucketToMigrate());
+    EXPECT_EQ(format("handleTimerEvent: Resizing hash table from %lu to "
+                     "%lu buckets", numBuckets, numBuckets / 2),
+              TestLog::get());
+
+    while (objectManager.objectMap.isResizing())
+        objectManager.hashTableResizer.handleTimerEvent();
+    EXPECT_EQ(numBuckets / 2, objectManager.objectMap.getNumBuckets());
+    EXPECT_TRUE(objectManager.objectMap.hasRetiredMemory());
+    Buffer value;
+    EXPECT_EQ(STATUS_OK,
+              objectManager.readObject(key1, &value, NULL, NULL, true));
+    EXPECT_EQ("value1", TestUtil::toString(&value));
+    LogEntryType type;
+    Buffer buffer;
+    {
+        ObjectManager::HashTableBucketLock lock(objectManager, key2);
+        EXPECT_TRUE(objectManager.lookup(lock, key2, type, buffer, 0, 0));
+        EXPECT_EQ(LOG_ENTRY_TYPE_OBJTOMB, type);
+    }
+
+    // No RPCs are outstanding, so the old table can be freed right away.
+    objectManager.hashTableResizer.minNumBuckets = numBuckets / 2;
+    objectManager.hashTableResizer.handleTimerEvent();
+    EXPECT_FALSE(objectManager.objectMap.hasRetiredMemory());
+}
+
+TEST_F(ObjectManagerTest, HashTableResizer_handleTimerEvent_readerActive) {
+    // Fill bucket 0 with enough references to need two overflow cache
+    // lines; migrating the bucket retires them.
+    for (uint64_t i = 1; i <= 2 * HashTable::entriesPerCacheLine(); i++)
+        objectManager.objectMap.insert(i << 48, i);
+
+    // Stands in for an enumeration that started before the resize and may
+    // still be walking the old bucket.
+    LogProtector::Activity activity;
+    activity.start();
+
+    objectManager.hashTableResizer.minNumBuckets = 1024;
+    objectManager.hashTableResizer.handleTimerEvent();
+    EXPECT_TRUE(objectManager.objectMap.isResizing());
+    ASSERT_EQ(1U, objectManager.objectMap.taggedMemory.size());
+    EXPECT_EQ(2U,
+              objectManager.objectMap.taggedMemory.front().cacheLines.size());
+
+    objectManager.hashTableResizer.handleTimerEvent();
+    ASSERT_LE(1U, objectManager.objectMap.taggedMemory.size());
+    EXPECT_EQ(2U,
+              objectManager.objectMap.taggedMemory.front().cacheLines.size());
+
+    activity.stop();
+    objectManager.hashTableResizer.handleTimerEvent();
+    foreach(HashTable::RetiredMemory& memory,
+            objectManager.objectMap.taggedMemory)
+        EXPECT_EQ(0U, memory.cacheLines.size());
+}
+
 TEST_F(ObjectManagerTest, TombstoneProtector) {
     TestLog::Enable logEnabler("handleTimerEvent");
     Tub<ObjectManager::TombstoneProtector> protector1, protector2;
@@ -17,6 +17,7 @@
 #include "Logger.h"
 #include "ObjectFinder.h"
 #include "ObjectRpcWrapper.h"
+#include "ReadBatcher.h"
 
 namespace RAMCloud {
 
@@ -50,6 +51,7 @@ ObjectRpcWrapper::ObjectRpcWrapper(Context* context, uint64_t tableId,
     , context(context)
     , tableId(tableId)
     , keyHash(Key::getHash(tableId, key, keyLength))
+    , batcher(NULL)
 {
 }
 
@@ -79,6 +81,7 @@ ObjectRpcWrapper::ObjectRpcWrapper(Context* context, uint64_t tableId,
     , context(context)
     , tableId(tableId)
     , keyHash(keyHash)
+    , batcher(NULL)
 {
 }
 
@@ -121,6 +124,8 @@ ObjectRpcWrapper::send()
     try {
         session = context->objectFinder->tryLookup(tableId, keyHash);
         if (session) {
+            if (batcher != NULL)
+                session = batcher->getSession(session);
             state = IN_PROGRESS;
             session->sendRequest(&request, response, this);
         } else {
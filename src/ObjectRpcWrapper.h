@@ -20,6 +20,8 @@
 
 namespace RAMCloud {
 
+class ReadBatcher;
+
 /**
  * ObjectRpcWrapper manages the client side of RPCs that must be sent to the
  * server that stores a particular object (more specifically, a particular
@@ -57,6 +59,11 @@ class ObjectRpcWrapper : public RpcWrapper {
     uint64_t tableId;
     uint64_t keyHash;
 
+    /// If non-NULL, requests are sent through this batcher rather than
+    /// directly to the master. Set by subclasses whose requests it can
+    /// combine (see ReadBatcher).
+    ReadBatcher* batcher;
+
     DISALLOW_COPY_AND_ASSIGN(ObjectRpcWrapper);
 };
 
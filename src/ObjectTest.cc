@@ -835,6 +835,26 @@ TEST_F(ObjectTest, checkIntegrity) {
     }
 }
 
+TEST_F(ObjectTest, computeChecksums) {
+    const Object::Header* headers[arrayLength(objects)];
+    uint32_t lengths[arrayLength(objects)];
+    uint32_t checksums[arrayLength(objects)];
+    Buffer buffers[arrayLength(objects)];
+    for (uint32_t i = 0; i < arrayLength(objects); i++) {
+        objects[i]->assembleForLog(buffers[i]);
+        lengths[i] = buffers[i].size();
+        headers[i] = static_cast<const Object::Header*>(
+                buffers[i].getRange(0, lengths[i]));
+    }
+    Object::computeChecksums(arrayLength(objects), headers, lengths,
+                             checksums);
+    for (uint32_t i = 0; i < arrayLength(objects); i++) {
+        EXPECT_EQ(objects[i]->computeChecksum(), checksums[i]);
+        EXPECT_EQ(Object::computeChecksum(headers[i], lengths[i]),
+                  checksums[i]);
+    }
+}
+
 /**
  * Unit tests for ObjectTombstone.
  */
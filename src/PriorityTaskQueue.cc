@@ -159,8 +159,7 @@ PriorityTaskQueue::performTask()
     if (!task)
         return;
     task->performTask();
-    ++doneCount;
-    changes.notify_all();
+    taskDone();
 }
 
 /**
@@ -187,8 +186,7 @@ PriorityTaskQueue::performTasksUntilHalt()
 {
     while (PriorityTask* task = getNextTask(true)) {
         task->performTask();
-        ++doneCount;
-        changes.notify_all();
+        taskDone();
     }
 }
 
@@ -322,6 +320,19 @@ PriorityTaskQueue::quiesce()
 
 // - private -
 
+/**
+ * Record that a task returned by getNextTask() has finished executing and
+ * wake up anyone in quiesce(). Several threads may be performing tasks at
+ * once, so the count is only updated with #mutex held.
+ */
+void
+PriorityTaskQueue::taskDone()
+{
+    Lock _(mutex);
+    ++doneCount;
+    changes.notify_all();
+}
+
 /**
  * Return the next task from the task queue if one is scheduled.
  *
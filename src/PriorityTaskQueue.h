@@ -169,6 +169,7 @@ class PriorityTaskQueue {
     void deschedule(PriorityTask* task);
     void deschedule(Lock& lock, PriorityTask* task);
 
+    void taskDone();
     PriorityTask* getNextTask(bool sleepIfIdle);
     typedef PriorityTask::PriorityQueueEntry PriorityQueueEntry;
     static bool entryLessThan(const PriorityQueueEntry* left,
@@ -31,6 +31,8 @@
 #include "Object.h"
 #include "ObjectFinder.h"
 #include "ProtoBuf.h"
+#include "ReadBatcher.h"
+#include "ReadCache.h"
 #include "RpcTracker.h"
 #include "ShortMacros.h"
 #include "TimeTrace.h"
@@ -60,6 +62,8 @@ RamCloud::RamCloud(CommandLineOptions* options)
     , clientLeaseAgent(new ClientLeaseAgent(this))
     , rpcTracker(new RpcTracker())
     , transactionManager(new ClientTransactionManager())
+    , readCache(NULL)
+    , readBatcher(NULL)
 {
     coordinatorLocator = options->getExternalStorageLocator();
     if (coordinatorLocator.size() == 0) {
@@ -82,6 +86,8 @@ RamCloud::RamCloud(Context* context)
     , clientLeaseAgent(new ClientLeaseAgent(this))
     , rpcTracker(new RpcTracker())
     , transactionManager(new ClientTransactionManager())
+    , readCache(NULL)
+    , readBatcher(NULL)
 {
     coordinatorLocator = context->options->getExternalStorageLocator();
     if (coordinatorLocator.size() == 0) {
@@ -101,6 +107,8 @@ RamCloud::RamCloud(const char* locator, const char* clusterName)
     , clientLeaseAgent(new ClientLeaseAgent(this))
     , rpcTracker(new RpcTracker())
     , transactionManager(new ClientTransactionManager())
+    , readCache(NULL)
+    , readBatcher(NULL)
 {
     clientContext->coordinatorSession->setLocation(locator, clusterName);
 }
@@ -112,6 +120,8 @@ RamCloud::RamCloud(Context* context, const char* locator,
     , clientLeaseAgent(new ClientLeaseAgent(this))
     , rpcTracker(new RpcTracker())
     , transactionManager(new ClientTransactionManager())
+    , readCache(NULL)
+    , readBatcher(NULL)
 {
     clientContext->coordinatorSession->setLocation(locator, clusterName);
 }
@@ -125,9 +135,11 @@ RamCloud::~RamCloud()
     delete clientLeaseAgent;
 
     delete rpcTracker;
+    delete readBatcher;
     delete realClientContext;
 
     delete transactionManager;
+    delete readCache;
 }
 
 /**
@@ -624,6 +636,47 @@ EchoRpc::wait()
     assert(respHdr->length == response->size());
 }
 
+/**
+ * Start (or stop) combining independent reads that are headed for the same
+ * master into MultiOp RPCs (see ReadBatcher). This benefits applications
+ * that keep many asynchronous ReadRpcs outstanding, and costs nothing
+ * when reads are issued one at a time. Reads that ask for a read lease
+ * (see enableReadCache) are never batched.
+ *
+ * This must not be called while any ReadRpcs are outstanding.
+ *
+ * \param enable
+ *      True means batch reads; false means send each one separately.
+ */
+void
+RamCloud::enableReadBatching(bool enable)
+{
+    delete readBatcher;
+    readBatcher = NULL;
+    if (enable)
+        readBatcher = new ReadBatcher(clientContext);
+}
+
+/**
+ * Start caching the objects returned by read, so that repeated reads of
+ * the same object can be answered without contacting its master. Each
+ * object is cached only as long as its master has agreed not to modify it
+ * (see ReadCache), so reads still return the latest value; in exchange,
+ * writes to a cached object may be delayed by up to a millisecond.
+ * Reads with reject rules always go to the master.
+ *
+ * \param maxObjects
+ *      Largest number of objects to cache; 0 disables caching.
+ */
+void
+RamCloud::enableReadCache(uint32_t maxObjects)
+{
+    delete readCache;
+    readCache = NULL;
+    if (maxObjects > 0)
+        readCache = new ReadCache(maxObjects);
+}
+
 /**
  * This method provides the core of table enumeration. It is invoked
  * repeatedly to enumerate a table; each invocation returns the next
@@ -2015,8 +2068,33 @@ RamCloud::read(uint64_t tableId, const void* key, uint16_t keyLength,
         Buffer* value, const RejectRules* rejectRules, uint64_t* version,
         bool* objectExists)
 {
-    ReadRpc rpc(this, tableId, key, keyLength, value, rejectRules);
-    rpc.wait(version, objectExists);
+    if (readCache == NULL || rejectRules != NULL) {
+        ReadRpc rpc(this, tableId, key, keyLength, value, rejectRules);
+        rpc.wait(version, objectExists);
+        return;
+    }
+
+    uint64_t objectVersion;
+    if (readCache->lookup(tableId, key, keyLength, value, &objectVersion)) {
+        if (version != NULL)
+            *version = objectVersion;
+        if (objectExists != NULL)
+            *objectExists = true;
+        return;
+    }
+
+    // The lease is measured from when the request is sent.
+    uint64_t start = Cycles::rdtsc();
+    ReadRpc rpc(this, tableId, key, keyLength, value, NULL,
+            ReadCache::LEASE_NANOSECONDS);
+    uint32_t leaseNanoseconds = 0;
+    rpc.wait(&objectVersion, objectExists, &leaseNanoseconds);
+    if (version != NULL)
+        *version = objectVersion;
+    if (leaseNanoseconds > 0) {
+        readCache->insert(tableId, key, keyLength, value, objectVersion,
+                start + Cycles::fromNanoseconds(leaseNanoseconds));
+    }
 }
 
 /**
@@ -2076,10 +2154,13 @@ RamCloud::readKeysAndValue(uint64_t tableId, const void* key,
  * \param rejectRules
  *      If non-NULL, specifies conditions under which the read
  *      should be aborted with an error.
+ * \param leaseNanoseconds
+ *      If nonzero, ask the master for a lease of this length on the object,
+ *      so that it can be cached (see ReadCache).
  */
 ReadRpc::ReadRpc(RamCloud* ramcloud, uint64_t tableId,
         const void* key, uint16_t keyLength, Buffer* value,
-        const RejectRules* rejectRules)
+        const RejectRules* rejectRules, uint32_t leaseNanoseconds)
     : ObjectRpcWrapper(ramcloud->clientContext, tableId, key, keyLength,
             sizeof(WireFormat::Read::Response), value)
 {
@@ -2088,7 +2169,11 @@ ReadRpc::ReadRpc(RamCloud* ramcloud, uint64_t tableId,
     reqHdr->tableId = tableId;
     reqHdr->keyLength = keyLength;
     reqHdr->rejectRules = rejectRules ? *rejectRules : defaultRejectRules;
+    reqHdr->leaseNanoseconds = leaseNanoseconds;
     request.append(key, keyLength);
+    // Batched reads come back without leases.
+    if (leaseNanoseconds == 0)
+        batcher = ramcloud->readBatcher;
     send();
 }
 
@@ -2101,9 +2186,14 @@ ReadRpc::ReadRpc(RamCloud* ramcloud, uint64_t tableId,
  * \param[out] objectExists
  *      If non-NULL, the ObjectDoesntExistException is not thrown and a flag
  *      indicating the existence of the object is returned here.
+ * \param[out] leaseNanoseconds
+ *      If non-NULL, the length of the lease granted by the master (measured
+ *      from when the RPC was started) is returned here; 0 means the object
+ *      must not be cached.
  */
 void
-ReadRpc::wait(uint64_t* version, bool* objectExists)
+ReadRpc::wait(uint64_t* version, bool* objectExists,
+        uint32_t* leaseNanoseconds)
 {
     if (objectExists != NULL)
         *objectExists = true;
@@ -2123,6 +2213,11 @@ ReadRpc::wait(uint64_t* version, bool* objectExists)
         }
     }
 
+    if (leaseNanoseconds != NULL) {
+        *leaseNanoseconds = (respHdr->common.status == STATUS_OK)
+                ? respHdr->leaseNanoseconds : 0;
+    }
+
     // Truncate the response Buffer so that it consists of nothing
     // but the object data.
     response->truncateFront(sizeof(*respHdr));
@@ -2404,6 +2499,169 @@ ObjectServerControlRpc::wait()
     response->truncateFront(sizeof(*respHdr));
     assert(respHdr->outputLength == response->size());
 }
+/**
+ * Retrieve the next group of objects in a range of key hashes within a
+ * table. Like enumerateTable, this is invoked repeatedly, and each
+ * invocation returns objects from a single tablet; unlike enumerateTable,
+ * it covers only the given range of key hashes, so several ranges of a
+ * table can be scanned concurrently, and objects may be filtered on the
+ * master by key prefix and version.
+ *
+ * This method is meant to be called from TableScanner and should not
+ * normally be used directly by applications.
+ *
+ * \param tableId
+ *      The table being scanned (return value from a previous call
+ *      to getTableId).
+ * \param keysOnly
+ *      False means that full objects are returned, containing both keys
+ *      and data. True means that the returned objects have been truncated
+ *      so that the object data is omitted (as in enumerateTable).
+ * \param tabletFirstHash
+ *      Where to continue the scan. The caller should provide the first
+ *      key hash of the range in the initial call. On subsequent calls,
+ *      the caller should pass the return value from the previous call.
+ * \param lastHash
+ *      The largest key hash in the range being scanned.
+ * \param keyPrefix
+ *      If non-NULL, only objects whose primary keys start with these
+ *      bytes are returned.
+ * \param keyPrefixLength
+ *      Number of bytes in \a keyPrefix.
+ * \param minVersion
+ *      Only objects with versions at least this large are returned; 0
+ *      means don't filter by version.
+ * \param[in,out] state
+ *      Holds the state of the scan; opaque to the caller. On the initial
+ *      call this Buffer should be empty. At the end of each call the
+ *      contents are modified to hold the current state of the scan.
+ * \param[out] objects
+ *      After a successful return, this buffer will contain zero or more
+ *      objects, in the same format as for enumerateTable. If zero objects
+ *      are returned, then there are no more objects remaining in the
+ *      tablet, and the return value points to the next tablet.
+ * \param maxPayloadBytes
+ *      Upper limit on the number of bytes of objects returned; 0 means
+ *      the largest amount the server will return in one RPC.
+ *
+ * \return
+ *      A key hash indicating where to continue the scan; it must be passed
+ *      to the next call to this method as the \a tabletFirstHash argument.
+ *      When no objects are returned and this is either zero or greater
+ *      than \a lastHash, the range has been completely scanned.
+ */
+uint64_t
+RamCloud::scanTable(uint64_t tableId, bool keysOnly,
+        uint64_t tabletFirstHash, uint64_t lastHash,
+        const void* keyPrefix, uint16_t keyPrefixLength,
+        uint64_t minVersion, Buffer& state, Buffer& objects,
+        uint32_t maxPayloadBytes)
+{
+    ScanTableRpc rpc(this, tableId, keysOnly, tabletFirstHash, lastHash,
+            keyPrefix, keyPrefixLength, minVersion, state, objects,
+            maxPayloadBytes);
+    return rpc.wait(state);
+}
+
+/**
+ * Constructor for ScanTableRpc: initiates an RPC in the same way as
+ * #RamCloud::scanTable, but returns once the RPC has been initiated,
+ * without waiting for it to complete.
+ *
+ * \param ramcloud
+ *      The RAMCloud object that governs this RPC.
+ * \param tableId
+ *      The table being scanned (return value from a previous call
+ *      to getTableId).
+ * \param keysOnly
+ *      False means that full objects are returned, containing both keys
+ *      and data. True means that the object data is omitted.
+ * \param tabletFirstHash
+ *      Where to continue the scan: the first key hash of the range in the
+ *      initial RPC, and the value returned by \c wait after that.
+ * \param lastHash
+ *      The largest key hash in the range being scanned.
+ * \param keyPrefix
+ *      If non-NULL, only objects whose primary keys start with these
+ *      bytes are returned. The caller must ensure that the storage for
+ *      the prefix is unchanged through the life of the RPC.
+ * \param keyPrefixLength
+ *      Number of bytes in \a keyPrefix.
+ * \param minVersion
+ *      Only objects with versions at least this large are returned; 0
+ *      means don't filter by version.
+ * \param state
+ *      Holds the state of the scan; opaque to the caller. On the initial
+ *      RPC this Buffer should be empty. In subsequent RPCs this must
+ *      contain the information returned by \c wait from the previous RPC.
+ * \param[out] objects
+ *      After a successful return, this buffer will contain zero or
+ *      more objects from the requested range.
+ * \param maxPayloadBytes
+ *      Upper limit on the number of bytes of objects returned; 0 means
+ *      the largest amount the server will return in one RPC.
+ */
+ScanTableRpc::ScanTableRpc(RamCloud* ramcloud, uint64_t tableId,
+        bool keysOnly, uint64_t tabletFirstHash, uint64_t lastHash,
+        const void* keyPrefix, uint16_t keyPrefixLength,
+        uint64_t minVersion, Buffer& state, Buffer& objects,
+        uint32_t maxPayloadBytes)
+    : ObjectRpcWrapper(ramcloud->clientContext, tableId, tabletFirstHash,
+            sizeof(WireFormat::Scan::Response), &objects)
+{
+    WireFormat::Scan::Request* reqHdr(allocHeader<WireFormat::Scan>());
+    reqHdr->tableId = tableId;
+    reqHdr->keysOnly = keysOnly;
+    reqHdr->tabletFirstHash = tabletFirstHash;
+    reqHdr->lastHash = lastHash;
+    reqHdr->minVersion = minVersion;
+    reqHdr->maxPayloadBytes = maxPayloadBytes;
+    reqHdr->keyPrefixLength = (keyPrefix == NULL) ? 0 : keyPrefixLength;
+    reqHdr->iteratorBytes = state.size();
+    if (reqHdr->keyPrefixLength > 0)
+        request.append(keyPrefix, keyPrefixLength);
+    for (Buffer::Iterator it(&state); !it.isDone(); it.next())
+        request.append(it.getData(), it.getLength());
+    send();
+}
+
+/**
+ * Wait for a scan RPC to complete, and return the same results as
+ * #RamCloud::scanTable.
+ *
+ * \param[out] state
+ *      Will be filled in with the current state of the scan as of this
+ *      method's return. Must be passed back to this class as the \a state
+ *      parameter to the constructor when retrieving the next objects.
+ * \return
+ *      A key hash indicating where to continue the scan; see
+ *      #RamCloud::scanTable.
+ */
+uint64_t
+ScanTableRpc::wait(Buffer& state)
+{
+    simpleWait(context);
+    const WireFormat::Scan::Response* respHdr(
+            getResponseHeader<WireFormat::Scan>());
+    uint64_t result = respHdr->tabletFirstHash;
+
+    uint32_t iteratorBytes = respHdr->iteratorBytes;
+    state.reset();
+    if (iteratorBytes != 0) {
+        response->copy(
+                downCast<uint32_t>(sizeof(*respHdr) + respHdr->payloadBytes),
+                iteratorBytes, state.alloc(iteratorBytes));
+    }
+
+    // Leave just the objects in the response buffer.
+    assert(response->size() == sizeof(*respHdr) +
+            respHdr->iteratorBytes + respHdr->payloadBytes);
+    response->truncateFront(sizeof(*respHdr));
+    response->truncate(response->size() - iteratorBytes);
+
+    return result;
+}
+
 /**
  * This RPCs used to invoke ServerControl on every server in the cluster; it
  * returns all of the responses. For more information on ServerControls, see
@@ -36,6 +36,8 @@ class MultiReadObject;
 class MultiRemoveObject;
 class MultiWriteObject;
 class ObjectFinder;
+class ReadBatcher;
+class ReadCache;
 class RpcTracker;
 
 /**
@@ -76,6 +78,8 @@ class RamCloud {
     void dropIndex(uint64_t tableId, uint8_t indexId);
     void echo(const char* serviceLocator, const void* message, uint32_t length,
          uint32_t echoLength, Buffer* reply = NULL);
+    void enableReadBatching(bool enable);
+    void enableReadCache(uint32_t maxObjects);
     uint64_t enumerateTable(uint64_t tableId, bool keysOnly,
          uint64_t tabletFirstHash, Buffer& state, Buffer& objects);
     void getLogMetrics(const char* serviceLocator,
@@ -130,6 +134,11 @@ class RamCloud {
             uint64_t* version = NULL, bool* objectExists = NULL);
     void remove(uint64_t tableId, const void* key, uint16_t keyLength,
             const RejectRules* rejectRules = NULL, uint64_t* version = NULL);
+    uint64_t scanTable(uint64_t tableId, bool keysOnly,
+            uint64_t tabletFirstHash, uint64_t lastHash,
+            const void* keyPrefix, uint16_t keyPrefixLength,
+            uint64_t minVersion, Buffer& state, Buffer& objects,
+            uint32_t maxPayloadBytes = 0);
     void serverControlAll(WireFormat::ControlOp controlOp,
             const void* inputData = NULL, uint32_t inputLength = 0,
             Buffer* outputData = NULL);
@@ -199,6 +208,14 @@ class RamCloud {
     RpcTracker *rpcTracker;
     ClientTransactionManager *transactionManager;
 
+    /// Caches objects returned by read; NULL unless enableReadCache has
+    /// been called.
+    ReadCache *readCache;
+
+    /// Combines asynchronous reads into MultiOp RPCs; NULL unless
+    /// enableReadBatching has been called.
+    ReadBatcher *readBatcher;
+
   private:
     DISALLOW_COPY_AND_ASSIGN(RamCloud);
 };
@@ -959,9 +976,11 @@ class ReadRpc : public ObjectRpcWrapper {
   public:
     ReadRpc(RamCloud* ramcloud, uint64_t tableId, const void* key,
             uint16_t keyLength, Buffer* value,
-            const RejectRules* rejectRules = NULL);
+            const RejectRules* rejectRules = NULL,
+            uint32_t leaseNanoseconds = 0);
     ~ReadRpc() {}
-    void wait(uint64_t* version = NULL, bool* objectExists = NULL);
+    void wait(uint64_t* version = NULL, bool* objectExists = NULL,
+            uint32_t* leaseNanoseconds = NULL);
 
   PRIVATE:
     DISALLOW_COPY_AND_ASSIGN(ReadRpc);
@@ -1015,6 +1034,25 @@ class ObjectServerControlRpc : public ObjectRpcWrapper {
     DISALLOW_COPY_AND_ASSIGN(ObjectServerControlRpc);
 };
 
+/**
+ * Encapsulates the state of a RamCloud::scanTable request, allowing it to
+ * execute asynchronously (TableScanner uses this to scan different parts
+ * of a table in parallel).
+ */
+class ScanTableRpc : public ObjectRpcWrapper {
+  public:
+    ScanTableRpc(RamCloud* ramcloud, uint64_t tableId, bool keysOnly,
+            uint64_t tabletFirstHash, uint64_t lastHash,
+            const void* keyPrefix, uint16_t keyPrefixLength,
+            uint64_t minVersion, Buffer& state, Buffer& objects,
+            uint32_t maxPayloadBytes = 0);
+    ~ScanTableRpc() {}
+    uint64_t wait(Buffer& state);
+
+  PRIVATE:
+    DISALLOW_COPY_AND_ASSIGN(ScanTableRpc);
+};
+
 /**
  * Encapsulates the state of a RamCloud::setRuntimeOption operation,
  * allowing it to execute asynchronously.
@@ -18,6 +18,7 @@
 #include "RawMetrics.h"
 #include "ServerMetrics.h"
 #include "RamCloud.h"
+#include "ReadCache.h"
 #include "TableEnumerator.h"
 
 namespace RAMCloud {
@@ -548,6 +549,34 @@ TEST_F(RamCloudTest, read_objectExists) {
             TableDoesntExistException);
 }
 
+TEST_F(RamCloudTest, read_cached) {
+    ramcloud->enableReadCache(10);
+    Buffer value;
+    uint64_t version;
+    bool objectExists = true;
+
+    ramcloud->read(tableId1, "0", 1, &value, NULL, &version, &objectExists);
+    EXPECT_FALSE(objectExists);
+    EXPECT_EQ(0U, ramcloud->readCache->size());
+
+    ramcloud->write(tableId1, "0", 1, "abcdef", 6);
+    ramcloud->read(tableId1, "0", 1, &value, NULL, &version, &objectExists);
+    EXPECT_TRUE(objectExists);
+    EXPECT_EQ(1U, ramcloud->readCache->size());
+
+    value.reset();
+    uint64_t cachedVersion;
+    objectExists = false;
+    ramcloud->read(tableId1, "0", 1, &value, NULL, &cachedVersion,
+            &objectExists);
+    EXPECT_EQ("abcdef", TestUtil::toString(&value));
+    EXPECT_EQ(version, cachedVersion);
+    EXPECT_TRUE(objectExists);
+
+    ramcloud->enableReadCache(0);
+    EXPECT_TRUE(ramcloud->readCache == NULL);
+}
+
 TEST_F(RamCloudTest, readKeysAndValue_objectExists) {
     ObjectBuffer keysAndValue;
     uint64_t version;
@@ -0,0 +1,466 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "ReadBatcher.h"
+#include "Cycles.h"
+#include "Object.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct a ReadBatcher.
+ *
+ * \param context
+ *      Overall information about the client; the batcher polls
+ *      context->dispatch.
+ */
+ReadBatcher::ReadBatcher(Context* context)
+    : Dispatch::Poller(context->dispatch, "ReadBatcher")
+    , context(context)
+    , sessions()
+    , roundTripCycles(0)
+{
+}
+
+/**
+ * Destructor for ReadBatcher. All ReadRpcs using the batcher must have been
+ * destroyed already.
+ */
+ReadBatcher::~ReadBatcher()
+{
+    sessions.clear();
+}
+
+/**
+ * Returns a session that ReadRpcs can use instead of a given session
+ * to a master; reads sent on it will be batched.
+ *
+ * \param session
+ *      Session to a master, as returned by the ObjectFinder.
+ */
+Transport::SessionRef
+ReadBatcher::getSession(Transport::SessionRef session)
+{
+    Transport::SessionRef& batchingSession = sessions[session->serviceLocator];
+    if (batchingSession) {
+        BatchingSession* previous =
+                static_cast<BatchingSession*>(batchingSession.get());
+        if (previous->session == session)
+            return batchingSession;
+
+        // The real session was replaced (for example, it was flushed after
+        // an error). Reads already queued on the old one won't be flushed
+        // by poll() once it's out of #sessions, so send them now.
+        previous->flush();
+    }
+    batchingSession = new BatchingSession(this, session);
+    return batchingSession;
+}
+
+/**
+ * This method is invoked by the dispatcher; it sends the reads that have
+ * waited long enough for a batch to fill.
+ *
+ * \return
+ *      1 if any reads were sent, 0 otherwise.
+ */
+int
+ReadBatcher::poll()
+{
+    uint64_t now = Cycles::rdtsc();
+    uint64_t maxDelay = Cycles::fromMicroseconds(MAX_DELAY_MICROS);
+    uint64_t delay = roundTripCycles/2;
+    if (delay > maxDelay)
+        delay = maxDelay;
+
+    // Flushing a session may remove it from #sessions (if the transport
+    // fails the batch immediately), so find the sessions first.
+    std::vector<Transport::SessionRef> ready;
+    for (auto& entry : sessions) {
+        BatchingSession* session =
+                static_cast<BatchingSession*>(entry.second.get());
+        if (session->queued.empty())
+            continue;
+        if (session->batches.empty() ||
+                now - session->oldestQueuedTime >= delay) {
+            ready.push_back(entry.second);
+        }
+    }
+    for (Transport::SessionRef& session : ready)
+        static_cast<BatchingSession*>(session.get())->flush();
+    return ready.empty() ? 0 : 1;
+}
+
+/**
+ * Fill in the response for a read in a batch and notify its RPC.
+ *
+ * \param read
+ *      The read that has finished; must not have been canceled.
+ * \param status
+ *      Status for the read.
+ * \param version
+ *      Version of the object (if status is STATUS_OK).
+ * \param value
+ *      Buffer containing the object's value.
+ * \param valueOffset
+ *      Offset of the value in \a value.
+ * \param valueLength
+ *      Length of the value in bytes.
+ */
+void
+ReadBatcher::finishRead(Read& read, Status status, uint64_t version,
+        Buffer* value, uint32_t valueOffset, uint32_t valueLength)
+{
+    read.response->reset();
+    WireFormat::Read::Response* respHdr =
+            read.response->emplaceAppend<WireFormat::Read::Response>();
+    memset(respHdr, 0, sizeof(*respHdr));
+    respHdr->common.status = status;
+    respHdr->version = version;
+    respHdr->length = valueLength;
+    if (valueLength > 0) {
+        value->copy(valueOffset, valueLength,
+                read.response->alloc(valueLength));
+    }
+    read.notifier->completed();
+}
+
+/**
+ * Update our estimate of the round-trip time for batches.
+ *
+ * \param cycles
+ *      Time taken by a batch that just completed.
+ */
+void
+ReadBatcher::recordRoundTrip(uint64_t cycles)
+{
+    if (roundTripCycles == 0)
+        roundTripCycles = cycles;
+    else
+        roundTripCycles = (7*roundTripCycles + cycles)/8;
+}
+
+/**
+ * Construct a Batch.
+ *
+ * \param session
+ *      Session on which the batch will be sent.
+ */
+ReadBatcher::Batch::Batch(BatchingSession* session)
+    : session(session)
+    , reads()
+    , request()
+    , response()
+    , startTime(0)
+{
+}
+
+// See Transport::RpcNotifier for documentation.
+void
+ReadBatcher::Batch::completed()
+{
+    session->batchCompleted(this);
+}
+
+// See Transport::RpcNotifier for documentation.
+void
+ReadBatcher::Batch::failed()
+{
+    session->batchFailed(this);
+}
+
+/**
+ * Construct a BatchingSession.
+ *
+ * \param batcher
+ *      The batcher that this session belongs to.
+ * \param session
+ *      The real session to the master.
+ */
+ReadBatcher::BatchingSession::BatchingSession(ReadBatcher* batcher,
+        Transport::SessionRef session)
+    : Session(session->serviceLocator)
+    , batcher(batcher)
+    , session(session)
+    , queued()
+    , oldestQueuedTime(0)
+    , batches()
+    , sent()
+{
+}
+
+/**
+ * Destructor for BatchingSession: cancels any batches still outstanding.
+ */
+ReadBatcher::BatchingSession::~BatchingSession()
+{
+    for (Batch* batch : batches) {
+        session->cancelRequest(batch);
+        delete batch;
+    }
+}
+
+// See Transport::Session for documentation. The request must be a READ
+// request.
+void
+ReadBatcher::BatchingSession::sendRequest(Buffer* request, Buffer* response,
+        Transport::RpcNotifier* notifier)
+{
+    if (queued.empty())
+        oldestQueuedTime = Cycles::rdtsc();
+    queued.emplace_back(request, response, notifier);
+    if (batches.empty() || queued.size() >= MAX_BATCH_OBJECTS)
+        flush();
+}
+
+// See Transport::Session for documentation.
+void
+ReadBatcher::BatchingSession::cancelRequest(Transport::RpcNotifier* notifier)
+{
+    for (std::deque<Read>::iterator it = queued.begin();
+            it != queued.end(); it++) {
+        if (it->notifier == notifier) {
+            queued.erase(it);
+            return;
+        }
+    }
+
+    std::unordered_map<Transport::RpcNotifier*, Batch*>::iterator it =
+            sent.find(notifier);
+    if (it == sent.end())
+        return;
+    Batch* batch = it->second;
+    sent.erase(it);
+    if (batch->request.size() == 0) {
+        // The read was sent by itself.
+        session->cancelRequest(batch);
+        batches.erase(batch);
+        delete batch;
+        return;
+    }
+
+    // The batch's response will be discarded for this read; in particular,
+    // it won't touch the read's buffers.
+    for (Read& read : batch->reads) {
+        if (read.notifier == notifier)
+            read.notifier = NULL;
+    }
+}
+
+// See Transport::Session for documentation.
+string
+ReadBatcher::BatchingSession::getRpcInfo()
+{
+    return session->getRpcInfo();
+}
+
+// See Transport::Session for documentation.
+void
+ReadBatcher::BatchingSession::abort()
+{
+    session->abort();
+}
+
+/**
+ * Invoked when the response for a batch has arrived: hands each read its
+ * part of the response.
+ *
+ * \param batch
+ *      The batch that completed; it is deleted.
+ */
+void
+ReadBatcher::BatchingSession::batchCompleted(Batch* batch)
+{
+    std::unique_ptr<Batch> _(batch);
+    batches.erase(batch);
+    batcher->recordRoundTrip(Cycles::rdtsc() - batch->startTime);
+
+    if (batch->request.size() == 0) {
+        // The read was sent by itself, and the response is already in
+        // the right place.
+        Read& read = batch->reads[0];
+        sent.erase(read.notifier);
+        read.notifier->completed();
+    } else {
+        Buffer* response = &batch->response;
+        const WireFormat::MultiOp::Response* respHdr =
+                response->getStart<WireFormat::MultiOp::Response>();
+        Status status = (respHdr == NULL) ? STATUS_RESPONSE_FORMAT_ERROR
+                : respHdr->common.status;
+        uint32_t count = (status == STATUS_OK) ? respHdr->count : 0;
+        uint32_t offset = sizeof32(WireFormat::MultiOp::Response);
+
+        // Reads that didn't fit in the response; they go back to the front
+        // of the queue.
+        std::vector<Read> unfinished;
+        for (uint32_t i = 0; i < batch->reads.size(); i++) {
+            Read& read = batch->reads[i];
+            if (read.notifier != NULL)
+                sent.erase(read.notifier);
+            if (status != STATUS_OK) {
+                if (read.notifier != NULL)
+                    finishRead(read, status, 0, NULL, 0, 0);
+                continue;
+            }
+            if (i >= count) {
+                if (read.notifier != NULL)
+                    unfinished.push_back(read);
+                continue;
+            }
+
+            const WireFormat::MultiOp::Response::ReadPart* part =
+                    response->getOffset<
+                    WireFormat::MultiOp::Response::ReadPart>(offset);
+            if (part == NULL || (part->status == STATUS_OK &&
+                    response->size() < offset + sizeof32(*part) +
+                    part->length)) {
+                // Malformed response; the rest of the reads can't be
+                // recovered.
+                status = STATUS_RESPONSE_FORMAT_ERROR;
+                if (read.notifier != NULL)
+                    finishRead(read, status, 0, NULL, 0, 0);
+                continue;
+            }
+            offset += sizeof32(*part);
+            if (read.notifier == NULL) {
+                // Canceled.
+                if (part->status == STATUS_OK)
+                    offset += part->length;
+                continue;
+            }
+            if (part->status != STATUS_OK) {
+                finishRead(read, part->status, part->version, NULL, 0, 0);
+                continue;
+            }
+
+            // The part holds the object's keys as well as its value; the
+            // READ response has just the value.
+            const WireFormat::Read::Request* readHdr =
+                    read.request->getStart<WireFormat::Read::Request>();
+            Object object(readHdr->tableId, part->version, 0, *response,
+                    offset, part->length);
+            uint32_t valueOffset = 0;
+            if (!object.getValueOffset(&valueOffset)) {
+                finishRead(read, STATUS_RESPONSE_FORMAT_ERROR, 0, NULL, 0, 0);
+            } else {
+                finishRead(read, STATUS_OK, part->version, response,
+                        offset + valueOffset, part->length - valueOffset);
+            }
+            offset += part->length;
+        }
+        if (!unfinished.empty()) {
+            queued.insert(queued.begin(), unfinished.begin(),
+                    unfinished.end());
+            oldestQueuedTime = batch->startTime;
+        }
+    }
+
+    if (!queued.empty())
+        flush();
+}
+
+/**
+ * Invoked when a batch fails because of a transport error: fails all of
+ * its reads (and any that are waiting to be sent) so that their RPCs will
+ * find a new session and retry.
+ *
+ * \param batch
+ *      The batch that failed; it is deleted.
+ */
+void
+ReadBatcher::BatchingSession::batchFailed(Batch* batch)
+{
+    // Dropping this session from the batcher could otherwise delete it
+    // before we're done.
+    Transport::SessionRef self(this);
+    std::unique_ptr<Batch> _(batch);
+    batches.erase(batch);
+
+    for (Read& read : batch->reads) {
+        if (read.notifier != NULL) {
+            sent.erase(read.notifier);
+            read.notifier->failed();
+        }
+    }
+    while (!queued.empty()) {
+        Read read = queued.front();
+        queued.pop_front();
+        read.notifier->failed();
+    }
+
+    // The real session is probably dead; the RPCs will get a new one
+    // when they retry.
+    std::unordered_map<string, Transport::SessionRef>::iterator it =
+            batcher->sessions.find(serviceLocator);
+    if (it != batcher->sessions.end() && it->second.get() == this)
+        batcher->sessions.erase(it);
+}
+
+/**
+ * Send the reads at the front of #queued as a batch.
+ */
+void
+ReadBatcher::BatchingSession::flush()
+{
+    if (queued.empty())
+        return;
+    Batch* batch = new Batch(this);
+    if (queued.size() == 1) {
+        batch->reads.push_back(queued.front());
+        queued.pop_front();
+    } else {
+        WireFormat::MultiOp::Request* reqHdr = batch->request.emplaceAppend<
+                WireFormat::MultiOp::Request>();
+        memset(reqHdr, 0, sizeof(*reqHdr));
+        reqHdr->common.opcode = WireFormat::MultiOp::opcode;
+        reqHdr->common.service = WireFormat::MultiOp::service;
+        reqHdr->type = WireFormat::MultiOp::READ;
+        while (!queued.empty() && batch->reads.size() < MAX_BATCH_OBJECTS) {
+            Read& read = queued.front();
+            const WireFormat::Read::Request* readHdr =
+                    read.request->getStart<WireFormat::Read::Request>();
+            uint32_t partLength =
+                    sizeof32(WireFormat::MultiOp::Request::ReadPart) +
+                    readHdr->keyLength;
+            if (!batch->reads.empty() &&
+                    batch->request.size() + partLength > MAX_REQUEST_SIZE)
+                break;
+            batch->request.emplaceAppend<
+                    WireFormat::MultiOp::Request::ReadPart>(
+                    readHdr->tableId, readHdr->keyLength,
+                    readHdr->rejectRules);
+            read.request->copy(sizeof32(*readHdr), readHdr->keyLength,
+                    batch->request.alloc(readHdr->keyLength));
+            batch->reads.push_back(read);
+            queued.pop_front();
+        }
+        reqHdr->count = downCast<uint32_t>(batch->reads.size());
+    }
+
+    // Finish all bookkeeping before sending: the transport may invoke the
+    // batch's completed or failed method before sendRequest returns.
+    batches.insert(batch);
+    for (Read& read : batch->reads)
+        sent[read.notifier] = batch;
+    batch->startTime = Cycles::rdtsc();
+    if (batch->request.size() == 0) {
+        session->sendRequest(batch->reads[0].request,
+                batch->reads[0].response, batch);
+    } else {
+        session->sendRequest(&batch->request, &batch->response, batch);
+    }
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,184 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_READBATCHER_H
+#define RAMCLOUD_READBATCHER_H
+
+#include <deque>
+#include <set>
+#include <unordered_map>
+
+#include "Common.h"
+#include "Dispatch.h"
+#include "Transport.h"
+#include "WireFormat.h"
+
+namespace RAMCloud {
+
+/**
+ * A ReadBatcher combines independent single-object reads (ReadRpcs) that
+ * are headed for the same master into MultiOp READ requests, so clients that
+ * issue many unrelated asynchronous reads pay the per-RPC overhead once per
+ * batch instead of once per object. It is enabled with
+ * RamCloud::enableReadBatching; callers keep using ReadRpc as before.
+ *
+ * Batching is adaptive, in the style of Nagle's algorithm: if no batch is
+ * outstanding to a master, a read is sent right away as an ordinary READ
+ * RPC, so lightly loaded clients see no extra latency. Otherwise it waits
+ * until the outstanding batch completes, MAX_BATCH_OBJECTS reads have
+ * accumulated, or it has waited half of the round-trip time observed for
+ * recent batches (but no more than MAX_DELAY_MICROS), whichever comes first.
+ *
+ * The batcher works by handing ReadRpcs a wrapper Session for the master;
+ * the wrapper splits each MultiOp response back into ordinary READ responses
+ * so the RPCs' retry logic (unknown tablets, STATUS_RETRY, transport
+ * failures) works unchanged.
+ *
+ * This class is not thread-safe: it must only be used in the dispatch thread
+ * (which is the case for ordinary clients).
+ */
+class ReadBatcher : public Dispatch::Poller {
+  PUBLIC:
+    explicit ReadBatcher(Context* context);
+    ~ReadBatcher();
+
+    Transport::SessionRef getSession(Transport::SessionRef session);
+    virtual int poll();
+
+    /// Largest number of reads combined into a single MultiOp RPC.
+    static const uint32_t MAX_BATCH_OBJECTS = 32;
+
+    /// Longest time a read will wait for other reads to join its batch.
+    static const uint32_t MAX_DELAY_MICROS = 20;
+
+  PRIVATE:
+    class BatchingSession;
+
+    /**
+     * A single READ request, as given to BatchingSession::sendRequest.
+     */
+    struct Read {
+        Read(Buffer* request, Buffer* response,
+                Transport::RpcNotifier* notifier)
+            : request(request)
+            , response(response)
+            , notifier(notifier)
+        {}
+
+        /// READ request; starts with a WireFormat::Read::Request.
+        Buffer* request;
+
+        /// Where to put the READ response.
+        Buffer* response;
+
+        /// Notified when the response is ready; NULL means the read has
+        /// been canceled.
+        Transport::RpcNotifier* notifier;
+    };
+
+    /**
+     * One RPC sent to a master on behalf of one or more reads. A batch
+     * holding a single read is sent as that read's own request; larger
+     * batches are sent as MultiOp requests.
+     */
+    class Batch : public Transport::RpcNotifier {
+      public:
+        explicit Batch(BatchingSession* session);
+        virtual ~Batch() {}
+        virtual void completed();
+        virtual void failed();
+
+        /// Session on which this batch was sent.
+        BatchingSession* session;
+
+        /// The reads in this batch, in the order of the request's parts.
+        std::vector<Read> reads;
+
+        /// MultiOp request and response (unused for a single read).
+        Buffer request;
+        Buffer response;
+
+        /// Cycles::rdtsc() time when the batch was sent.
+        uint64_t startTime;
+
+        DISALLOW_COPY_AND_ASSIGN(Batch);
+    };
+
+    /**
+     * Wraps a session to a master: READ requests sent on this session
+     * are combined into batches before being sent on the real session.
+     */
+    class BatchingSession : public Transport::Session {
+      public:
+        BatchingSession(ReadBatcher* batcher, Transport::SessionRef session);
+        ~BatchingSession();
+        virtual void sendRequest(Buffer* request, Buffer* response,
+                Transport::RpcNotifier* notifier);
+        virtual void cancelRequest(Transport::RpcNotifier* notifier);
+        virtual string getRpcInfo();
+        virtual void abort();
+
+        void batchCompleted(Batch* batch);
+        void batchFailed(Batch* batch);
+        void flush();
+
+        /// The batcher that owns this session.
+        ReadBatcher* batcher;
+
+        /// The real session to the master.
+        Transport::SessionRef session;
+
+        /// Reads that haven't been sent yet, oldest first.
+        std::deque<Read> queued;
+
+        /// Cycles::rdtsc() time when the oldest read in #queued arrived.
+        uint64_t oldestQueuedTime;
+
+        /// Batches that have been sent but haven't completed.
+        std::set<Batch*> batches;
+
+        /// Maps the notifier of each read in #batches to its batch.
+        std::unordered_map<Transport::RpcNotifier*, Batch*> sent;
+
+        DISALLOW_COPY_AND_ASSIGN(BatchingSession);
+    };
+
+    static void finishRead(Read& read, Status status, uint64_t version,
+            Buffer* value, uint32_t valueOffset, uint32_t valueLength);
+    void recordRoundTrip(uint64_t cycles);
+
+    /// Used to find the dispatcher for our poller.
+    Context* context;
+
+    /// Maps the service locator of each master we've sent reads to to the
+    /// BatchingSession for the most recent real session to it. Entries are
+    /// replaced when the real session changes and dropped when it fails, so
+    /// the map doesn't grow as sessions come and go; RPCs still using an
+    /// older BatchingSession keep it alive until they are done with it.
+    std::unordered_map<string, Transport::SessionRef> sessions;
+
+    /// Running average of the round-trip time for batches, in cycles.
+    uint64_t roundTripCycles;
+
+    /// The largest MultiOp request that we will send, in bytes.
+    static const uint32_t MAX_REQUEST_SIZE = Transport::MAX_RPC_LEN -
+            sizeof(WireFormat::MultiOp::Request);
+
+    DISALLOW_COPY_AND_ASSIGN(ReadBatcher);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_READBATCHER_H
@@ -0,0 +1,352 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "Cycles.h"
+#include "MockTransport.h"
+#include "MockWrapper.h"
+#include "Object.h"
+#include "ReadBatcher.h"
+
+namespace RAMCloud {
+
+class ReadBatcherTest : public ::testing::Test {
+  public:
+    Context context;
+    MockTransport transport;
+    ServiceLocator locator;
+    Transport::SessionRef session;
+    ReadBatcher batcher;
+    Transport::SessionRef batchingSession;
+    MockWrapper a, b, c;
+
+    ReadBatcherTest()
+        : context()
+        , transport(&context)
+        , locator("mock:host=master")
+        , session(transport.getSession(&locator))
+        , batcher(&context)
+        , batchingSession(batcher.getSession(session))
+        , a()
+        , b()
+        , c()
+    {
+        fillRequest(&a, "a");
+        fillRequest(&b, "b");
+        fillRequest(&c, "c");
+    }
+
+    /// Make a wrapper's request a READ for a given key in table 1.
+    void
+    fillRequest(MockWrapper* wrapper, const char* key)
+    {
+        WireFormat::Read::Request* reqHdr =
+                wrapper->request.emplaceAppend<WireFormat::Read::Request>();
+        memset(reqHdr, 0, sizeof(*reqHdr));
+        reqHdr->common.opcode = WireFormat::Read::opcode;
+        reqHdr->tableId = 1;
+        reqHdr->keyLength = downCast<uint16_t>(strlen(key));
+        wrapper->request.appendCopy(key, reqHdr->keyLength);
+    }
+
+    void
+    send(MockWrapper* wrapper)
+    {
+        batchingSession->sendRequest(&wrapper->request, &wrapper->response,
+                wrapper);
+    }
+
+    /// Returns the most recently sent batch.
+    ReadBatcher::Batch*
+    lastBatch()
+    {
+        return static_cast<ReadBatcher::Batch*>(transport.lastNotifier);
+    }
+
+    ReadBatcher::BatchingSession*
+    getBatchingSession()
+    {
+        return static_cast<ReadBatcher::BatchingSession*>(
+                batchingSession.get());
+    }
+
+    /// Add the part for one object to a MultiOp response.
+    void
+    appendPart(Buffer* response, Status status, const char* key,
+            const char* value)
+    {
+        WireFormat::MultiOp::Response::ReadPart* part =
+                response->emplaceAppend<
+                WireFormat::MultiOp::Response::ReadPart>();
+        part->status = status;
+        part->version = 7;
+        part->length = 0;
+        if (status == STATUS_OK) {
+            Key objectKey(1, key, downCast<uint16_t>(strlen(key)));
+            uint32_t start = response->size();
+            Object::appendKeysAndValueToBuffer(objectKey, value,
+                    downCast<uint32_t>(strlen(value)), response, true);
+            part->length = response->size() - start;
+        }
+    }
+
+    /// Start a MultiOp response for a given number of objects.
+    void
+    startResponse(Buffer* response, uint32_t count)
+    {
+        WireFormat::MultiOp::Response* respHdr =
+                response->emplaceAppend<WireFormat::MultiOp::Response>();
+        respHdr->common.status = STATUS_OK;
+        respHdr->count = count;
+    }
+
+    /// Return the status and value in a READ response.
+    string
+    readResponse(MockWrapper* wrapper)
+    {
+        const WireFormat::Read::Response* respHdr =
+                wrapper->response.getStart<WireFormat::Read::Response>();
+        if (respHdr == NULL)
+            return "no response";
+        string value(TestUtil::toString(&wrapper->response,
+                sizeof32(*respHdr), respHdr->length));
+        return format("%s, version %lu, value \"%s\"",
+                statusToSymbol(respHdr->common.status), respHdr->version,
+                value.c_str());
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(ReadBatcherTest);
+};
+
+TEST_F(ReadBatcherTest, getSession) {
+    EXPECT_EQ(batchingSession.get(), batcher.getSession(session).get());
+    ServiceLocator other("mock:host=other");
+    Transport::SessionRef otherSession = transport.getSession(&other);
+    EXPECT_NE(batchingSession.get(), batcher.getSession(otherSession).get());
+    EXPECT_EQ(2U, batcher.sessions.size());
+}
+
+TEST_F(ReadBatcherTest, getSession_realSessionReplaced) {
+    send(&a);
+    send(&b);
+    EXPECT_EQ(1U, getBatchingSession()->queued.size());
+
+    Transport::SessionRef newSession = transport.getSession(&locator);
+    Transport::SessionRef newBatchingSession = batcher.getSession(newSession);
+    EXPECT_NE(batchingSession.get(), newBatchingSession.get());
+    EXPECT_EQ(newBatchingSession.get(), batcher.getSession(newSession).get());
+    EXPECT_EQ(1U, batcher.sessions.size());
+    // Reads queued on the old session were sent.
+    EXPECT_EQ(0U, getBatchingSession()->queued.size());
+    EXPECT_EQ(2U, getBatchingSession()->batches.size());
+
+    // Failures on the old session don't drop the new one.
+    lastBatch()->failed();
+    EXPECT_EQ(1U, batcher.sessions.size());
+}
+
+TEST_F(ReadBatcherTest, poll) {
+    Cycles::mockTscValue = 1000;
+    send(&a);
+    send(&b);
+    EXPECT_EQ(1U, getBatchingSession()->queued.size());
+
+    // Round trips are slow, so wait for the batch to fill.
+    batcher.roundTripCycles = 600;
+    Cycles::mockTscValue = 1200;
+    EXPECT_EQ(0, batcher.poll());
+    Cycles::mockTscValue = 1300;
+    EXPECT_EQ(1, batcher.poll());
+    EXPECT_EQ(0U, getBatchingSession()->queued.size());
+    EXPECT_EQ(2U, getBatchingSession()->batches.size());
+    EXPECT_EQ(0, batcher.poll());
+    Cycles::mockTscValue = 0;
+}
+
+TEST_F(ReadBatcherTest, poll_noBatchOutstanding) {
+    send(&a);
+    send(&b);
+    getBatchingSession()->cancelRequest(&a);
+    batcher.roundTripCycles = ~0UL;
+    EXPECT_EQ(1, batcher.poll());
+    EXPECT_EQ(0U, getBatchingSession()->queued.size());
+}
+
+TEST_F(ReadBatcherTest, recordRoundTrip) {
+    batcher.recordRoundTrip(800);
+    EXPECT_EQ(800U, batcher.roundTripCycles);
+    batcher.recordRoundTrip(1600);
+    EXPECT_EQ(900U, batcher.roundTripCycles);
+}
+
+TEST_F(ReadBatcherTest, cancelRequest) {
+    send(&a);
+    send(&b);
+    send(&c);
+    getBatchingSession()->cancelRequest(&c);
+    EXPECT_EQ(1U, getBatchingSession()->queued.size());
+
+    transport.outputLog.clear();
+    getBatchingSession()->cancelRequest(&a);
+    EXPECT_EQ("cancel: ", transport.outputLog);
+    EXPECT_EQ(0U, getBatchingSession()->batches.size());
+    EXPECT_EQ(0U, getBatchingSession()->sent.size());
+
+    getBatchingSession()->cancelRequest(&a);
+    EXPECT_EQ("cancel: ", transport.outputLog);
+}
+
+TEST_F(ReadBatcherTest, batchCompleted_singleRead) {
+    send(&a);
+    send(&b);
+    send(&c);
+    EXPECT_EQ(1U, lastBatch()->reads.size());
+    EXPECT_EQ(0U, lastBatch()->request.size());
+    a.response.fillFromString("abc");
+    lastBatch()->completed();
+    EXPECT_STREQ("completed: 1, failed: 0", a.getState());
+    EXPECT_EQ("abc/0", TestUtil::toString(&a.response));
+
+    // The queued reads go out together.
+    EXPECT_EQ(2U, lastBatch()->reads.size());
+    EXPECT_EQ(1U, getBatchingSession()->batches.size());
+    EXPECT_EQ(2U, getBatchingSession()->sent.size());
+    const WireFormat::MultiOp::Request* reqHdr = lastBatch()->request.
+            getStart<WireFormat::MultiOp::Request>();
+    EXPECT_EQ(WireFormat::MULTI_OP, reqHdr->common.opcode);
+    EXPECT_EQ(WireFormat::MultiOp::READ, reqHdr->type);
+    EXPECT_EQ(2U, reqHdr->count);
+}
+
+TEST_F(ReadBatcherTest, batchCompleted_multiOp) {
+    send(&a);
+    send(&b);
+    send(&c);
+    lastBatch()->completed();
+    ReadBatcher::Batch* batch = lastBatch();
+    startResponse(&batch->response, 2);
+    appendPart(&batch->response, STATUS_OK, "b", "value");
+    appendPart(&batch->response, STATUS_OBJECT_DOESNT_EXIST, "c", NULL);
+    batch->completed();
+    EXPECT_STREQ("completed: 1, failed: 0", b.getState());
+    EXPECT_EQ("STATUS_OK, version 7, value \"value\"", readResponse(&b));
+    EXPECT_STREQ("completed: 1, failed: 0", c.getState());
+    EXPECT_EQ("STATUS_OBJECT_DOESNT_EXIST, version 7, value \"\"",
+            readResponse(&c));
+    EXPECT_EQ(0U, getBatchingSession()->batches.size());
+    EXPECT_EQ(0U, getBatchingSession()->sent.size());
+}
+
+TEST_F(ReadBatcherTest, batchCompleted_errorStatus) {
+    send(&a);
+    send(&b);
+    send(&c);
+    lastBatch()->completed();
+    ReadBatcher::Batch* batch = lastBatch();
+    startResponse(&batch->response, 0);
+    const_cast<WireFormat::MultiOp::Response*>(batch->response.getStart<
+            WireFormat::MultiOp::Response>())->common.status =
+            STATUS_UNKNOWN_TABLET;
+    batch->completed();
+    EXPECT_EQ("STATUS_UNKNOWN_TABLET, version 0, value \"\"",
+            readResponse(&b));
+    EXPECT_EQ("STATUS_UNKNOWN_TABLET, version 0, value \"\"",
+            readResponse(&c));
+}
+
+TEST_F(ReadBatcherTest, batchCompleted_truncatedResponse) {
+    send(&a);
+    send(&b);
+    send(&c);
+    lastBatch()->completed();
+    ReadBatcher::Batch* batch = lastBatch();
+    startResponse(&batch->response, 1);
+    appendPart(&batch->response, STATUS_OK, "b", "value");
+    batch->completed();
+    EXPECT_STREQ("completed: 1, failed: 0", b.getState());
+    EXPECT_STREQ("completed: 0, failed: 0", c.getState());
+
+    // c was sent again by itself.
+    EXPECT_EQ(1U, lastBatch()->reads.size());
+    EXPECT_EQ(&c, lastBatch()->reads[0].notifier);
+}
+
+TEST_F(ReadBatcherTest, batchCompleted_canceledRead) {
+    send(&a);
+    send(&b);
+    send(&c);
+    lastBatch()->completed();
+    getBatchingSession()->cancelRequest(&b);
+    ReadBatcher::Batch* batch = lastBatch();
+    startResponse(&batch->response, 2);
+    appendPart(&batch->response, STATUS_OK, "b", "value");
+    appendPart(&batch->response, STATUS_OK, "c", "xyz");
+    batch->completed();
+    EXPECT_STREQ("completed: 0, failed: 0", b.getState());
+    EXPECT_EQ(0U, b.response.size());
+    EXPECT_EQ("STATUS_OK, version 7, value \"xyz\"", readResponse(&c));
+}
+
+TEST_F(ReadBatcherTest, batchCompleted_malformedResponse) {
+    send(&a);
+    send(&b);
+    send(&c);
+    lastBatch()->completed();
+    ReadBatcher::Batch* batch = lastBatch();
+    startResponse(&batch->response, 2);
+    appendPart(&batch->response, STATUS_OK, "b", "value");
+    batch->response.appendCopy("xx", 2);
+    batch->completed();
+    EXPECT_EQ("STATUS_OK, version 7, value \"value\"", readResponse(&b));
+    EXPECT_EQ("STATUS_RESPONSE_FORMAT_ERROR, version 0, value \"\"",
+            readResponse(&c));
+}
+
+TEST_F(ReadBatcherTest, batchFailed) {
+    send(&a);
+    send(&b);
+    lastBatch()->failed();
+    EXPECT_STREQ("completed: 0, failed: 1", a.getState());
+    EXPECT_STREQ("completed: 0, failed: 1", b.getState());
+    EXPECT_EQ(0U, getBatchingSession()->batches.size());
+    EXPECT_EQ(0U, getBatchingSession()->queued.size());
+    EXPECT_EQ(0U, batcher.sessions.size());
+}
+
+TEST_F(ReadBatcherTest, flush_batchFull) {
+    send(&a);
+    MockWrapper others[ReadBatcher::MAX_BATCH_OBJECTS + 1];
+    for (MockWrapper& wrapper : others)
+        fillRequest(&wrapper, "key");
+    for (uint32_t i = 0; i < ReadBatcher::MAX_BATCH_OBJECTS - 1; i++)
+        send(&others[i]);
+    EXPECT_EQ(31U, getBatchingSession()->queued.size());
+    send(&others[31]);
+    EXPECT_EQ(0U, getBatchingSession()->queued.size());
+    EXPECT_EQ(32U, lastBatch()->reads.size());
+    EXPECT_EQ(32U, lastBatch()->request.getStart<
+            WireFormat::MultiOp::Request>()->count);
+    send(&others[32]);
+    EXPECT_EQ(1U, getBatchingSession()->queued.size());
+}
+
+TEST_F(ReadBatcherTest, flush_transportFailsImmediately) {
+    transport.setInput(NULL);
+    send(&a);
+    EXPECT_STREQ("completed: 0, failed: 1", a.getState());
+    EXPECT_EQ(0U, batcher.sessions.size());
+}
+
+} // namespace RAMCloud
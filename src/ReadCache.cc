@@ -0,0 +1,135 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "ReadCache.h"
+#include "Cycles.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct an empty ReadCache.
+ *
+ * \param maxObjects
+ *      Largest number of objects the cache will hold.
+ */
+ReadCache::ReadCache(uint32_t maxObjects)
+    : mutex("ReadCache::mutex")
+    , entries()
+    , lru()
+    , maxObjects(maxObjects)
+{
+}
+
+/**
+ * Return a cached object, if its lease hasn't expired.
+ *
+ * \param tableId
+ *      Table containing the object.
+ * \param key
+ *      Primary key of the object.
+ * \param keyLength
+ *      Size in bytes of the key.
+ * \param[out] value
+ *      If the object is found, this Buffer is reset and filled with the
+ *      object's value.
+ * \param[out] version
+ *      If non-NULL and the object is found, its version is returned here.
+ * \return
+ *      True if the object was found in the cache.
+ */
+bool
+ReadCache::lookup(uint64_t tableId, const void* key, uint16_t keyLength,
+                  Buffer* value, uint64_t* version)
+{
+    SpinLock::Guard lock(mutex);
+    EntryMap::iterator it = entries.find(CacheKey(tableId,
+            string(static_cast<const char*>(key), keyLength)));
+    if (it == entries.end())
+        return false;
+    Entry& entry = it->second;
+    if (Cycles::rdtsc() >= entry.expiration) {
+        erase(lock, it);
+        return false;
+    }
+
+    value->reset();
+    value->appendCopy(entry.value.data(),
+            downCast<uint32_t>(entry.value.size()));
+    if (version != NULL)
+        *version = entry.version;
+    lru.splice(lru.begin(), lru, entry.lruPosition);
+    return true;
+}
+
+/**
+ * Add an object to the cache (or replace the cached copy), discarding the
+ * least recently used object if the cache is full.
+ *
+ * \param tableId
+ *      Table containing the object.
+ * \param key
+ *      Primary key of the object.
+ * \param keyLength
+ *      Size in bytes of the key.
+ * \param value
+ *      Value of the object, as returned by the master.
+ * \param version
+ *      Version of the object.
+ * \param expiration
+ *      Cycles::rdtsc() time at which the lease on the object runs out.
+ */
+void
+ReadCache::insert(uint64_t tableId, const void* key, uint16_t keyLength,
+                  Buffer* value, uint64_t version, uint64_t expiration)
+{
+    if (maxObjects == 0)
+        return;
+    SpinLock::Guard lock(mutex);
+    CacheKey cacheKey(tableId, string(static_cast<const char*>(key),
+            keyLength));
+    EntryMap::iterator it = entries.find(cacheKey);
+    if (it == entries.end()) {
+        while (entries.size() >= maxObjects)
+            erase(lock, entries.find(lru.back()));
+        lru.push_front(cacheKey);
+        it = entries.insert({cacheKey, Entry()}).first;
+        it->second.lruPosition = lru.begin();
+    } else {
+        lru.splice(lru.begin(), lru, it->second.lruPosition);
+    }
+
+    Entry& entry = it->second;
+    entry.value.resize(value->size());
+    value->copy(0, value->size(), &entry.value[0]);
+    entry.version = version;
+    entry.expiration = expiration;
+}
+
+/**
+ * Remove an object from the cache.
+ *
+ * \param lock
+ *      Ensures that the caller holds the monitor lock.
+ * \param it
+ *      Identifies the object to remove.
+ */
+void
+ReadCache::erase(const SpinLock::Guard& lock, EntryMap::iterator it)
+{
+    lru.erase(it->second.lruPosition);
+    entries.erase(it);
+}
+
+} // namespace RAMCloud
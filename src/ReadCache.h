@@ -0,0 +1,114 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_READCACHE_H
+#define RAMCLOUD_READCACHE_H
+
+#include <list>
+#include <map>
+
+#include "Common.h"
+#include "Buffer.h"
+#include "SpinLock.h"
+
+namespace RAMCloud {
+
+/**
+ * A ReadCache holds recently read objects on a client so that repeated
+ * RamCloud::read calls for hot objects can be answered without contacting
+ * the master. Each object is cached under a short lease granted by its
+ * master (see ReadLeaseTable): the master won't modify the object until
+ * the lease expires, so a cached object is never stale. Once the lease has
+ * expired, the next read goes to the master again (and may be granted a new
+ * lease).
+ *
+ * The lease's expiration is computed from the time the read was issued,
+ * which is never later than the time the master granted it, so the client
+ * stops using an object no later than the master allows writes to it (this
+ * assumes clocks on different machines run at the same rate over the length
+ * of a lease).
+ *
+ * When the cache is full, the least recently used object is discarded.
+ *
+ * This class is thread-safe.
+ */
+class ReadCache {
+  PUBLIC:
+    explicit ReadCache(uint32_t maxObjects);
+
+    bool lookup(uint64_t tableId, const void* key, uint16_t keyLength,
+                Buffer* value, uint64_t* version);
+    void insert(uint64_t tableId, const void* key, uint16_t keyLength,
+                Buffer* value, uint64_t version, uint64_t expiration);
+
+    /// Number of objects currently cached (some may have expired).
+    size_t size()
+    {
+        SpinLock::Guard _(mutex);
+        return entries.size();
+    }
+
+    /// Length of the lease to ask the master for on each read.
+    static const uint32_t LEASE_NANOSECONDS = 1000000;
+
+  PRIVATE:
+    /// Identifies a cached object: (tableId, primary key).
+    typedef std::pair<uint64_t, string> CacheKey;
+
+    /**
+     * A cached object.
+     */
+    struct Entry {
+        Entry()
+            : value()
+            , version(0)
+            , expiration(0)
+            , lruPosition()
+        {}
+
+        /// Value of the object.
+        string value;
+
+        /// Version of the object.
+        uint64_t version;
+
+        /// Cycles::rdtsc() time at which the lease on this object runs out.
+        uint64_t expiration;
+
+        /// This entry's position in #lru.
+        std::list<CacheKey>::iterator lruPosition;
+    };
+    typedef std::map<CacheKey, Entry> EntryMap;
+
+    void erase(const SpinLock::Guard& lock, EntryMap::iterator it);
+
+    /// Monitor-style lock protecting all of the fields below.
+    SpinLock mutex;
+
+    /// Cached objects.
+    EntryMap entries;
+
+    /// Keys of the cached objects, most recently used first.
+    std::list<CacheKey> lru;
+
+    /// The cache never holds more than this many objects.
+    uint32_t maxObjects;
+
+    DISALLOW_COPY_AND_ASSIGN(ReadCache);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_READCACHE_H
@@ -0,0 +1,99 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "Cycles.h"
+#include "ReadCache.h"
+
+namespace RAMCloud {
+
+class ReadCacheTest : public ::testing::Test {
+  public:
+    ReadCache cache;
+    Buffer value;
+    Buffer out;
+
+    ReadCacheTest()
+        : cache(2)
+        , value()
+        , out()
+    {
+        Cycles::mockTscValue = 1000;
+        value.appendCopy("abcde", 5);
+    }
+
+    ~ReadCacheTest()
+    {
+        Cycles::mockTscValue = 0;
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(ReadCacheTest);
+};
+
+TEST_F(ReadCacheTest, lookup) {
+    uint64_t version = 0;
+    EXPECT_FALSE(cache.lookup(1, "a", 1, &out, &version));
+
+    cache.insert(1, "a", 1, &value, 7, 2000);
+    out.appendCopy("junk", 4);
+    EXPECT_TRUE(cache.lookup(1, "a", 1, &out, &version));
+    EXPECT_EQ("abcde", TestUtil::toString(&out));
+    EXPECT_EQ(7U, version);
+    EXPECT_TRUE(cache.lookup(1, "a", 1, &out, NULL));
+
+    // Different table or key.
+    EXPECT_FALSE(cache.lookup(2, "a", 1, &out, &version));
+    EXPECT_FALSE(cache.lookup(1, "ab", 2, &out, &version));
+}
+
+TEST_F(ReadCacheTest, lookup_expired) {
+    cache.insert(1, "a", 1, &value, 7, 2000);
+    Cycles::mockTscValue = 2000;
+    EXPECT_FALSE(cache.lookup(1, "a", 1, &out, NULL));
+    EXPECT_EQ(0U, cache.size());
+}
+
+TEST_F(ReadCacheTest, insert_replace) {
+    cache.insert(1, "a", 1, &value, 7, 2000);
+    Buffer newValue;
+    newValue.appendCopy("xy", 2);
+    cache.insert(1, "a", 1, &newValue, 8, 3000);
+    EXPECT_EQ(1U, cache.size());
+
+    uint64_t version;
+    Cycles::mockTscValue = 2500;
+    EXPECT_TRUE(cache.lookup(1, "a", 1, &out, &version));
+    EXPECT_EQ("xy", TestUtil::toString(&out));
+    EXPECT_EQ(8U, version);
+}
+
+TEST_F(ReadCacheTest, insert_evictLeastRecentlyUsed) {
+    cache.insert(1, "a", 1, &value, 1, 2000);
+    cache.insert(1, "b", 1, &value, 2, 2000);
+    EXPECT_TRUE(cache.lookup(1, "a", 1, &out, NULL));
+    cache.insert(1, "c", 1, &value, 3, 2000);
+    EXPECT_EQ(2U, cache.size());
+    EXPECT_TRUE(cache.lookup(1, "a", 1, &out, NULL));
+    EXPECT_FALSE(cache.lookup(1, "b", 1, &out, NULL));
+    EXPECT_TRUE(cache.lookup(1, "c", 1, &out, NULL));
+}
+
+TEST_F(ReadCacheTest, insert_disabled) {
+    ReadCache empty(0);
+    empty.insert(1, "a", 1, &value, 1, 2000);
+    EXPECT_EQ(0U, empty.size());
+}
+
+}  // namespace RAMCloud
@@ -0,0 +1,154 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "ReadLeaseTable.h"
+#include "Cycles.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct an empty ReadLeaseTable.
+ */
+ReadLeaseTable::ReadLeaseTable()
+    : mutex("ReadLeaseTable::mutex")
+    , leases()
+    , latestExpiration(0)
+{
+}
+
+/**
+ * Grant a lease on an object that is about to be returned to a client,
+ * promising not to modify the object until the lease expires. The caller
+ * must hold the object's HashTableBucketLock.
+ *
+ * \param key
+ *      Key of the object being read.
+ * \param requestedNanoseconds
+ *      Length of the lease the client asked for.
+ * \return
+ *      Length of the lease granted in nanoseconds, measured from the time
+ *      of this call; at most MAX_LEASE_NANOSECONDS. 0 means no lease was
+ *      granted (none was requested, a write to the object is waiting, or
+ *      the table is full) and the client must not cache the object.
+ */
+uint32_t
+ReadLeaseTable::grant(Key& key, uint32_t requestedNanoseconds)
+{
+    if (requestedNanoseconds == 0)
+        return 0;
+    uint32_t granted = requestedNanoseconds;
+    if (granted > MAX_LEASE_NANOSECONDS)
+        granted = MAX_LEASE_NANOSECONDS;
+
+    SpinLock::Guard lock(mutex);
+    uint64_t now = Cycles::rdtsc();
+    LeaseMap::iterator it = leases.find(key.getHash());
+    if (it != leases.end()) {
+        Lease& lease = it->second;
+        if (lease.writePending) {
+            if (now < lease.expiration +
+                    Cycles::fromNanoseconds(WRITE_PENDING_NANOSECONDS))
+                return 0;
+            // The writer seems to have given up.
+            lease.writePending = false;
+        }
+    } else {
+        if (leases.size() >= MAX_LEASES) {
+            prune(lock, now);
+            if (leases.size() >= MAX_LEASES)
+                return 0;
+        }
+        it = leases.insert({key.getHash(), {0, false}}).first;
+    }
+
+    uint64_t expiration = now + Cycles::fromNanoseconds(granted);
+    if (expiration > it->second.expiration)
+        it->second.expiration = expiration;
+    if (expiration > latestExpiration.load())
+        latestExpiration.store(expiration);
+    return granted;
+}
+
+/**
+ * Check whether an object may be modified now. If clients may still have
+ * it cached, no further leases will be granted on it until a write goes
+ * through, so the caller can retry once the current lease expires. The
+ * caller must hold the object's HashTableBucketLock.
+ *
+ * \param key
+ *      Key of the object about to be modified.
+ * \return
+ *      0 if the object may be modified. Otherwise, the number of
+ *      nanoseconds until its lease expires.
+ */
+uint64_t
+ReadLeaseTable::checkWrite(Key& key)
+{
+    uint64_t now = Cycles::rdtsc();
+    if (now >= latestExpiration.load())
+        return 0;
+
+    SpinLock::Guard _(mutex);
+    LeaseMap::iterator it = leases.find(key.getHash());
+    if (it == leases.end())
+        return 0;
+    if (now >= it->second.expiration) {
+        leases.erase(it);
+        return 0;
+    }
+    it->second.writePending = true;
+    return std::max(Cycles::toNanoseconds(it->second.expiration - now), 1UL);
+}
+
+/**
+ * Wait until every lease granted before this call has expired. Leases
+ * granted while waiting are not waited for, so a steady stream of reads
+ * can't starve the caller.
+ */
+void
+ReadLeaseTable::waitForAll()
+{
+    uint64_t expiration = latestExpiration.load();
+    uint64_t now = Cycles::rdtsc();
+    if (now < expiration)
+        Cycles::sleep(Cycles::toMicroseconds(expiration - now) + 1);
+}
+
+/**
+ * Discard leases that have expired (and whose grace period for a pending
+ * write has passed).
+ *
+ * \param lock
+ *      Ensures that the caller holds the monitor lock.
+ * \param now
+ *      Current Cycles::rdtsc() time.
+ */
+void
+ReadLeaseTable::prune(const SpinLock::Guard& lock, uint64_t now)
+{
+    uint64_t pendingCycles = Cycles::fromNanoseconds(WRITE_PENDING_NANOSECONDS);
+    LeaseMap::iterator it = leases.begin();
+    while (it != leases.end()) {
+        uint64_t end = it->second.expiration;
+        if (it->second.writePending)
+            end += pendingCycles;
+        if (now >= end)
+            it = leases.erase(it);
+        else
+            ++it;
+    }
+}
+
+} // namespace RAMCloud
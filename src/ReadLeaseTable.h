@@ -0,0 +1,104 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_READLEASETABLE_H
+#define RAMCLOUD_READLEASETABLE_H
+
+#include <unordered_map>
+
+#include "Common.h"
+#include "Atomic.h"
+#include "Key.h"
+#include "SpinLock.h"
+
+namespace RAMCloud {
+
+/**
+ * A master uses a ReadLeaseTable to keep track of the objects that clients
+ * may have cached (see ReadCache). When a master returns an object in
+ * response to a READ that asks for a lease, it promises not to modify the
+ * object until the lease runs out; clients may serve the object from their
+ * caches until then. Rather than sending invalidations (clients don't run
+ * services a master could call), a write to a leased object simply waits for
+ * the lease to expire.
+ *
+ * To keep a steady stream of readers from starving a writer, once a write
+ * has been held back no new leases are granted on the object until the
+ * write goes through (or a grace period passes, in case the writer has
+ * given up).
+ *
+ * Leases are tracked by key hash only, so two objects whose keys hash to
+ * the same value share leases; this is conservative.
+ *
+ * Callers must hold the object's HashTableBucketLock when calling grant()
+ * and checkWrite(), so that a lease can't be granted between the moment a
+ * writer checks for leases and the moment it modifies the object.
+ *
+ * This class is thread-safe.
+ */
+class ReadLeaseTable {
+  PUBLIC:
+    ReadLeaseTable();
+
+    uint32_t grant(Key& key, uint32_t requestedNanoseconds);
+    uint64_t checkWrite(Key& key);
+    void waitForAll();
+
+    /// Longest lease that will be granted. A write to a cached object can be
+    /// delayed by this long.
+    static const uint32_t MAX_LEASE_NANOSECONDS = 1000000;
+
+    /// After a write has been held back, no new leases are granted on the
+    /// object for up to this long past the expiration of the last lease,
+    /// giving the writer time to retry.
+    static const uint32_t WRITE_PENDING_NANOSECONDS = 2000000;
+
+    /// The table never holds more than this many leases; when full, expired
+    /// leases are discarded and, if that isn't enough, requests are refused.
+    static const uint32_t MAX_LEASES = 100000;
+
+  PRIVATE:
+    /**
+     * Information about outstanding leases on a single key hash.
+     */
+    struct Lease {
+        /// Cycles::rdtsc() time at which the last lease granted expires.
+        uint64_t expiration;
+
+        /// True means a write has been held back by this lease, so no new
+        /// leases should be granted on this key for now.
+        bool writePending;
+    };
+    typedef std::unordered_map<KeyHash, Lease> LeaseMap;
+
+    void prune(const SpinLock::Guard& lock, uint64_t now);
+
+    /// Monitor-style lock protecting #leases.
+    SpinLock mutex;
+
+    /// Outstanding (and some expired) leases, indexed by key hash.
+    LeaseMap leases;
+
+    /// Latest expiration time of any lease ever granted. Used to check
+    /// quickly that no leases are outstanding, which is the common case
+    /// when clients aren't caching.
+    Atomic<uint64_t> latestExpiration;
+
+    DISALLOW_COPY_AND_ASSIGN(ReadLeaseTable);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_READLEASETABLE_H
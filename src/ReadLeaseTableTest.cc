@@ -0,0 +1,148 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "Cycles.h"
+#include "ReadLeaseTable.h"
+
+namespace RAMCloud {
+
+class ReadLeaseTableTest : public ::testing::Test {
+  public:
+    ReadLeaseTable leases;
+    Key key;
+
+    ReadLeaseTableTest()
+        : leases()
+        , key(1, "key", 3)
+    {
+        // One cycle per nanosecond.
+        Cycles::mockCyclesPerSec = 1e09;
+        Cycles::mockTscValue = 1000;
+    }
+
+    ~ReadLeaseTableTest()
+    {
+        Cycles::mockCyclesPerSec = 0;
+        Cycles::mockTscValue = 0;
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(ReadLeaseTableTest);
+};
+
+TEST_F(ReadLeaseTableTest, grant) {
+    EXPECT_EQ(0U, leases.grant(key, 0));
+    EXPECT_EQ(0U, leases.leases.size());
+
+    EXPECT_EQ(500U, leases.grant(key, 500));
+    EXPECT_EQ(1500U, leases.leases[key.getHash()].expiration);
+    EXPECT_EQ(1500U, leases.latestExpiration.load());
+
+    // A shorter lease doesn't shorten the existing one.
+    EXPECT_EQ(100U, leases.grant(key, 100));
+    EXPECT_EQ(1500U, leases.leases[key.getHash()].expiration);
+
+    // Leases are capped.
+    uint32_t max = ReadLeaseTable::MAX_LEASE_NANOSECONDS;
+    EXPECT_EQ(max, leases.grant(key, ~0U));
+    EXPECT_EQ(1000U + ReadLeaseTable::MAX_LEASE_NANOSECONDS,
+            leases.leases[key.getHash()].expiration);
+}
+
+TEST_F(ReadLeaseTableTest, grant_writePending) {
+    leases.grant(key, 500);
+    EXPECT_EQ(500U, leases.checkWrite(key));
+    EXPECT_EQ(0U, leases.grant(key, 500));
+
+    // The writer never came back.
+    Cycles::mockTscValue = 1500 + ReadLeaseTable::WRITE_PENDING_NANOSECONDS;
+    EXPECT_EQ(500U, leases.grant(key, 500));
+    EXPECT_FALSE(leases.leases[key.getHash()].writePending);
+}
+
+TEST_F(ReadLeaseTableTest, grant_full) {
+    for (uint32_t i = 0; i < ReadLeaseTable::MAX_LEASES; i++)
+        leases.leases[i] = {1000, false};
+    leases.leases[key.getHash()] = {2000, false};
+    leases.leases.erase(0);
+
+    // Expired leases are discarded to make room.
+    EXPECT_EQ(500U, leases.grant(key, 500));
+    Key other(1, "other", 5);
+    EXPECT_EQ(500U, leases.grant(other, 500));
+    EXPECT_EQ(2U, leases.leases.size());
+
+    for (uint32_t i = 0; i < ReadLeaseTable::MAX_LEASES; i++)
+        leases.leases[i] = {2000, false};
+    Key third(1, "third", 5);
+    EXPECT_EQ(0U, leases.grant(third, 500));
+}
+
+TEST_F(ReadLeaseTableTest, checkWrite) {
+    EXPECT_EQ(0U, leases.checkWrite(key));
+    leases.grant(key, 500);
+
+    Key other(1, "other", 5);
+    EXPECT_EQ(0U, leases.checkWrite(other));
+
+    Cycles::mockTscValue = 1200;
+    EXPECT_EQ(300U, leases.checkWrite(key));
+    EXPECT_TRUE(leases.leases[key.getHash()].writePending);
+
+    Cycles::mockTscValue = 1500;
+    EXPECT_EQ(0U, leases.checkWrite(key));
+    EXPECT_EQ(1U, leases.leases.size());
+}
+
+TEST_F(ReadLeaseTableTest, checkWrite_expiredEntry) {
+    leases.grant(key, 500);
+    Key other(1, "other", 5);
+    leases.grant(other, 1000);
+    Cycles::mockTscValue = 1600;
+    EXPECT_EQ(0U, leases.checkWrite(key));
+    EXPECT_EQ(1U, leases.leases.size());
+}
+
+TEST_F(ReadLeaseTableTest, waitForAll) {
+    Cycles::mockCyclesPerSec = 0;
+    Cycles::mockTscValue = 0;
+    leases.waitForAll();
+
+    uint64_t start = Cycles::rdtsc();
+    leases.grant(key, 200000);
+    Key other(1, "other", 5);
+    leases.grant(other, 100000);
+    leases.waitForAll();
+    EXPECT_GE(Cycles::toNanoseconds(Cycles::rdtsc() - start), 200000U);
+    EXPECT_EQ(0U, leases.checkWrite(key));
+    EXPECT_EQ(0U, leases.checkWrite(other));
+}
+
+TEST_F(ReadLeaseTableTest, prune) {
+    leases.grant(key, 500);
+    Key pending(1, "pending", 7);
+    leases.grant(pending, 500);
+    leases.checkWrite(pending);
+    Key live(1, "live", 4);
+    leases.grant(live, 1000);
+
+    SpinLock::Guard lock(leases.mutex);
+    leases.prune(lock, 1600);
+    EXPECT_EQ(2U, leases.leases.size());
+    leases.prune(lock, 1500 + ReadLeaseTable::WRITE_PENDING_NANOSECONDS);
+    EXPECT_EQ(0U, leases.leases.size());
+}
+
+}  // namespace RAMCloud
@@ -28,6 +28,12 @@ namespace RAMCloud {
  * and chopping it up into individual seglets of the specified size. All
  * seglets will be placed in the lowest priority "default" pool.
  *
+ * On NUMA machines the memory is split evenly across the nodes, and
+ * allocations prefer seglets on the node of the calling core. Log heads are
+ * allocated by the worker doing the writing and cleaner survivors by the
+ * cleaner thread doing the relocating, so each segment's contents are
+ * usually written to local memory.
+ *
  * \param config
  *      Server runtime configuration, specifying various parameters like
  *      seglet size and bytes to allocate for seglets.
@@ -43,7 +49,7 @@ SegletAllocator::SegletAllocator(const ServerConfig* config)
       cleanerPoolReserve(0),
       defaultPool(),
       segletToSegmentTable(),
-      block(config->master.logBytes)
+      block(config->master.logBytes, NUMA_SPLIT)
 {
     assert(BitOps::isPowerOfTwo(segletSize));
     uint8_t* segletBlock = block.get();
@@ -395,9 +401,50 @@ SegletAllocator::allocFromPool(vector<Seglet*>& pool,
     if (pool.size() < count)
         return false;
 
+    if (LargeBlockOfMemoryInternal::getNumaNodeCount() > 1) {
+        preferSegletsOnNode(pool, count,
+                LargeBlockOfMemoryInternal::getCurrentNumaNode());
+    }
+
     outSeglets.insert(outSeglets.end(), pool.end() - count, pool.end());
     pool.erase(pool.end() - count, pool.end());
     return true;
 }
 
+/**
+ * Reorder a pool so that, as far as possible, its last ``count'' seglets
+ * (the ones allocFromPool() hands out) are backed by memory on the given
+ * NUMA node. Only the tail of the pool is searched, so this is cheap; if
+ * few local seglets are found there the allocation just uses some remote
+ * memory.
+ *
+ * This must be called with the monitor lock held.
+ *
+ * \param pool
+ *      The pool about to be allocated from.
+ * \param count
+ *      The number of seglets about to be allocated.
+ * \param node
+ *      The NUMA node that the seglets should preferably come from.
+ */
+void
+SegletAllocator::preferSegletsOnNode(vector<Seglet*>& pool,
+                                     uint32_t count,
+                                     int node)
+{
+    size_t scanLimit = std::min(pool.size(),
+            static_cast<size_t>(count) * NUMA_SCAN_FACTOR);
+    size_t next = pool.size();      // Seglets at [next, end) are local.
+    for (size_t i = pool.size(); i > pool.size() - scanLimit; i--) {
+        Seglet* seglet = pool[i - 1];
+        size_t offset = static_cast<uint8_t*>(seglet->get()) - block.get();
+        if (block.getNumaNode(offset) != node)
+            continue;
+        next--;
+        std::swap(pool[i - 1], pool[next]);
+        if (pool.size() - next == count)
+            break;
+    }
+}
+
 } // end RAMCloud
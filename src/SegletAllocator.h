@@ -94,6 +94,14 @@ class SegletAllocator {
     bool allocFromPool(vector<Seglet*>& pool,
                        uint32_t count,
                        vector<Seglet*>& outSeglets);
+    void preferSegletsOnNode(vector<Seglet*>& pool,
+                             uint32_t count,
+                             int node);
+
+    /// When looking for seglets on the local NUMA node, examine at most this
+    /// many times the number of seglets requested (see
+    /// preferSegletsOnNode()).
+    static const size_t NUMA_SCAN_FACTOR = 8;
 
     /// Size of each seglet in bytes.
     const uint32_t segletSize;
@@ -145,7 +153,8 @@ class SegletAllocator {
     /// based on a pointer anywhere into ``block'' below.
     vector<LogSegment*> segletToSegmentTable;
 
-    /// Single contiguous block of memory backing all of our seglets.
+    /// Single contiguous block of memory backing all of our seglets. On NUMA
+    /// machines it is split evenly across the nodes.
     LargeBlockOfMemory<uint8_t> block;
 
     DISALLOW_COPY_AND_ASSIGN(SegletAllocator);
@@ -202,4 +202,35 @@ TEST_F(SegletAllocatorTest, allocFromPool) {
     allocator.allocFromPool(seglets, maxSeglets, allocator.defaultPool);
 }
 
+TEST_F(SegletAllocatorTest, preferSegletsOnNode) {
+    // Pretend the block was split across two NUMA nodes.
+    vector<Seglet*>& all = allocator.defaultPool;
+    size_t n = all.size();
+    ASSERT_LE(20U, n);
+    allocator.block.numaNodes = 2;
+    allocator.block.numaPieceSize = allocator.block.length / 2;
+
+    vector<Seglet*> pool = { all[0], all[n - 1], all[1], all[n - 2] };
+    allocator.preferSegletsOnNode(pool, 2, 0);
+    EXPECT_EQ(all[n - 2], pool[0]);
+    EXPECT_EQ(all[n - 1], pool[1]);
+    EXPECT_EQ(all[0], pool[2]);
+    EXPECT_EQ(all[1], pool[3]);
+    allocator.preferSegletsOnNode(pool, 1, 1);
+    EXPECT_EQ(all[n - 1], pool[3]);
+
+    // Only the tail of the pool is searched.
+    pool.clear();
+    pool.push_back(all[0]);
+    for (size_t i = 1; i <= SegletAllocator::NUMA_SCAN_FACTOR; i++)
+        pool.push_back(all[n - i]);
+    allocator.preferSegletsOnNode(pool, 1, 0);
+    EXPECT_EQ(all[0], pool[0]);
+    allocator.preferSegletsOnNode(pool, 2, 0);
+    EXPECT_EQ(all[0], pool.back());
+
+    allocator.block.numaNodes = 1;
+    allocator.block.numaPieceSize = allocator.block.length;
+}
+
 } // namespace RAMCloud
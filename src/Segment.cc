@@ -200,30 +200,11 @@ Segment::append(LogEntryType type,
                 uint32_t length,
                 Reference* outReference)
 {
-    EntryHeader entryHeader(type, length);
-
-    if (!hasSpaceFor(&length, 1))
+    uint32_t dataOffset;
+    if (!reserve(type, length, outReference, &dataOffset))
         return false;
 
-    uint32_t startOffset = head;
-
-    copyIn(head, &entryHeader, sizeof(entryHeader));
-    checksum.update(&entryHeader, sizeof(entryHeader));
-    head += sizeof32(entryHeader);
-
-    // Note that this assumes a little-endian byte order. I think this is
-    // justified considering how widely we have assume byte order (if not
-    // x86 in particular).
-    copyIn(head, &length, entryHeader.getLengthBytes());
-    checksum.update(&length, entryHeader.getLengthBytes());
-    head += entryHeader.getLengthBytes();
-
-    copyIn(head, buffer, length);
-    head += length;
-
-    if (outReference != NULL)
-        *outReference = Reference(this, startOffset);
-
+    copyIn(dataOffset, buffer, length);
     return true;
 }
 
@@ -320,6 +301,81 @@ Segment::append(const void* buffer,
     return true;
 }
 
+/**
+ * Allocate space for a typed entry at the end of this segment and write its
+ * metadata, but do not copy in the entry's contents. This allows a caller to
+ * copy the contents (see #fillReserved) after releasing whatever lock
+ * serializes appends to the segment, so that multiple large entries can be
+ * copied in parallel.
+ *
+ * The segment's length and certificate cover the reserved entry as soon as
+ * this method returns, so callers must ensure that the contents have been
+ * filled in before the segment is replicated, iterated over, or closed.
+ *
+ * \param type
+ *      Type of the entry. See LogEntryTypes.h.
+ * \param length
+ *      Number of bytes of entry contents to reserve space for.
+ * \param[out] outReference
+ *      If the reservation was successful, a Segment::Reference pointing to
+ *      the new entry is returned here.
+ * \param[out] outDataOffset
+ *      If the reservation was successful, the segment offset at which the
+ *      entry's contents must be stored is returned here.
+ * \return
+ *      True if the reservation succeeded, false if there was insufficient
+ *      space to complete the operation.
+ */
+bool
+Segment::reserve(LogEntryType type,
+                 uint32_t length,
+                 Reference* outReference,
+                 uint32_t* outDataOffset)
+{
+    EntryHeader entryHeader(type, length);
+
+    if (!hasSpaceFor(&length, 1))
+        return false;
+
+    uint32_t startOffset = head;
+
+    copyIn(head, &entryHeader, sizeof(entryHeader));
+    checksum.update(&entryHeader, sizeof(entryHeader));
+    head += sizeof32(entryHeader);
+
+    // Note that this assumes a little-endian byte order. I think this is
+    // justified considering how widely we have assume byte order (if not
+    // x86 in particular).
+    copyIn(head, &length, entryHeader.getLengthBytes());
+    checksum.update(&length, entryHeader.getLengthBytes());
+    head += entryHeader.getLengthBytes();
+
+    *outDataOffset = head;
+    head += length;
+
+    if (outReference != NULL)
+        *outReference = Reference(this, startOffset);
+
+    return true;
+}
+
+/**
+ * Copy the contents of an entry into space previously allocated by
+ * #reserve. This method does not modify any segment metadata, so it may
+ * run concurrently with other calls to this method and to #reserve.
+ *
+ * \param dataOffset
+ *      Offset returned by #reserve.
+ * \param buffer
+ *      Contents of the entry; its size must match the length passed to
+ *      #reserve.
+ */
+void
+Segment::fillReserved(uint32_t dataOffset, Buffer& buffer)
+{
+    copyInFromBuffer(dataOffset, buffer, 0, buffer.size());
+}
+
 /**
  * Adds a log entry header to a buffer. The size of the header is
  * determined by the object size for which this header is to be
@@ -763,12 +819,18 @@ Segment::checkMetadataIntegrity(const SegmentCertificate& certificate)
 
     const void* unused = NULL;
     while (offset < certificate.segmentLength && peek(offset, &unused) > 0) {
+        // The checksum covers each entry's header and length field, which
+        // are adjacent; checksum them together rather than in two calls.
         EntryHeader header = getEntryHeader(offset);
-        currentChecksum.update(&header, sizeof(header));
+        uint8_t metadata[sizeof(header) + sizeof(uint32_t)] = {};
+        memcpy(metadata, &header, sizeof(header));
+        copyOut(offset + sizeof32(header), &metadata[sizeof(header)],
+                header.getLengthBytes());
+        currentChecksum.update(metadata,
+                sizeof32(header) + header.getLengthBytes());
 
         uint32_t length = 0;
-        copyOut(offset + sizeof32(header), &length, header.getLengthBytes());
-        currentChecksum.update(&length, header.getLengthBytes());
+        memcpy(&length, &metadata[sizeof(header)], header.getLengthBytes());
 
         offset += (sizeof32(header) + header.getLengthBytes() + length);
         size_t segmentSize = segletBlocks.size() * segletSize;
@@ -285,6 +285,11 @@ class Segment {
                 uint32_t* entryDataLength = NULL,
                 LogEntryType *type = NULL,
                 Reference* outReference = NULL);
+    bool reserve(LogEntryType type,
+                 uint32_t length,
+                 Reference* outReference,
+                 uint32_t* outDataOffset);
+    void fillReserved(uint32_t dataOffset, Buffer& buffer);
     static void appendLogHeader(LogEntryType type,
                                 uint32_t objectSize,
                                 Buffer *logBuffer);
@@ -294,7 +294,8 @@ SegmentManager::allocHeadSegment(uint32_t flags)
  * \param replacing
  *      If memory compaction is being performed, this must point to the current
  *      segment that is being compacted. The allocated segment will then be
- *      created with the same segment identifier and creation timestamp.
+ *      created with the same segment identifier, creation timestamp, and
+ *      data timestamp.
  *
  *      If a survivor is being allocated for disk cleaning instead, this must be
  *      NULL (the default).
@@ -353,7 +354,9 @@ SegmentManager::allocSideSegment(uint32_t flags, LogSegment* replacing)
 
     if (replacing != NULL) {
         // This survivor will inherit the replicatedSegment of the one it
-        // replaces when memoryCleaningComplete() is invoked.
+        // replaces when memoryCleaningComplete() is invoked. Compaction
+        // doesn't change the age of the data, so keep that too.
+        s->dataTimestamp = replacing->dataTimestamp;
     } else {
         s->replicatedSegment = replicaManager.allocateNonHead(s->id, s);
         segmentsOnDiskHistogram.storeSample(++segmentsOnDisk);
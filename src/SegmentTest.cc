@@ -128,6 +128,32 @@ TEST_P(SegmentTest, append_blackBox) {
     }
 }
 
+TEST_P(SegmentTest, reserve_and_fillReserved) {
+    SegmentAndAllocator segAndAlloc(GetParam());
+    Segment& s = *segAndAlloc.segment;
+
+    Segment::Reference ref;
+    uint32_t dataOffset;
+    EXPECT_TRUE(s.reserve(LOG_ENTRY_TYPE_OBJ, 2, &ref, &dataOffset));
+    EXPECT_EQ(2U, dataOffset);
+    EXPECT_EQ(4U, s.head);
+
+    // The certificate covers only entry metadata, so it is already final
+    // before the contents are copied in.
+    SegmentCertificate certificate;
+    EXPECT_EQ(4U, s.getAppendedLength(&certificate));
+    EXPECT_EQ(0x87a632e2u, certificate.checksum);
+
+    Buffer contents;
+    contents.appendExternal("hi", 2);
+    s.fillReserved(dataOffset, contents);
+
+    Buffer buffer;
+    s.getEntry(ref, &buffer);
+    EXPECT_EQ(2U, buffer.size());
+    EXPECT_EQ(0, memcmp("hi", buffer.getRange(0, 2), 2));
+}
+
 TEST_P(SegmentTest, append_outOfSpace) {
     SegmentAndAllocator segAndAlloc(GetParam());
     Segment& s = *segAndAlloc.segment;
@@ -64,6 +64,7 @@ struct ServerConfig {
         , maxObjectDataSize(segmentSize / 4)
         , maxObjectKeySize((64 * 1024) - 1)
         , maxCores(2)
+        , steerByKeyHash(false)
         , master(testing)
         , backup(testing)
     {}
@@ -88,6 +89,7 @@ struct ServerConfig {
         , maxObjectDataSize(segmentSize / 8)
         , maxObjectKeySize((64 * 1024) - 1)
         , maxCores(2)
+        , steerByKeyHash(false)
         , master()
         , backup()
     {}
@@ -137,6 +139,7 @@ struct ServerConfig {
         config.set_max_object_data_size(maxObjectDataSize);
         config.set_max_object_key_size(maxObjectKeySize);
         config.set_max_cores(maxCores);
+        config.set_steer_by_key_hash(steerByKeyHash);
 
         if (services.has(WireFormat::MASTER_SERVICE))
             master.serialize(*config.mutable_master());
@@ -217,6 +220,13 @@ struct ServerConfig {
      */
     uint32_t maxCores;
 
+    /**
+     * If true, the key-hash space is partitioned among worker threads and
+     * master requests that name a single key are preferentially executed
+     * by the worker that owns the key's partition (see WorkerManager).
+     */
+    bool steerByKeyHash;
+
     /**
      * Configuration details specific to the MasterService on a server,
      * if any.  If !config.has(MASTER_SERVICE) then this field is ignored.
@@ -229,12 +239,14 @@ struct ServerConfig {
         Master(Testing) // NOLINT
             : logBytes(40 * 1024 * 1024)
             , hashTableBytes(1 * 1024 * 1024)
+            , hashTableAutoResize(false)
             , disableLogCleaner(true)
             , disableInMemoryCleaning(true)
             , diskExpansionFactor(1.0)
             , cleanerBalancer("tombstoneRatio:0.40")
             , cleanerWriteCostThreshold(0)
             , cleanerThreadCount(1)
+            , recoveryReplayThreads(1)
             , numReplicas(0)
             , useMinCopysets(false)
             , allowLocalBackup(false)
@@ -248,12 +260,14 @@ struct ServerConfig {
         Master()
             : logBytes()
             , hashTableBytes()
+            , hashTableAutoResize()
             , disableLogCleaner()
             , disableInMemoryCleaning()
             , diskExpansionFactor()
             , cleanerBalancer()
             , cleanerWriteCostThreshold()
             , cleanerThreadCount()
+            , recoveryReplayThreads()
             , numReplicas()
             , useMinCopysets()
             , allowLocalBackup()
@@ -267,12 +281,14 @@ struct ServerConfig {
         {
             config.set_log_bytes(logBytes);
             config.set_hash_table_bytes(hashTableBytes);
+            config.set_hash_table_auto_resize(hashTableAutoResize);
             config.set_disable_log_cleaner(disableLogCleaner);
             config.set_disable_in_memory_cleaning(disableInMemoryCleaning);
             config.set_backup_disk_expansion_factor(diskExpansionFactor);
             config.set_cleaner_balancer(cleanerBalancer);
             config.set_cleaner_write_cost_threshold(cleanerWriteCostThreshold);
             config.set_cleaner_thread_count(cleanerThreadCount);
+            config.set_recovery_replay_threads(recoveryReplayThreads);
             config.set_num_replicas(numReplicas);
             config.set_use_mincopysets(useMinCopysets);
             config.set_use_local_backup(allowLocalBackup);
@@ -287,12 +303,14 @@ struct ServerConfig {
         {
             logBytes = config.log_bytes();
             hashTableBytes = config.hash_table_bytes();
+            hashTableAutoResize = config.hash_table_auto_resize();
             disableLogCleaner = config.disable_log_cleaner();
             disableInMemoryCleaning = config.disable_in_memory_cleaning();
             diskExpansionFactor = config.backup_disk_expansion_factor();
             cleanerBalancer = config.cleaner_balancer();
             cleanerWriteCostThreshold = config.cleaner_write_cost_threshold();
             cleanerThreadCount = config.cleaner_thread_count();
+            recoveryReplayThreads = config.recovery_replay_threads();
             numReplicas = config.num_replicas();
             useMinCopysets = config.use_mincopysets();
             allowLocalBackup = config.use_local_backup();
@@ -304,6 +322,10 @@ struct ServerConfig {
         /// Total number of bytes to use for the HashTable.
         uint64_t hashTableBytes;
 
+        /// If true, the HashTable is grown (and shrunk back, though never
+        /// below hashTableBytes) online as the number of objects changes.
+        bool hashTableAutoResize;
+
         /// If true, disable the log cleaner entirely.
         bool disableLogCleaner;
 
@@ -330,6 +352,11 @@ struct ServerConfig {
         /// at the expense of CPU cycles.
         uint32_t cleanerThreadCount;
 
+        /// Number of threads (including the one running the recovery) that
+        /// replay each recovery segment when this master is a recovery
+        /// master. Entries are divided among them by key hash.
+        uint32_t recoveryReplayThreads;
+
         /// Number of replicas to keep per segment stored on backups.
         uint32_t numReplicas;
 
@@ -357,6 +384,8 @@ struct ServerConfig {
             , numSegmentFrames(4)
             , maxNonVolatileBuffers(0)
             , maxRecoveryReplicas(20)
+            , recoveryBuilderThreads(0)
+            , ioUringThreads(0)
             , file()
             , strategy(1)
             , mockSpeed(100)
@@ -375,6 +404,8 @@ struct ServerConfig {
             , numSegmentFrames(512)
             , maxNonVolatileBuffers(0)
             , maxRecoveryReplicas(20)
+            , recoveryBuilderThreads(4)
+            , ioUringThreads(0)
             , file("/var/tmp/backup.log")
             , strategy(1)
             , mockSpeed(0)
@@ -392,6 +423,8 @@ struct ServerConfig {
             config.set_num_segment_frames(numSegmentFrames);
             config.set_max_non_volatile_buffers(maxNonVolatileBuffers);
             config.set_max_recovery_replicas(maxRecoveryReplicas);
+            config.set_recovery_builder_threads(recoveryBuilderThreads);
+            config.set_io_uring_threads(ioUringThreads);
             if (!inMemory)
                 config.set_file(file);
             config.set_strategy(strategy);
@@ -411,6 +444,8 @@ struct ServerConfig {
             numSegmentFrames = config.num_segment_frames();
             maxNonVolatileBuffers = config.max_non_volatile_buffers();
             maxRecoveryReplicas = config.max_recovery_replicas();
+            recoveryBuilderThreads = config.recovery_builder_threads();
+            ioUringThreads = config.io_uring_threads();
             if (!inMemory)
                 file = config.file();
             strategy = config.strategy();
@@ -460,6 +495,20 @@ struct ServerConfig {
          */
         uint32_t maxRecoveryReplicas;
 
+        /**
+         * Number of threads each master recovery on this backup uses to
+         * split replicas into recovery segments. If 0, replicas are split
+         * one at a time on the backup's task queue thread.
+         */
+        uint32_t recoveryBuilderThreads;
+
+        /**
+         * If nonzero and inMemory is false, replicas on disk are read and
+         * written through io_uring (IoUringStorage) by this many threads;
+         * otherwise MultiFileStorage with POSIX aio is used.
+         */
+        uint32_t ioUringThreads;
+
         /// Path to a file to use for the backing store if inMemory is false.
         string file;
 
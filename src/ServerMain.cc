@@ -161,11 +161,24 @@ main(int argc, char *argv[])
              ProgramOptions::value<string>(&config.backup.file)->
                 default_value("/var/tmp/backup.log"),
              "The file path to the backup storage.")
+            ("hashTableAutoResize",
+             ProgramOptions::bool_switch(&config.master.hashTableAutoResize),
+             "Grow the hash table online when it becomes too full to keep "
+             "bucket chains short, and shrink it again (never below "
+             "hashTableMemory) when objects are deleted. Memory used by a "
+             "larger table is in addition to totalMasterMemory.")
             ("hashTableMemory,h",
              ProgramOptions::value<string>(&hashTableMemory)->
                 default_value("10%"),
              "Percentage or megabytes of master memory allocated to "
              "the hash table")
+            ("ioUringThreads",
+             ProgramOptions::value<uint32_t>(
+                &config.backup.ioUringThreads)->default_value(0),
+             "If nonzero, the backup performs disk IO through io_uring "
+             "using this many IO threads, keeping the IO for that many "
+             "replicas in flight at once. 0 means use POSIX aio. Falls back "
+             "to POSIX aio if the kernel doesn't support io_uring.")
             ("logCleanerThreads",
              ProgramOptions::value<uint32_t>(
                 &config.master.cleanerThreadCount)->default_value(1),
@@ -202,6 +215,20 @@ main(int argc, char *argv[])
              "Use this value as the index number for this server's server id, "
              "if that number isn't already in use. Can be used to ensure "
              "a reproducible assignment of server ids.")
+            ("recoveryBuilderThreads",
+             ProgramOptions::value<uint32_t>(
+                &config.backup.recoveryBuilderThreads)->default_value(4),
+             "Number of threads each master recovery on this backup uses to "
+             "split replicas into recovery segments, so that filtering keeps "
+             "up with reads from storage. 0 means filter on the backup's "
+             "task queue thread, one replica at a time.")
+            ("recoveryReplayThreads",
+             ProgramOptions::value<uint32_t>(
+                &config.master.recoveryReplayThreads)->default_value(4),
+             "Number of threads used to replay each recovery segment when "
+             "this server acts as a recovery master. Objects are divided "
+             "among the threads by key hash. The extra threads are not "
+             "counted against maxCores.")
             ("replicas,r",
              ProgramOptions::value<uint32_t>(&config.master.numReplicas),
              "Number of backup copies to make for each segment")
@@ -214,6 +241,12 @@ main(int argc, char *argv[])
              "2NR/8M (gives the backup 2NR bytes of space); any value lower "
              "than this may cause the cluster to eventually fail to service "
              "write requests.")
+            ("steerByKeyHash",
+             ProgramOptions::bool_switch(&config.steerByKeyHash),
+             "Partition the key-hash space among the worker threads and run "
+             "reads, writes, and other single-key requests on the worker "
+             "that owns the key's partition whenever it is idle. This keeps "
+             "each hash table bucket on a single core.")
             ("sync",
              ProgramOptions::bool_switch(&config.backup.sync),
              "Make all updates completely synchronous all the way down to "
@@ -21,6 +21,7 @@
 #include "Common.h"
 #include "ClientException.h"
 #include "Buffer.h"
+#include "Key.h"
 #include "ServerId.h"
 #include "WireFormat.h"
 #include "PerfCounter.h"
@@ -58,7 +59,8 @@ class Service {
         Rpc(Worker* worker, Buffer* requestPayload, Buffer* replyPayload)
             : requestPayload(requestPayload)
             , replyPayload(replyPayload)
-            , worker(worker) {}
+            , worker(worker)
+            , keyHash() {}
 
         void sendReply();
 
@@ -72,6 +74,11 @@ class Service {
         /// this request.
         Worker* worker;
 
+        /// Hash of the request's primary key, if it was already computed
+        /// when the request was steered to a worker (see
+        /// Transport::ServerRpc::keyHash).
+        Tub<KeyHash> keyHash;
+
         friend class WorkerManager;
         friend class Service;
         DISALLOW_COPY_AND_ASSIGN(Rpc);
@@ -96,7 +96,9 @@ SideLog::commit()
     if (segments.empty())
         return;
 
-    // The last segment will still be open. Close it and begin replication.
+    // The last segment will still be open. Close it and begin replication
+    // (once any entries still being filled in are complete).
+    waitForAllCopies();
     LogSegment* lastSegmentAllocated = segments.back();
     lastSegmentAllocated->close();
     lastSegmentAllocated->replicatedSegment->close();
@@ -105,6 +105,11 @@ class Syscall {
         return ::getsockname(sockfd, addr, addrlen);
     }
     VIRTUAL_FOR_TESTING
+    int getsockopt(int sockfd, int level, int optname, void* optval,
+                    socklen_t* optlen) {
+        return ::getsockopt(sockfd, level, optname, optval, optlen);
+    }
+    VIRTUAL_FOR_TESTING
     int listen(int sockfd, int backlog) {
         return ::listen(sockfd, backlog);
     }
@@ -121,6 +126,10 @@ class Syscall {
         return ::pwrite(fd, buf, count, offset);
     }
     VIRTUAL_FOR_TESTING
+    ssize_t read(int fd, void* buf, size_t count) {
+        return ::read(fd, buf, count);
+    }
+    VIRTUAL_FOR_TESTING
     ssize_t recv(int sockfd, void *buf, size_t len, int flags) {
         return ::recv(sockfd, buf, len, flags);
     }
@@ -135,12 +144,21 @@ class Syscall {
         return ::recvmmsg(sockfd, msgvec, vlen, flags, timeout);
     }
     VIRTUAL_FOR_TESTING
+    ssize_t recvmsg(int sockfd, msghdr *msg, int flags) {
+        return ::recvmsg(sockfd, msg, flags);
+    }
+    VIRTUAL_FOR_TESTING
     int select(int nfds, fd_set *readfds, fd_set *writefds,
            fd_set *errorfds, struct timeval *timeout)
     {
         return ::select(nfds, readfds, writefds, errorfds, timeout);
     }
     VIRTUAL_FOR_TESTING
+    int sendmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen,
+            int flags) {
+        return ::sendmmsg(sockfd, msgvec, vlen, flags);
+    }
+    VIRTUAL_FOR_TESTING
     ssize_t sendmsg(int sockfd, const msghdr *msg, int flags) {
         return ::sendmsg(sockfd, msg, flags);
     }
@@ -869,36 +869,32 @@ TableManager::splitTablet(const char* name, uint64_t splitKeyHash)
     Directory::iterator it = directory.find(name);
     if (it == directory.end())
         throw NoSuchTable(HERE);
-    Table* table = it->second;
-    Tablet* tablet = findTablet(lock, table, splitKeyHash);
-    if (splitKeyHash == tablet->startKeyHash)
-        return;
-    if (tablet->status == Tablet::RECOVERING) {
-        // We can't process this request right now, because recovery may
-        // undo it. Try again when recovery is finished.
-        throw RetryException(HERE, 1000000, 2000000,
-                "can't split tablet now: recovery is underway");
-    }
-
-    // Perform the split on our in-memory structures.
-    table->tablets.push_back(new Tablet(tablet->tableId, splitKeyHash,
-            tablet->endKeyHash, tablet->serverId, tablet->status,
-            tablet->ctime));
-    tablet->endKeyHash = splitKeyHash - 1;
-
-    // Record information about the split in external storage, in case we
-    // crash.
-    ProtoBuf::Table externalInfo;
-    serializeTable(lock, table, &externalInfo);
-    externalInfo.set_sequence_number(updateManager->nextSequenceNumber());
-    ProtoBuf::Table::Split* split = externalInfo.mutable_split();
-    split->set_server_id(tablet->serverId.getId());
-    split->set_split_key_hash(splitKeyHash);
-    syncTable(lock, table, &externalInfo);
+    splitTablet(lock, it->second, splitKeyHash);
+}
 
-    // Finish up by notifying the relevant master.
-    notifySplitTablet(lock, &externalInfo);
-    updateManager->updateFinished(externalInfo.sequence_number());
+/**
+ * Split a tablet into two disjoint tablets at a specific key hash. This
+ * method is identical to the one above except that the table is identified
+ * by id; it is used by the TabletBalancer.
+ *
+ * \param tableId
+ *      Id of the table that contains the tablet to be split.
+ * \param splitKeyHash
+ *      Key hash to used to partition the tablet into two. Keys less than
+ *      \a splitKeyHash belong to one tablet, keys greater than or equal to
+ *      \a splitKeyHash belong to the other.
+ *
+ * \throw NoSuchTable
+ *      If tableId does not specify an existing table.
+ */
+void
+TableManager::splitTablet(uint64_t tableId, uint64_t splitKeyHash)
+{
+    Lock lock(mutex);
+    IdMap::iterator it = idMap.find(tableId);
+    if (it == idMap.end())
+        throw NoSuchTable(HERE);
+    splitTablet(lock, it->second, splitKeyHash);
 }
 
 /**
@@ -1633,6 +1629,53 @@ TableManager::serializeTable(const Lock& lock, Table* table,
     }
 }
 
+/**
+ * Helper for the public splitTablet methods; does all of the work.
+ *
+ * \param lock
+ *      Ensures that the caller holds the monitor lock; not actually used.
+ * \param table
+ *      Table that contains the tablet to be split.
+ * \param splitKeyHash
+ *      Key hash to used to partition the tablet into two. Keys less than
+ *      \a splitKeyHash belong to one tablet, keys greater than or equal to
+ *      \a splitKeyHash belong to the other.
+ */
+void
+TableManager::splitTablet(const Lock& lock, Table* table,
+        uint64_t splitKeyHash)
+{
+    Tablet* tablet = findTablet(lock, table, splitKeyHash);
+    if (splitKeyHash == tablet->startKeyHash)
+        return;
+    if (tablet->status == Tablet::RECOVERING) {
+        // We can't process this request right now, because recovery may
+        // undo it. Try again when recovery is finished.
+        throw RetryException(HERE, 1000000, 2000000,
+                "can't split tablet now: recovery is underway");
+    }
+
+    // Perform the split on our in-memory structures.
+    table->tablets.push_back(new Tablet(tablet->tableId, splitKeyHash,
+            tablet->endKeyHash, tablet->serverId, tablet->status,
+            tablet->ctime));
+    tablet->endKeyHash = splitKeyHash - 1;
+
+    // Record information about the split in external storage, in case we
+    // crash.
+    ProtoBuf::Table externalInfo;
+    serializeTable(lock, table, &externalInfo);
+    externalInfo.set_sequence_number(updateManager->nextSequenceNumber());
+    ProtoBuf::Table::Split* split = externalInfo.mutable_split();
+    split->set_server_id(tablet->serverId.getId());
+    split->set_split_key_hash(splitKeyHash);
+    syncTable(lock, table, &externalInfo);
+
+    // Finish up by notifying the relevant master.
+    notifySplitTablet(lock, &externalInfo);
+    updateManager->updateFinished(externalInfo.sequence_number());
+}
+
 /**
  * Update next_table_id on external storage.
  *
@@ -92,6 +92,7 @@ class TableManager {
     void serializeTableConfig(ProtoBuf::TableConfig* tableConfig,
             uint64_t tableId);
     void splitTablet(const char* name, uint64_t splitKeyHash);
+    void splitTablet(uint64_t tableId, uint64_t splitKeyHash);
     void splitRecoveringTablet(uint64_t tableId, uint64_t splitKeyHash);
     void tabletRecovered(uint64_t tableId, uint64_t startKeyHash,
             uint64_t endKeyHash, ServerId serverId, LogPosition ctime);
@@ -258,6 +259,7 @@ class TableManager {
     Table* recreateTable(const Lock& lock, ProtoBuf::Table* info);
     void serializeTable(const Lock& lock, Table* table,
             ProtoBuf::Table* externalInfo);
+    void splitTablet(const Lock& lock, Table* table, uint64_t splitKeyHash);
     void syncNextTableId(const Lock& lock);
     void syncTable(const Lock& lock, Table* table,
             ProtoBuf::Table* externalInfo);
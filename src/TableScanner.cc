@@ -0,0 +1,230 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TableScanner.h"
+#include "ObjectFinder.h"
+
+namespace RAMCloud {
+
+/**
+ * Constructor for TableScanner objects.
+ *
+ * \param ramcloud
+ *      Overall information about the RAMCloud cluster to use for this
+ *      scan.
+ * \param tableId
+ *      Identifier for the table to scan.
+ * \param keysOnly
+ *      False means that full objects are returned, containing both keys
+ *      and data. True means that the returned objects have been truncated
+ *      so that the object data (normally the last field of the object) is
+ *      omitted.
+ * \param keyPrefix
+ *      If non-NULL, only objects whose primary keys start with these bytes
+ *      are returned. The bytes are copied, so the caller's storage may be
+ *      reused once the constructor returns.
+ * \param keyPrefixLength
+ *      Number of bytes in \a keyPrefix.
+ * \param minVersion
+ *      Only objects with versions at least this large are returned; 0
+ *      means all versions.
+ * \param maxParallelRpcs
+ *      Largest number of SCAN RPCs to have outstanding at once.
+ */
+TableScanner::TableScanner(RamCloud& ramcloud, uint64_t tableId,
+        bool keysOnly, const void* keyPrefix, uint16_t keyPrefixLength,
+        uint64_t minVersion, uint32_t maxParallelRpcs)
+    : ramcloud(ramcloud)
+    , tableId(tableId)
+    , keysOnly(keysOnly)
+    , keyPrefix()
+    , minVersion(minVersion)
+    , maxParallelRpcs(std::max(maxParallelRpcs, 1U))
+    , maxPayloadBytes(0)
+    , ranges()
+    , current(NULL)
+    , outstandingRpcs(0)
+{
+    if (keyPrefix != NULL)
+        this->keyPrefix.assign(static_cast<const char*>(keyPrefix),
+                               keyPrefixLength);
+}
+
+/**
+ * Test if any objects remain to be returned from the table.
+ *
+ * \result
+ *      True if any objects remain, or false otherwise.
+ */
+bool
+TableScanner::hasNext()
+{
+    if (current != NULL) {
+        if (current->nextOffset < current->objects.size())
+            return true;
+
+        // We've returned all of the objects from the last response for
+        // this range; its next RPC can be started now.
+        current = NULL;
+    }
+    if (ranges.empty())
+        findRanges();
+
+    while (true) {
+        startRpcs();
+        if (outstandingRpcs == 0)
+            return false;
+
+        for (Range& range : ranges) {
+            if (!range.rpc || !range.rpc->isReady())
+                continue;
+            range.nextHash = range.rpc->wait(range.state);
+            range.rpc.destroy();
+            outstandingRpcs--;
+            if (range.objects.size() > 0) {
+                range.nextOffset = 0;
+                current = &range;
+                return true;
+            }
+
+            // An empty response means that the server has no more objects
+            // for us, and nextHash refers to the next tablet. Note: if this
+            // is the last tablet in the table, nextHash rolls around to 0.
+            if (range.nextHash == 0 || range.nextHash > range.lastHash)
+                range.done = true;
+        }
+        ramcloud.poll();
+    }
+}
+
+/**
+ * Return the next object in the table. Objects are returned in no
+ * particular order. Note: each object that existed throughout the entire
+ * lifetime of the scan (and matches its filters) is guaranteed to be
+ * returned exactly once. Objects that are created after the scan starts,
+ * or that are deleted before the scan completes, will be returned either
+ * 0 or 1 time.
+ *
+ * \param[out] size
+ *      After a successful return, this field will hold the size of
+ *      the object in bytes.
+ * \param[out] object
+ *      After a successful return, this will point to contiguous
+ *      memory containing an instance of Object immediately followed
+ *      by its key and data payloads. The memory remains valid until
+ *      the next call to hasNext or next. NULL is returned to indicate
+ *      that the scan is complete.
+ */
+void
+TableScanner::next(uint32_t* size, const void** object)
+{
+    *size = 0;
+    *object = NULL;
+
+    if (!hasNext())
+        return;
+
+    uint32_t objectSize = *current->objects.getOffset<uint32_t>(
+            current->nextOffset);
+    current->nextOffset += downCast<uint32_t>(sizeof(uint32_t));
+
+    *object = current->objects.getRange(current->nextOffset, objectSize);
+    *size = objectSize;
+    current->nextOffset += objectSize;
+}
+
+/**
+ * Returns the next object in the scan, if any, with a more convenient
+ * interface than hasNext and next.
+ *
+ * \param[out] keyLength
+ *      After successful return, this field holds the size of the key in bytes.
+ * \param[out] key
+ *      After a successful return, this points to contiguous memory containing
+ *      the key. NULL is returned to indicate the scan is complete.
+ * \param[out] dataLength
+ *      After successful return, this field holds the size of the data in
+ *      bytes.
+ * \param[out] data
+ *      After a successful return, this points to contiguous memory containing
+ *      the data. If the keysOnly flag was set when constructing the
+ *      TableScanner, NULL is returned.
+ */
+void
+TableScanner::nextKeyAndData(uint32_t* keyLength, const void** key,
+                             uint32_t* dataLength, const void** data)
+{
+    *keyLength = 0;
+    *key = NULL;
+    *dataLength = 0;
+    *data = NULL;
+
+    uint32_t size = 0;
+    const void* buffer = NULL;
+    next(&size, &buffer);
+    if (buffer == NULL)
+        return;
+
+    Object object(buffer, size);
+    *keyLength = object.getKeyLength();
+    *key = object.getKey();
+
+    if (!keysOnly) {
+        *data = object.getValue(dataLength);
+    }
+}
+
+/**
+ * Divide the table into one range for each of its tablets, using the
+ * client's cached tablet map. The map doesn't need to be up to date:
+ * if tablets have been split, merged, or moved, scans of a range will
+ * still visit every tablet that overlaps it.
+ */
+void
+TableScanner::findRanges()
+{
+    uint64_t firstHash = 0;
+    while (true) {
+        uint64_t lastHash = ramcloud.clientContext->objectFinder->
+                lookupTablet(tableId, firstHash)->tablet.endKeyHash;
+        ranges.emplace_back(firstHash, lastHash);
+        if (lastHash == ~0UL)
+            break;
+        firstHash = lastHash + 1;
+    }
+}
+
+/**
+ * Start SCAN RPCs for ranges that need more objects, subject to the limit
+ * on outstanding RPCs.
+ */
+void
+TableScanner::startRpcs()
+{
+    for (Range& range : ranges) {
+        if (outstandingRpcs >= maxParallelRpcs)
+            return;
+        if (range.done || range.rpc || &range == current)
+            continue;
+        range.rpc.construct(&ramcloud, tableId, keysOnly, range.nextHash,
+                range.lastHash,
+                keyPrefix.empty() ? NULL : keyPrefix.data(),
+                downCast<uint16_t>(keyPrefix.size()), minVersion,
+                range.state, range.objects, maxPayloadBytes);
+        outstandingRpcs++;
+    }
+}
+
+} // namespace RAMCloud
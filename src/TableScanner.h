@@ -0,0 +1,139 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_TABLESCANNER_H
+#define RAMCLOUD_TABLESCANNER_H
+
+#include <list>
+
+#include "RamCloud.h"
+#include "Object.h"
+
+namespace RAMCloud {
+
+/**
+ * This class provides a faster alternative to TableEnumerator for reading
+ * all of the objects in a table (or all of the objects that match a key
+ * prefix or are newer than a given version). The table is divided into
+ * ranges of key hashes, one per tablet, and the ranges are scanned in
+ * parallel with SCAN RPCs, so masters stream objects concurrently instead
+ * of one at a time. Filtering happens on the masters, so objects that
+ * don't match are never sent to the client.
+ *
+ * Objects are returned in no particular order; as with TableEnumerator,
+ * each object that exists throughout the scan is returned exactly once.
+ */
+class TableScanner {
+  public:
+    TableScanner(RamCloud& ramcloud, uint64_t tableId, bool keysOnly = false,
+                 const void* keyPrefix = NULL, uint16_t keyPrefixLength = 0,
+                 uint64_t minVersion = 0,
+                 uint32_t maxParallelRpcs = DEFAULT_MAX_PARALLEL_RPCS);
+    ~TableScanner() {}
+    bool hasNext();
+    void next(uint32_t* size, const void** object);
+    void nextKeyAndData(uint32_t* keyLength, const void** key,
+                        uint32_t* dataLength, const void** data);
+
+    /// Default for the largest number of SCAN RPCs outstanding at once.
+    /// Each response may be several megabytes, so this also bounds the
+    /// client's memory usage.
+    static const uint32_t DEFAULT_MAX_PARALLEL_RPCS = 8;
+
+  PRIVATE:
+    /**
+     * The state of the scan for one range of key hashes (initially, the
+     * range covered by one tablet).
+     */
+    struct Range {
+        Range(uint64_t firstHash, uint64_t lastHash)
+            : nextHash(firstHash)
+            , lastHash(lastHash)
+            , done(false)
+            , state()
+            , objects()
+            , nextOffset(0)
+            , rpc()
+        {}
+
+        /// Where the next SCAN RPC for this range should start.
+        uint64_t nextHash;
+
+        /// The largest key hash in this range.
+        uint64_t lastHash;
+
+        /// Set to true once all of the objects in the range have
+        /// been retrieved.
+        bool done;
+
+        /// Opaque state of the scan, managed by the servers.
+        Buffer state;
+
+        /// Objects returned by the most recent SCAN RPC for this range.
+        Buffer objects;
+
+        /// The next offset to read within objects.
+        uint32_t nextOffset;
+
+        /// The outstanding SCAN RPC for this range, if any.
+        Tub<ScanTableRpc> rpc;
+
+        DISALLOW_COPY_AND_ASSIGN(Range);
+    };
+
+    void findRanges();
+    void startRpcs();
+
+    /// The RamCloud master object.
+    RamCloud& ramcloud;
+
+    /// The table being scanned.
+    uint64_t tableId;
+
+    /// False means that full objects are returned, containing both keys
+    /// and data. True means that the returned objects have been truncated
+    /// so that the object data is omitted.
+    bool keysOnly;
+
+    /// Only objects whose primary keys start with this are returned.
+    string keyPrefix;
+
+    /// Only objects with versions at least this large are returned.
+    uint64_t minVersion;
+
+    /// Largest number of SCAN RPCs outstanding at once.
+    uint32_t maxParallelRpcs;
+
+    /// Passed to the servers to limit the size of each response; 0 means
+    /// the servers choose (overridden by tests).
+    uint32_t maxPayloadBytes;
+
+    /// All of the ranges in the table; empty until the first call to
+    /// hasNext.
+    std::list<Range> ranges;
+
+    /// The range whose objects are currently being returned by next,
+    /// or NULL if none.
+    Range* current;
+
+    /// Number of ranges with SCAN RPCs outstanding.
+    uint32_t outstandingRpcs;
+
+    DISALLOW_COPY_AND_ASSIGN(TableScanner);
+};
+
+} // end RAMCloud
+
+#endif  // RAMCLOUD_TABLESCANNER_H
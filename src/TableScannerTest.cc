@@ -0,0 +1,180 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <set>
+
+#include "TestUtil.h"
+#include "MockCluster.h"
+#include "TableScanner.h"
+
+namespace RAMCloud {
+
+class TableScannerTest : public ::testing::Test {
+  public:
+    TestLog::Enable logEnabler;
+    Context context;
+    MockCluster cluster;
+    RamCloud ramcloud;
+    uint64_t tableId1;
+    uint64_t versions[5];
+
+  public:
+    TableScannerTest()
+        : logEnabler()
+        , context()
+        , cluster(&context)
+        , ramcloud(&context, "mock:host=coordinator")
+        , tableId1(-1)
+        , versions()
+    {
+        Logger::get().setLogLevels(RAMCloud::SILENT_LOG_LEVEL);
+
+        ServerConfig config = ServerConfig::forTesting();
+        config.services = {WireFormat::MASTER_SERVICE,
+                           WireFormat::ADMIN_SERVICE};
+        config.localLocator = "mock:host=master1";
+        cluster.addServer(config);
+        config.localLocator = "mock:host=master2";
+        cluster.addServer(config);
+
+        tableId1 = ramcloud.createTable("table1", 2);
+        ramcloud.write(tableId1, "a0", 2, "abcdef", 6, NULL, &versions[0]);
+        ramcloud.write(tableId1, "a1", 2, "ghijkl", 6, NULL, &versions[1]);
+        ramcloud.write(tableId1, "b2", 2, "mnopqr", 6, NULL, &versions[2]);
+        ramcloud.write(tableId1, "b3", 2, "stuvwx", 6, NULL, &versions[3]);
+        ramcloud.write(tableId1, "a4", 2, "yzabcd", 6, NULL, &versions[4]);
+    }
+
+    /**
+     * Read all of the objects from a scanner and return a string
+     * describing them (in key order, since the scanner returns objects
+     * in no particular order).
+     */
+    string
+    drain(TableScanner& scanner)
+    {
+        std::set<string> objects;
+        uint32_t keyLength, dataLength;
+        const void* key;
+        const void* data;
+        while (scanner.hasNext()) {
+            scanner.nextKeyAndData(&keyLength, &key, &dataLength, &data);
+            string object(static_cast<const char*>(key), keyLength);
+            if (data != NULL) {
+                object += ":";
+                object.append(static_cast<const char*>(data), dataLength);
+            }
+            objects.insert(object);
+        }
+        string result;
+        for (const string& object : objects) {
+            if (!result.empty())
+                result += " ";
+            result += object;
+        }
+        return result;
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(TableScannerTest);
+};
+
+TEST_F(TableScannerTest, basics) {
+    TableScanner scanner(ramcloud, tableId1);
+    EXPECT_EQ("a0:abcdef a1:ghijkl a4:yzabcd b2:mnopqr b3:stuvwx",
+            drain(scanner));
+    EXPECT_EQ(2U, scanner.ranges.size());
+    EXPECT_EQ(0U, scanner.outstandingRpcs);
+    EXPECT_FALSE(scanner.hasNext());
+}
+
+TEST_F(TableScannerTest, next) {
+    TableScanner scanner(ramcloud, tableId1, false, "b3", 2);
+    uint32_t size;
+    const void* object;
+    scanner.next(&size, &object);
+    Object object1(object, size);
+    EXPECT_EQ(35U, size);
+    EXPECT_EQ(tableId1, object1.getTableId());
+    EXPECT_EQ(versions[3], object1.getVersion());
+    EXPECT_EQ("stuvwx", string(reinterpret_cast<const char*>(
+            object1.getValue()), 6));
+
+    scanner.next(&size, &object);
+    EXPECT_EQ(0U, size);
+    EXPECT_TRUE(object == NULL);
+}
+
+TEST_F(TableScannerTest, keysOnly) {
+    TableScanner scanner(ramcloud, tableId1, true);
+    EXPECT_EQ("a0 a1 a4 b2 b3", drain(scanner));
+}
+
+TEST_F(TableScannerTest, keyPrefix) {
+    TableScanner scanner(ramcloud, tableId1, false, "a", 1);
+    EXPECT_EQ("a0:abcdef a1:ghijkl a4:yzabcd", drain(scanner));
+
+    TableScanner scanner2(ramcloud, tableId1, false, "c", 1);
+    EXPECT_FALSE(scanner2.hasNext());
+}
+
+TEST_F(TableScannerTest, minVersion) {
+    // Each master numbers versions on its own, so which objects are new
+    // enough depends on which master each key hashes to.
+    const char* keys[] = {"a0", "a1", "b2", "b3", "a4"};
+    std::set<string> newEnough;
+    for (int i = 0; i < 5; i++) {
+        if (versions[i] >= versions[2])
+            newEnough.insert(keys[i]);
+    }
+    string expected;
+    for (const string& key : newEnough) {
+        if (!expected.empty())
+            expected += " ";
+        expected += key;
+    }
+    EXPECT_EQ(1U, newEnough.count("b2"));
+    TableScanner scanner(ramcloud, tableId1, true, NULL, 0, versions[2]);
+    EXPECT_EQ(expected, drain(scanner));
+
+    // Objects on the other master may also be new enough.
+    const char* values[] = {"abcdef", "ghijkl", "mnopqr", "stuvwx",
+            "yzabcd"};
+    uint64_t version;
+    ramcloud.write(tableId1, "a0", 2, "new", 3, NULL, &version);
+    std::set<string> newObjects = {"a0:new"};
+    for (int i = 1; i < 5; i++) {
+        if (versions[i] >= version)
+            newObjects.insert(format("%s:%s", keys[i], values[i]));
+    }
+    expected.clear();
+    for (const string& object : newObjects) {
+        if (!expected.empty())
+            expected += " ";
+        expected += object;
+    }
+    TableScanner scanner2(ramcloud, tableId1, false, NULL, 0, version);
+    EXPECT_EQ(expected, drain(scanner2));
+}
+
+TEST_F(TableScannerTest, manyRpcs) {
+    // Force each response to hold a single object, and allow only one
+    // RPC at a time.
+    TableScanner scanner(ramcloud, tableId1, false, NULL, 0, 0, 1);
+    scanner.maxPayloadBytes = 50;
+    EXPECT_EQ("a0:abcdef a1:ghijkl a4:yzabcd b2:mnopqr b3:stuvwx",
+            drain(scanner));
+}
+
+} // namespace RAMCloud
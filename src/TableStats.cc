@@ -164,6 +164,46 @@ decrement(MasterTableMetadata* mtm,
     }
 }
 
+/**
+ * Estimate how many bytes of live log data a master holds for part of a
+ * table, assuming the table's data is spread evenly over the key hashes
+ * the master owns. Used to report tablet sizes to the coordinator.
+ *
+ * \param mtm
+ *      Pointer to MasterTableMetadata container that is storing the current
+ *      stats information.  Must not be NULL.
+ * \param tableId
+ *      Id of table whose data is to be estimated.
+ * \param startKeyHash
+ *      First key hash value of the range to estimate.
+ * \param endKeyHash
+ *      Last key hash value of the range to estimate.
+ * \return
+ *      Estimated number of bytes; 0 if the master has no stats for the table.
+ */
+uint64_t
+estimateBytes(MasterTableMetadata* mtm,
+              uint64_t tableId,
+              uint64_t startKeyHash,
+              uint64_t endKeyHash)
+{
+    MasterTableMetadata::Entry* entry;
+    entry = mtm->find(tableId);
+    if (entry == NULL)
+        return 0;
+
+    SpinLock::Guard _(entry->stats.lock);
+    double keyHashCount = static_cast<double>(entry->stats.keyHashCount);
+    if (entry->stats.totalOwnership)
+        keyHashCount = 18446744073709551616.0; // 2^64
+    if (keyHashCount == 0)
+        return 0;
+    double rangeSize = static_cast<double>(endKeyHash - startKeyHash) + 1;
+    return static_cast<uint64_t>(
+            static_cast<double>(entry->stats.byteCount) * rangeSize /
+            keyHashCount);
+}
+
 
 /**
  * Compress and serialize all table stats information in the MasterTableMetadata
@@ -88,6 +88,10 @@ void decrement(MasterTableMetadata* mtm,
                uint64_t tableId,
                uint64_t byteCount,
                uint64_t recordCount);
+uint64_t estimateBytes(MasterTableMetadata* mtm,
+                       uint64_t tableId,
+                       uint64_t startKeyHash,
+                       uint64_t endKeyHash);
 void serialize(Buffer* buf, MasterTableMetadata *mtm);
 
 /**
@@ -175,6 +175,22 @@ TEST_F(TableStatsTest, decrement) {
     }
 }
 
+TEST_F(TableStatsTest, estimateBytes) {
+    EXPECT_EQ(0U, TableStats::estimateBytes(&mtm, 1, 0, 9));
+
+    TableStats::addKeyHashRange(&mtm, 1, 0, 9);
+    TableStats::addKeyHashRange(&mtm, 1, 20, 29);
+    TableStats::increment(&mtm, 1, 1000, 10);
+    EXPECT_EQ(500U, TableStats::estimateBytes(&mtm, 1, 0, 9));
+    EXPECT_EQ(250U, TableStats::estimateBytes(&mtm, 1, 20, 24));
+
+    // Master owns the entire table.
+    TableStats::addKeyHashRange(&mtm, 2, 0, ~0UL);
+    TableStats::increment(&mtm, 2, 1000, 10);
+    EXPECT_EQ(1000U, TableStats::estimateBytes(&mtm, 2, 0, ~0UL));
+    EXPECT_EQ(500U, TableStats::estimateBytes(&mtm, 2, 0, ~0UL >> 1));
+}
+
 TEST_F(TableStatsTest, serialize_basic) {
     // First Check an empty mtm.
     {
@@ -0,0 +1,479 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <cmath>
+
+#include "TabletBalancer.h"
+#include "ClientException.h"
+#include "CoordinatorServerList.h"
+#include "Cycles.h"
+#include "MasterClient.h"
+#include "ShortMacros.h"
+#include "TabletManager.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct a TabletBalancer; it doesn't run until start() is called.
+ *
+ * \param context
+ *      Overall information about the coordinator.
+ * \param tableManager
+ *      Coordinator's table manager; used to split tablets and to check
+ *      ownership before migrating.
+ * \param intervalSeconds
+ *      Seconds between polls of the masters. 0 disables the balancer.
+ */
+TabletBalancer::TabletBalancer(Context* context, TableManager* tableManager,
+                               double intervalSeconds)
+    : context(context)
+    , tableManager(tableManager)
+    , intervalSeconds(intervalSeconds)
+    , samples()
+    , lastPollTime(0)
+    , mutex()
+    , stopRequested(false)
+    , stopping()
+    , thread()
+{
+}
+
+/**
+ * Destructor: stops the balancer if it is running.
+ */
+TabletBalancer::~TabletBalancer()
+{
+    stop();
+}
+
+/**
+ * Begin polling masters and rebalancing, unless the balancer was constructed
+ * with a polling interval of 0.
+ */
+void
+TabletBalancer::start()
+{
+    if (intervalSeconds <= 0 || thread)
+        return;
+    LOG(NOTICE, "Tablet balancer polling masters every %.1f seconds",
+            intervalSeconds);
+    stopRequested = false;
+    thread.construct(&TabletBalancer::main, this);
+}
+
+/**
+ * Stop polling; returns once any poll in progress has finished.
+ */
+void
+TabletBalancer::stop()
+{
+    if (!thread)
+        return;
+    {
+        std::lock_guard<std::mutex> _(mutex);
+        stopRequested = true;
+        stopping.notify_one();
+    }
+    thread->join();
+    thread.destroy();
+}
+
+/**
+ * Top-level method of the balancer's thread: runs poll() once every
+ * polling interval until stop() is called.
+ */
+void
+TabletBalancer::main()
+{
+    std::chrono::nanoseconds interval(
+            static_cast<int64_t>(intervalSeconds * 1e09));
+    std::unique_lock<std::mutex> lock(mutex);
+    std::chrono::steady_clock::time_point nextPoll =
+            std::chrono::steady_clock::now() + interval;
+    while (!stopping.wait_until(lock, nextPoll,
+                                [this] { return stopRequested; })) {
+        nextPoll += interval;
+        lock.unlock();
+        poll();
+        lock.lock();
+    }
+}
+
+/**
+ * Collect load information from all masters and, if the previous poll
+ * provides a baseline, take at most one step to even out the load.
+ */
+void
+TabletBalancer::poll()
+{
+    vector<TabletLoad> loads;
+    vector<ServerId> masters;
+    bool haveBaseline = !samples.empty();
+    collect(&loads, &masters);
+    if (!haveBaseline)
+        return;
+
+    Action action = plan(loads, masters);
+    if (action.type == Action::NONE)
+        return;
+    execute(action);
+
+    // The layout has changed, so rates measured against the old samples
+    // no longer describe any master. Start over with a fresh baseline.
+    samples.clear();
+}
+
+/**
+ * Ask every master for its tablet statistics and compute the load on each
+ * tablet since the previous call. #samples is replaced with the counts
+ * just collected.
+ *
+ * \param[out] loads
+ *      Filled in with the load on each tablet that was also present (with
+ *      the same owner and key hash range) at the previous call.
+ * \param[out] masters
+ *      Filled in with the masters that responded.
+ */
+void
+TabletBalancer::collect(vector<TabletLoad>* loads, vector<ServerId>* masters)
+{
+    // Send all of the requests before waiting for any of them.
+    vector<ServerId> ids;
+    ServerId id;
+    while (1) {
+        bool end;
+        id = context->coordinatorServerList->nextServer(id,
+                ServiceMask({WireFormat::MASTER_SERVICE}), &end);
+        if (end)
+            break;
+        ids.push_back(id);
+    }
+    std::unique_ptr<Tub<GetMasterStatisticsRpc>[]> rpcs(
+            new Tub<GetMasterStatisticsRpc>[ids.size()]);
+    for (size_t i = 0; i < ids.size(); i++)
+        rpcs[i].construct(context, ids[i]);
+
+    uint64_t now = Cycles::rdtsc();
+    double elapsed = Cycles::toSeconds(now - lastPollTime);
+    lastPollTime = now;
+
+    std::map<TabletKey, Sample> newSamples;
+    for (size_t i = 0; i < ids.size(); i++) {
+        ProtoBuf::ServerStatistics stats;
+        try {
+            rpcs[i]->wait(stats);
+        } catch (ServerNotUpException& e) {
+            continue;
+        } catch (ClientException& e) {
+            LOG(WARNING, "Couldn't get tablet statistics from master %s: %s",
+                    ids[i].toString().c_str(), e.toString());
+            continue;
+        }
+        masters->push_back(ids[i]);
+
+        for (int t = 0; t < stats.tabletentry_size(); t++) {
+            const ProtoBuf::ServerStatistics_TabletEntry& entry =
+                    stats.tabletentry(t);
+            TabletKey key(entry.table_id(), entry.start_key_hash(),
+                    entry.end_key_hash(), ids[i].getId());
+            Sample& sample = newSamples[key];
+            sample.operations = entry.number_read_and_writes();
+            sample.histogram.assign(entry.load_histogram().begin(),
+                    entry.load_histogram().end());
+
+            std::map<TabletKey, Sample>::iterator previous = samples.find(key);
+            if (previous == samples.end() ||
+                    previous->second.operations > sample.operations)
+                continue;
+
+            TabletLoad load;
+            load.tableId = entry.table_id();
+            load.startKeyHash = entry.start_key_hash();
+            load.endKeyHash = entry.end_key_hash();
+            load.serverId = ids[i];
+            load.bytes = entry.byte_count();
+            load.opsPerSecond = static_cast<double>(sample.operations -
+                    previous->second.operations) / elapsed;
+            if (sample.histogram.size() ==
+                    previous->second.histogram.size()) {
+                for (size_t b = 0; b < sample.histogram.size(); b++) {
+                    load.histogram.push_back(static_cast<double>(
+                            sample.histogram[b] -
+                            previous->second.histogram[b]) / elapsed);
+                }
+            } else if (previous->second.histogram.empty()) {
+                for (size_t b = 0; b < sample.histogram.size(); b++) {
+                    load.histogram.push_back(static_cast<double>(
+                            sample.histogram[b]) / elapsed);
+                }
+            }
+            loads->push_back(load);
+        }
+    }
+    samples.swap(newSamples);
+}
+
+/**
+ * Carry out a step chosen by plan(). Failures are logged and otherwise
+ * ignored; the next poll will reconsider.
+ *
+ * \param action
+ *      Step to carry out; type must not be NONE.
+ */
+void
+TabletBalancer::execute(const Action& action)
+{
+    try {
+        // Tablets backing secondary indexes are placed along with their
+        // indexlets; leave them alone.
+        if (tableManager->isIndexletTable(action.tableId))
+            return;
+
+        // Make sure the tablet hasn't changed since the master reported it.
+        Tablet tablet = tableManager->getTablet(action.tableId,
+                action.startKeyHash);
+        if (tablet.startKeyHash != action.startKeyHash ||
+                tablet.endKeyHash != action.endKeyHash ||
+                tablet.serverId != action.serverId ||
+                tablet.status != Tablet::NORMAL)
+            return;
+
+        if (action.type == Action::SPLIT) {
+            LOG(NOTICE, "Splitting hot tablet [0x%lx,0x%lx] of table %lu "
+                    "on master %s at key hash 0x%lx", action.startKeyHash,
+                    action.endKeyHash, action.tableId,
+                    action.serverId.toString().c_str(), action.splitKeyHash);
+            tableManager->splitTablet(action.tableId, action.splitKeyHash);
+        } else {
+            LOG(NOTICE, "Migrating tablet [0x%lx,0x%lx] of table %lu "
+                    "from master %s to master %s to balance load",
+                    action.startKeyHash, action.endKeyHash, action.tableId,
+                    action.serverId.toString().c_str(),
+                    action.newOwner.toString().c_str());
+            MasterClient::migrateMasterTablet(context, action.serverId,
+                    action.tableId, action.startKeyHash, action.endKeyHash,
+                    action.newOwner);
+        }
+    } catch (TableManager::NoSuchTable& e) {
+    } catch (TableManager::NoSuchTablet& e) {
+    } catch (ServerNotUpException& e) {
+        LOG(NOTICE, "Tablet balancer step skipped: master %s isn't up",
+                action.serverId.toString().c_str());
+    } catch (ClientException& e) {
+        LOG(WARNING, "Tablet balancer couldn't %s tablet [0x%lx,0x%lx] of "
+                "table %lu: %s",
+                action.type == Action::SPLIT ? "split" : "migrate",
+                action.startKeyHash, action.endKeyHash, action.tableId,
+                e.toString());
+    }
+}
+
+/**
+ * Decide what, if anything, to do about the current load. Splitting a hot
+ * tablet takes priority over migration, since a tablet carrying more than
+ * a master's share of the load can't be placed well.
+ *
+ * \param loads
+ *      Load on each tablet over the most recent interval.
+ * \param masters
+ *      All masters that are up, including any that own no tablets.
+ * \return
+ *      The step to take.
+ */
+TabletBalancer::Action
+TabletBalancer::plan(const vector<TabletLoad>& loads,
+                     const vector<ServerId>& masters)
+{
+    if (masters.size() < 2)
+        return Action();
+    Action action = planSplit(loads, masters);
+    if (action.type == Action::NONE)
+        action = planMigration(loads, masters);
+    return action;
+}
+
+/**
+ * Find the hottest tablet and, if it is hot enough to be worth splitting,
+ * choose where to split it.
+ *
+ * \param loads
+ *      Load on each tablet over the most recent interval.
+ * \param masters
+ *      All masters that are up.
+ * \return
+ *      A SPLIT action, or NONE if no tablet needs splitting.
+ */
+TabletBalancer::Action
+TabletBalancer::planSplit(const vector<TabletLoad>& loads,
+                          const vector<ServerId>& masters)
+{
+    double totalOps = 0;
+    const TabletLoad* hottest = NULL;
+    for (const TabletLoad& load : loads) {
+        totalOps += load.opsPerSecond;
+        if (hottest == NULL || load.opsPerSecond > hottest->opsPerSecond)
+            hottest = &load;
+    }
+    if (hottest == NULL || hottest->opsPerSecond < MIN_SPLIT_OPS_PER_SECOND)
+        return Action();
+    double share = totalOps / static_cast<double>(masters.size());
+    if (hottest->opsPerSecond <= HOT_TABLET_FRACTION * share)
+        return Action();
+
+    uint64_t splitKeyHash = chooseSplitKeyHash(*hottest);
+    if (splitKeyHash == 0)
+        return Action();
+    Action action;
+    action.type = Action::SPLIT;
+    action.tableId = hottest->tableId;
+    action.startKeyHash = hottest->startKeyHash;
+    action.endKeyHash = hottest->endKeyHash;
+    action.serverId = hottest->serverId;
+    action.splitKeyHash = splitKeyHash;
+    return action;
+}
+
+/**
+ * Choose a tablet to move from the most heavily loaded master to the least
+ * loaded one. A master's load is the larger of its request rate and its
+ * memory use, each relative to the cluster average; the tablet chosen is
+ * the one whose move leaves the higher of the two masters' loads lowest.
+ *
+ * \param loads
+ *      Load on each tablet over the most recent interval.
+ * \param masters
+ *      All masters that are up, including any that own no tablets.
+ * \return
+ *      A MIGRATE action, or NONE if the masters are balanced within
+ *      IMBALANCE_TOLERANCE or no move would help.
+ */
+TabletBalancer::Action
+TabletBalancer::planMigration(const vector<TabletLoad>& loads,
+                              const vector<ServerId>& masters)
+{
+    std::map<ServerId, std::pair<double, double>> perMaster;
+    for (const ServerId& master : masters)
+        perMaster[master] = {0, 0};
+    double totalOps = 0, totalBytes = 0;
+    for (const TabletLoad& load : loads) {
+        std::pair<double, double>& m = perMaster[load.serverId];
+        m.first += load.opsPerSecond;
+        m.second += static_cast<double>(load.bytes);
+        totalOps += load.opsPerSecond;
+        totalBytes += static_cast<double>(load.bytes);
+    }
+    double count = static_cast<double>(masters.size());
+    double averageOps = totalOps / count;
+    double averageBytes = totalBytes / count;
+    auto score = [&](double ops, double bytes) {
+        double s = 0;
+        if (averageOps > 0)
+            s = std::max(s, ops / averageOps);
+        if (averageBytes > 0)
+            s = std::max(s, bytes / averageBytes);
+        return s;
+    };
+
+    ServerId busiest, idlest;
+    double busiestScore = 0, idlestScore = 0;
+    for (const ServerId& master : masters) {
+        double s = score(perMaster[master].first, perMaster[master].second);
+        if (!busiest.isValid() || s > busiestScore) {
+            busiest = master;
+            busiestScore = s;
+        }
+        if (!idlest.isValid() || s < idlestScore) {
+            idlest = master;
+            idlestScore = s;
+        }
+    }
+    if (busiestScore <= 1 + IMBALANCE_TOLERANCE)
+        return Action();
+
+    const std::pair<double, double>& from = perMaster[busiest];
+    const std::pair<double, double>& to = perMaster[idlest];
+    const TabletLoad* best = NULL;
+    double bestScore = busiestScore;
+    for (const TabletLoad& load : loads) {
+        if (load.serverId != busiest)
+            continue;
+        double bytes = static_cast<double>(load.bytes);
+        double after = std::max(
+                score(from.first - load.opsPerSecond, from.second - bytes),
+                score(to.first + load.opsPerSecond, to.second + bytes));
+        if (after < bestScore) {
+            best = &load;
+            bestScore = after;
+        }
+    }
+    if (best == NULL)
+        return Action();
+
+    Action action;
+    action.type = Action::MIGRATE;
+    action.tableId = best->tableId;
+    action.startKeyHash = best->startKeyHash;
+    action.endKeyHash = best->endKeyHash;
+    action.serverId = busiest;
+    action.newOwner = idlest;
+    return action;
+}
+
+/**
+ * Choose the slice boundary in a tablet's load histogram that comes closest
+ * to dividing its load in half. If nearly all of the load falls in one
+ * slice, this splits off that slice; the next poll then sees the hot range
+ * at finer granularity.
+ *
+ * \param load
+ *      Tablet to split.
+ * \return
+ *      The first key hash of the upper half, or 0 if the tablet can't be
+ *      split usefully (no accesses were recorded, or its key hash range is
+ *      too small to divide into slices).
+ */
+uint64_t
+TabletBalancer::chooseSplitKeyHash(const TabletLoad& load)
+{
+    uint32_t buckets = downCast<uint32_t>(load.histogram.size());
+    uint64_t range = load.endKeyHash - load.startKeyHash;
+    if (buckets < 2 || range / buckets < buckets)
+        return 0;
+    double total = 0;
+    for (double ops : load.histogram)
+        total += ops;
+    if (total <= 0)
+        return 0;
+
+    // Find the slice containing the median request, then split at
+    // whichever of its edges comes closer to dividing the load in half.
+    uint32_t median = 0;
+    double below = 0;
+    while (below + load.histogram[median] < total / 2) {
+        below += load.histogram[median];
+        median++;
+    }
+    double above = below + load.histogram[median];
+    uint32_t bestBoundary = median;
+    if (median == 0 || (median + 1 < buckets &&
+            std::abs(above - total / 2) < std::abs(below - total / 2)))
+        bestBoundary = median + 1;
+
+    // Slices are computed the same way as in TabletManager::Tablet.
+    uint64_t bucketWidth = range / buckets + 1;
+    return load.startKeyHash + bestBoundary * bucketWidth;
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,240 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_TABLETBALANCER_H
+#define RAMCLOUD_TABLETBALANCER_H
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <tuple>
+
+#include "Common.h"
+#include "Context.h"
+#include "ServerId.h"
+#include "TableManager.h"
+#include "Tub.h"
+
+namespace RAMCloud {
+
+/**
+ * The TabletBalancer, a module that runs on the coordinator, spreads load
+ * across masters without operator involvement. Every few seconds it asks
+ * each master for the number of reads and writes performed on each of its
+ * tablets (and how those accesses are distributed over the tablet's key
+ * hash range) along with an estimate of each tablet's size. From the change
+ * since the previous poll it computes per-tablet request rates, and then
+ * takes at most one step:
+ *  (1) A tablet carrying a large share of the cluster's requests is split
+ *      at the key hash that divides its load (not its key hash range) in
+ *      half, so that the halves can be placed on different masters.
+ *  (2) Otherwise, if some master's request rate or memory use is well above
+ *      the cluster average, one of its tablets is migrated to the least
+ *      loaded master.
+ * Each step invalidates the rates measured so far, so the next decision is
+ * made only after a full interval has been observed with the new layout.
+ *
+ * This makes it unnecessary to choose a serverSpan for each table by hand
+ * to avoid hotspots: tables can be created on a single master and will be
+ * split and spread as load arrives.
+ *
+ * The balancer is disabled unless it is given a nonzero polling interval.
+ * All of its work happens on a thread of its own: a migration can take
+ * a long time, and it mustn't hold up the coordinator's WorkerTimers in the
+ * meantime. Since there is only one such thread, the balancer is never
+ * invoked concurrently with itself.
+ */
+class TabletBalancer {
+  PUBLIC:
+    /**
+     * Load on a single tablet, measured over the most recent interval.
+     */
+    struct TabletLoad {
+        TabletLoad()
+            : tableId(0)
+            , startKeyHash(0)
+            , endKeyHash(0)
+            , serverId()
+            , opsPerSecond(0)
+            , bytes(0)
+            , histogram()
+        {}
+
+        /// Table containing the tablet.
+        uint64_t tableId;
+
+        /// First key hash in the tablet.
+        uint64_t startKeyHash;
+
+        /// Last key hash in the tablet.
+        uint64_t endKeyHash;
+
+        /// Master that owns the tablet.
+        ServerId serverId;
+
+        /// Reads plus writes per second.
+        double opsPerSecond;
+
+        /// Estimated bytes of live data in the tablet.
+        uint64_t bytes;
+
+        /**
+         * Reads plus writes per second in each of
+         * TabletManager::LOAD_HISTOGRAM_BUCKETS equal slices of the tablet's
+         * key hash range; empty if the master reported no accesses.
+         */
+        vector<double> histogram;
+    };
+
+    /**
+     * A step chosen by plan().
+     */
+    struct Action {
+        enum Type {
+            /// The cluster is balanced well enough; do nothing.
+            NONE,
+            /// Split the tablet at #splitKeyHash.
+            SPLIT,
+            /// Move the tablet from #serverId to #newOwner.
+            MIGRATE,
+        };
+
+        Action()
+            : type(NONE)
+            , tableId(0)
+            , startKeyHash(0)
+            , endKeyHash(0)
+            , serverId()
+            , splitKeyHash(0)
+            , newOwner()
+        {}
+
+        /// What to do.
+        Type type;
+
+        /// Table containing the tablet to split or migrate.
+        uint64_t tableId;
+
+        /// First key hash in the tablet to split or migrate.
+        uint64_t startKeyHash;
+
+        /// Last key hash in the tablet to split or migrate.
+        uint64_t endKeyHash;
+
+        /// Master that currently owns the tablet.
+        ServerId serverId;
+
+        /// For SPLIT: first key hash of the upper half.
+        uint64_t splitKeyHash;
+
+        /// For MIGRATE: master that should own the tablet afterwards.
+        ServerId newOwner;
+    };
+
+    TabletBalancer(Context* context, TableManager* tableManager,
+                   double intervalSeconds);
+    ~TabletBalancer();
+    void start();
+    void stop();
+
+  PRIVATE:
+    /**
+     * Identifies a tablet together with its owner, so that a tablet that has
+     * been split or migrated since the last poll is treated as a new tablet:
+     * (tableId, startKeyHash, endKeyHash, serverId).
+     */
+    typedef std::tuple<uint64_t, uint64_t, uint64_t, uint64_t> TabletKey;
+
+    /**
+     * Cumulative access counts reported by a master for one tablet at the
+     * most recent poll.
+     */
+    struct Sample {
+        Sample()
+            : operations(0)
+            , histogram()
+        {}
+
+        /// Reads plus writes since the master started counting.
+        uint64_t operations;
+
+        /// Reads plus writes in each slice of the key hash range.
+        vector<uint64_t> histogram;
+    };
+
+    /**
+     * A tablet whose share of the cluster's requests exceeds this fraction of
+     * an evenly divided share (total request rate / number of masters) is
+     * considered hot and is split.
+     */
+    static constexpr double HOT_TABLET_FRACTION = 0.5;
+
+    /// Tablets with fewer requests per second than this are never split.
+    static constexpr double MIN_SPLIT_OPS_PER_SECOND = 1000;
+
+    /**
+     * A master is considered overloaded if its request rate or memory use
+     * exceeds the cluster average by more than this fraction.
+     */
+    static constexpr double IMBALANCE_TOLERANCE = 0.2;
+
+    void main();
+    void poll();
+    void collect(vector<TabletLoad>* loads, vector<ServerId>* masters);
+    void execute(const Action& action);
+    static Action plan(const vector<TabletLoad>& loads,
+                       const vector<ServerId>& masters);
+    static Action planSplit(const vector<TabletLoad>& loads,
+                            const vector<ServerId>& masters);
+    static Action planMigration(const vector<TabletLoad>& loads,
+                                const vector<ServerId>& masters);
+    static uint64_t chooseSplitKeyHash(const TabletLoad& load);
+
+    /// Shared information about the coordinator.
+    Context* context;
+
+    /// Used to split tablets and to check tablet ownership before acting.
+    TableManager* tableManager;
+
+    /// Seconds between polls; 0 means the balancer never runs.
+    double intervalSeconds;
+
+    /// Counts reported at the most recent poll, used to compute rates.
+    std::map<TabletKey, Sample> samples;
+
+    /// Cycles::rdtsc() time of the most recent poll.
+    uint64_t lastPollTime;
+
+    /// Protects #stopRequested.
+    std::mutex mutex;
+
+    /// Set by stop() to tell #thread to exit.
+    bool stopRequested;
+
+    /// Signaled when #stopRequested is set, so that #thread doesn't wait
+    /// out the rest of its polling interval.
+    std::condition_variable stopping;
+
+    /// Runs main(), which invokes poll() periodically. Empty unless the
+    /// balancer has been started.
+    Tub<std::thread> thread;
+
+    DISALLOW_COPY_AND_ASSIGN(TabletBalancer);
+};
+
+} // namespace RAMCloud
+
+#endif  // RAMCLOUD_TABLETBALANCER_H
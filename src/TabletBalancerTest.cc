@@ -0,0 +1,188 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "Cycles.h"
+#include "TabletBalancer.h"
+#include "TabletManager.h"
+
+namespace RAMCloud {
+
+class TabletBalancerTest : public ::testing::Test {
+  public:
+    typedef TabletBalancer::Action Action;
+    typedef TabletBalancer::TabletLoad TabletLoad;
+
+    vector<TabletLoad> loads;
+    vector<ServerId> masters;
+
+    TabletBalancerTest()
+        : loads()
+        , masters({ServerId(1, 0), ServerId(2, 0), ServerId(3, 0)})
+    {
+    }
+
+    // Add a tablet on master \a server with \a ops requests per second
+    // spread evenly over its key hash range.
+    TabletLoad&
+    addTablet(uint64_t tableId, uint64_t start, uint64_t end,
+              uint32_t server, double ops, uint64_t bytes = 0)
+    {
+        TabletLoad load;
+        load.tableId = tableId;
+        load.startKeyHash = start;
+        load.endKeyHash = end;
+        load.serverId = ServerId(server, 0);
+        load.opsPerSecond = ops;
+        load.bytes = bytes;
+        load.histogram.assign(TabletManager::LOAD_HISTOGRAM_BUCKETS,
+                ops / TabletManager::LOAD_HISTOGRAM_BUCKETS);
+        loads.push_back(load);
+        return loads.back();
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(TabletBalancerTest);
+};
+
+TEST_F(TabletBalancerTest, startAndStop) {
+    Context context;
+    TabletBalancer disabled(&context, NULL, 0);
+    disabled.start();
+    EXPECT_FALSE(disabled.thread);
+
+    TabletBalancer balancer(&context, NULL, 1000);
+    balancer.start();
+    EXPECT_TRUE(balancer.thread);
+    // stop() doesn't wait out the rest of the polling interval.
+    uint64_t start = Cycles::rdtsc();
+    balancer.stop();
+    EXPECT_LT(Cycles::toSeconds(Cycles::rdtsc() - start), 10.0);
+    EXPECT_FALSE(balancer.thread);
+    balancer.stop();
+}
+
+TEST_F(TabletBalancerTest, plan_singleMaster) {
+    masters.resize(1);
+    addTablet(1, 0, ~0UL, 1, 100000);
+    EXPECT_EQ(Action::NONE, TabletBalancer::plan(loads, masters).type);
+}
+
+TEST_F(TabletBalancerTest, planMigration_balanced) {
+    addTablet(1, 0, ~0UL, 1, 1000, 1000);
+    addTablet(2, 0, ~0UL, 2, 1100, 900);
+    addTablet(3, 0, ~0UL, 3, 900, 1100);
+    // Every master is within IMBALANCE_TOLERANCE of the average.
+    EXPECT_EQ(Action::NONE, TabletBalancer::planMigration(loads,
+            masters).type);
+}
+
+TEST_F(TabletBalancerTest, plan_splitBeforeMigrate) {
+    addTablet(1, 0, ~0UL, 1, 90000);
+    addTablet(2, 0, ~0UL, 1, 5000);
+    addTablet(3, 0, ~0UL, 2, 5000);
+    Action action = TabletBalancer::plan(loads, masters);
+    EXPECT_EQ(Action::SPLIT, action.type);
+    EXPECT_EQ(1U, action.tableId);
+    EXPECT_EQ(ServerId(1, 0), action.serverId);
+    EXPECT_EQ(1UL << 63, action.splitKeyHash);
+}
+
+TEST_F(TabletBalancerTest, planSplit_notHotEnough) {
+    // Too few requests overall.
+    addTablet(1, 0, ~0UL, 1, 900);
+    EXPECT_EQ(Action::NONE, TabletBalancer::planSplit(loads, masters).type);
+
+    // Below half of a master's share.
+    loads.clear();
+    addTablet(1, 0, ~0UL, 1, 4000);
+    for (uint64_t t = 2; t < 8; t++)
+        addTablet(t, 0, ~0UL, downCast<uint32_t>(t % 3 + 1), 4000);
+    EXPECT_EQ(Action::NONE, TabletBalancer::planSplit(loads, masters).type);
+}
+
+TEST_F(TabletBalancerTest, planSplit_tooSmall) {
+    addTablet(1, 1000, 1000 + 200, 1, 100000);
+    EXPECT_EQ(Action::NONE, TabletBalancer::planSplit(loads, masters).type);
+}
+
+TEST_F(TabletBalancerTest, planMigration_requests) {
+    addTablet(1, 0, 99, 1, 4000);
+    addTablet(1, 100, 199, 1, 3000);
+    addTablet(1, 200, 299, 1, 500);
+    addTablet(2, 0, ~0UL, 2, 1500);
+    Action action = TabletBalancer::planMigration(loads, masters);
+    EXPECT_EQ(Action::MIGRATE, action.type);
+    EXPECT_EQ(1U, action.tableId);
+    EXPECT_EQ(0U, action.startKeyHash);
+    EXPECT_EQ(99U, action.endKeyHash);
+    EXPECT_EQ(ServerId(1, 0), action.serverId);
+    EXPECT_EQ(ServerId(3, 0), action.newOwner);
+}
+
+TEST_F(TabletBalancerTest, planMigration_memory) {
+    addTablet(1, 0, 99, 1, 0, 6000);
+    addTablet(1, 100, 199, 1, 0, 2000);
+    addTablet(2, 0, ~0UL, 2, 0, 4000);
+    addTablet(3, 0, ~0UL, 3, 0, 3000);
+    Action action = TabletBalancer::planMigration(loads, masters);
+    EXPECT_EQ(Action::MIGRATE, action.type);
+    EXPECT_EQ(100U, action.startKeyHash);
+    EXPECT_EQ(ServerId(3, 0), action.newOwner);
+}
+
+TEST_F(TabletBalancerTest, planMigration_noMoveHelps) {
+    // A single tablet holds most of the load; moving it just moves the
+    // hotspot.
+    addTablet(1, 0, ~0UL, 1, 9000);
+    addTablet(2, 0, ~0UL, 2, 500);
+    addTablet(3, 0, ~0UL, 3, 500);
+    EXPECT_EQ(Action::NONE, TabletBalancer::planMigration(loads,
+            masters).type);
+}
+
+TEST_F(TabletBalancerTest, chooseSplitKeyHash) {
+    TabletLoad& load = addTablet(1, 0, ~0UL, 1, 1600);
+    EXPECT_EQ(1UL << 63, TabletBalancer::chooseSplitKeyHash(load));
+
+    // Load concentrated at the bottom of the range.
+    load.histogram.assign(16, 0);
+    load.histogram[0] = 300;
+    load.histogram[1] = 300;
+    load.histogram[2] = 200;
+    load.histogram[3] = 200;
+    load.histogram[15] = 10;
+    EXPECT_EQ(2UL << 60, TabletBalancer::chooseSplitKeyHash(load));
+
+    // All of the load in one slice: split it off.
+    load.histogram.assign(16, 0);
+    load.histogram[0] = 1000;
+    EXPECT_EQ(1UL << 60, TabletBalancer::chooseSplitKeyHash(load));
+    load.histogram[0] = 0;
+    load.histogram[7] = 1000;
+    EXPECT_EQ(7UL << 60, TabletBalancer::chooseSplitKeyHash(load));
+
+    // Split points fall at the slice boundaries used by TabletManager.
+    TabletLoad& small = addTablet(1, 100, 100 + 16 * 20 - 1, 1, 1600);
+    EXPECT_EQ(100U + 8 * 20, TabletBalancer::chooseSplitKeyHash(small));
+}
+
+TEST_F(TabletBalancerTest, chooseSplitKeyHash_cantSplit) {
+    TabletLoad& load = addTablet(1, 0, ~0UL, 1, 0);
+    EXPECT_EQ(0U, TabletBalancer::chooseSplitKeyHash(load));
+    load.histogram.clear();
+    EXPECT_EQ(0U, TabletBalancer::chooseSplitKeyHash(load));
+}
+
+}  // namespace RAMCloud
@@ -95,6 +95,7 @@ TabletManager::checkAndIncrementReadCount(Key& key) {
     }
 
     it->second.readCount++;
+    it->second.countAccess(key.getHash());
     return true;
 }
 
@@ -299,6 +300,7 @@ TabletManager::splitTablet(uint64_t tableId,
         // behavior was to simply zero them, so for the time being we'll
         // stick with that. At the very least it's what Christian expects.
         t->readCount = t->writeCount = 0;
+        memset(t->loadHistogram, 0, sizeof(t->loadHistogram));
 
         if (t->state == TabletState::NOT_READY) {
             numLoadingTablets++;
@@ -380,8 +382,10 @@ TabletManager::incrementReadCount(uint64_t tableId, KeyHash keyHash)
 {
     SpinLock::Guard guard(lock);
     TabletMap::iterator it = lookup(tableId, keyHash, guard);
-    if (it != tabletMap.end())
+    if (it != tabletMap.end()) {
         it->second.readCount++;
+        it->second.countAccess(keyHash);
+    }
 }
 
 /**
@@ -403,8 +407,10 @@ TabletManager::incrementWriteCount(uint64_t tableId, KeyHash keyHash)
 {
     SpinLock::Guard guard(lock);
     TabletMap::iterator it = lookup(tableId, keyHash, guard);
-    if (it != tabletMap.end())
+    if (it != tabletMap.end()) {
         it->second.writeCount++;
+        it->second.countAccess(keyHash);
+    }
 }
 
 /**
@@ -425,8 +431,13 @@ TabletManager::getStatistics(ProtoBuf::ServerStatistics* serverStatistics)
         entry->set_start_key_hash(t->startKeyHash);
         entry->set_end_key_hash(t->endKeyHash);
         uint64_t totalOperations = t->readCount + t->writeCount;
-        if (totalOperations > 0)
+        if (totalOperations > 0) {
             entry->set_number_read_and_writes(totalOperations);
+            entry->set_number_reads(t->readCount);
+            entry->set_number_writes(t->writeCount);
+            for (uint32_t i = 0; i < LOAD_HISTOGRAM_BUCKETS; i++)
+                entry->add_load_histogram(t->loadHistogram[i]);
+        }
         ++it;
     }
 }
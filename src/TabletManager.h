@@ -45,6 +45,12 @@ namespace RAMCloud {
  */
 class TabletManager {
   PUBLIC:
+    /**
+     * Number of slices into which each tablet's key hash range is divided
+     * when counting accesses; see Tablet::loadHistogram.
+     */
+    static const uint32_t LOAD_HISTOGRAM_BUCKETS = 16;
+
     /**
      * Each tablet is in one particular state at any point in time. This state
      * is used only within each master's TabletManager. We never send or receive
@@ -79,6 +85,7 @@ class TabletManager {
             , state(NOT_READY)
             , readCount(-1)
             , writeCount(-1)
+            , loadHistogram()
         {
         }
 
@@ -92,9 +99,25 @@ class TabletManager {
             , state(state)
             , readCount(0)
             , writeCount(0)
+            , loadHistogram()
         {
         }
 
+        /**
+         * Record a read or write of an object in this tablet in
+         * #loadHistogram.
+         *
+         * \param keyHash
+         *      Primary key hash of the object; must be in this tablet.
+         */
+        void
+        countAccess(KeyHash keyHash)
+        {
+            uint64_t bucketWidth = (endKeyHash - startKeyHash) /
+                    LOAD_HISTOGRAM_BUCKETS + 1;
+            loadHistogram[(keyHash - startKeyHash) / bucketWidth]++;
+        }
+
         /// The identifier of the table that this tablet describes a portion of.
         uint64_t tableId;
 
@@ -112,6 +135,14 @@ class TabletManager {
 
         /// The number of write operations performed on objects in this tablet.
         uint64_t writeCount;
+
+        /**
+         * Number of reads and writes performed on objects in each of
+         * LOAD_HISTOGRAM_BUCKETS equal slices of this tablet's key hash
+         * range, lowest slice first. Lets the coordinator split a hot tablet
+         * where the load, rather than the key hash range, divides in half.
+         */
+        uint64_t loadHistogram[LOAD_HISTOGRAM_BUCKETS];
     };
 
     /**
@@ -277,9 +277,15 @@ TEST_F(TabletManagerTest, getStatistics) {
     {
         ProtoBuf::ServerStatistics stats;
         tm.getStatistics(&stats);
-        EXPECT_EQ("tabletentry { table_id: 58 start_key_hash: 0 "
-            "end_key_hash: 18446744073709551615 number_read_and_writes: 1 }",
-            stats.ShortDebugString());
+        ASSERT_EQ(1, stats.tabletentry_size());
+        const ProtoBuf::ServerStatistics_TabletEntry& entry =
+                stats.tabletentry(0);
+        EXPECT_EQ(1U, entry.number_read_and_writes());
+        EXPECT_EQ(1U, entry.number_reads());
+        EXPECT_EQ(0U, entry.number_writes());
+        ASSERT_EQ(16, entry.load_histogram_size());
+        EXPECT_EQ(1U, entry.load_histogram(
+                downCast<int>(key.getHash() >> 60)));
     }
 
     tm.incrementWriteCount(key);
@@ -287,12 +293,37 @@ TEST_F(TabletManagerTest, getStatistics) {
     {
         ProtoBuf::ServerStatistics stats;
         tm.getStatistics(&stats);
-        EXPECT_EQ("tabletentry { table_id: 58 start_key_hash: 0 "
-            "end_key_hash: 18446744073709551615 number_read_and_writes: 2 }",
-            stats.ShortDebugString());
+        const ProtoBuf::ServerStatistics_TabletEntry& entry =
+                stats.tabletentry(0);
+        EXPECT_EQ(2U, entry.number_read_and_writes());
+        EXPECT_EQ(1U, entry.number_reads());
+        EXPECT_EQ(1U, entry.number_writes());
+        EXPECT_EQ(2U, entry.load_histogram(
+                downCast<int>(key.getHash() >> 60)));
     }
 }
 
+TEST_F(TabletManagerTest, Tablet_countAccess) {
+    TabletManager::Tablet tablet(1, 100, 259, TabletManager::NORMAL);
+    tablet.countAccess(100);
+    tablet.countAccess(109);
+    tablet.countAccess(110);
+    tablet.countAccess(259);
+    EXPECT_EQ(2U, tablet.loadHistogram[0]);
+    EXPECT_EQ(1U, tablet.loadHistogram[1]);
+    EXPECT_EQ(1U, tablet.loadHistogram[15]);
+
+    // Whole key hash space: slices are 2^60 key hashes wide.
+    TabletManager::Tablet whole(1, 0, ~0UL, TabletManager::NORMAL);
+    whole.countAccess(0);
+    whole.countAccess((1UL << 60) - 1);
+    whole.countAccess(1UL << 60);
+    whole.countAccess(~0UL);
+    EXPECT_EQ(2U, whole.loadHistogram[0]);
+    EXPECT_EQ(1U, whole.loadHistogram[1]);
+    EXPECT_EQ(1U, whole.loadHistogram[15]);
+}
+
 TEST_F(TabletManagerTest, getNumTablets) {
     EXPECT_EQ(0U, tm.getNumTablets());
     tm.addTablet(0, 0, 0, TabletManager::NORMAL);
@@ -17,6 +17,7 @@
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
+#include <linux/errqueue.h>
 
 #include "Common.h"
 #include "PerfStats.h"
@@ -24,6 +25,18 @@
 #include "TcpTransport.h"
 #include "WorkerManager.h"
 
+// Older C libraries and kernel headers don't define these (MSG_ZEROCOPY
+// was added in Linux 4.14).
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+
 namespace RAMCloud {
 
 int TcpTransport::messageChunks = 0;
@@ -48,7 +61,8 @@ Syscall* TcpTransport::sys = &defaultSyscall;
  * \param serviceLocator
  *      If non-NULL this transport will be used to serve incoming
  *      RPC requests as well as make outgoing requests; this parameter
- *      specifies the (local) address on which to listen for connections.
+ *      specifies the (local) address on which to listen for connections,
+ *      and optionally the number of I/O threads ("ioThreads" option).
  *      If NULL this transport will be used only for outgoing requests.
  *
  * \throw TransportException
@@ -60,6 +74,10 @@ TcpTransport::TcpTransport(Context* context,
     , locatorString()
     , listenSocket(-1)
     , acceptHandler()
+    , ioThreads()
+    , readyRpcs()
+    , readyRpcsMutex("TcpTransport::readyRpcsMutex")
+    , readyRpcPoller()
     , sockets()
     , nextSocketId(100)
     , serverRpcPool()
@@ -116,6 +134,23 @@ TcpTransport::TcpTransport(Context* context,
                 "TcpTransport couldn't listen on socket", errno);
     }
 
+    uint32_t numIoThreads = serviceLocator->getOption<uint32_t>("ioThreads",
+            0);
+    try {
+        for (uint32_t i = 0; i < numIoThreads; i++) {
+            ioThreads.push_back(new IoThread(this, i));
+        }
+    } catch (TransportException& e) {
+        for (IoThread* ioThread : ioThreads) {
+            delete ioThread;
+        }
+        sys->close(listenSocket);
+        throw;
+    }
+    if (numIoThreads > 0) {
+        readyRpcPoller.construct(this);
+    }
+
     // Arrange to be notified whenever anyone connects to listenSocket.
     acceptHandler.construct(listenSocket, this);
 }
@@ -126,6 +161,15 @@ TcpTransport::TcpTransport(Context* context,
  */
 TcpTransport::~TcpTransport()
 {
+    for (IoThread* ioThread : ioThreads) {
+        delete ioThread;
+    }
+    ioThreads.clear();
+    readyRpcPoller.destroy();
+    for (TcpServerRpc* rpc : readyRpcs) {
+        serverRpcPool.destroy(rpc);
+    }
+    readyRpcs.clear();
     if (listenSocket >= 0) {
         sys->close(listenSocket);
         listenSocket = -1;
@@ -139,30 +183,155 @@ TcpTransport::~TcpTransport()
 
 /**
  * This private method is invoked to close the server's end of a
- * connection to a client and cleanup any related state.
+ * connection to a client and cleanup any related state. If the socket
+ * is serviced by an I/O thread, the caller must hold that thread's mutex.
  * \param fd
  *      File descriptor for the socket to be closed.
  */
 void
 TcpTransport::closeSocket(int fd) {
-    delete sockets[fd];
+    Socket* socket = sockets[fd];
+    if (socket->zeroCopySends != socket->zeroCopyCompleted) {
+        // The kernel may still transmit from memory that is about to be
+        // freed; reset the connection so that the data is discarded
+        // rather than sent.
+        struct linger linger;
+        linger.l_onoff = 1;
+        linger.l_linger = 0;
+        sys->setsockopt(fd, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
+    }
+    delete socket;
     sockets[fd] = NULL;
     sys->close(fd);
 }
 
+/**
+ * This method is invoked once a response has been passed completely to
+ * the kernel; it deletes the RPC, unless the kernel may still be reading
+ * the response from the RPC's memory (because of MSG_ZEROCOPY).
+ *
+ * \param socket
+ *      Socket on which the response was sent.
+ * \param rpc
+ *      The RPC whose response was sent; must not be on any of socket's
+ *      lists.
+ */
+void
+TcpTransport::finishReply(Socket* socket, TcpServerRpc* rpc)
+{
+    if ((rpc->zeroCopyMark != 0) && (static_cast<int32_t>(
+            socket->zeroCopyCompleted - rpc->zeroCopyMark) < 0)) {
+        socket->rpcsWaitingForZeroCopy.push_back(*rpc);
+        return;
+    }
+    serverRpcPool.destroy(rpc);
+}
+
+/**
+ * Make sure that #sockets has an entry for a given file descriptor.
+ * I/O threads access #sockets concurrently, so all of their locks must
+ * be held while it grows. Invoked only in the dispatch thread.
+ *
+ * \param fd
+ *      File descriptor that will be used to index #sockets.
+ */
+void
+TcpTransport::growSockets(int fd)
+{
+    if (sockets.size() > static_cast<unsigned int>(fd)) {
+        return;
+    }
+    for (IoThread* ioThread : ioThreads) {
+        ioThread->mutex.lock();
+    }
+    sockets.resize(fd + 1);
+    for (IoThread* ioThread : ioThreads) {
+        ioThread->mutex.unlock();
+    }
+}
+
+/**
+ * Process MSG_ZEROCOPY completion notifications from a socket's error
+ * queue, and delete RPCs whose memory the kernel no longer needs.
+ *
+ * \param socket
+ *      Socket whose error queue should be read. The caller must hold the
+ *      lock for the socket's I/O thread.
+ */
+void
+TcpTransport::reapZeroCopyCompletions(Socket* socket)
+{
+    while (true) {
+        uint64_t control[16];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (sys->recvmsg(socket->fd, &msg, MSG_ERRQUEUE|MSG_DONTWAIT) < 0) {
+            break;
+        }
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+                cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if ((cmsg->cmsg_level != SOL_IP) ||
+                    (cmsg->cmsg_type != IP_RECVERR)) {
+                continue;
+            }
+            struct sock_extended_err* error =
+                    reinterpret_cast<struct sock_extended_err*>(
+                    CMSG_DATA(cmsg));
+            if ((error->ee_origin != SO_EE_ORIGIN_ZEROCOPY) ||
+                    (error->ee_errno != 0)) {
+                continue;
+            }
+
+            // Sends ee_info through ee_data are complete. TCP frees its
+            // buffers as data is acknowledged, so completions arrive in
+            // order.
+            uint32_t completed = error->ee_data + 1;
+            if (static_cast<int32_t>(completed
+                    - socket->zeroCopyCompleted) > 0) {
+                socket->zeroCopyCompleted = completed;
+            }
+        }
+    }
+    while (!socket->rpcsWaitingForZeroCopy.empty()) {
+        TcpServerRpc& rpc = socket->rpcsWaitingForZeroCopy.front();
+        if (static_cast<int32_t>(socket->zeroCopyCompleted
+                - rpc.zeroCopyMark) < 0) {
+            break;
+        }
+        socket->rpcsWaitingForZeroCopy.pop_front();
+        serverRpcPool.destroy(&rpc);
+    }
+}
+
 /**
  * Constructor for Sockets.
  */
 TcpTransport::Socket::Socket(int fd, TcpTransport* transport, sockaddr_in& sin)
     : transport(transport)
+    , fd(fd)
     , id(transport->nextSocketId)
     , rpc(NULL)
-    , ioHandler(fd, transport, this)
+    , ioThread(NULL)
+    , ioHandler()
     , rpcsWaitingToReply()
     , bytesLeftToSend(0)
+    , rpcsWaitingForZeroCopy()
+    , zeroCopy(false)
+    , zeroCopySends(0)
+    , zeroCopyCompleted(0)
     , sin(sin)
 {
     transport->nextSocketId++;
+    if (transport->ioThreads.empty()) {
+        ioHandler.construct(fd, transport, this);
+        return;
+    }
+    ioThread = transport->ioThreads[fd % transport->ioThreads.size()];
+    int flag = 1;
+    zeroCopy = (sys->setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &flag,
+            sizeof(flag)) == 0);
 }
 
 /**
@@ -177,6 +346,27 @@ TcpTransport::Socket::~Socket() {
         rpcsWaitingToReply.pop_front();
         transport->serverRpcPool.destroy(&rpc);
     }
+    while (!rpcsWaitingForZeroCopy.empty()) {
+        TcpServerRpc& rpc = rpcsWaitingForZeroCopy.front();
+        rpcsWaitingForZeroCopy.pop_front();
+        transport->serverRpcPool.destroy(&rpc);
+    }
+}
+
+/**
+ * Specify the events for which the socket's handler should be invoked.
+ *
+ * \param events
+ *      OR-ed combination of Dispatch::FileEvent bits.
+ */
+void
+TcpTransport::Socket::setEvents(int events)
+{
+    if (ioThread == NULL) {
+        ioHandler->setEvents(events);
+    } else {
+        ioThread->setEvents(this, events);
+    }
 }
 
 
@@ -258,11 +448,13 @@ TcpTransport::AcceptHandler::handleFileEvent(int events)
     // At this point we have successfully opened a client connection.
     // Save information about it and create a handler for incoming
     // requests.
-    if (transport->sockets.size() <=
-            static_cast<unsigned int>(acceptedFd)) {
-        transport->sockets.resize(acceptedFd + 1);
+    transport->growSockets(acceptedFd);
+    Socket* socket = new Socket(acceptedFd, transport, sin);
+    if (socket->ioThread == NULL) {
+        transport->sockets[acceptedFd] = socket;
+    } else {
+        socket->ioThread->addSocket(socket);
     }
-    transport->sockets[acceptedFd] = new Socket(acceptedFd, transport, sin);
 }
 
 /**
@@ -289,10 +481,7 @@ TcpTransport::ServerSocketHandler::ServerSocketHandler(int fd,
 
 /**
  * This method is invoked by Dispatch when a server's connection from a client
- * becomes readable or writable.  It attempts to read incoming messages from
- * the socket.  If a full message is available, a TcpServerRpc object gets
- * queued for service.  It also attempts to write responses to the socket
- * (if there are responses waiting for transmission).
+ * becomes readable or writable.
  *
  * \param events
  *      Indicates whether the socket was readable, writable, or both
@@ -301,42 +490,59 @@ TcpTransport::ServerSocketHandler::ServerSocketHandler(int fd,
 void
 TcpTransport::ServerSocketHandler::handleFileEvent(int events)
 {
-    // The following variables are copies of data from this object;
-    // they are needed to safely detect socket closure below.
-    TcpTransport* transport = this->transport;
-    int socketFd = fd;
-    Socket* socket = transport->sockets[socketFd];
+    // Note: this object may be destroyed by the following call.
+    transport->serviceSocket(fd, events);
+}
+
+/**
+ * This method is invoked when a server's connection from a client becomes
+ * readable or writable.  It attempts to read incoming messages from the
+ * socket.  If a full message is available, a TcpServerRpc object gets
+ * queued for service.  It also attempts to write responses to the socket
+ * (if there are responses waiting for transmission). If the socket is
+ * serviced by an I/O thread, the caller must hold that thread's mutex.
+ *
+ * \param fd
+ *      File descriptor for the socket.
+ * \param events
+ *      Indicates whether the socket was readable, writable, or both
+ *      (OR-ed combination of Dispatch::FileEvent bits).
+ */
+void
+TcpTransport::serviceSocket(int fd, int events)
+{
+    Socket* socket = sockets[fd];
     assert(socket != NULL);
     try {
         if (events & Dispatch::FileEvent::READABLE) {
             if (socket->rpc == NULL) {
-                socket->rpc = transport->serverRpcPool.construct(socket,
-                                                                 fd, transport);
+                socket->rpc = serverRpcPool.construct(socket, fd, this);
             }
             if (socket->rpc->message.readMessage(fd)) {
                 // The incoming request is complete; pass it off for servicing.
                 TcpServerRpc *rpc = socket->rpc;
                 socket->rpc = NULL;
-                transport->context->workerManager->handleRpc(rpc);
+                if (socket->ioThread == NULL) {
+                    context->workerManager->handleRpc(rpc);
+                } else {
+                    socket->ioThread->receivedRpcs.push_back(rpc);
+                }
             }
         }
         // Check to see if this socket got closed due to an error in the
         // read handler; if so, it's neither necessary nor safe to continue
-        // in this method. Note: the check for closure must be done without
-        // accessing any fields in this object, since the object may have been
-        // destroyed and its memory recycled.
-        if (socket != transport->sockets[socketFd]) {
+        // in this method.
+        if (socket != sockets[fd]) {
             return;
         }
         if (events & Dispatch::FileEvent::WRITABLE) {
             while (true) {
                 if (socket->rpcsWaitingToReply.empty()) {
-                    setEvents(Dispatch::FileEvent::READABLE);
+                    socket->setEvents(Dispatch::FileEvent::READABLE);
                     break;
                 }
                 TcpServerRpc& rpc = socket->rpcsWaitingToReply.front();
-                socket->bytesLeftToSend = TcpTransport::sendMessage(fd,
-                        rpc.message.header.nonce, &rpc.replyPayload,
+                socket->bytesLeftToSend = transmitReplyBytes(socket, &rpc,
                         socket->bytesLeftToSend);
                 if (socket->bytesLeftToSend != 0) {
                     break;
@@ -344,13 +550,306 @@ TcpTransport::ServerSocketHandler::handleFileEvent(int events)
                 // The current reply is finished; start the next one, if
                 // there is one.
                 socket->rpcsWaitingToReply.pop_front();
-                transport->serverRpcPool.destroy(&rpc);
+                finishReply(socket, &rpc);
                 socket->bytesLeftToSend = -1;
             }
         }
     } catch (TransportException& e) {
-        transport->closeSocket(fd);
+        closeSocket(fd);
+    }
+}
+
+/**
+ * Constructor for IoThreads: creates the thread's epoll set and starts
+ * the thread.
+ *
+ * \param transport
+ *      The TcpTransport whose sockets the thread will service.
+ * \param index
+ *      Index of this thread in transport->ioThreads.
+ *
+ * \throw TransportException
+ *      The epoll set couldn't be created.
+ */
+TcpTransport::IoThread::IoThread(TcpTransport* transport, uint32_t index)
+    : transport(transport)
+    , index(index)
+    , epollFd(-1)
+    , mutex("TcpTransport::IoThread::mutex")
+    , receivedRpcs()
+    , repliesMutex("TcpTransport::IoThread::repliesMutex")
+    , replies()
+    , sleeping(false)
+    , exiting(false)
+    , thread()
+{
+    wakeupPipeFds[0] = wakeupPipeFds[1] = -1;
+    epollFd = sys->epoll_create(10);
+    if (epollFd < 0) {
+        throw TransportException(HERE,
+                "TcpTransport couldn't create epoll set for I/O thread",
+                errno);
+    }
+    if (sys->pipe(wakeupPipeFds) != 0) {
+        sys->close(epollFd);
+        throw TransportException(HERE,
+                "TcpTransport couldn't create wakeup pipe for I/O thread",
+                errno);
+    }
+    sys->fcntl(wakeupPipeFds[0], F_SETFL, O_NONBLOCK);
+    sys->fcntl(wakeupPipeFds[1], F_SETFL, O_NONBLOCK);
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    // -1 is a special value used to identify the wakeup pipe.
+    event.data.fd = -1;
+    if (sys->epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeupPipeFds[0],
+            &event) != 0) {
+        sys->close(wakeupPipeFds[0]);
+        sys->close(wakeupPipeFds[1]);
+        sys->close(epollFd);
+        throw TransportException(HERE,
+                "TcpTransport couldn't add wakeup pipe to epoll set", errno);
+    }
+    thread.construct(threadMain, this);
+}
+
+/**
+ * Destructor for IoThreads: stops the thread. Sockets serviced by the
+ * thread stay open; the caller must close them.
+ */
+TcpTransport::IoThread::~IoThread()
+{
+    {
+        SpinLock::Guard guard(repliesMutex);
+        exiting = true;
+    }
+    wakeup();
+    thread->join();
+    sys->close(wakeupPipeFds[0]);
+    sys->close(wakeupPipeFds[1]);
+    sys->close(epollFd);
+    for (TcpServerRpc* rpc : replies) {
+        transport->serverRpcPool.destroy(rpc);
+    }
+    for (TcpServerRpc* rpc : receivedRpcs) {
+        transport->serverRpcPool.destroy(rpc);
+    }
+}
+
+/**
+ * Start servicing a newly accepted connection in this thread.
+ *
+ * \param socket
+ *      Information about the connection; socket->ioThread must refer to
+ *      this thread.
+ */
+void
+TcpTransport::IoThread::addSocket(Socket* socket)
+{
+    {
+        SpinLock::Guard guard(mutex);
+        transport->sockets[socket->fd] = socket;
+    }
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = socket->fd;
+    if (sys->epoll_ctl(epollFd, EPOLL_CTL_ADD, socket->fd, &event) != 0) {
+        LOG(ERROR, "TcpTransport couldn't add socket to epoll set: %s",
+                strerror(errno));
+    }
+}
+
+/**
+ * Ask this thread to transmit the response for an RPC. May be invoked
+ * in any thread.
+ *
+ * \param rpc
+ *      RPC whose replyPayload is complete; its socket is serviced by
+ *      this thread.
+ */
+void
+TcpTransport::IoThread::queueReply(TcpServerRpc* rpc)
+{
+    bool wasSleeping;
+    {
+        SpinLock::Guard guard(repliesMutex);
+        replies.push_back(rpc);
+        wasSleeping = sleeping;
+        sleeping = false;
+    }
+    if (wasSleeping) {
+        wakeup();
+    }
+}
+
+/**
+ * Specify the events for which a socket should be serviced.
+ *
+ * \param socket
+ *      A socket serviced by this thread.
+ * \param events
+ *      OR-ed combination of Dispatch::FileEvent bits.
+ */
+void
+TcpTransport::IoThread::setEvents(Socket* socket, int events)
+{
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    if (events & Dispatch::FileEvent::READABLE) {
+        event.events |= EPOLLIN;
+    }
+    if (events & Dispatch::FileEvent::WRITABLE) {
+        event.events |= EPOLLOUT;
+    }
+    event.data.fd = socket->fd;
+    if (sys->epoll_ctl(epollFd, EPOLL_CTL_MOD, socket->fd, &event) != 0) {
+        LOG(ERROR, "TcpTransport couldn't modify events for socket: %s",
+                strerror(errno));
+    }
+}
+
+/**
+ * Top-level method for I/O threads: waits for sockets to become ready
+ * and services them, transmits responses queued by queueReply, and
+ * passes incoming requests to the dispatch thread.
+ *
+ * \param ioThread
+ *      The thread's IoThread object.
+ */
+void
+TcpTransport::IoThread::threadMain(IoThread* ioThread)
+try {
+    TcpTransport* transport = ioThread->transport;
+    static const int MAX_EVENTS = 32;
+    struct epoll_event events[MAX_EVENTS];
+    std::vector<TcpServerRpc*> replies;
+    bool sleeping = false;
+    while (true) {
+        int count = sys->epoll_wait(ioThread->epollFd, events, MAX_EVENTS,
+                sleeping ? -1 : 0);
+        if (count < 0) {
+            if (errno == EINTR)
+                continue;
+            LOG(ERROR, "epoll_wait failed in TcpTransport I/O thread: %s",
+                    strerror(errno));
+            return;
+        }
+
+        {
+            SpinLock::Guard guard(ioThread->repliesMutex);
+            if (ioThread->exiting) {
+                return;
+            }
+            replies.swap(ioThread->replies);
+        }
+
+        SpinLock::Guard guard(ioThread->mutex);
+        for (int i = 0; i < count; i++) {
+            int fd = events[i].data.fd;
+            if (fd == -1) {
+                // Wakeup pipe: just drain it.
+                char buffer[64];
+                while (sys->read(ioThread->wakeupPipeFds[0], buffer,
+                        sizeof(buffer)) > 0) {
+                    // Empty loop body.
+                }
+                continue;
+            }
+
+            // The socket may have been closed (and even reused) since
+            // epoll_wait returned.
+            Socket* socket = transport->sockets[fd];
+            if (socket == NULL) {
+                continue;
+            }
+            int readyEvents = 0;
+            if (events[i].events & EPOLLERR) {
+                // Either zero-copy completions are waiting on the error
+                // queue, or the connection failed (in which case reading
+                // will report the error).
+                if (socket->zeroCopy) {
+                    transport->reapZeroCopyCompletions(socket);
+                }
+                readyEvents |= Dispatch::FileEvent::READABLE;
+            }
+            if (events[i].events & (EPOLLIN|EPOLLHUP)) {
+                readyEvents |= Dispatch::FileEvent::READABLE;
+            }
+            if (events[i].events & EPOLLOUT) {
+                readyEvents |= Dispatch::FileEvent::WRITABLE;
+            }
+            transport->serviceSocket(fd, readyEvents);
+        }
+        for (TcpServerRpc* rpc : replies) {
+            transport->transmitReply(rpc);
+        }
+        replies.clear();
+
+        if (!ioThread->receivedRpcs.empty()) {
+            SpinLock::Guard readyGuard(transport->readyRpcsMutex);
+            transport->readyRpcs.insert(transport->readyRpcs.end(),
+                    ioThread->receivedRpcs.begin(),
+                    ioThread->receivedRpcs.end());
+            ioThread->receivedRpcs.clear();
+        }
+
+        // Block in the next epoll_wait unless more responses have arrived
+        // in the meantime.
+        SpinLock::Guard repliesGuard(ioThread->repliesMutex);
+        sleeping = ioThread->replies.empty();
+        ioThread->sleeping = sleeping;
+    }
+} catch (const std::exception& e) {
+    LOG(ERROR, "Fatal error in TcpTransport I/O thread: %s", e.what());
+    throw;
+} catch (...) {
+    LOG(ERROR, "Unknown fatal error in TcpTransport I/O thread.");
+    throw;
+}
+
+/**
+ * Cause the thread to return from epoll_wait, if it is waiting.
+ */
+void
+TcpTransport::IoThread::wakeup()
+{
+    // If the pipe is full, the thread is already due to wake up.
+    sys->write(wakeupPipeFds[1], "x", 1);
+}
+
+/**
+ * Constructor for ReadyRpcPollers.
+ *
+ * \param transport
+ *      The TcpTransport whose readyRpcs will be passed to the
+ *      WorkerManager.
+ */
+TcpTransport::ReadyRpcPoller::ReadyRpcPoller(TcpTransport* transport)
+    : Dispatch::Poller(transport->context->dispatch,
+            "TcpTransport::ReadyRpcPoller")
+    , transport(transport)
+    , rpcs()
+{
+}
+
+// See Dispatch::Poller for documentation.
+int
+TcpTransport::ReadyRpcPoller::poll()
+{
+    {
+        SpinLock::Guard guard(transport->readyRpcsMutex);
+        if (transport->readyRpcs.empty()) {
+            return 0;
+        }
+        rpcs.swap(transport->readyRpcs);
+    }
+    for (TcpServerRpc* rpc : rpcs) {
+        transport->context->workerManager->handleRpc(rpc);
     }
+    rpcs.clear();
+    return 1;
 }
 
 /**
@@ -371,6 +870,11 @@ TcpTransport::ServerSocketHandler::handleFileEvent(int events)
  *      Anything else means that part of the message was transmitted
  *      in a previous call, and the value of this parameter is the
  *      result returned by that call (always greater than 0).
+ * \param zeroCopySends
+ *      If non-NULL, a large payload may be sent with MSG_ZEROCOPY; the
+ *      value is incremented for each such send (the kernel reports its
+ *      completion on the socket's error queue, and the caller must keep
+ *      the payload unmodified until then). NULL means always copy.
  *
  * \return
  *      The number of (trailing) bytes that could not be transmitted.
@@ -381,7 +885,7 @@ TcpTransport::ServerSocketHandler::handleFileEvent(int events)
  */
 int
 TcpTransport::sendMessage(int fd, uint64_t nonce, Buffer* payload,
-        int bytesToSend)
+        int bytesToSend, uint32_t* zeroCopySends)
 {
     assert(fd >= 0);
 
@@ -394,6 +898,16 @@ TcpTransport::sendMessage(int fd, uint64_t nonce, Buffer* payload,
     }
     int alreadySent = totalLength - bytesToSend;
 
+    // The kernel reads zero-copy data after sendmsg returns, so the header
+    // (which lives on the stack) can't be sent that way. Instead, send it
+    // by itself first, with MSG_MORE so that it doesn't end up in a
+    // separate packet.
+    int flags = MSG_NOSIGNAL|MSG_DONTWAIT;
+    if ((zeroCopySends != NULL) && (header.len >= MIN_ZERO_COPY_BYTES)) {
+        flags |= (alreadySent < downCast<int>(sizeof(header))) ? MSG_MORE
+                : MSG_ZEROCOPY;
+    }
+
     // Use an iovec to send everything in one kernel call: one iov
     // for header, the rest for payload.  Skip parts that have
     // already been sent.
@@ -411,7 +925,7 @@ TcpTransport::sendMessage(int fd, uint64_t nonce, Buffer* payload,
         offset = alreadySent - downCast<int>(sizeof(header));
     }
     Buffer::Iterator iter(payload, offset, header.len - offset);
-    while (!iter.isDone()) {
+    while (!iter.isDone() && !(flags & MSG_MORE)) {
         iov[iovecIndex].iov_base = const_cast<void*>(iter.getData());
         iov[iovecIndex].iov_len = iter.getLength();
         ++iovecIndex;
@@ -432,8 +946,16 @@ TcpTransport::sendMessage(int fd, uint64_t nonce, Buffer* payload,
     msg.msg_iov = iov;
     msg.msg_iovlen = iovecIndex;
 
-    int r = downCast<int>(sys->sendmsg(fd, &msg,
-            MSG_NOSIGNAL|MSG_DONTWAIT));
+    int r = downCast<int>(sys->sendmsg(fd, &msg, flags));
+    if (flags & MSG_ZEROCOPY) {
+        if ((r == -1) && (errno == ENOBUFS)) {
+            // Too many zero-copy sends are outstanding on this socket.
+            return sendMessage(fd, nonce, payload, bytesToSend, NULL);
+        }
+        if (r > 0) {
+            (*zeroCopySends)++;
+        }
+    }
     if (r == bytesToSend) {
         PerfStats::threadStats.networkOutputBytes += r;
         return 0;
@@ -452,6 +974,12 @@ TcpTransport::sendMessage(int fd, uint64_t nonce, Buffer* payload,
         r = 0;
     }
     PerfStats::threadStats.networkOutputBytes += r;
+    if ((flags & MSG_MORE) && (r == downCast<int>(sizeof(header))
+            - alreadySent)) {
+        // The header is out of the way; now send the payload.
+        return sendMessage(fd, nonce, payload, bytesToSend - r,
+                zeroCopySends);
+    }
     return bytesToSend - r;
 }
 
@@ -926,45 +1454,101 @@ TcpTransport::ClientSocketHandler::handleFileEvent(int events)
 void
 TcpTransport::TcpServerRpc::sendReply()
 {
-    try {
-        Socket* socket = transport->sockets[fd];
+    if (!transport->ioThreads.empty()) {
+        // Let the socket's I/O thread make the system calls.
+        transport->ioThreads[fd % transport->ioThreads.size()]->queueReply(
+                this);
+        return;
+    }
+    transport->transmitReply(this);
+}
 
+// See Transport::ServerRpc::getclientServiceLocator for documentation.
+string
+TcpTransport::TcpServerRpc::getClientServiceLocator()
+{
+    Tub<SpinLock::Guard> guard;
+    if (!transport->ioThreads.empty()) {
+        guard.construct(transport->ioThreads[
+                fd % transport->ioThreads.size()]->mutex);
+    }
+    Socket* socket = transport->sockets[fd];
+    return format("tcp:host=%s,port=%hu", inet_ntoa(socket->sin.sin_addr),
+        NTOHS(socket->sin.sin_port));
+}
+
+/**
+ * Transmit the response for an RPC (or queue it for transmission once
+ * the socket has room). If the socket is serviced by an I/O thread, this
+ * method is invoked in that thread, with its mutex held.
+ *
+ * \param rpc
+ *      RPC whose replyPayload is complete.
+ */
+void
+TcpTransport::transmitReply(TcpServerRpc* rpc)
+{
+    int fd = rpc->fd;
+    Socket* socket = sockets[fd];
+    try {
         // It's possible that our fd has been closed (or even reused for a
         // new connection); if so, just discard the RPC without sending
         // a response.
-        if ((socket != NULL) && (socket->id == socketId)) {
+        if ((socket != NULL) && (socket->id == rpc->socketId)) {
             if (!socket->rpcsWaitingToReply.empty()) {
                 // Can't transmit the response yet; the socket is backed up.
-                socket->rpcsWaitingToReply.push_back(*this);
+                socket->rpcsWaitingToReply.push_back(*rpc);
                 return;
             }
 
             // Try to transmit the response.
-            socket->bytesLeftToSend = TcpTransport::sendMessage(fd,
-                    message.header.nonce, &replyPayload, -1);
+            socket->bytesLeftToSend = transmitReplyBytes(socket, rpc, -1);
             if (socket->bytesLeftToSend > 0) {
-                socket->rpcsWaitingToReply.push_back(*this);
-                socket->ioHandler.setEvents(Dispatch::FileEvent::READABLE |
+                socket->rpcsWaitingToReply.push_back(*rpc);
+                socket->setEvents(Dispatch::FileEvent::READABLE |
                         Dispatch::FileEvent::WRITABLE);
                 return;
             }
+
+            // The whole response was sent immediately (this should be the
+            // common case).
+            finishReply(socket, rpc);
+            return;
         }
     } catch (TransportException& e) {
-        transport->closeSocket(fd);
+        closeSocket(fd);
     }
-
-    // The whole response was sent immediately (this should be the
-    // common case).  Recycle the RPC object.
-    transport->serverRpcPool.destroy(this);
+    serverRpcPool.destroy(rpc);
 }
 
-// See Transport::ServerRpc::getclientServiceLocator for documentation.
-string
-TcpTransport::TcpServerRpc::getClientServiceLocator()
+/**
+ * Transmit as much as possible of an RPC's response, using MSG_ZEROCOPY
+ * if the socket allows it.
+ *
+ * \param socket
+ *      Socket on which to send the response.
+ * \param rpc
+ *      RPC whose response is to be sent.
+ * \param bytesToSend
+ *      Same as the corresponding argument to sendMessage.
+ * \return
+ *      The number of (trailing) bytes that could not be transmitted.
+ *
+ * \throw TransportException
+ *      An I/O error occurred.
+ */
+int
+TcpTransport::transmitReplyBytes(Socket* socket, TcpServerRpc* rpc,
+        int bytesToSend)
 {
-    Socket* socket = transport->sockets[fd];
-    return format("tcp:host=%s,port=%hu", inet_ntoa(socket->sin.sin_addr),
-        NTOHS(socket->sin.sin_port));
+    uint32_t zeroCopySends = socket->zeroCopySends;
+    int bytesLeft = sendMessage(socket->fd, rpc->message.header.nonce,
+            &rpc->replyPayload, bytesToSend,
+            socket->zeroCopy ? &socket->zeroCopySends : NULL);
+    if (socket->zeroCopySends != zeroCopySends) {
+        rpc->zeroCopyMark = socket->zeroCopySends;
+    }
+    return bytesLeft;
 }
 
 }  // namespace RAMCloud
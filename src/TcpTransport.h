@@ -17,6 +17,7 @@
 #define RAMCLOUD_TCPTRANSPORT_H
 
 #include <queue>
+#include <thread>
 
 #include "BoostIntrusive.h"
 #include "Dispatch.h"
@@ -24,6 +25,7 @@
 #include "Tub.h"
 #include "ServerRpcPool.h"
 #include "SessionAlarm.h"
+#include "SpinLock.h"
 #include "Syscall.h"
 #include "Transport.h"
 
@@ -35,6 +37,14 @@ namespace RAMCloud {
  * this class will be used primarily for development and as a baseline
  * for testing.  The goal is to provide an implementation that is about as
  * fast as possible, given its use of kernel-based TCP/IP.
+ *
+ * By default all sockets are serviced by the dispatch thread. If the
+ * service locator includes an "ioThreads" option (for example,
+ * "tcp:host=1.2.3.4,port=11000,ioThreads=4"), connections from clients
+ * are instead spread across that many I/O threads, each waiting on its own
+ * epoll set; the dispatch thread then only accepts connections and hands
+ * complete requests to the WorkerManager. In this mode large responses are
+ * transmitted with MSG_ZEROCOPY.
  */
 class TcpTransport : public Transport {
   public:
@@ -56,9 +66,11 @@ class TcpTransport : public Transport {
     class ServerSocketHandler;
     class IncomingMessage;
     class ClientSocketHandler;
+    class IoThread;
     class Socket;
     class TcpSession;
     friend class AcceptHandler;
+    friend class IoThread;
     friend class ServerSocketHandler;
     /**
      * Header for request and response messages: precedes the actual data
@@ -83,6 +95,7 @@ class TcpTransport : public Transport {
     class IncomingMessage {
         friend class ServerSocketHandler;
         friend class TcpServerRpc;
+        friend class TcpTransport;
       public:
         IncomingMessage(Buffer* buffer, TcpSession* session);
         void cancel();
@@ -125,6 +138,7 @@ class TcpTransport : public Transport {
     class TcpServerRpc : public Transport::ServerRpc {
       friend class ServerSocketHandler;
       friend class TcpTransport;
+      friend class IoThread;
       friend class ObjectPool<TcpServerRpc>;     // Since constructor is private
       public:
         virtual ~TcpServerRpc()
@@ -136,7 +150,7 @@ class TcpTransport : public Transport {
       PRIVATE:
         TcpServerRpc(Socket* socket, int fd, TcpTransport* transport)
             : fd(fd), socketId(socket->id), message(&requestPayload, NULL),
-            queueEntries(), transport(transport) { }
+            queueEntries(), transport(transport), zeroCopyMark(0) { }
 
         int fd;                   /// File descriptor of the socket on
                                   /// which the request was received.
@@ -150,6 +164,11 @@ class TcpTransport : public Transport {
                                   /// Used to link this RPC onto the
                                   /// rpcsWaitingToReply list of the Socket.
         TcpTransport* transport;  /// The parent TcpTransport object.
+        uint32_t zeroCopyMark;    /// If nonzero, part of the response was
+                                  /// sent with MSG_ZEROCOPY, and the RPC
+                                  /// (which owns the memory) can't be
+                                  /// deleted until the socket's
+                                  /// zeroCopyCompleted reaches this value.
 
         DISALLOW_COPY_AND_ASSIGN(TcpServerRpc);
     };
@@ -190,10 +209,23 @@ class TcpTransport : public Transport {
 
   PRIVATE:
     void closeSocket(int fd);
+    void finishReply(Socket* socket, TcpServerRpc* rpc);
+    void growSockets(int fd);
+    void reapZeroCopyCompletions(Socket* socket);
     static ssize_t recvCarefully(int fd, void* buffer, size_t length);
     static int sendMessage(int fd, uint64_t nonce, Buffer* payload,
+            int bytesToSend, uint32_t* zeroCopySends = NULL);
+    void serviceSocket(int fd, int events);
+    void transmitReply(TcpServerRpc* rpc);
+    int transmitReplyBytes(Socket* socket, TcpServerRpc* rpc,
             int bytesToSend);
 
+    /// Responses with at least this many bytes of payload are transmitted
+    /// with MSG_ZEROCOPY (when using I/O threads). Below this size, pinning
+    /// pages and processing completion notifications costs more than
+    /// copying.
+    static const uint32_t MIN_ZERO_COPY_BYTES = 16384;
+
     /**
      * An event handler that will accept connections on a socket.
      */
@@ -236,6 +268,130 @@ class TcpTransport : public Transport {
         DISALLOW_COPY_AND_ASSIGN(ClientSocketHandler);
     };
 
+    /**
+     * Each instance of this class is a thread that moves bytes to and from
+     * a subset of the server's client connections (those whose file
+     * descriptor modulo the number of I/O threads is the thread's index),
+     * so that the dispatch thread doesn't have to.
+     */
+    class IoThread {
+      public:
+        IoThread(TcpTransport* transport, uint32_t index);
+        ~IoThread();
+        void addSocket(Socket* socket);
+        void queueReply(TcpServerRpc* rpc);
+        void setEvents(Socket* socket, int events);
+      PRIVATE:
+        static void threadMain(IoThread* ioThread);
+        void wakeup();
+
+        /// The parent TcpTransport object.
+        TcpTransport* transport;
+
+        /// Identifies this thread among the transport's I/O threads.
+        uint32_t index;
+
+        /// Used to wait for events on this thread's sockets.
+        int epollFd;
+
+        /// Writing to the second of these file descriptors causes the
+        /// thread to return from epoll_wait (e.g. to transmit responses or
+        /// to exit).
+        int wakeupPipeFds[2];
+
+        /// Held by the thread while it services sockets; protects
+        /// receivedRpcs, as well as all the Socket objects managed by this
+        /// thread (and their entries in the transport's sockets).
+        SpinLock mutex;
+
+        /// Requests that have been received completely, but have not yet
+        /// been passed to the transport's readyRpcs.
+        std::vector<TcpServerRpc*> receivedRpcs;
+
+        /// Protects replies, sleeping, and exiting. This is separate from
+        /// mutex so that the dispatch thread doesn't have to wait while
+        /// this thread makes system calls.
+        SpinLock repliesMutex;
+
+        /// RPCs whose responses are ready, but haven't yet been passed
+        /// to the kernel.
+        std::vector<TcpServerRpc*> replies;
+
+        /// True means the thread is (or is about to be) waiting in
+        /// epoll_wait and must be woken up to notice new replies.
+        bool sleeping;
+
+        /// True means the thread should exit.
+        bool exiting;
+
+        /// The thread itself.
+        Tub<std::thread> thread;
+
+        friend class TcpTransport;
+        friend class TcpServerRpc;
+        DISALLOW_COPY_AND_ASSIGN(IoThread);
+    };
+
+    /**
+     * Runs in the dispatch thread and passes requests received by I/O
+     * threads to the WorkerManager (which may only be invoked from the
+     * dispatch thread).
+     */
+    class ReadyRpcPoller : public Dispatch::Poller {
+      public:
+        explicit ReadyRpcPoller(TcpTransport* transport);
+        virtual int poll();
+      PRIVATE:
+        /// The parent TcpTransport object.
+        TcpTransport* transport;
+
+        /// Holds RPCs taken from transport->readyRpcs; used to avoid
+        /// holding the lock while invoking the WorkerManager.
+        std::vector<TcpServerRpc*> rpcs;
+
+        DISALLOW_COPY_AND_ASSIGN(ReadyRpcPoller);
+    };
+
+    /**
+     * A ServerRpcPool that can be used concurrently by I/O threads, the
+     * dispatch thread, and LogProtector.
+     */
+    class LockedServerRpcPool : public ServerRpcPool<TcpServerRpc> {
+      public:
+        LockedServerRpcPool()
+            : ServerRpcPool<TcpServerRpc>()
+            , mutex("TcpTransport::LockedServerRpcPool")
+        {}
+
+        template<typename... Args>
+        TcpServerRpc*
+        construct(Args&&... args)
+        {
+            SpinLock::Guard guard(mutex);
+            return ServerRpcPool<TcpServerRpc>::construct(
+                    static_cast<Args&&>(args)...);
+        }
+
+        void
+        destroy(TcpServerRpc* const rpc)
+        {
+            SpinLock::Guard guard(mutex);
+            ServerRpcPool<TcpServerRpc>::destroy(rpc);
+        }
+
+        uint64_t
+        getEarliestEpoch(int activityMask)
+        {
+            SpinLock::Guard guard(mutex);
+            return ServerRpcPool<TcpServerRpc>::getEarliestEpoch(
+                    activityMask);
+        }
+
+      PRIVATE:
+        SpinLock mutex;
+        DISALLOW_COPY_AND_ASSIGN(LockedServerRpcPool);
+    };
+
     /**
      * The TCP implementation of Sessions (stored on a client to manage its
      * interactions with a particular server).
@@ -320,21 +476,42 @@ class TcpTransport : public Transport {
     /// Used to wait for listenSocket to become readable.
     Tub<AcceptHandler> acceptHandler;
 
+    /// Threads that service client connections; empty means all sockets
+    /// are serviced by the dispatch thread.
+    std::vector<IoThread*> ioThreads;
+
+    /// Complete requests received by I/O threads, waiting to be passed to
+    /// the WorkerManager by readyRpcPoller.
+    std::vector<TcpServerRpc*> readyRpcs;
+
+    /// Protects readyRpcs.
+    SpinLock readyRpcsMutex;
+
+    /// Moves RPCs from readyRpcs to the WorkerManager (only used with
+    /// I/O threads).
+    Tub<ReadyRpcPoller> readyRpcPoller;
+
     /// Used to hold information about a file descriptor associated with
     /// a socket, on which RPC requests may arrive.
     class Socket {
         public:
         Socket(int fd, TcpTransport* transport, sockaddr_in& sin);
         ~Socket();
+        void setEvents(int events);
         TcpTransport* transport;  /// The parent TcpTransport object.
+        int fd;                   /// File descriptor for the connection.
         uint64_t id;              /// Unique identifier: no other Socket
                                   /// for this transport instance will use
                                   /// the same value.
         TcpServerRpc* rpc;        /// Incoming RPC that is in progress for
                                   /// this fd, or NULL if none.
-        ServerSocketHandler ioHandler;
+        IoThread* ioThread;       /// Thread that services this socket, or
+                                  /// NULL if it is serviced by the
+                                  /// dispatch thread.
+        Tub<ServerSocketHandler> ioHandler;
                                   /// Used to get notified whenever data
-                                  /// arrives on this fd.
+                                  /// arrives on this fd (only if ioThread
+                                  /// is NULL).
         INTRUSIVE_LIST_TYPEDEF(TcpServerRpc, queueEntries) ServerRpcList;
         ServerRpcList rpcsWaitingToReply;
                                   /// RPCs whose response messages have not yet
@@ -345,6 +522,19 @@ class TcpTransport : public Transport {
                                   /// need to be transmitted, once fd becomes
                                   /// writable again.  -1 or 0 means there are
                                   /// no RPCs waiting.
+        ServerRpcList rpcsWaitingForZeroCopy;
+                                  /// RPCs whose responses have been passed
+                                  /// to the kernel with MSG_ZEROCOPY, but
+                                  /// the kernel may still be using their
+                                  /// memory. In order of transmission.
+        bool zeroCopy;            /// True means MSG_ZEROCOPY may be used
+                                  /// on this socket.
+        uint32_t zeroCopySends;   /// Number of successful MSG_ZEROCOPY
+                                  /// sends on this socket.
+        uint32_t zeroCopyCompleted;
+                                  /// The kernel has finished with the memory
+                                  /// for all MSG_ZEROCOPY sends before this
+                                  /// one.
         struct sockaddr_in sin;   /// sockaddr_in of the client host on the
                                   /// other end of the socket. Used to
                                   /// implement #getClientServiceLocator().
@@ -364,7 +554,7 @@ class TcpTransport : public Transport {
     static int messageChunks;
 
     /// Pool allocator for our ServerRpc objects.
-    ServerRpcPool<TcpServerRpc> serverRpcPool;
+    LockedServerRpcPool serverRpcPool;
 
     /// Pool allocator for TcpClientRpc objects.
     ObjectPool<TcpClientRpc> clientRpcPool;
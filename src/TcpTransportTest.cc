@@ -232,6 +232,32 @@ TEST_F(TcpTransportTest, destructor) {
     EXPECT_EQ(5, sys->closeCount);
 }
 
+TEST_F(TcpTransportTest, destructor_ioThreads) {
+    ServiceLocator locator("tcp+ip:host=localhost,port=11001,ioThreads=2");
+    TcpTransport* server = new TcpTransport(&context, &locator);
+    EXPECT_EQ(2U, server->ioThreads.size());
+    EXPECT_TRUE(server->readyRpcPoller);
+    Transport::SessionRef session = client.getSession(&locator);
+    MockWrapper rpc("request");
+    session->sendRequest(&rpc.request, &rpc.response, &rpc);
+    server->acceptHandler->handleFileEvent(Dispatch::FileEvent::READABLE);
+    for (int i = 0; i < 1000; i++) {
+        usleep(1000);
+        SpinLock::Guard guard(server->readyRpcsMutex);
+        if (!server->readyRpcs.empty())
+            break;
+    }
+    EXPECT_EQ(1U, server->readyRpcs.size());
+
+    // The request hasn't been passed to the WorkerManager, so the
+    // destructor must delete it.
+    sys->closeCount = 0;
+    delete server;
+    EXPECT_EQ(8, sys->closeCount);
+    EXPECT_TRUE(TestUtil::waitForRpc(&context, rpc));
+    EXPECT_STREQ("completed: 0, failed: 1", rpc.getState());
+}
+
 TEST_F(TcpTransportTest, Socket_destructor_deleteRpc) {
     // Send a partial message to a server, then close its socket and
     // ensure that the TcpServerRpc was deleted.
@@ -244,7 +270,7 @@ TEST_F(TcpTransportTest, Socket_destructor_deleteRpc) {
     header.len = 6;
     EXPECT_EQ(static_cast<int>(sizeof(header)),
         write(fd, &header, sizeof(header)));
-    server.sockets[serverFd]->ioHandler.handleFileEvent(
+    server.sockets[serverFd]->ioHandler->handleFileEvent(
             Dispatch::FileEvent::READABLE);
     EXPECT_TRUE(server.sockets[serverFd]->rpc != NULL);
     server.closeSocket(serverFd);
@@ -323,13 +349,13 @@ TEST_F(TcpTransportTest, ServerSocketHandler_handleFileEvent_reads) {
     header.len = 6;
     EXPECT_EQ(static_cast<int>(sizeof(header)),
         write(fd, &header, sizeof(header)));
-    server.sockets[serverFd]->ioHandler.handleFileEvent(
+    server.sockets[serverFd]->ioHandler->handleFileEvent(
             Dispatch::FileEvent::READABLE);
     EXPECT_TRUE(server.sockets[serverFd]->rpc != NULL);
     EXPECT_EQ(0, countWaitingRequests(&server));
 
     EXPECT_EQ(6, write(fd, "abcdef", 6));
-    server.sockets[serverFd]->ioHandler.handleFileEvent(
+    server.sockets[serverFd]->ioHandler->handleFileEvent(
             Dispatch::FileEvent::READABLE);
     EXPECT_EQ(1, countWaitingRequests(&server));
 
@@ -383,7 +409,7 @@ TEST_F(TcpTransportTest, ServerSocketHandler_handleFileEvent_eof) {
     server.acceptHandler->handleFileEvent(Dispatch::FileEvent::READABLE);
     int serverFd = downCast<unsigned>(server.sockets.size()) - 1;
     close(fd);
-    server.sockets[serverFd]->ioHandler.handleFileEvent(
+    server.sockets[serverFd]->ioHandler->handleFileEvent(
             Dispatch::FileEvent::READABLE);
     EXPECT_TRUE(server.sockets[serverFd] == NULL);
 }
@@ -393,7 +419,7 @@ TEST_F(TcpTransportTest, ServerSocketHandler_handleFileEvent_error) {
     server.acceptHandler->handleFileEvent(Dispatch::FileEvent::READABLE);
     int serverFd = downCast<unsigned>(server.sockets.size()) - 1;
     sys->recvErrno = EPERM;
-    server.sockets[serverFd]->ioHandler.handleFileEvent(
+    server.sockets[serverFd]->ioHandler->handleFileEvent(
             Dispatch::FileEvent::READABLE);
     EXPECT_TRUE(server.sockets[serverFd] == NULL);
     EXPECT_EQ("recvCarefully: TcpTransport recv error: "
@@ -1275,6 +1301,117 @@ TEST_F(TcpTransportTest, sessionAlarm) {
     EXPECT_STREQ("completed: 0, failed: 1", rpc2.getState());
 }
 
+TEST_F(TcpTransportTest, IoThread_sanityCheck) {
+    ServiceLocator locator("tcp+ip:host=localhost,port=11001,ioThreads=2");
+    TcpTransport server(&context, &locator);
+    Transport::SessionRef session = client.getSession(&locator);
+    MockWrapper rpc1("request1");
+    session->sendRequest(&rpc1.request, &rpc1.response, &rpc1);
+    MockWrapper rpc2("request2");
+    session->sendRequest(&rpc2.request, &rpc2.response, &rpc2);
+
+    // The requests are read by an I/O thread and passed to the
+    // WorkerManager by the dispatch thread.
+    Transport::ServerRpc* serverRpc1 = workerManager->waitForRpc(1.0);
+    ASSERT_TRUE(serverRpc1 != NULL);
+    EXPECT_EQ("request1", TestUtil::toString(&serverRpc1->requestPayload));
+    Transport::ServerRpc* serverRpc2 = workerManager->waitForRpc(1.0);
+    ASSERT_TRUE(serverRpc2 != NULL);
+    EXPECT_EQ("request2", TestUtil::toString(&serverRpc2->requestPayload));
+    int fd = static_cast<TcpTransport::TcpServerRpc*>(serverRpc1)->fd;
+    EXPECT_EQ(server.ioThreads[fd % 2], server.sockets[fd]->ioThread);
+    EXPECT_FALSE(server.sockets[fd]->ioHandler);
+    EXPECT_EQ(0U, serverRpc1->getClientServiceLocator().find(
+            "tcp:host=127.0.0.1,port="));
+
+    serverRpc2->replyPayload.fillFromString("response2");
+    serverRpc2->sendReply();
+    serverRpc1->replyPayload.fillFromString("response1");
+    serverRpc1->sendReply();
+    EXPECT_TRUE(TestUtil::waitForRpc(&context, rpc1));
+    EXPECT_TRUE(TestUtil::waitForRpc(&context, rpc2));
+    EXPECT_EQ("response1/0", TestUtil::toString(&rpc1.response));
+    EXPECT_EQ("response2/0", TestUtil::toString(&rpc2.response));
+}
+
+TEST_F(TcpTransportTest, IoThread_zeroCopyResponse) {
+    ServiceLocator locator("tcp+ip:host=localhost,port=11001,ioThreads=1");
+    TcpTransport server(&context, &locator);
+    Transport::SessionRef session = client.getSession(&locator);
+    MockWrapper rpc("request");
+    session->sendRequest(&rpc.request, &rpc.response, &rpc);
+    Transport::ServerRpc* serverRpc = workerManager->waitForRpc(1.0);
+    ASSERT_TRUE(serverRpc != NULL);
+    int fd = static_cast<TcpTransport::TcpServerRpc*>(serverRpc)->fd;
+    TcpTransport::Socket* socket = server.sockets[fd];
+    EXPECT_TRUE(socket->zeroCopy);
+
+    string response(100000, 'x');
+    serverRpc->replyPayload.appendCopy(response.data(), 100000);
+    serverRpc->sendReply();
+    EXPECT_TRUE(TestUtil::waitForRpc(&context, rpc));
+    ASSERT_EQ(100000U, rpc.response.size());
+    EXPECT_EQ(0, memcmp(response.data(), rpc.response.getRange(0, 100000),
+            100000));
+
+    // The RPC isn't deleted until the kernel is done with its memory.
+    for (int i = 0; i < 1000; i++) {
+        {
+            SpinLock::Guard guard(server.ioThreads[0]->mutex);
+            if (socket->rpcsWaitingForZeroCopy.empty())
+                break;
+        }
+        usleep(1000);
+    }
+    SpinLock::Guard guard(server.ioThreads[0]->mutex);
+    EXPECT_EQ(0U, socket->rpcsWaitingForZeroCopy.size());
+    EXPECT_LT(0U, socket->zeroCopySends);
+    EXPECT_EQ(socket->zeroCopySends, socket->zeroCopyCompleted);
+}
+
+TEST_F(TcpTransportTest, sendMessage_zeroCopy) {
+    int fd = connectToServer(&locator);
+    server.acceptHandler->handleFileEvent(Dispatch::FileEvent::READABLE);
+    int serverFd = downCast<unsigned>(server.sockets.size()) - 1;
+    int flag = 1;
+    ASSERT_EQ(0, setsockopt(serverFd, SOL_SOCKET, SO_ZEROCOPY, &flag,
+            sizeof(flag)));
+
+    // Small messages are always copied.
+    Buffer payload;
+    payload.appendCopy("abcdefg", 7);
+    uint32_t zeroCopySends = 0;
+    EXPECT_EQ(0, TcpTransport::sendMessage(serverFd, 111, &payload, -1,
+            &zeroCopySends));
+    EXPECT_EQ(0U, zeroCopySends);
+
+    // The header of a large message is sent separately (and copied).
+    string data(TcpTransport::MIN_ZERO_COPY_BYTES, 'y');
+    Buffer payload2;
+    payload2.appendCopy(data.data(), TcpTransport::MIN_ZERO_COPY_BYTES);
+    EXPECT_EQ(0, TcpTransport::sendMessage(serverFd, 222, &payload2, -1,
+            &zeroCopySends));
+    EXPECT_EQ(1U, zeroCopySends);
+
+    TcpTransport::IncomingMessage incoming(&payload, NULL);
+    payload.reset();
+    while (!incoming.readMessage(fd)) {
+        // Empty loop body.
+    }
+    EXPECT_EQ(111U, incoming.header.nonce);
+    EXPECT_EQ("abcdefg", TestUtil::toString(&payload));
+    Buffer received;
+    TcpTransport::IncomingMessage incoming2(&received, NULL);
+    while (!incoming2.readMessage(fd)) {
+        // Empty loop body.
+    }
+    EXPECT_EQ(222U, incoming2.header.nonce);
+    ASSERT_EQ(data.size(), received.size());
+    EXPECT_EQ(0, memcmp(data.data(), received.getRange(0, received.size()),
+            data.size()));
+    close(fd);
+}
+
 TEST_F(TcpTransportTest, TcpServerRpc_getClientServiceLocator) {
     Transport::SessionRef session = client.getSession(&locator);
     TcpTransport::messageChunks = 0;
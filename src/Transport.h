@@ -24,6 +24,7 @@
 #include "Buffer.h"
 #include "CodeLocation.h"
 #include "Exception.h"
+#include "Key.h"
 
 namespace RAMCloud {
 class ServiceLocator;
@@ -78,6 +79,7 @@ class Transport {
             , replyPayload()
             , epoch(0)
             , activities(~0)
+            , keyHash()
             , outstandingRpcListHook()
         {}
 
@@ -156,6 +158,14 @@ class Transport {
         static const int READ_ACTIVITY = 1;
         static const int APPEND_ACTIVITY = 2;
 
+        /**
+         * Hash of the primary key named by the request, if the
+         * WorkerManager computed it to steer the RPC to a worker (see
+         * WorkerManager::chooseWorker); otherwise empty. Saves the service
+         * from hashing the key again.
+         */
+        Tub<KeyHash> keyHash;
+
         /**
          * Hook for the list of active server RPCs that the ServerRpcPool class
          * maintains. RPCs are added when ServerRpc-derived classes are
@@ -40,6 +40,10 @@
 #include "DpdkDriver.h"
 #endif
 
+#ifdef XDP
+#include "XdpDriver.h"
+#endif
+
 namespace RAMCloud {
 
 static struct TcpTransportFactory : public TransportFactory {
@@ -122,6 +126,19 @@ struct BasicDpdkTransportFactory : public TransportFactory {
 static BasicDpdkTransportFactory basicDpdkTransportFactory;
 #endif
 
+#ifdef XDP
+static struct BasicXdpTransportFactory : public TransportFactory {
+    BasicXdpTransportFactory()
+        : TransportFactory("basic+xdp", "basic+xdp") {}
+    Transport* createTransport(Context* context,
+            const ServiceLocator* localServiceLocator) {
+        return new BasicTransport(context, localServiceLocator,
+                new XdpDriver(context, localServiceLocator),
+                generateRandom());
+    }
+} basicXdpTransportFactory;
+#endif
+
 /**
  * TransportManager constructor.
  * 
@@ -159,6 +176,9 @@ TransportManager::TransportManager(Context* context)
                     new DpdkDriver(context, dpdkPort));
         }
     }
+#endif
+#ifdef XDP
+    transportFactories.push_back(&basicXdpTransportFactory);
 #endif
     transports.resize(transportFactories.size(), NULL);
     if (context->options != NULL) {
@@ -16,6 +16,7 @@
 #include <errno.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <netinet/udp.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 
@@ -27,6 +28,12 @@
 #include "ServiceLocator.h"
 #include "TimeTrace.h"
 
+// Older C libraries don't define the socket option for UDP GSO (which
+// was added in Linux 4.18).
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
 namespace RAMCloud {
 
 /**
@@ -52,7 +59,9 @@ Syscall* UdpDriver::sys = &defaultSyscall;
  *      identifying the desired socket.  If NULL then a port will be
  *      chosen by system software. Typically the socket is specified
  *      explicitly for server-side drivers but not for client-side
- *      drivers.
+ *      drivers. The "gbs" option gives the network bandwidth, and
+ *      "gso=1" requests UDP segmentation offload for batched transmits,
+ *      if the kernel supports it.
  */
 UdpDriver::UdpDriver(Context* context,
         const ServiceLocator* localServiceLocator)
@@ -66,6 +75,10 @@ UdpDriver::UdpDriver(Context* context,
     , bandwidthGbps(10)                   // Default bandwidth = 10 gbs
     , queueEstimator(0)
     , maxTransmitQueueSize(0)
+    , transmitBatch()
+    , packetsQueued(0)
+    , packetsFlushed(0)
+    , gsoEnabled(false)
     , readerThread()
     , readerThreadExit(false)
 {
@@ -74,6 +87,9 @@ UdpDriver::UdpDriver(Context* context,
         try {
             bandwidthGbps = localServiceLocator->getOption<int>("gbs");
         } catch (ServiceLocator::NoSuchKeyException& e) {}
+        try {
+            gsoEnabled = localServiceLocator->getOption<int>("gso") != 0;
+        } catch (ServiceLocator::NoSuchKeyException& e) {}
     }
     queueEstimator.setBandwidth(1000*bandwidthGbps);
     maxTransmitQueueSize = (uint32_t) (static_cast<double>(bandwidthGbps)
@@ -93,6 +109,19 @@ UdpDriver::UdpDriver(Context* context,
                               errno);
     }
 
+    if (gsoEnabled) {
+        // Setting a default segment size of 0 leaves GSO off for ordinary
+        // sends; it just tells us whether the kernel supports GSO (we
+        // request it explicitly for each batched send).
+        int segmentSize = 0;
+        if (sys->setsockopt(fd, SOL_UDP, UDP_SEGMENT, &segmentSize,
+                sizeof(segmentSize)) == -1) {
+            LOG(WARNING, "UdpDriver can't use UDP segmentation offload: %s",
+                    strerror(errno));
+            gsoEnabled = false;
+        }
+    }
+
     if (localServiceLocator != NULL) {
         IpAddress ipAddress(localServiceLocator);
         int r = sys->bind(fd, &ipAddress.address, sizeof(ipAddress.address));
@@ -148,6 +177,9 @@ UdpDriver::~UdpDriver()
 void
 UdpDriver::close()
 {
+    transmitBatch.numPackets = 0;
+    transmitBatch.numIovecs = 0;
+    packetsFlushed = packetsQueued;
     if (readerThread) {
         stopReaderThread();
         readerThread->join();
@@ -234,6 +266,20 @@ UdpDriver::sendPacket(const Address* addr,
                            (payload ? payload->size() : 0);
     assert(totalLength <= MAX_PAYLOAD_SIZE);
 
+    if (transmitBatch.active) {
+        if (headerLen <= TransmitBatch::MAX_HEADER_SIZE) {
+            queuePacket(static_cast<const IpAddress*>(addr), header,
+                    headerLen, payload, totalLength);
+            return;
+        }
+
+        // Can't queue this packet; send it now, but make sure it doesn't
+        // overtake packets that were queued earlier.
+        transmitQueuedPackets();
+    }
+    packetsQueued++;
+    packetsFlushed = packetsQueued;
+
     // one for header, the rest for payload
     uint32_t iovecs = 1 + (payload ? payload->getNumberChunks() : 0);
 
@@ -267,6 +313,124 @@ UdpDriver::sendPacket(const Address* addr,
     assert(static_cast<size_t>(r) == totalLength);
 }
 
+// See docs in Driver class.
+void
+UdpDriver::flushTransmitBatch()
+{
+    transmitQueuedPackets();
+    transmitBatch.active = false;
+}
+
+/**
+ * Add a packet to transmitBatch; it will be transmitted by the next call
+ * to transmitQueuedPackets. Arguments are the same as for sendPacket,
+ * except that \a headerLen must not exceed TransmitBatch::MAX_HEADER_SIZE.
+ *
+ * \param totalLength
+ *      Total number of bytes in the packet (header plus payload).
+ */
+void
+UdpDriver::queuePacket(const IpAddress* recipient, const void* header,
+        uint32_t headerLen, Buffer::Iterator* payload, uint32_t totalLength)
+{
+    TransmitBatch* batch = &transmitBatch;
+    int iovecsNeeded = 1 + (payload ? payload->getNumberChunks() : 0);
+    if ((batch->numPackets == TransmitBatch::MAX_PACKETS) ||
+            (batch->numIovecs + iovecsNeeded > TransmitBatch::MAX_IOVECS)) {
+        transmitQueuedPackets();
+    }
+
+    TransmitBatch::Packet* packet = &batch->packets[batch->numPackets];
+    batch->numPackets++;
+    packet->address = recipient->address;
+    memcpy(packet->header, header, headerLen);
+    packet->length = totalLength;
+    packet->firstIovec = batch->numIovecs;
+    batch->iovecs[batch->numIovecs].iov_base = packet->header;
+    batch->iovecs[batch->numIovecs].iov_len = headerLen;
+    batch->numIovecs++;
+    while (payload && !payload->isDone()) {
+        batch->iovecs[batch->numIovecs].iov_base =
+                const_cast<void*>(payload->getData());
+        batch->iovecs[batch->numIovecs].iov_len = payload->getLength();
+        batch->numIovecs++;
+        payload->next();
+    }
+    packet->numIovecs = batch->numIovecs - packet->firstIovec;
+    packetsQueued++;
+    queueEstimator.packetQueued(totalLength, Cycles::rdtsc());
+}
+
+/**
+ * Hand all of the packets in transmitBatch to the kernel, using a single
+ * sendmmsg call if possible. If GSO is enabled, each run of full-size
+ * packets to the same destination (possibly followed by one shorter
+ * packet) is sent as a single message that the kernel segments.
+ */
+void
+UdpDriver::transmitQueuedPackets()
+{
+    TransmitBatch* batch = &transmitBatch;
+    int numMessages = 0;
+    for (int i = 0; i < batch->numPackets; ) {
+        TransmitBatch::Packet* first = &batch->packets[i];
+        int segments = 1;
+        uint32_t bytes = first->length;
+        size_t iovecs = first->numIovecs;
+        while (gsoEnabled && (i + segments < batch->numPackets)
+                && (segments < TransmitBatch::MAX_GSO_SEGMENTS)) {
+            // All segments but the last must be the same size as the first.
+            TransmitBatch::Packet* next = &batch->packets[i + segments];
+            if ((batch->packets[i + segments - 1].length != first->length)
+                    || (next->length > first->length)
+                    || (bytes + next->length > TransmitBatch::MAX_GSO_BYTES)
+                    || (memcmp(&next->address, &first->address,
+                    sizeof(first->address)) != 0)) {
+                break;
+            }
+            segments++;
+            bytes += next->length;
+            iovecs += next->numIovecs;
+        }
+
+        struct msghdr* message = &batch->messages[numMessages].msg_hdr;
+        memset(message, 0, sizeof(*message));
+        message->msg_name = &first->address;
+        message->msg_namelen = sizeof(first->address);
+        message->msg_iov = &batch->iovecs[first->firstIovec];
+        message->msg_iovlen = iovecs;
+        if (segments > 1) {
+            message->msg_control = batch->control[numMessages];
+            message->msg_controllen = sizeof(batch->control[numMessages]);
+            struct cmsghdr* cmsg = CMSG_FIRSTHDR(message);
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            uint16_t segmentSize = downCast<uint16_t>(first->length);
+            memcpy(CMSG_DATA(cmsg), &segmentSize, sizeof(segmentSize));
+        }
+        numMessages++;
+        i += segments;
+    }
+
+    int sent = 0;
+    while (sent < numMessages) {
+        int count = sys->sendmmsg(socketFd, &batch->messages[sent],
+                numMessages - sent, 0);
+        if (count == -1) {
+            // Skip the message that failed (as if it had been lost in
+            // the network) and keep going.
+            LOG(WARNING, "UdpDriver error sending to socket: %s",
+                    strerror(errno));
+            count = 1;
+        }
+        sent += count;
+    }
+    batch->numPackets = 0;
+    batch->numIovecs = 0;
+    packetsFlushed = packetsQueued;
+}
+
 /**
  * Notify the reader thread that it should exit. Don't actually wait for the
  * thread to return here, though.
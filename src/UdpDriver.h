@@ -54,6 +54,12 @@ class UdpDriver : public Driver {
                             Buffer::Iterator* payload,
                             int priority = 0);
     virtual string getServiceLocator();
+    virtual uint64_t getTransmitMark() { return packetsQueued; }
+    virtual bool isTransmitComplete(uint64_t mark) {
+        return mark <= packetsFlushed;
+    }
+    virtual void startTransmitBatch() { transmitBatch.active = true; }
+    virtual void flushTransmitBatch();
 
     virtual Address* newAddress(const ServiceLocator* serviceLocator) {
         return new IpAddress(serviceLocator);
@@ -61,7 +67,11 @@ class UdpDriver : public Driver {
 
   PROTECTED:
     static void readerThreadMain(UdpDriver* driver);
+    void queuePacket(const IpAddress* recipient, const void* header,
+            uint32_t headerLen, Buffer::Iterator* payload,
+            uint32_t totalLength);
     void stopReaderThread();
+    void transmitQueuedPackets();
 
     struct PacketBuf : Driver::PacketBuf<IpAddress, MAX_PAYLOAD_SIZE> {
         PacketBuf()
@@ -121,6 +131,76 @@ class UdpDriver : public Driver {
         }
     };
 
+    /**
+     * Holds packets passed to sendPacket between calls to
+     * startTransmitBatch and flushTransmitBatch, so that they can be handed
+     * to the kernel with a single sendmmsg call. Only headers are copied;
+     * iovecs refer directly to the callers' payload data.
+     */
+    struct TransmitBatch {
+        /// Maximum number of packets that can be queued at once.
+        static const int MAX_PACKETS = 64;
+
+        /// Maximum number of iovecs for all of the queued packets
+        /// (the kernel's limit for a single message is UIO_MAXIOV).
+        static const int MAX_IOVECS = 1024;
+
+        /// Longest packet header that can be queued; packets with longer
+        /// headers are transmitted immediately.
+        static const uint32_t MAX_HEADER_SIZE = 64;
+
+        /// Maximum number of packets that will be combined into a single
+        /// GSO send, and the maximum number of bytes in one.
+        static const int MAX_GSO_SEGMENTS = 64;
+        static const uint32_t MAX_GSO_BYTES = 65000;
+
+        /// Describes one queued packet.
+        struct Packet {
+            /// Where to send the packet.
+            struct sockaddr address;
+
+            /// Copy of the packet header.
+            char header[MAX_HEADER_SIZE];
+
+            /// Total bytes in the packet, including header.
+            uint32_t length;
+
+            /// Index in iovecs of the packet's first iovec (its header).
+            int firstIovec;
+
+            /// Number of iovecs for the packet, including its header.
+            int numIovecs;
+        };
+
+        TransmitBatch()
+            : active(false)
+            , numPackets(0)
+            , numIovecs(0)
+            , packets()
+            , iovecs()
+            , messages()
+            , control()
+        {}
+
+        /// True means startTransmitBatch has been called, so sendPacket
+        /// should queue packets here rather than transmitting them.
+        bool active;
+
+        /// Number of valid entries in packets and iovecs.
+        int numPackets;
+        int numIovecs;
+
+        Packet packets[MAX_PACKETS];
+        struct iovec iovecs[MAX_IOVECS];
+
+        /// Arguments for sendmmsg: one message per packet, or per group
+        /// of packets when GSO is in use.
+        struct mmsghdr messages[MAX_PACKETS];
+
+        /// Ancillary data holding the UDP_SEGMENT size for GSO messages.
+        char control[MAX_PACKETS][CMSG_SPACE(sizeof(uint16_t))];
+    };
+
     /// Shared RAMCloud information.
     Context* context;
 
@@ -164,6 +244,23 @@ class UdpDriver : public Driver {
     /// at any given time.
     uint32_t maxTransmitQueueSize;
 
+    /// Packets waiting to be transmitted in a batch.
+    TransmitBatch transmitBatch;
+
+    /// Number of packets passed to sendPacket so far (used as the
+    /// transmit mark).
+    uint64_t packetsQueued;
+
+    /// Number of packets that have been handed to the kernel (the kernel
+    /// copies packet data, so we are finished with their payloads).
+    uint64_t packetsFlushed;
+
+    /// True means the kernel supports UDP segmentation offload (GSO) and
+    /// the service locator asked for it ("gso=1"): consecutive full-size
+    /// packets to the same destination are passed to the kernel as a
+    /// single large datagram, which it splits into packets.
+    bool gsoEnabled;
+
     /// The following thread runs in the background to wait for kernel calls
     /// that receive packets.
     Tub<std::thread> readerThread;
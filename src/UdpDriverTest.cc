@@ -13,6 +13,8 @@
  * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <netinet/udp.h>
+
 #include "TestUtil.h"
 #include "MockSyscall.h"
 #include "Tub.h"
@@ -129,6 +131,18 @@ TEST_F(UdpDriverTest, constructor_gbsOption) {
     EXPECT_EQ(2800u, driver2.maxTransmitQueueSize);
     Cycles::mockCyclesPerSec = 0;
 }
+TEST_F(UdpDriverTest, constructor_gsoOption) {
+    EXPECT_FALSE(server.gsoEnabled);
+    ServiceLocator locator("basic+udp:host=localhost,port=8101,gso=1");
+    sys->setsockoptErrno = ENOPROTOOPT;
+    TestLog::reset();
+    Tub<UdpDriver> driver;
+    driver.construct(&context, &locator);
+    EXPECT_FALSE(driver->gsoEnabled);
+    EXPECT_TRUE(TestUtil::contains(TestLog::get(),
+            "UdpDriver can't use UDP segmentation offload: "
+            "Protocol not available"));
+}
 TEST_F(UdpDriverTest, constructor_errorInSocketCall) {
     sys->socketErrno = EPERM;
     try {
@@ -295,6 +309,96 @@ TEST_F(UdpDriverTest, sendPacket_errorInSend) {
             "Operation not permitted", TestLog::get());
 }
 
+TEST_F(UdpDriverTest, sendPacket_queueInBatch) {
+    client.startTransmitBatch();
+    sendMessage(&client, &serverAddress, "header1:", "abc");
+    sendMessage(&client, &serverAddress, "header2:", "defg");
+    EXPECT_EQ(2, client.transmitBatch.numPackets);
+    EXPECT_EQ(4, client.transmitBatch.numIovecs);
+    EXPECT_EQ(11u, client.transmitBatch.packets[0].length);
+    EXPECT_EQ(2, client.transmitBatch.packets[1].firstIovec);
+    uint64_t mark = client.getTransmitMark();
+    EXPECT_EQ(2u, mark);
+    EXPECT_FALSE(client.isTransmitComplete(mark));
+
+    client.flushTransmitBatch();
+    EXPECT_TRUE(client.isTransmitComplete(mark));
+    EXPECT_FALSE(client.transmitBatch.active);
+    EXPECT_EQ(1, sys->sendmmsgCalls);
+    EXPECT_EQ("header1:abc, header2:defg", receivePackets(&server));
+}
+
+TEST_F(UdpDriverTest, sendPacket_headerTooLongToQueue) {
+    client.startTransmitBatch();
+    sendMessage(&client, &serverAddress, "header1:", "abc");
+    string header(UdpDriver::TransmitBatch::MAX_HEADER_SIZE + 1, 'h');
+    client.sendPacket(&serverAddress, header.data(),
+            downCast<uint32_t>(header.size()), NULL);
+    EXPECT_EQ(0, client.transmitBatch.numPackets);
+    EXPECT_TRUE(client.isTransmitComplete(client.getTransmitMark()));
+    EXPECT_EQ("header1:abc, " + header, receivePackets(&server));
+    client.flushTransmitBatch();
+}
+
+TEST_F(UdpDriverTest, queuePacket_batchFull) {
+    client.startTransmitBatch();
+    for (int i = 0; i < UdpDriver::TransmitBatch::MAX_PACKETS; i++) {
+        client.sendPacket(&serverAddress, "x", 1, NULL);
+    }
+    EXPECT_EQ(0, sys->sendmmsgCalls);
+    client.sendPacket(&serverAddress, "y", 1, NULL);
+    EXPECT_EQ(1, sys->sendmmsgCalls);
+    EXPECT_EQ(1, client.transmitBatch.numPackets);
+    client.flushTransmitBatch();
+    EXPECT_EQ(2, sys->sendmmsgCalls);
+}
+
+TEST_F(UdpDriverTest, transmitQueuedPackets_gso) {
+    // Don't depend on kernel support for GSO: just check how packets
+    // are grouped into messages.
+    client.gsoEnabled = true;
+    sys->sendmmsgErrno = EPERM;
+    ServiceLocator otherLocator("udp: host=localhost, port=8101");
+    IpAddress otherAddress(&otherLocator);
+    client.startTransmitBatch();
+    sendMessage(&client, &serverAddress, "h1:", "abcd");
+    sendMessage(&client, &serverAddress, "h2:", "efgh");
+    sendMessage(&client, &serverAddress, "h3:", "ij");
+    sendMessage(&client, &serverAddress, "h4:", "k");
+    sendMessage(&client, &otherAddress, "h5:", "lmno");
+    sendMessage(&client, &serverAddress, "h6:", "pqrs");
+    TestLog::reset();
+    client.flushTransmitBatch();
+
+    // The short packet ends the first group; changes of address also
+    // start new groups.
+    UdpDriver::TransmitBatch* batch = &client.transmitBatch;
+    EXPECT_EQ(6lu, batch->messages[0].msg_hdr.msg_iovlen);
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&batch->messages[0].msg_hdr);
+    EXPECT_EQ(SOL_UDP, cmsg->cmsg_level);
+    EXPECT_EQ(7, *reinterpret_cast<uint16_t*>(CMSG_DATA(cmsg)));
+    EXPECT_EQ(2lu, batch->messages[1].msg_hdr.msg_iovlen);
+    EXPECT_EQ(0lu, batch->messages[1].msg_hdr.msg_controllen);
+    EXPECT_EQ(&batch->iovecs[8], batch->messages[2].msg_hdr.msg_iov);
+    EXPECT_EQ(&batch->iovecs[10], batch->messages[3].msg_hdr.msg_iov);
+    EXPECT_EQ(4, sys->sendmmsgCalls);
+}
+
+TEST_F(UdpDriverTest, transmitQueuedPackets_errorInSend) {
+    sys->sendmmsgErrno = EPERM;
+    client.startTransmitBatch();
+    sendMessage(&client, &serverAddress, "h1:", "abc");
+    sendMessage(&client, &serverAddress, "h2:", "def");
+    TestLog::reset();
+    client.flushTransmitBatch();
+    EXPECT_EQ("transmitQueuedPackets: UdpDriver error sending to socket: "
+            "Operation not permitted | "
+            "transmitQueuedPackets: UdpDriver error sending to socket: "
+            "Operation not permitted", TestLog::get());
+    EXPECT_EQ(0, client.transmitBatch.numPackets);
+    EXPECT_TRUE(client.isTransmitComplete(client.getTransmitMark()));
+}
+
 TEST_F(UdpDriverTest, stopReaderThread_basics) {
     client.stopReaderThread();
     TestUtil::waitForLog();
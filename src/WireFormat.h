@@ -130,7 +130,8 @@ enum Opcode {
     TX_REQUEST_ABORT            = 78,
     TX_HINT_FAILED              = 79,
     ECHO                        = 80,
-    ILLEGAL_RPC_TYPE            = 81, // 1 + the highest legitimate Opcode
+    SCAN                        = 81,
+    ILLEGAL_RPC_TYPE            = 82, // 1 + the highest legitimate Opcode
 };
 
 /**
@@ -1251,10 +1252,16 @@ struct Read {
                                       // The actual key follows
                                       // immediately after this header.
         RejectRules rejectRules;
+        uint32_t leaseNanoseconds;    // If nonzero, the client would like to
+                                      // cache the object for this long (see
+                                      // ReadCache).
     } __attribute__((packed));
     struct Response {
         ResponseCommon common;
         uint64_t version;
+        uint32_t leaseNanoseconds;    // Length of the read lease granted,
+                                      // measured from when the request was
+                                      // sent; 0 means don't cache.
         uint32_t length;              // Length of the object's value in bytes.
                                       // The actual bytes of the object follow
                                       // immediately after this header.
@@ -1455,6 +1462,42 @@ struct RenewLease {
     } __attribute__((packed));
 };
 
+struct Scan {
+    static const Opcode opcode = SCAN;
+    static const ServiceType service = MASTER_SERVICE;
+    struct Request {
+        RequestCommon common;
+        uint64_t tableId;
+        bool keysOnly;              // Same meaning as in Enumerate.
+        uint64_t tabletFirstHash;   // Where to continue the scan: the
+                                    // smallest key hash of interest.
+        uint64_t lastHash;          // Largest key hash covered by the
+                                    // scan (inclusive).
+        uint64_t minVersion;        // Objects with versions less than
+                                    // this are skipped; 0 means no
+                                    // version filter.
+        uint32_t maxPayloadBytes;   // Upper limit on payloadBytes in the
+                                    // response; 0 means use the largest
+                                    // limit the server allows.
+        uint16_t keyPrefixLength;   // Only objects whose primary keys
+                                    // start with this many bytes of
+                                    // prefix are returned. The prefix
+                                    // follows immediately after this
+                                    // header.
+        uint32_t iteratorBytes;     // Size of iterator in bytes. The
+                                    // actual iterator follows the key
+                                    // prefix. See EnumerationIterator.
+    } __attribute__((packed));
+    struct Response {
+        ResponseCommon common;
+        uint64_t tabletFirstHash;   // Same meaning as in Enumerate.
+        uint32_t payloadBytes;      // Same format as in Enumerate.
+        uint32_t iteratorBytes;     // Size of iterator in bytes. The
+                                    // actual iterator follows after
+                                    // the payload.
+    } __attribute__((packed));
+};
+
 struct ServerControl {
     static const Opcode opcode = Opcode::SERVER_CONTROL;
     static const ServiceType service = ADMIN_SERVICE;
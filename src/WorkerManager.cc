@@ -87,14 +87,22 @@ int WorkerManager::pollMicros = 10000;
  *      threads doesn't exceed this value. However, in order to prevent
  *      deadlocks, it may occasionally be necessary to go beyond this
  *      limit.
+ * \param steerByKeyHash
+ *      True means partition the key-hash space among maxCores of the
+ *      worker threads and hand single-key master requests to the worker
+ *      that owns the key's partition, when that worker is idle. False
+ *      means any idle worker may service any request.
  */
-WorkerManager::WorkerManager(Context* context, uint32_t maxCores)
+WorkerManager::WorkerManager(Context* context, uint32_t maxCores,
+        bool steerByKeyHash)
     : Dispatch::Poller(context->dispatch, "WorkerManager")
     , context(context)
     , levels()
     , busyThreads()
+    , numBusyThreads(0)
     , idleThreads()
     , maxCores(maxCores)
+    , keyPartitionOwners()
     , rpcsWaiting(0)
     , testingSaveRpcs(0)
     , testRpcs()
@@ -115,6 +123,9 @@ WorkerManager::WorkerManager(Context* context, uint32_t maxCores)
         Worker* worker = new Worker(context);
         worker->thread.construct(workerMain, worker);
         idleThreads.push_back(worker);
+        if (steerByKeyHash && (keyPartitionOwners.size() < maxCores)) {
+            keyPartitionOwners.push_back(worker);
+        }
     }
 }
 
@@ -245,13 +256,182 @@ WorkerManager::handleRpc(Transport::ServerRpc* rpc)
 
     // Hand off the RPC to a worker thread.
     assert(!idleThreads.empty());
-    Worker* worker = idleThreads.back();
-    idleThreads.pop_back();
+    Worker* worker = chooseWorker(rpc, header);
     worker->opcode = WireFormat::Opcode(header->opcode);
     worker->level = level;
     worker->handoff(rpc);
     worker->busyIndex = downCast<int>(busyThreads.size());
     busyThreads.push_back(worker);
+    numBusyThreads = downCast<uint32_t>(busyThreads.size());
+}
+
+/**
+ * Select an idle worker thread to execute an incoming RPC and remove it
+ * from idleThreads. If key steering is enabled and the RPC is a master
+ * request for a single key, the worker that owns the key's partition is
+ * preferred; if it is busy we don't wait for it, since that would leave
+ * cores idle while requests queue up behind a hot partition.
+ *
+ * \param rpc
+ *      The incoming RPC; idleThreads must not be empty.
+ * \param header
+ *      The request header at the start of rpc's request payload.
+ * \return
+ *      The worker that should execute the RPC.
+ */
+Worker*
+WorkerManager::chooseWorker(Transport::ServerRpc* rpc,
+        const WireFormat::RequestCommon* header)
+{
+    KeyHash keyHash;
+    MasterService* master = context->getMasterService();
+    rpc->keyHash.destroy();
+    if (!keyPartitionOwners.empty() && master != NULL
+            && getKeyHash(&rpc->requestPayload, header, &keyHash)) {
+        // Save the hash so the service doesn't compute it again.
+        rpc->keyHash.construct(keyHash);
+
+        // Partition by the hash table bucket lock that guards the key, so
+        // that each worker owns whole lock stripes: keys that share a lock
+        // (or a bucket) always belong to the same partition.
+        uint32_t lockIndex = master->objectManager.getBucketLockIndex(keyHash);
+        Worker* owner = keyPartitionOwners[lockIndex
+                % keyPartitionOwners.size()];
+        if (owner->busyIndex < 0) {
+            for (size_t i = 0; i < idleThreads.size(); i++) {
+                if (idleThreads[i] == owner) {
+                    idleThreads.erase(idleThreads.begin() + i);
+                    return owner;
+                }
+            }
+        }
+    }
+    Worker* worker = idleThreads.back();
+    idleThreads.pop_back();
+    return worker;
+}
+
+/**
+ * Extract the primary key hash from a master request that operates on a
+ * single object. Used to steer requests by key.
+ *
+ * \param request
+ *      Request message for an incoming RPC.
+ * \param header
+ *      The request header at the start of \a request.
+ * \param[out] keyHash
+ *      If the return value is true, the hash of the request's primary key
+ *      is stored here.
+ * \return
+ *      True means the request names a single key, whose hash has been
+ *      stored in \a keyHash. False means the request is of some other type,
+ *      or it is malformed (the service will report the error).
+ */
+bool
+WorkerManager::getKeyHash(Buffer* request,
+        const WireFormat::RequestCommon* header, KeyHash* keyHash)
+{
+    if (header->service != WireFormat::MASTER_SERVICE) {
+        return false;
+    }
+    uint64_t tableId;
+    uint32_t keyOffset;
+    uint16_t keyLength;
+    switch (header->opcode) {
+        case WireFormat::READ: {
+            const WireFormat::Read::Request* reqHdr =
+                    request->getStart<WireFormat::Read::Request>();
+            if (reqHdr == NULL) {
+                return false;
+            }
+            tableId = reqHdr->tableId;
+            keyOffset = sizeof32(*reqHdr);
+            keyLength = reqHdr->keyLength;
+            break;
+        }
+        case WireFormat::READ_KEYS_AND_VALUE: {
+            const WireFormat::ReadKeysAndValue::Request* reqHdr =
+                    request->getStart<WireFormat::ReadKeysAndValue::Request>();
+            if (reqHdr == NULL) {
+                return false;
+            }
+            tableId = reqHdr->tableId;
+            keyOffset = sizeof32(*reqHdr);
+            keyLength = reqHdr->keyLength;
+            break;
+        }
+        case WireFormat::INCREMENT: {
+            const WireFormat::Increment::Request* reqHdr =
+                    request->getStart<WireFormat::Increment::Request>();
+            if (reqHdr == NULL) {
+                return false;
+            }
+            tableId = reqHdr->tableId;
+            keyOffset = sizeof32(*reqHdr);
+            keyLength = reqHdr->keyLength;
+            break;
+        }
+        case WireFormat::REMOVE: {
+            const WireFormat::Remove::Request* reqHdr =
+                    request->getStart<WireFormat::Remove::Request>();
+            if (reqHdr == NULL) {
+                return false;
+            }
+            tableId = reqHdr->tableId;
+            keyOffset = sizeof32(*reqHdr);
+            keyLength = reqHdr->keyLength;
+            break;
+        }
+        case WireFormat::WRITE: {
+            // The primary key is the first key in the object's keysAndValue
+            // blob (see Object). Find it directly rather than constructing
+            // an Object, to keep the dispatch thread's work small.
+            const WireFormat::Write::Request* reqHdr =
+                    request->getStart<WireFormat::Write::Request>();
+            if (reqHdr == NULL) {
+                return false;
+            }
+            uint32_t keyInfoOffset = sizeof32(*reqHdr);
+            const KeyCount* numKeys =
+                    request->getOffset<KeyCount>(keyInfoOffset);
+            if (numKeys == NULL || *numKeys == 0) {
+                return false;
+            }
+            const CumulativeKeyLength* firstKeyLength =
+                    request->getOffset<CumulativeKeyLength>(
+                    keyInfoOffset + sizeof32(KeyCount));
+            if (firstKeyLength == NULL || *firstKeyLength == 0) {
+                return false;
+            }
+            tableId = reqHdr->tableId;
+            keyOffset = keyInfoOffset + KEY_INFO_LENGTH(*numKeys);
+            keyLength = *firstKeyLength;
+            break;
+        }
+        default:
+            return false;
+    }
+
+    const void* key = request->getRange(keyOffset, keyLength);
+    if (key == NULL) {
+        return false;
+    }
+    *keyHash = Key::getHash(tableId, key, keyLength);
+    return true;
+}
+
+/**
+ * Returns true if fewer worker threads are executing RPCs than the number
+ * of cores set aside for them (i.e., the server isn't using all of the
+ * cores it could for servicing requests). Unlike most methods of this
+ * class, this may be invoked from any thread; the answer may be slightly
+ * stale. Used by other modules, such as the log cleaner, that would like
+ * to borrow cores when the server is lightly loaded.
+ */
+bool
+WorkerManager::hasIdleCore()
+{
+    return numBusyThreads.load() < maxCores;
 }
 
 /**
@@ -360,6 +540,7 @@ WorkerManager::poll()
                         worker->busyIndex;
             }
             busyThreads.pop_back();
+            numBusyThreads = downCast<uint32_t>(busyThreads.size());
             worker->busyIndex = -1;
             idleThreads.push_back(worker);
         }
@@ -460,6 +641,8 @@ WorkerManager::workerMain(Worker* worker)
             worker->rpc->epoch = LogProtector::getCurrentEpoch();
             Service::Rpc rpc(worker, &worker->rpc->requestPayload,
                     &worker->rpc->replyPayload);
+            if (worker->rpc->keyHash)
+                rpc.keyHash.construct(*worker->rpc->keyHash);
             Service::handleRpc(worker->context, &rpc);
 
             // Pass the RPC back to the dispatch thread for completion.
@@ -16,9 +16,11 @@
 #ifndef RAMCLOUD_WORKERMANAGER_H
 #define RAMCLOUD_WORKERMANAGER_H
 
+#include <atomic>
 #include <queue>
 
 #include "Dispatch.h"
+#include "Key.h"
 #include "Service.h"
 #include "Transport.h"
 #include "WireFormat.h"
@@ -36,11 +38,13 @@ namespace RAMCloud {
  */
 class WorkerManager : Dispatch::Poller {
   public:
-    explicit WorkerManager(Context* context, uint32_t maxCores = 3);
+    explicit WorkerManager(Context* context, uint32_t maxCores = 3,
+            bool steerByKeyHash = false);
     ~WorkerManager();
 
     void exitWorker();
     void handleRpc(Transport::ServerRpc* rpc);
+    bool hasIdleCore();
     bool idle();
     static void init();
     int poll();
@@ -51,6 +55,10 @@ class WorkerManager : Dispatch::Poller {
   static inline void timeTrace(const char* format,
         uint32_t arg0 = 0, uint32_t arg1 = 0, uint32_t arg2 = 0,
         uint32_t arg3 = 0);
+    Worker* chooseWorker(Transport::ServerRpc* rpc,
+            const WireFormat::RequestCommon* header);
+    static bool getKeyHash(Buffer* request,
+            const WireFormat::RequestCommon* header, KeyHash* keyHash);
 
     /// How many microseconds worker threads should remain in their polling
     /// loop waiting for work. If no new arrives during this period the
@@ -83,6 +91,10 @@ class WorkerManager : Dispatch::Poller {
     // Worker threads that are currently executing RPCs (no particular order).
     std::vector<Worker*> busyThreads;
 
+    // Copy of busyThreads.size(), which may be read safely from threads
+    // other than the dispatch thread (see hasIdleCore).
+    std::atomic<uint32_t> numBusyThreads;
+
     // Worker threads that are available to execute incoming RPCs.  Threads
     // are push_back'ed and pop_back'ed (the thread with highest index was
     // the last one to go idle, so it's most likely to be POLLING and thus
@@ -94,6 +106,15 @@ class WorkerManager : Dispatch::Poller {
     // deadlock; other RPCs will wait until some threads finish.
     uint32_t maxCores;
 
+    // If key steering is enabled, this holds one worker thread for each
+    // partition of the key-hash space (one partition per core allowed by
+    // maxCores); otherwise it is empty. Each partition consists of whole
+    // hash table bucket lock stripes (see ObjectManager::getBucketLockIndex).
+    // Master requests that name a single key are given to the partition's
+    // worker whenever it is idle, so that all operations on a given bucket
+    // lock (and its buckets and cache lines) tend to run on the same core.
+    std::vector<Worker*> keyPartitionOwners;
+
     // Total number of RPCs (across all Levels) in waitingRpcs queues.
     int rpcsWaiting;
 
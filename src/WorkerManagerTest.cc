@@ -15,10 +15,13 @@
 
 #include "TestUtil.h"
 #include "Common.h"
+#include "MasterService.h"
 #include "MockService.h"
 #include "MockSyscall.h"
 #include "MockTransport.h"
+#include "Object.h"
 #include "RpcLevel.h"
+#include "ServerList.h"
 #include "Tub.h"
 #include "WorkerManager.h"
 
@@ -200,6 +203,116 @@ TEST_F(WorkerManagerTest, handleRpc_handoffToWorker) {
     EXPECT_EQ(5U, manager->idleThreads.size());
 }
 
+TEST_F(WorkerManagerTest, chooseWorker_steerByKeyHash) {
+    ServerList serverList(&context);
+    ServerConfig config(ServerConfig::forTesting());
+    WorkerManager manager1(&context, 3, true);
+    EXPECT_EQ(3U, manager1.keyPartitionOwners.size());
+    Key key(5, "abc", 3);
+    MockTransport::MockServerRpc rpc(&transport, NULL);
+    WireFormat::Read::Request* reqHdr =
+            rpc.requestPayload.emplaceAppend<WireFormat::Read::Request>();
+    reqHdr->common.opcode = WireFormat::READ;
+    reqHdr->common.service = WireFormat::MASTER_SERVICE;
+    reqHdr->tableId = 5;
+    reqHdr->keyLength = 3;
+    rpc.requestPayload.appendCopy("abc", 3);
+    size_t numIdle = manager1.idleThreads.size();
+
+    // No master service on this server: nothing to steer by.
+    Worker* last = manager1.idleThreads.back();
+    EXPECT_EQ(last, manager1.chooseWorker(&rpc, &reqHdr->common));
+    EXPECT_FALSE(rpc.keyHash);
+    manager1.idleThreads.push_back(last);
+
+    MasterService master(&context, &config);
+    uint32_t lockIndex = master.objectManager.getBucketLockIndex(
+            key.getHash());
+    Worker* owner = manager1.keyPartitionOwners[lockIndex % 3];
+
+    EXPECT_EQ(owner, manager1.chooseWorker(&rpc, &reqHdr->common));
+    EXPECT_EQ(numIdle - 1, manager1.idleThreads.size());
+    ASSERT_TRUE(rpc.keyHash);
+    EXPECT_EQ(key.getHash(), *rpc.keyHash);
+    manager1.idleThreads.push_back(owner);
+
+    // The owner is busy: use any other idle worker.
+    owner->busyIndex = 0;
+    Worker* other = manager1.idleThreads[0];
+    manager1.idleThreads[0] = owner;
+    manager1.idleThreads.back() = other;
+    EXPECT_EQ(other, manager1.chooseWorker(&rpc, &reqHdr->common));
+    manager1.idleThreads.push_back(other);
+    owner->busyIndex = -1;
+
+    // Requests without a key aren't steered.
+    reqHdr->common.service = WireFormat::BACKUP_SERVICE;
+    EXPECT_EQ(other, manager1.chooseWorker(&rpc, &reqHdr->common));
+    EXPECT_FALSE(rpc.keyHash);
+    manager1.idleThreads.push_back(other);
+}
+
+TEST_F(WorkerManagerTest, getKeyHash) {
+    KeyHash keyHash = 0;
+    Key key(5, "abc", 3);
+    Buffer request;
+    WireFormat::Remove::Request* reqHdr =
+            request.emplaceAppend<WireFormat::Remove::Request>();
+    reqHdr->common.opcode = WireFormat::REMOVE;
+    reqHdr->common.service = WireFormat::MASTER_SERVICE;
+    reqHdr->tableId = 5;
+    reqHdr->keyLength = 3;
+
+    // Key missing from the request.
+    EXPECT_FALSE(WorkerManager::getKeyHash(&request, &reqHdr->common,
+            &keyHash));
+    request.appendCopy("abc", 3);
+    EXPECT_TRUE(WorkerManager::getKeyHash(&request, &reqHdr->common,
+            &keyHash));
+    EXPECT_EQ(key.getHash(), keyHash);
+
+    // Not a single-key request.
+    reqHdr->common.opcode = WireFormat::MULTI_OP;
+    EXPECT_FALSE(WorkerManager::getKeyHash(&request, &reqHdr->common,
+            &keyHash));
+}
+
+TEST_F(WorkerManagerTest, getKeyHash_write) {
+    KeyHash keyHash = 0;
+    Key key(5, "abc", 3);
+    Buffer request;
+    WireFormat::Write::Request* reqHdr =
+            request.emplaceAppend<WireFormat::Write::Request>();
+    reqHdr->common.opcode = WireFormat::WRITE;
+    reqHdr->common.service = WireFormat::MASTER_SERVICE;
+    reqHdr->tableId = 5;
+
+    // No keysAndValue in the request.
+    EXPECT_FALSE(WorkerManager::getKeyHash(&request, &reqHdr->common,
+            &keyHash));
+
+    uint32_t length = 0;
+    Object::appendKeysAndValueToBuffer(key, "value", 5, &request, false,
+            &length);
+    reqHdr->length = length;
+    EXPECT_TRUE(WorkerManager::getKeyHash(&request, &reqHdr->common,
+            &keyHash));
+    EXPECT_EQ(key.getHash(), keyHash);
+}
+
+TEST_F(WorkerManagerTest, hasIdleCore) {
+    manager->maxCores = 1;
+    EXPECT_TRUE(manager->hasIdleCore());
+    MockTransport::MockServerRpc* rpc = new MockTransport::MockServerRpc(
+            &transport, "0x10000 3 4");
+    manager->handleRpc(rpc);
+    EXPECT_FALSE(manager->hasIdleCore());
+
+    waitUntilDone(1);
+    manager->poll();
+    EXPECT_TRUE(manager->hasIdleCore());
+}
+
 TEST_F(WorkerManagerTest, idle) {
     EXPECT_TRUE(manager->idle());
     // Start one RPC.
@@ -0,0 +1,1055 @@
+/* Copyright (c) 2017 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <errno.h>
+#include <net/if.h>
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "Common.h"
+#include "Cycles.h"
+#include "Dispatch.h"
+#include "NetUtil.h"
+#include "PerfStats.h"
+#include "ShortMacros.h"
+#include "XdpDriver.h"
+
+// Older C libraries don't define these.
+#ifndef AF_XDP
+#define AF_XDP 44
+#endif
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+namespace RAMCloud {
+
+/**
+ * Default object used to make system calls.
+ */
+static Syscall defaultSyscall;
+
+/**
+ * Used by this class to make all system calls.  In normal production
+ * use it points to defaultSyscall; for testing it points to a mock
+ * object.
+ */
+Syscall* XdpDriver::sys = &defaultSyscall;
+
+constexpr uint16_t XdpDriver::PRIORITY_TO_PCP[8];
+
+namespace {
+    /// Invoke the bpf system call (there is no C library wrapper).
+    int
+    bpf(int cmd, union bpf_attr* attr)
+    {
+        return static_cast<int>(syscall(__NR_bpf, cmd, attr, sizeof(*attr)));
+    }
+
+    /// Assemble one eBPF instruction.
+    bpf_insn
+    instruction(uint8_t code, uint8_t dst, uint8_t src, int16_t offset,
+            int32_t imm)
+    {
+        bpf_insn insn;
+        insn.code = code;
+        insn.dst_reg = dst & 0xf;
+        insn.src_reg = src & 0xf;
+        insn.off = offset;
+        insn.imm = imm;
+        return insn;
+    }
+}
+
+#if TESTING
+/**
+ * Construct an XdpDriver for unit tests: it has a UMEM and rings, but no
+ * socket, so tests play the role of the kernel.
+ *
+ * \param context
+ *      Overall information about the RAMCloud server or client.
+ */
+XdpDriver::XdpDriver(Context* context)
+    : context(context)
+    , locatorString("xdp:ifname=test,mac=01:23:45:67:89:ab")
+    , ifName()
+    , ifIndex(0)
+    , queueId(0)
+    , localMac()
+    , fd(-1)
+    , xskMapFd(-1)
+    , programFd(-1)
+    , linkFd(-1)
+    , umemBase(NULL)
+    , umemBytes(0)
+    , framesOffset(0)
+    , frames(NULL)
+    , retiredFrames(NULL)
+    , freeRxFrames()
+    , freeTxFrames()
+    , rxRing()
+    , txRing()
+    , fillRing()
+    , completionRing()
+    , loopbackPackets()
+    , discardingFragments(false)
+    , packetBufPool()
+    , packetsOutstanding(0)
+    , framesHeld(0)
+    , txDescsQueued(0)
+    , txDescsCompleted(0)
+    , transmitBatchActive(false)
+    , zeroCopyMode(false)
+    , multiBuffer(false)
+    , bandwidthMbps(10000)
+    , queueEstimator(0)
+    , maxTransmitQueueSize(0)
+    , mutex("XdpDriver::mutex")
+{
+    localMac.construct("01:23:45:67:89:ab");
+    queueEstimator.setBandwidth(bandwidthMbps);
+    maxTransmitQueueSize = 2*getMaxPacketSize();
+    createUmem(NULL, 0);
+    SpinLock::Guard guard(mutex);
+    openSocket();
+}
+#endif
+
+/**
+ * Construct an XdpDriver.
+ *
+ * \param context
+ *      Overall information about the RAMCloud server or client.
+ * \param localServiceLocator
+ *      Specifies the interface to use ("ifname" option) and, optionally,
+ *      the receive queue ("queue"), MAC address ("mac"), and link speed in
+ *      Gbits/sec ("gbs").
+ * \throw DriverException
+ *      The interface doesn't exist, or the AF_XDP socket or XDP program
+ *      couldn't be set up (the latter typically requires root privileges
+ *      or CAP_NET_ADMIN and CAP_BPF).
+ */
+XdpDriver::XdpDriver(Context* context,
+        const ServiceLocator* localServiceLocator)
+    : context(context)
+    , locatorString()
+    , ifName()
+    , ifIndex(0)
+    , queueId(0)
+    , localMac()
+    , fd(-1)
+    , xskMapFd(-1)
+    , programFd(-1)
+    , linkFd(-1)
+    , umemBase(NULL)
+    , umemBytes(0)
+    , framesOffset(0)
+    , frames(NULL)
+    , retiredFrames(NULL)
+    , freeRxFrames()
+    , freeTxFrames()
+    , rxRing()
+    , txRing()
+    , fillRing()
+    , completionRing()
+    , loopbackPackets()
+    , discardingFragments(false)
+    , packetBufPool()
+    , packetsOutstanding(0)
+    , framesHeld(0)
+    , txDescsQueued(0)
+    , txDescsCompleted(0)
+    , transmitBatchActive(false)
+    , zeroCopyMode(false)
+    , multiBuffer(false)
+    , bandwidthMbps(10000)                // Default bandwidth = 10 gbs
+    , queueEstimator(0)
+    , maxTransmitQueueSize(0)
+    , mutex("XdpDriver::mutex")
+{
+    if (localServiceLocator == NULL ||
+            !localServiceLocator->hasOption("ifname")) {
+        throw DriverException(HERE, "XdpDriver requires an ifname option "
+                "in its service locator");
+    }
+    ifName = localServiceLocator->getOption("ifname");
+    ifIndex = if_nametoindex(ifName.c_str());
+    if (ifIndex == 0) {
+        throw DriverException(HERE, format("XdpDriver couldn't find "
+                "network interface %s", ifName.c_str()), errno);
+    }
+    queueId = localServiceLocator->getOption<uint32_t>("queue", 0);
+    if (queueId >= MAX_QUEUES) {
+        throw DriverException(HERE, format("XdpDriver can't use queue %u "
+                "(maximum is %u)", queueId, MAX_QUEUES - 1));
+    }
+    const char* mac = localServiceLocator->getOption<const char*>("mac",
+            NULL);
+    if (mac != NULL) {
+        localMac.construct(mac);
+    } else {
+        localMac.construct(NetUtil::getLocalMac(ifName.c_str()).c_str());
+    }
+    bandwidthMbps = 1000*localServiceLocator->getOption<uint32_t>("gbs", 10);
+    locatorString = format("xdp:ifname=%s,queue=%u,mac=%s", ifName.c_str(),
+            queueId, localMac->toString().c_str());
+
+    queueEstimator.setBandwidth(bandwidthMbps);
+    maxTransmitQueueSize = (uint32_t) (static_cast<double>(bandwidthMbps)
+            * MAX_DRAIN_TIME / 8000.0);
+    uint32_t maxPacketSize = getMaxPacketSize();
+    if (maxTransmitQueueSize < 2*maxPacketSize) {
+        // Make sure that we advertise enough space in the transmit queue to
+        // prepare the next packet while the current one is transmitting.
+        maxTransmitQueueSize = 2*maxPacketSize;
+    }
+
+    if (!createUmem(NULL, 0)) {
+        throw DriverException(HERE, "XdpDriver couldn't allocate memory for "
+                "packet frames", errno);
+    }
+    try {
+        installXdpProgram();
+        SpinLock::Guard guard(mutex);
+        openSocket();
+    } catch (...) {
+        closeSocket();
+        if (linkFd >= 0)
+            sys->close(linkFd);
+        if (programFd >= 0)
+            sys->close(programFd);
+        if (xskMapFd >= 0)
+            sys->close(xskMapFd);
+        munmap(frames, (NUM_RX_FRAMES + NUM_TX_FRAMES) * FRAME_SIZE);
+        throw;
+    }
+
+    LOG(NOTICE, "XdpDriver locator: %s, %s mode%s, bandwidth: %u "
+            "Mbits/sec, maxTransmitQueueSize: %u bytes",
+            locatorString.c_str(), zeroCopyMode ? "zero-copy" : "copy",
+            multiBuffer ? " (multi-buffer)" : "", bandwidthMbps,
+            maxTransmitQueueSize);
+}
+
+/**
+ * Destroy the XdpDriver. Closing the BPF link detaches the XDP program
+ * from the interface.
+ */
+XdpDriver::~XdpDriver()
+{
+    if (packetsOutstanding != 0)
+        LOG(ERROR, "XdpDriver deleted with %d packets still in use",
+            packetsOutstanding);
+    closeSocket();
+    if (linkFd >= 0)
+        sys->close(linkFd);
+    if (programFd >= 0)
+        sys->close(programFd);
+    if (xskMapFd >= 0)
+        sys->close(xskMapFd);
+    size_t frameBytes = (NUM_RX_FRAMES + NUM_TX_FRAMES) * FRAME_SIZE;
+    munmap(frames, frameBytes);
+    if (retiredFrames != NULL)
+        munmap(retiredFrames, frameBytes);
+}
+
+/**
+ * Unmap the rings and close the AF_XDP socket (if they exist). Packets
+ * in the rings are lost.
+ */
+void
+XdpDriver::closeSocket()
+{
+    Ring* rings[] = {&rxRing, &txRing, &fillRing, &completionRing};
+    for (Ring* ring : rings) {
+        if (ring->mapping != NULL) {
+            if (ring->mappingLength != 0) {
+                munmap(ring->mapping, ring->mappingLength);
+            } else {
+                free(ring->mapping);
+            }
+        }
+        ring->producer = ring->consumer = ring->flags = NULL;
+        ring->entries = NULL;
+        ring->cachedIndex = 0;
+        ring->mapping = NULL;
+        ring->mappingLength = 0;
+    }
+    if (fd >= 0) {
+        sys->close(fd);
+        fd = -1;
+    }
+
+    // The kernel no longer references any of our memory for transmission,
+    // and loopback packets refer to frames that are about to be retired.
+    txDescsCompleted = txDescsQueued;
+    loopbackPackets.clear();
+}
+
+/**
+ * Allocate memory for the driver's packet frames and lay out the UMEM
+ * region. If this method succeeds, the previous frames (if any) are
+ * retired; the caller must then open a new socket.
+ *
+ * \param region
+ *      Memory that will be transmitted from without copying (it becomes
+ *      the first part of the UMEM), or NULL. Must be page-aligned.
+ * \param regionBytes
+ *      Size of \a region in bytes.
+ * \return
+ *      True means success. False means the frames couldn't be mapped
+ *      (if \a region is non-NULL, this typically means that the address
+ *      space just after it is in use); nothing has been changed.
+ */
+bool
+XdpDriver::createUmem(char* region, size_t regionBytes)
+{
+    // The UMEM must be a single contiguous range of virtual addresses, so
+    // the frames have to be placed just after the registered region.
+    size_t frameBytes = (NUM_RX_FRAMES + NUM_TX_FRAMES) * FRAME_SIZE;
+    uint64_t offset = (regionBytes + FRAME_SIZE - 1) & ~(FRAME_SIZE - 1UL);
+    char* address = (region == NULL) ? NULL : region + offset;
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE;
+    if (address != NULL)
+        flags |= MAP_FIXED_NOREPLACE;
+    void* mapping = mmap(address, frameBytes, PROT_READ | PROT_WRITE, flags,
+            -1, 0);
+    if (mapping == MAP_FAILED)
+        return false;
+    if (address != NULL && mapping != address) {
+        // Kernels older than 4.17 treat MAP_FIXED_NOREPLACE as a hint.
+        munmap(mapping, frameBytes);
+        return false;
+    }
+
+    if (frames != NULL) {
+        assert(retiredFrames == NULL);
+        retiredFrames = frames;
+    }
+    frames = static_cast<char*>(mapping);
+    umemBase = (region == NULL) ? frames : region;
+    framesOffset = offset;
+    umemBytes = framesOffset + frameBytes;
+
+    freeRxFrames.clear();
+    for (uint32_t i = 0; i < NUM_RX_FRAMES; i++)
+        freeRxFrames.push_back(framesOffset + i*FRAME_SIZE);
+    freeTxFrames.clear();
+    for (uint32_t i = 0; i < NUM_TX_FRAMES; i++)
+        freeTxFrames.push_back(framesOffset + (NUM_RX_FRAMES + i)*FRAME_SIZE);
+    return true;
+}
+
+/**
+ * Create an XDP program that redirects RAMCloud packets to our socket,
+ * and attach it to the interface.
+ */
+void
+XdpDriver::installXdpProgram()
+{
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.map_type = BPF_MAP_TYPE_XSKMAP;
+    attr.key_size = sizeof(uint32_t);
+    attr.value_size = sizeof(int);
+    attr.max_entries = MAX_QUEUES;
+    xskMapFd = bpf(BPF_MAP_CREATE, &attr);
+    if (xskMapFd < 0) {
+        throw DriverException(HERE, "XdpDriver couldn't create XSKMAP",
+                errno);
+    }
+
+    // The program below is equivalent to the following C code:
+    //
+    //     if (data + 18 > data_end)
+    //         return XDP_PASS;
+    //     type = *(uint16_t*)(data + 12);
+    //     if (type != RAMCLOUD) {
+    //         if (type != VLAN || *(uint16_t*)(data + 16) != RAMCLOUD)
+    //             return XDP_PASS;
+    //     }
+    //     return bpf_redirect_map(&xskMap, ctx->rx_queue_index, XDP_PASS);
+    //
+    // Jump offsets are relative to the following instruction.
+    int32_t ramcloudType = HTONS(NetUtil::EthPayloadType::RAMCLOUD);
+    int32_t vlanType = HTONS(ETH_P_8021Q);
+    bpf_insn program[] = {
+        // r2 = ctx->data; r3 = ctx->data_end
+        instruction(BPF_LDX | BPF_MEM | BPF_W, 2, 1, 0, 0),
+        instruction(BPF_LDX | BPF_MEM | BPF_W, 3, 1, 4, 0),
+        // if (r2 + 18 > r3) goto pass
+        instruction(BPF_ALU64 | BPF_MOV | BPF_X, 4, 2, 0, 0),
+        instruction(BPF_ALU64 | BPF_ADD | BPF_K, 4, 0, 0, 18),
+        instruction(BPF_JMP | BPF_JGT | BPF_X, 4, 3, 11, 0),
+        // r5 = Ethernet type
+        instruction(BPF_LDX | BPF_MEM | BPF_H, 5, 2, 12, 0),
+        instruction(BPF_JMP | BPF_JEQ | BPF_K, 5, 0, 3, ramcloudType),
+        instruction(BPF_JMP | BPF_JNE | BPF_K, 5, 0, 8, vlanType),
+        // r5 = Ethernet type after VLAN tag
+        instruction(BPF_LDX | BPF_MEM | BPF_H, 5, 2, 16, 0),
+        instruction(BPF_JMP | BPF_JNE | BPF_K, 5, 0, 6, ramcloudType),
+        // redirect: r2 = ctx->rx_queue_index; r1 = xskMap; r3 = XDP_PASS
+        instruction(BPF_LDX | BPF_MEM | BPF_W, 2, 1, 16, 0),
+        instruction(BPF_LD | BPF_IMM | BPF_DW, 1, BPF_PSEUDO_MAP_FD, 0,
+                xskMapFd),
+        instruction(0, 0, 0, 0, 0),
+        instruction(BPF_ALU64 | BPF_MOV | BPF_K, 3, 0, 0, XDP_PASS),
+        instruction(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map),
+        instruction(BPF_JMP | BPF_EXIT, 0, 0, 0, 0),
+        // pass:
+        instruction(BPF_ALU64 | BPF_MOV | BPF_K, 0, 0, 0, XDP_PASS),
+        instruction(BPF_JMP | BPF_EXIT, 0, 0, 0, 0),
+    };
+
+    static const char license[] = "BSD";
+    memset(&attr, 0, sizeof(attr));
+    attr.prog_type = BPF_PROG_TYPE_XDP;
+    attr.insn_cnt = sizeof32(program) / sizeof32(program[0]);
+    attr.insns = reinterpret_cast<uint64_t>(program);
+    attr.license = reinterpret_cast<uint64_t>(license);
+    programFd = bpf(BPF_PROG_LOAD, &attr);
+    if (programFd < 0) {
+        throw DriverException(HERE, "XdpDriver couldn't load XDP program",
+                errno);
+    }
+
+    memset(&attr, 0, sizeof(attr));
+    attr.link_create.prog_fd = programFd;
+    attr.link_create.target_ifindex = ifIndex;
+    attr.link_create.attach_type = BPF_XDP;
+    linkFd = bpf(BPF_LINK_CREATE, &attr);
+    if (linkFd < 0) {
+        throw DriverException(HERE, format("XdpDriver couldn't attach XDP "
+                "program to %s (is another XdpDriver using it?)",
+                ifName.c_str()), errno);
+    }
+}
+
+/**
+ * Make newly queued transmit descriptors visible to the kernel, and
+ * issue a system call if the kernel needs one to start transmitting them.
+ */
+void
+XdpDriver::kickTransmit()
+{
+    __atomic_store_n(txRing.producer, txRing.cachedIndex, __ATOMIC_RELEASE);
+    if (fd < 0)
+        return;
+
+    // In copy mode, the kernel transmits only during system calls.
+    if (!zeroCopyMode ||
+            (__atomic_load_n(txRing.flags, __ATOMIC_RELAXED)
+            & XDP_RING_NEED_WAKEUP)) {
+        if (sys->sendto(fd, NULL, 0, MSG_DONTWAIT, NULL, 0) < 0
+                && errno != EAGAIN && errno != EBUSY && errno != ENOBUFS
+                && errno != ENETDOWN) {
+            RAMCLOUD_CLOG(WARNING, "XdpDriver couldn't start transmission: "
+                    "%s", strerror(errno));
+        }
+    }
+}
+
+/**
+ * Map one of the socket's rings into our address space.
+ *
+ * \param ring
+ *      Filled in with information about the ring.
+ * \param pageOffset
+ *      Identifies the ring to the kernel (XDP_PGOFF_RX_RING, etc.).
+ * \param entrySize
+ *      Size of each of the ring's entries, in bytes.
+ * \param offsets
+ *      Location of the ring's fields in the mapping, as returned by the
+ *      kernel.
+ */
+void
+XdpDriver::mapRing(Ring* ring, uint64_t pageOffset, uint32_t entrySize,
+        const xdp_ring_offset* offsets)
+{
+    size_t length = offsets->desc + RING_SIZE*entrySize;
+    void* mapping = mmap(NULL, length, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, fd, pageOffset);
+    if (mapping == MAP_FAILED) {
+        throw DriverException(HERE, "XdpDriver couldn't map AF_XDP ring",
+                errno);
+    }
+    char* base = static_cast<char*>(mapping);
+    ring->producer = reinterpret_cast<uint32_t*>(base + offsets->producer);
+    ring->consumer = reinterpret_cast<uint32_t*>(base + offsets->consumer);
+    ring->flags = reinterpret_cast<uint32_t*>(base + offsets->flags);
+    ring->entries = base + offsets->desc;
+    ring->mapping = mapping;
+    ring->mappingLength = length;
+}
+
+/**
+ * Create an AF_XDP socket, register the UMEM with it, and map its rings.
+ */
+void
+XdpDriver::createSocket()
+{
+    fd = sys->socket(AF_XDP, SOCK_RAW, 0);
+    if (fd < 0) {
+        throw DriverException(HERE, "XdpDriver couldn't create AF_XDP socket",
+                errno);
+    }
+
+    xdp_umem_reg umem;
+    memset(&umem, 0, sizeof(umem));
+    umem.addr = reinterpret_cast<uint64_t>(umemBase);
+    umem.len = umemBytes;
+    umem.chunk_size = FRAME_SIZE;
+    umem.headroom = RX_HEADROOM;
+    if (sys->setsockopt(fd, SOL_XDP, XDP_UMEM_REG, &umem,
+            sizeof(umem)) < 0) {
+        throw DriverException(HERE, format("XdpDriver couldn't register "
+                "%lu bytes of UMEM", umemBytes), errno);
+    }
+
+    int ringSize = RING_SIZE;
+    int ringOptions[] = {XDP_UMEM_FILL_RING, XDP_UMEM_COMPLETION_RING,
+            XDP_RX_RING, XDP_TX_RING};
+    for (int option : ringOptions) {
+        if (sys->setsockopt(fd, SOL_XDP, option, &ringSize,
+                sizeof(ringSize)) < 0) {
+            throw DriverException(HERE, "XdpDriver couldn't size AF_XDP "
+                    "ring", errno);
+        }
+    }
+
+    xdp_mmap_offsets offsets;
+    socklen_t offsetsLength = sizeof(offsets);
+    if (sys->getsockopt(fd, SOL_XDP, XDP_MMAP_OFFSETS, &offsets,
+            &offsetsLength) < 0) {
+        throw DriverException(HERE, "XdpDriver couldn't get AF_XDP ring "
+                "offsets", errno);
+    }
+    mapRing(&rxRing, XDP_PGOFF_RX_RING, sizeof32(xdp_desc), &offsets.rx);
+    mapRing(&txRing, XDP_PGOFF_TX_RING, sizeof32(xdp_desc), &offsets.tx);
+    mapRing(&fillRing, XDP_UMEM_PGOFF_FILL_RING, sizeof32(uint64_t),
+            &offsets.fr);
+    mapRing(&completionRing, XDP_UMEM_PGOFF_COMPLETION_RING,
+            sizeof32(uint64_t), &offsets.cr);
+    rxRing.cachedIndex = *rxRing.consumer;
+    txRing.cachedIndex = *txRing.producer;
+    fillRing.cachedIndex = *fillRing.producer;
+    completionRing.cachedIndex = *completionRing.consumer;
+}
+
+/**
+ * Open an AF_XDP socket for the current UMEM, bind it to our queue, and
+ * connect it to the XDP program. Must be invoked with mutex held.
+ */
+void
+XdpDriver::openSocket()
+{
+#if TESTING
+    if (ifName.empty()) {
+        // Unit test: allocate rings in ordinary memory instead.
+        struct Indexes { uint32_t producer, consumer, flags, pad; };
+        Ring* rings[] = {&rxRing, &txRing, &fillRing, &completionRing};
+        for (Ring* ring : rings) {
+            ring->mapping = calloc(1, sizeof(Indexes)
+                    + RING_SIZE*sizeof(xdp_desc));
+            Indexes* indexes = static_cast<Indexes*>(ring->mapping);
+            ring->producer = &indexes->producer;
+            ring->consumer = &indexes->consumer;
+            ring->flags = &indexes->flags;
+            ring->entries = indexes + 1;
+        }
+        multiBuffer = true;
+        refillRxRing();
+        return;
+    }
+#endif
+
+    // Prefer zero-copy mode and multi-buffer packets, but accept whatever
+    // the NIC driver and kernel support. A socket can't be bound again
+    // after a failed attempt, so each attempt needs a new one. The kernel
+    // releases a closed socket's queue asynchronously, so EBUSY may just
+    // mean we closed a socket (in registerMemory) a moment ago.
+    static const uint16_t modes[] = {XDP_ZEROCOPY | XDP_USE_SG, XDP_ZEROCOPY,
+            XDP_COPY | XDP_USE_SG, XDP_COPY};
+    sockaddr_xdp address;
+    memset(&address, 0, sizeof(address));
+    address.sxdp_family = AF_XDP;
+    address.sxdp_ifindex = ifIndex;
+    address.sxdp_queue_id = queueId;
+    uint64_t deadline = Cycles::rdtsc() + Cycles::fromSeconds(1.0);
+    int error = 0;
+    for (uint32_t i = 0; i < sizeof(modes)/sizeof(modes[0]); ) {
+        createSocket();
+        address.sxdp_flags = modes[i] | XDP_USE_NEED_WAKEUP;
+        if (sys->bind(fd, reinterpret_cast<sockaddr*>(&address),
+                sizeof(address)) == 0) {
+            zeroCopyMode = (modes[i] & XDP_ZEROCOPY) != 0;
+            multiBuffer = (modes[i] & XDP_USE_SG) != 0;
+            error = 0;
+            break;
+        }
+        error = errno;
+        closeSocket();
+        if (error == EBUSY && Cycles::rdtsc() < deadline) {
+            usleep(1000);
+            continue;
+        }
+        i++;
+    }
+    if (error != 0) {
+        throw DriverException(HERE, format("XdpDriver couldn't bind AF_XDP "
+                "socket to %s, queue %u", ifName.c_str(), queueId), error);
+    }
+
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.map_fd = xskMapFd;
+    attr.key = reinterpret_cast<uint64_t>(&queueId);
+    attr.value = reinterpret_cast<uint64_t>(&fd);
+    if (bpf(BPF_MAP_UPDATE_ELEM, &attr) < 0) {
+        throw DriverException(HERE, "XdpDriver couldn't add socket to "
+                "XSKMAP", errno);
+    }
+    refillRxRing();
+}
+
+/**
+ * Pass an incoming packet to the transport, or recycle its frame if it
+ * isn't a RAMCloud packet. Must be invoked with mutex held.
+ *
+ * \param addr
+ *      UMEM offset of the first byte of the Ethernet frame.
+ * \param length
+ *      Total length of the frame, in bytes.
+ * \param receivedPackets
+ *      The packet is appended here.
+ */
+void
+XdpDriver::processFrame(uint64_t addr, uint32_t length,
+        std::vector<Received>* receivedPackets)
+{
+    char* data = umemBase + addr;
+    NetUtil::EthernetHeader* ethHeader =
+            reinterpret_cast<NetUtil::EthernetHeader*>(data);
+    uint32_t headerLength = sizeof32(NetUtil::EthernetHeader);
+    uint16_t etherType = ethHeader->etherType;
+    if (etherType == HTONS(ETH_P_8021Q) && length >= ETHER_VLAN_HDR_LEN) {
+        etherType = *reinterpret_cast<uint16_t*>(data + headerLength + 2);
+        headerLength += VLAN_TAG_LEN;
+    }
+    if (length <= headerLength ||
+            etherType != HTONS(NetUtil::EthPayloadType::RAMCLOUD)) {
+        freeRxFrames.push_back(addr & ~(FRAME_SIZE - 1UL));
+        return;
+    }
+
+    PerfStats::threadStats.networkInputBytes += length;
+    packetsOutstanding++;
+    if (framesHeld >= MAX_FRAMES_HELD) {
+        PacketBuf* buffer = packetBufPool.construct();
+        buffer->sender.construct(ethHeader->srcAddress);
+        memcpy(buffer->payload, data + headerLength, length - headerLength);
+        receivedPackets->emplace_back(buffer->sender.get(), this,
+                length - headerLength, buffer->payload);
+        freeRxFrames.push_back(addr & ~(FRAME_SIZE - 1UL));
+        return;
+    }
+
+    // The sender's address lives in the headroom in front of the packet,
+    // so it stays valid for as long as the transport holds the packet.
+    MacAddress* sender = new(data - RX_HEADROOM)
+            MacAddress(ethHeader->srcAddress);
+    framesHeld++;
+    receivedPackets->emplace_back(sender, this, length - headerLength,
+            data + headerLength);
+}
+
+/**
+ * Retrieve descriptors from the completion ring, making their transmit
+ * frames available for reuse.
+ */
+void
+XdpDriver::reapCompletions()
+{
+    uint32_t produced = __atomic_load_n(completionRing.producer,
+            __ATOMIC_ACQUIRE);
+    if (produced == completionRing.cachedIndex)
+        return;
+    uint64_t* entries = static_cast<uint64_t*>(completionRing.entries);
+    while (completionRing.cachedIndex != produced) {
+        uint64_t addr = entries[completionRing.cachedIndex & (RING_SIZE-1)];
+        if (addr >= framesOffset) {
+            // Descriptors in registered memory need no recycling.
+            freeTxFrames.push_back(addr & ~(FRAME_SIZE - 1UL));
+        }
+        completionRing.cachedIndex++;
+        txDescsCompleted++;
+    }
+    __atomic_store_n(completionRing.consumer, completionRing.cachedIndex,
+            __ATOMIC_RELEASE);
+}
+
+/**
+ * Pass free receive frames to the kernel through the fill ring. Must be
+ * invoked with mutex held.
+ */
+void
+XdpDriver::refillRxRing()
+{
+    uint32_t space = RING_SIZE - (fillRing.cachedIndex
+            - __atomic_load_n(fillRing.consumer, __ATOMIC_ACQUIRE));
+    uint32_t count = std::min(space, downCast<uint32_t>(freeRxFrames.size()));
+    if (count == 0)
+        return;
+    uint64_t* entries = static_cast<uint64_t*>(fillRing.entries);
+    for (uint32_t i = 0; i < count; i++) {
+        entries[fillRing.cachedIndex & (RING_SIZE-1)] = freeRxFrames.back();
+        freeRxFrames.pop_back();
+        fillRing.cachedIndex++;
+    }
+    __atomic_store_n(fillRing.producer, fillRing.cachedIndex,
+            __ATOMIC_RELEASE);
+}
+
+/**
+ * Fill in the Ethernet header (including a VLAN tag carrying the packet's
+ * priority) at the beginning of an outgoing frame.
+ *
+ * \param frame
+ *      Where to write the header.
+ * \param recipient
+ *      Where the packet should be sent.
+ * \param priority
+ *      Packet priority, in the range accepted by sendPacket.
+ * \return
+ *      The number of bytes written.
+ */
+uint32_t
+XdpDriver::writeEthernetHeader(char* frame, const MacAddress* recipient,
+        int priority)
+{
+    NetUtil::EthernetHeader* ethHeader =
+            reinterpret_cast<NetUtil::EthernetHeader*>(frame);
+    memcpy(ethHeader->destAddress, recipient->address, 6);
+    memcpy(ethHeader->srcAddress, localMac->address, 6);
+    ethHeader->etherType = HTONS(ETH_P_8021Q);
+    uint16_t* vlanTag = reinterpret_cast<uint16_t*>(ethHeader + 1);
+    vlanTag[0] = HTONS(PRIORITY_TO_PCP[priority]);
+    vlanTag[1] = HTONS(NetUtil::EthPayloadType::RAMCLOUD);
+    return ETHER_VLAN_HDR_LEN;
+}
+
+// See docs in Driver class.
+void
+XdpDriver::flushTransmitBatch()
+{
+    transmitBatchActive = false;
+    if (txRing.producer != NULL && *txRing.producer != txRing.cachedIndex)
+        kickTransmit();
+}
+
+// See docs in Driver class.
+int
+XdpDriver::getHighestPacketPriority()
+{
+    return 7;
+}
+
+// See docs in Driver class.
+uint32_t
+XdpDriver::getMaxPacketSize()
+{
+    return MAX_PAYLOAD_SIZE;
+}
+
+// See docs in Driver class.
+uint32_t
+XdpDriver::getBandwidth()
+{
+    return bandwidthMbps;
+}
+
+// See docs in Driver class.
+int
+XdpDriver::getTransmitQueueSpace(uint64_t currentTime)
+{
+    return maxTransmitQueueSize - queueEstimator.getQueueSize(currentTime);
+}
+
+// See docs in Driver class.
+string
+XdpDriver::getServiceLocator()
+{
+    return locatorString;
+}
+
+// See docs in Driver class.
+bool
+XdpDriver::isTransmitComplete(uint64_t mark)
+{
+    if (mark > txDescsCompleted)
+        reapCompletions();
+    return mark <= txDescsCompleted;
+}
+
+// See docs in Driver class.
+void
+XdpDriver::receivePackets(uint32_t maxPackets,
+        std::vector<Received>* receivedPackets)
+{
+    reapCompletions();
+    if (txRing.producer != NULL && __atomic_load_n(txRing.consumer,
+            __ATOMIC_ACQUIRE) != txRing.cachedIndex) {
+        // In copy mode the kernel transmits a limited number of packets
+        // per system call, so keep prodding it until the ring is empty.
+        kickTransmit();
+    }
+
+    SpinLock::Guard guard(mutex);
+    refillRxRing();
+    uint32_t available = __atomic_load_n(rxRing.producer, __ATOMIC_ACQUIRE)
+            - rxRing.cachedIndex;
+    uint32_t count = std::min(available, maxPackets);
+    xdp_desc* entries = static_cast<xdp_desc*>(rxRing.entries);
+    for (uint32_t i = 0; i < count; i++) {
+        xdp_desc* desc = &entries[rxRing.cachedIndex & (RING_SIZE-1)];
+        rxRing.cachedIndex++;
+
+        // Frames larger than FRAME_SIZE arrive in multiple pieces; we
+        // never send such packets, so discard them.
+        bool lastPiece = (desc->options & XDP_PKT_CONTD) == 0;
+        if (!lastPiece || discardingFragments) {
+            freeRxFrames.push_back(desc->addr & ~(FRAME_SIZE - 1UL));
+            discardingFragments = !lastPiece;
+            continue;
+        }
+        processFrame(desc->addr, desc->len, receivedPackets);
+    }
+    if (count > 0) {
+        __atomic_store_n(rxRing.consumer, rxRing.cachedIndex,
+                __ATOMIC_RELEASE);
+    }
+
+    while (!loopbackPackets.empty() && count < maxPackets) {
+        processFrame(loopbackPackets.front().addr,
+                loopbackPackets.front().len, receivedPackets);
+        loopbackPackets.pop_front();
+        count++;
+    }
+
+    if (fd >= 0 && (__atomic_load_n(fillRing.flags, __ATOMIC_RELAXED)
+            & XDP_RING_NEED_WAKEUP)) {
+        sys->recvfrom(fd, NULL, 0, MSG_DONTWAIT, NULL, NULL);
+    }
+}
+
+/**
+ * Arrange for packets whose payloads lie in the given memory to be
+ * transmitted without copying. The region becomes part of the UMEM, which
+ * requires a new socket; packets in flight when this method is invoked
+ * may be lost. Only the first region is used, and only if the kernel
+ * supports multi-buffer AF_XDP sockets; otherwise packets are copied.
+ *
+ * \param base
+ *     Start of the memory region (must be page-aligned).
+ * \param bytes
+ *     The total size in bytes of the region.
+ */
+void
+XdpDriver::registerMemory(void* base, size_t bytes)
+{
+    Tub<Dispatch::Lock> dispatchLock;
+    if (context != NULL && context->dispatch != NULL)
+        dispatchLock.construct(context->dispatch);
+    SpinLock::Guard guard(mutex);
+
+    char* region = static_cast<char*>(base);
+    if (framesOffset != 0) {
+        LOG(NOTICE, "XdpDriver already has a zero-copy region; ignoring "
+                "%lu bytes at %p", bytes, base);
+        return;
+    }
+    if (!multiBuffer) {
+        LOG(NOTICE, "Kernel doesn't support multi-buffer AF_XDP sockets; "
+                "XdpDriver will copy packets from %lu bytes at %p",
+                bytes, base);
+        return;
+    }
+    if ((reinterpret_cast<uintptr_t>(region) & (FRAME_SIZE - 1)) != 0) {
+        LOG(WARNING, "XdpDriver can't transmit from %p without copying: "
+                "not page-aligned", base);
+        return;
+    }
+    if (!createUmem(region, bytes)) {
+        LOG(WARNING, "XdpDriver can't transmit from %lu bytes at %p without "
+                "copying: couldn't map frames after the region (%s)",
+                bytes, base, strerror(errno));
+        return;
+    }
+    closeSocket();
+    openSocket();
+    LOG(NOTICE, "XdpDriver created zero-copy region with %lu bytes at %p",
+            bytes, base);
+}
+
+// See docs in Driver class.
+void
+XdpDriver::release(char *payload)
+{
+    // Must sync with the dispatch thread, since this method could
+    // potentially be invoked in a worker.
+    SpinLock::Guard guard(mutex);
+    packetsOutstanding--;
+    assert(packetsOutstanding >= 0);
+
+    size_t rxFrameBytes = NUM_RX_FRAMES*FRAME_SIZE;
+    if (payload >= frames && payload < frames + rxFrameBytes) {
+        framesHeld--;
+        freeRxFrames.push_back(static_cast<uint64_t>(payload - umemBase)
+                & ~(FRAME_SIZE - 1UL));
+    } else if (retiredFrames != NULL && payload >= retiredFrames
+            && payload < retiredFrames + rxFrameBytes) {
+        // The frame was retired by registerMemory; just drop it.
+        framesHeld--;
+    } else {
+        packetBufPool.destroy(reinterpret_cast<PacketBuf*>(
+                payload - OFFSET_OF(PacketBuf, payload)));
+    }
+}
+
+// See docs in Driver class.
+void
+XdpDriver::sendPacket(const Address* addr,
+                      const void* header,
+                      uint32_t headerLen,
+                      Buffer::Iterator* payload,
+                      int priority)
+{
+    assert(priority >= 0 && priority <= getHighestPacketPriority());
+    const MacAddress* recipient = static_cast<const MacAddress*>(addr);
+    uint32_t frameLength = ETHER_VLAN_HDR_LEN + headerLen
+            + (payload ? payload->size() : 0);
+    assert(frameLength - ETHER_VLAN_HDR_LEN <= MAX_PAYLOAD_SIZE);
+
+    if (memcmp(recipient->address, localMac->address, 6) == 0) {
+        // The packet is addressed to ourselves; the NIC won't loop it
+        // back, so copy it directly to a receive frame.
+        SpinLock::Guard guard(mutex);
+        if (freeRxFrames.empty()) {
+            RAMCLOUD_CLOG(NOTICE, "XdpDriver out of receive frames; "
+                    "dropping loopback packet");
+            return;
+        }
+        uint64_t frame = freeRxFrames.back() + RX_HEADROOM;
+        freeRxFrames.pop_back();
+        char* p = umemBase + frame;
+        p += writeEthernetHeader(p, recipient, priority);
+        memcpy(p, header, headerLen);
+        p += headerLen;
+        while (payload && !payload->isDone()) {
+            memcpy(p, payload->getData(), payload->getLength());
+            p += payload->getLength();
+            payload->next();
+        }
+        loopbackPackets.push_back({frame, frameLength, 0});
+        PerfStats::threadStats.networkOutputBytes += frameLength;
+        return;
+    }
+
+    reapCompletions();
+    uint32_t ringSpace = RING_SIZE - (txRing.cachedIndex
+            - __atomic_load_n(txRing.consumer, __ATOMIC_ACQUIRE));
+    if (ringSpace < MAX_DESCS_PER_PACKET ||
+            freeTxFrames.size() < MAX_DESCS_PER_PACKET) {
+        RAMCLOUD_CLOG(NOTICE, "XdpDriver transmit ring full; dropping packet");
+        queueEstimator.setQueueSize(maxTransmitQueueSize, Cycles::rdtsc());
+        return;
+    }
+
+    // The packet consists of one or more descriptors: transmit frames
+    // into which we copy data, interleaved with pieces of registered
+    // memory that the kernel reads directly.
+    xdp_desc descs[MAX_DESCS_PER_PACKET];
+    uint64_t frame = freeTxFrames.back();
+    freeTxFrames.pop_back();
+    char* p = umemBase + frame;
+    uint32_t length = writeEthernetHeader(p, recipient, priority);
+    memcpy(p + length, header, headerLen);
+    descs[0] = {frame, length + headerLen, 0};
+    uint32_t numDescs = 1;
+
+    // The descriptor into which data is currently being copied, or NULL
+    // if the last descriptor refers to registered memory.
+    xdp_desc* copyDesc = &descs[0];
+    while (payload && !payload->isDone()) {
+        const char* chunk = static_cast<const char*>(payload->getData());
+        uint32_t chunkLength = payload->getLength();
+        payload->next();
+        if (chunkLength >= MIN_ZERO_COPY_BYTES && chunk >= umemBase
+                && chunk + chunkLength <= umemBase + framesOffset) {
+            // Descriptors can't cross frame boundaries, so the chunk may
+            // need several of them. Always leave room for one more
+            // descriptor, in case later chunks must be copied.
+            uint64_t offset = chunk - umemBase;
+            uint32_t pieces = downCast<uint32_t>(
+                    (offset + chunkLength - 1)/FRAME_SIZE - offset/FRAME_SIZE
+                    + 1);
+            if (numDescs + pieces < MAX_DESCS_PER_PACKET) {
+                while (chunkLength > 0) {
+                    uint32_t pieceLength = std::min(chunkLength,
+                            FRAME_SIZE - downCast<uint32_t>(
+                            offset % FRAME_SIZE));
+                    descs[numDescs] = {offset, pieceLength, 0};
+                    numDescs++;
+                    offset += pieceLength;
+                    chunkLength -= pieceLength;
+                }
+                copyDesc = NULL;
+                continue;
+            }
+        }
+        if (copyDesc == NULL) {
+            copyDesc = &descs[numDescs];
+            numDescs++;
+            *copyDesc = {freeTxFrames.back(), 0, 0};
+            freeTxFrames.pop_back();
+        }
+        memcpy(umemBase + copyDesc->addr + copyDesc->len, chunk,
+                chunkLength);
+        copyDesc->len += chunkLength;
+    }
+
+    xdp_desc* entries = static_cast<xdp_desc*>(txRing.entries);
+    for (uint32_t i = 0; i < numDescs; i++) {
+        xdp_desc* desc = &entries[txRing.cachedIndex & (RING_SIZE-1)];
+        *desc = descs[i];
+        if (i < numDescs - 1)
+            desc->options = XDP_PKT_CONTD;
+        txRing.cachedIndex++;
+    }
+    txDescsQueued += numDescs;
+    if (!transmitBatchActive)
+        kickTransmit();
+
+    queueEstimator.packetQueued(frameLength, Cycles::rdtsc());
+    PerfStats::threadStats.networkOutputBytes += frameLength;
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,342 @@
+/* Copyright (c) 2017 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_XDPDRIVER_H
+#define RAMCLOUD_XDPDRIVER_H
+
+#include <linux/if_xdp.h>
+#include <deque>
+#include <vector>
+
+#include "Driver.h"
+#include "MacAddress.h"
+#include "ObjectPool.h"
+#include "QueueEstimator.h"
+#include "ServiceLocator.h"
+#include "SpinLock.h"
+#include "Syscall.h"
+#include "Tub.h"
+
+// Older kernel headers don't define these (multi-buffer AF_XDP sockets
+// were added in Linux 6.6).
+#ifndef XDP_USE_SG
+#define XDP_USE_SG (1 << 4)
+#endif
+#ifndef XDP_PKT_CONTD
+#define XDP_PKT_CONTD (1 << 0)
+#endif
+
+namespace RAMCloud {
+
+/**
+ * A Driver that sends and receives raw Ethernet frames through an AF_XDP
+ * socket, which bypasses the kernel's network stack without requiring DPDK
+ * or special NIC drivers. Packets are exchanged with the kernel through
+ * four shared-memory rings whose descriptors refer to frames in a "UMEM"
+ * region owned by this driver:
+ * - Received packets are handed to the transport in place (no copying);
+ *   release returns their frames to the kernel through the fill ring. If
+ *   the transport holds on to too many frames (e.g. while receiving a
+ *   large message), packets are copied out so the kernel doesn't run out.
+ * - Outgoing packets are assembled in transmit frames; if memory has
+ *   been registered with registerMemory (e.g. the log), payload chunks
+ *   within it are transmitted directly from that memory as additional
+ *   fragments of a multi-buffer packet, without copying.
+ *
+ * A small XDP program, installed on the interface by the constructor,
+ * redirects RAMCloud frames (Ethernet type NetUtil::RAMCLOUD) arriving on
+ * the driver's queue to the socket; all other traffic continues up the
+ * kernel stack. The driver uses zero-copy mode if the NIC's kernel driver
+ * supports it and falls back to copy mode otherwise (e.g. on veth pairs,
+ * which makes the driver usable for testing on a stock Linux machine).
+ *
+ * Service locators have the form "xdp:ifname=eth0,mac=...". The optional
+ * "queue" option selects the NIC receive queue (default 0); "gbs" gives
+ * the link speed in Gbits/sec (default 10). Only one XdpDriver can run on
+ * each interface, since an interface has a single XDP program.
+ */
+class XdpDriver : public Driver {
+  public:
+#if TESTING
+    explicit XdpDriver(Context* context);
+#endif
+    explicit XdpDriver(Context* context,
+                       const ServiceLocator* localServiceLocator);
+    virtual ~XdpDriver();
+    virtual int getHighestPacketPriority();
+    virtual uint32_t getMaxPacketSize();
+    virtual uint32_t getBandwidth();
+    virtual int getTransmitQueueSpace(uint64_t currentTime);
+    virtual void receivePackets(uint32_t maxPackets,
+            std::vector<Received>* receivedPackets);
+    virtual void registerMemory(void* base, size_t bytes);
+    virtual void release(char *payload);
+    virtual void sendPacket(const Address* addr,
+                            const void* header,
+                            uint32_t headerLen,
+                            Buffer::Iterator* payload,
+                            int priority = 0);
+    virtual string getServiceLocator();
+    virtual uint64_t getTransmitMark() { return txDescsQueued; }
+    virtual bool isTransmitComplete(uint64_t mark);
+    virtual void startTransmitBatch() { transmitBatchActive = true; }
+    virtual void flushTransmitBatch();
+
+    virtual Address* newAddress(const ServiceLocator* serviceLocator)
+    {
+        return new MacAddress(serviceLocator->getOption<const char*>("mac"));
+    }
+
+  PRIVATE:
+    /**
+     * One of the four rings shared with the kernel. The kernel and this
+     * driver each own one end: the producer adds entries and advances
+     * *producer; the consumer removes them and advances *consumer. Each
+     * side caches its own index locally, so only the other side's index
+     * needs to be read from shared memory.
+     */
+    struct Ring {
+        Ring()
+            : producer(NULL)
+            , consumer(NULL)
+            , flags(NULL)
+            , entries(NULL)
+            , cachedIndex(0)
+            , mapping(NULL)
+            , mappingLength(0)
+        {}
+
+        /// Index of the next entry to be produced.
+        uint32_t* producer;
+
+        /// Index of the next entry to be consumed.
+        uint32_t* consumer;
+
+        /// XDP_RING_NEED_WAKEUP is set here when the kernel must be
+        /// prodded with a system call to make progress on the ring.
+        uint32_t* flags;
+
+        /// The ring's entries: xdp_desc for the receive and transmit
+        /// rings, UMEM addresses (uint64_t) for the fill and completion
+        /// rings. There are RING_SIZE of them.
+        void* entries;
+
+        /// This driver's private copy of whichever index it owns.
+        uint32_t cachedIndex;
+
+        /// The region mapped from the socket to hold the ring (or
+        /// allocated with malloc, during unit tests).
+        void* mapping;
+
+        /// Size of mapping, in bytes.
+        size_t mappingLength;
+
+        DISALLOW_COPY_AND_ASSIGN(Ring);
+    };
+
+    void closeSocket();
+    bool createUmem(char* region, size_t regionBytes);
+    void createSocket();
+    void installXdpProgram();
+    void kickTransmit();
+    void mapRing(Ring* ring, uint64_t pageOffset, uint32_t entrySize,
+            const xdp_ring_offset* offsets);
+    void openSocket();
+    void processFrame(uint64_t addr, uint32_t length,
+            std::vector<Received>* receivedPackets);
+    void reapCompletions();
+    void refillRxRing();
+    uint32_t writeEthernetHeader(char* frame, const MacAddress* recipient,
+            int priority);
+
+    /// The maximum size of the Ethernet payload of a packet.
+    static const uint32_t MAX_PAYLOAD_SIZE = 1500;
+
+    /// Size of VLAN tag, in bytes. As in DpdkDriver, the PCP (Priority
+    /// Code Point) field of the VLAN tag specifies the packet priority.
+    static const uint32_t VLAN_TAG_LEN = 4;
+
+    /// Size of Ethernet header including VLAN tag, in bytes.
+    static const uint32_t ETHER_VLAN_HDR_LEN = 14 + VLAN_TAG_LEN;
+
+    /// Size of each UMEM frame (the "chunk size" in AF_XDP terms). This is
+    /// also the granularity at which the kernel validates transmit
+    /// descriptors: a descriptor may not cross a FRAME_SIZE boundary.
+    static const uint32_t FRAME_SIZE = 4096;
+
+    /// Number of entries in each of the four rings.
+    static const uint32_t RING_SIZE = 2048;
+
+    /// Number of frames used for incoming packets. This is larger than
+    /// RING_SIZE so that the fill ring can be kept full while the transport
+    /// holds on to packets.
+    static const uint32_t NUM_RX_FRAMES = 2*RING_SIZE;
+
+    /// Number of frames used to assemble outgoing packets.
+    static const uint32_t NUM_TX_FRAMES = RING_SIZE;
+
+    /// Space reserved in front of each received packet (the UMEM
+    /// "headroom"); it holds the MacAddress of the packet's sender.
+    static const uint32_t RX_HEADROOM = 64;
+
+    /// The largest number of descriptors (fragments) used for one
+    /// outgoing packet.
+    static const uint32_t MAX_DESCS_PER_PACKET = 8;
+
+    /// Chunks of registered memory smaller than this are copied, since
+    /// an extra descriptor costs more than copying a few bytes.
+    static const uint32_t MIN_ZERO_COPY_BYTES = 256;
+
+    /// Number of entries in the XSKMAP used by the XDP program (i.e., one
+    /// more than the highest receive queue that can be used).
+    static const uint32_t MAX_QUEUES = 64;
+
+    /// Once this many received packets are held in place by the transport,
+    /// further packets are copied out of their frames (otherwise a large
+    /// incoming message could consume every frame and stall the driver).
+    static const uint32_t MAX_FRAMES_HELD = NUM_RX_FRAMES - RING_SIZE;
+
+    /// Map from priority levels to values of the PCP field (see DpdkDriver).
+    static constexpr uint16_t PRIORITY_TO_PCP[8] =
+            {1 << 13, 0 << 13, 2 << 13, 3 << 13, 4 << 13, 5 << 13, 6 << 13,
+             7 << 13};
+
+    typedef Driver::PacketBuf<MacAddress, MAX_PAYLOAD_SIZE> PacketBuf;
+
+    /// Shared RAMCloud information.
+    Context* context;
+
+    /// The service locator string returned by getServiceLocator.
+    string locatorString;
+
+    /// Name of the network interface used by this driver. Empty during
+    /// unit tests, in which case no socket is opened.
+    string ifName;
+
+    /// Kernel index of ifName.
+    uint32_t ifIndex;
+
+    /// NIC receive queue whose packets are delivered to this driver.
+    uint32_t queueId;
+
+    /// MAC address of this driver (either the interface's or overridden
+    /// by the "mac" locator option).
+    Tub<MacAddress> localMac;
+
+    /// The AF_XDP socket, or -1 if none.
+    int fd;
+
+    /// Descriptors for the XSKMAP, the XDP program, and the BPF link that
+    /// attaches the program to the interface (-1 if not open).
+    int xskMapFd;
+    int programFd;
+    int linkFd;
+
+    /// Start of the UMEM region shared with the kernel. It consists of
+    /// the memory passed to registerMemory (if any), immediately followed
+    /// by NUM_RX_FRAMES receive frames and NUM_TX_FRAMES transmit frames.
+    char* umemBase;
+
+    /// Total size of the UMEM region, in bytes.
+    size_t umemBytes;
+
+    /// Offset within the UMEM of the first receive frame; everything
+    /// before this is registered memory that can be transmitted without
+    /// copying.
+    uint64_t framesOffset;
+
+    /// Start of the memory mapped for the driver's frames (umemBase +
+    /// framesOffset).
+    char* frames;
+
+    /// Frame memory from before the last call to registerMemory. It is
+    /// kept mapped (but not reused) since the transport may still hold
+    /// packets in it. NULL means none.
+    char* retiredFrames;
+
+    /// Receive frames (UMEM offsets) that are neither in the fill ring nor
+    /// held by the transport. Protected by mutex.
+    std::vector<uint64_t> freeRxFrames;
+
+    /// Transmit frames (UMEM offsets) that are available for new packets.
+    std::vector<uint64_t> freeTxFrames;
+
+    /// The four AF_XDP rings: rxRing and completionRing are produced by
+    /// the kernel, txRing and fillRing by this driver.
+    Ring rxRing;
+    Ring txRing;
+    Ring fillRing;
+    Ring completionRing;
+
+    /// Packets sent to our own MAC address; they are copied into receive
+    /// frames and returned by the next call to receivePackets.
+    std::deque<xdp_desc> loopbackPackets;
+
+    /// True means the receive ring is in the middle of a packet that
+    /// arrived in several pieces, which are being discarded.
+    bool discardingFragments;
+
+    /// Holds copies of received packets (see MAX_FRAMES_HELD).
+    ObjectPool<PacketBuf> packetBufPool;
+
+    /// Number of received packets currently held by the transport (for
+    /// detecting leaks).
+    int packetsOutstanding;
+
+    /// Number of packets held by the transport that are still in their
+    /// receive frames.
+    uint32_t framesHeld;
+
+    /// Total number of descriptors added to txRing, and number whose
+    /// completions have been retrieved from completionRing. Used for
+    /// transmit marks.
+    uint64_t txDescsQueued;
+    uint64_t txDescsCompleted;
+
+    /// True means that packets are being queued in txRing without notifying
+    /// the kernel (see startTransmitBatch).
+    bool transmitBatchActive;
+
+    /// True means the socket is bound in zero-copy mode; false means the
+    /// kernel copies packets between the UMEM and its own buffers.
+    bool zeroCopyMode;
+
+    /// True means the socket accepts multi-buffer packets (Linux 6.6 and
+    /// later), which is required to transmit from registered memory.
+    bool multiBuffer;
+
+    /// Effective network bandwidth, in Mbits/second.
+    uint32_t bandwidthMbps;
+
+    /// Used to estimate # bytes outstanding in the NIC's transmit queue.
+    QueueEstimator queueEstimator;
+
+    /// Upper limit on how many bytes should be queued for transmission
+    /// at any given time.
+    uint32_t maxTransmitQueueSize;
+
+    /// Protects freeRxFrames, fillRing, packetBufPool, and the counts of
+    /// packets held by the transport, which are also used by release
+    /// (which may be invoked in worker threads).
+    SpinLock mutex;
+
+    static Syscall* sys;
+
+    DISALLOW_COPY_AND_ASSIGN(XdpDriver);
+};
+
+} // end RAMCloud
+
+#endif  // RAMCLOUD_XDPDRIVER_H
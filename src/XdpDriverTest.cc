@@ -0,0 +1,369 @@
+/* Copyright (c) 2017 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/mman.h>
+
+#include "TestUtil.h"
+#include "MockSyscall.h"
+#include "NetUtil.h"
+#include "PerfStats.h"
+#include "XdpDriver.h"
+
+namespace RAMCloud {
+
+// The tests below use a driver without a socket, and play the role of the
+// kernel by manipulating its rings directly.
+class XdpDriverTest : public ::testing::Test {
+  public:
+    Context context;
+    XdpDriver driver;
+    MacAddress peer;
+    std::vector<Driver::Received> received;
+    TestLog::Enable logEnabler;
+
+    XdpDriverTest()
+        : context()
+        , driver(&context)
+        , peer("ff:ff:ff:ff:ff:ff")
+        , received()
+        , logEnabler()
+    {}
+
+    ~XdpDriverTest() {}
+
+    // Return a string describing the transmit descriptors that have been
+    // queued since the last call.
+    string
+    takeTxDescs()
+    {
+        string result;
+        xdp_desc* entries = static_cast<xdp_desc*>(driver.txRing.entries);
+        while (*driver.txRing.consumer != driver.txRing.cachedIndex) {
+            xdp_desc* desc = &entries[*driver.txRing.consumer
+                    & (XdpDriver::RING_SIZE - 1)];
+            if (!result.empty())
+                result += ", ";
+            if (desc->addr >= driver.framesOffset) {
+                result += "frame";
+            } else {
+                result += format("region+%lu",
+                        static_cast<uint64_t>(desc->addr));
+            }
+            result += format(" %u%s", desc->len,
+                    (desc->options & XDP_PKT_CONTD) ? " contd" : "");
+            (*driver.txRing.consumer)++;
+        }
+        return result;
+    }
+
+    // Simulate the kernel receiving an Ethernet frame: take a buffer from
+    // the fill ring, store the frame in it, and add it to the rx ring.
+    void
+    deliver(uint16_t etherType, const char* payload)
+    {
+        uint64_t* fillEntries = static_cast<uint64_t*>(
+                driver.fillRing.entries);
+        uint64_t addr = fillEntries[*driver.fillRing.consumer
+                & (XdpDriver::RING_SIZE - 1)] + 256 + XdpDriver::RX_HEADROOM;
+        (*driver.fillRing.consumer)++;
+
+        char* frame = driver.umemBase + addr;
+        memcpy(frame, peer.address, 6);
+        memcpy(frame + 6, peer.address, 6);
+        *reinterpret_cast<uint16_t*>(frame + 12) = HTONS(etherType);
+        uint32_t length = downCast<uint32_t>(strlen(payload));
+        memcpy(frame + 14, payload, length);
+
+        xdp_desc* rxEntries = static_cast<xdp_desc*>(driver.rxRing.entries);
+        rxEntries[*driver.rxRing.producer & (XdpDriver::RING_SIZE - 1)] =
+                {addr, 14 + length, 0};
+        (*driver.rxRing.producer)++;
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(XdpDriverTest);
+};
+
+TEST_F(XdpDriverTest, constructor_noInterface) {
+    ServiceLocator sl("xdp:ifname=bogus99");
+    EXPECT_THROW(XdpDriver(&context, &sl), DriverException);
+    ServiceLocator sl2("xdp:mac=01:23:45:67:89:ab");
+    EXPECT_THROW(XdpDriver(&context, &sl2), DriverException);
+}
+
+// Pretends that AF_XDP sockets can be created and configured, so that
+// createSocket can get as far as reading the ring offsets.
+class XdpMockSyscall : public MockSyscall {
+  public:
+    int socket(int domain, int type, int protocol) {
+        return ::socket(AF_UNIX, SOCK_DGRAM, 0);
+    }
+    int setsockopt(int sockfd, int level, int optname, const void *optval,
+                    socklen_t optlen) {
+        return 0;
+    }
+};
+
+TEST_F(XdpDriverTest, createSocket_errorInGetsockopt) {
+    XdpMockSyscall sys;
+    sys.getsockoptErrno = EINVAL;
+    Syscall* savedSyscall = XdpDriver::sys;
+    XdpDriver::sys = &sys;
+    string message("no exception");
+    try {
+        driver.createSocket();
+    } catch (DriverException& e) {
+        message = e.message;
+    }
+    XdpDriver::sys = savedSyscall;
+    EXPECT_EQ("XdpDriver couldn't get AF_XDP ring offsets: "
+            "Invalid argument", message);
+    close(driver.fd);
+    driver.fd = -1;
+}
+
+TEST_F(XdpDriverTest, createUmem_afterRegion) {
+    // Reserve address space, then free the part after the region so that
+    // the frames can be mapped there.
+    size_t regionBytes = 10000;
+    char* region = static_cast<char*>(mmap(NULL, 64 << 20, PROT_READ,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    munmap(region + 3*4096, (64 << 20) - 3*4096);
+    char* oldFrames = driver.frames;
+
+    EXPECT_TRUE(driver.createUmem(region, regionBytes));
+    EXPECT_EQ(region, driver.umemBase);
+    EXPECT_EQ(3*4096U, driver.framesOffset);
+    EXPECT_EQ(region + 3*4096, driver.frames);
+    EXPECT_EQ(oldFrames, driver.retiredFrames);
+    EXPECT_EQ(4096U, driver.freeRxFrames.size());
+    EXPECT_EQ(3*4096U, driver.freeRxFrames[0]);
+
+    // The address space after the region is now in use.
+    EXPECT_FALSE(driver.createUmem(region, 100));
+    EXPECT_EQ(region + 3*4096, driver.frames);
+    munmap(region, 3*4096);
+}
+
+TEST_F(XdpDriverTest, isTransmitComplete) {
+    Buffer buffer;
+    buffer.appendCopy("abcdefgh", 8);
+    Buffer::Iterator iterator(&buffer);
+    driver.sendPacket(&peer, "header", 6, &iterator);
+    uint64_t mark = driver.getTransmitMark();
+    EXPECT_EQ(1U, mark);
+    EXPECT_FALSE(driver.isTransmitComplete(mark));
+    size_t freeFrames = driver.freeTxFrames.size();
+
+    uint64_t* entries = static_cast<uint64_t*>(
+            driver.completionRing.entries);
+    entries[0] = static_cast<xdp_desc*>(driver.txRing.entries)[0].addr;
+    *driver.completionRing.producer = 1;
+    EXPECT_TRUE(driver.isTransmitComplete(mark));
+    EXPECT_EQ(1U, *driver.completionRing.consumer);
+    EXPECT_EQ(freeFrames + 1, driver.freeTxFrames.size());
+}
+
+TEST_F(XdpDriverTest, receivePackets_basics) {
+    PerfStats::threadStats.networkInputBytes = 0;
+    size_t freeFrames = driver.freeRxFrames.size();
+    deliver(NetUtil::EthPayloadType::RAMCLOUD, "first packet");
+    deliver(NetUtil::EthPayloadType::IP_V4, "not for us");
+    deliver(NetUtil::EthPayloadType::RAMCLOUD, "third packet");
+
+    driver.receivePackets(10, &received);
+    EXPECT_EQ(3U, *driver.rxRing.consumer);
+    ASSERT_EQ(2U, received.size());
+    EXPECT_EQ("first packet", string(received[0].payload, received[0].len));
+    EXPECT_EQ("ff:ff:ff:ff:ff:ff", received[0].sender->toString());
+    EXPECT_EQ("third packet", string(received[1].payload, received[1].len));
+    EXPECT_EQ(52U, PerfStats::threadStats.networkInputBytes);
+    EXPECT_EQ(2, driver.packetsOutstanding);
+
+    // The frame for the IPv4 packet has been recycled, and the fill ring
+    // has been topped up.
+    EXPECT_EQ(freeFrames - 2, driver.freeRxFrames.size());
+    received.clear();
+    EXPECT_EQ(0, driver.packetsOutstanding);
+    EXPECT_EQ(0U, driver.framesHeld);
+}
+
+TEST_F(XdpDriverTest, receivePackets_maxPackets) {
+    deliver(NetUtil::EthPayloadType::RAMCLOUD, "first");
+    deliver(NetUtil::EthPayloadType::RAMCLOUD, "second");
+    driver.receivePackets(1, &received);
+    EXPECT_EQ(1U, received.size());
+    driver.receivePackets(1, &received);
+    EXPECT_EQ(2U, received.size());
+    EXPECT_EQ("second", string(received[1].payload, received[1].len));
+}
+
+TEST_F(XdpDriverTest, receivePackets_copyWhenTooManyFramesHeld) {
+    driver.framesHeld = XdpDriver::MAX_FRAMES_HELD;
+    size_t freeFrames = driver.freeRxFrames.size();
+    deliver(NetUtil::EthPayloadType::RAMCLOUD, "copied");
+    driver.receivePackets(10, &received);
+    ASSERT_EQ(1U, received.size());
+    EXPECT_EQ("copied", string(received[0].payload, received[0].len));
+    EXPECT_EQ("ff:ff:ff:ff:ff:ff", received[0].sender->toString());
+    EXPECT_EQ(2048U, driver.framesHeld);
+    EXPECT_EQ(1U, driver.packetBufPool.outstandingObjects);
+
+    // The frame went back to the kernel right away.
+    EXPECT_EQ(freeFrames, driver.freeRxFrames.size());
+    received.clear();
+    EXPECT_EQ(0U, driver.packetBufPool.outstandingObjects);
+}
+
+TEST_F(XdpDriverTest, registerMemory) {
+    char* region = static_cast<char*>(mmap(NULL, 64 << 20, PROT_READ,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    munmap(region + 4096, (64 << 20) - 4096);
+
+    driver.multiBuffer = false;
+    TestLog::reset();
+    driver.registerMemory(region, 4096);
+    EXPECT_TRUE(TestUtil::contains(TestLog::get(),
+            "Kernel doesn't support multi-buffer"));
+    EXPECT_EQ(0U, driver.framesOffset);
+
+    driver.multiBuffer = true;
+    TestLog::reset();
+    driver.registerMemory(region + 1, 4095);
+    EXPECT_TRUE(TestUtil::contains(TestLog::get(), "not page-aligned"));
+
+    TestLog::reset();
+    driver.registerMemory(region, 4096);
+    EXPECT_TRUE(TestUtil::contains(TestLog::get(),
+            "created zero-copy region with 4096 bytes"));
+    EXPECT_EQ(region, driver.umemBase);
+    EXPECT_EQ(4096U, driver.framesOffset);
+    EXPECT_EQ(2048U, *driver.fillRing.producer);
+
+    TestLog::reset();
+    driver.registerMemory(region, 4096);
+    EXPECT_TRUE(TestUtil::contains(TestLog::get(),
+            "already has a zero-copy region"));
+    munmap(region, 4096);
+}
+
+TEST_F(XdpDriverTest, release_retiredFrame) {
+    deliver(NetUtil::EthPayloadType::RAMCLOUD, "old packet");
+    driver.receivePackets(10, &received);
+    ASSERT_EQ(1U, received.size());
+
+    char* region = static_cast<char*>(mmap(NULL, 64 << 20, PROT_READ,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    munmap(region + 4096, (64 << 20) - 4096);
+    driver.registerMemory(region, 4096);
+    size_t freeFrames = driver.freeRxFrames.size();
+    received.clear();
+    EXPECT_EQ(freeFrames, driver.freeRxFrames.size());
+    EXPECT_EQ(0U, driver.framesHeld);
+    munmap(region, 4096);
+}
+
+TEST_F(XdpDriverTest, sendPacket_basics) {
+    PerfStats::threadStats.networkOutputBytes = 0;
+    Buffer buffer;
+    buffer.appendCopy("abcdefgh", 8);
+    Buffer::Iterator iterator(&buffer);
+    driver.sendPacket(&peer, "ABCDEFGH", 8, &iterator, 3);
+
+    xdp_desc desc = static_cast<xdp_desc*>(driver.txRing.entries)[0];
+    EXPECT_EQ("frame 34", takeTxDescs());
+    EXPECT_EQ(1U, *driver.txRing.producer);
+    const uint8_t* frame = reinterpret_cast<const uint8_t*>(
+            driver.umemBase + desc.addr);
+    string hexHeader;
+    for (uint32_t i = 0; i < XdpDriver::ETHER_VLAN_HDR_LEN; i++)
+        hexHeader += format("%02x", frame[i]);
+    EXPECT_EQ("ffffffffffff" "0123456789ab" "8100" "6000" "88b5", hexHeader);
+    EXPECT_EQ("ABCDEFGHabcdefgh", string(reinterpret_cast<const char*>(
+            frame + XdpDriver::ETHER_VLAN_HDR_LEN), 16));
+    EXPECT_EQ(34, driver.queueEstimator.queueSize);
+    EXPECT_EQ(34U, PerfStats::threadStats.networkOutputBytes);
+}
+
+TEST_F(XdpDriverTest, sendPacket_loopback) {
+    MacAddress self("01:23:45:67:89:ab");
+    Buffer buffer;
+    buffer.appendCopy("payload", 7);
+    Buffer::Iterator iterator(&buffer);
+    driver.sendPacket(&self, "header:", 7, &iterator);
+    EXPECT_EQ("", takeTxDescs());
+    EXPECT_EQ(1U, driver.loopbackPackets.size());
+
+    driver.receivePackets(10, &received);
+    ASSERT_EQ(1U, received.size());
+    EXPECT_EQ("header:payload", string(received[0].payload,
+            received[0].len));
+    EXPECT_EQ("01:23:45:67:89:ab", received[0].sender->toString());
+}
+
+TEST_F(XdpDriverTest, sendPacket_ringFull) {
+    driver.freeTxFrames.resize(XdpDriver::MAX_DESCS_PER_PACKET - 1);
+    TestLog::reset();
+    driver.sendPacket(&peer, "header", 6, NULL);
+    EXPECT_TRUE(TestUtil::contains(TestLog::get(),
+            "transmit ring full; dropping packet"));
+    EXPECT_EQ("", takeTxDescs());
+}
+
+TEST_F(XdpDriverTest, sendPacket_zeroCopy) {
+    char* region = static_cast<char*>(mmap(NULL, 64 << 20,
+            PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    munmap(region + 4*4096, (64 << 20) - 4*4096);
+    driver.registerMemory(region, 4*4096);
+
+    // A chunk that crosses a frame boundary needs two descriptors; small
+    // chunks are copied.
+    Buffer buffer;
+    buffer.appendCopy("abc", 3);
+    buffer.appendExternal(region + 4000, 1000);
+    buffer.appendExternal(region + 8192, 100);
+    buffer.appendCopy("xyz", 3);
+    Buffer::Iterator iterator(&buffer);
+    driver.sendPacket(&peer, "header", 6, &iterator);
+    EXPECT_EQ("frame 27 contd, region+4000 96 contd, region+4096 904 contd, "
+            "frame 103", takeTxDescs());
+    EXPECT_EQ(4U, driver.getTransmitMark());
+
+    // Once the descriptors run out, chunks are copied.
+    Buffer buffer2;
+    buffer2.appendExternal(region + 4000, 256);
+    buffer2.appendExternal(region + 8100, 256);
+    buffer2.appendExternal(region + 12200, 256);
+    buffer2.appendExternal(region, 256);
+    Buffer::Iterator iterator2(&buffer2);
+    driver.sendPacket(&peer, "header", 6, &iterator2);
+    EXPECT_EQ("frame 24 contd, region+4000 96 contd, region+4096 160 contd, "
+            "region+8100 92 contd, region+8192 164 contd, "
+            "region+12200 88 contd, region+12288 168 contd, frame 256",
+            takeTxDescs());
+    munmap(region, 4*4096);
+}
+
+TEST_F(XdpDriverTest, transmitBatch) {
+    driver.startTransmitBatch();
+    driver.sendPacket(&peer, "header", 6, NULL);
+    driver.sendPacket(&peer, "header", 6, NULL);
+    EXPECT_EQ(0U, *driver.txRing.producer);
+    driver.flushTransmitBatch();
+    EXPECT_EQ(2U, *driver.txRing.producer);
+    driver.sendPacket(&peer, "header", 6, NULL);
+    EXPECT_EQ(3U, *driver.txRing.producer);
+}
+
+}  // namespace RAMCloud